@@ -61,10 +61,16 @@ static bool RunBootloader = true;
 uint16_t TxLEDPulse = 0; // time remaining for Tx LED pulse
 uint16_t RxLEDPulse = 0; // time remaining for Rx LED pulse
 
-/* Bootloader timeout timer */
-#define TIMEOUT_PERIOD	8000
+/* Bootloader timeout timer, in ms. Set TIMEOUT_PERIOD in the Makefile to shorten the wait for the host */
+#if !defined(TIMEOUT_PERIOD)
+	#define TIMEOUT_PERIOD	8000
+#endif
 uint16_t Timeout = 0;
 
+/* Boot key the sketch leaves in RAM before a watchdog reset to ask for the bootloader. When EXT_RESET_TIMEOUT_PERIOD
+ * (in ms) is set, an external reset also sets it for that long and then starts the sketch, so a second reset in the
+ * meantime enters the bootloader. Without it every external reset enters the bootloader.
+ */
 uint16_t bootKey = 0x7777;
 volatile uint16_t *const bootKeyPtr = (volatile uint16_t *)0x0800;
 
@@ -122,6 +128,16 @@ int main(void)
 	wdt_disable();
 	
 	if (mcusr_state & (1<<EXTRF)) {
+		#if defined(EXT_RESET_TIMEOUT_PERIOD)
+		if ((bootKeyPtrVal != bootKey) && (pgm_read_word(0) != 0xFFFF)) {
+			// A single external reset starts the sketch. Leave the boot key set for the
+			// window, so a second reset during it finds the key and stays in the bootloader.
+			*bootKeyPtr = bootKey;
+			_delay_ms(EXT_RESET_TIMEOUT_PERIOD);
+			*bootKeyPtr = 0;
+			StartSketch();
+		}
+		#endif
 		// External reset -  we should continue to self-programming mode.
 	} else if ((mcusr_state & (1<<PORF)) && (pgm_read_word(0) != 0xFFFF)) {		
 		// After a power-on reset skip the bootloader and jump straight to sketch 
@@ -271,9 +287,23 @@ void EVENT_USB_Device_ControlRequest(void)
 }
 
 #if !defined(NO_BLOCK_SUPPORT)
+#if (FLASHEND > 0xFFFF)
+	#define ReadFlashByte(Address)  pgm_read_byte_far(Address)
+#else
+	#define ReadFlashByte(Address)  pgm_read_byte(Address)
+#endif
+
+/** Holds one page of FLASH data from the host, so that it can be compared against the current page contents
+ *  before anything is erased or written.
+ */
+static uint8_t PageBuffer[SPM_PAGESIZE];
+
 /** Reads or writes a block of EEPROM or FLASH memory to or from the appropriate CDC data endpoint, depending
  *  on the AVR910 protocol command issued.
  *
+ *  FLASH blocks are moved a whole endpoint bank at a time rather than through the per-byte helpers, and a
+ *  FLASH page is only erased and written if its contents actually change.
+ *
  *  \param[in] Command  Single character AVR910 protocol command indicating what memory operation to perform
  */
 static void ReadWriteMemoryBlock(const uint8_t Command)
@@ -281,15 +311,14 @@ static void ReadWriteMemoryBlock(const uint8_t Command)
 	uint16_t BlockSize;
 	char     MemoryType;
 
-	bool     HighByte = false;
-	uint8_t  LowByte  = 0;
-
 	BlockSize  = (FetchNextCommandByte() << 8);
 	BlockSize |=  FetchNextCommandByte();
 
 	MemoryType =  FetchNextCommandByte();
 
-	if ((MemoryType != 'E') && (MemoryType != 'F'))
+	/* FLASH writes must fit in the page buffer, which is the block size reported by the 'b' command */
+	if (((MemoryType != 'E') && (MemoryType != 'F')) ||
+	    ((MemoryType == 'F') && (Command == 'B') && (BlockSize > SPM_PAGESIZE)))
 	{
 		/* Send error byte back to the host */
 		WriteNextResponseByte('?');
@@ -301,30 +330,20 @@ static void ReadWriteMemoryBlock(const uint8_t Command)
 	 * while doing SPM tasks */
 	TIMSK1 = 0;
 
+	/* Re-enable RWW section, both reads and the page comparison below need it */
+	boot_rww_enable();
+
 	/* Check if command is to read memory */
 	if (Command == 'g')
-	{		
-		/* Re-enable RWW section */
-		boot_rww_enable();
-
-		while (BlockSize--)
+	{
+		if (MemoryType == 'F')
 		{
-			if (MemoryType == 'F')
-			{
-				/* Read the next FLASH byte from the current FLASH page */
-				#if (FLASHEND > 0xFFFF)
-				WriteNextResponseByte(pgm_read_byte_far(CurrAddress | HighByte));
-				#else
-				WriteNextResponseByte(pgm_read_byte(CurrAddress | HighByte));
-				#endif
-
-				/* If both bytes in current word have been read, increment the address counter */
-				if (HighByte)
-				  CurrAddress += 2;
-
-				HighByte = !HighByte;
-			}
-			else
+			/* Send the FLASH data straight from the FLASH into the IN endpoint */
+			WriteFlashResponseBlock(BlockSize);
+		}
+		else
+		{
+			while (BlockSize--)
 			{
 				/* Read the next EEPROM byte into the endpoint */
 				WriteNextResponseByte(eeprom_read_byte((uint8_t*)(intptr_t)(CurrAddress >> 1)));
@@ -336,35 +355,62 @@ static void ReadWriteMemoryBlock(const uint8_t Command)
 	}
 	else
 	{
-		uint32_t PageStartAddress = CurrAddress;
-
 		if (MemoryType == 'F')
 		{
-			boot_page_erase(PageStartAddress);
-			boot_spm_busy_wait();
-		}
-
-		while (BlockSize--)
-		{
-			if (MemoryType == 'F')
+			uint32_t PageStartAddress = CurrAddress;
+			#if !defined(NO_PAGE_COMPARE)
+			bool     PageChanged      = false;
+			bool     PageNeedsErase   = false;
+			#else
+			const bool PageChanged    = true;
+			const bool PageNeedsErase = true;
+			#endif
+
+			/* The rest of a short block reads back as erased, as it did when every page was erased first */
+			memset(PageBuffer, 0xFF, sizeof(PageBuffer));
+			FetchNextCommandBlock(PageBuffer, BlockSize);
+
+			#if !defined(NO_PAGE_COMPARE)
+			/* Bits can only be programmed from 1 to 0, so the page needs erasing only if a bit goes the other way */
+			for (uint16_t i = 0; i < SPM_PAGESIZE; i++)
 			{
-				/* If both bytes in current word have been written, increment the address counter */
-				if (HighByte)
+				uint8_t OldByte = ReadFlashByte(PageStartAddress + i);
+
+				if (OldByte != PageBuffer[i])
 				{
-					/* Write the next FLASH word to the current FLASH page */
-					boot_page_fill(CurrAddress, ((FetchNextCommandByte() << 8) | LowByte));
+					PageChanged = true;
 
-					/* Increment the address counter after use */
-					CurrAddress += 2;
+					if ((OldByte & PageBuffer[i]) != PageBuffer[i])
+					  PageNeedsErase = true;
 				}
-				else
+			}
+			#endif
+
+			if (PageChanged)
+			{
+				if (PageNeedsErase)
 				{
-					LowByte = FetchNextCommandByte();
+					boot_page_erase(PageStartAddress);
+					boot_spm_busy_wait();
 				}
-				
-				HighByte = !HighByte;
+
+				/* Write the buffered data to the current FLASH page */
+				for (uint16_t i = 0; i < SPM_PAGESIZE; i += 2)
+				  boot_page_fill(PageStartAddress + i, (PageBuffer[i + 1] << 8) | PageBuffer[i]);
+
+				/* Commit the flash page to memory */
+				boot_page_write(PageStartAddress);
+
+				/* Wait until write operation has completed */
+				boot_spm_busy_wait();
 			}
-			else
+
+			/* Increment the address counter past the words written */
+			CurrAddress += (BlockSize & ~1);
+		}
+		else
+		{
+			while (BlockSize--)
 			{
 				/* Write the next EEPROM byte from the endpoint */
 				eeprom_write_byte((uint8_t*)((intptr_t)(CurrAddress >> 1)), FetchNextCommandByte());
@@ -374,16 +420,6 @@ static void ReadWriteMemoryBlock(const uint8_t Command)
 			}
 		}
 
-		/* If in FLASH programming mode, commit the page after writing */
-		if (MemoryType == 'F')
-		{
-			/* Commit the flash page to memory */
-			boot_page_write(PageStartAddress);
-
-			/* Wait until write operation has completed */
-			boot_spm_busy_wait();
-		}
-
 		/* Send response byte back to the host */
 		WriteNextResponseByte('\r');
 	}
@@ -391,6 +427,86 @@ static void ReadWriteMemoryBlock(const uint8_t Command)
 	/* Re-enable timer 1 interrupt disabled earlier in this routine */	
 	TIMSK1 = (1 << OCIE1A);
 }
+
+/** Reads a block of data from the host in the CDC data OUT endpoint, a whole endpoint bank at a time, clearing
+ *  each bank once it is empty to allow reception of the next data packet from the host.
+ *
+ *  \param[out] Buffer  Buffer to store the received data in
+ *  \param[in]  Length  Number of bytes to read
+ */
+static void FetchNextCommandBlock(uint8_t* Buffer, uint16_t Length)
+{
+	/* Select the OUT endpoint so the data can be read */
+	Endpoint_SelectEndpoint(CDC_RX_EPNUM);
+
+	while (Length)
+	{
+		/* If OUT endpoint empty, clear it and wait for the next packet from the host */
+		if (!(Endpoint_IsReadWriteAllowed()))
+		{
+			Endpoint_ClearOUT();
+
+			while (!(Endpoint_IsOUTReceived()))
+			{
+				if (USB_DeviceState == DEVICE_STATE_Unattached)
+				  return;
+			}
+
+			continue;
+		}
+
+		/* Take everything the bank holds, up to the end of the block */
+		uint16_t BankBytes = Endpoint_BytesInEndpoint();
+
+		if (BankBytes > Length)
+		  BankBytes = Length;
+
+		Length -= BankBytes;
+
+		while (BankBytes--)
+		  *(Buffer++) = Endpoint_Read_8();
+	}
+}
+
+/** Sends a block of FLASH data from the current address to the host in the CDC data IN endpoint, filling each
+ *  endpoint bank before sending it. The last bank is left for CDC_Task() to send.
+ *
+ *  \param[in] Length  Number of bytes to send
+ */
+static void WriteFlashResponseBlock(uint16_t Length)
+{
+	/* Select the IN endpoint so the data can be written */
+	Endpoint_SelectEndpoint(CDC_TX_EPNUM);
+
+	while (Length)
+	{
+		/* If IN endpoint full, clear it and wait until ready for the next packet to the host */
+		if (!(Endpoint_IsReadWriteAllowed()))
+		{
+			Endpoint_ClearIN();
+
+			while (!(Endpoint_IsINReady()))
+			{
+				if (USB_DeviceState == DEVICE_STATE_Unattached)
+				  return;
+			}
+		}
+
+		/* Fill the free space in the bank, up to the end of the block */
+		uint16_t BankBytes = CDC_TXRX_EPSIZE - Endpoint_BytesInEndpoint();
+
+		if (BankBytes > Length)
+		  BankBytes = Length;
+
+		Length -= BankBytes;
+
+		while (BankBytes--)
+		  Endpoint_Write_8(ReadFlashByte(CurrAddress++));
+	}
+
+	TX_LED_ON();
+	TxLEDPulse = TX_RX_LED_PULSE_PERIOD;
+}
 #endif
 
 /** Retrieves the next byte from the host in the CDC data OUT endpoint, and clears the endpoint bank if needed
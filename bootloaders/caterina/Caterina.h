@@ -43,7 +43,9 @@
 		#include <avr/eeprom.h>
 		#include <avr/power.h>
 		#include <avr/interrupt.h>
+		#include <util/delay.h>
 		#include <stdbool.h>
+		#include <string.h>
 
 		#include "Descriptors.h"
 
@@ -97,6 +99,8 @@
 		#if defined(INCLUDE_FROM_CATERINA_C) || defined(__DOXYGEN__)
 			#if !defined(NO_BLOCK_SUPPORT)
 			static void    ReadWriteMemoryBlock(const uint8_t Command);
+			static void    FetchNextCommandBlock(uint8_t* Buffer, uint16_t Length);
+			static void    WriteFlashResponseBlock(uint16_t Length);
 			#endif
 			static uint8_t FetchNextCommandByte(void);
 			static void    WriteNextResponseByte(const uint8_t Response);
@@ -101,8 +101,12 @@
 		/** Endpoint number for the CDC data interface RX (data OUT) endpoint. */
 		#define CDC_RX_EPNUM                   4
 
-		/** Size of the CDC data interface TX and RX data endpoint banks, in bytes. */
-		#define CDC_TXRX_EPSIZE                16
+		/** Size of the CDC data interface TX and RX data endpoint banks, in bytes. Set to 16 in BOOT_OPTIONS
+		 *  to go back to the old endpoint size, which takes less code to set up.
+		 */
+		#if !defined(CDC_TXRX_EPSIZE)
+			#define CDC_TXRX_EPSIZE            64
+		#endif
 
 		/** Size of the CDC control interface notification endpoint bank, in bytes. */
 		#define CDC_NOTIFICATION_EPSIZE        8
@@ -113,6 +113,32 @@
 /* Bootloader timeout period, in milliseconds.            */
 /* 500,1000,2000,4000,8000 supported.                     */
 /*                                                        */
+/* SKIP_UNCHANGED:                                        */
+/* Compare each page with the flash and leave it alone if */
+/* it is the same, so re-uploading a mostly unchanged     */
+/* sketch skips most erases and writes. On with BIG_BOOT. */
+/*                                                        */
+/* SUPPORT_CRC:                                           */
+/* Add STK_CRC_FLASH, which returns the CRC of a range of */
+/* flash, to check an upload without reading it back. On  */
+/* with BIG_BOOT.                                         */
+/*                                                        */
+/* SUPPORT_RLE:                                           */
+/* Add STK_PROG_PAGE_RLE, STK_PROG_PAGE with run-length   */
+/* coded data, for slow links. On with BIG_BOOT.          */
+/*                                                        */
+/* AUTOBAUD:                                              */
+/* Time avrdude's first sync byte instead of using        */
+/* BAUD_RATE, for any programming rate from F_CPU/506 to  */
+/* F_CPU/8 (31620 to 2M baud at 16MHz). Hardware UART     */
+/* only, and not with LED_START_FLASHES.                  */
+/*                                                        */
+/* APP_SPM:                                               */
+/* Let the application erase and write its own flash      */
+/* pages by calling do_spm() in the bootloader, since SPM */
+/* only works from the boot section. Costs about 30       */
+/* bytes, so in 512 bytes it needs LED_START_FLASHES=0.   */
+/*                                                        */
 /**********************************************************/
 
 /**********************************************************/
@@ -132,6 +158,10 @@
 /**********************************************************/
 /* Edit History:					  */
 /*							  */
+/* 4.5 Add the APP_SPM do_spm() entry at the second word  */
+/*             of the bootloader.  Add AUTOBAUD.          */
+/*             Add SKIP_UNCHANGED, SUPPORT_CRC and        */
+/*             SUPPORT_RLE.                               */
 /* 4.4 WestfW: add initialization of address to keep      */
 /*             the compiler happy.  Change SC'ed targets. */
 /*             Return the SW version via READ PARAM       */
@@ -144,7 +174,7 @@
 /**********************************************************/
 
 #define OPTIBOOT_MAJVER 4
-#define OPTIBOOT_MINVER 4
+#define OPTIBOOT_MINVER 5
 
 #define MAKESTR(a) #a
 #define MAKEVER(a, b) MAKESTR(a*256+b)
@@ -167,6 +197,16 @@ asm("  .section .version\n"
 #include "pin_defs.h"
 #include "stk500.h"
 
+#if defined(BIG_BOOT) || defined(BIGBOOT)
+#define SKIP_UNCHANGED
+#define SUPPORT_CRC
+#define SUPPORT_RLE
+#endif
+
+#ifdef SUPPORT_CRC
+#include <util/crc16.h>
+#endif
+
 #ifndef LED_START_FLASHES
 #define LED_START_FLASHES 0
 #endif
@@ -188,8 +228,14 @@ asm("  .section .version\n"
 #endif
 #endif
 
+#ifdef AUTOBAUD
+#if defined(SOFT_UART) || LED_START_FLASHES > 0
+#error AUTOBAUD needs the hardware UART and LED_START_FLASHES=0
+#endif
+#endif
+
 /* Switch in soft UART for hard baud rates */
-#if (F_CPU/BAUD_RATE) > 280 // > 57600 for 16MHz
+#if (F_CPU/BAUD_RATE) > 280 && !defined(AUTOBAUD) // > 57600 for 16MHz
 #ifndef SOFT_UART
 #define SOFT_UART
 #endif
@@ -227,6 +273,11 @@ void watchdogConfig(uint8_t x);
 void uartDelay() __attribute__ ((naked));
 #endif
 void appStart() __attribute__ ((naked));
+static inline uint8_t flash_byte(uint16_t);
+#ifdef APP_SPM
+void pre_main(void) __attribute__ ((naked)) __attribute__ ((section (".init8")));
+void do_spm(void) __attribute__ ((naked)) __attribute__ ((used));
+#endif
 
 #if defined(__AVR_ATmega168__)
 #define RAMSTART (0x100)
@@ -257,6 +308,21 @@ void appStart() __attribute__ ((naked));
 #define wdtVect (*(uint16_t*)(RAMSTART+SPM_PAGESIZE*2+6))
 #endif
 
+#ifdef APP_SPM
+/*
+ * .init8 comes right before main, at the very start of the bootloader.
+ * This puts "rjmp do_spm" at a fixed place, the second word, for the
+ * application to call, whatever the size of the code before do_spm.
+ */
+void pre_main(void) {
+  asm volatile (
+    "  rjmp 1f\n"
+    "  rjmp do_spm\n"
+    "1:\n"
+  );
+}
+#endif
+
 /* main program starts here */
 int main(void) {
   uint8_t ch;
@@ -293,23 +359,49 @@ int main(void) {
   // Set up Timer 1 for timeout counter
   TCCR1B = _BV(CS12) | _BV(CS10); // div 1024
 #endif
+  // Set up watchdog to trigger after 500ms
+  watchdogConfig(WATCHDOG_1S);
+
+#ifdef AUTOBAUD
+  /*
+   * avrdude starts with STK_GET_SYNC, '0' (0x30). On the line that is
+   * the start bit and bits 0-3 low, bits 4-5 high, bits 6-7 low and the
+   * stop bit high, so the rising edges at bit 4 and at the stop bit are
+   * 4 bit times apart, which with Timer 1 at F_CPU/8 is as many ticks
+   * as half the cycles of a bit; a quarter of that is the double speed
+   * UBRR + 1. The count is kept in 8 bits to save code, so it must stay
+   * below 254 (ch + 2 wraps from there), which sets the lowest rate at
+   * about F_CPU/506. The USART receiver is still off, so it never sees
+   * this byte.
+   * The watchdog is already running, so no host means the app starts.
+   */
+  TCCR1B = _BV(CS11);
+  while (UART_PIN & _BV(UART_RX_BIT));     // start bit
+  while (!(UART_PIN & _BV(UART_RX_BIT)));  // bit 4
+  ch = TCNT1L;
+  while (UART_PIN & _BV(UART_RX_BIT));     // bit 6
+  while (!(UART_PIN & _BV(UART_RX_BIT)));  // stop bit
+  ch = TCNT1L - ch;
+  ch = (uint8_t)(ch + 2) / 4 - 1;
+#define UBRR_VALUE ch
+#else
+#define UBRR_VALUE (uint8_t)( (F_CPU + BAUD_RATE * 4L) / (BAUD_RATE * 8L) - 1 )
+#endif
+
 #ifndef SOFT_UART
 #ifdef __AVR_ATmega8__
   UCSRA = _BV(U2X); //Double speed mode USART
   UCSRB = _BV(RXEN) | _BV(TXEN);  // enable Rx & Tx
   UCSRC = _BV(URSEL) | _BV(UCSZ1) | _BV(UCSZ0);  // config USART; 8N1
-  UBRRL = (uint8_t)( (F_CPU + BAUD_RATE * 4L) / (BAUD_RATE * 8L) - 1 );
+  UBRRL = UBRR_VALUE;
 #else
   UCSR0A = _BV(U2X0); //Double speed mode USART0
   UCSR0B = _BV(RXEN0) | _BV(TXEN0);
   UCSR0C = _BV(UCSZ00) | _BV(UCSZ01);
-  UBRR0L = (uint8_t)( (F_CPU + BAUD_RATE * 4L) / (BAUD_RATE * 8L) - 1 );
+  UBRR0L = UBRR_VALUE;
 #endif
 #endif
 
-  // Set up watchdog to trigger after 500ms
-  watchdogConfig(WATCHDOG_1S);
-
   /* Set LED pin as output */
   LED_DDR |= _BV(LED);
 
@@ -323,6 +415,15 @@ int main(void) {
   flash_led(LED_START_FLASHES * 2);
 #endif
 
+#ifdef AUTOBAUD
+  /*
+   * The receiver may come up in the middle of the CRC_EOP after the sync
+   * byte, or the next one, so drop everything up to a good CRC_EOP.
+   * avrdude sends a few syncs without waiting for an answer anyway.
+   */
+  while (getch() != CRC_EOP);
+#endif
+
   /* Forever loop */
   for (;;) {
     /* get character from UART */
@@ -373,7 +474,11 @@ int main(void) {
       putch(0x00);
     }
     /* Write memory, length is big endian and is in bytes */
+#ifdef SUPPORT_RLE
+    else if(ch == STK_PROG_PAGE || ch == STK_PROG_PAGE_RLE) {
+#else
     else if(ch == STK_PROG_PAGE) {
+#endif
       // PROGRAM PAGE - we support flash programming only, not EEPROM
       uint8_t *bufPtr;
       uint16_t addrPtr;
@@ -382,17 +487,42 @@ int main(void) {
       length = getch();
       getch();
 
+#ifndef SKIP_UNCHANGED
       // If we are in RWW section, immediately start page erase
       if (address < NRWWSTART) __boot_page_erase_short((uint16_t)(void*)address);
+#endif
 
       // While that is going on, read in page contents
       bufPtr = buff;
+#ifdef SUPPORT_RLE
+      if (ch == STK_PROG_PAGE_RLE) {
+        // PackBits coded, until length bytes (0 is 256) have come out:
+        // n < 0x80 is followed by n+1 bytes, n > 0x80 by one byte to
+        // repeat 257-n times. A run is cut off at the end of the page;
+        // the bytes of it left in a bad stream then fail verifySpace().
+        uint8_t *bufEnd = buff + (uint8_t)(length - 1) + 1;
+        do {
+          uint8_t count = getch();
+          if (count & 0x80) {
+            uint8_t b = getch();
+            count = -count;
+            do *bufPtr++ = b;
+            while (count-- && bufPtr < bufEnd);
+          } else {
+            do *bufPtr++ = getch();
+            while (count-- && bufPtr < bufEnd);
+          }
+        } while (bufPtr < bufEnd);
+      } else
+#endif
       do *bufPtr++ = getch();
       while (--length);
 
+#ifndef SKIP_UNCHANGED
       // If we are in NRWW section, page erase has to be delayed until now.
       // Todo: Take RAMPZ into account
       if (address >= NRWWSTART) __boot_page_erase_short((uint16_t)(void*)address);
+#endif
 
       // Read command terminator, start reply
       verifySpace();
@@ -420,6 +550,22 @@ int main(void) {
       }
 #endif
 
+#ifdef SKIP_UNCHANGED
+      // If the flash already holds this page, we're done. Otherwise erase
+      // it now; it couldn't start in the background, as the flash can't
+      // be read while it runs.
+      {
+        uint8_t *bufEnd = bufPtr;
+        bufPtr = buff;
+        addrPtr = (uint16_t)(void*)address;
+        while (flash_byte(addrPtr++) == *bufPtr) {
+          if (++bufPtr == bufEnd) goto page_done;
+        }
+      }
+      __boot_page_erase_short((uint16_t)(void*)address);
+      boot_spm_busy_wait();
+#endif
+
       // Copy buffer into programming buffer
       bufPtr = buff;
       addrPtr = (uint16_t)(void*)address;
@@ -441,6 +587,9 @@ int main(void) {
       boot_rww_enable();
 #endif
 
+#ifdef SKIP_UNCHANGED
+    page_done:;
+#endif
     }
     /* Read memory block mode, length is big endian.  */
     else if(ch == STK_READ_PAGE) {
@@ -479,6 +628,25 @@ int main(void) {
 #endif
     }
 
+#ifdef SUPPORT_CRC
+    /*
+     * CRC of the flash from the loaded address on, an optiboot extension.
+     * The length is big endian and in bytes, 0 meaning 64K; the reply is
+     * the CRC-16/XMODEM (polynomial 0x1021, starting from 0), low byte
+     * first.
+     */
+    else if(ch == STK_CRC_FLASH) {
+      uint16_t crc = 0;
+      uint16_t count = getch() << 8;
+      count |= getch();
+      verifySpace();
+      do crc = _crc_xmodem_update(crc, flash_byte(address++));
+      while (--count);
+      putch(crc & 0xff);
+      putch(crc >> 8);
+    }
+#endif
+
     /* Get device signature bytes  */
     else if(ch == STK_READ_SIGN) {
       // READ SIGN - return what Avrdude wants to hear
@@ -643,6 +811,16 @@ void flash_led(uint8_t count) {
 }
 #endif
 
+uint8_t flash_byte(uint16_t address) {
+#ifdef __AVR_ATmega1280__
+  uint8_t result;
+  __asm__ ("elpm %0,Z\n":"=r"(result):"z"(address));
+  return result;
+#else
+  return pgm_read_byte_near(address);
+#endif
+}
+
 // Watchdog functions. These are only safe with interrupts turned off.
 void watchdogReset() {
   __asm__ __volatile__ (
@@ -655,6 +833,41 @@ void watchdogConfig(uint8_t x) {
   WDTCSR = x;
 }
 
+#ifdef APP_SPM
+/*
+ * do_spm(uint16_t address, uint8_t command, uint16_t data), called by
+ * the application with interrupts off: runs SPM with command in SPMCSR,
+ * address in Z and data in r1:r0, and waits for it to finish.  After a
+ * page erase or write, the RWW section is made readable again, so the
+ * application can carry on; a fill leaves the page buffer alone.
+ * For addresses past 64K, the caller sets RAMPZ.
+ */
+void do_spm(void) {
+  __asm__ __volatile__ (
+    "   movw r30,r24\n"           // Z = address
+    "   movw r0,r20\n"            // r1:r0 = data
+    "1: out %[spmReg],r22\n"
+    "   spm\n"
+    "2: in r0,%[spmReg]\n"        // wait for SPM to finish
+    "   sbrc r0,%[spmEnable]\n"
+    "   rjmp 2b\n"
+#if defined(RWWSRE)
+    "   andi r22,%[eraseWrite]\n"
+    "   breq 3f\n"
+    "   ldi r22,%[rwwEnable]\n"   // once more, to re-enable RWW
+    "   rjmp 1b\n"
+#endif
+    "3: clr __zero_reg__\n"
+    "   ret\n"
+    ::
+      [spmReg] "I" (_SFR_IO_ADDR(__SPM_REG)),
+      [spmEnable] "I" (__SPM_ENABLE),
+      [eraseWrite] "M" (_BV(PGERS) | _BV(PGWRT)),
+      [rwwEnable] "M" (__BOOT_RWW_ENABLE)
+  );
+}
+#endif
+
 void appStart() {
   watchdogConfig(WATCHDOG_OFF);
   __asm__ __volatile__ (
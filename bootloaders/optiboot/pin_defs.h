@@ -5,8 +5,8 @@
 #define LED_PIN     PINB
 #define LED         PINB5
 
-/* Ports for soft UART */
-#ifdef SOFT_UART
+/* Ports for soft UART, RX pin for AUTOBAUD */
+#if defined(SOFT_UART) || defined(AUTOBAUD)
 #define UART_PORT   PORTD
 #define UART_PIN    PIND
 #define UART_DDR    DDRD
@@ -51,8 +51,8 @@
 #define LED_PIN     PINB
 #define LED         PINB0
 
-/* Ports for soft UART */
-#ifdef SOFT_UART
+/* Ports for soft UART, RX pin for AUTOBAUD */
+#if defined(SOFT_UART) || defined(AUTOBAUD)
 #define UART_PORT   PORTD
 #define UART_PIN    PIND
 #define UART_DDR    DDRD
@@ -69,8 +69,8 @@
 #define LED_PIN     PINB
 #define LED         PINB7
 
-/* Ports for soft UART */
-#ifdef SOFT_UART
+/* Ports for soft UART, RX pin for AUTOBAUD */
+#if defined(SOFT_UART) || defined(AUTOBAUD)
 #define UART_PORT   PORTE
 #define UART_PIN    PINE
 #define UART_DDR    DDRE
@@ -37,3 +37,7 @@
 #define STK_READ_OSCCAL     0x76  // 'v'
 #define STK_READ_FUSE_EXT   0x77  // 'w'
 #define STK_READ_OSCCAL_EXT 0x78  // 'x'
+
+/* optiboot extensions */
+#define STK_PROG_PAGE_RLE   0x79  // 'y'
+#define STK_CRC_FLASH       0x7A  // 'z'
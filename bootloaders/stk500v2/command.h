@@ -76,6 +76,14 @@
 #define CMD_READ_SIGNATURE_HVSP             0x3B
 #define CMD_READ_OSCCAL_HVSP                0x3C
 
+// *****************[ Bootloader extensions, not in AVR068 ]********************
+
+// Same as CMD_PROGRAM_FLASH_ISP, but the data after the 10 byte header is
+// run-length coded (PackBits): a byte n of 0x00..0x7F is followed by n+1
+// literal bytes, a byte n of 0x81..0xFF by one byte to repeat 257-n times.
+// 0x80 is not used. Bytes 1 and 2 still give the number of bytes to program.
+#define CMD_PROGRAM_FLASH_RLE               0x70
+
 // *****************[ STK status constants ]***************************
 
 // Success
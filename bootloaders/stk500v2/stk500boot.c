@@ -86,6 +86,10 @@ LICENSE:
 //*	Jan  1,	2012	<MLS> Issue 543: CMD_CHIP_ERASE_ISP now returns STATUS_CMD_FAILED instead of STATUS_CMD_OK
 //*	Jan  1,	2012	<MLS> Issue 543: Write EEPROM now does something (NOT TESTED)
 //*	Jan  1,	2012	<MLS> Issue 544: stk500v2 bootloader doesn't support reading fuses
+//*	Oct 14,	2026	Flash pages are programmed while the next message is received
+//*	Oct 14,	2026	UBRR high byte is set, baud rate error is checked at compile time
+//*	Oct 14,	2026	Added CMD_PROGRAM_FLASH_RLE for run-length coded flash pages
+//*	Oct 14,	2026	Added do_spm() for the sketch and staged updates past 128K
 //************************************************************************
 
 //************************************************************************
@@ -111,6 +115,10 @@ LICENSE:
 #include	<stdlib.h>
 #include	"command.h"
 
+#if (FLASHEND > 0x1FFFF) && !defined(REMOVE_STAGED_UPDATE)
+	#define		ENABLE_STAGED_UPDATE
+	#include	<util/crc16.h>
+#endif
 
 #if defined(_MEGA_BOARD_) || defined(_BOARD_AMBER128_) || defined(__AVR_ATmega1280__) || defined(__AVR_ATmega2560__) \
 	|| defined(__AVR_ATmega2561__) || defined(__AVR_ATmega1284P__) || defined(ENABLE_MONITOR)
@@ -136,6 +144,9 @@ LICENSE:
 //#define	REMOVE_PROGRAM_LOCK_BIT_SUPPORT		// disable program lock bits
 //#define	REMOVE_BOOTLOADER_LED				// no LED to show active bootloader
 //#define	REMOVE_CMD_SPI_MULTI				// disable processing of SPI_MULTI commands, Remark this line for AVRDUDE <Worapoht>
+//#define	REMOVE_FLASH_RLE_SUPPORT			// disable CMD_PROGRAM_FLASH_RLE, run-length coded flash pages
+//#define	REMOVE_STAGED_UPDATE				// disable do_spm() and staged updates (past 128K only)
+//#define	REMOVE_OVERLAPPED_FLASH_WRITE		// write each page before answering, see flash_poll()
 //
 
 
@@ -313,6 +324,7 @@ LICENSE:
 
 #if defined(_BOARD_ROBOTX_) || defined(__AVR_AT90USB1287__) || defined(__AVR_AT90USB1286__)
 	#define	UART_BAUD_RATE_LOW			UBRR1L
+	#define	UART_BAUD_RATE_HIGH			UBRR1H
 	#define	UART_STATUS_REG				UCSR1A
 	#define	UART_CONTROL_REG			UCSR1B
 	#define	UART_ENABLE_TRANSMITTER		TXEN1
@@ -326,6 +338,7 @@ LICENSE:
 	|| defined(__AVR_ATmega8515__) || defined(__AVR_ATmega8535__)
 	/* ATMega8 with one USART */
 	#define	UART_BAUD_RATE_LOW			UBRRL
+	#define	UART_BAUD_RATE_HIGH			UBRRH
 	#define	UART_STATUS_REG				UCSRA
 	#define	UART_CONTROL_REG			UCSRB
 	#define	UART_ENABLE_TRANSMITTER		TXEN
@@ -339,6 +352,7 @@ LICENSE:
 	 || defined(__AVR_ATmega1280__) || defined(__AVR_ATmega2560__) || defined(__AVR_ATmega2561__)
 	/* ATMega with two USART, use UART0 */
 	#define	UART_BAUD_RATE_LOW			UBRR0L
+	#define	UART_BAUD_RATE_HIGH			UBRR0H
 	#define	UART_STATUS_REG				UCSR0A
 	#define	UART_CONTROL_REG			UCSR0B
 	#define	UART_ENABLE_TRANSMITTER		TXEN0
@@ -350,6 +364,7 @@ LICENSE:
 #elif defined(UBRR0L) && defined(UCSR0A) && defined(TXEN0)
 	/* ATMega with two USART, use UART0 */
 	#define	UART_BAUD_RATE_LOW			UBRR0L
+	#define	UART_BAUD_RATE_HIGH			UBRR0H
 	#define	UART_STATUS_REG				UCSR0A
 	#define	UART_CONTROL_REG			UCSR0B
 	#define	UART_ENABLE_TRANSMITTER		TXEN0
@@ -361,6 +376,7 @@ LICENSE:
 #elif defined(UBRRL) && defined(UCSRA) && defined(UCSRB) && defined(TXEN) && defined(RXEN)
 	//* catch all
 	#define	UART_BAUD_RATE_LOW			UBRRL
+	#define	UART_BAUD_RATE_HIGH			UBRRH
 	#define	UART_STATUS_REG				UCSRA
 	#define	UART_CONTROL_REG			UCSRB
 	#define	UART_ENABLE_TRANSMITTER		TXEN
@@ -388,6 +404,24 @@ LICENSE:
 	#define UART_BAUD_SELECT(baudRate,xtalCpu) (((float)(xtalCpu))/(((float)(baudRate))*16.0)-1.0+0.5)
 #endif
 
+/*
+ * Check the baud rate the divisor really gives, a host more than about 3% off won't sync
+ */
+#if !defined(__AVR_ATmega32__)
+	#if UART_BAUDRATE_DOUBLE_SPEED
+		#define UART_BAUD_DIVISOR	8
+	#else
+		#define UART_BAUD_DIVISOR	16
+	#endif
+	#define UART_BAUD_UBRR		(((F_CPU) + (UART_BAUD_DIVISOR * (BAUDRATE)) / 2) / (UART_BAUD_DIVISOR * (BAUDRATE)) - 1)
+	#define UART_BAUD_REAL		((F_CPU) / (UART_BAUD_DIVISOR * (UART_BAUD_UBRR + 1)))
+	#if (UART_BAUD_UBRR > 4095)
+		#error "BAUDRATE is too low for this F_CPU"
+	#elif (UART_BAUD_REAL * 100 > (BAUDRATE) * 103) || (UART_BAUD_REAL * 100 < (BAUDRATE) * 97)
+		#warning "BAUDRATE can't be matched within 3% at this F_CPU"
+	#endif
+#endif
+
 
 /*
  * States used in the receive state machine
@@ -491,6 +525,48 @@ static unsigned char recchar(void)
 	return UART_DATA_REG;
 }
 
+//*****************************************************************************
+/*
+ * Overlapped flash programming. CMD_PROGRAM_FLASH_ISP only fills the page
+ * buffer and starts the page erase, then answers. The page write and the
+ * re-enabling of the RWW section follow from flash_poll() while the next
+ * message is being received into msgBuffer, so the SPM page buffer and
+ * msgBuffer work as a double buffer. flash_finish() completes it all before
+ * anything else touches the flash.
+ */
+#define	FLASH_IDLE		0
+#define	FLASH_ERASING	1
+#define	FLASH_WRITING	2
+
+static unsigned char	flashState	=	FLASH_IDLE;
+static address_t		flashPage;
+
+static void flash_poll(void)
+{
+	if ((flashState == FLASH_IDLE) || boot_spm_busy())
+	{
+		return;
+	}
+	if (flashState == FLASH_ERASING)
+	{
+		boot_page_write(flashPage);		// the erase is done, write the filled page buffer
+		flashState	=	FLASH_WRITING;
+	}
+	else
+	{
+		boot_rww_enable();				// Re-enable the RWW section
+		flashState	=	FLASH_IDLE;
+	}
+}
+
+static void flash_finish(void)
+{
+	while (flashState != FLASH_IDLE)
+	{
+		flash_poll();
+	}
+}
+
 #define	MAX_TIME_COUNT	(F_CPU >> 1)
 //*****************************************************************************
 static unsigned char recchar_timeout(void)
@@ -500,10 +576,13 @@ uint32_t count = 0;
 	while (!(UART_STATUS_REG & (1 << UART_RECEIVE_COMPLETE)))
 	{
 		// wait for data
+		flash_poll();
 		count++;
 		if (count > MAX_TIME_COUNT)
 		{
 		unsigned int	data;
+
+			flash_finish();
 		#if (FLASHEND > 0x10000)
 			data	=	pgm_read_word_far(0);	//*	get the first word of the user program
 		#else
@@ -526,6 +605,109 @@ uint32_t count = 0;
 //*	for watch dog timer startup
 void (*app_start)(void) = 0x0000;
 
+#ifdef ENABLE_STAGED_UPDATE
+//*****************************************************************************
+/*
+ * do_spm(uint16_t address, uint8_t command, uint16_t data) for the sketch,
+ * as with optiboot's APP_SPM: runs SPM with command in SPMCSR, address in Z
+ * (the caller sets RAMPZ) and data in r1:r0, waits for it to finish, and
+ * re-enables the RWW section after an erase or write. It is the INT0 vector
+ * of the bootloader's own table, 4 bytes into the boot section, so it stays
+ * there whatever else changes; the bootloader never enables INT0.
+ */
+ISR(INT0_vect, ISR_NAKED)
+{
+	__asm__ __volatile__ (
+		"	movw r30,r24		\n\t"	// Z = address
+		"	movw r0,r20			\n\t"	// r1:r0 = data
+		"1:	out %[spmReg],r22	\n\t"
+		"	spm					\n\t"
+		"2:	in r0,%[spmReg]		\n\t"	// wait for SPM to finish
+		"	sbrc r0,%[spmEnable]	\n\t"
+		"	rjmp 2b				\n\t"
+		"	andi r22,%[eraseWrite]	\n\t"
+		"	breq 3f				\n\t"
+		"	ldi r22,%[rwwEnable]	\n\t"	// once more, to re-enable RWW
+		"	rjmp 1b				\n\t"
+		"3:	clr __zero_reg__	\n\t"
+		"	ret					\n\t"
+		::
+		[spmReg]		"I" (_SFR_IO_ADDR(__SPM_REG)),
+		[spmEnable]		"I" (__SPM_ENABLE),
+		[eraseWrite]	"M" (_BV(PGERS) | _BV(PGWRT)),
+		[rwwEnable]		"M" (__BOOT_RWW_ENABLE)
+	);
+}
+
+//*****************************************************************************
+/*
+ * Fail-safe updates, see flashUpdateCommit() in the core's wiring_flash.c.
+ * While it runs, the sketch writes a new image to the upper half of the
+ * flash, then a descriptor to the page below the 8K bootloader: 0x5AA5,
+ * the image length (4 bytes) and its CRC-16/XMODEM, little endian.
+ * At the next reset a valid descriptor gets the image copied to address 0,
+ * and the descriptor is erased once it is all there. A reset during the
+ * copy starts it over from the untouched staged image; a missing or bad
+ * descriptor leaves the running sketch alone.
+ */
+#define	UPDATE_BOOTLOADER_SIZE	8192
+#define	UPDATE_START			((address_t)(FLASHEND + 1) / 2)
+#define	UPDATE_DESCRIPTOR		((address_t)(FLASHEND + 1) - UPDATE_BOOTLOADER_SIZE - SPM_PAGESIZE)
+#define	UPDATE_MAGIC			0x5AA5
+
+static void apply_staged_update(void)
+{
+	address_t	length;
+	address_t	offset;
+	uint16_t	crc	=	0;
+
+	if (pgm_read_word_far(UPDATE_DESCRIPTOR) != UPDATE_MAGIC)
+	{
+		return;
+	}
+
+	length	=	pgm_read_dword_far(UPDATE_DESCRIPTOR + 2);
+	if (length > (UPDATE_DESCRIPTOR - UPDATE_START))
+	{
+		length	=	0;
+	}
+	for (offset = 0; offset < length; offset++)
+	{
+		crc	=	_crc_xmodem_update(crc, pgm_read_byte_far(UPDATE_START + offset));
+	}
+
+	if (length && (crc == pgm_read_word_far(UPDATE_DESCRIPTOR + 6)))
+	{
+	#ifndef REMOVE_BOOTLOADER_LED
+		PROGLED_DDR		|=	(1<<PROGLED_PIN);
+	#endif
+		for (offset = 0; offset < length; offset += SPM_PAGESIZE)
+		{
+			unsigned int	ii;
+
+			// fill the page buffer while the staged page can still be read
+			for (ii = 0; ii < SPM_PAGESIZE; ii += 2)
+			{
+				boot_page_fill(offset + ii, pgm_read_word_far(UPDATE_START + offset + ii));
+			}
+			boot_page_erase(offset);
+			boot_spm_busy_wait();
+			boot_page_write(offset);
+			boot_spm_busy_wait();
+			boot_rww_enable();
+		#ifndef REMOVE_BOOTLOADER_LED
+			PROGLED_PORT	^=	(1<<PROGLED_PIN);
+		#endif
+		}
+	}
+
+	// done with it, or it was no good
+	boot_page_erase(UPDATE_DESCRIPTOR);
+	boot_spm_busy_wait();
+	boot_rww_enable();
+}
+#endif
+
 
 //*****************************************************************************
 int main(void)
@@ -569,6 +751,10 @@ int main(void)
 	WDTCSR	|=	_BV(WDCE) | _BV(WDE);
 	WDTCSR	=	0;
 	__asm__ __volatile__ ("sei");
+#ifdef ENABLE_STAGED_UPDATE
+	// with the watchdog off, as the copy takes seconds
+	apply_staged_update();
+#endif
 	// check if WDT generated the reset, if so, go straight to app
 	if (mcuStatusReg & _BV(WDRF))
 	{
@@ -615,6 +801,9 @@ int main(void)
 	 */
 #if UART_BAUDRATE_DOUBLE_SPEED
 	UART_STATUS_REG		|=	(1 <<UART_DOUBLE_SPEED);
+#endif
+#ifdef UART_BAUD_RATE_HIGH
+	UART_BAUD_RATE_HIGH	=	((unsigned int)UART_BAUD_SELECT(BAUDRATE,F_CPU)) >> 8;
 #endif
 	UART_BAUD_RATE_LOW	=	UART_BAUD_SELECT(BAUDRATE,F_CPU);
 	UART_CONTROL_REG	=	(1 << UART_ENABLE_RECEIVER) | (1 << UART_ENABLE_TRANSMITTER);
@@ -691,6 +880,7 @@ int main(void)
 					exPointCntr++;
 					if (exPointCntr == 3)
 					{
+						flash_finish();
 						RunMonitor();
 						exPointCntr		=	0;	//	reset back to zero so we dont get in an endless loop
 						isLeave			=	1;
@@ -782,7 +972,9 @@ int main(void)
 
 			/*
 			 * Now process the STK500 commands, see Atmel Appnote AVR068
+			 * The last flash page must be finished first
 			 */
+			flash_finish();
 
 			switch (msgBuffer[0])
 			{
@@ -983,25 +1175,75 @@ int main(void)
 
 				case CMD_PROGRAM_FLASH_ISP:
 				case CMD_PROGRAM_EEPROM_ISP:
+	#ifndef REMOVE_FLASH_RLE_SUPPORT
+				case CMD_PROGRAM_FLASH_RLE:
+	#endif
 					{
 						unsigned int	size	=	((msgBuffer[1])<<8) | msgBuffer[2];
 						unsigned char	*p	=	msgBuffer+10;
 						unsigned int	data;
 						unsigned char	highByte, lowByte;
 						address_t		tempaddress	=	address;
+						unsigned char	status		=	STATUS_CMD_OK;
 
 
-						if ( msgBuffer[0] == CMD_PROGRAM_FLASH_ISP )
+	#ifndef REMOVE_FLASH_RLE_SUPPORT
+						if ( msgBuffer[0] == CMD_PROGRAM_FLASH_RLE )
 						{
-							// erase only main section (bootloader protection)
-							if (eraseAddress < APP_END )
+							/* Decode into the page buffer, see CMD_PROGRAM_FLASH_RLE in command.h */
+							unsigned char	*end	=	msgBuffer + msgLength;
+							unsigned char	odd		=	0;
+
+							lowByte	=	0;
+							while (size && (p < end))
 							{
-								boot_page_erase(eraseAddress);	// Perform page erase
-								boot_spm_busy_wait();		// Wait until the memory is erased.
-								eraseAddress += SPM_PAGESIZE;	// point to next page to be erase
+								unsigned char	count	=	*p++;
+								unsigned char	repeat	=	count & 0x80;
+
+								if (repeat)
+								{
+									count	=	-count;			// one less than the repeats
+								}
+								do {
+									highByte	=	*p;
+									if (!repeat)
+									{
+										p++;
+									}
+									if (odd)
+									{
+										boot_page_fill(address, (highByte << 8) | lowByte);
+										address	=	address + 2;	// Select next word in memory
+									}
+									lowByte	=	highByte;
+									odd		^=	1;
+									size--;
+								} while (count-- && size);
+								if (count != 0xFF)
+								{
+									/* the run goes past the end of the block */
+									status	=	STATUS_CMD_FAILED;
+									break;
+								}
+								if (repeat)
+								{
+									p++;
+								}
 							}
-
-							/* Write FLASH */
+							/* the stream must expand to exactly the block, with nothing left over */
+							if ((status != STATUS_CMD_OK) || size || odd || (p != end))
+							{
+								/* Bad data, clear the page buffer and leave the flash alone */
+								boot_rww_enable();
+								address	=	tempaddress;
+								status	=	STATUS_CMD_FAILED;
+							}
+						}
+						else
+	#endif
+						if ( msgBuffer[0] == CMD_PROGRAM_FLASH_ISP )
+						{
+							/* Fill the page buffer first, the erase leaves it alone */
 							do {
 								lowByte		=	*p++;
 								highByte 	=	*p++;
@@ -1012,10 +1254,6 @@ int main(void)
 								address	=	address + 2;	// Select next word in memory
 								size	-=	2;				// Reduce number of bytes to write by two
 							} while (size);					// Loop until all bytes written
-
-							boot_page_write(tempaddress);
-							boot_spm_busy_wait();
-							boot_rww_enable();				// Re-enable the RWW section
 						}
 						else
 						{
@@ -1029,8 +1267,29 @@ int main(void)
 								size--;
 							}
 						}
+
+						if ( (msgBuffer[0] != CMD_PROGRAM_EEPROM_ISP) && (status == STATUS_CMD_OK) )
+						{
+							/* Erase and write while the next message comes in, see flash_poll() */
+							flashPage	=	tempaddress;
+							// erase only main section (bootloader protection)
+							if (eraseAddress < APP_END )
+							{
+								boot_page_erase(eraseAddress);	// Start page erase
+								eraseAddress += SPM_PAGESIZE;	// point to next page to be erase
+								flashState	=	FLASH_ERASING;
+							}
+							else
+							{
+								boot_page_write(tempaddress);
+								flashState	=	FLASH_WRITING;
+							}
+						#ifdef REMOVE_OVERLAPPED_FLASH_WRITE
+							flash_finish();
+						#endif
+						}
 						msgLength		=	2;
-						msgBuffer[1]	=	STATUS_CMD_OK;
+						msgBuffer[1]	=	status;
 					}
 					break;
 
@@ -98,6 +98,24 @@ void yield(void);
 #define degrees(rad) ((rad)*RAD_TO_DEG)
 #define sq(x) ((x)*(x))
 
+// For the few functions that run all the time, mostly from interrupts:
+// built for speed (-O2) even when the rest is built for size (-Os, see
+// the Optimize menu). A function that is inlined into one of them needs
+// it as well, or GCC won't inline it.
+#define HOT_FUNCTION __attribute__((hot, optimize("O2")))
+
+// Build with CORE_ISR_NOBLOCK=1 to let other interrupts preempt the long
+// interrupt handlers of the core and its libraries: TWI_vect (Wire, with
+// its slave callbacks), the setup requests in USB_COM_vect, and the
+// SoftwareSerial reception in the pin change interrupt. Each masks its
+// own source first, so it doesn't interrupt itself, then enables
+// interrupts. A USART receive interrupt then waits a few microseconds
+// at most instead of hundreds. ISR_NOBLOCK itself is not used, as it
+// enables interrupts before the source is masked.
+#ifndef CORE_ISR_NOBLOCK
+#define CORE_ISR_NOBLOCK 0
+#endif
+
 #define interrupts() sei()
 #define noInterrupts() cli()
 
@@ -133,25 +151,412 @@ int atexit(void (*func)()) __attribute__((weak));
 void pinMode(uint8_t, uint8_t);
 void digitalWrite(uint8_t, uint8_t);
 int digitalRead(uint8_t);
+// The same functions under other names, so that the inline versions
+// further down can call them
+void _pinModeCall(uint8_t, uint8_t) __asm__("pinMode");
+void _digitalWriteCall(uint8_t, uint8_t) __asm__("digitalWrite");
+int _digitalReadCall(uint8_t) __asm__("digitalRead");
+// Nonzero for the timer channels (TIMER0A ... TIMER5C) that analogWrite()
+// connected to their pin, so that digitalWrite() and digitalRead() only
+// need to turn PWM off on those
+extern uint8_t timer_pwm_active[];
+// Whole port versions, for the port returned by digitalPinToPort(): only
+// the bits set in mask are changed or returned
+void portMode(uint8_t port, uint8_t mask, uint8_t mode);
+// Sets the modes of many pins at once from a PROGMEM table, e.g.
+//   const PinModeEntry pins[] PROGMEM = { { 13, OUTPUT }, { 2, INPUT_PULLUP } };
+//   pinModes(pins, sizeof(pins) / sizeof(pins[0]));
+typedef struct {
+	uint8_t pin;
+	uint8_t mode;
+} PinModeEntry;
+void pinModes(const PinModeEntry *table, uint8_t count);
+void portWrite(uint8_t port, uint8_t mask, uint8_t value);
+uint8_t portRead(uint8_t port, uint8_t mask);
 int analogRead(uint8_t);
+void analogReadStart(uint8_t pin);
+uint8_t analogReadReady(void);
+int analogReadResult(void);
+uint8_t analogReadAsync(uint8_t pin, void (*callback)(int));
+int analogReadNoiseReduced(uint8_t pin);
 void analogReference(uint8_t mode);
+void analogPrescaler(uint8_t divisor);
 void analogWrite(uint8_t, int);
 
+// Owners of the hardware timers, see wiring_timer_alloc.c
+#define TIMER_COUNT 6
+#define TIMER_FREE 0
+#define TIMER_OWNER_MILLIS 1
+#define TIMER_OWNER_TONE 2
+#define TIMER_OWNER_PWM16 3
+#define TIMER_OWNER_CAPTURE 4
+#define TIMER_OWNER_CYCLES 5
+#define TIMER_OWNER_SAMPLING 6
+#define TIMER_OWNER_SYNTH 7
+#define TIMER_OWNER_USER 8
+#define TIMER_OWNER_SOFTPWM 9
+#define TIMER_OWNER_AUTOBAUD 10
+
+uint8_t claimTimer(uint8_t timer, uint8_t owner);
+void releaseTimer(uint8_t timer, uint8_t owner);
+uint8_t timerOwner(uint8_t timer);
+int8_t claimFreeTimer(const uint8_t *candidates, uint8_t count, uint8_t owner);
+uint8_t timerOfChannel(uint8_t channel);
+uint16_t timerPrescaler(uint8_t timer);
+
+uint16_t beginPwm16(uint8_t pin, unsigned long frequency);
+void pwmWrite16(uint8_t pin, uint16_t value);
+volatile uint16_t *pwmRegister16(uint8_t pin);
+void endPwm16(uint8_t pin);
+
+uint8_t beginSoftPwm(unsigned long frequency);
+uint8_t softPwmAttach(uint8_t pin);
+void softPwmWrite(uint8_t pin, uint8_t value);
+void softPwmDetach(uint8_t pin);
+void endSoftPwm(void);
+
+uint8_t beginAnalogSampling(uint8_t pin, unsigned long rate, uint16_t *buffer, uint16_t size);
+void endAnalogSampling(void);
+uint16_t analogSamplesAvailable(void);
+int readAnalogSample(void);
+uint8_t analogSamplingOverflow(void);
+
+#ifndef ANALOG_SCAN_MAX
+#define ANALOG_SCAN_MAX 16
+#endif
+
+uint8_t beginAnalogScan(const uint8_t *pins, uint8_t count, uint16_t *results, uint8_t continuous);
+uint8_t analogScanDone(void);
+void endAnalogScan(void);
+
+uint8_t beginAnalogOversample(uint8_t pin, uint8_t bits);
+uint8_t analogOversampleReady(void);
+uint16_t analogOversampleResult(void);
+void endAnalogOversample(void);
+
 unsigned long millis(void);
 unsigned long micros(void);
+uint8_t beginCycleCounter(void);
+void endCycleCounter(void);
+unsigned long cycleCounter(void);
+
+// Pulse measurement with the input capture unit of timer 1, 3, 4 or 5,
+// see wiring_capture.c. With a constant timer, only that timer's vectors
+// are linked in.
+uint8_t _beginPulseCapture1(uint8_t state);
+void _endPulseCapture1(void);
+uint8_t _readPulseCapture1(unsigned long *width, unsigned long *period);
+uint8_t _beginPulseCapture3(uint8_t state);
+void _endPulseCapture3(void);
+uint8_t _readPulseCapture3(unsigned long *width, unsigned long *period);
+uint8_t _beginPulseCapture4(uint8_t state);
+void _endPulseCapture4(void);
+uint8_t _readPulseCapture4(unsigned long *width, unsigned long *period);
+uint8_t _beginPulseCapture5(uint8_t state);
+void _endPulseCapture5(void);
+uint8_t _readPulseCapture5(unsigned long *width, unsigned long *period);
+
+// Starts measuring pulses of the given state (HIGH or LOW) on the input
+// capture pin of timer. Returns 0 if the timer has no input capture unit
+// on this board or is taken. The pin must be an input.
+static inline __attribute__((always_inline)) uint8_t beginPulseCapture(uint8_t timer, uint8_t state)
+{
+	switch (timer) {
+#if defined(TIMER1_CAPT_vect) && defined(ICR1)
+	case 1: return _beginPulseCapture1(state);
+#endif
+#if defined(TIMER3_CAPT_vect) && defined(ICR3)
+	case 3: return _beginPulseCapture3(state);
+#endif
+#if defined(TIMER4_CAPT_vect) && defined(ICR4)
+	case 4: return _beginPulseCapture4(state);
+#endif
+#if defined(TIMER5_CAPT_vect) && defined(ICR5)
+	case 5: return _beginPulseCapture5(state);
+#endif
+	default: return 0;
+	}
+}
+
+// Stops the measurement and gives the timer back to analogWrite().
+static inline __attribute__((always_inline)) void endPulseCapture(uint8_t timer)
+{
+	switch (timer) {
+#if defined(TIMER1_CAPT_vect) && defined(ICR1)
+	case 1: _endPulseCapture1(); break;
+#endif
+#if defined(TIMER3_CAPT_vect) && defined(ICR3)
+	case 3: _endPulseCapture3(); break;
+#endif
+#if defined(TIMER4_CAPT_vect) && defined(ICR4)
+	case 4: _endPulseCapture4(); break;
+#endif
+#if defined(TIMER5_CAPT_vect) && defined(ICR5)
+	case 5: _endPulseCapture5(); break;
+#endif
+	}
+}
+
+// Returns 1 if a pulse completed since the last call, with its width and
+// the period since the previous pulse (0 for the first one) in clock
+// cycles. Use clockCyclesToMicroseconds() to convert.
+static inline __attribute__((always_inline)) uint8_t readPulseCapture(uint8_t timer, unsigned long *width, unsigned long *period)
+{
+	switch (timer) {
+#if defined(TIMER1_CAPT_vect) && defined(ICR1)
+	case 1: return _readPulseCapture1(width, period);
+#endif
+#if defined(TIMER3_CAPT_vect) && defined(ICR3)
+	case 3: return _readPulseCapture3(width, period);
+#endif
+#if defined(TIMER4_CAPT_vect) && defined(ICR4)
+	case 4: return _readPulseCapture4(width, period);
+#endif
+#if defined(TIMER5_CAPT_vect) && defined(ICR5)
+	case 5: return _readPulseCapture5(width, period);
+#endif
+	default: return 0;
+	}
+}
+
+// Inputs of the analog comparator besides the analog pins, see
+// wiring_comparator.c
+#define COMPARATOR_AIN0 0xFE
+#define COMPARATOR_AIN1 0xFE
+#define COMPARATOR_BANDGAP 0xFF
+
+uint8_t beginComparator(uint8_t positive, uint8_t negative);
+void endComparator(void);
+int comparatorRead(void);
+void attachComparatorInterrupt(void (*)(void), int mode);
+void detachComparatorInterrupt(void);
+uint8_t beginComparatorCapture(uint8_t state);
+void endComparatorCapture(void);
+// A seed for randomSeed() or fastRandomSeed(), from watchdog jitter; takes
+// about half a second, see wiring_entropy.c
+unsigned long randomEntropy(void);
 void delay(unsigned long);
+// Power-down sleep woken by the watchdog, millis() goes on counting; see
+// wiring_sleep.c
+unsigned long sleepFor(unsigned long ms);
 void delayMicroseconds(unsigned int us);
+#if defined(__OPTIMIZE__)
+// Delays by a constant number of microseconds are done inline, exact to
+// the clock cycle for any F_CPU. Others call the function in wiring.c;
+// this GNU inline definition is only used for inlining, see
+// digitalWrite() below.
+void _delayMicrosecondsCall(unsigned int us) __asm__("delayMicroseconds");
+extern inline __attribute__((gnu_inline, always_inline)) void delayMicroseconds(unsigned int us)
+{
+	if (__builtin_constant_p(us))
+		__builtin_avr_delay_cycles(((unsigned long)us * (F_CPU / 1000L) + 500) / 1000);
+	else
+		_delayMicrosecondsCall(us);
+}
+#endif
 unsigned long pulseIn(uint8_t pin, uint8_t state, unsigned long timeout);
 unsigned long pulseInLong(uint8_t pin, uint8_t state, unsigned long timeout);
+// WS2812-type LED strips on any pin, len bytes of colour data; see
+// wiring_ledstrip.c
+void ledStripWrite(uint8_t pin, const uint8_t *data, size_t len);
 
 void shiftOut(uint8_t dataPin, uint8_t clockPin, uint8_t bitOrder, uint8_t val);
+void shiftOutBuffer(uint8_t dataPin, uint8_t clockPin, uint8_t bitOrder, const uint8_t *buf, size_t len);
+uint8_t shiftOutParallel(const uint8_t *dataPins, uint8_t chains, uint8_t clockPin, uint8_t bitOrder, const uint8_t *buf, size_t len);
 uint8_t shiftIn(uint8_t dataPin, uint8_t clockPin, uint8_t bitOrder);
 
 void attachInterrupt(uint8_t, void (*)(void), int mode);
+void attachInterruptVector(uint8_t, int mode);
 void detachInterrupt(uint8_t);
+// TWI_vect handler, see WInterruptsTwi.c
+void attachInterruptTwi(void (*)(void));
+void detachInterruptTwi(void);
+// WDT_vect handler, see WInterruptsWdt.c
+void attachInterruptWdt(void (*)(void));
+void detachInterruptWdt(void);
+
+// Number of edges buffered per interrupt by attachInterruptCapture(), 0 to
+// leave the capture mode out. Times are in Timer0 ticks and wrap around,
+// so only differences between them are meaningful.
+#ifndef INTERRUPT_CAPTURE_SIZE
+#define INTERRUPT_CAPTURE_SIZE 0
+#endif
+
+#if INTERRUPT_CAPTURE_SIZE > 0
+typedef struct {
+  uint16_t time;
+  uint8_t level;
+} interruptCapture;
+
+void attachInterruptCapture(uint8_t, uint8_t pin, int mode);
+uint8_t readInterruptCapture(uint8_t, interruptCapture *event);
+uint8_t interruptCaptureOverflow(uint8_t);
+unsigned long interruptCaptureMicros(uint16_t ticks);
+#endif
+
+void attachPinChangeInterrupt(uint8_t pin, void (*)(void), int mode);
+void detachPinChangeInterrupt(uint8_t pin);
+void attachPinChangeHook(void (*)(void));
+
+// Quadrature encoders decoded in the pin change interrupts, see WPinChange.c
+#ifndef ENCODER_MAX
+#define ENCODER_MAX 4
+#endif
+
+int8_t attachEncoder(uint8_t pinA, uint8_t pinB);
+void detachEncoder(uint8_t encoder);
+long readEncoder(uint8_t encoder);
+void writeEncoder(uint8_t encoder, long position);
+
+#ifndef TASKS_MAX
+#define TASKS_MAX 8
+#endif
+
+int8_t addTask(void (*)(void), unsigned long period);
+void removeTask(int8_t);
+// Only linked in when addTask() is used, so check before calling
+void runTasks(void) __attribute__((weak));
+
+// One-shot or periodic callback driven by the Timer0 compare B interrupt,
+// see wiring_timers.c. The structure is owned by the caller and must stay
+// valid while the timer is running; its fields are private.
+typedef struct softTimer {
+	struct softTimer *next;
+	void (*callback)(void *);
+	void *arg;
+	unsigned int period;
+	unsigned int rounds;
+	uint8_t slot;
+} softTimer;
+
+void startTimer(softTimer *, unsigned int ms, unsigned int period, void (*)(void *), void *arg);
+void stopTimer(softTimer *);
+
+// Number of voices mixed by beginToneVoices(), see wiring_synth.c
+#ifndef TONE_VOICES
+#define TONE_VOICES 4
+#endif
+
+uint8_t beginToneVoices(uint8_t pin);
+void playVoice(uint8_t voice, unsigned int frequency, unsigned long duration);
+void stopVoice(uint8_t voice);
+void endToneVoices(void);
+// Only linked in when startTimer() is used, so check before calling
+void runTimers(void) __attribute__((weak));
+
+// Size classes of the fixed-block allocator, see wiring_pool.c, smallest
+// first. Blocks must hold at least a pointer; a count of 0 leaves the
+// class out.
+#ifndef POOL_SIZE_0
+#define POOL_SIZE_0 8
+#endif
+#ifndef POOL_SIZE_1
+#define POOL_SIZE_1 16
+#endif
+#ifndef POOL_SIZE_2
+#define POOL_SIZE_2 32
+#endif
+#ifndef POOL_SIZE_3
+#define POOL_SIZE_3 64
+#endif
+#ifndef POOL_COUNT_0
+#define POOL_COUNT_0 0
+#endif
+#ifndef POOL_COUNT_1
+#define POOL_COUNT_1 0
+#endif
+#ifndef POOL_COUNT_2
+#define POOL_COUNT_2 0
+#endif
+#ifndef POOL_COUNT_3
+#define POOL_COUNT_3 0
+#endif
+
+typedef struct {
+	uint16_t size;
+	uint8_t count;
+	uint8_t used;
+	uint8_t highWater;
+} poolStats;
+
+void *poolAlloc(size_t size);
+uint8_t poolFree(void *ptr);
+uint8_t poolGetStats(uint8_t index, poolStats *stats);
+
+// Bump allocator over a caller's buffer, see wiring_arena.c. The fields
+// are private.
+typedef struct memArena {
+	uint8_t *base;
+	size_t size;
+	size_t used;
+	size_t last;
+	size_t highWater;
+} memArena;
+
+void arenaBegin(memArena *arena, void *buffer, size_t size);
+void *arenaAlloc(memArena *arena, size_t size);
+void *arenaRealloc(memArena *arena, void *ptr, size_t oldSize, size_t size);
+uint8_t arenaOwns(const memArena *arena, const void *ptr);
+void arenaReset(memArena *arena);
+void setLoopArena(memArena *arena);
+// Only linked in when setLoopArena() is used, so check before calling
+void resetLoopArena(void) __attribute__((weak));
+
+// External RAM on the ATmega1280/2560, enabled from the board menu,
+// which passes the last address as XMEM_END. malloc() and new then take
+// their memory there, from XMEM_START (just above the internal RAM) up.
+#ifndef XMEM_END
+#define XMEM_END 0
+#endif
+#ifndef XMEM_WAIT_STATES
+#define XMEM_WAIT_STATES 0
+#endif
+#define XMEM_START (RAMEND + 1)
+
+#if defined(XMCRA) && XMEM_END
+void *xmemBuffer(size_t size);
+#endif
+
+size_t freeMemory(void);
+size_t largestFreeBlock(void);
+size_t stackUnused(void);
+size_t stackMaxUsed(void);
+
+// Erasing and writing the flash from the sketch, see wiring_flash.c. This
+// needs an optiboot built with APP_SPM (bootloaders/optiboot), or past 128K
+// the stk500v2 bootloader from this core, and FLASH_BOOTLOADER_SIZE set to
+// its size; with any other bootloader these crash. Addresses are in bytes,
+// pages are SPM_PAGESIZE long.
+#ifndef FLASH_BOOTLOADER_SIZE
+#if FLASHEND > 0x1FFFF
+#define FLASH_BOOTLOADER_SIZE 8192
+#else
+#define FLASH_BOOTLOADER_SIZE 512
+#endif
+#endif
+// For PROGMEM arrays that are written with flashWritePage()
+#define FLASH_PAGE_ALIGNED __attribute__((aligned(SPM_PAGESIZE)))
+
+uint8_t flashErasePage(uint32_t address);
+uint8_t flashWritePage(uint32_t address, const void *data);
+uint8_t flashWrite(uint32_t address, const void *data, size_t size);
+
+// Past 128K, a sketch up to 128K can update itself: write the new image
+// with flashWrite() to FLASH_UPDATE_START on, up to FLASH_UPDATE_SIZE
+// bytes, then call flashUpdateCommit() and reset. The bootloader copies it
+// over the old sketch only if it all arrived.
+#if FLASHEND > 0x1FFFF
+#define FLASH_UPDATE_START ((uint32_t)(FLASHEND + 1) / 2)
+#define FLASH_UPDATE_SIZE ((uint32_t)FLASHEND + 1 - FLASH_BOOTLOADER_SIZE - SPM_PAGESIZE - FLASH_UPDATE_START)
+uint8_t flashUpdateCommit(uint32_t length);
+#endif
 
 void setup(void);
 void loop(void);
+// Called from loop() when it has nothing left to do: once this pass of
+// the main loop is over, the CPU idles until the next interrupt, see
+// main.cpp
+void loopIdle(void);
 
 // Get the bit location within the hardware port of the given virtual pin.
 // This comes from the pins_*.c file for the active board configuration.
@@ -243,17 +648,264 @@ uint16_t makeWord(byte h, byte l);
 unsigned long pulseIn(uint8_t pin, uint8_t state, unsigned long timeout = 1000000L);
 unsigned long pulseInLong(uint8_t pin, uint8_t state, unsigned long timeout = 1000000L);
 
+inline void shiftOut(uint8_t dataPin, uint8_t clockPin, uint8_t bitOrder, const uint8_t *buf, size_t len)
+{
+  shiftOutBuffer(dataPin, clockPin, bitOrder, buf, len);
+}
+
 void tone(uint8_t _pin, unsigned int frequency, unsigned long duration = 0);
 void noTone(uint8_t _pin);
 
+// One note of a playToneSequence() table: frequency in Hz (0 for a rest)
+// and duration in milliseconds
+typedef struct {
+  uint16_t frequency;
+  uint16_t duration;
+} ToneNote;
+
+void playToneSequence(uint8_t _pin, const ToneNote *notes, uint16_t count, bool repeat = false);
+bool toneSequencePlaying();
+
 // WMath prototypes
 long random(long);
 long random(long, long);
 void randomSeed(unsigned long);
+// xorshift32, a few dozen cycles for a number below 65536 where random()
+// takes several hundred; built with RANDOM_XORSHIFT set, random() and
+// randomSeed() are these
+long fastRandom(long);
+long fastRandom(long, long);
+uint32_t fastRandom32(void);
+void fastRandomSeed(unsigned long);
 long map(long, long, long, long, long);
 
+// map() with the ranges known at compile time, e.g. mapRange<0, 1023, 0,
+// 255>(analogRead(A0)). The division by the input range is folded into a
+// 32-bit multiply and shift by a constant, which gives exactly the result
+// of map() for x inside the input range; values outside it, and ranges
+// too large for the multiply, take the map() formula. Being constexpr, it
+// can also be used in constant expressions.
+template <long InMin, long InMax, long OutMin, long OutMax>
+struct _MapRange {
+  static_assert(InMin != InMax, "mapRange() input range is empty");
+  static constexpr unsigned long in = InMax > InMin ? InMax - InMin : InMin - InMax;
+  static constexpr unsigned long out = OutMax > OutMin ? OutMax - OutMin : OutMin - OutMax;
+  // 2^shift > in^2 makes the rounded up multiplier exact for 0..in
+  static constexpr uint8_t shiftFor(uint8_t s) {
+    return (1ULL << s) > (unsigned long long)in * in ? s : shiftFor(s + 1);
+  }
+  static constexpr uint8_t shift = shiftFor(0);
+  static constexpr unsigned long long mul = ((unsigned long long)out << shift) / in + 1;
+  static constexpr bool fast = shift < 32 && mul * in < (1ULL << 32);
+
+  static constexpr long slow(long x) {
+    return (x - InMin) * (OutMax - OutMin) / (InMax - InMin) + OutMin;
+  }
+  static constexpr unsigned long index(long x) {
+    return InMax > InMin ? (unsigned long)(x - InMin) : (unsigned long)(InMin - x);
+  }
+  static constexpr long scaled(unsigned long n) {
+    return (long)((n * (unsigned long)mul) >> shift);
+  }
+};
+
+template <long InMin, long InMax, long OutMin, long OutMax>
+constexpr long mapRange(long x)
+{
+  typedef _MapRange<InMin, InMax, OutMin, OutMax> m;
+  return !m::fast || m::index(x) > m::in ? m::slow(x) :
+         OutMax >= OutMin ? OutMin + m::scaled(m::index(x)) :
+                            OutMin - m::scaled(m::index(x));
+}
+
 #endif
 
 #include "pins_arduino.h"
 
+// Versions of digitalWrite(), digitalRead() and pinMode() that compile to
+// one or two instructions when the pin number is a constant, using the
+// compile time pin mapping of the variant. Unlike digitalWrite(), they do
+// not turn off PWM on the pin. With a pin number only known at runtime
+// they simply call the normal functions.
+#if defined(digitalPinToPortLetter) && defined(digitalPinToBitNumber) && defined(__OPTIMIZE__)
+
+#define _FAST_PIN 0
+#define _FAST_DDR 1
+#define _FAST_PORT 2
+
+// Returns the PIN, DDR or PORT register of the pin, or 0 if the pin does
+// not exist
+static inline __attribute__((always_inline)) volatile uint8_t *_fastPinRegister(uint8_t pin, uint8_t which)
+{
+	switch (digitalPinToPortLetter(pin)) {
+#if defined(PORTA)
+	case 'A': return which == _FAST_PIN ? &PINA : which == _FAST_DDR ? &DDRA : &PORTA;
+#endif
+#if defined(PORTB)
+	case 'B': return which == _FAST_PIN ? &PINB : which == _FAST_DDR ? &DDRB : &PORTB;
+#endif
+#if defined(PORTC)
+	case 'C': return which == _FAST_PIN ? &PINC : which == _FAST_DDR ? &DDRC : &PORTC;
+#endif
+#if defined(PORTD)
+	case 'D': return which == _FAST_PIN ? &PIND : which == _FAST_DDR ? &DDRD : &PORTD;
+#endif
+#if defined(PORTE)
+	case 'E': return which == _FAST_PIN ? &PINE : which == _FAST_DDR ? &DDRE : &PORTE;
+#endif
+#if defined(PORTF)
+	case 'F': return which == _FAST_PIN ? &PINF : which == _FAST_DDR ? &DDRF : &PORTF;
+#endif
+#if defined(PORTG)
+	case 'G': return which == _FAST_PIN ? &PING : which == _FAST_DDR ? &DDRG : &PORTG;
+#endif
+#if defined(PORTH)
+	case 'H': return which == _FAST_PIN ? &PINH : which == _FAST_DDR ? &DDRH : &PORTH;
+#endif
+#if defined(PORTJ)
+	case 'J': return which == _FAST_PIN ? &PINJ : which == _FAST_DDR ? &DDRJ : &PORTJ;
+#endif
+#if defined(PORTK)
+	case 'K': return which == _FAST_PIN ? &PINK : which == _FAST_DDR ? &DDRK : &PORTK;
+#endif
+#if defined(PORTL)
+	case 'L': return which == _FAST_PIN ? &PINL : which == _FAST_DDR ? &DDRL : &PORTL;
+#endif
+	}
+	return 0;
+}
+
+// The ports above 0x3F (e.g. PORTH on the ATmega2560) are out of reach for
+// sbi/cbi, so changing a bit there takes a read-modify-write that must not
+// be interrupted
+#define _FAST_ATOMIC(reg) ((uintptr_t)(reg) < 0x40)
+
+static inline __attribute__((always_inline)) void digitalWriteFast(uint8_t pin, uint8_t val)
+{
+	volatile uint8_t *out = _fastPinRegister(pin, _FAST_PORT);
+	uint8_t bit = _BV(digitalPinToBitNumber(pin));
+
+	if (!__builtin_constant_p(pin) || !out) {
+		_digitalWriteCall(pin, val);
+	} else if (_FAST_ATOMIC(out)) {
+		if (val == LOW) *out &= ~bit;
+		else *out |= bit;
+	} else {
+		uint8_t oldSREG = SREG;
+		cli();
+		if (val == LOW) *out &= ~bit;
+		else *out |= bit;
+		SREG = oldSREG;
+	}
+}
+
+static inline __attribute__((always_inline)) int digitalReadFast(uint8_t pin)
+{
+	volatile uint8_t *in = _fastPinRegister(pin, _FAST_PIN);
+
+	if (!__builtin_constant_p(pin) || !in)
+		return _digitalReadCall(pin);
+	return (*in & _BV(digitalPinToBitNumber(pin))) ? HIGH : LOW;
+}
+
+static inline __attribute__((always_inline)) void _pinModeFast(volatile uint8_t *reg, volatile uint8_t *out, uint8_t bit, uint8_t mode)
+{
+	if (mode == INPUT) {
+		*reg &= ~bit;
+		*out &= ~bit;
+	} else if (mode == INPUT_PULLUP) {
+		*reg &= ~bit;
+		*out |= bit;
+	} else {
+		*reg |= bit;
+	}
+}
+
+static inline __attribute__((always_inline)) void pinModeFast(uint8_t pin, uint8_t mode)
+{
+	volatile uint8_t *reg = _fastPinRegister(pin, _FAST_DDR);
+	volatile uint8_t *out = _fastPinRegister(pin, _FAST_PORT);
+	uint8_t bit = _BV(digitalPinToBitNumber(pin));
+
+	if (!__builtin_constant_p(pin) || !reg) {
+		_pinModeCall(pin, mode);
+	} else if (_FAST_ATOMIC(reg)) {
+		_pinModeFast(reg, out, bit, mode);
+	} else {
+		uint8_t oldSREG = SREG;
+		cli();
+		_pinModeFast(reg, out, bit, mode);
+		SREG = oldSREG;
+	}
+}
+
+#ifdef __cplusplus
+// Bit mask of a group of pins, computed at compile time, for portWrite()
+// and friends. Check with digitalPinsOnSamePort() that they all share a
+// port, e.g.
+//   static_assert(digitalPinsOnSamePort(2, 3, 4, 5), "bus split");
+//   portWrite(digitalPinToPort(2), digitalPinsToBitMask(2, 3, 4, 5), v);
+constexpr uint8_t digitalPinsToBitMask() { return 0; }
+template <typename... Pins>
+constexpr uint8_t digitalPinsToBitMask(uint8_t pin, Pins... pins)
+{
+	return _BV(digitalPinToBitNumber(pin)) | digitalPinsToBitMask(pins...);
+}
+
+constexpr bool digitalPinsOnSamePort(uint8_t) { return true; }
+template <typename... Pins>
+constexpr bool digitalPinsOnSamePort(uint8_t a, uint8_t b, Pins... pins)
+{
+	return digitalPinToPortLetter(a) != 0 &&
+	       digitalPinToPortLetter(a) == digitalPinToPortLetter(b) &&
+	       digitalPinsOnSamePort(b, pins...);
+}
+#endif
+
+// Whether a constant pin can have PWM on, known at compile time where
+// the variant lists its PWM pins
+#if defined(digitalPinHasPWM)
+#define _fastPinMayPWM(pin) digitalPinHasPWM(pin)
+#else
+#define _fastPinMayPWM(pin) 1
+#endif
+#define _fastPinPWMOn(pin) (_fastPinMayPWM(pin) && timer_pwm_active[digitalPinToTimer(pin)])
+
+// digitalWrite(), digitalRead() and pinMode() themselves take the same
+// path for constant pins. For a pin without PWM, digitalWrite() is then
+// a single sbi/cbi on the ports that allow it. On a PWM pin, it and
+// digitalRead() first look up at runtime whether analogWrite() left PWM
+// on, and if so leave it to the normal functions to turn it off. These
+// are GNU inline definitions: they are only used for inlining, the calls
+// with a pin known at runtime and the function addresses go to
+// wiring_digital.c, and methods of the same name in other classes are
+// left alone.
+extern inline __attribute__((gnu_inline, always_inline)) void digitalWrite(uint8_t pin, uint8_t val)
+{
+	if (!__builtin_constant_p(pin) || _fastPinPWMOn(pin))
+		_digitalWriteCall(pin, val);
+	else
+		digitalWriteFast(pin, val);
+}
+
+extern inline __attribute__((gnu_inline, always_inline)) int digitalRead(uint8_t pin)
+{
+	if (!__builtin_constant_p(pin) || _fastPinPWMOn(pin))
+		return _digitalReadCall(pin);
+	return digitalReadFast(pin);
+}
+
+extern inline __attribute__((gnu_inline, always_inline)) void pinMode(uint8_t pin, uint8_t mode)
+{
+	pinModeFast(pin, mode);
+}
+
+#else
+
+#define digitalWriteFast(pin, val) digitalWrite(pin, val)
+#define digitalReadFast(pin) digitalRead(pin)
+#define pinModeFast(pin, mode) pinMode(pin, mode)
+
+#endif
+
 #endif
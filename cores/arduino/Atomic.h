@@ -0,0 +1,138 @@
+/*
+  Atomic.h - Reading data shared with interrupt handlers without cli()
+  Copyright (c) 2026 Arduino.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef Atomic_h
+#define Atomic_h
+
+#include <stddef.h>
+#include <inttypes.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+// The AVR reads a multi-byte variable one byte at a time, so an interrupt
+// handler that changes it in between leaves the reader with half of the
+// old and half of the new value. The usual cure is to disable interrupts
+// around the read, which delays every interrupt that comes meanwhile.
+//
+// atomicRead() instead reads the variable twice and returns once both
+// reads agree. A reader is only torn by an interrupt in the middle of
+// one of the reads, and then the other one differs; if they agree, the
+// value is one the handler really wrote. Interrupts stay enabled
+// throughout, the cost is a second read, and a retry only when the
+// handler ran. This needs the handler to change the variable less often
+// than twice within the two reads, which holds for counters and ring
+// buffer indexes updated once per interrupt.
+//
+// Atomic<T> wraps a variable written by an interrupt handler and read
+// with atomicRead(). SeqLock<T> does the same for larger data, such as a
+// struct of several fields that must be read together: the handler bumps
+// a sequence number before and after writing, and the reader copies
+// until the number was even and unchanged. Only interrupt handlers may
+// write either, as they can't wait for the main code to finish a read.
+
+template <typename T>
+inline T atomicRead(const volatile T &v)
+{
+  if (sizeof(T) == 1)
+    return v;
+  T a = v;
+  for (;;) {
+    T b = v;
+    if (a == b)
+      return a;
+    a = b;
+  }
+}
+
+template <typename T>
+class Atomic
+{
+  public:
+    constexpr Atomic() : _value() {}
+    constexpr Atomic(T value) : _value(value) {}
+
+    // From code an interrupt handler may interrupt
+    inline T load() const { return atomicRead(_value); }
+    inline operator T() const { return load(); }
+
+    // From the interrupt handler, which nothing interrupts
+    inline void store(T value) { _value = value; }
+    inline Atomic &operator = (T value) { store(value); return *this; }
+
+    // For the rare writes from the main code
+    inline void storeAtomic(T value)
+    {
+      uint8_t oldSREG = SREG;
+      cli();
+      _value = value;
+      SREG = oldSREG;
+    }
+
+    inline volatile T &raw() { return _value; }
+
+  private:
+    volatile T _value;
+};
+
+template <typename T>
+class SeqLock
+{
+  public:
+    // Copies the data to out, retrying while the handler writes it
+    void load(T &out) const
+    {
+      uint8_t seq;
+      do {
+        while ((seq = _seq) & 1)
+          ;
+        copy(out, _data);
+      } while (seq != _seq);
+    }
+
+    inline T load() const { T out; load(out); return out; }
+
+    // From the interrupt handler only
+    void store(const T &in)
+    {
+      _seq++;
+      copy(_data, in);
+      _seq++;
+    }
+
+  private:
+    static inline void copy(volatile T &to, const T &from)
+    {
+      const uint8_t *s = (const uint8_t *)&from;
+      volatile uint8_t *d = (volatile uint8_t *)&to;
+      for (size_t i = 0; i < sizeof(T); i++)
+        d[i] = s[i];
+    }
+    static inline void copy(T &to, const volatile T &from)
+    {
+      const volatile uint8_t *s = (const volatile uint8_t *)&from;
+      uint8_t *d = (uint8_t *)&to;
+      for (size_t i = 0; i < sizeof(T); i++)
+        d[i] = s[i];
+    }
+
+    volatile uint8_t _seq = 0;
+    volatile T _data;
+};
+
+#endif
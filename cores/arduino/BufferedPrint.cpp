@@ -0,0 +1,71 @@
+/*
+  BufferedPrint.cpp - Print adapter that collects bytes into larger writes
+  Copyright (c) 2026 Arduino.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include <string.h>
+
+#include "BufferedPrint.h"
+
+size_t BufferedPrint::write(uint8_t c)
+{
+  _buf[_len++] = c;
+  if (_len == sizeof(_buf))
+    send();
+  return 1;
+}
+
+size_t BufferedPrint::write(const uint8_t *buffer, size_t size)
+{
+  size_t n = size;
+
+  while (size) {
+    // a full chunk with nothing buffered goes straight through
+    if (_len == 0 && size >= sizeof(_buf)) {
+      if (_out.write(buffer, size) != size)
+        setWriteError();
+      break;
+    }
+
+    size_t chunk = sizeof(_buf) - _len;
+    if (chunk > size)
+      chunk = size;
+    memcpy(_buf + _len, buffer, chunk);
+    _len += chunk;
+    buffer += chunk;
+    size -= chunk;
+
+    if (_len == sizeof(_buf))
+      send();
+  }
+  return n;
+}
+
+void BufferedPrint::send()
+{
+  if (_len == 0)
+    return;
+  if (_out.write(_buf, _len) != _len)
+    setWriteError();
+  _len = 0;
+}
+
+void BufferedPrint::flush()
+{
+  send();
+  _out.flush();
+}
@@ -0,0 +1,62 @@
+/*
+  BufferedPrint.h - Print adapter that collects bytes into larger writes
+  Copyright (c) 2026 Arduino.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef BufferedPrint_h
+#define BufferedPrint_h
+
+#include <inttypes.h>
+
+#include "Print.h"
+
+// One USB full speed bulk packet
+#if !defined(BUFFERED_PRINT_SIZE)
+#define BUFFERED_PRINT_SIZE 64
+#endif
+
+// Wraps another Print and passes bytes on to its write(buffer, size) in
+// chunks of up to BUFFERED_PRINT_SIZE, instead of one write(uint8_t) per
+// byte. Prints of single characters and numbers then cost a copy into the
+// buffer; on Serial (USB CDC) each chunk is one packet instead of a USB
+// transfer per byte.
+//
+// Bytes stay in the buffer until it is full, send() or flush() is called,
+// or the adapter goes out of scope.
+class BufferedPrint : public Print
+{
+  public:
+    BufferedPrint(Print &out) : _out(out), _len(0) {}
+    ~BufferedPrint() { send(); }
+
+    virtual size_t write(uint8_t);
+    virtual size_t write(const uint8_t *buffer, size_t size);
+    using Print::write; // pull in write(str) and write(buf, size) for char
+    virtual int availableForWrite() { return sizeof(_buf) - _len; }
+
+    // Passes the buffered bytes on to the wrapped Print
+    void send();
+    // send(), then flushes the wrapped Print
+    virtual void flush();
+
+  private:
+    Print &_out;
+    uint8_t _len;
+    uint8_t _buf[BUFFERED_PRINT_SIZE];
+};
+
+#endif
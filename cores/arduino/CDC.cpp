@@ -39,23 +39,7 @@ static u8 wdtcsr_save;
 #define WEAK __attribute__ ((weak))
 
 extern const CDCDescriptor _cdcInterface PROGMEM;
-const CDCDescriptor _cdcInterface =
-{
-	D_IAD(0,2,CDC_COMMUNICATION_INTERFACE_CLASS,CDC_ABSTRACT_CONTROL_MODEL,1),
-
-	//	CDC communication interface
-	D_INTERFACE(CDC_ACM_INTERFACE,1,CDC_COMMUNICATION_INTERFACE_CLASS,CDC_ABSTRACT_CONTROL_MODEL,0),
-	D_CDCCS(CDC_HEADER,0x10,0x01),								// Header (1.10 bcd)
-	D_CDCCS(CDC_CALL_MANAGEMENT,1,1),							// Device handles call management (not)
-	D_CDCCS4(CDC_ABSTRACT_CONTROL_MANAGEMENT,6),				// SET_LINE_CODING, GET_LINE_CODING, SET_CONTROL_LINE_STATE supported
-	D_CDCCS(CDC_UNION,CDC_ACM_INTERFACE,CDC_DATA_INTERFACE),	// Communication interface is master, data interface is slave 0
-	D_ENDPOINT(USB_ENDPOINT_IN (CDC_ENDPOINT_ACM),USB_ENDPOINT_TYPE_INTERRUPT,0x10,0x40),
-
-	//	CDC data interface
-	D_INTERFACE(CDC_DATA_INTERFACE,2,CDC_DATA_INTERFACE_CLASS,0,0),
-	D_ENDPOINT(USB_ENDPOINT_OUT(CDC_ENDPOINT_OUT),USB_ENDPOINT_TYPE_BULK,USB_EP_SIZE,0),
-	D_ENDPOINT(USB_ENDPOINT_IN (CDC_ENDPOINT_IN ),USB_ENDPOINT_TYPE_BULK,USB_EP_SIZE,0)
-};
+const CDCDescriptor _cdcInterface = D_CDC();
 
 bool isLUFAbootloader()
 {
@@ -166,45 +150,137 @@ bool CDC_Setup(USBSetup& setup)
 
 void Serial_::begin(unsigned long /* baud_count */)
 {
-	peek_buffer = -1;
 }
 
 void Serial_::begin(unsigned long /* baud_count */, byte /* config */)
 {
-	peek_buffer = -1;
 }
 
 void Serial_::end(void)
 {
 }
 
-int Serial_::available(void)
+void CDC_Receive(void)
+{
+	Serial._rx_complete_irq();
+}
+
+// Copies the received packet into the ring, in two runs when it wraps.
+// If the ring fills up, the rest stays in the endpoint bank and the host
+// is NAKed until read() has made room again.
+void Serial_::_rx_complete_irq(void)
 {
-	if (peek_buffer >= 0) {
-		return 1 + USB_Available(CDC_RX);
+	for (;;) {
+		uint8_t head = _rx_buffer_head;
+		uint8_t tail = _rx_buffer_tail;
+		uint8_t space;
+
+		if (head >= tail)
+			space = SERIAL_BUFFER_SIZE - head - (tail == 0);
+		else
+			space = tail - head - 1;
+
+		if (space == 0) {
+			if (USB_Available(CDC_RX)) {
+				_rx_paused = true;
+				USB_RecvInterrupt(CDC_RX, false);
+			}
+			return;
+		}
+
+		int n = USB_Recv(CDC_RX, &_rx_buffer[head], space);
+		if (n <= 0)
+			return;
+		head += n;
+		if (head == SERIAL_BUFFER_SIZE)
+			head = 0;
+		_rx_buffer_head = head;
 	}
-	return USB_Available(CDC_RX);
+}
+
+void CDC_Transmit(void)
+{
+	Serial._tx_sof_irq();
+}
+
+// Sends what is queued in the TX ring, as far as the banks take it, and
+// releases a partly filled bank as setFlushPolicy() says
+void Serial_::_tx_sof_irq(void)
+{
+#if CDC_TX_BUFFER_SIZE
+	while (_tx_buffer_head != _tx_buffer_tail) {
+		uint8_t head = _tx_buffer_head;
+		uint8_t tail = _tx_buffer_tail;
+		uint8_t n = (head > tail ? head : CDC_TX_BUFFER_SIZE) - tail;
+
+		int r = USB_Send(CDC_TX | TRANSFER_NOWAIT, &_tx_buffer[tail], n);
+		if (r <= 0)
+			break;
+		tail += r;
+		if (tail == CDC_TX_BUFFER_SIZE)
+			tail = 0;
+		_tx_buffer_tail = tail;
+		if (r < n)
+			break;
+	}
+#endif
+
+	if (_flush_frames != CDC_FLUSH_FULL && ++_flush_count >= _flush_frames) {
+		_flush_count = 0;
+		USB_Flush(CDC_TX);
+	}
+}
+
+void Serial_::setNonBlockingWrite(bool enable)
+{
+#if CDC_TX_BUFFER_SIZE
+	if (!enable && _tx_nonblocking) {
+		unsigned long start = millis();
+		while (_tx_buffer_head != _tx_buffer_tail && millis() - start < USB_SEND_TIMEOUT)
+			;
+		ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+			_tx_buffer_tail = _tx_buffer_head;
+		}
+	}
+#endif
+	_tx_nonblocking = enable;
+}
+
+int Serial_::available(void)
+{
+	return ((unsigned int)(SERIAL_BUFFER_SIZE + _rx_buffer_head - _rx_buffer_tail)) % SERIAL_BUFFER_SIZE;
 }
 
 int Serial_::peek(void)
 {
-	if (peek_buffer < 0)
-		peek_buffer = USB_Recv(CDC_RX);
-	return peek_buffer;
+	if (_rx_buffer_head == _rx_buffer_tail)
+		return -1;
+	return _rx_buffer[_rx_buffer_tail];
 }
 
 int Serial_::read(void)
 {
-	if (peek_buffer >= 0) {
-		int c = peek_buffer;
-		peek_buffer = -1;
-		return c;
+	if (_rx_buffer_head == _rx_buffer_tail)
+		return -1;
+
+	unsigned char c = _rx_buffer[_rx_buffer_tail];
+	_rx_buffer_tail = (uint8_t)(_rx_buffer_tail + 1) % SERIAL_BUFFER_SIZE;
+
+	// take the endpoint interrupt back once there is room for a good part
+	// of a packet, rather than for every single byte
+	if (_rx_paused && available() < SERIAL_BUFFER_SIZE / 2) {
+		_rx_paused = false;
+		USB_RecvInterrupt(CDC_RX, true);
 	}
-	return USB_Recv(CDC_RX);
+	return c;
 }
 
 int Serial_::availableForWrite(void)
 {
+#if CDC_TX_BUFFER_SIZE
+	if (_tx_nonblocking)
+		return ((unsigned int)(CDC_TX_BUFFER_SIZE + _tx_buffer_tail - _tx_buffer_head - 1)) % CDC_TX_BUFFER_SIZE;
+#endif
 	return USB_SendSpace(CDC_TX);
 }
 
@@ -229,8 +305,35 @@ size_t Serial_::write(const uint8_t *buffer, size_t size)
 	// TODO - ZE - check behavior on different OSes and test what happens if an
 	// open connection isn't broken cleanly (cable is yanked out, host dies
 	// or locks up, or host virtual serial port hangs)
+	uint8_t ep = CDC_TX;
+	if (_flush_frames == CDC_FLUSH_IMMEDIATE)
+		ep |= TRANSFER_RELEASE;
+
+	if (_usbLineInfo.lineState > 0 && _tx_nonblocking) {
+		size_t sent = 0;
+		// straight into the banks while nothing is queued ahead of us
+#if CDC_TX_BUFFER_SIZE
+		if (_tx_buffer_head == _tx_buffer_tail)
+#endif
+		{
+			int r = USB_Send(ep | TRANSFER_NOWAIT, buffer, size);
+			if (r > 0)
+				sent = r;
+		}
+#if CDC_TX_BUFFER_SIZE
+		while (sent < size) {
+			uint8_t head = _tx_buffer_head;
+			uint8_t next = (uint8_t)(head + 1) % CDC_TX_BUFFER_SIZE;
+			if (next == _tx_buffer_tail)
+				break;
+			_tx_buffer[head] = buffer[sent++];
+			_tx_buffer_head = next;
+		}
+#endif
+		return sent;
+	}
 	if (_usbLineInfo.lineState > 0)	{
-		int r = USB_Send(CDC_TX,buffer,size);
+		int r = USB_Send(ep,buffer,size);
 		if (r > 0) {
 			return r;
 		} else {
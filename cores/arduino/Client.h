@@ -30,10 +30,22 @@ public:
   virtual int connect(const char *host, uint16_t port) =0;
   virtual size_t write(uint8_t) =0;
   virtual size_t write(const uint8_t *buf, size_t size) =0;
+  // Writes the segments one after the other, as one write where the
+  // library can map them to a single transfer instead of one per write()
+  // and without copying them together first. Returns the bytes written.
+  virtual size_t writev(const WriteSegment *segments, size_t count) { return writeSegments(segments, count); }
   virtual int available() = 0;
   virtual int read() = 0;
   virtual int read(uint8_t *buf, size_t size) = 0;
   virtual int peek() = 0;
+  // Borrows the received data: points data at the next bytes in the
+  // library's own receive buffer and returns how many of them are in one
+  // piece, without copying them. They stay valid until consume() or the
+  // next read. 0 means none, or that the library has no such buffer, in
+  // which case read() still works.
+  virtual size_t peekSpan(const uint8_t **data) { *data = NULL; return 0; }
+  // Drops the next n received bytes, e.g. those peekSpan() pointed at
+  virtual void consume(size_t n) { while (n-- && read() >= 0); }
   virtual void flush() = 0;
   virtual void stop() = 0;
   virtual uint8_t connected() = 0;
@@ -0,0 +1,261 @@
+/*
+  Fixed.h - Saturating fixed point numbers
+  Copyright (c) 2026 Arduino.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef Fixed_h
+#define Fixed_h
+
+#include "Arduino.h"
+
+// A number with F fractional bits in a T, e.g.
+//   q16_16 kp = 1.25, error = 0, out;
+//   out = kp * (setpoint - q16_16(analogRead(A0)));
+//   Serial.println(out, 4);
+// An AVR has no floating point unit, so a float multiply is a library
+// call of about 150 cycles and a divide about 500. A q8_8 (-128 to
+// 127.996) multiply is one 16x16 hardware multiply, a q16_16
+// (-32768 to 32767.99998) one is four of them, put together without any
+// 64-bit arithmetic. Results that don't fit saturate at the largest or
+// smallest number instead of wrapping around, as a control loop wants.
+// Division still goes bit by bit, so multiply by a constant reciprocal
+// where possible.
+//
+// Constants like 1.25 above are converted by the compiler. sin(), cos()
+// and atan2() take and give radians, from PROGMEM tables with linear
+// interpolation; angles go through 16-bit fractions of a turn, so they
+// are good to about 1e-4. sqrt() is exact to the last bit.
+
+// The helpers below do the arithmetic on the raw values
+
+template <uint8_t F>
+inline int16_t fixedMul(int16_t a, int16_t b)
+{
+  int32_t p = ((int32_t)a * b + ((int32_t)1 << (F - 1))) >> F;
+  return p > INT16_MAX ? INT16_MAX : p < INT16_MIN ? INT16_MIN : (int16_t)p;
+}
+
+// The 64-bit product of the magnitudes from four 16x16 multiplies, rounded
+// and shifted right by F
+template <uint8_t F>
+inline int32_t fixedMul(int32_t a, int32_t b)
+{
+  uint8_t neg = (a < 0) != (b < 0);
+  uint32_t ua = a < 0 ? -(uint32_t)a : a;
+  uint32_t ub = b < 0 ? -(uint32_t)b : b;
+  uint16_t a0 = ua, a1 = ua >> 16, b0 = ub, b1 = ub >> 16;
+
+  uint32_t ll = (uint32_t)a0 * b0;
+  uint32_t lh = (uint32_t)a0 * b1;
+  uint32_t hl = (uint32_t)a1 * b0;
+  uint32_t mid = (ll >> 16) + (uint16_t)lh + (uint16_t)hl;
+  uint32_t lo = (mid << 16) | (uint16_t)ll;
+  uint32_t hi = (uint32_t)a1 * b1 + (lh >> 16) + (hl >> 16) + (mid >> 16);
+
+  uint32_t r = lo + ((uint32_t)1 << (F - 1));
+  hi += r < lo;
+  lo = r;
+  uint32_t q = (hi << (32 - F)) | (lo >> F);
+  if ((hi >> F) != 0 || q > (uint32_t)INT32_MAX + neg)
+    return neg ? INT32_MIN : INT32_MAX;
+  return neg ? (int32_t)-q : (int32_t)q;
+}
+
+template <uint8_t F>
+inline int16_t fixedDiv(int16_t a, int16_t b)
+{
+  if (b == 0)
+    return a < 0 ? INT16_MIN : INT16_MAX;
+  int32_t q = ((int32_t)a << F) / b;
+  return q > INT16_MAX ? INT16_MAX : q < INT16_MIN ? INT16_MIN : (int16_t)q;
+}
+
+// (a << F) / b, one quotient bit at a time, truncated toward zero
+template <uint8_t F>
+int32_t fixedDiv(int32_t a, int32_t b)
+{
+  uint8_t neg = (a < 0) != (b < 0);
+  uint32_t ua = a < 0 ? -(uint32_t)a : a;
+  uint32_t ub = b < 0 ? -(uint32_t)b : b;
+  uint32_t rem = 0, q = 0;
+
+  if (b == 0)
+    return a < 0 ? INT32_MIN : INT32_MAX;
+  for (uint8_t i = 0; i < 32 + F; i++) {
+    uint8_t carry = rem >> 31;
+    rem = (rem << 1) | (ua >> 31);
+    ua <<= 1;
+    if (q >> 31)
+      return neg ? INT32_MIN : INT32_MAX;
+    q <<= 1;
+    if (carry || rem >= ub) {
+      rem -= ub;
+      q |= 1;
+    }
+  }
+  if (q > (uint32_t)INT32_MAX + neg)
+    return neg ? INT32_MIN : INT32_MAX;
+  return neg ? (int32_t)-q : (int32_t)q;
+}
+
+// sqrt(v << F), two bits of the radicand at a time
+template <uint8_t F>
+uint32_t fixedSqrt(uint32_t v)
+{
+  uint8_t bits = 32 + F;
+  uint32_t rem = 0, root = 0;
+
+  if (bits & 1) {
+    if (v >> 31)
+      root = 1;
+    v <<= 1;
+    bits--;
+  }
+  for (; bits; bits -= 2) {
+    rem = (rem << 2) | (v >> 30);
+    v <<= 2;
+    uint32_t t = (root << 2) | 1;
+    root <<= 1;
+    if (rem >= t) {
+      rem -= t;
+      root |= 1;
+    }
+  }
+  return root;
+}
+
+// In Fixed.cpp; angles are radians and results Q16.16. atan2 only
+// depends on the ratio, so y and x may have any scale.
+int32_t fixedSin(int32_t radians);
+int32_t fixedCos(int32_t radians);
+int32_t fixedAtan2(int32_t y, int32_t x);
+
+template <typename T, uint8_t F>
+class Fixed
+{
+  public:
+    static_assert(F > 0 && F < sizeof(T) * 8, "F has to leave an integer bit");
+
+    static constexpr T maxRaw = (T)((((uint32_t)1 << (sizeof(T) * 8 - 1)) - 1));
+    static constexpr T minRaw = -maxRaw - 1;
+
+    constexpr Fixed() : _raw(0) {}
+    constexpr Fixed(int i) : _raw(fromLong(i)) {}
+    constexpr Fixed(long i) : _raw(fromLong(i)) {}
+    constexpr Fixed(double d) : _raw(fromDouble(d)) {}
+    // the same number in another format, saturated
+    template <typename U, uint8_t G>
+    constexpr Fixed(const Fixed<U, G> &other) : _raw(fromQ(other.raw(), G)) {}
+
+    static constexpr Fixed fromRaw(T raw) { return Fixed(raw, 0, 0); }
+    constexpr T raw() const { return _raw; }
+    // rounded toward minus infinity, like floor()
+    constexpr long toInt() const { return _raw >> F; }
+    constexpr float toFloat() const { return _raw * (1.0f / ((uint32_t)1 << F)); }
+
+    friend Fixed operator + (Fixed a, Fixed b)
+    {
+      T r;
+      if (__builtin_add_overflow(a._raw, b._raw, &r))
+        r = b._raw < 0 ? minRaw : maxRaw;
+      return fromRaw(r);
+    }
+    friend Fixed operator - (Fixed a, Fixed b)
+    {
+      T r;
+      if (__builtin_sub_overflow(a._raw, b._raw, &r))
+        r = b._raw < 0 ? maxRaw : minRaw;
+      return fromRaw(r);
+    }
+    friend Fixed operator * (Fixed a, Fixed b) { return fromRaw(fixedMul<F>(a._raw, b._raw)); }
+    friend Fixed operator / (Fixed a, Fixed b) { return fromRaw(fixedDiv<F>(a._raw, b._raw)); }
+    Fixed operator - () const { return fromRaw(_raw == minRaw ? maxRaw : -_raw); }
+
+    Fixed &operator += (Fixed b) { return *this = *this + b; }
+    Fixed &operator -= (Fixed b) { return *this = *this - b; }
+    Fixed &operator *= (Fixed b) { return *this = *this * b; }
+    Fixed &operator /= (Fixed b) { return *this = *this / b; }
+
+    friend bool operator == (Fixed a, Fixed b) { return a._raw == b._raw; }
+    friend bool operator != (Fixed a, Fixed b) { return a._raw != b._raw; }
+    friend bool operator < (Fixed a, Fixed b) { return a._raw < b._raw; }
+    friend bool operator <= (Fixed a, Fixed b) { return a._raw <= b._raw; }
+    friend bool operator > (Fixed a, Fixed b) { return a._raw > b._raw; }
+    friend bool operator >= (Fixed a, Fixed b) { return a._raw >= b._raw; }
+
+  private:
+    constexpr Fixed(T raw, int, int) : _raw(raw) {}
+
+    static constexpr T fromLong(long i)
+    {
+      return i > (maxRaw >> F) ? maxRaw : i < (minRaw >> F) ? minRaw : (T)(i * ((T)1 << F));
+    }
+    static constexpr T fromDouble(double d)
+    {
+      return d * ((uint32_t)1 << F) >= maxRaw ? maxRaw :
+             d * ((uint32_t)1 << F) <= minRaw ? minRaw :
+             (T)(d * ((uint32_t)1 << F) + (d < 0 ? -0.5 : 0.5));
+    }
+    static constexpr T fromQ(long raw, uint8_t g)
+    {
+      return g == F ? (T)raw
+           : g > F ? (T)saturate(((raw >> (g - F - 1)) + 1) >> 1)
+                    : (T)saturate(raw > (maxRaw >> (F - g)) ? maxRaw :
+                                  raw < (minRaw >> (F - g)) ? minRaw :
+                                  raw * ((long)1 << (F - g)));
+    }
+    static constexpr long saturate(long v)
+    {
+      return v > maxRaw ? maxRaw : v < minRaw ? minRaw : v;
+    }
+
+    T _raw;
+};
+
+template <typename T, uint8_t F> constexpr T Fixed<T, F>::maxRaw;
+template <typename T, uint8_t F> constexpr T Fixed<T, F>::minRaw;
+
+typedef Fixed<int16_t, 8> q8_8;
+typedef Fixed<int32_t, 16> q16_16;
+
+template <typename T, uint8_t F>
+Fixed<T, F> sqrt(Fixed<T, F> x)
+{
+  if (x.raw() <= 0)
+    return Fixed<T, F>();
+  return Fixed<T, F>::fromRaw((T)fixedSqrt<F>((uint32_t)x.raw()));
+}
+
+template <typename T, uint8_t F>
+Fixed<T, F> sin(Fixed<T, F> x)
+{
+  return Fixed<T, F>(q16_16::fromRaw(fixedSin(q16_16(x).raw())));
+}
+
+template <typename T, uint8_t F>
+Fixed<T, F> cos(Fixed<T, F> x)
+{
+  return Fixed<T, F>(q16_16::fromRaw(fixedCos(q16_16(x).raw())));
+}
+
+template <typename T, uint8_t F>
+Fixed<T, F> atan2(Fixed<T, F> y, Fixed<T, F> x)
+{
+  return Fixed<T, F>(q16_16::fromRaw(fixedAtan2(y.raw(), x.raw())));
+}
+
+#endif
@@ -0,0 +1,63 @@
+/*
+  FlashString.cpp - read-only view of a string in flash
+  Copyright (c) 2026 Arduino.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "FlashString.h"
+
+bool FlashString::startsWith(const char *prefix) const
+{
+  if (!prefix || !_str) return false;
+  size_t n = strlen(prefix);
+  return n <= _len && memcmp_P(prefix, _str, n) == 0;
+}
+
+int FlashString::indexOf(char c, size_t fromIndex) const
+{
+  for (size_t i = fromIndex; i < _len; i++)
+    if (pgm_read_byte(_str + i) == c)
+      return i;
+  return -1;
+}
+
+int FlashString::indexOf(const char *str, size_t fromIndex) const
+{
+  if (!str) return -1;
+  size_t n = strlen(str);
+  if (n > _len) return -1;
+  for (size_t i = fromIndex; i + n <= _len; i++)
+    if (memcmp_P(str, _str + i, n) == 0)
+      return i;
+  return -1;
+}
+
+// djb2 (h * 33 + c), in 16 bits so it takes shifts and adds on AVR
+uint16_t FlashString::hash() const
+{
+  uint16_t h = 5381;
+  for (size_t i = 0; i < _len; i++)
+    h = (h << 5) + h + (uint8_t)pgm_read_byte(_str + i);
+  return h;
+}
+
+uint16_t FlashString::hash(const char *str, size_t len)
+{
+  uint16_t h = 5381;
+  while (len--)
+    h = (h << 5) + h + (uint8_t)*str++;
+  return h;
+}
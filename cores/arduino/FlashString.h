@@ -0,0 +1,73 @@
+/*
+  FlashString.h - read-only view of a string in flash
+  Copyright (c) 2026 Arduino.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef FlashString_h
+#define FlashString_h
+
+#include <inttypes.h>
+#include <avr/pgmspace.h>
+
+#include "WString.h"
+
+// Wraps a F() or PROGMEM string so it can be compared and searched where
+// it is, with the *_P functions of avr-libc, instead of being copied into a
+// String first. The length is measured once. A FlashString converts to
+// const __FlashStringHelper *, so it can be passed to print() and the
+// String constructor as it is.
+//
+// hash() and the static hash(str, len) for strings in RAM give the same
+// value for the same characters, so a token can be looked up in a PROGMEM
+// table by hash before it is compared.
+class FlashString
+{
+  public:
+    FlashString(const __FlashStringHelper *str)
+      : _str(reinterpret_cast<PGM_P>(str)), _len(str ? strlen_P(_str) : 0) {}
+
+    size_t length() const { return _len; }
+    PGM_P c_str_P() const { return _str; }
+    operator const __FlashStringHelper *() const { return reinterpret_cast<const __FlashStringHelper *>(_str); }
+
+    char charAt(size_t index) const { return index < _len ? pgm_read_byte(_str + index) : 0; }
+    char operator [] (size_t index) const { return charAt(index); }
+
+    bool equals(const char *str) const { return str && _str && strcmp_P(str, _str) == 0; }
+    bool equals(const char *str, size_t len) const { return str && len == _len && memcmp_P(str, _str, len) == 0; }
+    bool equals(const String &str) const { return equals(str.c_str(), str.length()); }
+    bool equalsIgnoreCase(const char *str) const { return str && _str && strcasecmp_P(str, _str) == 0; }
+    bool operator == (const char *str) const { return equals(str); }
+    bool operator != (const char *str) const { return !equals(str); }
+    int compareTo(const char *str) const { return -strcmp_P(str, _str); }
+
+    bool startsWith(const char *prefix) const;
+    // whether str starts with this string, as for a command and its arguments
+    bool isPrefixOf(const char *str) const { return str && _str && strncmp_P(str, _str, _len) == 0; }
+
+    int indexOf(char c, size_t fromIndex = 0) const;
+    int indexOf(const char *str, size_t fromIndex = 0) const;
+
+    uint16_t hash() const;
+    static uint16_t hash(const char *str, size_t len);
+
+  private:
+    PGM_P _str;
+    size_t _len;
+};
+
+#endif
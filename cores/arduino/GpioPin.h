@@ -0,0 +1,99 @@
+/*
+  GpioPin.h - Digital pin handle with the port registers looked up once
+  Copyright (c) 2026 Arduino.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef GpioPin_h
+#define GpioPin_h
+
+#include "Arduino.h"
+
+// Older chips cannot toggle an output by writing a 1 to its PINx bit
+#if defined(__AVR_ATmega8__) || defined(__AVR_ATmega16__) || defined(__AVR_ATmega32__) || \
+    defined(__AVR_ATmega64__) || defined(__AVR_ATmega128__) || defined(__AVR_ATmega8535__)
+#define GPIOPIN_NO_PIN_TOGGLE
+#endif
+
+// Handle for a digital pin that is only known at runtime (digitalWriteFast()
+// covers pins known at compile time). The port registers and bit mask are
+// looked up in the pin tables once, when the handle is created, instead of
+// on every call like digitalWrite() does. Unlike digitalWrite(), set() and
+// clear() do not turn off PWM on the pin.
+//
+// Handles for pins that do not exist point at a dummy register, so using
+// them does nothing.
+class GpioPin
+{
+  public:
+    GpioPin(uint8_t pin)
+    {
+      uint8_t port = digitalPinToPort(pin);
+
+      if (port == NOT_A_PIN) {
+        _in = _mode = _out = dummy();
+        _mask = 0;
+      } else {
+        _in = portInputRegister(port);
+        _mode = portModeRegister(port);
+        _out = portOutputRegister(port);
+        _mask = digitalPinToBitMask(pin);
+      }
+    }
+
+    // Writes to the same port from interrupt handlers are not lost:
+    // every read-modify-write below runs with interrupts disabled.
+    inline void set() { uint8_t oldSREG = SREG; cli(); *_out |= _mask; SREG = oldSREG; }
+    inline void clear() { uint8_t oldSREG = SREG; cli(); *_out &= ~_mask; SREG = oldSREG; }
+    inline void write(uint8_t val) { if (val == LOW) clear(); else set(); }
+#if defined(GPIOPIN_NO_PIN_TOGGLE)
+    inline void toggle() { uint8_t oldSREG = SREG; cli(); *_out ^= _mask; SREG = oldSREG; }
+#else
+    // Writing a 1 to a PINx bit toggles the output, in a single store
+    inline void toggle() { *_in = _mask; }
+#endif
+    inline int read() const { return (*_in & _mask) ? HIGH : LOW; }
+
+    // Same as pinMode(): INPUT, INPUT_PULLUP or OUTPUT
+    void mode(uint8_t mode)
+    {
+      uint8_t oldSREG = SREG;
+      cli();
+      if (mode == OUTPUT) {
+        *_mode |= _mask;
+      } else {
+        *_mode &= ~_mask;
+        if (mode == INPUT_PULLUP)
+          *_out |= _mask;
+        else
+          *_out &= ~_mask;
+      }
+      SREG = oldSREG;
+    }
+
+    inline bool valid() const { return _mask != 0; }
+
+  private:
+    volatile uint8_t *_in;
+    volatile uint8_t *_mode;
+    volatile uint8_t *_out;
+    uint8_t _mask;
+
+    // Target of handles for pins that do not exist
+    static volatile uint8_t *dummy() { static volatile uint8_t reg; return &reg; }
+};
+
+#endif
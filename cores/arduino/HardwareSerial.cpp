@@ -28,6 +28,7 @@
 #include <inttypes.h>
 #include <util/atomic.h>
 #include "Arduino.h"
+#include "Atomic.h"
 
 #include "HardwareSerial.h"
 #include "HardwareSerial_private.h"
@@ -77,21 +78,23 @@ void serialEventRun(void)
 #endif
 }
 
-// macro to guard critical sections when needed for large TX buffer sizes
-#if (SERIAL_TX_BUFFER_SIZE>256)
-#define TX_BUFFER_ATOMIC ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+// macro to guard writes of indexes the interrupt handler reads, when
+// needed for large RX buffer sizes; reads of the indexes the handler
+// writes go through atomicRead() instead (see Atomic.h)
+#if defined(SERIAL_RX_BUFFER_WIDE)
+#define RX_BUFFER_ATOMIC ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
 #else
-#define TX_BUFFER_ATOMIC
+#define RX_BUFFER_ATOMIC
 #endif
 
 // Actual interrupt handlers //////////////////////////////////////////////////////////////
 
-void HardwareSerial::_tx_udr_empty_irq(void)
+HOT_FUNCTION void HardwareSerial::_tx_udr_empty_irq(void)
 {
   // If interrupts are enabled, there must be more data in the output
   // buffer. Send the next byte
   unsigned char c = _tx_buffer[_tx_buffer_tail];
-  _tx_buffer_tail = (_tx_buffer_tail + 1) % SERIAL_TX_BUFFER_SIZE;
+  _tx_buffer_tail = (tx_buffer_index_t)(_tx_buffer_tail + 1) & _tx_buffer_mask;
 
   *_udr = c;
 
@@ -114,22 +117,65 @@ void HardwareSerial::_tx_udr_empty_irq(void)
 
 // Public Methods //////////////////////////////////////////////////////////////
 
+// Returns the UBRR value that gets closest to the given baud rate, with
+// the given number of clock cycles per sample (8 in u2x mode, 16 in
+// normal mode), limited to what fits in the register
+static uint16_t baud_setting_for(unsigned long baud, uint8_t divisor)
+{
+  unsigned long setting = (F_CPU + (unsigned long)divisor / 2 * baud) / ((unsigned long)divisor * baud);
+  if (setting == 0)
+    return 0;
+  if (setting > 4096)
+    return 4095;
+  return setting - 1;
+}
+
+static unsigned long baud_difference(unsigned long a, unsigned long b)
+{
+  return a > b ? a - b : b - a;
+}
+
+// Error of the actual rate against the requested one in per mille,
+// saturated to the range of an int16_t: when UBRR is at its limit, a very
+// low requested rate can be missed by far more than 3276%
+static int16_t baud_error(unsigned long actual, unsigned long requested)
+{
+  unsigned long diff = baud_difference(actual, requested);
+  // diff * 1000 must not overflow
+  unsigned long err = diff < 4294967UL ? diff * 1000 / requested : diff / (requested / 1000 + 1);
+  if (err > 32767)
+    err = 32767;
+  return actual >= requested ? (int16_t)err : -(int16_t)err;
+}
+
 void HardwareSerial::begin(unsigned long baud, byte config)
 {
-  // Try u2x mode first
-  uint16_t baud_setting = (F_CPU / 4 / baud - 1) / 2;
-  *_ucsra = 1 << U2X0;
+  // Evaluate both u2x and normal mode and pick the one that gets closest
+  // to the requested rate. On a tie, normal mode wins, since it samples
+  // every bit more often and so tolerates more clock error and noise.
+  uint16_t setting_u2x = baud_setting_for(baud, 8);
+  uint16_t setting_1x = baud_setting_for(baud, 16);
+  unsigned long baud_u2x = F_CPU / 8 / (setting_u2x + 1);
+  unsigned long baud_1x = F_CPU / 16 / (setting_1x + 1);
+  bool u2x = baud_difference(baud_u2x, baud) < baud_difference(baud_1x, baud);
 
   // hardcoded exception for 57600 for compatibility with the bootloader
   // shipped with the Duemilanove and previous boards and the firmware
-  // on the 8U2 on the Uno and Mega 2560. Also, The baud_setting cannot
-  // be > 4095, so switch back to non-u2x mode if the baud rate is too
-  // low.
-  if (((F_CPU == 16000000UL) && (baud == 57600)) || (baud_setting >4095))
-  {
-    *_ucsra = 0;
-    baud_setting = (F_CPU / 8 / baud - 1) / 2;
-  }
+  // on the 8U2 on the Uno and Mega 2560, which use normal mode for it
+  // even though u2x mode is closer.
+  if ((F_CPU == 16000000UL) && (baud == 57600))
+    u2x = false;
+
+  uint16_t baud_setting = u2x ? setting_u2x : setting_1x;
+  // init() stopped the USART clock
+  usartPower(_ucsrb, true);
+  *_ucsra = u2x ? (1 << U2X0) : 0;
+  _baud = u2x ? baud_u2x : baud_1x;
+  _baud_error = baud_error(_baud, baud);
+
+  // keep waiting for our address in multiprocessor communication mode
+  if (_rx_address >= 0)
+    *_ucsra |= _BV(MPCM0);
 
   // assign the baud_setting, a.k.a. ubrr (USART Baud Rate Register)
   *_ubrrh = baud_setting >> 8;
@@ -137,7 +183,20 @@ void HardwareSerial::begin(unsigned long baud, byte config)
 
   _written = false;
 
+#if SERIAL_RX_FRAMES
+  // Convert the idle time to microseconds, using the actual bit time
+  uint32_t gap = (uint32_t)_rx_frame_idle_bits * (baud_setting + 1) *
+                 ((*_ucsra & _BV(U2X0)) ? 8 : 16) / clockCyclesPerMicrosecond();
+  _rx_frame_gap = (gap > 0xFFFF) ? 0xFFFF : gap;
+#endif
+
   //set the data bits, parity, and stop bits
+  // The 9th data bit is selected in UCSRB, the rest goes to UCSRC
+  if (config & SERIAL_9BIT)
+    sbi(*_ucsrb, UCSZ02);
+  else
+    cbi(*_ucsrb, UCSZ02);
+  config &= ~SERIAL_9BIT;
 #if defined(__AVR_ATmega8__)
   config |= 0x80; // select UCSRC register (shared with UBRRH)
 #endif
@@ -147,6 +206,11 @@ void HardwareSerial::begin(unsigned long baud, byte config)
   sbi(*_ucsrb, TXEN0);
   sbi(*_ucsrb, RXCIE0);
   cbi(*_ucsrb, UDRIE0);
+#if SERIAL_TX_COMPLETE
+  // in half-duplex mode, the transmitter is only on while sending
+  if (_half_duplex)
+    cbi(*_ucsrb, TXEN0);
+#endif
 }
 
 void HardwareSerial::end()
@@ -158,19 +222,131 @@ void HardwareSerial::end()
   cbi(*_ucsrb, TXEN0);
   cbi(*_ucsrb, RXCIE0);
   cbi(*_ucsrb, UDRIE0);
+  cbi(*_ucsrb, TXCIE0);
+  usartPower(_ucsrb, false);
   
   // clear any received data
   _rx_buffer_head = _rx_buffer_tail;
+#if SERIAL_RX_FRAMES
+  _rx_frame_reset();
+#endif
+}
+
+#if SERIAL_RX_CALLBACK
+void HardwareSerial::onReceive(serialRxCallback callback)
+{
+  // A pointer takes two writes, which the ISR must not see halfway
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    _rx_callback = callback;
+  }
+}
+#endif
+
+void HardwareSerial::getErrors(SerialErrors &errors, bool clear)
+{
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    errors = _errors;
+    if (clear)
+      memset(&_errors, 0, sizeof(_errors));
+  }
+}
+
+void HardwareSerial::clearErrors(void)
+{
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    memset(&_errors, 0, sizeof(_errors));
+  }
+}
+
+#if SERIAL_TX_COMPLETE
+void HardwareSerial::setDriverEnablePin(int pin)
+{
+  // Let any transmission in progress finish with the old setting
+  flush();
+
+  if (pin >= 0) {
+    digitalWrite(pin, LOW);
+    pinMode(pin, OUTPUT);
+  }
+
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    cbi(*_ucsrb, TXCIE0);
+    if (pin < 0) {
+      _de_port = NULL;
+    } else {
+      _de_port = portOutputRegister(digitalPinToPort(pin));
+      _de_mask = digitalPinToBitMask(pin);
+    }
+  }
+}
+
+void HardwareSerial::setHalfDuplex(bool enable)
+{
+  // Let any transmission in progress finish with the old setting
+  flush();
+
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    _half_duplex = enable;
+    cbi(*_ucsrb, TXCIE0);
+    // Only touch the transmitter between begin() and end()
+    if (bit_is_set(*_ucsrb, RXEN0)) {
+      if (enable)
+        cbi(*_ucsrb, TXEN0);
+      else
+        sbi(*_ucsrb, TXEN0);
+    }
+  }
+}
+#endif
+
+void HardwareSerial::setAddress(int address)
+{
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    _rx_address = address;
+    // Ignore data frames until our address is seen. Don't write back
+    // TXC, which would clear it.
+    if (address >= 0)
+      *_ucsra = (*_ucsra & _BV(U2X0)) | _BV(MPCM0);
+    else
+      *_ucsra = *_ucsra & _BV(U2X0);
+  }
+}
+
+size_t HardwareSerial::writeAddress(uint8_t address)
+{
+  // The 9th bit applies to whatever is moved into the shift register
+  // next, so all queued data must have left the data register first.
+  // flush() would also wait for the shift register, which isn't needed.
+  _written = true;
+  while (bit_is_set(*_ucsrb, UDRIE0) || bit_is_clear(*_ucsra, UDRE0)) {
+    if (bit_is_clear(SREG, SREG_I) && bit_is_set(*_ucsrb, UDRIE0))
+      if (bit_is_set(*_ucsra, UDRE0))
+        _tx_udr_empty_irq();
+  }
+
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    _de_assert();
+    sbi(*_ucsrb, TXB80);
+    *_udr = address;
+    *_ucsra = ((*_ucsra) & ((1 << U2X0) | (1 << MPCM0))) | (1 << TXC0);
+  }
+
+  // Wait for the address to move to the shift register before the 9th
+  // bit is cleared again for the data that follows
+  while (bit_is_clear(*_ucsra, UDRE0))
+    ;
+  cbi(*_ucsrb, TXB80);
+  return 1;
 }
 
 int HardwareSerial::available(void)
 {
-  return ((unsigned int)(SERIAL_RX_BUFFER_SIZE + _rx_buffer_head - _rx_buffer_tail)) % SERIAL_RX_BUFFER_SIZE;
+  return (rx_buffer_index_t)(atomicRead(_rx_buffer_head) - _rx_buffer_tail) & _rx_buffer_mask;
 }
 
 int HardwareSerial::peek(void)
 {
-  if (_rx_buffer_head == _rx_buffer_tail) {
+  if (atomicRead(_rx_buffer_head) == _rx_buffer_tail) {
     return -1;
   } else {
     return _rx_buffer[_rx_buffer_tail];
@@ -180,26 +356,145 @@ int HardwareSerial::peek(void)
 int HardwareSerial::read(void)
 {
   // if the head isn't ahead of the tail, we don't have any characters
-  if (_rx_buffer_head == _rx_buffer_tail) {
+  if (atomicRead(_rx_buffer_head) == _rx_buffer_tail) {
     return -1;
   } else {
     unsigned char c = _rx_buffer[_rx_buffer_tail];
-    _rx_buffer_tail = (rx_buffer_index_t)(_rx_buffer_tail + 1) % SERIAL_RX_BUFFER_SIZE;
+    _rx_buffer_tail = (rx_buffer_index_t)(_rx_buffer_tail + 1) & _rx_buffer_mask;
     return c;
   }
 }
 
+size_t HardwareSerial::read(uint8_t *buffer, size_t size)
+{
+  // Only the ISR moves the head, only we move the tail
+  rx_buffer_index_t tail = _rx_buffer_tail;
+  rx_buffer_index_t head;
+
+  head = atomicRead(_rx_buffer_head);
+  rx_buffer_index_t count = (rx_buffer_index_t)(head - tail) & _rx_buffer_mask;
+  if (count > size)
+    count = size;
+
+  _rx_copy(buffer, tail, count);
+
+  RX_BUFFER_ATOMIC {
+    _rx_buffer_tail = (rx_buffer_index_t)(tail + count) & _rx_buffer_mask;
+  }
+  return count;
+}
+
+void HardwareSerial::_rx_copy(uint8_t *buffer, rx_buffer_index_t tail, rx_buffer_index_t count)
+{
+  // Copy in at most two contiguous chunks: up to the end of the buffer
+  // and then from its start.
+  unsigned int to_end = (unsigned int)_rx_buffer_mask + 1 - tail;
+  if (count <= to_end) {
+    memcpy(buffer, _rx_buffer + tail, count);
+  } else {
+    memcpy(buffer, _rx_buffer + tail, to_end);
+    memcpy(buffer + to_end, _rx_buffer, count - to_end);
+  }
+}
+
+size_t HardwareSerial::readBytes(char *buffer, size_t length)
+{
+  size_t count = 0;
+  bool waiting = false;
+
+  while (count < length) {
+    size_t n = read((uint8_t *)buffer + count, length - count);
+    if (n) {
+      count += n;
+      waiting = false;
+      continue;
+    }
+    // Nothing buffered, so only now look at the clock. As with
+    // Stream::timedRead(), the timeout restarts for every character.
+    if (!waiting) {
+      _startMillis = millis();
+      waiting = true;
+    } else if (millis() - _startMillis >= _timeout) {
+      break;
+    }
+  }
+  return count;
+}
+
+#if SERIAL_RX_FRAMES
+void HardwareSerial::_rx_frame_reset(void)
+{
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    _rx_buffer_tail = _rx_buffer_head;
+    _rx_frame_start = _rx_buffer_head;
+    _rx_frames_tail = _rx_frames_head;
+    _rx_frame_overflow = false;
+  }
+}
+
+void HardwareSerial::setFrameDelimiter(int delimiter)
+{
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    _rx_frame_delimiter = delimiter;
+  }
+  _rx_frame_reset();
+}
+
+void HardwareSerial::setFrameIdleBits(uint8_t bits)
+{
+  _rx_frame_idle_bits = bits;
+  if (!bits) {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+      _rx_frame_gap = 0;
+    }
+  }
+  _rx_frame_reset();
+}
+
+int HardwareSerial::availableFrames(void)
+{
+  // The interrupt can only end a frame in idle mode when the next one
+  // starts, so check here whether the line has gone idle since.
+  if (_rx_frame_gap) {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+      if (micros() - _rx_frame_last >= _rx_frame_gap)
+        _rx_frame_end();
+    }
+  }
+  return (uint8_t)(_rx_frames_head - _rx_frames_tail) & (SERIAL_RX_FRAMES - 1);
+}
+
+size_t HardwareSerial::readFrame(uint8_t *buffer, size_t size)
+{
+  if (!availableFrames())
+    return 0;
+
+  uint8_t frame = _rx_frames_tail;
+  rx_buffer_index_t end = _rx_frame_ends[frame];
+  rx_buffer_index_t tail = _rx_buffer_tail;
+  rx_buffer_index_t count = (rx_buffer_index_t)(end - tail) & _rx_buffer_mask;
+  if (count > size)
+    count = size;
+
+  _rx_copy(buffer, tail, count);
+
+  RX_BUFFER_ATOMIC {
+    _rx_buffer_tail = end;
+  }
+  _rx_frames_tail = (frame + 1) & (SERIAL_RX_FRAMES - 1);
+  return count;
+}
+#endif
+
 int HardwareSerial::availableForWrite(void)
 {
   tx_buffer_index_t head;
   tx_buffer_index_t tail;
 
-  TX_BUFFER_ATOMIC {
-    head = _tx_buffer_head;
-    tail = _tx_buffer_tail;
-  }
-  if (head >= tail) return SERIAL_TX_BUFFER_SIZE - 1 - head + tail;
-  return tail - head - 1;
+  // only the interrupt handler moves the tail
+  head = _tx_buffer_head;
+  tail = atomicRead(_tx_buffer_tail);
+  return (tx_buffer_index_t)(tail - head - 1) & _tx_buffer_mask;
 }
 
 void HardwareSerial::flush()
@@ -210,6 +505,26 @@ void HardwareSerial::flush()
   if (!_written)
     return;
 
+#if SERIAL_TX_COMPLETE
+  if (_de_port || _half_duplex) {
+    // In RS-485 and half-duplex mode, the TX complete interrupt clears
+    // TXC, so wait for it to release the bus (and disable itself) instead.
+    while (bit_is_set(*_ucsrb, UDRIE0) || bit_is_set(*_ucsrb, TXCIE0)) {
+      if (bit_is_clear(SREG, SREG_I)) {
+        // Interrupts are globally disabled, so run the handlers
+        // ourselves to prevent deadlock (see below)
+        if (bit_is_set(*_ucsrb, UDRIE0)) {
+          if (bit_is_set(*_ucsra, UDRE0))
+            _tx_udr_empty_irq();
+        } else if (bit_is_set(*_ucsra, TXC0)) {
+          _tx_complete_irq();
+        }
+      }
+    }
+    return;
+  }
+#endif
+
   while (bit_is_set(*_ucsrb, UDRIE0) || bit_is_clear(*_ucsra, TXC0)) {
     if (bit_is_clear(SREG, SREG_I) && bit_is_set(*_ucsrb, UDRIE0))
 	// Interrupts are globally disabled, but the DR empty
@@ -239,6 +554,7 @@ size_t HardwareSerial::write(uint8_t c)
     // is transmitted (setting TXC) before clearing TXC. Then TXC will
     // be cleared when no bytes are left, causing flush() to hang
     ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+      _de_assert();
       *_udr = c;
 #ifdef MPCM0
       *_ucsra = ((*_ucsra) & ((1 << U2X0) | (1 << MPCM0))) | (1 << TXC0);
@@ -248,7 +564,7 @@ size_t HardwareSerial::write(uint8_t c)
     }
     return 1;
   }
-  tx_buffer_index_t i = (_tx_buffer_head + 1) % SERIAL_TX_BUFFER_SIZE;
+  tx_buffer_index_t i = (tx_buffer_index_t)(_tx_buffer_head + 1) & _tx_buffer_mask;
 	
   // If the output buffer is full, there's nothing for it other than to 
   // wait for the interrupt handler to empty it a bit
@@ -271,6 +587,7 @@ size_t HardwareSerial::write(uint8_t c)
   // head pointer and setting the interrupt flag resulting in buffer
   // retransmission
   ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    _de_assert();
     _tx_buffer_head = i;
     sbi(*_ucsrb, UDRIE0);
   }
@@ -278,4 +595,52 @@ size_t HardwareSerial::write(uint8_t c)
   return 1;
 }
 
+size_t HardwareSerial::write(const uint8_t *buffer, size_t size)
+{
+  size_t n = size;
+
+  _written = true;
+  while (n) {
+    // Only this function and write(uint8_t) move the head, so it can be
+    // read without protection. The tail is moved by the ISR.
+    tx_buffer_index_t head = _tx_buffer_head;
+    tx_buffer_index_t tail;
+
+    tail = atomicRead(_tx_buffer_tail);
+    tx_buffer_index_t space = (tx_buffer_index_t)(tail - head - 1) & _tx_buffer_mask;
+
+    if (space == 0) {
+      // Buffer full, wait for the interrupt handler to empty it a bit,
+      // or poll the data register empty flag ourselves when interrupts
+      // are disabled (see write(uint8_t)).
+      if (bit_is_clear(SREG, SREG_I) && bit_is_set(*_ucsra, UDRE0))
+        _tx_udr_empty_irq();
+      continue;
+    }
+
+    // Copy as much as fits, in at most two contiguous chunks: up to the
+    // end of the buffer and then from its start.
+    tx_buffer_index_t count = (n < space) ? n : space;
+    unsigned int to_end = (unsigned int)_tx_buffer_mask + 1 - head;
+    if (count <= to_end) {
+      memcpy(_tx_buffer + head, buffer, count);
+    } else {
+      memcpy(_tx_buffer + head, buffer, to_end);
+      memcpy(_tx_buffer, buffer + to_end, count - to_end);
+    }
+    buffer += count;
+    n -= count;
+
+    // Publish all new bytes at once. As in write(uint8_t), this must be
+    // atomic with enabling the interrupt.
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+      _de_assert();
+      _tx_buffer_head = (tx_buffer_index_t)(head + count) & _tx_buffer_mask;
+      sbi(*_ucsrb, UDRIE0);
+    }
+  }
+
+  return size;
+}
+
 #endif // whole file
@@ -27,13 +27,15 @@
 #include <inttypes.h>
 
 #include "Stream.h"
+#include "RingBuffer.h"
 
 // Define constants and variables for buffering incoming serial data.  We're
-// using a ring buffer (I think), in which head is the index of the location
-// to which to write the next incoming character and tail is the index of the
+// using a ring buffer, in which head is the index of the location to which
+// to write the next incoming character and tail is the index of the
 // location from which to read.
-// NOTE: a "power of 2" buffer size is reccomended to dramatically
-//       optimize all the modulo operations for ring buffers.
+// NOTE: buffer sizes must be a power of 2, so that advancing an index is a
+//       single AND with the buffer mask instead of a division (enforced
+//       by RingIndex where the buffers are declared).
 // WARNING: When buffer sizes are increased to > 256, the buffer index
 // variables are automatically increased in size, but the extra
 // atomicity guards needed for that are not implemented. This will
@@ -53,12 +55,50 @@
 #define SERIAL_RX_BUFFER_SIZE 64
 #endif
 #endif
-#if (SERIAL_TX_BUFFER_SIZE>256)
+
+// Each port can be given its own buffer sizes, e.g. to give a busy
+// Serial1 a large receive buffer without spending the same RAM on the
+// other (idle) ports. Ports that are not configured explicitly use
+// SERIAL_TX_BUFFER_SIZE / SERIAL_RX_BUFFER_SIZE.
+#if !defined(SERIAL0_TX_BUFFER_SIZE)
+#define SERIAL0_TX_BUFFER_SIZE SERIAL_TX_BUFFER_SIZE
+#endif
+#if !defined(SERIAL0_RX_BUFFER_SIZE)
+#define SERIAL0_RX_BUFFER_SIZE SERIAL_RX_BUFFER_SIZE
+#endif
+#if !defined(SERIAL1_TX_BUFFER_SIZE)
+#define SERIAL1_TX_BUFFER_SIZE SERIAL_TX_BUFFER_SIZE
+#endif
+#if !defined(SERIAL1_RX_BUFFER_SIZE)
+#define SERIAL1_RX_BUFFER_SIZE SERIAL_RX_BUFFER_SIZE
+#endif
+#if !defined(SERIAL2_TX_BUFFER_SIZE)
+#define SERIAL2_TX_BUFFER_SIZE SERIAL_TX_BUFFER_SIZE
+#endif
+#if !defined(SERIAL2_RX_BUFFER_SIZE)
+#define SERIAL2_RX_BUFFER_SIZE SERIAL_RX_BUFFER_SIZE
+#endif
+#if !defined(SERIAL3_TX_BUFFER_SIZE)
+#define SERIAL3_TX_BUFFER_SIZE SERIAL_TX_BUFFER_SIZE
+#endif
+#if !defined(SERIAL3_RX_BUFFER_SIZE)
+#define SERIAL3_RX_BUFFER_SIZE SERIAL_RX_BUFFER_SIZE
+#endif
+
+// All ports share the same index type, so a single port with a buffer
+// of more than 256 bytes switches all of them to 16-bit indices.
+#if (SERIAL_TX_BUFFER_SIZE>256) || (SERIAL0_TX_BUFFER_SIZE>256) || \
+    (SERIAL1_TX_BUFFER_SIZE>256) || (SERIAL2_TX_BUFFER_SIZE>256) || \
+    (SERIAL3_TX_BUFFER_SIZE>256)
+#define SERIAL_TX_BUFFER_WIDE
 typedef uint16_t tx_buffer_index_t;
 #else
 typedef uint8_t tx_buffer_index_t;
 #endif
-#if  (SERIAL_RX_BUFFER_SIZE>256)
+#if (SERIAL_RX_BUFFER_SIZE>256) || (SERIAL0_RX_BUFFER_SIZE>256) || \
+    (SERIAL1_RX_BUFFER_SIZE>256) || (SERIAL2_RX_BUFFER_SIZE>256) || \
+    (SERIAL3_RX_BUFFER_SIZE>256)
+#define SERIAL_RX_BUFFER_WIDE
 typedef uint16_t rx_buffer_index_t;
 #else
 typedef uint8_t rx_buffer_index_t;
@@ -89,6 +129,60 @@ typedef uint8_t rx_buffer_index_t;
 #define SERIAL_6O2 0x3A
 #define SERIAL_7O2 0x3C
 #define SERIAL_8O2 0x3E
+// 9-bit frames, e.g. for multiprocessor communication (see setAddress()).
+// These are the 8-bit configs with SERIAL_9BIT added.
+#define SERIAL_9BIT 0x01
+#define SERIAL_9N1 0x07
+#define SERIAL_9N2 0x0F
+#define SERIAL_9E1 0x27
+#define SERIAL_9E2 0x2F
+#define SERIAL_9O1 0x37
+#define SERIAL_9O2 0x3F
+
+// Error flags passed to the receive callback. These are the bits of the
+// UCSRnA register, which are at the same position on all supported chips.
+#define SERIAL_PARITY_ERROR  0x04
+#define SERIAL_OVERRUN_ERROR 0x08
+#define SERIAL_FRAME_ERROR   0x10
+
+// Receive error counters of a port, see HardwareSerial::getErrors()
+struct SerialErrors {
+  uint16_t frame;      // stop bit missing, usually a baud rate mismatch
+  uint16_t parity;     // parity error, the byte was dropped
+  uint16_t overrun;    // bytes lost because the interrupt came too late
+  uint16_t overflow;   // bytes (or frames) lost because the buffer was full
+};
+
+// Build with SERIAL_RX_CALLBACK set to 1 for onReceive(). It is off by
+// default: calling a function from the receive interrupt makes the
+// compiler save all call-clobbered registers in it, which every received
+// byte would pay for even when no callback is set, as well as the RAM
+// for the pointer in each port.
+#if !defined(SERIAL_RX_CALLBACK)
+#define SERIAL_RX_CALLBACK 0
+#endif
+
+// Build with SERIAL_TX_COMPLETE set to 1 for setDriverEnablePin() and
+// setHalfDuplex(). Both need the TX complete interrupt, whose vector
+// (and the code it pulls in) would otherwise be linked into every sketch
+// using a port, so it is off by default.
+#if !defined(SERIAL_TX_COMPLETE)
+#define SERIAL_TX_COMPLETE 0
+#endif
+
+// Number of entries in the queue of received frame boundaries used by
+// the framed receive mode, so up to SERIAL_RX_FRAMES - 1 complete frames
+// can be waiting to be read. Must be a power of 2. Set to 0 to remove
+// the framed receive mode (and the RAM it uses) altogether.
+#if !defined(SERIAL_RX_FRAMES)
+#define SERIAL_RX_FRAMES 4
+#endif
+
+// Called from the receive interrupt with every received byte and its
+// error flags (SERIAL_*_ERROR), before the byte is put in the receive
+// buffer. Return true to have the byte buffered as usual, or false to
+// drop it (e.g. because the callback already handled it).
+typedef bool (*serialRxCallback)(uint8_t data, uint8_t errors);
 
 class HardwareSerial : public Stream
 {
@@ -101,42 +195,167 @@ class HardwareSerial : public Stream
     volatile uint8_t * const _udr;
     // Has any byte been written to the UART since begin()
     bool _written;
+    // Baud rate actually set by begin(), and its error in 0.1% units
+    unsigned long _baud;
+    int16_t _baud_error;
 
     volatile rx_buffer_index_t _rx_buffer_head;
     volatile rx_buffer_index_t _rx_buffer_tail;
     volatile tx_buffer_index_t _tx_buffer_head;
     volatile tx_buffer_index_t _tx_buffer_tail;
 
-    // Don't put any members after these buffers, since only the first
-    // 32 bytes of this struct can be accessed quickly using the ldd
-    // instruction.
-    unsigned char _rx_buffer[SERIAL_RX_BUFFER_SIZE];
-    unsigned char _tx_buffer[SERIAL_TX_BUFFER_SIZE];
+    // The buffers themselves live next to each instance (see
+    // HardwareSerial0.cpp and friends), so every port can have its own
+    // size. The masks are the buffer sizes minus one.
+    unsigned char * const _rx_buffer;
+    unsigned char * const _tx_buffer;
+    const rx_buffer_index_t _rx_buffer_mask;
+    const tx_buffer_index_t _tx_buffer_mask;
+
+#if SERIAL_RX_CALLBACK
+    volatile serialRxCallback _rx_callback;
+#endif
+
+    SerialErrors _errors;
+
+    // Our address in multiprocessor communication mode, or -1
+    int16_t _rx_address;
+
+#if SERIAL_TX_COMPLETE
+    // RS-485 driver enable pin, or NULL when not in RS-485 mode
+    volatile uint8_t *_de_port;
+    uint8_t _de_mask;
+    // Single-wire half-duplex mode, see setHalfDuplex()
+    bool _half_duplex;
+    inline void _de_assert(void);
+#else
+    inline void _de_assert(void) { }
+#endif
+
+#if SERIAL_RX_FRAMES
+    // Framed receive mode. _rx_frame_ends holds the buffer index just
+    // past the end of each complete frame, _rx_frame_start is where the
+    // frame that is currently being received began.
+    int16_t _rx_frame_delimiter;
+    uint8_t _rx_frame_idle_bits;
+    uint16_t _rx_frame_gap;
+    volatile unsigned long _rx_frame_last;
+    volatile bool _rx_frame_overflow;
+    volatile rx_buffer_index_t _rx_frame_start;
+    volatile uint8_t _rx_frames_head;
+    volatile uint8_t _rx_frames_tail;
+    volatile rx_buffer_index_t _rx_frame_ends[SERIAL_RX_FRAMES];
+
+    inline void _rx_frame_end(void);
+    void _rx_frame_reset(void);
+#endif
+
+    void _rx_copy(uint8_t *buffer, rx_buffer_index_t tail, rx_buffer_index_t count);
 
   public:
     inline HardwareSerial(
       volatile uint8_t *ubrrh, volatile uint8_t *ubrrl,
       volatile uint8_t *ucsra, volatile uint8_t *ucsrb,
-      volatile uint8_t *ucsrc, volatile uint8_t *udr);
+      volatile uint8_t *ucsrc, volatile uint8_t *udr,
+      unsigned char *rx_buffer, unsigned int rx_buffer_size,
+      unsigned char *tx_buffer, unsigned int tx_buffer_size);
     void begin(unsigned long baud) { begin(baud, SERIAL_8N1); }
     void begin(unsigned long, uint8_t);
+    // Waits for a character, measures the baud rate from its bits and
+    // calls begin() with that. The character itself is lost, so the other
+    // side should send one with single bits in it first, such as 'U'.
+    // Returns the baud rate, or 0 after timeout ms (0 waits forever) or
+    // when Timer1 is in use. Works up to 115200 baud at 16 MHz.
+    unsigned long beginAutoBaud(uint8_t config = SERIAL_8N1, unsigned long timeout = 0);
     void end();
+    // The baud rate that begin() could actually set up, and how far that
+    // is off from the requested rate, in units of 0.1% (positive when
+    // faster than requested). Most receivers cope with up to about 2%.
+    unsigned long getBaudRate(void) { return _baud; }
+    int getBaudError(void) { return _baud_error; }
     virtual int available(void);
     virtual int peek(void);
     virtual int read(void);
+    // Copies up to size bytes that are already in the receive buffer,
+    // without waiting. Returns the number of bytes copied.
+    size_t read(uint8_t *buffer, size_t size);
+    // Same as Stream::readBytes(), but copies directly out of the receive
+    // buffer and only checks the timeout while the buffer is empty.
+    size_t readBytes(char *buffer, size_t length);
+    size_t readBytes(uint8_t *buffer, size_t length) { return readBytes((char *)buffer, length); }
     virtual int availableForWrite(void);
     virtual void flush(void);
     virtual size_t write(uint8_t);
+    virtual size_t write(const uint8_t *buffer, size_t size);
     inline size_t write(unsigned long n) { return write((uint8_t)n); }
     inline size_t write(long n) { return write((uint8_t)n); }
     inline size_t write(unsigned int n) { return write((uint8_t)n); }
     inline size_t write(int n) { return write((uint8_t)n); }
-    using Print::write; // pull in write(str) and write(buf, size) from Print
+    using Print::write; // pull in write(str) and write(char*, size) from Print
     operator bool() { return true; }
 
+#if SERIAL_RX_CALLBACK
+    // Sets the function to call from the receive interrupt, or NULL
+    void onReceive(serialRxCallback callback);
+#endif
+
+    // Copies the receive error counters (all of them at the same moment)
+    // and optionally resets them to zero. Counters wrap around at 65535.
+    void getErrors(SerialErrors &errors, bool clear = false);
+    void clearErrors(void);
+
+#if SERIAL_TX_COMPLETE
+    // RS-485 mode: the given pin is driven high before any data is sent,
+    // and driven low again by the TX complete interrupt once the last
+    // byte has left the shift register, so writes never have to wait for
+    // the bus turnaround.
+    void setDriverEnablePin(int pin);   // -1 to disable
+
+    // Single-wire half-duplex mode, for buses where TX and RX share one
+    // line (smart servos and the like). The transmitter is only enabled
+    // while data goes out, with the receiver disabled meanwhile so the
+    // local echo is never received. The TX complete interrupt switches
+    // back to receiving right after the last stop bit, so a reply can be
+    // read without calling flush(). The TX pin is released while
+    // receiving, so the line needs a pull-up (pinMode(tx, INPUT_PULLUP)
+    // or an external one). Can be combined with setDriverEnablePin().
+    void setHalfDuplex(bool enable);
+#endif
+
+    // Multiprocessor communication mode, for multidrop buses using 9-bit
+    // frames (begin() with one of the SERIAL_9xx configs). Frames with
+    // the 9th bit set carry an address, and after setAddress() the
+    // hardware ignores all data frames until an address frame for this
+    // port arrives. The data up to the next address frame is received as
+    // usual; address frames themselves are not stored (in framed mode,
+    // they also end the current frame).
+    void setAddress(int address);   // -1 to disable
+    // Sends an address frame (9th bit set), after waiting for any data
+    // that is still queued to go out.
+    size_t writeAddress(uint8_t address);
+
+#if SERIAL_RX_FRAMES
+    // Framed receive mode: the receive interrupt splits the incoming data
+    // into frames, which can then be read as a whole with readFrame().
+    // A frame ends at a delimiter byte (which is not stored), or when the
+    // line has been idle for the given number of bit times, or both.
+    // Empty frames are skipped, and frames that do not fit in the buffer
+    // or the frame queue are dropped whole. Changing either setting
+    // discards all received data. Don't mix with read() or readBytes().
+    void setFrameDelimiter(int delimiter); // -1 to disable
+    void setFrameIdleBits(uint8_t bits);   // 0 to disable, applied by begin()
+    int availableFrames(void);
+    // Copies the next frame into buffer and returns the number of bytes
+    // copied. When the frame is larger than size, the rest is discarded.
+    size_t readFrame(uint8_t *buffer, size_t size);
+#endif
+
     // Interrupt handlers - Not intended to be called externally
     inline void _rx_complete_irq(void);
     void _tx_udr_empty_irq(void);
+#if SERIAL_TX_COMPLETE
+    inline void _tx_complete_irq(void);
+#endif
 };
 
 #if defined(UBRRH) || defined(UBRR0H)
@@ -25,6 +25,7 @@
 #include "Arduino.h"
 #include "HardwareSerial.h"
 #include "HardwareSerial_private.h"
+#include "Profile.h"
 
 // Each HardwareSerial is defined in its own file, sine the linker pulls
 // in the entire file when any element inside is used. --gc-sections can
@@ -37,18 +38,37 @@
 #if defined(HAVE_HWSERIAL0)
 
 #if defined(USART_RX_vect)
-  ISR(USART_RX_vect)
+  ISR(USART_RX_vect, HOT_FUNCTION)
 #elif defined(USART0_RX_vect)
-  ISR(USART0_RX_vect)
+  ISR(USART0_RX_vect, HOT_FUNCTION)
 #elif defined(USART_RXC_vect)
-  ISR(USART_RXC_vect) // ATmega8
+  ISR(USART_RXC_vect, HOT_FUNCTION) // ATmega8
 #else
   #error "Don't know what the Data Received vector is called for Serial"
 #endif
   {
+    PROFILE_SCOPE(PROFILE_SERIAL0_RX);
+    TRACE_SCOPE(SERIAL_RX);
     Serial._rx_complete_irq();
   }
 
+#if SERIAL_TX_COMPLETE
+#if defined(USART_TX_vect)
+ISR(USART_TX_vect)
+#elif defined(USART0_TX_vect)
+ISR(USART0_TX_vect)
+#elif defined(UART0_TX_vect)
+ISR(UART0_TX_vect)
+#elif defined(USART_TXC_vect)
+ISR(USART_TXC_vect) // ATmega8
+#else
+  #error "Don't know what the Transmit Complete vector is called for Serial"
+#endif
+{
+  Serial._tx_complete_irq();
+}
+#endif
+
 #if defined(UART0_UDRE_vect)
 ISR(UART0_UDRE_vect)
 #elif defined(UART_UDRE_vect)
@@ -61,13 +81,21 @@ ISR(USART_UDRE_vect)
   #error "Don't know what the Data Register Empty vector is called for Serial"
 #endif
 {
+  PROFILE_SCOPE(PROFILE_SERIAL0_UDRE);
+  TRACE_SCOPE(SERIAL_UDRE);
   Serial._tx_udr_empty_irq();
 }
 
+HWSERIAL_BUFFERS(Serial0, SERIAL0_RX_BUFFER_SIZE, SERIAL0_TX_BUFFER_SIZE)
+
 #if defined(UBRRH) && defined(UBRRL)
-  HardwareSerial Serial(&UBRRH, &UBRRL, &UCSRA, &UCSRB, &UCSRC, &UDR);
+  HardwareSerial Serial(&UBRRH, &UBRRL, &UCSRA, &UCSRB, &UCSRC, &UDR,
+    Serial0_rx_buffer, SERIAL0_RX_BUFFER_SIZE,
+    Serial0_tx_buffer, SERIAL0_TX_BUFFER_SIZE);
 #else
-  HardwareSerial Serial(&UBRR0H, &UBRR0L, &UCSR0A, &UCSR0B, &UCSR0C, &UDR0);
+  HardwareSerial Serial(&UBRR0H, &UBRR0L, &UCSR0A, &UCSR0B, &UCSR0C, &UDR0,
+    Serial0_rx_buffer, SERIAL0_RX_BUFFER_SIZE,
+    Serial0_tx_buffer, SERIAL0_TX_BUFFER_SIZE);
 #endif
 
 // Function that can be weakly referenced by serialEventRun to prevent
@@ -25,6 +25,7 @@
 #include "Arduino.h"
 #include "HardwareSerial.h"
 #include "HardwareSerial_private.h"
+#include "Profile.h"
 
 // Each HardwareSerial is defined in its own file, sine the linker pulls
 // in the entire file when any element inside is used. --gc-sections can
@@ -37,13 +38,15 @@
 #if defined(HAVE_HWSERIAL1)
 
 #if defined(UART1_RX_vect)
-ISR(UART1_RX_vect)
+ISR(UART1_RX_vect, HOT_FUNCTION)
 #elif defined(USART1_RX_vect)
-ISR(USART1_RX_vect)
+ISR(USART1_RX_vect, HOT_FUNCTION)
 #else
 #error "Don't know what the Data Register Empty vector is called for Serial1"
 #endif
 {
+  PROFILE_SCOPE(PROFILE_SERIAL1_RX);
+  TRACE_SCOPE(SERIAL_RX);
   Serial1._rx_complete_irq();
 }
 
@@ -55,10 +58,29 @@ ISR(USART1_UDRE_vect)
 #error "Don't know what the Data Register Empty vector is called for Serial1"
 #endif
 {
+  PROFILE_SCOPE(PROFILE_SERIAL1_UDRE);
+  TRACE_SCOPE(SERIAL_UDRE);
   Serial1._tx_udr_empty_irq();
 }
 
-HardwareSerial Serial1(&UBRR1H, &UBRR1L, &UCSR1A, &UCSR1B, &UCSR1C, &UDR1);
+#if SERIAL_TX_COMPLETE
+#if defined(UART1_TX_vect)
+ISR(UART1_TX_vect)
+#elif defined(USART1_TX_vect)
+ISR(USART1_TX_vect)
+#else
+#error "Don't know what the Transmit Complete vector is called for Serial1"
+#endif
+{
+  Serial1._tx_complete_irq();
+}
+#endif
+
+HWSERIAL_BUFFERS(Serial1, SERIAL1_RX_BUFFER_SIZE, SERIAL1_TX_BUFFER_SIZE)
+
+HardwareSerial Serial1(&UBRR1H, &UBRR1L, &UCSR1A, &UCSR1B, &UCSR1C, &UDR1,
+    Serial1_rx_buffer, SERIAL1_RX_BUFFER_SIZE,
+    Serial1_tx_buffer, SERIAL1_TX_BUFFER_SIZE);
 
 // Function that can be weakly referenced by serialEventRun to prevent
 // pulling in this file if it's not otherwise used.
@@ -25,6 +25,7 @@
 #include "Arduino.h"
 #include "HardwareSerial.h"
 #include "HardwareSerial_private.h"
+#include "Profile.h"
 
 // Each HardwareSerial is defined in its own file, sine the linker pulls
 // in the entire file when any element inside is used. --gc-sections can
@@ -36,17 +37,32 @@
 
 #if defined(HAVE_HWSERIAL2)
 
-ISR(USART2_RX_vect)
+ISR(USART2_RX_vect, HOT_FUNCTION)
 {
+  PROFILE_SCOPE(PROFILE_SERIAL2_RX);
+  TRACE_SCOPE(SERIAL_RX);
   Serial2._rx_complete_irq();
 }
 
 ISR(USART2_UDRE_vect)
 {
+  PROFILE_SCOPE(PROFILE_SERIAL2_UDRE);
+  TRACE_SCOPE(SERIAL_UDRE);
   Serial2._tx_udr_empty_irq();
 }
 
-HardwareSerial Serial2(&UBRR2H, &UBRR2L, &UCSR2A, &UCSR2B, &UCSR2C, &UDR2);
+#if SERIAL_TX_COMPLETE
+ISR(USART2_TX_vect)
+{
+  Serial2._tx_complete_irq();
+}
+#endif
+
+HWSERIAL_BUFFERS(Serial2, SERIAL2_RX_BUFFER_SIZE, SERIAL2_TX_BUFFER_SIZE)
+
+HardwareSerial Serial2(&UBRR2H, &UBRR2L, &UCSR2A, &UCSR2B, &UCSR2C, &UDR2,
+    Serial2_rx_buffer, SERIAL2_RX_BUFFER_SIZE,
+    Serial2_tx_buffer, SERIAL2_TX_BUFFER_SIZE);
 
 // Function that can be weakly referenced by serialEventRun to prevent
 // pulling in this file if it's not otherwise used.
@@ -25,6 +25,7 @@
 #include "Arduino.h"
 #include "HardwareSerial.h"
 #include "HardwareSerial_private.h"
+#include "Profile.h"
 
 // Each HardwareSerial is defined in its own file, sine the linker pulls
 // in the entire file when any element inside is used. --gc-sections can
@@ -36,17 +37,32 @@
 
 #if defined(HAVE_HWSERIAL3)
 
-ISR(USART3_RX_vect)
+ISR(USART3_RX_vect, HOT_FUNCTION)
 {
+  PROFILE_SCOPE(PROFILE_SERIAL3_RX);
+  TRACE_SCOPE(SERIAL_RX);
   Serial3._rx_complete_irq();
 }
 
 ISR(USART3_UDRE_vect)
 {
+  PROFILE_SCOPE(PROFILE_SERIAL3_UDRE);
+  TRACE_SCOPE(SERIAL_UDRE);
   Serial3._tx_udr_empty_irq();
 }
 
-HardwareSerial Serial3(&UBRR3H, &UBRR3L, &UCSR3A, &UCSR3B, &UCSR3C, &UDR3);
+#if SERIAL_TX_COMPLETE
+ISR(USART3_TX_vect)
+{
+  Serial3._tx_complete_irq();
+}
+#endif
+
+HWSERIAL_BUFFERS(Serial3, SERIAL3_RX_BUFFER_SIZE, SERIAL3_TX_BUFFER_SIZE)
+
+HardwareSerial Serial3(&UBRR3H, &UBRR3L, &UCSR3A, &UCSR3B, &UCSR3C, &UDR3,
+    Serial3_rx_buffer, SERIAL3_RX_BUFFER_SIZE,
+    Serial3_tx_buffer, SERIAL3_TX_BUFFER_SIZE);
 
 // Function that can be weakly referenced by serialEventRun to prevent
 // pulling in this file if it's not otherwise used.
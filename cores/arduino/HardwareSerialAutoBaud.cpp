@@ -0,0 +1,228 @@
+/*
+  HardwareSerialAutoBaud.cpp - Baud rate detection for HardwareSerial
+  Copyright (c) 2026 Arduino.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+// beginAutoBaud() times the edges of the first character on the RXD pin
+// with Timer1 counting clock cycles, before the USART is turned on. All
+// edges of a character are a whole number of bits apart, so the shortest
+// interval is one bit as long as the character has a single 0 or 1 bit
+// somewhere, which is the case for nearly all text ('U', 0x55, is all
+// single bits, if the other side can send a sync character). Each
+// interval is rounded to whole bits of that length, and dividing the
+// time from the first to the last edge by the sum then evens out the
+// few cycles of polling jitter of each edge. Rates within 4% of a
+// standard rate are taken as that rate, and begin() picks the closest
+// UBRR setting as usual. The jitter is what limits the rate: detection
+// is reliable up to 115200 baud at 16 MHz, 57600 at 8 MHz.
+//
+// After the first edge, interrupts are disabled until the character is
+// over, so at low rates millis() may miss a Timer0 overflow. The
+// character used for the measurement is lost. This file is only linked
+// in when beginAutoBaud() is used.
+
+#include "Arduino.h"
+#include "HardwareSerial.h"
+#include "wiring_private.h"
+
+#if defined(TCCR1A) && defined(TCCR1B) && defined(TCNT1)
+
+#if defined(TIFR1)
+#define AUTOBAUD_TIFR TIFR1
+#else
+#define AUTOBAUD_TIFR TIFR
+#endif
+
+// at most 12 edges in a frame of 12 bits
+#define AUTOBAUD_EDGES 12
+
+// Polling iterations longer than this had an interrupt in them
+#define AUTOBAUD_MAX_GAP 48
+
+static const unsigned long standard_bauds[] PROGMEM = {
+  300, 600, 1200, 2400, 4800, 9600, 14400, 19200, 28800, 31250, 38400,
+  57600, 76800, 115200, 230400, 250000, 460800, 500000, 1000000,
+};
+
+// The RXD pin of the USART with UCSRnB register ucsrb
+static bool rxd_pin(volatile uint8_t *ucsrb, volatile uint8_t *&in, uint8_t &mask)
+{
+#if defined(__AVR_ATmega1280__) || defined(__AVR_ATmega2560__)
+  if (ucsrb == &UCSR0B) { in = &PINE; mask = _BV(0); return true; }
+  if (ucsrb == &UCSR1B) { in = &PIND; mask = _BV(2); return true; }
+  if (ucsrb == &UCSR2B) { in = &PINH; mask = _BV(0); return true; }
+  if (ucsrb == &UCSR3B) { in = &PINJ; mask = _BV(0); return true; }
+#elif defined(__AVR_ATmega32U4__) || defined(__AVR_ATmega16U4__)
+  if (ucsrb == &UCSR1B) { in = &PIND; mask = _BV(2); return true; }
+#elif defined(UCSR0B) && defined(UCSR1B)
+  // ATmega644/1284
+  if (ucsrb == &UCSR0B) { in = &PIND; mask = _BV(0); return true; }
+  if (ucsrb == &UCSR1B) { in = &PIND; mask = _BV(2); return true; }
+#elif defined(UCSR0B)
+  if (ucsrb == &UCSR0B) { in = &PIND; mask = _BV(0); return true; }
+#elif defined(UCSRB)
+  if (ucsrb == &UCSRB) { in = &PIND; mask = _BV(0); return true; }
+#endif
+  (void)ucsrb; (void)in; (void)mask;
+  return false;
+}
+
+// Timer1 count extended by the overflows seen so far. Interrupts must be
+// disabled.
+static inline uint32_t autobaud_time(uint16_t &high)
+{
+  uint16_t low = TCNT1;
+  if (AUTOBAUD_TIFR & _BV(TOV1)) {
+    AUTOBAUD_TIFR = _BV(TOV1);
+    high++;
+    // the overflow may have come after the read
+    if (low >= 0x8000)
+      return ((uint32_t)(high - 1) << 16) | low;
+  }
+  return ((uint32_t)high << 16) | low;
+}
+
+// Waits for a character and returns the length of one bit in clock
+// cycles, 0 after timeout overflows of Timer1 without one
+static uint32_t autobaud_measure(volatile uint8_t *in, uint8_t mask, uint32_t timeout)
+{
+  uint32_t edge[AUTOBAUD_EDGES];
+  uint16_t high = 0;
+
+  for (;;) {
+    uint32_t prev, now = 0;
+    uint8_t oldSREG = SREG, n, level, low;
+
+    // wait for the line to be idle (high), then for a start bit, with
+    // interrupts disabled only for each sample and its time stamp
+    do {
+      cli();
+      now = autobaud_time(high);
+      level = *in & mask;
+      SREG = oldSREG;
+      if (now >> 16 >= timeout)
+        return 0;
+    } while (!level);
+    do {
+      prev = now;
+      cli();
+      now = autobaud_time(high);
+      low = !(*in & mask);
+      if (now >> 16 >= timeout) {
+        SREG = oldSREG;
+        return 0;
+      }
+      if (!low)
+        SREG = oldSREG;
+    } while (!low);
+    // an interrupt between the last two samples makes the time of the
+    // edge uncertain, wait for the next character
+    if (now - prev > AUTOBAUD_MAX_GAP) {
+      SREG = oldSREG;
+      continue;
+    }
+
+    // time the rest of the character, until the line stays high for
+    // longer than ten times the shortest interval so far
+    uint32_t shortest = 0xFFFFFFFFUL;
+    edge[0] = now;
+    level = 0;
+    for (n = 1; n < AUTOBAUD_EDGES; ) {
+      now = autobaud_time(high);
+      if ((*in & mask) != level) {
+        uint32_t d = now - edge[n - 1];
+        if (d < shortest)
+          shortest = d;
+        edge[n++] = now;
+        level ^= mask;
+      } else if (level && shortest != 0xFFFFFFFFUL && now - edge[n - 1] > shortest * 10) {
+        break;
+      } else if (now - edge[0] > 0x00FFFFFFUL) {
+        // a line stuck low, or slower than 300 baud
+        break;
+      }
+    }
+    SREG = oldSREG;
+
+    if (n < 2 || shortest == 0xFFFFFFFFUL)
+      continue;
+
+    // the span from the first to the last edge in whole bits, rounding
+    // each interval on its own: shortest is biased low by the jitter,
+    // so dividing the whole span by it would multiply that error
+    uint32_t span = edge[n - 1] - edge[0];
+    uint16_t bits = 0;
+    for (uint8_t i = 1; i < n; i++)
+      bits += (edge[i] - edge[i - 1] + shortest / 2) / shortest;
+    return (span + bits / 2) / bits;
+  }
+}
+
+// Measures the baud rate from the first character received, then calls
+// begin() with it and config. Returns the rate, or 0 if nothing came
+// within timeout milliseconds (0 to wait forever) or Timer1 is taken.
+unsigned long HardwareSerial::beginAutoBaud(uint8_t config, unsigned long timeout)
+{
+  volatile uint8_t *in;
+  uint8_t mask;
+
+  if (!rxd_pin(_ucsrb, in, mask) || !claimTimer(1, TIMER_OWNER_AUTOBAUD))
+    return 0;
+
+  // the pin is an input while the USART is off, and it idles high
+  end();
+  uint8_t tccr1a = TCCR1A, tccr1b = TCCR1B;
+  TCCR1A = 0;
+  TCCR1B = _BV(CS10);
+
+  // Timer1 overflows about every 4 ms at 16 MHz; the count of them has
+  // 16 bits, so timeouts are limited to a few minutes
+  uint32_t overflows = timeout ? timeout * (F_CPU / 1000 / 256) / 256 + 1 : 0xFFFFFFFFUL;
+  if (timeout && overflows > 0xFFFF)
+    overflows = 0xFFFF;
+  uint32_t cycles = autobaud_measure(in, mask, overflows);
+
+  TCCR1A = tccr1a;
+  TCCR1B = tccr1b;
+  releaseTimer(1, TIMER_OWNER_AUTOBAUD);
+  if (cycles == 0)
+    return 0;
+
+  unsigned long baud = (F_CPU + cycles / 2) / cycles;
+  for (uint8_t i = 0; i < sizeof(standard_bauds) / sizeof(standard_bauds[0]); i++) {
+    unsigned long b = pgm_read_dword(&standard_bauds[i]);
+    unsigned long d = baud > b ? baud - b : b - baud;
+    if (d < b / 25) {
+      baud = b;
+      break;
+    }
+  }
+
+  begin(baud, config);
+  return baud;
+}
+
+#else
+
+unsigned long HardwareSerial::beginAutoBaud(uint8_t config, unsigned long timeout)
+{
+  (void)config;
+  (void)timeout;
+  return 0;
+}
+
+#endif
@@ -48,6 +48,13 @@
 #define U2X0 U2X
 #define UPE0 UPE
 #define UDRE0 UDRE
+#define FE0 FE
+#define DOR0 DOR
+#define MPCM0 MPCM
+#define UCSZ02 UCSZ2
+#define RXB80 RXB8
+#define TXB80 TXB8
+#define TXCIE0 TXCIE
 #elif defined(TXC1)
 // Some devices have uart1 but no uart0
 #define TXC0 TXC1
@@ -58,6 +65,13 @@
 #define U2X0 U2X1
 #define UPE0 UPE1
 #define UDRE0 UDRE1
+#define FE0 FE1
+#define DOR0 DOR1
+#define MPCM0 MPCM1
+#define UCSZ02 UCSZ12
+#define RXB80 RXB81
+#define TXB80 TXB81
+#define TXCIE0 TXCIE1
 #else
 #error No UART found in HardwareSerial.cpp
 #endif
@@ -81,30 +95,137 @@
 		      UDRE3 != UDRE0)
 #error "Not all bit positions for UART3 are the same as for UART0"
 #endif
+#if (_BV(UPE0) != SERIAL_PARITY_ERROR || _BV(DOR0) != SERIAL_OVERRUN_ERROR || \
+     _BV(FE0) != SERIAL_FRAME_ERROR)
+#error "UART error flags do not match the SERIAL_*_ERROR values"
+#endif
+
+// Declares the buffers for one port. RingIndex refuses sizes that are
+// not a power of 2, since the index arithmetic relies on masking.
+#if SERIAL_RX_FRAMES && (SERIAL_RX_FRAMES & (SERIAL_RX_FRAMES - 1))
+#error "SERIAL_RX_FRAMES must be a power of 2"
+#endif
+
+#define HWSERIAL_BUFFERS(name, rx_size, tx_size) \
+  static unsigned char name##_rx_buffer[RingIndex<rx_size>::size]; \
+  static unsigned char name##_tx_buffer[RingIndex<tx_size>::size];
 
 // Constructors ////////////////////////////////////////////////////////////////
 
 HardwareSerial::HardwareSerial(
   volatile uint8_t *ubrrh, volatile uint8_t *ubrrl,
   volatile uint8_t *ucsra, volatile uint8_t *ucsrb,
-  volatile uint8_t *ucsrc, volatile uint8_t *udr) :
+  volatile uint8_t *ucsrc, volatile uint8_t *udr,
+  unsigned char *rx_buffer, unsigned int rx_buffer_size,
+  unsigned char *tx_buffer, unsigned int tx_buffer_size) :
     _ubrrh(ubrrh), _ubrrl(ubrrl),
     _ucsra(ucsra), _ucsrb(ucsrb), _ucsrc(ucsrc),
-    _udr(udr),
+    _udr(udr), _baud(0), _baud_error(0),
     _rx_buffer_head(0), _rx_buffer_tail(0),
-    _tx_buffer_head(0), _tx_buffer_tail(0)
+    _tx_buffer_head(0), _tx_buffer_tail(0),
+    _rx_buffer(rx_buffer), _tx_buffer(tx_buffer),
+    _rx_buffer_mask(rx_buffer_size - 1), _tx_buffer_mask(tx_buffer_size - 1)
+#if SERIAL_RX_CALLBACK
+    , _rx_callback(NULL)
+#endif
+    , _errors(), _rx_address(-1)
+#if SERIAL_TX_COMPLETE
+    , _de_port(NULL), _de_mask(0), _half_duplex(false)
+#endif
+#if SERIAL_RX_FRAMES
+    , _rx_frame_delimiter(-1), _rx_frame_idle_bits(0), _rx_frame_gap(0),
+    _rx_frame_last(0), _rx_frame_overflow(false), _rx_frame_start(0),
+    _rx_frames_head(0), _rx_frames_tail(0)
+#endif
 {
 }
 
 // Actual interrupt handlers //////////////////////////////////////////////////////////////
 
-void HardwareSerial::_rx_complete_irq(void)
+#if SERIAL_RX_FRAMES
+// Ends the frame that is being received at the current head. Called from
+// the receive interrupt, or with interrupts disabled.
+void HardwareSerial::_rx_frame_end(void)
 {
-  if (bit_is_clear(*_ucsra, UPE0)) {
-    // No Parity error, read byte and store it in the buffer if there is
-    // room
-    unsigned char c = *_udr;
-    rx_buffer_index_t i = (unsigned int)(_rx_buffer_head + 1) % SERIAL_RX_BUFFER_SIZE;
+  rx_buffer_index_t head = _rx_buffer_head;
+  if (head == _rx_frame_start)
+    return;
+
+  uint8_t next = (_rx_frames_head + 1) & (SERIAL_RX_FRAMES - 1);
+  if (_rx_frame_overflow || next == _rx_frames_tail) {
+    // Part of the frame was lost, or there is no room to queue it, so
+    // drop the whole frame
+    if (!_rx_frame_overflow)
+      _errors.overflow++;
+    _rx_buffer_head = _rx_frame_start;
+    _rx_frame_overflow = false;
+    return;
+  }
+  _rx_frame_ends[_rx_frames_head] = head;
+  _rx_frames_head = next;
+  _rx_frame_start = head;
+}
+#endif
+
+
+HOT_FUNCTION void HardwareSerial::_rx_complete_irq(void)
+{
+  // The error flags are only valid until UDR is read
+  uint8_t status = *_ucsra;
+
+  IDLE_WAKE();
+
+  if (_rx_address >= 0 && bit_is_set(*_ucsrb, RXB80)) {
+    // Address frame: listen to the data frames that follow only if they
+    // are for us, by clearing MPCM. Don't write back TXC, which would
+    // clear it.
+    unsigned char a = *_udr;
+    if (a == _rx_address)
+      *_ucsra = status & _BV(U2X0);
+    else
+      *_ucsra = (status & _BV(U2X0)) | _BV(MPCM0);
+#if SERIAL_RX_FRAMES
+    // an address frame ends the frame before it, in framed mode only
+    if (_rx_frame_delimiter >= 0 || _rx_frame_gap)
+      _rx_frame_end();
+#endif
+    return;
+  }
+
+  unsigned char c = *_udr;
+
+  if (status & (SERIAL_PARITY_ERROR | SERIAL_OVERRUN_ERROR | SERIAL_FRAME_ERROR)) {
+    if (status & SERIAL_PARITY_ERROR)
+      _errors.parity++;
+    if (status & SERIAL_OVERRUN_ERROR)
+      _errors.overrun++;
+    if (status & SERIAL_FRAME_ERROR)
+      _errors.frame++;
+  }
+
+#if SERIAL_RX_CALLBACK
+  if (_rx_callback && !_rx_callback(c, status & (SERIAL_PARITY_ERROR |
+                                                 SERIAL_OVERRUN_ERROR |
+                                                 SERIAL_FRAME_ERROR)))
+    return;
+#endif
+
+  if (bit_is_clear(status, UPE0)) {
+#if SERIAL_RX_FRAMES
+    if (_rx_frame_gap) {
+      unsigned long now = micros();
+      if (now - _rx_frame_last >= _rx_frame_gap)
+        _rx_frame_end();
+      _rx_frame_last = now;
+    }
+    if (c == _rx_frame_delimiter) {
+      _rx_frame_end();
+      return;
+    }
+#endif
+
+    // No Parity error, store the byte in the buffer if there is room
+    rx_buffer_index_t i = (rx_buffer_index_t)(_rx_buffer_head + 1) & _rx_buffer_mask;
 
     // if we should be storing the received character into the location
     // just before the tail (meaning that the head would advance to the
@@ -113,11 +234,46 @@ void HardwareSerial::_rx_complete_irq(void)
     if (i != _rx_buffer_tail) {
       _rx_buffer[_rx_buffer_head] = c;
       _rx_buffer_head = i;
+    } else {
+      _errors.overflow++;
+#if SERIAL_RX_FRAMES
+      _rx_frame_overflow = true;
+#endif
     }
-  } else {
-    // Parity error, read byte but discard it
-    *_udr;
-  };
+  }
+  // else: parity error, the byte is discarded
+}
+
+#if SERIAL_TX_COMPLETE
+// Called on TX complete, which is only enabled in RS-485 and half-duplex
+// mode while sending
+void HardwareSerial::_tx_complete_irq(void)
+{
+  // Release the bus, unless more data was queued in the meantime (which
+  // will raise TX complete again when done)
+  if (bit_is_clear(*_ucsrb, UDRIE0) && bit_is_set(*_ucsra, UDRE0)) {
+    if (_de_port)
+      *_de_port &= ~_de_mask;
+    if (_half_duplex)
+      *_ucsrb = (*_ucsrb & ~(_BV(TXEN0) | _BV(TXCIE0))) | _BV(RXEN0);
+    else
+      cbi(*_ucsrb, TXCIE0);
+  }
 }
 
+// Takes the bus in RS-485 or half-duplex mode. Must be called with
+// interrupts disabled, before anything is written to UDR.
+void HardwareSerial::_de_assert(void)
+{
+  if (_de_port)
+    *_de_port |= _de_mask;
+  if (_half_duplex) {
+    // Turning the receiver off also drops a byte it was receiving
+    *_ucsrb = (*_ucsrb & ~_BV(RXEN0)) | _BV(TXEN0) | _BV(TXCIE0);
+  } else if (_de_port) {
+    sbi(*_ucsrb, TXCIE0);
+  }
+}
+#endif
+
 #endif // whole file
@@ -20,66 +20,50 @@
 #include <Arduino.h>
 #include <IPAddress.h>
 
-IPAddress::IPAddress()
-{
-    _address.dword = 0;
-}
-
-IPAddress::IPAddress(uint8_t first_octet, uint8_t second_octet, uint8_t third_octet, uint8_t fourth_octet)
-{
-    _address.bytes[0] = first_octet;
-    _address.bytes[1] = second_octet;
-    _address.bytes[2] = third_octet;
-    _address.bytes[3] = fourth_octet;
-}
-
-IPAddress::IPAddress(uint32_t address)
-{
-    _address.dword = address;
-}
-
 IPAddress::IPAddress(const uint8_t *address)
+    : _address(0UL)
 {
     memcpy(_address.bytes, address, sizeof(_address.bytes));
 }
 
 bool IPAddress::fromString(const char *address)
 {
-    uint16_t acc = 0; // Accumulator
-    uint8_t dots = 0;
+    uint8_t bytes[4];
 
-    while (*address)
+    // Four octets of one to three digits, with a dot between them. Each
+    // octet is taken as a whole, the range only checked once at its end
+    for (uint8_t i = 0; i < 4; i++)
     {
-        char c = *address++;
-        if (c >= '0' && c <= '9')
-        {
-            acc = acc * 10 + (c - '0');
-            if (acc > 255) {
-                // Value out of [0..255] range
-                return false;
-            }
+        uint8_t digit = (uint8_t)(*address++ - '0');
+        if (digit > 9) {
+            // Empty octet or invalid char
+            return false;
         }
-        else if (c == '.')
-        {
-            if (dots == 3) {
-                // Too much dots (there must be 3 dots)
-                return false;
+        uint16_t acc = digit;
+        if ((digit = (uint8_t)(*address - '0')) <= 9) {
+            acc = acc * 10 + digit;
+            address++;
+            if ((digit = (uint8_t)(*address - '0')) <= 9) {
+                acc = acc * 10 + digit;
+                address++;
             }
-            _address.bytes[dots++] = acc;
-            acc = 0;
         }
-        else
-        {
-            // Invalid char
+        if (acc > 255) {
+            // Value out of [0..255] range
+            return false;
+        }
+        bytes[i] = acc;
+        if (i < 3 && *address++ != '.') {
+            // Too few dots (there must be 3 dots)
             return false;
         }
     }
 
-    if (dots != 3) {
-        // Too few dots (there must be 3 dots)
+    if (*address) {
+        // Too many digits or dots, or an invalid char
         return false;
     }
-    _address.bytes[3] = acc;
+    memcpy(_address.bytes, bytes, sizeof(bytes));
     return true;
 }
 
@@ -25,12 +25,20 @@
 #include "WString.h"
 
 // A class to make it easier to handle and pass around IP addresses
+//
+// The constructors are constexpr, so constant addresses need no code at
+// startup. For long tables, keep the addresses as plain dwords in flash
+// and compare them without building IPAddress objects, e.g.
+//   const uint32_t allowed[] PROGMEM = { IPAddress::v4(192,168,1,0), ... };
+//   if (ip.inSubnet(pgm_read_dword(&allowed[i]), 24)) ...
 
 class IPAddress : public Printable {
 private:
-    union {
+    union Address {
 	uint8_t bytes[4];  // IPv4 address
 	uint32_t dword;
+	constexpr Address(uint32_t address) : dword(address) {}
+	constexpr Address(uint8_t a, uint8_t b, uint8_t c, uint8_t d) : bytes{a, b, c, d} {}
     } _address;
 
     // Access the raw byte array containing the address.  Because this returns a pointer
@@ -41,11 +49,22 @@ private:
 
 public:
     // Constructors
-    IPAddress();
-    IPAddress(uint8_t first_octet, uint8_t second_octet, uint8_t third_octet, uint8_t fourth_octet);
-    IPAddress(uint32_t address);
+    constexpr IPAddress() : _address(0UL) {}
+    constexpr IPAddress(uint8_t first_octet, uint8_t second_octet, uint8_t third_octet, uint8_t fourth_octet)
+        : _address(first_octet, second_octet, third_octet, fourth_octet) {}
+    constexpr IPAddress(uint32_t address) : _address(address) {}
     IPAddress(const uint8_t *address);
 
+    // The dword IPAddress(uint32_t) takes for a.b.c.d (octets in memory
+    // order, as the address goes over the wire)
+    static constexpr uint32_t v4(uint8_t a, uint8_t b, uint8_t c, uint8_t d) {
+        return (uint32_t)a | ((uint32_t)b << 8) | ((uint32_t)c << 16) | ((uint32_t)d << 24);
+    }
+    // The netmask of a /bits subnet, as a dword like v4()
+    static constexpr uint32_t prefixMask(uint8_t bits) {
+        return bits >= 32 ? 0xFFFFFFFFUL : bits == 0 ? 0 : swap(0xFFFFFFFFUL << (32 - bits));
+    }
+
     bool fromString(const char *address);
     bool fromString(const String &address) { return fromString(address.c_str()); }
 
@@ -54,6 +73,16 @@ public:
     operator uint32_t() const { return _address.dword; };
     bool operator==(const IPAddress& addr) const { return _address.dword == addr._address.dword; };
     bool operator==(const uint8_t* addr) const;
+    bool operator!=(const IPAddress& addr) const { return _address.dword != addr._address.dword; };
+
+    // True if the address is in the subnet network/mask, resp. network/bits;
+    // one 32-bit and and compare
+    bool inSubnet(const IPAddress& network, const IPAddress& mask) const {
+        return ((_address.dword ^ network._address.dword) & mask._address.dword) == 0;
+    }
+    bool inSubnet(const IPAddress& network, uint8_t bits) const {
+        return inSubnet(network, IPAddress(prefixMask(bits)));
+    }
 
     // Overloaded index operator to allow getting and setting individual octets of the address
     uint8_t operator[](int index) const { return _address.bytes[index]; };
@@ -65,6 +94,11 @@ public:
 
     virtual size_t printTo(Print& p) const;
 
+private:
+    static constexpr uint32_t swap(uint32_t h) {
+        return v4(h >> 24, h >> 16, h >> 8, h);
+    }
+
     friend class EthernetClass;
     friend class UDP;
     friend class Client;
@@ -0,0 +1,30 @@
+/*
+  NumberFormat.h - integer to text conversion shared by Print and String
+  Copyright (c) 2026 Arduino.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef NumberFormat_h
+#define NumberFormat_h
+
+#include <inttypes.h>
+
+// Writes the digits of n in base (2 to 36) backwards from end, which is
+// not included, and returns a pointer to the first digit. Needs up to
+// 8 * sizeof(long) bytes before end. Defined in Print.cpp.
+char *formatNumber(char *end, unsigned long n, uint8_t base);
+
+#endif
@@ -24,6 +24,7 @@
 #ifdef PLUGGABLE_USB_ENABLED
 
 extern uint8_t _initEndpoints[];
+extern uint8_t _initEndpointConfig[];
 
 int PluggableUSB_::getInterface(uint8_t* interfaceCount)
 {
@@ -59,6 +60,14 @@ void PluggableUSB_::getShortName(char *iSerialNum)
 	*iSerialNum = 0;
 }
 
+void PluggableUSB_::startOfFrame(void)
+{
+	PluggableUSBModule* node;
+	for (node = rootNode; node; node = node->next) {
+		node->startOfFrame();
+	}
+}
+
 bool PluggableUSB_::setup(USBSetup& setup)
 {
 	PluggableUSBModule* node;
@@ -91,6 +100,8 @@ bool PluggableUSB_::plug(PluggableUSBModule *node)
 	lastIf += node->numInterfaces;
 	for (uint8_t i = 0; i < node->numEndpoints; i++) {
 		_initEndpoints[lastEp] = node->endpointType[i];
+		if (node->endpointConfig)
+			_initEndpointConfig[lastEp] = node->endpointConfig[i];
 		lastEp++;
 	}
 	return true;
@@ -36,6 +36,9 @@ protected:
   virtual int getInterface(uint8_t* interfaceCount) = 0;
   virtual int getDescriptor(USBSetup& setup) = 0;
   virtual uint8_t getShortName(char *name) { name[0] = 'A'+pluggedInterface; return 1; }
+  // Called from the USB interrupt at every start of frame (1 ms) while
+  // the device is configured, e.g. to send queued data
+  virtual void startOfFrame(void) { }
 
   uint8_t pluggedInterface;
   uint8_t pluggedEndpoint;
@@ -43,6 +46,9 @@ protected:
   const uint8_t numEndpoints;
   const uint8_t numInterfaces;
   const uint8_t *endpointType;
+  // EP_CONFIG() of each endpoint, or NULL for the default: 64-byte banks,
+  // two of them except for interrupt endpoints
+  const uint8_t *endpointConfig = NULL;
 
   PluggableUSBModule *next = NULL;
 
@@ -57,6 +63,7 @@ public:
   int getDescriptor(USBSetup& setup);
   bool setup(USBSetup& setup);
   void getShortName(char *iSerialNum);
+  void startOfFrame(void);
 
 private:
   uint8_t lastIf;
@@ -27,6 +27,7 @@
 #include "Arduino.h"
 
 #include "Print.h"
+#include "NumberFormat.h"
 
 // Public Methods //////////////////////////////////////////////////////////////
 
@@ -41,6 +42,33 @@ size_t Print::write(const uint8_t *buffer, size_t size)
   return n;
 }
 
+size_t Print::writeSegments(const WriteSegment *segments, size_t count)
+{
+  size_t n = 0;
+  for (; count--; segments++) {
+    const uint8_t *p = (const uint8_t *)segments->data;
+    size_t size = segments->size;
+
+    if (!segments->progmem) {
+      size_t done = write(p, size);
+      n += done;
+      if (done != size) break;
+      continue;
+    }
+    while (size) {
+      uint8_t buf[PRINTF_BUFFER_SIZE];
+      size_t len = size < sizeof(buf) ? size : sizeof(buf);
+      memcpy_P(buf, p, len);
+      size_t done = write(buf, len);
+      n += done;
+      if (done != len) return n;
+      p += len;
+      size -= len;
+    }
+  }
+  return n;
+}
+
 size_t Print::print(const __FlashStringHelper *ifsh)
 {
   PGM_P p = reinterpret_cast<PGM_P>(ifsh);
@@ -54,6 +82,52 @@ size_t Print::print(const __FlashStringHelper *ifsh)
   return n;
 }
 
+#if FLASHEND > 0xFFFF
+
+size_t Print::writeFar(uint_farptr_t address, size_t size)
+{
+  size_t n = 0;
+  while (size) {
+    uint8_t buf[PRINTF_BUFFER_SIZE];
+    size_t len = size < sizeof(buf) ? size : sizeof(buf);
+    memcpy_PF(buf, address, len);
+    size_t done = write(buf, len);
+    n += done;
+    if (done != len) break;
+    address += len;
+    size -= len;
+  }
+  return n;
+}
+
+size_t Print::print(const FarFlashString &s)
+{
+  uint_farptr_t p = s.address;
+  size_t n = 0;
+  while (1) {
+    uint8_t buf[PRINTF_BUFFER_SIZE];
+    size_t len = 0;
+    unsigned char c;
+    while (len < sizeof(buf) && (c = pgm_read_byte_far(p + len)) != 0)
+      buf[len++] = c;
+    if (len == 0) break;
+    size_t done = write(buf, len);
+    n += done;
+    if (done != len) break;
+    p += len;
+  }
+  return n;
+}
+
+size_t Print::println(const FarFlashString &s)
+{
+  size_t n = print(s);
+  n += println();
+  return n;
+}
+
+#endif
+
 size_t Print::print(const String &s)
 {
   return write(s.c_str(), s.length());
@@ -118,6 +192,36 @@ size_t Print::println(const __FlashStringHelper *ifsh)
   return n;
 }
 
+size_t Print::printFixed(long raw, uint8_t fracBits, int digits)
+{
+  size_t n = 0;
+  uint32_t u = raw;
+  uint32_t mask = ((uint32_t)1 << fracBits) - 1;
+
+  if (raw < 0) {
+    n += print('-');
+    u = -(uint32_t)raw;
+  }
+
+  // add half the last digit shown, as printFloat() does
+  uint32_t rounding = (mask + 1) >> 1;
+  for (int i = 0; i < digits; i++)
+    rounding /= 10;
+  u += rounding;
+
+  n += print((unsigned long)(u >> fracBits));
+  if (digits > 0)
+    n += print('.');
+
+  uint32_t frac = u & mask;
+  while (digits-- > 0) {
+    frac *= 10;
+    n += print((char)('0' + (frac >> fracBits)));
+    frac &= mask;
+  }
+  return n;
+}
+
 size_t Print::print(const Printable& x)
 {
   return x.printTo(*this);
@@ -198,8 +302,129 @@ size_t Print::println(const Printable& x)
   return n;
 }
 
+size_t Print::printf(const char *format, ...)
+{
+  va_list ap;
+  va_start(ap, format);
+  size_t n = vprintf(format, ap);
+  va_end(ap);
+  return n;
+}
+
+size_t Print::printf_P(const char *format, ...)
+{
+  va_list ap;
+  va_start(ap, format);
+  size_t n = vprintf_P(format, ap);
+  va_end(ap);
+  return n;
+}
+
+size_t Print::printf(const __FlashStringHelper *format, ...)
+{
+  va_list ap;
+  va_start(ap, format);
+  size_t n = vprintf_P(reinterpret_cast<PGM_P>(format), ap);
+  va_end(ap);
+  return n;
+}
+
+size_t Print::vprintf(const char *format, va_list ap)
+{
+  return printFormatted(format, ap, false);
+}
+
+size_t Print::vprintf_P(const char *format, va_list ap)
+{
+  return printFormatted(format, ap, true);
+}
+
 // Private Methods /////////////////////////////////////////////////////////////
 
+// Division by 10 with shifts and adds (Hacker's Delight, divu10), a
+// fraction of the cost of the libgcc 32-bit division
+static inline unsigned long divmod10(unsigned long n, uint8_t *rem)
+{
+  unsigned long q = (n >> 1) + (n >> 2);
+  q += q >> 4;
+  q += q >> 8;
+  q += q >> 16;
+  q >>= 3;
+  uint8_t r = (uint8_t)n - (uint8_t)q * 10; // only the low byte matters
+  if (r > 9) {
+    q++;
+    r -= 10;
+  }
+  *rem = r;
+  return q;
+}
+
+static inline uint16_t divmod10(uint16_t n, uint8_t *rem)
+{
+  uint16_t q = (n >> 1) + (n >> 2);
+  q += q >> 4;
+  q += q >> 8;
+  q >>= 3;
+  uint8_t r = (uint8_t)n - (uint8_t)q * 10; // only the low byte matters
+  if (r > 9) {
+    q++;
+    r -= 10;
+  }
+  *rem = r;
+  return q;
+}
+
+static inline char digitChar(uint8_t c)
+{
+  return c < 10 ? c + '0' : c + 'A' - 10;
+}
+
+char *formatNumber(char *end, unsigned long n, uint8_t base)
+{
+  char *str = end;
+
+  // prevent crash if called with base == 1
+  if (base < 2) base = 10;
+
+  if (base == 10) {
+    uint8_t c;
+    // once the value fits in 16 bits the rest is done in 16 bits
+    while (n > 0xffff) {
+      n = divmod10(n, &c);
+      *--str = c + '0';
+    }
+    uint16_t m = n;
+    do {
+      m = divmod10(m, &c);
+      *--str = c + '0';
+    } while (m);
+  } else if ((base & (base - 1)) == 0) {
+    // powers of two (HEX, OCT, BIN) only need shifts and masks
+    uint8_t shift = 1;
+    while ((1 << shift) != base) shift++;
+    uint8_t mask = base - 1;
+
+    while (n > 0xffff) {
+      *--str = digitChar((uint8_t)n & mask);
+      n >>= shift;
+    }
+    uint16_t m = n;
+    do {
+      *--str = digitChar((uint8_t)m & mask);
+      m >>= shift;
+    } while (m);
+  } else {
+    do {
+      char c = n % base;
+      n /= base;
+
+      *--str = digitChar(c);
+    } while(n);
+  }
+
+  return str;
+}
+
 size_t Print::printNumber(unsigned long n, uint8_t base)
 {
   char buf[8 * sizeof(long) + 1]; // Assumes 8-bit chars plus zero byte.
@@ -207,60 +432,107 @@ size_t Print::printNumber(unsigned long n, uint8_t base)
 
   *str = '\0';
 
-  // prevent crash if called with base == 1
-  if (base < 2) base = 10;
+  return write(formatNumber(str, n, base));
+}
 
-  do {
-    char c = n % base;
-    n /= base;
+// The stream vfprintf() writes to: characters are collected here and
+// passed on to write() whenever the buffer fills up.
+struct PrintfSink {
+  Print *out;
+  size_t n;
+  uint8_t len;
+  uint8_t buf[PRINTF_BUFFER_SIZE];
+};
 
-    *--str = c < 10 ? c + '0' : c + 'A' - 10;
-  } while(n);
+static int printfPut(char c, FILE *stream)
+{
+  PrintfSink *sink = (PrintfSink *)fdev_get_udata(stream);
 
-  return write(str);
+  sink->buf[sink->len++] = c;
+  if (sink->len == sizeof(sink->buf)) {
+    sink->n += sink->out->write(sink->buf, sink->len);
+    sink->len = 0;
+  }
+  return 0;
+}
+
+size_t Print::printFormatted(const char *format, va_list ap, bool progmem)
+{
+  FILE stream;
+  PrintfSink sink;
+
+  sink.out = this;
+  sink.n = 0;
+  sink.len = 0;
+  fdev_setup_stream(&stream, printfPut, NULL, _FDEV_SETUP_WRITE);
+  fdev_set_udata(&stream, &sink);
+
+  if (progmem)
+    vfprintf_P(&stream, format, ap);
+  else
+    vfprintf(&stream, format, ap);
+
+  if (sink.len)
+    sink.n += write(sink.buf, sink.len);
+  return sink.n;
 }
 
 size_t Print::printFloat(double number, uint8_t digits) 
 { 
-  size_t n = 0;
-  
   if (isnan(number)) return print("nan");
   if (isinf(number)) return print("inf");
   if (number > 4294967040.0) return print ("ovf");  // constant determined empirically
   if (number <-4294967040.0) return print ("ovf");  // constant determined empirically
-  
-  // Handle negative numbers
-  if (number < 0.0)
-  {
-     n += print('-');
-     number = -number;
-  }
 
-  // Round correctly so that print(1.999, 2) prints as "2.00"
-  double rounding = 0.5;
-  for (uint8_t i=0; i<digits; ++i)
-    rounding /= 10.0;
-  
-  number += rounding;
+  char buf[24]; // sign, 10 digits, point, 9 digits and zero byte
+  char *str = &buf[sizeof(buf) - 1];
+  bool negative = number < 0.0;
+  uint8_t c;
+
+  *str = '\0';
 
-  // Extract the integer part of the number and print it
+  // Handle negative numbers
+  if (negative)
+    number = -number;
+
+  // The fraction is scaled to an integer once and rounded there, so that
+  // print(1.999, 2) prints as "2.00". Beyond 9 digits it would not fit in
+  // 32 bits; a float has no more than 7 significant digits anyway, the
+  // rest is printed as zeros.
+  uint8_t scaled = digits > 9 ? 9 : digits;
+  unsigned long scale = 1;
+  for (uint8_t i=0; i<scaled; ++i)
+    scale *= 10;
+
+  // taking the integer part off is exact
   unsigned long int_part = (unsigned long)number;
   double remainder = number - (double)int_part;
-  n += print(int_part);
+  unsigned long frac = (unsigned long)(remainder * scale + 0.5);
+  if (frac >= scale) {
+    frac -= scale;
+    int_part++;
+  }
 
-  // Print the decimal point, but only if there are digits beyond
-  if (digits > 0) {
-    n += print('.'); 
+  for (uint8_t i=0; i<scaled; ++i) {
+    frac = divmod10(frac, &c);
+    *--str = c + '0';
   }
 
-  // Extract digits from the remainder one at a time
-  while (digits-- > 0)
-  {
-    remainder *= 10.0;
-    unsigned int toPrint = (unsigned int)(remainder);
-    n += print(toPrint);
-    remainder -= toPrint; 
-  } 
-  
+  // Print the decimal point, but only if there are digits beyond
+  if (digits > 0)
+    *--str = '.';
+
+  do {
+    int_part = divmod10(int_part, &c);
+    *--str = c + '0';
+  } while (int_part);
+
+  if (negative)
+    *--str = '-';
+
+  size_t n = write(str);
+  while (digits-- > scaled)
+    n += print('0');
+
   return n;
 }
@@ -22,6 +22,7 @@
 
 #include <inttypes.h>
 #include <stdio.h> // for size_t
+#include <stdarg.h> // for va_list
 
 #include "WString.h"
 #include "Printable.h"
@@ -34,14 +35,39 @@
 #endif
 #define BIN 2
 
+template <typename T, uint8_t F> class Fixed;
+
+// Bytes printf() collects on the stack before passing them to write(),
+// also how much of a flash segment writeSegments() or writeFar() copies
+// at a time
+#if !defined(PRINTF_BUFFER_SIZE)
+#define PRINTF_BUFFER_SIZE 16
+#endif
+
+// One piece of a message for Client::writev() and UDP::writev(), e.g.
+//   static const char head[] PROGMEM = "GET / HTTP/1.1\r\nHost: ";
+//   WriteSegment req[] = { { head, sizeof(head) - 1, true },
+//                          { host, strlen(host), false },
+//                          { tail, tailLen, false } };
+struct WriteSegment {
+  const void *data;
+  size_t size;
+  bool progmem;   // data is in flash (PROGMEM, PSTR())
+};
+
 class Print
 {
   private:
     int write_error;
     size_t printNumber(unsigned long, uint8_t);
     size_t printFloat(double, uint8_t);
+    size_t printFormatted(const char *, va_list, bool);
   protected:
     void setWriteError(int err = 1) { write_error = err; }
+    // Passes each segment to write(const uint8_t *, size_t), flash ones
+    // through a small stack buffer, and stops at the first short write.
+    // The default writev() of Client and UDP.
+    size_t writeSegments(const WriteSegment *segments, size_t count);
   public:
     Print() : write_error(0) {}
   
@@ -62,6 +88,14 @@ class Print
     // should be overriden by subclasses with buffering
     virtual int availableForWrite() { return 0; }
 
+#if FLASHEND > 0xFFFF
+    // size bytes from anywhere in flash (see FAR_F()), to write() through
+    // a small stack buffer
+    size_t writeFar(uint_farptr_t address, size_t size);
+    size_t print(const FarFlashString &);
+    size_t println(const FarFlashString &);
+#endif
+
     size_t print(const __FlashStringHelper *);
     size_t print(const String &);
     size_t print(const char[]);
@@ -87,6 +121,27 @@ class Print
     size_t println(const Printable&);
     size_t println(void);
 
+    // A fixed point number (see Fixed.h) with digits decimals, rounded,
+    // without going through float
+    size_t printFixed(long raw, uint8_t fracBits, int digits = 2);
+    template <typename T, uint8_t F> size_t print(const Fixed<T, F> &x, int digits = 2) {
+      return printFixed(x.raw(), F, digits);
+    }
+    template <typename T, uint8_t F> size_t println(const Fixed<T, F> &x, int digits = 2) {
+      size_t n = printFixed(x.raw(), F, digits);
+      return n + println();
+    }
+
+    // Formats straight into write(), PRINTF_BUFFER_SIZE bytes at a time,
+    // without a buffer for the whole text. printf_P() and the F() version
+    // take the format from flash. %f needs the floating point vfprintf
+    // (-Wl,-u,vfprintf -lprintf_flt).
+    size_t printf(const char *format, ...) __attribute__ ((format (printf, 2, 3)));
+    size_t printf_P(const char *format, ...);
+    size_t printf(const __FlashStringHelper *format, ...);
+    size_t vprintf(const char *format, va_list ap);
+    size_t vprintf_P(const char *format, va_list ap);
+
     virtual void flush() { /* Empty implementation for backward compatibility */ }
 };
 
@@ -0,0 +1,159 @@
+/*
+  Profile.cpp - Execution time statistics for the core's interrupt handlers
+  Copyright (c) 2026 Arduino.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "Arduino.h"
+#include "Profile.h"
+
+#if CORE_PROFILE
+
+#include <util/atomic.h>
+
+static profileStats profile_stats[PROFILE_SITES];
+
+static const char profile_name_0[] PROGMEM = "loop";
+static const char profile_name_1[] PROGMEM = "serialEvent";
+static const char profile_name_2[] PROGMEM = "TIMER0_OVF";
+static const char profile_name_3[] PROGMEM = "SERIAL0_RX";
+static const char profile_name_4[] PROGMEM = "SERIAL0_UDRE";
+static const char profile_name_5[] PROGMEM = "SERIAL1_RX";
+static const char profile_name_6[] PROGMEM = "SERIAL1_UDRE";
+static const char profile_name_7[] PROGMEM = "SERIAL2_RX";
+static const char profile_name_8[] PROGMEM = "SERIAL2_UDRE";
+static const char profile_name_9[] PROGMEM = "SERIAL3_RX";
+static const char profile_name_10[] PROGMEM = "SERIAL3_UDRE";
+static const char profile_name_11[] PROGMEM = "TWI";
+static const char profile_name_12[] PROGMEM = "EXTINT";
+static const char profile_name_13[] PROGMEM = "USB_GEN";
+static const char profile_name_14[] PROGMEM = "USB_COM";
+
+static const char * const profile_names[PROFILE_SITES] PROGMEM = {
+  profile_name_0, profile_name_1, profile_name_2, profile_name_3,
+  profile_name_4, profile_name_5, profile_name_6, profile_name_7,
+  profile_name_8, profile_name_9, profile_name_10, profile_name_11,
+  profile_name_12, profile_name_13, profile_name_14,
+};
+
+static void profileCount(uint16_t *histogram, unsigned long cycles)
+{
+  uint8_t b = 0;
+
+  cycles >>= PROFILE_BUCKET_SHIFT;
+  while (cycles && b < PROFILE_BUCKETS - 1) {
+    cycles >>= 1;
+    b++;
+  }
+  if (histogram[b] != 0xFFFF)
+    histogram[b]++;
+}
+
+// Each site is only recorded from one context (its interrupt handler, or
+// the main loop), and interrupt handlers do not nest, so updating the
+// statistics needs no locking.
+void profileRecord(uint8_t site, unsigned long start)
+{
+  unsigned long cycles = cycleCounter() - start;
+  profileStats *s = &profile_stats[site];
+
+  if (s->count == 0 || cycles < s->min)
+    s->min = cycles;
+  if (cycles > s->max)
+    s->max = cycles;
+  s->total += cycles;
+  s->count++;
+  profileCount(s->histogram, cycles);
+}
+
+void profileLatency(uint8_t site, unsigned long cycles)
+{
+  profileStats *s = &profile_stats[site];
+
+  if (cycles > s->latencyMax)
+    s->latencyMax = cycles;
+  profileCount(s->latency, cycles);
+}
+
+void profileCaptureLatency(uint8_t site, unsigned long start)
+{
+#if defined(ICR1) && defined(TIFR1) && defined(ICF1)
+  if (TIFR1 & _BV(ICF1)) {
+    // start is the counter at entry, whose low word is TCNT1
+    uint16_t edge = ICR1;
+    TIFR1 = _BV(ICF1);
+    profileLatency(site, (uint16_t)((uint16_t)start - edge));
+  }
+#endif
+}
+
+void getProfile(uint8_t site, profileStats *stats)
+{
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    *stats = profile_stats[site];
+  }
+}
+
+void clearProfile(void)
+{
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    memset(profile_stats, 0, sizeof(profile_stats));
+  }
+}
+
+// e.g. " <32:0 <64:120 <128:3 ... >=2048:0"
+static void printHistogram(Print &out, const uint16_t *histogram)
+{
+  for (uint8_t b = 0; b < PROFILE_BUCKETS; b++) {
+    unsigned long limit = 1UL << (PROFILE_BUCKET_SHIFT + b);
+    out.print(b < PROFILE_BUCKETS - 1 ? F(" <") : F(" >="));
+    out.print(b < PROFILE_BUCKETS - 1 ? limit : limit >> 1);
+    out.print(':');
+    out.print(histogram[b]);
+  }
+  out.println();
+}
+
+void printProfile(Print &out)
+{
+  for (uint8_t i = 0; i < PROFILE_SITES; i++) {
+    profileStats s;
+
+    getProfile(i, &s);
+    if (s.count == 0)
+      continue;
+
+    out.print((const __FlashStringHelper *)pgm_read_word(&profile_names[i]));
+    out.print(F(": "));
+    out.print(s.count);
+    out.print(F(" runs, cycles min "));
+    out.print(s.min);
+    out.print(F(" avg "));
+    out.print((unsigned long)(s.total / s.count));
+    out.print(F(" max "));
+    out.println(s.max);
+
+    out.print(F("  duration"));
+    printHistogram(out, s.histogram);
+    if (s.latencyMax) {
+      out.print(F("  latency max "));
+      out.print(s.latencyMax);
+      printHistogram(out, s.latency);
+    }
+  }
+}
+
+#endif
@@ -0,0 +1,217 @@
+/*
+  Profile.h - Execution time statistics for the core's interrupt handlers
+  Copyright (c) 2026 Arduino.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef Profile_h
+#define Profile_h
+
+#include <inttypes.h>
+
+// Build with CORE_PROFILE=1 (e.g. -DCORE_PROFILE=1 in build.extra_flags)
+// to have loop(), serialEventRun() and the core's interrupt handlers
+// record how often they ran and how many clock cycles they took. Times
+// are taken with cycleCounter(), so init() then starts the cycle counter
+// and Timer1 is not available for PWM. Each measurement includes the
+// few dozen cycles cycleCounter() itself takes.
+//
+// Besides the durations, some sites record their latency, the cycles
+// from the event to the handler starting, which is where other handlers
+// and code with interrupts off show up:
+// - TIMER0_OVF, from TCNT0 at entry, to within TIMER0_PRESCALER cycles
+// - EXTINT (attachInterrupt()), when the pin is also wired to ICP1
+//   (pin 8 on the Uno, 4 on the Leonardo), whose input capture stamps
+//   the edge in hardware. ICP1 captures falling edges; set ICES1 in
+//   TCCR1B for rising ones.
+#ifndef CORE_PROFILE
+#define CORE_PROFILE 0
+#endif
+
+// Runs are also counted by cycles, in buckets of powers of two: below
+// 32 cycles (1 << PROFILE_BUCKET_SHIFT), below 64, and so on, the last
+// bucket taking all longer ones
+#ifndef PROFILE_BUCKETS
+#define PROFILE_BUCKETS 8
+#endif
+#define PROFILE_BUCKET_SHIFT 5
+
+// The instrumented sites
+enum {
+  PROFILE_LOOP,
+  PROFILE_SERIAL_EVENT,
+  PROFILE_TIMER0,
+  PROFILE_SERIAL0_RX,
+  PROFILE_SERIAL0_UDRE,
+  PROFILE_SERIAL1_RX,
+  PROFILE_SERIAL1_UDRE,
+  PROFILE_SERIAL2_RX,
+  PROFILE_SERIAL2_UDRE,
+  PROFILE_SERIAL3_RX,
+  PROFILE_SERIAL3_UDRE,
+  PROFILE_TWI,
+  PROFILE_EXTINT,
+  PROFILE_USB_GEN,
+  PROFILE_USB_COM,
+  PROFILE_SITES
+};
+
+typedef struct {
+  unsigned long count;    // number of runs
+  unsigned long min;      // shortest run, in clock cycles
+  unsigned long max;      // longest run, in clock cycles
+  unsigned long long total; // all runs together, in clock cycles
+  uint16_t histogram[PROFILE_BUCKETS]; // runs by duration, saturating
+  unsigned long latencyMax; // longest latency, in clock cycles
+  uint16_t latency[PROFILE_BUCKETS]; // runs by latency, where recorded
+} profileStats;
+
+#if CORE_PROFILE
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+unsigned long cycleCounter(void);
+void profileRecord(uint8_t site, unsigned long start);
+void profileLatency(uint8_t site, unsigned long cycles);
+// The latency from the ICP1 stamp, for a handler that started at start
+void profileCaptureLatency(uint8_t site, unsigned long start);
+// Copies the statistics of one site, consistently even while its
+// interrupt keeps firing
+void getProfile(uint8_t site, profileStats *stats);
+void clearProfile(void);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+// Bracket the code to measure with these (in C) ...
+#define PROFILE_BEGIN() unsigned long _profile_start = cycleCounter()
+#define PROFILE_END(site) profileRecord((site), _profile_start)
+#define PROFILE_LATENCY(site, cycles) profileLatency((site), (cycles))
+#define PROFILE_CAPTURE_LATENCY(site) profileCaptureLatency((site), _profile_start)
+
+#ifdef __cplusplus
+// ... or, in C++, put this at the top of the block to measure, which
+// also covers early returns
+class ProfileScope
+{
+  public:
+    inline ProfileScope(uint8_t site) : _site(site), _start(cycleCounter()) {}
+    inline ~ProfileScope() { profileRecord(_site, _start); }
+  private:
+    uint8_t _site;
+    unsigned long _start;
+};
+#define PROFILE_SCOPE(site) ProfileScope _profile_scope(site)
+
+class Print;
+// Prints a line per site that ran: name, runs, and min/avg/max cycles,
+// followed by the histograms
+void printProfile(Print &out);
+#endif
+
+#else
+
+#define PROFILE_BEGIN()
+#define PROFILE_END(site)
+#define PROFILE_LATENCY(site, cycles)
+#define PROFILE_CAPTURE_LATENCY(site)
+#define PROFILE_SCOPE(site)
+
+#endif
+
+// For a logic analyzer or scope: build with CORE_TRACE=1 and a pin for
+// each site to watch, e.g. -DCORE_TRACE=1 -DTRACE_PIN_SERIAL_RX=8, and
+// the pin is high while the site runs. The sites are
+//   SERIAL_RX      HardwareSerial receive interrupts
+//   SERIAL_UDRE    HardwareSerial transmit (data register empty) ones
+//   TWI            TWI_vect, the whole Wire state machine
+//   USB_COM        USB endpoint interrupt
+//   USB_GEN        USB general interrupt
+//   ADC_WAIT       analogRead() waiting for the conversion
+//   USB_SEND_WAIT  USB_Send() (Serial on the Leonardo) waiting for the
+//                  host to take a packet
+// The pin numbers are constants, so each edge is a single sbi/cbi (see
+// digitalWriteFast()), two cycles; sites without a pin, and everything
+// with CORE_TRACE off, compile to nothing. init() makes the pins outputs.
+#ifndef CORE_TRACE
+#define CORE_TRACE 0
+#endif
+
+#if CORE_TRACE
+
+#define TRACE_NO_PIN 255
+#ifndef TRACE_PIN_SERIAL_RX
+#define TRACE_PIN_SERIAL_RX TRACE_NO_PIN
+#endif
+#ifndef TRACE_PIN_SERIAL_UDRE
+#define TRACE_PIN_SERIAL_UDRE TRACE_NO_PIN
+#endif
+#ifndef TRACE_PIN_TWI
+#define TRACE_PIN_TWI TRACE_NO_PIN
+#endif
+#ifndef TRACE_PIN_USB_COM
+#define TRACE_PIN_USB_COM TRACE_NO_PIN
+#endif
+#ifndef TRACE_PIN_USB_GEN
+#define TRACE_PIN_USB_GEN TRACE_NO_PIN
+#endif
+#ifndef TRACE_PIN_ADC_WAIT
+#define TRACE_PIN_ADC_WAIT TRACE_NO_PIN
+#endif
+#ifndef TRACE_PIN_USB_SEND_WAIT
+#define TRACE_PIN_USB_SEND_WAIT TRACE_NO_PIN
+#endif
+
+#define _TRACE_WRITE(pin, val) do { if ((pin) != TRACE_NO_PIN) digitalWriteFast((pin), (val)); } while (0)
+#define _TRACE_OUTPUT(pin) do { if ((pin) != TRACE_NO_PIN) pinModeFast((pin), OUTPUT); } while (0)
+
+#define TRACE_BEGIN(site) _TRACE_WRITE(TRACE_PIN_##site, HIGH)
+#define TRACE_END(site) _TRACE_WRITE(TRACE_PIN_##site, LOW)
+#define TRACE_INIT() do { \
+    _TRACE_OUTPUT(TRACE_PIN_SERIAL_RX); \
+    _TRACE_OUTPUT(TRACE_PIN_SERIAL_UDRE); \
+    _TRACE_OUTPUT(TRACE_PIN_TWI); \
+    _TRACE_OUTPUT(TRACE_PIN_USB_COM); \
+    _TRACE_OUTPUT(TRACE_PIN_USB_GEN); \
+    _TRACE_OUTPUT(TRACE_PIN_ADC_WAIT); \
+    _TRACE_OUTPUT(TRACE_PIN_USB_SEND_WAIT); \
+  } while (0)
+
+#ifdef __cplusplus
+// In C++, at the top of the block, which also covers early returns
+template <uint8_t pin>
+class TraceScope
+{
+  public:
+    inline TraceScope() { _TRACE_WRITE(pin, HIGH); }
+    inline ~TraceScope() { _TRACE_WRITE(pin, LOW); }
+};
+#define TRACE_SCOPE(site) TraceScope<TRACE_PIN_##site> _trace_scope
+#endif
+
+#else
+
+#define TRACE_BEGIN(site)
+#define TRACE_END(site)
+#define TRACE_INIT()
+#define TRACE_SCOPE(site)
+
+#endif
+
+#endif
@@ -0,0 +1,127 @@
+/*
+  PwmPin.h - PWM pin handle with the compare register looked up once
+  Copyright (c) 2026 Arduino.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef PwmPin_h
+#define PwmPin_h
+
+#include "Arduino.h"
+
+// Handle for a PWM pin. analogWrite() looks up the timer of the pin and
+// goes through a switch over all timer channels on every call; the handle
+// finds the output compare register once, so write() is a single 8 or
+// 16-bit store.
+//
+// begin() connects the pin to the timer through analogWrite(). Unlike
+// analogWrite(), write(0) and write(255) do not switch the pin to a plain
+// digital output, so on the fast PWM pins of Timer0 (5 and 6 on the Uno)
+// 0 still gives a short pulse every period. Handles for pins without PWM
+// point at a dummy register, so using them does nothing.
+class PwmPin
+{
+  public:
+    PwmPin(uint8_t pin) : _pin(pin), _ocr(dummy()), _wide(false)
+    {
+      switch (digitalPinToTimer(pin)) {
+#if defined(OCR0A)
+        case TIMER0A: _ocr = &OCR0A; break;
+#endif
+#if defined(OCR0B)
+        case TIMER0B: _ocr = &OCR0B; break;
+#endif
+#if defined(OCR2)
+        case TIMER2: _ocr = &OCR2; break;
+#endif
+#if defined(OCR2A)
+        case TIMER2A: _ocr = &OCR2A; break;
+#endif
+#if defined(OCR2B)
+        case TIMER2B: _ocr = &OCR2B; break;
+#endif
+#if defined(OCR1A)
+        case TIMER1A: wide(&OCR1A); break;
+#endif
+#if defined(OCR1B)
+        case TIMER1B: wide(&OCR1B); break;
+#endif
+#if defined(OCR1C)
+        case TIMER1C: wide(&OCR1C); break;
+#endif
+#if defined(OCR3A)
+        case TIMER3A: wide(&OCR3A); break;
+#endif
+#if defined(OCR3B)
+        case TIMER3B: wide(&OCR3B); break;
+#endif
+#if defined(OCR3C)
+        case TIMER3C: wide(&OCR3C); break;
+#endif
+#if defined(TCCR4D)
+        // the 10-bit Timer4 of the 32U4, used with 8-bit values
+        case TIMER4A: _ocr = &OCR4A; break;
+        case TIMER4D: _ocr = &OCR4D; break;
+#else
+#if defined(OCR4A)
+        case TIMER4A: wide(&OCR4A); break;
+#endif
+#if defined(OCR4B)
+        case TIMER4B: wide(&OCR4B); break;
+#endif
+#if defined(OCR4C)
+        case TIMER4C: wide(&OCR4C); break;
+#endif
+#endif
+#if defined(OCR5A)
+        case TIMER5A: wide(&OCR5A); break;
+#endif
+#if defined(OCR5B)
+        case TIMER5B: wide(&OCR5B); break;
+#endif
+#if defined(OCR5C)
+        case TIMER5C: wide(&OCR5C); break;
+#endif
+      }
+    }
+
+    // Connects the pin to its timer and sets the duty cycle
+    inline void begin(uint8_t value = 0) { analogWrite(_pin, 1); write(value); }
+
+    // On the 16-bit timers the high byte goes through the shared TEMP
+    // register, like any 16-bit timer access
+    inline void write(uint8_t value)
+    {
+      if (_wide)
+        *(volatile uint16_t *)_ocr = value;
+      else
+        *_ocr = value;
+    }
+
+    inline bool valid() const { return _ocr != dummy(); }
+
+  private:
+    uint8_t _pin;
+    volatile uint8_t *_ocr;
+    bool _wide;
+
+    inline void wide(volatile uint16_t *ocr) { _ocr = (volatile uint8_t *)ocr; _wide = true; }
+
+    // Target of handles for pins without PWM
+    static volatile uint8_t *dummy() { static volatile uint8_t reg; return &reg; }
+};
+
+#endif
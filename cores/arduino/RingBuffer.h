@@ -0,0 +1,204 @@
+/*
+  RingBuffer.h - Power-of-two ring buffers and a single producer queue
+  Copyright (c) 2026 Arduino.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef RingBuffer_h
+#define RingBuffer_h
+
+#include <inttypes.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+// Picks the smallest index type that can address a buffer of the given
+// size. Buffers of up to 256 bytes use a single byte index, which keeps
+// the interrupt handlers free of 16-bit arithmetic.
+template <bool wide> struct RingIndexType { typedef uint8_t type; };
+template <> struct RingIndexType<true> { typedef uint16_t type; };
+
+// Index arithmetic for a ring buffer of N slots. The storage itself is
+// left to the user, so it can be laid out wherever access is cheapest.
+// Code that handles buffers of different sizes at runtime (such as
+// HardwareSerial) can still use RingIndex<N>::size to have the size of
+// each buffer checked where it is declared.
+//
+// N must be a power of two, so that wrapping an index is a single AND
+// instead of a division. As is usual for ring buffers, one slot is kept
+// free to tell a full buffer from an empty one, so at most N - 1 bytes
+// can be stored.
+template <unsigned int N>
+class RingIndex
+{
+  static_assert(N >= 2 && (N & (N - 1)) == 0,
+                "Ring buffer size must be a power of 2");
+
+  public:
+    typedef typename RingIndexType<(N > 256)>::type type;
+
+    static const unsigned int size = N;
+    static const type mask = N - 1;
+
+    // Index following i, wrapped around the end of the buffer
+    static inline type next(type i) { return (type)(i + 1) & mask; }
+    // Number of bytes stored between tail (read) and head (write)
+    static inline type count(type head, type tail) { return (type)(head - tail) & mask; }
+    // Number of bytes that can still be written before the buffer is full
+    static inline type space(type head, type tail) { return (type)(tail - head - 1) & mask; }
+};
+
+// Storage of an SpscQueue of N slots, N a power of two
+template <typename T, unsigned int N>
+class SpscFixedStore
+{
+  typedef RingIndex<N> ring;
+
+  public:
+    typedef typename ring::type index_t;
+
+  protected:
+    static inline index_t next(index_t i) { return ring::next(i); }
+    static inline index_t count(index_t head, index_t tail) { return ring::count(head, tail); }
+    static inline index_t space(index_t head, index_t tail) { return ring::space(head, tail); }
+
+    T _buf[N];
+};
+
+// Storage of an SpscQueue given at runtime, for code that handles queues
+// of different sizes with the same functions (such as SoftwareSerial).
+// The size must be a power of two.
+template <typename T>
+class SpscExternalStore
+{
+  public:
+    typedef uint16_t index_t;
+
+  protected:
+    SpscExternalStore(T *buffer, unsigned int size) : _buf(buffer), _mask(size - 1) {}
+
+    inline index_t next(index_t i) const { return (index_t)(i + 1) & _mask; }
+    inline index_t count(index_t head, index_t tail) const { return (index_t)(head - tail) & _mask; }
+    inline index_t space(index_t head, index_t tail) const { return (index_t)(tail - head - 1) & _mask; }
+
+    T * const _buf;
+    const index_t _mask;
+};
+
+// Queue of values of T between one producer and one consumer, typically
+// an interrupt handler and the sketch: push() may only be used on one
+// side and pop(), peek() and clear() only on the other. Neither side has
+// to disable interrupts for an 8-bit index (up to 256 slots), as each
+// index is written by one side only and read in a single instruction.
+// 16-bit indices are read and written with interrupts off. As with
+// RingIndex, one slot is kept free.
+template <typename T, typename Store>
+class SpscQueueBase : public Store
+{
+  public:
+    typedef typename Store::index_t index_t;
+
+    template <typename... Args>
+    SpscQueueBase(Args... args) : Store(args...), _head(0), _tail(0) {}
+
+    // producer side, false if the queue is full
+    inline bool push(const T &value)
+    {
+      index_t head = _head;
+      index_t next = Store::next(head);
+      if (next == load(_tail))
+        return false;
+      this->_buf[head] = value;
+      barrier();   // the value is stored before the consumer can see it
+      store(_head, next);
+      return true;
+    }
+
+    // consumer side, false if the queue is empty
+    inline bool pop(T &value)
+    {
+      index_t tail = _tail;
+      if (tail == load(_head))
+        return false;
+      value = this->_buf[tail];
+      barrier();   // the value is read before the producer can reuse it
+      store(_tail, Store::next(tail));
+      return true;
+    }
+
+    inline bool peek(T &value) const
+    {
+      index_t tail = _tail;
+      if (tail == load(_head))
+        return false;
+      value = this->_buf[tail];
+      return true;
+    }
+
+    // drops everything queued so far
+    inline void clear() { store(_tail, load(_head)); }
+
+    inline index_t available() const { return Store::count(load(_head), load(_tail)); }
+    inline index_t space() const { return Store::space(load(_head), load(_tail)); }
+    inline bool empty() const { return load(_head) == load(_tail); }
+
+  private:
+    static inline void barrier() { asm volatile("" ::: "memory"); }
+
+    static inline index_t load(const volatile index_t &i)
+    {
+      if (sizeof(index_t) == 1)
+        return i;
+      uint8_t oldSREG = SREG;
+      cli();
+      index_t v = i;
+      SREG = oldSREG;
+      return v;
+    }
+
+    static inline void store(volatile index_t &i, index_t v)
+    {
+      if (sizeof(index_t) == 1) {
+        i = v;
+        return;
+      }
+      uint8_t oldSREG = SREG;
+      cli();
+      i = v;
+      SREG = oldSREG;
+    }
+
+    volatile index_t _head;  // written by the producer
+    volatile index_t _tail;  // written by the consumer
+};
+
+// Queue of up to N - 1 values of T, see SpscQueueBase
+template <typename T, unsigned int N>
+class SpscQueue : public SpscQueueBase<T, SpscFixedStore<T, N> >
+{
+};
+
+// Queue over storage given to the constructor, whose size (a power of
+// two) is only known at runtime:
+//   SpscQueue<uint8_t, 0> queue(buffer, sizeof(buffer));
+template <typename T>
+class SpscQueue<T, 0> : public SpscQueueBase<T, SpscExternalStore<T> >
+{
+  public:
+    SpscQueue(T *buffer, unsigned int size) :
+      SpscQueueBase<T, SpscExternalStore<T> >(buffer, size) {}
+};
+
+#endif
@@ -229,6 +229,42 @@ size_t Stream::readBytesUntil(char terminator, char *buffer, size_t length)
   return index; // return number of characters, not including null terminator
 }
 
+// as readBytesUntil, but the buffer is null terminated and everything up
+// to the terminator is consumed, also when it doesn't fit
+size_t Stream::readUntil(char terminator, char *buffer, size_t size)
+{
+  if (size < 1) return 0;
+  size_t index = 0;
+  while (1) {
+    int c = timedRead();
+    if (c < 0 || c == terminator) break;
+    if (index < size - 1)
+      buffer[index++] = (char)c;
+  }
+  buffer[index] = '\0';
+  return index;
+}
+
+// collects the characters available so far into buffer, never waits
+bool Stream::readLine(char *buffer, size_t size, size_t &length)
+{
+  if (size < 1) return false;
+  while (available() > 0) {
+    int c = read();
+    if (c < 0) break;
+    if (c == '\n') {
+      if (length > 0 && buffer[length - 1] == '\r')
+        length--;
+      buffer[length] = '\0';
+      length = 0;
+      return true;
+    }
+    if (length < size - 1)
+      buffer[length++] = (char)c;
+  }
+  return false;
+}
+
 String Stream::readString()
 {
   String ret;
@@ -317,3 +353,192 @@ int Stream::findMulti( struct Stream::MultiTarget *targets, int tCount) {
   // unreachable
   return -1;
 }
+
+int Stream::findMulti(MultiFinder &finder)
+{
+  finder.reset();
+  while (1) {
+    int c = timedRead();
+    if (c < 0)
+      return -1;
+
+    int8_t match = finder.feed(c);
+    if (match >= 0)
+      return match;
+  }
+}
+
+// MultiFinder ///////////////////////////////////////////////////////////////
+
+static inline char stringChar(const char * const *strings, uint8_t i, uint8_t j, bool progmem)
+{
+  if (progmem)
+    return pgm_read_byte((const char *)pgm_read_word(&strings[i]) + j);
+  return strings[i][j];
+}
+
+uint8_t MultiFinder::child(uint8_t node, char c)
+{
+  for (uint8_t n = _nodes[node].child; n; n = _nodes[n].sibling)
+    if (_nodes[n].c == c)
+      return n;
+  return 0;
+}
+
+bool MultiFinder::begin(const char * const *strings, uint8_t count)
+{
+  return build(strings, count, false);
+}
+
+bool MultiFinder::begin_P(const char * const *strings, uint8_t count)
+{
+  return build(strings, count, true);
+}
+
+bool MultiFinder::build(const char * const *strings, uint8_t count, bool progmem)
+{
+  uint8_t maxLen = 0;
+  char c;
+
+  _count = 0;
+  _state = 0;
+  if (_size < 1)
+    return false;
+
+  // node 0 is the root, the empty prefix
+  _nodes[0].c = 0;
+  _nodes[0].child = 0;
+  _nodes[0].sibling = 0;
+  _nodes[0].fail = 0;
+  _nodes[0].match = -1;
+  _count = 1;
+
+  // the trie of all strings
+  for (uint8_t i = 0; i < count; i++) {
+    uint8_t node = 0;
+    uint8_t j;
+    for (j = 0; (c = stringChar(strings, i, j, progmem)) && j < 255; j++) {
+      uint8_t n = child(node, c);
+      if (!n) {
+        if (_count == _size)
+          return false;
+        n = _count++;
+        _nodes[n].c = c;
+        _nodes[n].child = 0;
+        _nodes[n].sibling = _nodes[node].child;
+        _nodes[n].fail = 0;
+        _nodes[n].match = -1;
+        _nodes[node].child = n;
+      }
+      node = n;
+    }
+    if (j == 0)
+      return false;
+    if (_nodes[node].match < 0)
+      _nodes[node].match = i;
+    if (j > maxLen)
+      maxLen = j;
+  }
+
+  // failure links, one depth at a time so the links of the parents are
+  // known; nodes one character deep fail to the root
+  for (uint8_t d = 2; d <= maxLen; d++) {
+    for (uint8_t i = 0; i < count; i++) {
+      uint8_t parent = 0;
+      uint8_t node = 0;
+      uint8_t j;
+      for (j = 0; j < d && (c = stringChar(strings, i, j, progmem)); j++) {
+        parent = node;
+        node = child(node, c);
+      }
+      if (j < d)
+        continue; // shorter than d
+
+      uint8_t f = _nodes[parent].fail;
+      uint8_t n;
+      while (!(n = child(f, c)) && f)
+        f = _nodes[f].fail;
+      _nodes[node].fail = n;
+      if (_nodes[node].match < 0)
+        _nodes[node].match = _nodes[n].match;
+    }
+  }
+  return true;
+}
+
+int8_t MultiFinder::feed(char c)
+{
+  if (_count == 0)
+    return -1;
+
+  uint8_t s = _state;
+  uint8_t n;
+  while (!(n = child(s, c)) && s)
+    s = _nodes[s].fail;
+  _state = n;
+  return _nodes[n].match;
+}
+
+// NumberParser //////////////////////////////////////////////////////////////
+
+void NumberParser::reset()
+{
+  _status = NEED_MORE;
+  _started = false;
+  _negative = false;
+  _fraction = false;
+  _fractionDigits = 0;
+  _value = 0;
+}
+
+// follows the rules of peekNextDigit() and parseInt()/parseFloat(), one
+// available character at a time
+NumberParser::Status NumberParser::parse(Stream &stream)
+{
+  while (_status == NEED_MORE && stream.available() > 0) {
+    int c = stream.peek();
+    if (c < 0)
+      break;
+
+    bool digit = c >= '0' && c <= '9';
+    if (!_started) {
+      if (c == '-' || digit || (_decimal && c == '.')) {
+        _started = true;
+      } else {
+        if (_lookahead == SKIP_NONE ||
+            (_lookahead == SKIP_WHITESPACE &&
+             c != ' ' && c != '\t' && c != '\r' && c != '\n')) {
+          _status = NO_NUMBER;
+          break;
+        }
+        stream.read();  // discard non-numeric
+        continue;
+      }
+    } else if (!digit && c != _ignore && !(_decimal && c == '.' && !_fraction)) {
+      _status = DONE;
+      break;
+    }
+
+    if (c == _ignore)
+      ; // ignore this character
+    else if (c == '-')
+      _negative = true;
+    else if (c == '.')
+      _fraction = true;
+    else {
+      _value = _value * 10 + c - '0';
+      if (_fraction)
+        _fractionDigits++;
+    }
+    stream.read();  // consume the character we got with peek
+  }
+  return _status;
+}
+
+float NumberParser::floatValue() const
+{
+  float value = intValue();
+  for (uint8_t i = 0; i < _fractionDigits; i++)
+    value *= 0.1;
+  return value;
+}
@@ -46,6 +46,44 @@ enum LookaheadMode{
 
 #define NO_IGNORE_CHAR  '\x01' // a char not found in a valid ASCII numeric field
 
+// Aho-Corasick automaton for looking out for several strings at once.
+// feed() does the same work per character however many strings there are
+// and whatever came before, where findMulti() walks back through every
+// target on a mismatch. The automaton lives in a Node array given by the
+// caller, one node per character of all strings plus one (fewer when the
+// strings share prefixes), and is built once by begin() or, for a table of
+// PROGMEM strings in PROGMEM, begin_P().
+class MultiFinder
+{
+  public:
+    struct Node {
+      char c;           // character leading to this node
+      uint8_t child;    // first node one character further, 0 if none
+      uint8_t sibling;  // next child of the same parent, 0 if none
+      uint8_t fail;     // longest suffix that is also a prefix of a string
+      int8_t match;     // string ending here, -1 if none
+    };
+
+    MultiFinder(Node *nodes, uint8_t size) : _nodes(nodes), _size(size), _count(0), _state(0) {}
+
+    // false if there are too many nodes or a string is empty
+    bool begin(const char * const *strings, uint8_t count);
+    bool begin_P(const char * const *strings, uint8_t count);
+
+    // returns the index of the string ending with c, or -1
+    int8_t feed(char c);
+    void reset() { _state = 0; }
+
+  private:
+    bool build(const char * const *strings, uint8_t count, bool progmem);
+    uint8_t child(uint8_t node, char c);
+
+    Node *_nodes;
+    uint8_t _size;
+    uint8_t _count;
+    uint8_t _state;
+};
+
 class Stream : public Print
 {
   protected:
@@ -103,6 +141,21 @@ class Stream : public Print
   // terminates if length characters have been read, timeout, or if the terminator character  detected
   // returns the number of characters placed in the buffer (0 means no valid data found)
 
+  size_t readUntil( char terminator, char *buffer, size_t size); // as readBytesUntil, but null terminated
+  size_t readUntil( char terminator, uint8_t *buffer, size_t size) { return readUntil(terminator, (char *)buffer, size); }
+  // stores up to size - 1 characters and a null, and discards the rest of
+  // the input up to the terminator, so the next read starts after it
+  // returns the number of characters placed in the buffer
+
+  bool readLine( char *buffer, size_t size, size_t &length); // reads what is available of a line, without waiting
+  // call repeatedly with length starting at 0; returns true once a line
+  // ending in '\n' is in buffer (null terminated, without '\r\n'), and sets
+  // length back to 0 for the next line. Lines longer than size - 1 are cut.
+
+  int findMulti(MultiFinder &finder);
+  // reads until one of the strings of finder is found, returns its index
+  // or -1 if timed out
+
   // Arduino String functions to be added here
   String readString();
   String readStringUntil(char terminator);
@@ -125,5 +178,39 @@ class Stream : public Print
   int findMulti(struct MultiTarget *targets, int tCount);
 };
 
+// Incremental version of Stream::parseInt() and parseFloat(): parse()
+// takes only the characters that are already available and returns
+// NEED_MORE, so loop() goes on instead of waiting for the rest of the
+// number. The number is DONE when a character follows that can't be part
+// of it; that character is left in the stream. NO_NUMBER is returned when
+// the lookahead mode rejects a character before the number starts. The
+// state is kept until reset().
+class NumberParser
+{
+  public:
+    enum Status { NEED_MORE, DONE, NO_NUMBER };
+
+    NumberParser(bool decimal = false, LookaheadMode lookahead = SKIP_ALL, char ignore = NO_IGNORE_CHAR)
+      : _decimal(decimal), _lookahead(lookahead), _ignore(ignore) { reset(); }
+
+    void reset();
+    Status parse(Stream &stream);
+    Status status() const { return _status; }
+
+    long intValue() const { return _negative ? -_value : _value; }
+    float floatValue() const;
+
+  private:
+    bool _decimal;
+    LookaheadMode _lookahead;
+    char _ignore;
+    Status _status;
+    bool _started;
+    bool _negative;
+    bool _fraction;
+    uint8_t _fractionDigits;
+    long _value;
+};
+
 #undef NO_IGNORE_CHAR
 #endif
@@ -124,6 +124,70 @@ static uint8_t tone_pins[AVAILABLE_TONE_PINS] = { 255 /*, 255, 255 */ };
 #endif
 
 
+// When the tone pin is the OCnA output of its timer, the timer toggles the
+// pin in hardware (COMnA0 in CTC mode), so a tone costs no interrupts at
+// all. A duration is then timed with a software timer on Timer0 where
+// those exist, otherwise the compare interrupt only counts the toggles.
+static uint8_t tone_hw_timers;
+
+#if defined(TIMER0_COMPB_vect) && defined(OCR0B) && defined(TIMSK0) && defined(OCIE0B)
+#define TONE_SOFT_TIMER
+static softTimer tone_timer;
+
+static void toneTimeout(void *arg)
+{
+  noTone((uint8_t)(uintptr_t)arg);
+}
+#endif
+
+// Connects the pin to the timer in toggle mode, if it is the OCnA pin of
+// the timer. Returns whether it is.
+static bool toneHardware(int8_t _timer, uint8_t _pin)
+{
+  uint8_t t = digitalPinToTimer(_pin);
+
+  switch (_timer)
+  {
+#if defined(TCCR0A) && defined(COM0A0)
+    case 0:
+      if (t != TIMER0A) return false;
+      TCCR0A |= _BV(COM0A0);
+      return true;
+#endif
+#if defined(TCCR1A) && defined(COM1A0)
+    case 1:
+      if (t != TIMER1A) return false;
+      TCCR1A |= _BV(COM1A0);
+      return true;
+#endif
+#if defined(TCCR2A) && defined(COM2A0)
+    case 2:
+      if (t != TIMER2A && t != TIMER2) return false;
+      TCCR2A |= _BV(COM2A0);
+      return true;
+#endif
+#if defined(TCCR3A) && defined(COM3A0)
+    case 3:
+      if (t != TIMER3A) return false;
+      TCCR3A |= _BV(COM3A0);
+      return true;
+#endif
+#if defined(TCCR4A) && defined(COM4A0) && defined(WGM42)
+    case 4:
+      if (t != TIMER4A) return false;
+      TCCR4A |= _BV(COM4A0);
+      return true;
+#endif
+#if defined(TCCR5A) && defined(COM5A0)
+    case 5:
+      if (t != TIMER5A) return false;
+      TCCR5A |= _BV(COM5A0);
+      return true;
+#endif
+    default:
+      return false;
+  }
+}
 
 static int8_t toneBegin(uint8_t _pin)
 {
@@ -136,11 +200,14 @@ static int8_t toneBegin(uint8_t _pin)
     }
   }
   
-  // search for an unused timer.
+  // search for an unused timer, skipping timers claimed by someone else
   for (int i = 0; i < AVAILABLE_TONE_PINS; i++) {
     if (tone_pins[i] == 255) {
+      uint8_t t = pgm_read_byte(tone_pin_to_timer_PGM + i);
+      if (!claimTimer(t, TIMER_OWNER_TONE))
+        continue;
       tone_pins[i] = _pin;
-      _timer = pgm_read_byte(tone_pin_to_timer_PGM + i);
+      _timer = t;
       break;
     }
   }
@@ -238,14 +305,130 @@ static int8_t toneBegin(uint8_t _pin)
 
 
 
+// Sequence played by playToneSequence(), in PROGMEM
+static const ToneNote *tone_seq;
+static const ToneNote *tone_seq_start;
+static uint16_t tone_seq_left;
+static uint16_t tone_seq_count;
+static uint8_t tone_seq_pin;
+static bool tone_seq_repeat;
+
+static void toneStart(uint8_t _pin, unsigned int frequency, unsigned long duration, bool sequenced);
+
+// Called from the timer interrupt when a note is over. Returns whether
+// the next note was started.
+static bool toneSequenceNext()
+{
+  if (!tone_seq)
+    return false;
+
+  if (tone_seq_left == 0)
+  {
+    if (!tone_seq_repeat)
+    {
+      tone_seq = NULL;
+      return false;
+    }
+    tone_seq = tone_seq_start;
+    tone_seq_left = tone_seq_count;
+  }
+
+  unsigned int frequency = pgm_read_word(&tone_seq->frequency);
+  unsigned int duration = pgm_read_word(&tone_seq->duration);
+  tone_seq++;
+  tone_seq_left--;
+
+  toneStart(tone_seq_pin, frequency, duration ? duration : 1, true);
+  return true;
+}
+
+// Plays count notes from the PROGMEM table notes on _pin, one after the
+// other, from the timer interrupt, so the sketch doesn't have to wait
+// for them. A note with frequency 0 is a rest. With repeat set the
+// sequence starts over at the end, until noTone() or tone() is called.
+void playToneSequence(uint8_t _pin, const ToneNote *notes, uint16_t count, bool repeat)
+{
+  if (count == 0)
+    return;
+
+  uint8_t oldSREG = SREG;
+  cli();
+  tone_seq = NULL;
+  SREG = oldSREG;
+
+  tone_seq_start = notes;
+  tone_seq_count = count;
+  tone_seq_repeat = repeat;
+  tone_seq_pin = _pin;
+  tone_seq_left = count - 1;
+
+  unsigned int frequency = pgm_read_word(&notes->frequency);
+  unsigned int duration = pgm_read_word(&notes->duration);
+
+  oldSREG = SREG;
+  cli();
+  tone_seq = notes + 1;
+  toneStart(_pin, frequency, duration ? duration : 1, true);
+  SREG = oldSREG;
+}
+
+bool toneSequencePlaying()
+{
+  return tone_seq != NULL;
+}
+
 // frequency (in hertz) and duration (in milliseconds).
 
 void tone(uint8_t _pin, unsigned int frequency, unsigned long duration)
+{
+  // a tone of its own ends a sequence
+  uint8_t oldSREG = SREG;
+  cli();
+  tone_seq = NULL;
+  SREG = oldSREG;
+
+  toneStart(_pin, frequency, duration, false);
+}
+
+// Disconnects the OCnA toggle output, see toneHardware()
+static void toneDisconnect(int8_t _timer)
+{
+  switch (_timer)
+  {
+#if defined(TCCR0A) && defined(COM0A0)
+    case 0: TCCR0A &= ~_BV(COM0A0); break;
+#endif
+#if defined(TCCR1A) && defined(COM1A0)
+    case 1: TCCR1A &= ~_BV(COM1A0); break;
+#endif
+#if defined(TCCR2A) && defined(COM2A0)
+    case 2: TCCR2A &= ~_BV(COM2A0); break;
+#endif
+#if defined(TCCR3A) && defined(COM3A0)
+    case 3: TCCR3A &= ~_BV(COM3A0); break;
+#endif
+#if defined(TCCR4A) && defined(COM4A0) && defined(WGM42)
+    case 4: TCCR4A &= ~_BV(COM4A0); break;
+#endif
+#if defined(TCCR5A) && defined(COM5A0)
+    case 5: TCCR5A &= ~_BV(COM5A0); break;
+#endif
+  }
+}
+
+// sequenced is set for notes of a sequence, which may be started from the
+// timer interrupt and always need it to move on to the next note.
+static void toneStart(uint8_t _pin, unsigned int frequency, unsigned long duration, bool sequenced)
 {
   uint8_t prescalarbits = 0b001;
   long toggle_count = 0;
   uint32_t ocr = 0;
   int8_t _timer;
+  bool rest = frequency == 0;
+
+  // a rest runs the timer at 1 kHz to time it, with the output off
+  if (rest)
+    frequency = 1000;
 
   _timer = toneBegin(_pin);
 
@@ -356,6 +539,38 @@ void tone(uint8_t _pin, unsigned int frequency, unsigned long duration)
       toggle_count = -1;
     }
 
+    bool interrupt = true;
+#if defined(TONE_SOFT_TIMER)
+    // no software timer is running for sequences, and the timer list must
+    // not be touched from the interrupt
+    if (!sequenced)
+      stopTimer(&tone_timer);
+#endif
+    if (rest)
+    {
+      // the interrupt leaves the pin alone, as for hardware toggling
+      toneDisconnect(_timer);
+      tone_hw_timers |= _BV(_timer);
+      digitalWrite(_pin, LOW);
+    }
+    else if (toneHardware(_timer, _pin))
+    {
+      tone_hw_timers |= _BV(_timer);
+      if (toggle_count < 0)
+        interrupt = false;
+#if defined(TONE_SOFT_TIMER)
+      else if (!sequenced && duration <= 0xffff)
+      {
+        startTimer(&tone_timer, duration, 0, toneTimeout, (void *)(uintptr_t)_pin);
+        interrupt = false;
+      }
+#endif
+    }
+    else
+    {
+      tone_hw_timers &= ~_BV(_timer);
+    }
+
     // Set the OCR for the given timer,
     // set the toggle count,
     // then turn on the interrupts
@@ -366,7 +581,7 @@ void tone(uint8_t _pin, unsigned int frequency, unsigned long duration)
       case 0:
         OCR0A = ocr;
         timer0_toggle_count = toggle_count;
-        bitWrite(TIMSK0, OCIE0A, 1);
+        bitWrite(TIMSK0, OCIE0A, interrupt);
         break;
 #endif
 
@@ -374,12 +589,12 @@ void tone(uint8_t _pin, unsigned int frequency, unsigned long duration)
 #if defined(OCR1A) && defined(TIMSK1) && defined(OCIE1A)
         OCR1A = ocr;
         timer1_toggle_count = toggle_count;
-        bitWrite(TIMSK1, OCIE1A, 1);
+        bitWrite(TIMSK1, OCIE1A, interrupt);
 #elif defined(OCR1A) && defined(TIMSK) && defined(OCIE1A)
         // this combination is for at least the ATmega32
         OCR1A = ocr;
         timer1_toggle_count = toggle_count;
-        bitWrite(TIMSK, OCIE1A, 1);
+        bitWrite(TIMSK, OCIE1A, interrupt);
 #endif
         break;
 
@@ -387,7 +602,7 @@ void tone(uint8_t _pin, unsigned int frequency, unsigned long duration)
       case 2:
         OCR2A = ocr;
         timer2_toggle_count = toggle_count;
-        bitWrite(TIMSK2, OCIE2A, 1);
+        bitWrite(TIMSK2, OCIE2A, interrupt);
         break;
 #endif
 
@@ -395,7 +610,7 @@ void tone(uint8_t _pin, unsigned int frequency, unsigned long duration)
       case 3:
         OCR3A = ocr;
         timer3_toggle_count = toggle_count;
-        bitWrite(TIMSK3, OCIE3A, 1);
+        bitWrite(TIMSK3, OCIE3A, interrupt);
         break;
 #endif
 
@@ -403,7 +618,7 @@ void tone(uint8_t _pin, unsigned int frequency, unsigned long duration)
       case 4:
         OCR4A = ocr;
         timer4_toggle_count = toggle_count;
-        bitWrite(TIMSK4, OCIE4A, 1);
+        bitWrite(TIMSK4, OCIE4A, interrupt);
         break;
 #endif
 
@@ -411,7 +626,7 @@ void tone(uint8_t _pin, unsigned int frequency, unsigned long duration)
       case 5:
         OCR5A = ocr;
         timer5_toggle_count = toggle_count;
-        bitWrite(TIMSK5, OCIE5A, 1);
+        bitWrite(TIMSK5, OCIE5A, interrupt);
         break;
 #endif
 
@@ -428,6 +643,9 @@ void disableTimer(uint8_t _timer)
   switch (_timer)
   {
     case 0:
+      #if defined(TCCR0A) && defined(COM0A0)
+        bitWrite(TCCR0A, COM0A0, 0);
+      #endif
       #if defined(TIMSK0)
         TIMSK0 = 0;
       #elif defined(TIMSK)
@@ -438,6 +656,9 @@ void disableTimer(uint8_t _timer)
 #if defined(TIMSK1) && defined(OCIE1A)
     case 1:
       bitWrite(TIMSK1, OCIE1A, 0);
+#if defined(COM1A0)
+      bitWrite(TCCR1A, COM1A0, 0);
+#endif
       break;
 #endif
 
@@ -459,27 +680,57 @@ void disableTimer(uint8_t _timer)
 #if defined(TIMSK3) && defined(OCIE3A)
     case 3:
       bitWrite(TIMSK3, OCIE3A, 0);
+#if defined(COM3A0)
+      bitWrite(TCCR3A, COM3A0, 0);
+#endif
       break;
 #endif
 
 #if defined(TIMSK4) && defined(OCIE4A)
     case 4:
       bitWrite(TIMSK4, OCIE4A, 0);
+#if defined(COM4A0)
+      bitWrite(TCCR4A, COM4A0, 0);
+#endif
       break;
 #endif
 
 #if defined(TIMSK5) && defined(OCIE5A)
     case 5:
       bitWrite(TIMSK5, OCIE5A, 0);
+#if defined(COM5A0)
+      bitWrite(TCCR5A, COM5A0, 0);
+#endif
       break;
 #endif
   }
 }
 
 
+#if defined(USE_TIMER0) || defined(USE_TIMER1) || defined(USE_TIMER3) || \
+    defined(USE_TIMER4) || defined(USE_TIMER5)
+// Called from the compare match interrupt when a tone of limited duration
+// is over: stops the timer and hands it back, like noTone() does
+static void toneStopped(uint8_t _timer)
+{
+  for (int i = 0; i < AVAILABLE_TONE_PINS; i++) {
+    if (tone_pins[i] != 255 && pgm_read_byte(tone_pin_to_timer_PGM + i) == _timer) {
+      tone_pins[i] = 255;
+      break;
+    }
+  }
+  tone_hw_timers &= ~_BV(_timer);
+  disableTimer(_timer);
+  releaseTimer(_timer, TIMER_OWNER_TONE);
+}
+#endif
+
 void noTone(uint8_t _pin)
 {
   int8_t _timer = -1;
+
+  if (_pin == tone_seq_pin)
+    tone_seq = NULL;
   
   for (int i = 0; i < AVAILABLE_TONE_PINS; i++) {
     if (tone_pins[i] == _pin) {
@@ -489,7 +740,15 @@ void noTone(uint8_t _pin)
     }
   }
   
-  disableTimer(_timer);
+#if defined(TONE_SOFT_TIMER)
+  stopTimer(&tone_timer);
+#endif
+  if (_timer >= 0)
+  {
+    tone_hw_timers &= ~_BV(_timer);
+    disableTimer(_timer);
+    releaseTimer(_timer, TIMER_OWNER_TONE);
+  }
 
   digitalWrite(_pin, 0);
 }
@@ -499,15 +758,16 @@ ISR(TIMER0_COMPA_vect)
 {
   if (timer0_toggle_count != 0)
   {
-    // toggle the pin
-    *timer0_pin_port ^= timer0_pin_mask;
+    // toggle the pin, unless the timer does it
+    if (!(tone_hw_timers & _BV(0)))
+      *timer0_pin_port ^= timer0_pin_mask;
 
     if (timer0_toggle_count > 0)
       timer0_toggle_count--;
   }
-  else
+  else if (!toneSequenceNext())
   {
-    disableTimer(0);
+    toneStopped(0);
     *timer0_pin_port &= ~(timer0_pin_mask);  // keep pin low after stop
   }
 }
@@ -519,15 +779,16 @@ ISR(TIMER1_COMPA_vect)
 {
   if (timer1_toggle_count != 0)
   {
-    // toggle the pin
-    *timer1_pin_port ^= timer1_pin_mask;
+    // toggle the pin, unless the timer does it
+    if (!(tone_hw_timers & _BV(1)))
+      *timer1_pin_port ^= timer1_pin_mask;
 
     if (timer1_toggle_count > 0)
       timer1_toggle_count--;
   }
-  else
+  else if (!toneSequenceNext())
   {
-    disableTimer(1);
+    toneStopped(1);
     *timer1_pin_port &= ~(timer1_pin_mask);  // keep pin low after stop
   }
 }
@@ -540,13 +801,14 @@ ISR(TIMER2_COMPA_vect)
 
   if (timer2_toggle_count != 0)
   {
-    // toggle the pin
-    *timer2_pin_port ^= timer2_pin_mask;
+    // toggle the pin, unless the timer does it
+    if (!(tone_hw_timers & _BV(2)))
+      *timer2_pin_port ^= timer2_pin_mask;
 
     if (timer2_toggle_count > 0)
       timer2_toggle_count--;
   }
-  else
+  else if (!toneSequenceNext())
   {
     // need to call noTone() so that the tone_pins[] entry is reset, so the
     // timer gets initialized next time we call tone().
@@ -564,15 +826,16 @@ ISR(TIMER3_COMPA_vect)
 {
   if (timer3_toggle_count != 0)
   {
-    // toggle the pin
-    *timer3_pin_port ^= timer3_pin_mask;
+    // toggle the pin, unless the timer does it
+    if (!(tone_hw_timers & _BV(3)))
+      *timer3_pin_port ^= timer3_pin_mask;
 
     if (timer3_toggle_count > 0)
       timer3_toggle_count--;
   }
-  else
+  else if (!toneSequenceNext())
   {
-    disableTimer(3);
+    toneStopped(3);
     *timer3_pin_port &= ~(timer3_pin_mask);  // keep pin low after stop
   }
 }
@@ -584,15 +847,16 @@ ISR(TIMER4_COMPA_vect)
 {
   if (timer4_toggle_count != 0)
   {
-    // toggle the pin
-    *timer4_pin_port ^= timer4_pin_mask;
+    // toggle the pin, unless the timer does it
+    if (!(tone_hw_timers & _BV(4)))
+      *timer4_pin_port ^= timer4_pin_mask;
 
     if (timer4_toggle_count > 0)
       timer4_toggle_count--;
   }
-  else
+  else if (!toneSequenceNext())
   {
-    disableTimer(4);
+    toneStopped(4);
     *timer4_pin_port &= ~(timer4_pin_mask);  // keep pin low after stop
   }
 }
@@ -604,15 +868,16 @@ ISR(TIMER5_COMPA_vect)
 {
   if (timer5_toggle_count != 0)
   {
-    // toggle the pin
-    *timer5_pin_port ^= timer5_pin_mask;
+    // toggle the pin, unless the timer does it
+    if (!(tone_hw_timers & _BV(5)))
+      *timer5_pin_port ^= timer5_pin_mask;
 
     if (timer5_toggle_count > 0)
       timer5_toggle_count--;
   }
-  else
+  else if (!toneSequenceNext())
   {
-    disableTimer(5);
+    toneStopped(5);
     *timer5_pin_port &= ~(timer5_pin_mask);  // keep pin low after stop
   }
 }
@@ -55,6 +55,14 @@ typedef unsigned long u32;
 #define EP_TYPE_ISOCHRONOUS_IN		((1<<EPTYPE0) | (1<<EPDIR))
 #define EP_TYPE_ISOCHRONOUS_OUT		(1<<EPTYPE0)
 
+// Bank layout of an endpoint (UECFG1X) for
+// PluggableUSBModule::endpointConfig: size is 8, 16, 32 or 64 bytes,
+// banks is 1 or 2. All endpoints share the 832 bytes of endpoint memory
+// (176 on the U2 series); only endpoint 1, which CDC uses, could hold
+// larger banks.
+#define EP_BANK_SIZE(size)			((size) <= 8 ? 0 : (size) <= 16 ? 1 : (size) <= 32 ? 2 : 3)
+#define EP_CONFIG(size, banks)		((EP_BANK_SIZE(size) << EPSIZE0) | (((banks) - 1) << EPBK0) | (1 << ALLOC))
+
 class USBDevice_
 {
 public:
@@ -63,11 +71,24 @@ public:
 
 	void attach();
 	void detach();	// Serial port goes down too...
-	void poll();
+	void poll();	// sleeps while suspended if USB_SUSPEND_SLEEP is set
+	bool suspended();
 	bool wakeupHost(); // returns false, when wakeup cannot be processed
 };
 extern USBDevice_ USBDevice;
 
+// When the host suspends the bus the USB clock is frozen and the PLL
+// stopped. With USB_SUSPEND_SLEEP set to 1 the main loop also puts the
+// CPU into power-down until the host resumes, so the sketch does not
+// run while suspended.
+#ifndef USB_SUSPEND_SLEEP
+#define USB_SUSPEND_SLEEP 0
+#endif
+
+// Called from the USB interrupt when the bus is suspended (true) and
+// when it resumes (false), e.g. to switch external loads off and on
+void USB_SuspendCallback(bool suspended) __attribute__((weak));
+
 //================================================================================
 //================================================================================
 //	Serial over CDC (Serial1 is the physical port)
@@ -85,12 +106,37 @@ struct ring_buffer;
 #error Please lower the CDC Buffer size
 #endif
 
+// Ring for Serial writes in non-blocking mode, see setNonBlockingWrite().
+// Off by default; without it, non-blocking writes only go as far as the
+// endpoint banks take them.
+#ifndef CDC_TX_BUFFER_SIZE
+#define CDC_TX_BUFFER_SIZE 0
+#endif
+#if (CDC_TX_BUFFER_SIZE>256) || (CDC_TX_BUFFER_SIZE==1)
+#error CDC_TX_BUFFER_SIZE must be 0 or between 2 and 256
+#endif
+
+// Arguments of Serial.setFlushPolicy() besides a number of frames
+#define CDC_FLUSH_IMMEDIATE 0
+#define CDC_FLUSH_FULL 0xFF
+
 class Serial_ : public Stream
 {
 private:
-	int peek_buffer;
+	volatile bool _rx_paused;
+	bool _tx_nonblocking;
+	uint8_t _flush_frames;
+	uint8_t _flush_count;
 public:
-	Serial_() { peek_buffer = -1; };
+	Serial_() {
+		_rx_buffer_head = _rx_buffer_tail = 0;
+#if CDC_TX_BUFFER_SIZE
+		_tx_buffer_head = _tx_buffer_tail = 0;
+#endif
+		_rx_paused = _tx_nonblocking = false;
+		_flush_frames = 1;
+		_flush_count = 0;
+	};
 	void begin(unsigned long);
 	void begin(unsigned long, uint8_t);
 	void end(void);
@@ -105,10 +151,41 @@ public:
 	using Print::write; // pull in write(str) and write(buf, size) from Print
 	operator bool();
 
+	// Received packets are moved from the CDC_RX endpoint into this ring
+	// by the endpoint interrupt, so the host can keep sending while the
+	// sketch catches up; SERIAL_BUFFER_SIZE sets its size.
 	volatile uint8_t _rx_buffer_head;
 	volatile uint8_t _rx_buffer_tail;
 	unsigned char _rx_buffer[SERIAL_BUFFER_SIZE];
 
+	// In non-blocking mode write() never waits for the host: what does
+	// not fit in the endpoint banks goes into a ring of
+	// CDC_TX_BUFFER_SIZE bytes, which the start-of-frame interrupt sends
+	// every millisecond, and what does not fit in the ring is dropped
+	// (write() returns the bytes taken). Switching back to blocking mode
+	// waits up to USB_SEND_TIMEOUT ms for the ring to empty and discards
+	// the rest.
+	void setNonBlockingWrite(bool enable);
+#if CDC_TX_BUFFER_SIZE
+	volatile uint8_t _tx_buffer_head;
+	volatile uint8_t _tx_buffer_tail;
+	unsigned char _tx_buffer[CDC_TX_BUFFER_SIZE];
+#endif
+
+	// When a bank that is not full yet goes to the host. The host only
+	// takes one packet per bank, so sending bytes right away costs a
+	// packet per write(), while holding them back adds latency:
+	//   CDC_FLUSH_IMMEDIATE - at the end of each write(), for command and
+	//                         response tools
+	//   1 to 254            - every that many frames (ms), 1 by default
+	//   CDC_FLUSH_FULL      - only when full or on flush(), for bulk
+	//                         logging at the highest rate
+	void setFlushPolicy(uint8_t frames) { _flush_frames = frames; _flush_count = 0; }
+
+	// Interrupt handlers - Not intended to be called externally
+	void _rx_complete_irq(void);
+	void _tx_sof_irq(void);
+
 	// This method allows processing "SEND_BREAK" requests sent by
 	// the USB host. Those requests indicate that the host wants to
 	// send a BREAK signal and are accompanied by a single uint16_t
@@ -183,6 +260,8 @@ bool	MSC_Data(uint8_t rx,uint8_t tx);
 int		CDC_GetInterface(uint8_t* interfaceNum);
 int		CDC_GetDescriptor(int i);
 bool	CDC_Setup(USBSetup& setup);
+void	CDC_Receive(void);		// called from the endpoint interrupt
+void	CDC_Transmit(void);		// called from the start-of-frame interrupt
 
 //================================================================================
 //================================================================================
@@ -190,6 +269,43 @@ bool	CDC_Setup(USBSetup& setup);
 #define TRANSFER_PGM		0x80
 #define TRANSFER_RELEASE	0x40
 #define TRANSFER_ZERO		0x20
+#define TRANSFER_NOWAIT		0x10	// USB_Send() returns when the banks are full
+#define TRANSFER_NOZLP		0x08	// no zero length packet after a full last bank
+
+// Build with USB_STATS=1 to have USBCore count the traffic of each
+// endpoint and the bus events, e.g. to tell a slow host from a slow
+// sketch. Endpoint 0 (control transfers) is not counted.
+#ifndef USB_STATS
+#define USB_STATS 0
+#endif
+
+typedef struct
+{
+	uint32_t bytes;		// bytes sent (IN) or received (OUT)
+	uint16_t packets;	// banks handed to or taken from the host
+	uint16_t busy;		// times USB_Send() found no free bank (host NAKing)
+	uint16_t timeouts;	// USB_Send() calls that gave up or, with
+						// TRANSFER_NOWAIT, returned short
+} USBEndpointStats;
+
+typedef struct
+{
+	uint32_t frames;	// start-of-frame interrupts, one per ms on the bus
+	uint16_t resets;	// bus resets
+	uint16_t suspends;
+	uint16_t resumes;
+} USBDeviceStats;
+
+#if USB_STATS
+void USB_GetEndpointStats(uint8_t ep, USBEndpointStats* stats);
+void USB_GetDeviceStats(USBDeviceStats* stats);
+void USB_ClearStats(void);
+#endif
+
+// How long USB_Send() waits for the host to free a bank, in milliseconds
+#ifndef USB_SEND_TIMEOUT
+#define USB_SEND_TIMEOUT 250
+#endif
 
 int USB_SendControl(uint8_t flags, const void* d, int len);
 int USB_RecvControl(void* d, int len);
@@ -198,9 +314,11 @@ int USB_RecvControlLong(void* d, int len);
 uint8_t	USB_Available(uint8_t ep);
 uint8_t USB_SendSpace(uint8_t ep);
 int USB_Send(uint8_t ep, const void* data, int len);	// blocking
+void USB_SetSendTimeout(uint16_t ms);
 int USB_Recv(uint8_t ep, void* data, int len);		// non-blocking
 int USB_Recv(uint8_t ep);							// non-blocking
 void USB_Flush(uint8_t ep);
+void USB_RecvInterrupt(uint8_t ep, bool enable);	// RXOUT interrupt on/off
 
 #endif
 
@@ -19,7 +19,9 @@
 
 #include "USBAPI.h"
 #include "PluggableUSB.h"
+#include "Profile.h"
 #include <stdlib.h>
+#include <avr/sleep.h>
 
 #if defined(USBCON)
 
@@ -79,6 +81,47 @@ volatile u8 _usbConfiguration = 0;
 volatile u8 _usbCurrentStatus = 0; // meaning of bits see usb_20.pdf, Figure 9-4. Information Returned by a GetStatus() Request to a Device
 volatile u8 _usbSuspendState = 0; // copy of UDINT to check SUSPI and WAKEUPI bits
 
+#if USB_STATS
+static USBEndpointStats _usbEndpointStats[USB_ENDPOINTS];
+static USBDeviceStats _usbDeviceStats;
+
+// Counters are also bumped from USB_GEN_vect and USB_COM_vect
+#define USB_COUNT_EP(ep, field, n) do { \
+		u8 _sreg = SREG; cli(); \
+		_usbEndpointStats[(ep) & 7].field += (n); \
+		SREG = _sreg; \
+	} while (0)
+#define USB_COUNT_DEV(field) (_usbDeviceStats.field++)	// ISR only
+
+void USB_GetEndpointStats(u8 ep, USBEndpointStats* stats)
+{
+	u8 sreg = SREG;
+	cli();
+	*stats = _usbEndpointStats[ep & 7];
+	SREG = sreg;
+}
+
+void USB_GetDeviceStats(USBDeviceStats* stats)
+{
+	u8 sreg = SREG;
+	cli();
+	*stats = _usbDeviceStats;
+	SREG = sreg;
+}
+
+void USB_ClearStats(void)
+{
+	u8 sreg = SREG;
+	cli();
+	memset(_usbEndpointStats, 0, sizeof(_usbEndpointStats));
+	memset(&_usbDeviceStats, 0, sizeof(_usbDeviceStats));
+	SREG = sreg;
+}
+#else
+#define USB_COUNT_EP(ep, field, n)
+#define USB_COUNT_DEV(field)
+#endif
+
 static inline void WaitIN(void)
 {
 	while (!(UEINTX & (1<<TXINI)))
@@ -130,6 +173,67 @@ static inline void Send8(u8 d)
 	UEDATX = d;
 }
 
+// Block moves between memory and the endpoint FIFO for USB_Send() and
+// USB_Recv(), unrolled by eight so a full 64-byte packet costs about 4
+// cycles per byte (5 from flash) rather than a loop iteration per byte
+static inline void SendBlock(const u8* data, u8 count)
+{
+	for (; count >= 8; count -= 8, data += 8)
+	{
+		UEDATX = data[0];
+		UEDATX = data[1];
+		UEDATX = data[2];
+		UEDATX = data[3];
+		UEDATX = data[4];
+		UEDATX = data[5];
+		UEDATX = data[6];
+		UEDATX = data[7];
+	}
+	while (count--)
+		UEDATX = *data++;
+}
+
+static inline u8 ReadFlashInc(const u8*& data)
+{
+	u8 c;
+	__asm__ __volatile__ ("lpm %0, Z+" : "=r" (c), "+z" (data));
+	return c;
+}
+
+static inline void SendBlock_P(const u8* data, u8 count)
+{
+	for (; count >= 8; count -= 8)
+	{
+		UEDATX = ReadFlashInc(data);
+		UEDATX = ReadFlashInc(data);
+		UEDATX = ReadFlashInc(data);
+		UEDATX = ReadFlashInc(data);
+		UEDATX = ReadFlashInc(data);
+		UEDATX = ReadFlashInc(data);
+		UEDATX = ReadFlashInc(data);
+		UEDATX = ReadFlashInc(data);
+	}
+	while (count--)
+		UEDATX = ReadFlashInc(data);
+}
+
+static inline void RecvBlock(u8* data, u8 count)
+{
+	for (; count >= 8; count -= 8, data += 8)
+	{
+		data[0] = UEDATX;
+		data[1] = UEDATX;
+		data[2] = UEDATX;
+		data[3] = UEDATX;
+		data[4] = UEDATX;
+		data[5] = UEDATX;
+		data[6] = UEDATX;
+		data[7] = UEDATX;
+	}
+	while (count--)
+		*data++ = UEDATX;
+}
+
 static inline void SetEP(u8 ep)
 {
 	UENUM = ep;
@@ -140,6 +244,12 @@ static inline u8 FifoByteCount()
 	return UEBCLX;
 }
 
+// Bank size of the selected endpoint, from its EPSIZE bits
+static inline u8 BankSize()
+{
+	return 8 << ((UECFG1X >> EPSIZE0) & 0x03);
+}
+
 static inline u8 ReceivedSetupInt()
 {
 	return UEINTX & (1<<RXSTPI);
@@ -226,12 +336,25 @@ int USB_Recv(u8 ep, void* d, int len)
 	LockEP lock(ep);
 	u8 n = FifoByteCount();
 	len = min(n,len);
-	n = len;
-	u8* dst = (u8*)d;
-	while (n--)
-		*dst++ = Recv8();
-	if (len && !FifoByteCount())	// release empty buffer
+	if (len)
+	{
+		RecvBlock((u8*)d, len);
+		RXLED1;					// light the RX LED
+		RxLEDPulse = TX_RX_LED_PULSE_MS;
+		USB_COUNT_EP(ep, bytes, len);
+		if (!FifoByteCount())	// release empty buffer
+		{
+			ReleaseRX();
+			USB_COUNT_EP(ep, packets, 1);
+		}
+	}
+	else if (n == 0 && (UEINTX & (1<<RXOUTI)))
+	{
+		// a zero length packet: release the bank, or RXOUTI stays set
+		// and the endpoint interrupt comes back forever
 		ReleaseRX();
+		USB_COUNT_EP(ep, packets, 1);
+	}
 	
 	return len;
 }
@@ -251,10 +374,21 @@ u8 USB_SendSpace(u8 ep)
 	LockEP lock(ep);
 	if (!ReadWriteAllowed())
 		return 0;
-	return USB_EP_SIZE - FifoByteCount();
+	return BankSize() - FifoByteCount();
+}
+
+static u16 _usbSendTimeout = USB_SEND_TIMEOUT;
+
+void USB_SetSendTimeout(u16 ms)
+{
+	_usbSendTimeout = ms;
 }
 
 //	Blocking Send of data to an endpoint
+//	Polls for a free bank (RWAL, which follows TXINI on an IN endpoint)
+//	and gives up after _usbSendTimeout ms without a free bank. With
+//	TRANSFER_NOWAIT it returns at the first full bank instead, with the
+//	number of bytes accepted.
 int USB_Send(u8 ep, const void* d, int len)
 {
 	if (!_usbConfiguration)
@@ -262,24 +396,43 @@ int USB_Send(u8 ep, const void* d, int len)
 
 	if (_usbSuspendState & (1<<SUSPI)) {
 		//send a remote wakeup
-		UDCON |= (1 << RMWKUP);
+		USBDevice.wakeupHost();
 	}
 
 	int r = len;
 	const u8* data = (const u8*)d;
-	u8 timeout = 250;		// 250ms timeout on send? TODO
+	u16 start = millis();
 	bool sendZlp = false;
+	bool busy = false;
 
 	while (len || sendZlp)
 	{
 		u8 n = USB_SendSpace(ep);
 		if (n == 0)
 		{
-			if (!(--timeout))
+			if (!busy) {
+				USB_COUNT_EP(ep, busy, 1);
+				TRACE_BEGIN(USB_SEND_WAIT);
+			}
+			busy = true;
+			if (ep & TRANSFER_NOWAIT)
+			{
+				TRACE_END(USB_SEND_WAIT);
+				if (len)
+					USB_COUNT_EP(ep, timeouts, 1);
+				return r - len;	// a pending zero length packet is dropped
+			}
+			if (!_usbConfiguration || (u16)((u16)millis() - start) >= _usbSendTimeout)
+			{
+				TRACE_END(USB_SEND_WAIT);
+				USB_COUNT_EP(ep, timeouts, 1);
 				return -1;
-			delay(1);
+			}
 			continue;
 		}
+		TRACE_END(USB_SEND_WAIT);
+		start = millis();
+		busy = false;
 
 		if (n > len) {
 			n = len;
@@ -292,6 +445,7 @@ int USB_Send(u8 ep, const void* d, int len)
 				continue;
 
 			len -= n;
+			USB_COUNT_EP(ep, bytes, n);
 			if (ep & TRANSFER_ZERO)
 			{
 				while (n--)
@@ -299,24 +453,27 @@ int USB_Send(u8 ep, const void* d, int len)
 			}
 			else if (ep & TRANSFER_PGM)
 			{
-				while (n--)
-					Send8(pgm_read_byte(data++));
+				SendBlock_P(data, n);
+				data += n;
 			}
 			else
 			{
-				while (n--)
-					Send8(*data++);
+				SendBlock(data, n);
+				data += n;
 			}
 
 			if (sendZlp) {
 				ReleaseTX();
+				USB_COUNT_EP(ep, packets, 1);
 				sendZlp = false;
 			} else if (!ReadWriteAllowed()) { // ...release if buffer is full...
 				ReleaseTX();
-				if (len == 0) sendZlp = true;
+				USB_COUNT_EP(ep, packets, 1);
+				if (len == 0 && !(ep & TRANSFER_NOZLP)) sendZlp = true;
 			} else if ((len == 0) && (ep & TRANSFER_RELEASE)) { // ...or if forced with TRANSFER_RELEASE
-				// XXX: TRANSFER_RELEASE is never used can be removed?
+				// (Serial with CDC_FLUSH_IMMEDIATE)
 				ReleaseTX();
+				USB_COUNT_EP(ep, packets, 1);
 			}
 		}
 	}
@@ -336,10 +493,26 @@ u8 _initEndpoints[USB_ENDPOINTS] =
 	// Following endpoints are automatically initialized to 0
 };
 
-#define EP_SINGLE_64 0x32	// EP0
-#define EP_DOUBLE_64 0x36	// Other endpoints
+// UECFG1X of each endpoint as set by a PluggableUSB module, 0 for the
+// default from EndpointBanks()
+u8 _initEndpointConfig[USB_ENDPOINTS];
+
+#define EP_SINGLE_64 0x32	// EP0 and interrupt endpoints
+#define EP_DOUBLE_64 0x36	// Bulk and isochronous endpoints
 #define EP_SINGLE_16 0x12
 
+// Bulk endpoints get two banks, so the controller can move one packet on
+// the bus while USB_Send()/USB_Recv() work on the other. Interrupt
+// endpoints only carry a short report per polling interval; one bank is
+// enough there and leaves DPRAM (832 bytes on the 32U4) for PluggableUSB
+// endpoints.
+static inline u8 EndpointBanks(u8 type)
+{
+	if ((type & ((1<<EPTYPE1) | (1<<EPTYPE0))) == ((1<<EPTYPE1) | (1<<EPTYPE0)))
+		return EP_SINGLE_64;
+	return EP_DOUBLE_64;
+}
+
 static
 void InitEP(u8 index, u8 type, u8 size)
 {
@@ -357,16 +530,25 @@ void InitEndpoints()
 		UENUM = i;
 		UECONX = (1<<EPEN);
 		UECFG0X = _initEndpoints[i];
+		u8 config = _initEndpointConfig[i];
+		if (!config)
+		{
 #if USB_EP_SIZE == 16
-		UECFG1X = EP_SINGLE_16;
+			config = EP_SINGLE_16;
 #elif USB_EP_SIZE == 64
-		UECFG1X = EP_DOUBLE_64;
+			config = EndpointBanks(_initEndpoints[i]);
 #else
 #error Unsupported value for USB_EP_SIZE
 #endif
+		}
+		UECFG1X = config;
 	}
 	UERST = 0x7E;	// And reset them
 	UERST = 0;
+
+	// CDC_RX is drained into Serial's ring from the endpoint interrupt
+	UENUM = CDC_RX;
+	UEIENX = 1 << RXOUTE;
 }
 
 //	Handle CLASS_INTERFACE requests
@@ -481,6 +663,14 @@ static u8 SendInterfaces()
 static
 bool SendConfiguration(int maxlen)
 {
+	if (USB_FixedConfiguration)
+	{
+		const u8* desc = (const u8*)USB_FixedConfiguration();
+		InitControl(maxlen);
+		USB_SendControl(TRANSFER_PGM,desc,pgm_read_word(desc + 2));
+		return true;
+	}
+
 	//	Count and measure interfaces
 	InitControl(0);
 	u8 interfaces = SendInterfaces();
@@ -544,9 +734,49 @@ bool SendDescriptor(USBSetup& setup)
 	return true;
 }
 
-//	Endpoint 0 interrupt
+#if CORE_ISR_NOBLOCK
+// Descriptor and class requests walk the PluggableUSB modules and may
+// take a while, so they run with interrupts enabled and RXSTPE masked.
+// CDC_RX may still come in meanwhile and is handled by a nested
+// USB_COM_vect, which leaves the setup request alone.
+static volatile bool _usbSetupBusy;
+
+static inline void SetupUnblock()
+{
+	UEIENX &= ~(1<<RXSTPE);		// endpoint 0 is selected
+	_usbSetupBusy = true;
+	sei();
+}
+
+static inline void SetupBlock()
+{
+	cli();
+	_usbSetupBusy = false;
+	SetEP(0);
+	UEIENX |= (1<<RXSTPE);
+}
+#else
+static inline void SetupUnblock() { }
+static inline void SetupBlock() { }
+#endif
+
+//	Endpoint interrupt: setup packets on endpoint 0, received data on CDC_RX
 ISR(USB_COM_vect)
 {
+    PROFILE_SCOPE(PROFILE_USB_COM);
+    TRACE_SCOPE(USB_COM);
+	if (UEINT & (1 << CDC_RX))
+	{
+		u8 ep = UENUM;	// the sketch may be between SetEP() and a FIFO access
+		CDC_Receive();
+		SetEP(ep);
+	}
+
+#if CORE_ISR_NOBLOCK
+	if (_usbSetupBusy)
+		return;
+#endif
+
     SetEP(0);
 	if (!ReceivedSetupInt())
 		return;
@@ -605,6 +835,7 @@ ISR(USB_COM_vect)
 		}
 		else if (GET_DESCRIPTOR == r)
 		{
+			SetupUnblock();
 			ok = SendDescriptor(setup);
 		}
 		else if (SET_DESCRIPTOR == r)
@@ -634,8 +865,10 @@ ISR(USB_COM_vect)
 	else
 	{
 		InitControl(setup.wLength);		//	Max length of transfer
+		SetupUnblock();
 		ok = ClassInterfaceRequest(setup);
 	}
+	SetupBlock();
 
 	if (ok)
 		ClearIN();
@@ -649,17 +882,27 @@ void USB_Flush(u8 ep)
 {
 	SetEP(ep);
 	if (FifoByteCount())
+	{
 		ReleaseTX();
+		USB_COUNT_EP(ep, packets, 1);
+	}
+}
+
+void USB_RecvInterrupt(u8 ep, bool enable)
+{
+	LockEP lock(ep);
+	if (enable)
+		UEIENX |= (1<<RXOUTE);
+	else
+		UEIENX &= ~(1<<RXOUTE);
 }
 
+// Stops the USB clock for suspend. The controller and the VBUS pad stay
+// on, so VBUS is still seen and the host can resume the bus.
 static inline void USB_ClockDisable()
 {
-#if defined(OTGPADE)
-	USBCON = (USBCON & ~(1<<OTGPADE)) | (1<<FRZCLK); // freeze clock and disable VBUS Pad
-#else // u2 Series
-	USBCON = (1 << FRZCLK); // freeze clock
-#endif
-	PLLCSR &= ~(1<<PLLE);  // stop PLL
+	USBCON |= (1<<FRZCLK);	// freeze clock
+	PLLCSR &= ~(1<<PLLE);	// stop PLL
 }
 
 static inline void USB_ClockEnable()
@@ -738,9 +981,25 @@ static inline void USB_ClockEnable()
 #endif
 }
 
+// Undoes USB_ClockDisable() on resume: the PLL prescaler and the rest of
+// the USB setup are kept while suspended
+static inline void USB_ClockResume()
+{
+	PLLCSR |= (1<<PLLE);
+	while (!(PLLCSR & (1<<PLOCK)))		// wait for lock pll
+	{
+	}
+	USBCON &= ~(1<<FRZCLK);	// start USB clock
+}
+
 //	General interrupt
 ISR(USB_GEN_vect)
 {
+	PROFILE_SCOPE(PROFILE_USB_GEN);
+	TRACE_SCOPE(USB_GEN);
+#if CORE_ISR_NOBLOCK
+	u8 ep = UENUM;	// USB_COM_vect may be in the middle of a setup request
+#endif
 	u8 udint = UDINT;
 	UDINT &= ~((1<<EORSTI) | (1<<SOFI)); // clear the IRQ flags for the IRQs which are handled here, except WAKEUPI and SUSPI (see below)
 
@@ -748,6 +1007,7 @@ ISR(USB_GEN_vect)
 	if (udint & (1<<EORSTI))
 	{
 		InitEP(0,EP_TYPE_CONTROL,EP_SINGLE_64);	// init ep0
+		USB_COUNT_DEV(resets);
 		_usbConfiguration = 0;			// not configured yet
 		UEIENX = 1 << RXSTPE;			// Enable interrupts for ep0
 	}
@@ -755,7 +1015,12 @@ ISR(USB_GEN_vect)
 	//	Start of Frame - happens every millisecond so we use it for TX and RX LED one-shot timing, too
 	if (udint & (1<<SOFI))
 	{
-		USB_Flush(CDC_TX);				// Send a tx frame if found
+		USB_COUNT_DEV(frames);
+		CDC_Transmit();					// Move queued Serial bytes into the endpoint and flush it
+#ifdef PLUGGABLE_USB_ENABLED
+		if (_usbConfiguration)
+			PluggableUSB().startOfFrame();
+#endif
 		
 		// check whether the one-shot period has elapsed.  if so, turn off the LED
 		if (TxLEDPulse && !(--TxLEDPulse))
@@ -771,22 +1036,31 @@ ISR(USB_GEN_vect)
 	{
 		UDIEN = (UDIEN & ~(1<<WAKEUPE)) | (1<<SUSPE); // Disable interrupts for WAKEUP and enable interrupts for SUSPEND
 
-		//TODO
 		// WAKEUPI shall be cleared by software (USB clock inputs must be enabled before).
-		//USB_ClockEnable();
+		USB_ClockResume();
 		UDINT &= ~(1<<WAKEUPI);
 		_usbSuspendState = (_usbSuspendState & ~(1<<SUSPI)) | (1<<WAKEUPI);
+		USB_COUNT_DEV(resumes);
+		if (USB_SuspendCallback)
+			USB_SuspendCallback(false);
 	}
 	else if (udint & (1<<SUSPI)) // only one of the WAKEUPI / SUSPI bits can be active at time
 	{
 		UDIEN = (UDIEN & ~(1<<SUSPE)) | (1<<WAKEUPE); // Disable interrupts for SUSPEND and enable interrupts for WAKEUP
 
-		//TODO
-		//USB_ClockDisable();
-
 		UDINT &= ~((1<<WAKEUPI) | (1<<SUSPI)); // clear any already pending WAKEUP IRQs and the SUSPI request
 		_usbSuspendState = (_usbSuspendState & ~(1<<WAKEUPI)) | (1<<SUSPI);
+		USB_COUNT_DEV(suspends);
+		if (USB_SuspendCallback)
+			USB_SuspendCallback(true);
+
+		// the bus is idle for at least 3 ms: stop the USB clock and the PLL
+		// to get down to the suspend current, WAKEUPI still works without them
+		USB_ClockDisable();
 	}
+#if CORE_ISR_NOBLOCK
+	SetEP(ep);
+#endif
 }
 
 //	VBUS or counting frames
@@ -822,6 +1096,14 @@ void USBDevice_::attach()
 
 void USBDevice_::detach()
 {
+	UDIEN = 0;
+	UDCON |= (1<<DETACH);	// disconnect the attach resistor
+	USB_ClockDisable();
+#if defined(OTGPADE)
+	USBCON &= ~(1<<OTGPADE);	// disable VBUS Pad
+#endif
+	_usbConfiguration = 0;
+	_usbSuspendState = 0;
 }
 
 //	Check for interrupts
@@ -831,8 +1113,32 @@ bool USBDevice_::configured()
 	return _usbConfiguration;
 }
 
+bool USBDevice_::suspended()
+{
+	return _usbSuspendState & (1<<SUSPI);
+}
+
 void USBDevice_::poll()
 {
+#if USB_SUSPEND_SLEEP
+	if (!suspended())
+		return;
+
+	// Power down until the host resumes the bus. Other wake-up sources
+	// (pin change, watchdog) run their interrupt handlers, then the CPU
+	// goes back to sleep as long as the bus stays suspended.
+	set_sleep_mode(SLEEP_MODE_PWR_DOWN);
+	cli();
+	while (_usbSuspendState & (1<<SUSPI))
+	{
+		sleep_enable();
+		sei();
+		sleep_cpu();
+		sleep_disable();
+		cli();
+	}
+	sei();
+#endif
 }
 
 bool USBDevice_::wakeupHost()
@@ -845,9 +1151,8 @@ bool USBDevice_::wakeupHost()
 	  && (_usbSuspendState & (1<<SUSPI))
 	  && (_usbCurrentStatus & FEATURE_REMOTE_WAKEUP_ENABLED))
 	{
-		// This short version will only work, when the device has not been suspended. Currently the
-		// Arduino core doesn't handle SUSPEND at all, so this is ok.
-		USB_ClockEnable();
+		// the suspend interrupt stopped the clock, RMWKUP needs it running
+		USB_ClockResume();
 		UDCON |= (1 << RMWKUP); // send the wakeup request
 		return true;
 	}
@@ -109,6 +109,12 @@
 #define USB_ENDPOINT_TYPE_BULK                 0x02
 #define USB_ENDPOINT_TYPE_INTERRUPT            0x03
 
+// Synchronization type of an isochronous endpoint, ORed into bmAttributes
+#define USB_ENDPOINT_SYNC_NONE                 0x00
+#define USB_ENDPOINT_SYNC_ASYNCHRONOUS         0x04
+#define USB_ENDPOINT_SYNC_ADAPTIVE             0x08
+#define USB_ENDPOINT_SYNC_SYNCHRONOUS          0x0C
+
 #define TOBYTES(x) ((x) & 0xFF),(((x) >> 8) & 0xFF)
 
 #define CDC_V1_10                               0x0110
@@ -281,6 +287,68 @@ typedef struct
 #define D_CDCCS(_subtype,_d0,_d1)	{ 5, 0x24, _subtype, _d0, _d1 }
 #define D_CDCCS4(_subtype,_d0)		{ 4, 0x24, _subtype, _d0 }
 
+// The CDCDescriptor of Serial, as sent by CDC_GetInterface()
+#define D_CDC() \
+	{ \
+		D_IAD(0,2,CDC_COMMUNICATION_INTERFACE_CLASS,CDC_ABSTRACT_CONTROL_MODEL,1), \
+		D_INTERFACE(CDC_ACM_INTERFACE,1,CDC_COMMUNICATION_INTERFACE_CLASS,CDC_ABSTRACT_CONTROL_MODEL,0), \
+		D_CDCCS(CDC_HEADER,0x10,0x01), \
+		D_CDCCS(CDC_CALL_MANAGEMENT,1,1), \
+		D_CDCCS4(CDC_ABSTRACT_CONTROL_MANAGEMENT,6), \
+		D_CDCCS(CDC_UNION,CDC_ACM_INTERFACE,CDC_DATA_INTERFACE), \
+		D_ENDPOINT(USB_ENDPOINT_IN (CDC_ENDPOINT_ACM),USB_ENDPOINT_TYPE_INTERRUPT,0x10,0x40), \
+		D_INTERFACE(CDC_DATA_INTERFACE,2,CDC_DATA_INTERFACE_CLASS,0,0), \
+		D_ENDPOINT(USB_ENDPOINT_OUT(CDC_ENDPOINT_OUT),USB_ENDPOINT_TYPE_BULK,USB_EP_SIZE,0), \
+		D_ENDPOINT(USB_ENDPOINT_IN (CDC_ENDPOINT_IN ),USB_ENDPOINT_TYPE_BULK,USB_EP_SIZE,0) \
+	}
+
+//	Configuration descriptor assembled at compile time
+//
+//	By default the configuration descriptor is built during enumeration,
+//	by asking CDC and each PluggableUSB module for its interfaces twice
+//	(once to measure, once to send). A sketch whose set of modules is
+//	fixed can instead put the whole descriptor into flash:
+//
+//	  const USBConfiguration<CDCDescriptor, HIDDescriptor> usbConfig PROGMEM(
+//	    3, D_CDC(), HIDDescriptor{ ... });
+//	  USB_FIXED_CONFIGURATION(usbConfig)
+//
+//	The parts must describe the modules in the order they are plugged,
+//	with the interface and endpoint numbers plug() gives them (the first
+//	module gets interface 2 and endpoint 4). The modules still handle
+//	their own requests and class descriptors.
+template<typename... Parts> struct USBDescriptorList;
+
+template<typename Part>
+struct USBDescriptorList<Part>
+{
+	Part part;
+	constexpr USBDescriptorList(const Part& p) : part(p) { }
+};
+
+template<typename Part, typename... Rest>
+struct USBDescriptorList<Part, Rest...>
+{
+	Part part;
+	USBDescriptorList<Rest...> rest;
+	constexpr USBDescriptorList(const Part& p, const Rest&... r) : part(p), rest(r...) { }
+};
+
+template<typename... Parts>
+struct USBConfiguration
+{
+	ConfigDescriptor config;
+	USBDescriptorList<Parts...> parts;
+	constexpr USBConfiguration(u8 interfaces, const Parts&... p)
+		: config D_CONFIG(sizeof(USBConfiguration), interfaces), parts(p...) { }
+};
+
+// Returns the fixed configuration descriptor in flash, see above
+const void* USB_FixedConfiguration(void) __attribute__((weak));
+
+#define USB_FIXED_CONFIGURATION(desc) \
+	const void* USB_FixedConfiguration(void) { return &(desc); }
+
 // Bootloader related fields
 // Old Caterina bootloader places the MAGIC key into unsafe RAM locations (it can be rewritten
 // by the running sketch before to actual reboot).
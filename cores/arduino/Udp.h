@@ -60,6 +60,9 @@ public:
   virtual size_t write(uint8_t) =0;
   // Write size bytes from buffer into the packet
   virtual size_t write(const uint8_t *buffer, size_t size) =0;
+  // Write the segments one after the other into the packet, see Client::writev()
+  // Returns the number of bytes written
+  virtual size_t writev(const WriteSegment *segments, size_t count) { return writeSegments(segments, count); }
 
   // Start processing the next available incoming packet
   // Returns the size of the packet in bytes, or 0 if no packets are available
@@ -76,6 +79,12 @@ public:
   virtual int read(char* buffer, size_t len) =0;
   // Return the next byte from the current packet without moving on to the next byte
   virtual int peek() =0;
+  // Point data at the next bytes of the current packet in the library's own
+  // buffer, see Client::peekSpan()
+  // Returns how many of them are in one piece, 0 if none can be borrowed
+  virtual size_t peekSpan(const uint8_t **data) { *data = NULL; return 0; }
+  // Skip the next n bytes of the current packet
+  virtual void consume(size_t n) { while (n-- && read() >= 0); }
   virtual void flush() =0;	// Finish reading the current packet
 
   // Return the IP address of the host who sent the current incoming packet
@@ -31,6 +31,7 @@
 #include <stdio.h>
 
 #include "wiring_private.h"
+#include "Profile.h"
 
 static void nothing(void) {
 }
@@ -65,122 +66,113 @@ static volatile voidFuncPtr intFunc[EXTERNAL_NUM_INTERRUPTS] = {
     nothing,
 #endif
 };
-// volatile static voidFuncPtr twiIntFunc;
 
-void attachInterrupt(uint8_t interruptNum, void (*userFunc)(void), int mode) {
+#if INTERRUPT_CAPTURE_SIZE > 0
+
+#if (INTERRUPT_CAPTURE_SIZE & (INTERRUPT_CAPTURE_SIZE - 1)) || INTERRUPT_CAPTURE_SIZE > 128
+#error INTERRUPT_CAPTURE_SIZE must be a power of 2 no larger than 128
+#endif
+
+extern volatile unsigned long timer0_overflow_count;
+
+static interruptCapture capture_buf[EXTERNAL_NUM_INTERRUPTS][INTERRUPT_CAPTURE_SIZE];
+static volatile uint8_t capture_head[EXTERNAL_NUM_INTERRUPTS];
+static volatile uint8_t capture_tail[EXTERNAL_NUM_INTERRUPTS];
+static volatile uint8_t *capture_pin[EXTERNAL_NUM_INTERRUPTS];
+static uint8_t capture_mask[EXTERNAL_NUM_INTERRUPTS];
+static volatile uint8_t capture_on;
+static volatile uint8_t capture_overflow;
+
+// Instead of calling a function, record the Timer0 count and the level of
+// the pin for every edge. The events are read back with
+// readInterruptCapture() outside of the interrupt.
+void attachInterruptCapture(uint8_t interruptNum, uint8_t pin, int mode) {
   if(interruptNum < EXTERNAL_NUM_INTERRUPTS) {
-    intFunc[interruptNum] = userFunc;
-    
-    // Configure the interrupt mode (trigger on low input, any change, rising
-    // edge, or falling edge).  The mode constants were chosen to correspond
-    // to the configuration bits in the hardware register, so we simply shift
-    // the mode into place.
-      
-    // Enable the interrupt.
-      
-    switch (interruptNum) {
-#if defined(__AVR_ATmega32U4__)
-	// I hate doing this, but the register assignment differs between the 1280/2560
-	// and the 32U4.  Since avrlib defines registers PCMSK1 and PCMSK2 that aren't 
-	// even present on the 32U4 this is the only way to distinguish between them.
-    case 0:
-	EICRA = (EICRA & ~((1<<ISC00) | (1<<ISC01))) | (mode << ISC00);
-	EIMSK |= (1<<INT0);
-	break;
-    case 1:
-	EICRA = (EICRA & ~((1<<ISC10) | (1<<ISC11))) | (mode << ISC10);
-	EIMSK |= (1<<INT1);
-	break;	
-    case 2:
-        EICRA = (EICRA & ~((1<<ISC20) | (1<<ISC21))) | (mode << ISC20);
-        EIMSK |= (1<<INT2);
-        break;
-    case 3:
-        EICRA = (EICRA & ~((1<<ISC30) | (1<<ISC31))) | (mode << ISC30);
-        EIMSK |= (1<<INT3);
-        break;
-    case 4:
-        EICRB = (EICRB & ~((1<<ISC60) | (1<<ISC61))) | (mode << ISC60);
-        EIMSK |= (1<<INT6);
-        break;
-#elif defined(EICRA) && defined(EICRB) && defined(EIMSK)
-    case 2:
-      EICRA = (EICRA & ~((1 << ISC00) | (1 << ISC01))) | (mode << ISC00);
-      EIMSK |= (1 << INT0);
-      break;
-    case 3:
-      EICRA = (EICRA & ~((1 << ISC10) | (1 << ISC11))) | (mode << ISC10);
-      EIMSK |= (1 << INT1);
-      break;
-    case 4:
-      EICRA = (EICRA & ~((1 << ISC20) | (1 << ISC21))) | (mode << ISC20);
-      EIMSK |= (1 << INT2);
-      break;
-    case 5:
-      EICRA = (EICRA & ~((1 << ISC30) | (1 << ISC31))) | (mode << ISC30);
-      EIMSK |= (1 << INT3);
-      break;
-    case 0:
-      EICRB = (EICRB & ~((1 << ISC40) | (1 << ISC41))) | (mode << ISC40);
-      EIMSK |= (1 << INT4);
-      break;
-    case 1:
-      EICRB = (EICRB & ~((1 << ISC50) | (1 << ISC51))) | (mode << ISC50);
-      EIMSK |= (1 << INT5);
-      break;
-    case 6:
-      EICRB = (EICRB & ~((1 << ISC60) | (1 << ISC61))) | (mode << ISC60);
-      EIMSK |= (1 << INT6);
-      break;
-    case 7:
-      EICRB = (EICRB & ~((1 << ISC70) | (1 << ISC71))) | (mode << ISC70);
-      EIMSK |= (1 << INT7);
-      break;
-#else		
-    case 0:
-    #if defined(EICRA) && defined(ISC00) && defined(EIMSK)
-      EICRA = (EICRA & ~((1 << ISC00) | (1 << ISC01))) | (mode << ISC00);
-      EIMSK |= (1 << INT0);
-    #elif defined(MCUCR) && defined(ISC00) && defined(GICR)
-      MCUCR = (MCUCR & ~((1 << ISC00) | (1 << ISC01))) | (mode << ISC00);
-      GICR |= (1 << INT0);
-    #elif defined(MCUCR) && defined(ISC00) && defined(GIMSK)
-      MCUCR = (MCUCR & ~((1 << ISC00) | (1 << ISC01))) | (mode << ISC00);
-      GIMSK |= (1 << INT0);
-    #else
-      #error attachInterrupt not finished for this CPU (case 0)
-    #endif
-      break;
+    uint8_t oldSREG = SREG;
+    cli();
+    capture_pin[interruptNum] = portInputRegister(digitalPinToPort(pin));
+    capture_mask[interruptNum] = digitalPinToBitMask(pin);
+    capture_head[interruptNum] = capture_tail[interruptNum] = 0;
+    capture_overflow &= ~_BV(interruptNum);
+    capture_on |= _BV(interruptNum);
+    SREG = oldSREG;
+    attachInterruptVector(interruptNum, mode);
+  }
+}
 
-    case 1:
-    #if defined(EICRA) && defined(ISC10) && defined(ISC11) && defined(EIMSK)
-      EICRA = (EICRA & ~((1 << ISC10) | (1 << ISC11))) | (mode << ISC10);
-      EIMSK |= (1 << INT1);
-    #elif defined(MCUCR) && defined(ISC10) && defined(ISC11) && defined(GICR)
-      MCUCR = (MCUCR & ~((1 << ISC10) | (1 << ISC11))) | (mode << ISC10);
-      GICR |= (1 << INT1);
-    #elif defined(MCUCR) && defined(ISC10) && defined(GIMSK) && defined(GIMSK)
-      MCUCR = (MCUCR & ~((1 << ISC10) | (1 << ISC11))) | (mode << ISC10);
-      GIMSK |= (1 << INT1);
-    #else
-      #warning attachInterrupt may need some more work for this cpu (case 1)
-    #endif
-      break;
-    
-    case 2:
-    #if defined(EICRA) && defined(ISC20) && defined(ISC21) && defined(EIMSK)
-      EICRA = (EICRA & ~((1 << ISC20) | (1 << ISC21))) | (mode << ISC20);
-      EIMSK |= (1 << INT2);
-    #elif defined(MCUCR) && defined(ISC20) && defined(ISC21) && defined(GICR)
-      MCUCR = (MCUCR & ~((1 << ISC20) | (1 << ISC21))) | (mode << ISC20);
-      GICR |= (1 << INT2);
-    #elif defined(MCUCR) && defined(ISC20) && defined(GIMSK) && defined(GIMSK)
-      MCUCR = (MCUCR & ~((1 << ISC20) | (1 << ISC21))) | (mode << ISC20);
-      GIMSK |= (1 << INT2);
-    #endif
-      break;
+// Returns 1 and fills in *event if an edge was captured, 0 otherwise.
+uint8_t readInterruptCapture(uint8_t interruptNum, interruptCapture *event) {
+  uint8_t tail;
+
+  if (interruptNum >= EXTERNAL_NUM_INTERRUPTS) return 0;
+
+  tail = capture_tail[interruptNum];
+  if (tail == capture_head[interruptNum]) return 0;
+
+  // the ISR only writes a slot before moving the head past it, so the slot
+  // at the tail can be read with interrupts enabled
+  *event = capture_buf[interruptNum][tail];
+  capture_tail[interruptNum] = (tail + 1) & (INTERRUPT_CAPTURE_SIZE - 1);
+  return 1;
+}
+
+// Returns 1 if edges were dropped because the buffer was full since the
+// last call.
+uint8_t interruptCaptureOverflow(uint8_t interruptNum) {
+  uint8_t bit = _BV(interruptNum), lost;
+  uint8_t oldSREG = SREG;
+
+  cli();
+  lost = capture_overflow & bit;
+  capture_overflow &= ~bit;
+  SREG = oldSREG;
+
+  return lost != 0;
+}
+
+// Converts a difference between two interruptCapture times to microseconds.
+unsigned long interruptCaptureMicros(uint16_t ticks) {
+  return clockCyclesToMicroseconds((unsigned long)ticks * TIMER0_PRESCALER);
+}
+
+static inline void captureEdge(uint8_t interrupt) __attribute__((always_inline));
+static inline void captureEdge(uint8_t interrupt) {
+  uint8_t level = *capture_pin[interrupt] & capture_mask[interrupt];
+#if defined(TCNT0)
+  uint8_t t = TCNT0;
+#elif defined(TCNT0L)
+  uint8_t t = TCNT0L;
 #endif
-    }
+  // only the low byte of the overflow count is needed, so avoid loading
+  // all four bytes of the volatile (AVR is little endian)
+  uint8_t m = *(volatile uint8_t *)&timer0_overflow_count;
+  uint8_t head = capture_head[interrupt];
+  uint8_t next = (head + 1) & (INTERRUPT_CAPTURE_SIZE - 1);
+
+#ifdef TIFR0
+  if ((TIFR0 & _BV(TOV0)) && (t < 255))
+    m++;
+#else
+  if ((TIFR & _BV(TOV0)) && (t < 255))
+    m++;
+#endif
+
+  if (next == capture_tail[interrupt]) {
+    capture_overflow |= _BV(interrupt);
+    return;
+  }
+
+  capture_buf[interrupt][head].time = ((uint16_t)m << 8) | t;
+  capture_buf[interrupt][head].level = level != 0;
+  capture_head[interrupt] = next;
+}
+
+#endif
+
+void attachInterrupt(uint8_t interruptNum, void (*userFunc)(void), int mode) {
+  if(interruptNum < EXTERNAL_NUM_INTERRUPTS) {
+    intFunc[interruptNum] = userFunc;
+    attachInterruptVector(interruptNum, mode);
   }
 }
 
@@ -271,19 +263,42 @@ void detachInterrupt(uint8_t interruptNum) {
     }
       
     intFunc[interruptNum] = nothing;
+#if INTERRUPT_CAPTURE_SIZE > 0
+    capture_on &= ~_BV(interruptNum);
+#endif
   }
 }
 
-/*
-void attachInterruptTwi(void (*userFunc)(void) ) {
-  twiIntFunc = userFunc;
-}
-*/
-
+// The handlers can't be weak: the startup code already provides a weak
+// alias to __bad_interrupt for every vector and, being linked first, that
+// one would win. A sketch that defines its own ISR() for one of these
+// vectors must not use attachInterrupt() or detachInterrupt(), so that
+// WInterrupts.o is not pulled from the core archive; attachInterruptVector()
+// lives in WInterruptsVector.c for that reason.
+// Note that interrupt numbers and vectors differ on the ATmega1280/2560,
+// where interrupt 0 is INT4_vect.
+#if INTERRUPT_CAPTURE_SIZE > 0
+#define IMPLEMENT_ISR(vect, interrupt) \
+  ISR(vect) { \
+    PROFILE_BEGIN(); \
+    PROFILE_CAPTURE_LATENCY(PROFILE_EXTINT); \
+    IDLE_WAKE(); \
+    if (capture_on & _BV(interrupt)) \
+      captureEdge(interrupt); \
+    else \
+      intFunc[interrupt](); \
+    PROFILE_END(PROFILE_EXTINT); \
+  }
+#else
 #define IMPLEMENT_ISR(vect, interrupt) \
   ISR(vect) { \
+    PROFILE_BEGIN(); \
+    PROFILE_CAPTURE_LATENCY(PROFILE_EXTINT); \
+    IDLE_WAKE(); \
     intFunc[interrupt](); \
+    PROFILE_END(PROFILE_EXTINT); \
   }
+#endif
 
 #if defined(__AVR_ATmega32U4__)
 
@@ -314,11 +329,3 @@ IMPLEMENT_ISR(INT2_vect, EXTERNAL_INT_2)
 #endif
 
 #endif
-
-/*
-ISR(TWI_vect) {
-  if(twiIntFunc)
-    twiIntFunc();
-}
-*/
-
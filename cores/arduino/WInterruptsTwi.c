@@ -0,0 +1,93 @@
+/* -*- mode: jde; c-basic-offset: 2; indent-tabs-mode: nil -*- */
+
+/*
+  WInterruptsTwi.c - TWI interrupt with a registrable handler
+  Part of Arduino - http://www.arduino.cc/
+
+  Copyright (c) 2026 Arduino.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General
+  Public License along with this library; if not, write to the
+  Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+  Boston, MA  02111-1307  USA
+*/
+
+#include "wiring_private.h"
+#include "Profile.h"
+
+#if defined(TWI_vect)
+
+static void nothing(void) {
+}
+
+static volatile voidFuncPtr twiIntFunc = nothing;
+
+#if CORE_ISR_NOBLOCK
+static uint8_t twiBusy;
+static uint8_t twiDeferred;
+#endif
+
+// The core owns TWI_vect, so Wire and other I2C drivers can be linked
+// into the same sketch; whichever attached last gets the interrupts.
+// Wire attaches itself in twi_init(). Like the external interrupts, this
+// file is only linked in when attachInterruptTwi() is used, so a sketch
+// that neither uses it nor Wire may still define ISR(TWI_vect) itself.
+void attachInterruptTwi(void (*userFunc)(void)) {
+  uint8_t oldSREG = SREG;
+  cli();
+  twiIntFunc = userFunc ? userFunc : nothing;
+  SREG = oldSREG;
+}
+
+void detachInterruptTwi(void) {
+  attachInterruptTwi(nothing);
+}
+
+#if CORE_ISR_NOBLOCK
+
+// TWIE is cleared before interrupts are enabled, and the handler sets it
+// again with its write to TWCR, which it has to do on every interrupt.
+// Writing a 1 to TWINT would start the next bus operation, so the masks
+// write a 0 there. If the next TWI interrupt comes while the handler
+// still runs, it is put off until the handler returns.
+ISR(TWI_vect) {
+  if (twiBusy) {
+    TWCR &= ~(_BV(TWIE) | _BV(TWINT));
+    twiDeferred = 1;
+    return;
+  }
+  TRACE_BEGIN(TWI);
+  TWCR &= ~(_BV(TWIE) | _BV(TWINT));
+  twiBusy = 1;
+  sei();
+  twiIntFunc();
+  cli();
+  twiBusy = 0;
+  if (twiDeferred) {
+    twiDeferred = 0;
+    TWCR = (TWCR & ~_BV(TWINT)) | _BV(TWIE);
+  }
+  TRACE_END(TWI);
+}
+
+#else
+
+ISR(TWI_vect) {
+  TRACE_BEGIN(TWI);
+  twiIntFunc();
+  TRACE_END(TWI);
+}
+
+#endif
+
+#endif
@@ -0,0 +1,53 @@
+/* -*- mode: jde; c-basic-offset: 2; indent-tabs-mode: nil -*- */
+
+/*
+  WInterruptsWdt.c - Watchdog interrupt with a registrable handler
+  Part of Arduino - http://www.arduino.cc/
+
+  Copyright (c) 2026 Arduino.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General
+  Public License along with this library; if not, write to the
+  Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+  Boston, MA  02111-1307  USA
+*/
+
+#include "wiring_private.h"
+
+#if defined(WDT_vect)
+
+static void nothing(void) {
+}
+
+static volatile voidFuncPtr wdtIntFunc = nothing;
+
+// The core owns WDT_vect, so randomEntropy() and sleepFor() can both be
+// used in one sketch. As with TWI_vect, this file is only linked in when
+// attachInterruptWdt() is used, so a sketch that uses neither may still
+// define ISR(WDT_vect) itself.
+void attachInterruptWdt(void (*userFunc)(void)) {
+  uint8_t oldSREG = SREG;
+  cli();
+  wdtIntFunc = userFunc ? userFunc : nothing;
+  SREG = oldSREG;
+}
+
+void detachInterruptWdt(void) {
+  attachInterruptWdt(nothing);
+}
+
+ISR(WDT_vect) {
+  wdtIntFunc();
+}
+
+#endif
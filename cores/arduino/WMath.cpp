@@ -24,6 +24,79 @@
 extern "C" {
   #include "stdlib.h"
 }
+#include "Arduino.h"
+
+// Marsaglia's xorshift32, any state but 0 goes through all 2^32 - 1 others
+static uint32_t xorshift_state = 2463534242UL;
+
+uint32_t fastRandom32(void)
+{
+  uint32_t x = xorshift_state;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  xorshift_state = x;
+  return x;
+}
+
+void fastRandomSeed(unsigned long seed)
+{
+  if (seed != 0) {
+    xorshift_state = seed;
+  }
+}
+
+// Lemire's multiply-shift: the high half of random * howbig is below
+// howbig, and dropping the few low halves below 2^n % howbig makes every
+// result equally likely without a division in the common case. Ranges that
+// fit 16 bits take the upper 16 random bits and a 16x16 multiply.
+long fastRandom(long howbig)
+{
+  if (howbig <= 0) {
+    return 0;
+  }
+  if (howbig <= 0xFFFF) {
+    uint16_t range = howbig;
+    uint32_t m = (uint32_t)(uint16_t)(fastRandom32() >> 16) * range;
+    if ((uint16_t)m < range) {
+      uint16_t t = (uint16_t)(0 - range) % range;
+      while ((uint16_t)m < t)
+        m = (uint32_t)(uint16_t)(fastRandom32() >> 16) * range;
+    }
+    return m >> 16;
+  }
+  uint32_t range = howbig;
+  uint64_t m = (uint64_t)fastRandom32() * range;
+  if ((uint32_t)m < range) {
+    uint32_t t = (0 - range) % range;
+    while ((uint32_t)m < t)
+      m = (uint64_t)fastRandom32() * range;
+  }
+  return m >> 32;
+}
+
+long fastRandom(long howsmall, long howbig)
+{
+  if (howsmall >= howbig) {
+    return howsmall;
+  }
+  long diff = howbig - howsmall;
+  return fastRandom(diff) + howsmall;
+}
+
+#if RANDOM_XORSHIFT
+
+void randomSeed(unsigned long seed)
+{
+  fastRandomSeed(seed);
+}
+
+long random(long howbig)
+{
+  return fastRandom(howbig);
+}
+
+#else
 
 void randomSeed(unsigned long seed)
 {
@@ -40,6 +113,8 @@ long random(long howbig)
   return random() % howbig;
 }
 
+#endif
+
 long random(long howsmall, long howbig)
 {
   if (howsmall >= howbig) {
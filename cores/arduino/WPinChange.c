@@ -0,0 +1,346 @@
+/* -*- mode: jde; c-basic-offset: 2; indent-tabs-mode: nil -*- */
+
+/*
+  WPinChange.c - Pin change interrupts with a callback per pin
+  Part of Arduino - http://www.arduino.cc/
+
+  Copyright (c) 2026 Arduino.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General
+  Public License along with this library; if not, write to the
+  Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+  Boston, MA  02111-1307  USA
+*/
+
+#include "wiring_private.h"
+#include "pins_arduino.h"
+
+// Pins are grouped into ports of up to 8 pins that share a pin change
+// interrupt. PCINT_STATEn reads the current level of the 8 pins of group
+// n, in PCMSKn bit order.
+#if defined(__AVR_ATmega1280__) || defined(__AVR_ATmega2560__)
+#define PCINT_GROUPS 3
+#define PCINT_STATE0 PINB
+// PCINT8 is PE0, PCINT9-15 are PJ0-6
+#define PCINT_STATE1 ((PINE & 0x01) | (uint8_t)(PINJ << 1))
+#define PCINT_STATE2 PINK
+#elif defined(__AVR_ATmega644__) || defined(__AVR_ATmega644A__) || defined(__AVR_ATmega644P__) || \
+      defined(__AVR_ATmega644PA__) || defined(__AVR_ATmega1284__) || defined(__AVR_ATmega1284P__)
+#define PCINT_GROUPS 4
+#define PCINT_STATE0 PINA
+#define PCINT_STATE1 PINB
+#define PCINT_STATE2 PINC
+#define PCINT_STATE3 PIND
+#elif defined(PCMSK2) && !defined(__AVR_ATmega32U4__) && !defined(__AVR_ATmega16U4__)
+// ATmega88/168/328
+#define PCINT_GROUPS 3
+#define PCINT_STATE0 PINB
+#define PCINT_STATE1 PINC
+#define PCINT_STATE2 PIND
+#elif defined(PCMSK0) || defined(PCMSK)
+// ATmega32U4, ATtiny25/45/85
+#define PCINT_GROUPS 1
+#define PCINT_STATE0 PINB
+#endif
+
+#if defined(PCINT_GROUPS) && defined(digitalPinToPCMSK)
+
+static voidFuncPtr pcint_func[PCINT_GROUPS][8];
+static uint8_t pcint_rising[PCINT_GROUPS];
+static uint8_t pcint_falling[PCINT_GROUPS];
+static uint8_t pcint_last[PCINT_GROUPS];
+static volatile voidFuncPtr pcint_hook;
+
+#if ENCODER_MAX > 0
+// Quadrature encoders are decoded here rather than through callbacks:
+// one port read gives both channels, and the previous and the new level
+// of A and B index a table of the step they make. The sequence 00, 10,
+// 11, 01 of A and B (A leading) counts up, the other way down, and
+// changes of both channels at once are impossible and count nothing, so
+// every edge of either channel counts and bouncing contacts cancel
+// themselves out. Both channels must be in the same pin change group
+// (the same port on the Uno).
+typedef struct {
+  uint8_t group;
+  uint8_t a, b;   // bit masks in the group state, 0 for a free encoder
+  uint8_t last;   // previous levels, A in bit 1 and B in bit 0
+  volatile long position;
+} encoder_t;
+
+static encoder_t encoders[ENCODER_MAX];
+static uint8_t pcint_encoder[PCINT_GROUPS];  // pins of encoders per group
+
+// step from (last << 2) | now, in RAM as it is read on every edge
+static const int8_t encoder_step[16] = {
+   0, -1, +1,  0,
+  +1,  0,  0, -1,
+  -1,  0,  0, +1,
+   0, +1, -1,  0,
+};
+
+static inline uint8_t encoder_levels(const encoder_t *e, uint8_t state)
+{
+  return ((state & e->a) ? 2 : 0) | ((state & e->b) ? 1 : 0);
+}
+#endif
+
+static uint8_t pcint_group(uint8_t pin)
+{
+#if PCINT_GROUPS > 1
+  return digitalPinToPCICRbit(pin);
+#else
+  (void)pin;
+  return 0;
+#endif
+}
+
+static uint8_t pcint_state(uint8_t group)
+{
+  switch (group) {
+#if PCINT_GROUPS > 1
+    case 1: return PCINT_STATE1;
+    case 2: return PCINT_STATE2;
+#endif
+#if PCINT_GROUPS > 3
+    case 3: return PCINT_STATE3;
+#endif
+    default: return PCINT_STATE0;
+  }
+}
+
+// Calls userFunc on every CHANGE, RISING or FALLING edge of the pin. Any
+// pin for which the variant defines digitalPinToPCMSK() can be used.
+void attachPinChangeInterrupt(uint8_t pin, void (*userFunc)(void), int mode)
+{
+  volatile uint8_t *pcicr = digitalPinToPCICR(pin);
+  volatile uint8_t *pcmsk = digitalPinToPCMSK(pin);
+  uint8_t group, bit;
+
+  if (!pcicr || !pcmsk || !userFunc) return;
+
+  group = pcint_group(pin);
+  bit = _BV(digitalPinToPCMSKbit(pin));
+
+  uint8_t oldSREG = SREG;
+  cli();
+  pcint_func[group][digitalPinToPCMSKbit(pin)] = userFunc;
+  pcint_rising[group] &= ~bit;
+  pcint_falling[group] &= ~bit;
+  if (mode != FALLING) pcint_rising[group] |= bit;
+  if (mode != RISING) pcint_falling[group] |= bit;
+  // start from the current level, so an old change is not reported
+  pcint_last[group] = (pcint_last[group] & ~bit) | (pcint_state(group) & bit);
+  *pcmsk |= bit;
+  *pcicr |= _BV(digitalPinToPCICRbit(pin));
+  SREG = oldSREG;
+}
+
+void detachPinChangeInterrupt(uint8_t pin)
+{
+  volatile uint8_t *pcmsk = digitalPinToPCMSK(pin);
+  uint8_t group, bit;
+
+  if (!pcmsk) return;
+
+  group = pcint_group(pin);
+  bit = _BV(digitalPinToPCMSKbit(pin));
+
+  uint8_t oldSREG = SREG;
+  cli();
+  pcint_rising[group] &= ~bit;
+  pcint_falling[group] &= ~bit;
+#if ENCODER_MAX > 0
+  // an encoder on the pin still needs its interrupt
+  bit &= ~pcint_encoder[group];
+#endif
+  *pcmsk &= ~bit;
+  SREG = oldSREG;
+}
+
+// For libraries that need to see every pin change interrupt of every
+// group and manage PCMSK themselves, such as SoftwareSerial. The hook runs
+// before any per-pin callbacks.
+void attachPinChangeHook(void (*hook)(void))
+{
+  pcint_hook = hook;
+}
+
+#if ENCODER_MAX > 0
+
+// Counts the edges of a quadrature encoder on pinA and pinB, four per
+// cycle, up when A leads B. Both pins need pin change interrupts in the
+// same group; set them to INPUT or INPUT_PULLUP first. Returns the number
+// of the encoder for readEncoder(), or -1 if the pins can't be used or
+// ENCODER_MAX encoders are attached already.
+int8_t attachEncoder(uint8_t pinA, uint8_t pinB)
+{
+  volatile uint8_t *pcicr = digitalPinToPCICR(pinA);
+  volatile uint8_t *pcmsk = digitalPinToPCMSK(pinA);
+  uint8_t group, a, b;
+  int8_t n;
+
+  if (!pcicr || !pcmsk || digitalPinToPCMSK(pinB) != pcmsk || pinA == pinB)
+    return -1;
+  for (n = 0; n < ENCODER_MAX && encoders[n].a; n++)
+    ;
+  if (n == ENCODER_MAX)
+    return -1;
+
+  group = pcint_group(pinA);
+  a = _BV(digitalPinToPCMSKbit(pinA));
+  b = _BV(digitalPinToPCMSKbit(pinB));
+
+  uint8_t oldSREG = SREG;
+  cli();
+  encoders[n].group = group;
+  encoders[n].a = a;
+  encoders[n].b = b;
+  encoders[n].last = encoder_levels(&encoders[n], pcint_state(group));
+  encoders[n].position = 0;
+  pcint_encoder[group] |= a | b;
+  *pcmsk |= a | b;
+  *pcicr |= _BV(digitalPinToPCICRbit(pinA));
+  SREG = oldSREG;
+  return n;
+}
+
+void detachEncoder(uint8_t encoder)
+{
+  encoder_t *e = &encoders[encoder];
+  uint8_t bits, i;
+
+  if (encoder >= ENCODER_MAX || !e->a)
+    return;
+
+  uint8_t oldSREG = SREG;
+  cli();
+  bits = e->a | e->b;
+  e->a = e->b = 0;
+  pcint_encoder[e->group] = 0;
+  for (i = 0; i < ENCODER_MAX; i++)
+    if (encoders[i].a && encoders[i].group == e->group)
+      pcint_encoder[e->group] |= encoders[i].a | encoders[i].b;
+  // leave the pins to attachPinChangeInterrupt() callbacks on them
+  bits &= ~(pcint_encoder[e->group] | pcint_rising[e->group] | pcint_falling[e->group]);
+  switch (e->group) {
+#if PCINT_GROUPS > 1
+    case 1: PCMSK1 &= ~bits; break;
+    case 2: PCMSK2 &= ~bits; break;
+#endif
+#if PCINT_GROUPS > 3
+    case 3: PCMSK3 &= ~bits; break;
+#endif
+    default:
+#if defined(PCMSK0)
+      PCMSK0 &= ~bits;
+#else
+      PCMSK &= ~bits;
+#endif
+      break;
+  }
+  SREG = oldSREG;
+}
+
+long readEncoder(uint8_t encoder)
+{
+  long position;
+
+  if (encoder >= ENCODER_MAX)
+    return 0;
+  uint8_t oldSREG = SREG;
+  cli();
+  position = encoders[encoder].position;
+  SREG = oldSREG;
+  return position;
+}
+
+void writeEncoder(uint8_t encoder, long position)
+{
+  if (encoder >= ENCODER_MAX)
+    return;
+  uint8_t oldSREG = SREG;
+  cli();
+  encoders[encoder].position = position;
+  SREG = oldSREG;
+}
+
+// Runs first in the interrupt, on the state read on entry
+static inline void encoder_update(uint8_t group, uint8_t state)
+{
+  uint8_t i;
+
+  for (i = 0; i < ENCODER_MAX; i++) {
+    encoder_t *e = &encoders[i];
+    if (e->group != group || !e->a)
+      continue;
+    uint8_t now = encoder_levels(e, state);
+    e->position += encoder_step[(e->last << 2) | now];
+    e->last = now;
+  }
+}
+
+#endif
+
+// Only the pins that actually changed in the direction they were attached
+// for are dispatched, so the cost grows with the number of changed pins
+// rather than the number of attached pins.
+static inline void pcint_dispatch(uint8_t group, uint8_t state)
+{
+  voidFuncPtr hook = pcint_hook;
+  uint8_t changed, i;
+
+#if ENCODER_MAX > 0
+  if (pcint_encoder[group])
+    encoder_update(group, state);
+#endif
+  IDLE_WAKE();
+  if (hook) {
+    hook();
+    // the hook may have taken a while, use the level after it
+    state = pcint_state(group);
+  }
+
+  changed = state ^ pcint_last[group];
+  pcint_last[group] = state;
+  changed &= (state & pcint_rising[group]) | (~state & pcint_falling[group]);
+
+  for (i = 0; changed; i++, changed >>= 1)
+    if (changed & 1)
+      pcint_func[group][i]();
+}
+
+ISR(PCINT0_vect)
+{
+  pcint_dispatch(0, PCINT_STATE0);
+}
+
+#if PCINT_GROUPS > 1
+ISR(PCINT1_vect)
+{
+  pcint_dispatch(1, PCINT_STATE1);
+}
+
+ISR(PCINT2_vect)
+{
+  pcint_dispatch(2, PCINT_STATE2);
+}
+#endif
+
+#if PCINT_GROUPS > 3
+ISR(PCINT3_vect)
+{
+  pcint_dispatch(3, PCINT_STATE3);
+}
+#endif
+
+#endif
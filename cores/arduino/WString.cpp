@@ -19,7 +19,11 @@
   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 */
 
+#include "Arduino.h"
 #include "WString.h"
+#include "NumberFormat.h"
+
+static memArena *string_arena;
 
 /*********************************************/
 /*  Constructors                             */
@@ -68,41 +72,43 @@ String::String(char c)
 String::String(unsigned char value, unsigned char base)
 {
 	init();
-	char buf[1 + 8 * sizeof(unsigned char)];
-	utoa(value, buf, base);
-	*this = buf;
+	copyNumber(value, base, false);
 }
 
 String::String(int value, unsigned char base)
 {
 	init();
-	char buf[2 + 8 * sizeof(int)];
-	itoa(value, buf, base);
-	*this = buf;
+	if (base == 10) {
+		copyNumber(value < 0 ? -(unsigned long)value : value, 10, value < 0);
+	} else {
+		char buf[2 + 8 * sizeof(int)];
+		itoa(value, buf, base);
+		*this = buf;
+	}
 }
 
 String::String(unsigned int value, unsigned char base)
 {
 	init();
-	char buf[1 + 8 * sizeof(unsigned int)];
-	utoa(value, buf, base);
-	*this = buf;
+	copyNumber(value, base, false);
 }
 
 String::String(long value, unsigned char base)
 {
 	init();
-	char buf[2 + 8 * sizeof(long)];
-	ltoa(value, buf, base);
-	*this = buf;
+	if (base == 10) {
+		copyNumber(value < 0 ? -(unsigned long)value : value, 10, value < 0);
+	} else {
+		char buf[2 + 8 * sizeof(long)];
+		ltoa(value, buf, base);
+		*this = buf;
+	}
 }
 
 String::String(unsigned long value, unsigned char base)
 {
 	init();
-	char buf[1 + 8 * sizeof(unsigned long)];
-	ultoa(value, buf, base);
-	*this = buf;
+	copyNumber(value, base, false);
 }
 
 String::String(float value, unsigned char decimalPlaces)
@@ -121,7 +127,7 @@ String::String(double value, unsigned char decimalPlaces)
 
 String::~String()
 {
-	free(buffer);
+	if (!isInline()) freeBuffer();
 }
 
 /*********************************************/
@@ -133,11 +139,12 @@ inline void String::init(void)
 	buffer = NULL;
 	capacity = 0;
 	len = 0;
+	inArena = 0;
 }
 
 void String::invalidate(void)
 {
-	if (buffer) free(buffer);
+	if (buffer && !isInline()) freeBuffer();
 	buffer = NULL;
 	capacity = len = 0;
 }
@@ -152,12 +159,92 @@ unsigned char String::reserve(unsigned int size)
 	return 0;
 }
 
+void String::useArena(memArena *arena)
+{
+	string_arena = arena;
+}
+
+// realloc() or the arena: buffers move to the arena while one is set, and
+// to the heap when it is full. Where ptr (buffer, or NULL) came from is
+// kept in inArena rather than worked out from its address, as the arena
+// may have been changed or reset since; inArena is set for the result
+// only once the caller has taken it, by changeBuffer().
+char *String::reallocBuffer(char *ptr, unsigned int oldSize, unsigned int size, unsigned char &toArena)
+{
+	memArena *arena = string_arena;
+	char *newptr;
+
+	toArena = 0;
+	if (!ptr || !inArena) {
+		// from the heap, or nothing yet
+		if (arena && (newptr = (char *)arenaAlloc(arena, size))) {
+			if (ptr) {
+				memcpy(newptr, ptr, oldSize);
+				free(ptr);
+			}
+			toArena = 1;
+			return newptr;
+		}
+		return (char *)realloc(ptr, size);
+	}
+
+	// from an arena, which can only grow it in place if it is still the
+	// current one; it is never freed
+	if (arena && arenaOwns(arena, ptr)) {
+		newptr = (char *)arenaRealloc(arena, ptr, oldSize, size);
+		if (newptr) {
+			toArena = 1;
+			return newptr;
+		}
+	}
+	if (arena && (newptr = (char *)arenaAlloc(arena, size)))
+		toArena = 1;
+	else
+		newptr = (char *)malloc(size);
+	if (newptr) memcpy(newptr, ptr, oldSize);
+	return newptr;
+}
+
+void String::freeBuffer(void)
+{
+	if (!inArena) free(buffer);
+	inArena = 0;
+}
+
+// for appending: grows by half again the current size, so a String built
+// up piece by piece is reallocated a few times instead of for every piece
+unsigned char String::grow(unsigned int size)
+{
+	if (buffer && capacity >= size) return 1;
+	unsigned int ahead = capacity + (capacity >> 1);
+	if (ahead > size && reserve(ahead)) return 1;
+	return reserve(size);
+}
+
 unsigned char String::changeBuffer(unsigned int maxStrLen)
 {
-	char *newbuffer = (char *)realloc(buffer, maxStrLen + 1);
+	char *newbuffer;
+	unsigned char toArena;
+
+	if (!buffer || isInline()) {
+		// short strings stay in the object, without malloc()
+		if (maxStrLen < sizeof(sso)) {
+			buffer = sso;
+			capacity = sizeof(sso) - 1;
+			return 1;
+		}
+		newbuffer = reallocBuffer(NULL, 0, maxStrLen + 1, toArena);
+		if (newbuffer && buffer) {
+			memcpy(newbuffer, buffer, len);
+			newbuffer[len] = 0;
+		}
+	} else {
+		newbuffer = reallocBuffer(buffer, capacity + 1, maxStrLen + 1, toArena);
+	}
 	if (newbuffer) {
 		buffer = newbuffer;
 		capacity = maxStrLen;
+		inArena = toArena;
 		return 1;
 	}
 	return 0;
@@ -189,6 +276,18 @@ String & String::copy(const __FlashStringHelper *pstr, unsigned int length)
 	return *this;
 }
 
+// the digits are formatted backwards into buf and copied once, without
+// the reversing and strlen() of ultoa()
+String & String::copyNumber(unsigned long value, unsigned char base, bool negative)
+{
+	char buf[2 + 8 * sizeof(long)];
+	char *end = &buf[sizeof(buf) - 1];
+	*end = 0;
+	char *str = formatNumber(end, value, base);
+	if (negative) *--str = '-';
+	return copy(str, end - str);
+}
+
 #if __cplusplus >= 201103L || defined(__GXX_EXPERIMENTAL_CXX0X__)
 void String::move(String &rhs)
 {
@@ -198,16 +297,25 @@ void String::move(String &rhs)
 			len = rhs.len;
 			rhs.len = 0;
 			return;
-		} else {
-			free(buffer);
+		} else if (!isInline()) {
+			freeBuffer();
 		}
+		buffer = NULL;
+	}
+	if (rhs.isInline()) {
+		// nothing to take over, the characters are inside rhs
+		copy(rhs.buffer, rhs.len);
+		rhs.len = 0;
+		return;
 	}
 	buffer = rhs.buffer;
 	capacity = rhs.capacity;
 	len = rhs.len;
+	inArena = rhs.inArena;
 	rhs.buffer = NULL;
 	rhs.capacity = 0;
 	rhs.len = 0;
+	rhs.inArena = 0;
 }
 #endif
 
@@ -265,7 +373,7 @@ unsigned char String::concat(const char *cstr, unsigned int length)
 	unsigned int newlen = len + length;
 	if (!cstr) return 0;
 	if (length == 0) return 1;
-	if (!reserve(newlen)) return 0;
+	if (!grow(newlen)) return 0;
 	strcpy(buffer + len, cstr);
 	len = newlen;
 	return 1;
@@ -287,37 +395,37 @@ unsigned char String::concat(char c)
 
 unsigned char String::concat(unsigned char num)
 {
-	char buf[1 + 3 * sizeof(unsigned char)];
-	itoa(num, buf, 10);
-	return concat(buf, strlen(buf));
+	return concatNumber(num, false);
 }
 
 unsigned char String::concat(int num)
 {
-	char buf[2 + 3 * sizeof(int)];
-	itoa(num, buf, 10);
-	return concat(buf, strlen(buf));
+	return concatNumber(num < 0 ? -(unsigned long)num : num, num < 0);
 }
 
 unsigned char String::concat(unsigned int num)
 {
-	char buf[1 + 3 * sizeof(unsigned int)];
-	utoa(num, buf, 10);
-	return concat(buf, strlen(buf));
+	return concatNumber(num, false);
 }
 
 unsigned char String::concat(long num)
 {
-	char buf[2 + 3 * sizeof(long)];
-	ltoa(num, buf, 10);
-	return concat(buf, strlen(buf));
+	return concatNumber(num < 0 ? -(unsigned long)num : num, num < 0);
 }
 
 unsigned char String::concat(unsigned long num)
 {
-	char buf[1 + 3 * sizeof(unsigned long)];
-	ultoa(num, buf, 10);
-	return concat(buf, strlen(buf));
+	return concatNumber(num, false);
+}
+
+unsigned char String::concatNumber(unsigned long value, bool negative)
+{
+	char buf[2 + 3 * sizeof(long)];
+	char *end = &buf[sizeof(buf) - 1];
+	*end = 0;
+	char *str = formatNumber(end, value, 10);
+	if (negative) *--str = '-';
+	return concat(str, end - str);
 }
 
 unsigned char String::concat(float num)
@@ -340,7 +448,7 @@ unsigned char String::concat(const __FlashStringHelper * str)
 	int length = strlen_P((const char *) str);
 	if (length == 0) return 1;
 	unsigned int newlen = len + length;
-	if (!reserve(newlen)) return 0;
+	if (!grow(newlen)) return 0;
 	strcpy_P(buffer + len, (const char *) str);
 	len = newlen;
 	return 1;
@@ -732,10 +840,20 @@ void String::trim(void)
 /*  Parsing / Conversion                     */
 /*********************************************/
 
+// As atol(): leading white space, an optional sign and decimal digits
 long String::toInt(void) const
 {
-	if (buffer) return atol(buffer);
-	return 0;
+	if (!buffer) return 0;
+
+	const char *p = buffer;
+	while (isspace(*p)) p++;
+	bool negative = *p == '-';
+	if (*p == '-' || *p == '+') p++;
+
+	unsigned long value = 0;
+	for (; isdigit(*p); p++)
+		value = value * 10 + (*p - '0');
+	return negative ? -(long)value : (long)value;
 }
 
 float String::toFloat(void) const
@@ -743,8 +861,48 @@ float String::toFloat(void) const
 	return float(toDouble());
 }
 
+// As atof() for plain decimal numbers (digits, point, exponent), without
+// linking strtod(). The first 9 significant digits are used, more than a
+// float holds.
 double String::toDouble(void) const
 {
-	if (buffer) return atof(buffer);
-	return 0;
+	if (!buffer) return 0;
+
+	const char *p = buffer;
+	while (isspace(*p)) p++;
+	bool negative = *p == '-';
+	if (*p == '-' || *p == '+') p++;
+
+	unsigned long mantissa = 0;
+	int exponent = 0;
+	for (; isdigit(*p); p++) {
+		if (mantissa < 100000000UL) mantissa = mantissa * 10 + (*p - '0');
+		else exponent++;
+	}
+	if (*p == '.') {
+		for (p++; isdigit(*p); p++) {
+			if (mantissa < 100000000UL) {
+				mantissa = mantissa * 10 + (*p - '0');
+				exponent--;
+			}
+		}
+	}
+	if (*p == 'e' || *p == 'E') {
+		const char *q = p + 1;
+		bool negativeExp = *q == '-';
+		if (*q == '-' || *q == '+') q++;
+		int e = 0;
+		for (; isdigit(*q); q++)
+			if (e < 100) e = e * 10 + (*q - '0');
+		exponent += negativeExp ? -e : e;
+	}
+
+	// 10^|exponent| by squaring
+	double scale = 1, power = 10;
+	for (unsigned int e = exponent < 0 ? -exponent : exponent; e; e >>= 1) {
+		if (e & 1) scale *= power;
+		power *= power;
+	}
+	double value = exponent < 0 ? mantissa / scale : mantissa * scale;
+	return negative ? -value : value;
 }
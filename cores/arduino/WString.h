@@ -34,9 +34,31 @@
 //     -felide-constructors
 //     -std=c++0x
 
+// Strings up to STRING_SSO_SIZE - 1 characters are kept in the String
+// object itself instead of on the heap. Must be at least 1.
+#if !defined(STRING_SSO_SIZE)
+#define STRING_SSO_SIZE 8
+#endif
+
+struct memArena;
+
 class __FlashStringHelper;
 #define F(string_literal) (reinterpret_cast<const __FlashStringHelper *>(PSTR(string_literal)))
 
+#if FLASHEND > 0xFFFF
+// A string anywhere in flash, for print(). PROGMEM pointers, and so F(),
+// only reach the first 64 KB; data the linker put after the code, e.g.
+//   const char page[] __attribute__((section(".fini7"))) = "<html>...";
+// may be above that on the ATmega1280/2560, and is printed with
+//   client.print(FAR_F(page));
+// var has to be the name of the array itself, not a pointer to it.
+struct FarFlashString {
+	uint_farptr_t address;
+	explicit FarFlashString(uint_farptr_t address) : address(address) {}
+};
+#define FAR_F(var) (FarFlashString(pgm_get_far_address(var)))
+#endif
+
 // An inherited class for holding the result of a concatenation.  These
 // result objects are assumed to be writable by subsequent concatenations.
 class StringSumHelper;
@@ -74,6 +96,11 @@ public:
 	~String(void);
 
 	// memory management
+	// while an arena is set, String buffers that outgrow the object are
+	// taken from it (and from the heap once it is full), and not freed;
+	// Strings using it must be gone before it is reset. NULL for the heap.
+	static void useArena(struct memArena *arena);
+
 	// return true on success, false on failure (in which case, the string
 	// is left unchanged).  reserve(0), if successful, will validate an
 	// invalid string (i.e., "if (s)" will be true afterwards)
@@ -196,15 +223,23 @@ protected:
 	char *buffer;	        // the actual char array
 	unsigned int capacity;  // the array length minus one (for the '\0')
 	unsigned int len;       // the String length (not counting the '\0')
+	char sso[STRING_SSO_SIZE]; // buffer points here for short strings
+	unsigned char inArena;  // buffer is from an arena, not the heap
 protected:
+	bool isInline(void) const { return buffer == sso; }
 	void init(void);
 	void invalidate(void);
 	unsigned char changeBuffer(unsigned int maxStrLen);
+	unsigned char grow(unsigned int size);
+	char *reallocBuffer(char *ptr, unsigned int oldSize, unsigned int size, unsigned char &toArena);
+	void freeBuffer(void);
 	unsigned char concat(const char *cstr, unsigned int length);
+	unsigned char concatNumber(unsigned long value, bool negative);
 
 	// copy and move
 	String & copy(const char *cstr, unsigned int length);
 	String & copy(const __FlashStringHelper *pstr, unsigned int length);
+	String & copyNumber(unsigned long value, unsigned char base, bool negative);
        #if __cplusplus >= 201103L || defined(__GXX_EXPERIMENTAL_CXX0X__)
 	void move(String &rhs);
 	#endif
@@ -16,16 +16,21 @@
   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 */
 
+#include "Arduino.h"
+
 /**
- * Empty yield() hook.
+ * Default yield() hook.
  *
  * This function is intended to be used by library writers to build
  * libraries or sketches that supports cooperative threads.
  *
+ * By default it runs the tasks registered with addTask() and the
+ * timers started with startTimer(), if any.
  * Its defined as a weak symbol and it can be redefined to implement a
- * real cooperative scheduler.
+ * different cooperative scheduler.
  */
 static void __empty() {
-	// Empty
+	if (runTasks) runTasks();
+	if (runTimers) runTimers();
 }
 void yield(void) __attribute__ ((weak, alias("__empty")));
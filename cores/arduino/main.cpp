@@ -18,6 +18,9 @@
 */
 
 #include <Arduino.h>
+#include <avr/sleep.h>
+#include "wiring_private.h"
+#include "Profile.h"
 
 // Declared weak in Arduino.h to allow user redefinitions.
 int atexit(void (* /*func*/ )()) { return 0; }
@@ -30,6 +33,34 @@ void initVariant() { }
 void setupUSB() __attribute__((weak));
 void setupUSB() { }
 
+// Idle sleep: loopIdle() asks for it, and it only happens if none of the
+// interrupts that set idle_wake came during this pass of the main loop.
+// Any interrupt ends the sleep (the Timer0 overflow behind millis() at
+// least once per overflow), after which loop() runs again. Work that only depends on
+// time, like addTask() tasks and startTimer() timers, may run up to one
+// Timer0 overflow late.
+static uint8_t loop_idle;
+
+void loopIdle(void)
+{
+	loop_idle = 1;
+}
+
+static void idleSleep(void)
+{
+	set_sleep_mode(SLEEP_MODE_IDLE);
+	cli();
+	if (!idle_wake) {
+		sleep_enable();
+		// the instruction after sei() runs before any pending interrupt,
+		// so none can come between the check and sleep_cpu()
+		sei();
+		sleep_cpu();
+		sleep_disable();
+	}
+	sei();
+}
+
 int main(void)
 {
 	init();
@@ -43,8 +74,25 @@ int main(void)
 	setup();
     
 	for (;;) {
-		loop();
-		if (serialEventRun) serialEventRun();
+		idle_wake = 0;
+		{
+			PROFILE_SCOPE(PROFILE_LOOP);
+			loop();
+		}
+		if (serialEventRun) {
+			PROFILE_SCOPE(PROFILE_SERIAL_EVENT);
+			serialEventRun();
+		}
+		if (runTasks) runTasks();
+		if (runTimers) runTimers();
+		if (resetLoopArena) resetLoopArena();
+#if defined(USBCON) && USB_SUSPEND_SLEEP
+		USBDevice.poll();
+#endif
+		if (loop_idle) {
+			loop_idle = 0;
+			idleSleep();
+		}
 	}
         
 	return 0;
@@ -18,19 +18,36 @@
 
 #include <stdlib.h>
 
+#if defined(NEW_USE_POOL)
+#include "Arduino.h"
+
+// Blocks from the pools of wiring_pool.c first, the heap when no class
+// fits or the fitting ones are used up.
+static void *newBlock(size_t size) {
+  void *ptr = poolAlloc(size);
+  return ptr ? ptr : malloc(size);
+}
+
+static void deleteBlock(void *ptr) {
+  if (ptr && !poolFree(ptr)) free(ptr);
+}
+#else
+#define newBlock malloc
+#define deleteBlock free
+#endif
+
 void *operator new(size_t size) {
-  return malloc(size);
+  return newBlock(size);
 }
 
 void *operator new[](size_t size) {
-  return malloc(size);
+  return newBlock(size);
 }
 
 void operator delete(void * ptr) {
-  free(ptr);
+  deleteBlock(ptr);
 }
 
 void operator delete[](void * ptr) {
-  free(ptr);
+  deleteBlock(ptr);
 }
-
@@ -21,23 +21,118 @@
 */
 
 #include "wiring_private.h"
+#include "Profile.h"
+#include <avr/sleep.h>
 
-// the prescaler is set so that timer0 ticks every 64 clock cycles, and the
-// the overflow handler is called every 256 ticks.
-#define MICROSECONDS_PER_TIMER0_OVERFLOW (clockCyclesToMicroseconds(64 * 256))
+// the overflow handler is called every 256 timer0 ticks, that is every
+// TIMER0_CYCLES_PER_OVERFLOW clock cycles (see wiring_private.h).
+#define CYCLES_PER_MILLISECOND (F_CPU / 1000)
 
 // the whole number of milliseconds per timer0 overflow
-#define MILLIS_INC (MICROSECONDS_PER_TIMER0_OVERFLOW / 1000)
+#define MILLIS_INC (TIMER0_CYCLES_PER_OVERFLOW / CYCLES_PER_MILLISECOND)
+
+// the fractional number of milliseconds per timer0 overflow, counted in
+// clock cycles. both numbers are divided by the largest power of two that
+// divides both (the lowest bit set in either), which fits them into a byte
+// for the usual clock speeds without losing precision.
+#define FRACT_CYCLES (TIMER0_CYCLES_PER_OVERFLOW % CYCLES_PER_MILLISECOND)
+#define FRACT_SCALE ((FRACT_CYCLES | CYCLES_PER_MILLISECOND) & -(FRACT_CYCLES | CYCLES_PER_MILLISECOND))
+#define FRACT_INC (FRACT_CYCLES / FRACT_SCALE)
+#define FRACT_MAX (CYCLES_PER_MILLISECOND / FRACT_SCALE)
+
+#if FRACT_MAX + FRACT_INC > 256
+typedef uint16_t timer0_fract_t;
+#else
+typedef uint8_t timer0_fract_t;
+#endif
+
+// microseconds for m timer0 overflows plus t timer0 ticks. each case keeps
+// the result continuous when m << 8 wraps around, so that micros() only
+// wraps at 2^32 microseconds.
+#define CYCLES_PER_MICROSECOND clockCyclesPerMicrosecond()
+#if TIMER0_PRESCALER % CYCLES_PER_MICROSECOND == 0
+// a whole number of microseconds per tick (1 MHz to 16 MHz at 64)
+#define TIMER0_TO_MICROS(m, t) ((((m) << 8) + (t)) * (TIMER0_PRESCALER / CYCLES_PER_MICROSECOND))
+#elif CYCLES_PER_MICROSECOND % TIMER0_PRESCALER == 0 && 256 % (CYCLES_PER_MICROSECOND / TIMER0_PRESCALER) == 0
+// several ticks per microsecond (16 MHz at 8)
+#define TIMER0_TO_MICROS(m, t) ((m) * (256 / (CYCLES_PER_MICROSECOND / TIMER0_PRESCALER)) + \
+                                (t) / (CYCLES_PER_MICROSECOND / TIMER0_PRESCALER))
+#else
+// anything else (20 MHz at 64), at the cost of some divisions
+#define TIMER0_US_INC (TIMER0_CYCLES_PER_OVERFLOW / CYCLES_PER_MICROSECOND)
+#define TIMER0_US_REM (TIMER0_CYCLES_PER_OVERFLOW % CYCLES_PER_MICROSECOND)
+#define TIMER0_TO_MICROS(m, t) ((m) * TIMER0_US_INC + \
+                                (m) / CYCLES_PER_MICROSECOND * TIMER0_US_REM + \
+                                (m) % CYCLES_PER_MICROSECOND * TIMER0_US_REM / CYCLES_PER_MICROSECOND + \
+                                (t) * TIMER0_PRESCALER / CYCLES_PER_MICROSECOND)
+#endif
 
-// the fractional number of milliseconds per timer0 overflow. we shift right
-// by three to fit these numbers into a byte. (for the clock speeds we care
-// about - 8 and 16 MHz - this doesn't lose precision.)
-#define FRACT_INC ((MICROSECONDS_PER_TIMER0_OVERFLOW % 1000) >> 3)
-#define FRACT_MAX (1000 >> 3)
+#if TIMER0_PRESCALER == 1
+#define TIMER0_CLOCK_SELECT (_BV(CS00))
+#elif TIMER0_PRESCALER == 8
+#define TIMER0_CLOCK_SELECT (_BV(CS01))
+#elif TIMER0_PRESCALER == 64
+#define TIMER0_CLOCK_SELECT (_BV(CS01) | _BV(CS00))
+#elif TIMER0_PRESCALER == 256
+#define TIMER0_CLOCK_SELECT (_BV(CS02))
+#elif TIMER0_PRESCALER == 1024
+#define TIMER0_CLOCK_SELECT (_BV(CS02) | _BV(CS00))
+#else
+#error TIMER0_PRESCALER must be 1, 8, 64, 256 or 1024
+#endif
+
+// Define TIMER0_LAZY_MILLIS to 1 (e.g. with -DTIMER0_LAZY_MILLIS=1) to have
+// the overflow handler only count overflows. millis() then computes the
+// milliseconds from that count when it is called, which makes millis()
+// slower but shortens the handler that runs every 1024 us (at 16 MHz) and
+// delays every other interrupt. In this mode millis() jumps back to 0 when
+// the overflow count itself wraps around (after about 51 days at 16 MHz)
+// rather than at 2^32 milliseconds.
+#ifndef TIMER0_LAZY_MILLIS
+#define TIMER0_LAZY_MILLIS 0
+#endif
 
 volatile unsigned long timer0_overflow_count = 0;
+
+// see IDLE_WAKE() in wiring_private.h; lives here rather than in main.cpp
+// so that sketches with their own main() still link
+volatile uint8_t idle_wake;
+
+#if TIMER0_LAZY_MILLIS
+
+#if defined(TIM0_OVF_vect)
+ISR(TIM0_OVF_vect)
+#else
+ISR(TIMER0_OVF_vect)
+#endif
+{
+	PROFILE_BEGIN();
+	PROFILE_LATENCY(PROFILE_TIMER0, (unsigned long)TCNT0 * TIMER0_PRESCALER);
+	timer0_overflow_count++;
+	PROFILE_END(PROFILE_TIMER0);
+}
+
+unsigned long millis()
+{
+	unsigned long n;
+
+	// read until two reads agree rather than disabling interrupts, see
+	// atomicRead() in Atomic.h
+	do {
+		n = timer0_overflow_count;
+	} while (n != timer0_overflow_count);
+
+	// n * (MILLIS_INC + FRACT_INC / FRACT_MAX) without a 64-bit
+	// intermediate: split n into n / FRACT_MAX and n % FRACT_MAX so that
+	// each product stays within 32 bits
+	unsigned long q = n / FRACT_MAX, r = n % FRACT_MAX;
+	return n * MILLIS_INC + q * FRACT_INC + r * FRACT_INC / FRACT_MAX;
+}
+
+#else
+
 volatile unsigned long timer0_millis = 0;
-static unsigned char timer0_fract = 0;
+static timer0_fract_t timer0_fract = 0;
 
 #if defined(TIM0_OVF_vect)
 ISR(TIM0_OVF_vect)
@@ -45,10 +140,14 @@ ISR(TIM0_OVF_vect)
 ISR(TIMER0_OVF_vect)
 #endif
 {
+	PROFILE_BEGIN();
+	// the counter has run on since the overflow
+	PROFILE_LATENCY(PROFILE_TIMER0, (unsigned long)TCNT0 * TIMER0_PRESCALER);
+
 	// copy these to local variables so they can be stored in registers
 	// (volatile variables must be read from memory on every access)
 	unsigned long m = timer0_millis;
-	unsigned char f = timer0_fract;
+	timer0_fract_t f = timer0_fract;
 
 	m += MILLIS_INC;
 	f += FRACT_INC;
@@ -60,22 +159,27 @@ ISR(TIMER0_OVF_vect)
 	timer0_fract = f;
 	timer0_millis = m;
 	timer0_overflow_count++;
+
+	PROFILE_END(PROFILE_TIMER0);
 }
 
 unsigned long millis()
 {
 	unsigned long m;
-	uint8_t oldSREG = SREG;
 
-	// disable interrupts while we read timer0_millis or we might get an
-	// inconsistent value (e.g. in the middle of a write to timer0_millis)
-	cli();
-	m = timer0_millis;
-	SREG = oldSREG;
+	// the overflow handler may change timer0_millis in the middle of a
+	// read, so read until two reads agree; that is shorter than the
+	// interrupt latency disabling interrupts would add (see atomicRead()
+	// in Atomic.h)
+	do {
+		m = timer0_millis;
+	} while (m != timer0_millis);
 
 	return m;
 }
 
+#endif
+
 unsigned long micros() {
 	unsigned long m;
 	uint8_t oldSREG = SREG, t;
@@ -100,9 +204,40 @@ unsigned long micros() {
 
 	SREG = oldSREG;
 	
-	return ((m << 8) + t) * (64 / clockCyclesPerMicrosecond());
+	return TIMER0_TO_MICROS(m, t);
 }
 
+// Does at once what the overflow handler would have done for the whole
+// overflows in us, and keeps the rest for the next call.
+void timer0Advance(unsigned long us)
+{
+	static unsigned long cycles_left;
+	unsigned long cycles, n;
+	uint8_t oldSREG = SREG;
+
+	cycles = cycles_left + us * CYCLES_PER_MICROSECOND;
+	n = cycles / TIMER0_CYCLES_PER_OVERFLOW;
+	cycles_left = cycles % TIMER0_CYCLES_PER_OVERFLOW;
+
+	cli();
+#if !TIMER0_LAZY_MILLIS
+	unsigned long f = timer0_fract + n * FRACT_INC;
+	timer0_millis += n * MILLIS_INC + f / FRACT_MAX;
+	timer0_fract = f % FRACT_MAX;
+#endif
+	timer0_overflow_count += n;
+	SREG = oldSREG;
+}
+
+// Define DELAY_SLEEP to 1 to have delay() put the CPU into idle sleep
+// between checks instead of spinning. Timers, serial ports and other
+// peripherals keep running in idle mode and the next interrupt (at the
+// latest the Timer0 overflow) wakes the CPU up again, so millis() and the
+// delay itself stay accurate. yield() is still called on every wakeup.
+#ifndef DELAY_SLEEP
+#define DELAY_SLEEP 0
+#endif
+
 void delay(unsigned long ms)
 {
 	uint32_t start = micros();
@@ -113,10 +248,18 @@ void delay(unsigned long ms)
 			ms--;
 			start += 1000;
 		}
+#if DELAY_SLEEP
+		// without interrupts nothing would wake us up again
+		if (ms > 0 && (SREG & _BV(SREG_I))) {
+			set_sleep_mode(SLEEP_MODE_IDLE);
+			sleep_mode();
+		}
+#endif
 	}
 }
 
-/* Delay for the given number of microseconds.  Assumes a 1, 8, 12, 16, 20 or 24 MHz clock. */
+/* Delay for the given number of microseconds.  Hand tuned for 1, 8, 12, 16,
+ * 20 and 24 MHz clocks, scaled at runtime for any other. */
 void delayMicroseconds(unsigned int us)
 {
 	// call = 4 cycles + 2 to 4 cycles to init us(2 for constant delay, 4 for variable)
@@ -124,7 +267,7 @@ void delayMicroseconds(unsigned int us)
 	// calling avrlib's delay_us() function with low values (e.g. 1 or
 	// 2 microseconds) gives delays longer than desired.
 	//delay_us(us);
-#if F_CPU >= 24000000L
+#if F_CPU == 24000000L
 	// for the 24 MHz clock for the aventurous ones, trying to overclock
 
 	// zero delay fix
@@ -140,7 +283,7 @@ void delayMicroseconds(unsigned int us)
 	// us is at least 6 so we can substract 5
 	us -= 5; //=2 cycles
 
-#elif F_CPU >= 20000000L
+#elif F_CPU == 20000000L
 	// for the 20 MHz clock on rare Arduino boards
 
 	// for a one-microsecond delay, simply return.  the overhead
@@ -162,7 +305,7 @@ void delayMicroseconds(unsigned int us)
 	// us is at least 10 so we can substract 7
 	us -= 7; // 2 cycles
 
-#elif F_CPU >= 16000000L
+#elif F_CPU == 16000000L
 	// for the 16 MHz clock on most Arduino boards
 
 	// for a one-microsecond delay, simply return.  the overhead
@@ -179,7 +322,7 @@ void delayMicroseconds(unsigned int us)
 	// us is at least 8 so we can substract 5
 	us -= 5; // = 2 cycles,
 
-#elif F_CPU >= 12000000L
+#elif F_CPU == 12000000L
 	// for the 12 MHz clock if somebody is working with USB
 
 	// for a 1 microsecond delay, simply return.  the overhead
@@ -196,7 +339,7 @@ void delayMicroseconds(unsigned int us)
 	// us is at least 6 so we can substract 5
 	us -= 5; //2 cycles
 
-#elif F_CPU >= 8000000L
+#elif F_CPU == 8000000L
 	// for the 8 MHz internal clock
 
 	// for a 1 and 2 microsecond delay, simply return.  the overhead
@@ -213,7 +356,7 @@ void delayMicroseconds(unsigned int us)
 	// us is at least 6 so we can substract 4
 	us -= 4; // = 2 cycles
 
-#else
+#elif F_CPU == 1000000L
 	// for the 1 MHz internal clock (default settings for common Atmega microcontrollers)
 
 	// the overhead of the function calls is 14 (16) cycles
@@ -227,6 +370,20 @@ void delayMicroseconds(unsigned int us)
 	// us is at least 4, divided by 4 gives us 1 (no zero delay bug)
 	us >>= 2; // us div 4, = 4 cycles
 	
+#else
+	// for any other clock, such as the UART friendly 14.7456 and 18.432 MHz
+
+	// the loop below takes 4 cycles per iteration, so it has to run
+	// F_CPU / 4 MHz times per microsecond. scale by that factor in 8.8
+	// fixed point, which is accurate to better than 0.1% above 1 MHz.
+	// the loop count is 16 bits, which limits the delay to 65535
+	// iterations (about 14 ms at 18.432 MHz).
+	unsigned long loops = ((unsigned long)us * ((F_CPU * 64UL + 500000UL) / 1000000UL)) >> 8;
+
+	// account for the time taken in the preceeding commands: the call and
+	// the multiplication take about 40 cycles, that is 10 iterations
+	if (loops <= 10) return;
+	us = loops - 10;
 
 #endif
 
@@ -238,11 +395,132 @@ void delayMicroseconds(unsigned int us)
 	// return = 4 cycles
 }
 
+#if defined(XMCRA) && XMEM_END
+
+extern char *__malloc_heap_start;
+extern char *__malloc_heap_end;
+
+// Turns on the external memory interface and moves the malloc() heap
+// from above .bss to external RAM, XMEM_START to XMEM_END, leaving all
+// of the internal RAM to globals and the stack. This lives here rather
+// than with the memory functions because this file is always linked.
+// .init5 comes after .data is initialized (.init4), which would set the
+// heap limits back, and before the constructors (.init6), which may
+// already use new; there is nothing on the stack yet.
+void initXmem(void) __attribute__((naked, used, section(".init5")));
+
+void initXmem(void)
+{
+	// XMEM_WAIT_STATES (0 to 3) for memories slower than about 60 ns
+	// at 16 MHz
+	XMCRA = _BV(SRE) | ((XMEM_WAIT_STATES & 3) << SRW10);
+	// with at most 32 KB, A15 is never high, and PC7 stays a normal pin
+#if XMEM_END < 0x8000
+	XMCRB = _BV(XMM0);
+#else
+	XMCRB = 0;
+#endif
+	__malloc_heap_start = (char *)XMEM_START;
+	__malloc_heap_end = (char *)XMEM_END;
+}
+
+#endif
+
+// Timers 1 to 5 are set up for phase-correct hardware pwm by init(), or,
+// with INIT_LAZY, by the first analogWrite() on one of their pins. This
+// is better for motors as it ensures an even waveform; note, however,
+// that fast pwm mode can achieve a frequency of up 8 MHz (with a 16 MHz
+// clock) at 50% duty cycle.
+uint8_t timer_pwm_ready;
+
+void initPwmTimer(uint8_t timer)
+{
+	timer_pwm_ready |= _BV(timer);
+
+	switch (timer) {
+	case 1:
+#if defined(TCCR1B) && defined(CS11) && defined(CS10)
+		TCCR1B = 0;
+
+		// set timer 1 prescale factor to 64
+		sbi(TCCR1B, CS11);
+#if F_CPU >= 8000000L
+		sbi(TCCR1B, CS10);
+#endif
+#elif defined(TCCR1) && defined(CS11) && defined(CS10)
+		sbi(TCCR1, CS11);
+#if F_CPU >= 8000000L
+		sbi(TCCR1, CS10);
+#endif
+#endif
+		// put timer 1 in 8-bit phase correct pwm mode
+#if defined(TCCR1A) && defined(WGM10)
+		sbi(TCCR1A, WGM10);
+#endif
+		break;
+
+	case 2:
+		// set timer 2 prescale factor to 64
+#if defined(TCCR2) && defined(CS22)
+		sbi(TCCR2, CS22);
+#elif defined(TCCR2B) && defined(CS22)
+		sbi(TCCR2B, CS22);
+//#else
+		// Timer 2 not finished (may not be present on this CPU)
+#endif
+
+		// configure timer 2 for phase correct pwm (8-bit)
+#if defined(TCCR2) && defined(WGM20)
+		sbi(TCCR2, WGM20);
+#elif defined(TCCR2A) && defined(WGM20)
+		sbi(TCCR2A, WGM20);
+//#else
+		// Timer 2 not finished (may not be present on this CPU)
+#endif
+		break;
+
+	case 3:
+#if defined(TCCR3B) && defined(CS31) && defined(WGM30)
+		sbi(TCCR3B, CS31);		// set timer 3 prescale factor to 64
+		sbi(TCCR3B, CS30);
+		sbi(TCCR3A, WGM30);		// put timer 3 in 8-bit phase correct pwm mode
+#endif
+		break;
+
+	case 4:
+#if defined(TCCR4A) && defined(TCCR4B) && defined(TCCR4D) /* beginning of timer4 block for 32U4 and similar */
+		sbi(TCCR4B, CS42);		// set timer4 prescale factor to 64
+		sbi(TCCR4B, CS41);
+		sbi(TCCR4B, CS40);
+		sbi(TCCR4D, WGM40);		// put timer 4 in phase- and frequency-correct PWM mode
+		sbi(TCCR4A, PWM4A);		// enable PWM mode for comparator OCR4A
+		sbi(TCCR4C, PWM4D);		// enable PWM mode for comparator OCR4D
+#else /* beginning of timer4 block for ATMEGA1280 and ATMEGA2560 */
+#if defined(TCCR4B) && defined(CS41) && defined(WGM40)
+		sbi(TCCR4B, CS41);		// set timer 4 prescale factor to 64
+		sbi(TCCR4B, CS40);
+		sbi(TCCR4A, WGM40);		// put timer 4 in 8-bit phase correct pwm mode
+#endif
+#endif /* end timer4 block for ATMEGA1280/2560 and similar */
+		break;
+
+	case 5:
+#if defined(TCCR5B) && defined(CS51) && defined(WGM50)
+		sbi(TCCR5B, CS51);		// set timer 5 prescale factor to 64
+		sbi(TCCR5B, CS50);
+		sbi(TCCR5A, WGM50);		// put timer 5 in 8-bit phase correct pwm mode
+#endif
+		break;
+	}
+}
+
 void init()
 {
 	// this needs to be called before setup() or some functions won't
 	// work there
 	sei();
+
+	claimTimer(0, TIMER_OWNER_MILLIS);
 	
 	// on the ATmega168, timer 0 is also used for fast hardware pwm
 	// (using phase-correct PWM would mean that timer 0 overflowed half as often
@@ -252,24 +530,24 @@ void init()
 	sbi(TCCR0A, WGM00);
 #endif
 
-	// set timer 0 prescale factor to 64
+	// set timer 0 prescale factor to TIMER0_PRESCALER (64 by default)
 #if defined(__AVR_ATmega128__)
 	// CPU specific: different values for the ATmega128
+#if TIMER0_PRESCALER != 64
+	#error Only a Timer 0 prescale factor of 64 is supported on the ATmega128
+#endif
 	sbi(TCCR0, CS02);
 #elif defined(TCCR0) && defined(CS01) && defined(CS00)
 	// this combination is for the standard atmega8
-	sbi(TCCR0, CS01);
-	sbi(TCCR0, CS00);
+	TCCR0 |= TIMER0_CLOCK_SELECT;
 #elif defined(TCCR0B) && defined(CS01) && defined(CS00)
 	// this combination is for the standard 168/328/1280/2560
-	sbi(TCCR0B, CS01);
-	sbi(TCCR0B, CS00);
+	TCCR0B |= TIMER0_CLOCK_SELECT;
 #elif defined(TCCR0A) && defined(CS01) && defined(CS00)
 	// this combination is for the __AVR_ATmega645__ series
-	sbi(TCCR0A, CS01);
-	sbi(TCCR0A, CS00);
+	TCCR0A |= TIMER0_CLOCK_SELECT;
 #else
-	#error Timer 0 prescale factor 64 not set correctly
+	#error Timer 0 prescale factor not set correctly
 #endif
 
 	// enable timer 0 overflow interrupt
@@ -281,112 +559,54 @@ void init()
 	#error	Timer 0 overflow interrupt not set correctly
 #endif
 
-	// timers 1 and 2 are used for phase-correct hardware pwm
-	// this is better for motors as it ensures an even waveform
-	// note, however, that fast pwm mode can achieve a frequency of up
-	// 8 MHz (with a 16 MHz clock) at 50% duty cycle
+#if !INIT_LAZY
+	// the PWM timers and the ADC, see initPwmTimer() and analogInit()
+	for (uint8_t t = 1; t < TIMER_COUNT; t++)
+		initPwmTimer(t);
+	analogInit();
+#endif
 
-#if defined(TCCR1B) && defined(CS11) && defined(CS10)
-	TCCR1B = 0;
+	// the bootloader connects pins 0 and 1 to the USART; disconnect them
+	// here so they can be used as normal digital i/o; they will be
+	// reconnected in Serial.begin()
+#if defined(UCSRB)
+	UCSRB = 0;
+#elif defined(UCSR0B)
+	UCSR0B = 0;
+#endif
 
-	// set timer 1 prescale factor to 64
-	sbi(TCCR1B, CS11);
-#if F_CPU >= 8000000L
-	sbi(TCCR1B, CS10);
+	// stop the clocks of everything that is started on demand, see
+	// wiring_private.h
+#if defined(power_adc_disable)
+	power_adc_disable();
 #endif
-#elif defined(TCCR1) && defined(CS11) && defined(CS10)
-	sbi(TCCR1, CS11);
-#if F_CPU >= 8000000L
-	sbi(TCCR1, CS10);
+#if defined(power_spi_disable)
+	power_spi_disable();
 #endif
+#if defined(power_twi_disable)
+	power_twi_disable();
 #endif
-	// put timer 1 in 8-bit phase correct pwm mode
-#if defined(TCCR1A) && defined(WGM10)
-	sbi(TCCR1A, WGM10);
+#if defined(power_usi_disable)
+	power_usi_disable();
 #endif
-
-	// set timer 2 prescale factor to 64
-#if defined(TCCR2) && defined(CS22)
-	sbi(TCCR2, CS22);
-#elif defined(TCCR2B) && defined(CS22)
-	sbi(TCCR2B, CS22);
-//#else
-	// Timer 2 not finished (may not be present on this CPU)
+#if defined(power_usart0_disable)
+	power_usart0_disable();
 #endif
-
-	// configure timer 2 for phase correct pwm (8-bit)
-#if defined(TCCR2) && defined(WGM20)
-	sbi(TCCR2, WGM20);
-#elif defined(TCCR2A) && defined(WGM20)
-	sbi(TCCR2A, WGM20);
-//#else
-	// Timer 2 not finished (may not be present on this CPU)
+#if defined(power_usart1_disable)
+	power_usart1_disable();
 #endif
-
-#if defined(TCCR3B) && defined(CS31) && defined(WGM30)
-	sbi(TCCR3B, CS31);		// set timer 3 prescale factor to 64
-	sbi(TCCR3B, CS30);
-	sbi(TCCR3A, WGM30);		// put timer 3 in 8-bit phase correct pwm mode
+#if defined(power_usart2_disable)
+	power_usart2_disable();
 #endif
-
-#if defined(TCCR4A) && defined(TCCR4B) && defined(TCCR4D) /* beginning of timer4 block for 32U4 and similar */
-	sbi(TCCR4B, CS42);		// set timer4 prescale factor to 64
-	sbi(TCCR4B, CS41);
-	sbi(TCCR4B, CS40);
-	sbi(TCCR4D, WGM40);		// put timer 4 in phase- and frequency-correct PWM mode	
-	sbi(TCCR4A, PWM4A);		// enable PWM mode for comparator OCR4A
-	sbi(TCCR4C, PWM4D);		// enable PWM mode for comparator OCR4D
-#else /* beginning of timer4 block for ATMEGA1280 and ATMEGA2560 */
-#if defined(TCCR4B) && defined(CS41) && defined(WGM40)
-	sbi(TCCR4B, CS41);		// set timer 4 prescale factor to 64
-	sbi(TCCR4B, CS40);
-	sbi(TCCR4A, WGM40);		// put timer 4 in 8-bit phase correct pwm mode
+#if defined(power_usart3_disable)
+	power_usart3_disable();
 #endif
-#endif /* end timer4 block for ATMEGA1280/2560 and similar */	
 
-#if defined(TCCR5B) && defined(CS51) && defined(WGM50)
-	sbi(TCCR5B, CS51);		// set timer 5 prescale factor to 64
-	sbi(TCCR5B, CS50);
-	sbi(TCCR5A, WGM50);		// put timer 5 in 8-bit phase correct pwm mode
-#endif
-
-#if defined(ADCSRA)
-	// set a2d prescaler so we are inside the desired 50-200 KHz range.
-	#if F_CPU >= 16000000 // 16 MHz / 128 = 125 KHz
-		sbi(ADCSRA, ADPS2);
-		sbi(ADCSRA, ADPS1);
-		sbi(ADCSRA, ADPS0);
-	#elif F_CPU >= 8000000 // 8 MHz / 64 = 125 KHz
-		sbi(ADCSRA, ADPS2);
-		sbi(ADCSRA, ADPS1);
-		cbi(ADCSRA, ADPS0);
-	#elif F_CPU >= 4000000 // 4 MHz / 32 = 125 KHz
-		sbi(ADCSRA, ADPS2);
-		cbi(ADCSRA, ADPS1);
-		sbi(ADCSRA, ADPS0);
-	#elif F_CPU >= 2000000 // 2 MHz / 16 = 125 KHz
-		sbi(ADCSRA, ADPS2);
-		cbi(ADCSRA, ADPS1);
-		cbi(ADCSRA, ADPS0);
-	#elif F_CPU >= 1000000 // 1 MHz / 8 = 125 KHz
-		cbi(ADCSRA, ADPS2);
-		sbi(ADCSRA, ADPS1);
-		sbi(ADCSRA, ADPS0);
-	#else // 128 kHz / 2 = 64 KHz -> This is the closest you can get, the prescaler is 2
-		cbi(ADCSRA, ADPS2);
-		cbi(ADCSRA, ADPS1);
-		sbi(ADCSRA, ADPS0);
-	#endif
-	// enable a2d conversions
-	sbi(ADCSRA, ADEN);
+#if CORE_PROFILE
+	// the profiler takes its timestamps from the cycle counter
+	beginCycleCounter();
 #endif
 
-	// the bootloader connects pins 0 and 1 to the USART; disconnect them
-	// here so they can be used as normal digital i/o; they will be
-	// reconnected in Serial.begin()
-#if defined(UCSRB)
-	UCSRB = 0;
-#elif defined(UCSR0B)
-	UCSR0B = 0;
-#endif
+	// the trace pins of Profile.h, if any
+	TRACE_INIT();
 }
@@ -24,6 +24,7 @@
 
 #include "wiring_private.h"
 #include "pins_arduino.h"
+#include "Profile.h"
 
 uint8_t analog_reference = DEFAULT;
 
@@ -35,9 +36,86 @@ void analogReference(uint8_t mode)
 	analog_reference = mode;
 }
 
-int analogRead(uint8_t pin)
+// Set once the ADC clock is chosen, by init() or, with INIT_LAZY, by the
+// first analogSelectInput(), whichever analogPrescaler() doesn't do first
+static uint8_t adc_ready;
+
+void analogInit(void)
 {
-	uint8_t low, high;
+#if defined(ADCSRA)
+#if defined(power_adc_enable)
+	power_adc_enable();
+#endif
+	// set a2d prescaler so we are inside the desired 50-200 KHz range.
+	#if defined(ADC_PRESCALER) && ADC_PRESCALER > 0
+		// a faster ADC clock was chosen at build time (the "ADC clock"
+		// board menu), trading resolution for conversion time
+		analogPrescaler(ADC_PRESCALER);
+	#elif F_CPU >= 16000000 // 16 MHz / 128 = 125 KHz
+		sbi(ADCSRA, ADPS2);
+		sbi(ADCSRA, ADPS1);
+		sbi(ADCSRA, ADPS0);
+	#elif F_CPU >= 8000000 // 8 MHz / 64 = 125 KHz
+		sbi(ADCSRA, ADPS2);
+		sbi(ADCSRA, ADPS1);
+		cbi(ADCSRA, ADPS0);
+	#elif F_CPU >= 4000000 // 4 MHz / 32 = 125 KHz
+		sbi(ADCSRA, ADPS2);
+		cbi(ADCSRA, ADPS1);
+		sbi(ADCSRA, ADPS0);
+	#elif F_CPU >= 2000000 // 2 MHz / 16 = 125 KHz
+		sbi(ADCSRA, ADPS2);
+		cbi(ADCSRA, ADPS1);
+		cbi(ADCSRA, ADPS0);
+	#elif F_CPU >= 1000000 // 1 MHz / 8 = 125 KHz
+		cbi(ADCSRA, ADPS2);
+		sbi(ADCSRA, ADPS1);
+		sbi(ADCSRA, ADPS0);
+	#else // 128 kHz / 2 = 64 KHz -> This is the closest you can get, the prescaler is 2
+		cbi(ADCSRA, ADPS2);
+		cbi(ADCSRA, ADPS1);
+		sbi(ADCSRA, ADPS0);
+	#endif
+	// the ADC itself stays off until analogSelectInput() needs it
+#endif
+	adc_ready = 1;
+}
+
+// Sets the ADC clock to F_CPU / divisor, rounding the divisor up to the
+// next power of two from 2 to 128. A conversion takes 13 ADC clocks. The
+// full 10 bits of resolution need an ADC clock of at most 200 kHz; at
+// 1 MHz (divisor 16 at 16 MHz) about 8 bits remain.
+void analogPrescaler(uint8_t divisor)
+{
+#if defined(ADCSRA)
+	uint8_t bits = 1;
+
+#if defined(power_adc_enable)
+	power_adc_enable();
+#endif
+	while (bits < 7 && (1 << bits) < divisor)
+		bits++;
+
+	ADCSRA = (ADCSRA & ~(_BV(ADPS2) | _BV(ADPS1) | _BV(ADPS0) | _BV(ADIF))) | bits;
+#endif
+	adc_ready = 1;
+}
+
+// Selects the channel of an analog pin (or channel number) and the
+// reference for the next conversion. The first call also turns the ADC
+// on, as init() leaves it off.
+void analogSelectInput(uint8_t pin)
+{
+#if INIT_LAZY
+	if (!adc_ready)
+		analogInit();
+#endif
+#if defined(power_adc_enable)
+	power_adc_enable();
+#endif
+#if defined(ADCSRA)
+	sbi(ADCSRA, ADEN);
+#endif
 
 #if defined(analogPinToChannel)
 #if defined(__AVR_ATmega32U4__)
@@ -70,6 +148,14 @@ int analogRead(uint8_t pin)
 	ADMUX = (analog_reference << 6) | (pin & 0x07);
 #endif
 #endif
+}
+
+// Starts a conversion and returns right away, so the sketch can do other
+// work until analogReadReady(). The result is then read with
+// analogReadResult().
+void analogReadStart(uint8_t pin)
+{
+	analogSelectInput(pin);
 
 	// without a delay, we seem to read from the wrong channel
 	//delay(1);
@@ -77,9 +163,29 @@ int analogRead(uint8_t pin)
 #if defined(ADCSRA) && defined(ADCL)
 	// start the conversion
 	sbi(ADCSRA, ADSC);
+#endif
+}
 
+uint8_t analogReadReady(void)
+{
+#if defined(ADCSRA) && defined(ADCL)
 	// ADSC is cleared when the conversion finishes
+	return bit_is_clear(ADCSRA, ADSC);
+#else
+	return 1;
+#endif
+}
+
+// Returns the result of the conversion started by analogReadStart(),
+// waiting for it if it is not finished yet.
+int analogReadResult(void)
+{
+	uint8_t low, high;
+
+#if defined(ADCSRA) && defined(ADCL)
+	TRACE_BEGIN(ADC_WAIT);
 	while (bit_is_set(ADCSRA, ADSC));
+	TRACE_END(ADC_WAIT);
 
 	// we have to read ADCL first; doing so locks both ADCL
 	// and ADCH until ADCH is read.  reading ADCL second would
@@ -97,6 +203,12 @@ int analogRead(uint8_t pin)
 	return (high << 8) | low;
 }
 
+int analogRead(uint8_t pin)
+{
+	analogReadStart(pin);
+	return analogReadResult();
+}
+
 // Right now, PWM output only works on the pins with
 // hardware support.  These are defined in the appropriate
 // pins_*.c file.  For the rest of the pins, we default
@@ -119,7 +231,24 @@ void analogWrite(uint8_t pin, int val)
 	}
 	else
 	{
-		switch(digitalPinToTimer(pin))
+		uint8_t timer = digitalPinToTimer(pin);
+
+		// a timer claimed by tone(), beginPwm16() and the like is not
+		// set up for 8-bit PWM, so leave it alone (millis() only counts
+		// Timer0 overflows and doesn't mind)
+		if (timerOwner(timerOfChannel(timer)) > TIMER_OWNER_MILLIS)
+			timer = NOT_ON_TIMER;
+#if INIT_LAZY
+		else if (timer != NOT_ON_TIMER && !(timer_pwm_ready & _BV(timerOfChannel(timer))))
+			initPwmTimer(timerOfChannel(timer));
+#endif
+
+		// remember to turn it off in digitalWrite(); if the timer is not
+		// available, the digitalWrite() below clears this again
+		if (timer != NOT_ON_TIMER)
+			timer_pwm_active[timer] = 1;
+
+		switch(timer)
 		{
 			// XXX fix needed for atmega8
 			#if defined(TCCR0) && defined(COM00) && !defined(__AVR_ATmega8__)
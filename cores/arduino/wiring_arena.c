@@ -0,0 +1,101 @@
+/*
+  wiring_arena.c - bump allocator for short-lived data
+  Part of Arduino - http://www.arduino.cc/
+
+  Copyright (c) 2026 Arduino.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General
+  Public License along with this library; if not, write to the
+  Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+  Boston, MA  02111-1307  USA
+*/
+
+#include "wiring_private.h"
+
+// An arena hands out consecutive pieces of a buffer given by the caller:
+// allocating is a bounds check and an addition, and nothing is freed on
+// its own. arenaReset() takes everything back at once, so the arena never
+// fragments. The last piece handed out can still grow in place, which is
+// what a String being appended to needs.
+//
+// setLoopArena() makes main() reset an arena after every loop(), for data
+// that only lives for one pass. Arenas are not for use from interrupts.
+
+static memArena *loop_arena;
+
+void arenaBegin(memArena *arena, void *buffer, size_t size)
+{
+	arena->base = (uint8_t *)buffer;
+	arena->size = size;
+	arena->used = 0;
+	arena->last = 0;
+	arena->highWater = 0;
+}
+
+void *arenaAlloc(memArena *arena, size_t size)
+{
+	if (size > arena->size - arena->used)
+		return NULL;
+
+	void *ptr = arena->base + arena->used;
+	arena->last = arena->used;
+	arena->used += size;
+	if (arena->used > arena->highWater)
+		arena->highWater = arena->used;
+	return ptr;
+}
+
+// As realloc(), but the arena needs to be told the old size. Only the last
+// piece is resized in place; others are copied and their space is lost
+// until arenaReset().
+void *arenaRealloc(memArena *arena, void *ptr, size_t oldSize, size_t size)
+{
+	if (!ptr)
+		return arenaAlloc(arena, size);
+
+	if ((uint8_t *)ptr == arena->base + arena->last &&
+	    size <= arena->size - arena->last) {
+		arena->used = arena->last + size;
+		if (arena->used > arena->highWater)
+			arena->highWater = arena->used;
+		return ptr;
+	}
+
+	void *newptr = arenaAlloc(arena, size);
+	if (newptr)
+		memcpy(newptr, ptr, oldSize < size ? oldSize : size);
+	return newptr;
+}
+
+uint8_t arenaOwns(const memArena *arena, const void *ptr)
+{
+	return (const uint8_t *)ptr >= arena->base &&
+	       (const uint8_t *)ptr < arena->base + arena->size;
+}
+
+void arenaReset(memArena *arena)
+{
+	arena->used = 0;
+	arena->last = 0;
+}
+
+void setLoopArena(memArena *arena)
+{
+	loop_arena = arena;
+}
+
+void resetLoopArena(void)
+{
+	if (loop_arena)
+		arenaReset(loop_arena);
+}
@@ -0,0 +1,67 @@
+/*
+  wiring_capture.c - pulse measurement with the timer input capture units
+  Part of Arduino - http://www.arduino.cc/
+
+  Copyright (c) 2026 Arduino.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General
+  Public License along with this library; if not, write to the
+  Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+  Boston, MA  02111-1307  USA
+*/
+
+#include "wiring_capture_private.h"
+
+// Unlike pulseIn(), which busy-waits for the whole pulse, this lets the
+// input capture unit of a 16-bit timer latch the timer on each edge of its
+// ICPn pin (pin 8 on the Uno, ICP4/ICP5 are pins 49/48 on the Mega). The
+// timer runs without prescaler, so widths and periods are measured in
+// clock cycles (62.5 ns at 16 MHz) no matter how late the interrupt runs.
+// The results are picked up with readPulseCapture() whenever convenient.
+//
+// Timer1 is shared with the cycle counter (see wiring_cycles.c). While a
+// capture is running, the timer is claimed and not available for PWM or
+// Servo.
+//
+// Like the external interrupts, the vectors of each timer are in a file
+// of their own (wiring_capture1.c and so on), which is only linked in
+// when the sketch uses that timer: beginPulseCapture() and friends are
+// inline in Arduino.h and pick the timer's functions at compile time.
+// This file has the parts all timers share.
+
+void capture_reset(pulse_capture_t *c, uint8_t state)
+{
+	c->leading = state ? _BV(ICES1) : 0;
+	c->started = 0;
+	c->ready = 0;
+}
+
+// Returns 1 if a pulse completed since the last call, with its width and
+// the period since the previous pulse (0 for the first one) in clock
+// cycles. Use clockCyclesToMicroseconds() to convert.
+uint8_t capture_read(pulse_capture_t *c, unsigned long *width, unsigned long *period)
+{
+	uint8_t oldSREG;
+
+	if (!c->ready)
+		return 0;
+
+	oldSREG = SREG;
+	cli();
+	*width = c->width;
+	*period = c->period;
+	c->ready = 0;
+	SREG = oldSREG;
+
+	return 1;
+}
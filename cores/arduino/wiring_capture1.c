@@ -0,0 +1,88 @@
+/*
+  wiring_capture1.c - input capture on Timer1
+  Part of Arduino - http://www.arduino.cc/
+
+  Copyright (c) 2026 Arduino.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General
+  Public License along with this library; if not, write to the
+  Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+  Boston, MA  02111-1307  USA
+*/
+
+#include "wiring_capture_private.h"
+
+#if defined(TIMER1_CAPT_vect) && defined(ICR1)
+
+// Timer1 is shared with the cycle counter (see wiring_cycles.c), which
+// counts its overflows
+extern volatile uint16_t timer1_overflow_count;
+static pulse_capture_t capture1;
+
+ISR(TIMER1_CAPT_vect)
+{
+#if defined(TIFR1)
+	capture_edge(&capture1, timer1_overflow_count, ICR1, &TCCR1B, &TIFR1);
+#else
+	capture_edge(&capture1, timer1_overflow_count, ICR1, &TCCR1B, &TIFR);
+#endif
+}
+
+uint8_t _beginPulseCapture1(uint8_t state)
+{
+	uint8_t oldSREG;
+
+	if (!claimTimer(1, TIMER_OWNER_CAPTURE))
+		return 0;
+
+	oldSREG = SREG;
+	cli();
+	capture_reset(&capture1, state);
+	beginCycleCounter();
+	TCCR1B |= _BV(ICNC1) | capture1.leading;
+#if defined(TIFR1) && defined(TIMSK1)
+	TIFR1 = _BV(ICF1);
+	sbi(TIMSK1, ICIE1);
+#else
+	TIFR = _BV(ICF1);
+	sbi(TIMSK, ICIE1);
+#endif
+	SREG = oldSREG;
+	return 1;
+}
+
+void _endPulseCapture1(void)
+{
+	uint8_t oldSREG;
+
+	if (timerOwner(1) != TIMER_OWNER_CAPTURE)
+		return;
+
+	oldSREG = SREG;
+	cli();
+#if defined(TIMSK1)
+	cbi(TIMSK1, ICIE1);
+#else
+	cbi(TIMSK, ICIE1);
+#endif
+	endCycleCounter();
+	releaseTimer(1, TIMER_OWNER_CAPTURE);
+	SREG = oldSREG;
+}
+
+uint8_t _readPulseCapture1(unsigned long *width, unsigned long *period)
+{
+	return capture_read(&capture1, width, period);
+}
+
+#endif
@@ -0,0 +1,122 @@
+/*
+  wiring_capture_private.h - shared parts of the input capture files
+  Part of Arduino - http://www.arduino.cc/
+
+  Copyright (c) 2026 Arduino.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General
+  Public License along with this library; if not, write to the
+  Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+  Boston, MA  02111-1307  USA
+*/
+
+#ifndef WiringCapturePrivate_h
+#define WiringCapturePrivate_h
+
+#include "wiring_private.h"
+
+#if !defined(ICIE1) && defined(TICIE1)
+#define ICIE1 TICIE1	// ATmega8
+#endif
+
+typedef struct {
+	unsigned long start;	// time of the last leading edge
+	unsigned long width;
+	unsigned long period;
+	uint8_t leading;	// ICESn setting that catches the leading edge
+	uint8_t started;
+	volatile uint8_t ready;
+} pulse_capture_t;
+
+void capture_reset(pulse_capture_t *c, uint8_t state);
+uint8_t capture_read(pulse_capture_t *c, unsigned long *width, unsigned long *period);
+
+// The ICESn, ICNCn, ICFn and interrupt enable bits are at the same place
+// for every timer, so the Timer1 names are used for all of them.
+static inline void capture_edge(pulse_capture_t *c, uint16_t high, uint16_t icr,
+		volatile uint8_t *tccrb, volatile uint8_t *tifr) __attribute__((always_inline));
+static inline void capture_edge(pulse_capture_t *c, uint16_t high, uint16_t icr,
+		volatile uint8_t *tccrb, volatile uint8_t *tifr)
+{
+	unsigned long now;
+
+	// an overflow may be pending if it happened after the capture did
+	if ((*tifr & _BV(TOV1)) && icr < 0x8000)
+		high++;
+	now = ((unsigned long)high << 16) | icr;
+
+	if ((*tccrb & _BV(ICES1)) == c->leading) {
+		if (c->started)
+			c->period = now - c->start;
+		c->start = now;
+		c->started = 1;
+	} else if (c->started) {
+		c->width = now - c->start;
+		c->ready = 1;
+	}
+
+	// wait for the other edge next; changing the edge may set the flag
+	*tccrb ^= _BV(ICES1);
+	*tifr = _BV(ICF1);
+}
+
+// Timers 3 to 5 get their own overflow counters, and are stopped back in
+// the configuration init() left them in: prescale factor 64, 8-bit phase
+// correct pwm
+#define IMPLEMENT_CAPTURE(n) \
+	static volatile uint16_t timer##n##_overflow_count; \
+	static pulse_capture_t capture##n; \
+	ISR(TIMER##n##_OVF_vect) \
+	{ \
+		timer##n##_overflow_count++; \
+	} \
+	ISR(TIMER##n##_CAPT_vect) \
+	{ \
+		capture_edge(&capture##n, timer##n##_overflow_count, ICR##n, &TCCR##n##B, &TIFR##n); \
+	} \
+	uint8_t _beginPulseCapture##n(uint8_t state) \
+	{ \
+		uint8_t oldSREG; \
+		if (!claimTimer(n, TIMER_OWNER_CAPTURE)) \
+			return 0; \
+		oldSREG = SREG; \
+		cli(); \
+		capture_reset(&capture##n, state); \
+		TCCR##n##A = 0; \
+		TCCR##n##B = _BV(ICNC1) | capture##n.leading | _BV(CS10); \
+		TCNT##n = 0; \
+		timer##n##_overflow_count = 0; \
+		TIFR##n = _BV(ICF1) | _BV(TOV1); \
+		TIMSK##n |= _BV(ICIE1) | _BV(TOIE1); \
+		SREG = oldSREG; \
+		return 1; \
+	} \
+	void _endPulseCapture##n(void) \
+	{ \
+		uint8_t oldSREG; \
+		if (timerOwner(n) != TIMER_OWNER_CAPTURE) \
+			return; \
+		oldSREG = SREG; \
+		cli(); \
+		TIMSK##n &= ~(_BV(ICIE1) | _BV(TOIE1)); \
+		TCCR##n##B = _BV(CS11) | _BV(CS10); \
+		TCCR##n##A = _BV(WGM10); \
+		releaseTimer(n, TIMER_OWNER_CAPTURE); \
+		SREG = oldSREG; \
+	} \
+	uint8_t _readPulseCapture##n(unsigned long *width, unsigned long *period) \
+	{ \
+		return capture_read(&capture##n, width, period); \
+	}
+
+#endif
@@ -0,0 +1,187 @@
+/*
+  wiring_comparator.c - analog comparator
+  Part of Arduino - http://www.arduino.cc/
+
+  Copyright (c) 2026 Arduino.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General
+  Public License along with this library; if not, write to the
+  Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+  Boston, MA  02111-1307  USA
+*/
+
+#include "wiring_private.h"
+
+// The analog comparator tells whether its positive input (the AIN0 pin, or
+// the internal bandgap reference) is above its negative input (the AIN1
+// pin, or an analog pin through the ADC multiplexer) within a few clock
+// cycles, where analogRead() takes about 104 us. Its output can raise an
+// interrupt on either edge, or trigger the Timer1 input capture unit in
+// place of the ICP1 pin, which timestamps crossings to the clock cycle
+// without any code running.
+//
+// AIN0 and AIN1 are pins 6 and 7 on the Uno. The Leonardo has AIN0 on
+// pin 7 but no AIN1, so its negative input has to be an analog pin; the
+// Mega only has AIN1 on a header (pin 5), so its positive input is the
+// bandgap. Using an analog pin turns the ADC off, so analogRead() can't
+// be used meanwhile. Call beginComparator() first, it resets the
+// interrupt and capture settings.
+
+#if defined(ACSR)
+
+#if defined(ANALOG_COMP_vect) || defined(ANA_COMP_vect)
+
+static volatile voidFuncPtr comparator_func;
+
+#if defined(ANALOG_COMP_vect)
+ISR(ANALOG_COMP_vect)
+#else
+ISR(ANA_COMP_vect)	// ATmega8
+#endif
+{
+	IDLE_WAKE();
+	comparator_func();
+}
+
+#endif
+
+// Where the multiplexer enable bit lives
+#if defined(ADCSRB) && defined(ACME)
+#define COMPARATOR_ACME_REG ADCSRB
+#elif defined(SFIOR) && defined(ACME)
+#define COMPARATOR_ACME_REG SFIOR	// ATmega8
+#endif
+
+// Powers up the comparator between positive (COMPARATOR_AIN0 or
+// COMPARATOR_BANDGAP) and negative (COMPARATOR_AIN1, or an analog pin as
+// for analogRead()). Returns 0 if the negative input can't be an analog
+// pin on this chip.
+uint8_t beginComparator(uint8_t positive, uint8_t negative)
+{
+	uint8_t oldSREG = SREG;
+
+	cli();
+	// changing the inputs may raise the interrupt flag
+	cbi(ACSR, ACIE);
+
+	if (negative == COMPARATOR_AIN1) {
+#if defined(COMPARATOR_ACME_REG)
+		cbi(COMPARATOR_ACME_REG, ACME);
+#endif
+	} else {
+#if defined(COMPARATOR_ACME_REG)
+		// the multiplexer only feeds the comparator while the ADC is
+		// off; selecting the input turns it on first
+		analogSelectInput(negative);
+		cbi(ADCSRA, ADEN);
+		sbi(COMPARATOR_ACME_REG, ACME);
+#else
+		SREG = oldSREG;
+		return 0;
+#endif
+	}
+
+	ACSR = (positive == COMPARATOR_BANDGAP) ? _BV(ACBG) : 0;
+#if defined(DIDR1) && defined(AIN0D)
+	// the digital input buffers would only draw current
+	if (positive != COMPARATOR_BANDGAP)
+		sbi(DIDR1, AIN0D);
+#endif
+#if defined(DIDR1) && defined(AIN1D)
+	if (negative == COMPARATOR_AIN1)
+		sbi(DIDR1, AIN1D);
+#endif
+	ACSR |= _BV(ACI);
+
+	SREG = oldSREG;
+	return 1;
+}
+
+// Turns the comparator off, with its interrupt and the capture routing.
+// analogRead() turns the ADC back on itself.
+void endComparator(void)
+{
+	uint8_t oldSREG = SREG;
+
+	cli();
+	ACSR = _BV(ACD) | _BV(ACI);
+#if defined(COMPARATOR_ACME_REG)
+	cbi(COMPARATOR_ACME_REG, ACME);
+#endif
+#if defined(DIDR1) && defined(AIN0D)
+	cbi(DIDR1, AIN0D);
+#endif
+#if defined(DIDR1) && defined(AIN1D)
+	cbi(DIDR1, AIN1D);
+#endif
+	SREG = oldSREG;
+}
+
+// Returns HIGH while the positive input is above the negative one.
+int comparatorRead(void)
+{
+	return bit_is_set(ACSR, ACO) ? HIGH : LOW;
+}
+
+#if defined(ANALOG_COMP_vect) || defined(ANA_COMP_vect)
+
+// Calls func from the comparator interrupt on a RISING or FALLING edge of
+// its output, or on every CHANGE.
+void attachComparatorInterrupt(void (*func)(void), int mode)
+{
+	uint8_t oldSREG = SREG;
+
+	cli();
+	cbi(ACSR, ACIE);
+	comparator_func = func;
+	// ACIS1:0 is 00 for toggle, 10 for falling and 11 for rising
+	ACSR = (ACSR & ~(_BV(ACIS1) | _BV(ACIS0) | _BV(ACI))) |
+	       (mode == CHANGE ? 0 : (uint8_t)mode << ACIS0);
+	// a flag set by the change above is not an edge
+	ACSR |= _BV(ACI);
+	sbi(ACSR, ACIE);
+	SREG = oldSREG;
+}
+
+void detachComparatorInterrupt(void)
+{
+	cbi(ACSR, ACIE);
+}
+
+#endif
+
+#if defined(ACIC) && defined(TIMER1_CAPT_vect) && defined(ICR1)
+
+// Routes the comparator output to the Timer1 input capture unit in place
+// of ICP1 and measures pulses of the given state (HIGH while the positive
+// input is above), read with readPulseCapture(1, ...) as for
+// beginPulseCapture(). Returns 0 if Timer1 is taken.
+uint8_t beginComparatorCapture(uint8_t state)
+{
+	sbi(ACSR, ACIC);
+	if (!beginPulseCapture(1, state)) {
+		cbi(ACSR, ACIC);
+		return 0;
+	}
+	return 1;
+}
+
+void endComparatorCapture(void)
+{
+	endPulseCapture(1);
+	cbi(ACSR, ACIC);
+}
+
+#endif
+
+#endif
@@ -0,0 +1,139 @@
+/*
+  wiring_cycles.c - cycle-resolution timestamps on Timer1
+  Part of Arduino - http://www.arduino.cc/
+
+  Copyright (c) 2026 Arduino.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General
+  Public License along with this library; if not, write to the
+  Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+  Boston, MA  02111-1307  USA
+*/
+
+#include "wiring_private.h"
+
+// micros() only has a resolution of 4 us at 16 MHz (the Timer0 prescaler)
+// and briefly disables interrupts. The cycle counter instead runs Timer1
+// without prescaler and extends it to 32 bits in software, so it counts
+// single clock cycles and wraps around after 2^32 cycles (about 268
+// seconds at 16 MHz). Use clockCyclesToMicroseconds() to convert.
+//
+// While it is running, Timer1 is not available for PWM (pins 9 and 10 on
+// the Uno), the Servo library or other Timer1 users; the other way round,
+// beginCycleCounter() returns 0 and does nothing if one of them has it.
+
+#if defined(TCCR1A) && defined(TCCR1B) && defined(TCNT1)
+
+volatile uint16_t timer1_overflow_count = 0;
+
+ISR(TIMER1_OVF_vect)
+{
+	timer1_overflow_count++;
+}
+
+// Timer1 is either taken for the counter, or already owned by pulse
+// capture, which runs the counter itself
+static uint8_t cycles_owner_ok(void)
+{
+	return timerOwner(1) == TIMER_OWNER_CYCLES || timerOwner(1) == TIMER_OWNER_CAPTURE;
+}
+
+uint8_t beginCycleCounter(void)
+{
+	uint8_t oldSREG = SREG;
+	cli();
+
+	if (!claimTimer(1, TIMER_OWNER_CYCLES) && !cycles_owner_ok()) {
+		SREG = oldSREG;
+		return 0;
+	}
+
+	// normal mode, no output compare pins, no prescaling
+	TCCR1A = 0;
+	TCCR1B = _BV(CS10);
+	TCNT1 = 0;
+	timer1_overflow_count = 0;
+
+#if defined(TIFR1) && defined(TIMSK1)
+	TIFR1 = _BV(TOV1);
+	sbi(TIMSK1, TOIE1);
+#else
+	TIFR = _BV(TOV1);
+	sbi(TIMSK, TOIE1);
+#endif
+
+	SREG = oldSREG;
+	return 1;
+}
+
+void endCycleCounter(void)
+{
+	uint8_t oldSREG = SREG;
+	cli();
+
+	// leave Timer1 alone if beginCycleCounter() didn't get it
+	if (!cycles_owner_ok()) {
+		SREG = oldSREG;
+		return;
+	}
+
+#if defined(TIMSK1)
+	cbi(TIMSK1, TOIE1);
+#else
+	cbi(TIMSK, TOIE1);
+#endif
+
+	// back to the configuration init() left it in: prescale factor 64,
+	// 8-bit phase correct pwm
+	TCCR1B = _BV(CS11);
+#if F_CPU >= 8000000L
+	sbi(TCCR1B, CS10);
+#endif
+	TCCR1A = _BV(WGM10);
+
+	releaseTimer(1, TIMER_OWNER_CYCLES);
+	SREG = oldSREG;
+}
+
+unsigned long cycleCounter(void)
+{
+	uint16_t high, low, check;
+
+	if (SREG & _BV(SREG_I)) {
+		// No need to disable interrupts. Read again if the overflow
+		// interrupt ran in between, or if the two timer reads are too
+		// far apart: then some interrupt handler got in the way, and if
+		// it accessed a Timer1 16-bit register itself, it may have
+		// clobbered the high byte we read.
+		do {
+			high = timer1_overflow_count;
+			low = TCNT1;
+			check = TCNT1;
+		} while (high != timer1_overflow_count || (uint16_t)(check - low) > 32);
+	} else {
+		// Interrupts are disabled, so nothing changes underneath us, but
+		// an overflow might not have been counted yet
+		high = timer1_overflow_count;
+		low = TCNT1;
+#if defined(TIFR1)
+		if ((TIFR1 & _BV(TOV1)) && low < 0x8000)
+#else
+		if ((TIFR & _BV(TOV1)) && low < 0x8000)
+#endif
+			high++;
+	}
+
+	return ((unsigned long)high << 16) | low;
+}
+
+#endif
@@ -72,8 +72,12 @@ void pinMode(uint8_t pin, uint8_t mode)
 //
 //static inline void turnOffPWM(uint8_t timer) __attribute__ ((always_inline));
 //static inline void turnOffPWM(uint8_t timer)
+uint8_t timer_pwm_active[TIMER5C + 1];
+
 static void turnOffPWM(uint8_t timer)
 {
+	timer_pwm_active[timer] = 0;
+
 	switch (timer)
 	{
 		#if defined(TCCR1A) && defined(COM1A1)
@@ -135,7 +139,7 @@ static void turnOffPWM(uint8_t timer)
 	}
 }
 
-void digitalWrite(uint8_t pin, uint8_t val)
+HOT_FUNCTION void digitalWrite(uint8_t pin, uint8_t val)
 {
 	uint8_t timer = digitalPinToTimer(pin);
 	uint8_t bit = digitalPinToBitMask(pin);
@@ -144,9 +148,10 @@ void digitalWrite(uint8_t pin, uint8_t val)
 
 	if (port == NOT_A_PIN) return;
 
-	// If the pin that support PWM output, we need to turn it off
-	// before doing a digital write.
-	if (timer != NOT_ON_TIMER) turnOffPWM(timer);
+	// If analogWrite() enabled PWM output on the pin, we need to turn it
+	// off before doing a digital write. (timer_pwm_active[NOT_ON_TIMER] is
+	// always 0.)
+	if (timer_pwm_active[timer]) turnOffPWM(timer);
 
 	out = portOutputRegister(port);
 
@@ -162,7 +167,7 @@ void digitalWrite(uint8_t pin, uint8_t val)
 	SREG = oldSREG;
 }
 
-int digitalRead(uint8_t pin)
+HOT_FUNCTION int digitalRead(uint8_t pin)
 {
 	uint8_t timer = digitalPinToTimer(pin);
 	uint8_t bit = digitalPinToBitMask(pin);
@@ -170,10 +175,103 @@ int digitalRead(uint8_t pin)
 
 	if (port == NOT_A_PIN) return LOW;
 
-	// If the pin that support PWM output, we need to turn it off
-	// before getting a digital reading.
-	if (timer != NOT_ON_TIMER) turnOffPWM(timer);
+	// If analogWrite() enabled PWM output on the pin, we need to turn it
+	// off before getting a digital reading.
+	if (timer_pwm_active[timer]) turnOffPWM(timer);
 
 	if (*portInputRegister(port) & bit) return HIGH;
 	return LOW;
 }
+
+void portMode(uint8_t port, uint8_t mask, uint8_t mode)
+{
+	volatile uint8_t *reg, *out;
+	uint8_t oldSREG;
+
+	if (port == NOT_A_PORT) return;
+
+	reg = portModeRegister(port);
+	out = portOutputRegister(port);
+
+	oldSREG = SREG;
+	cli();
+	if (mode == OUTPUT) {
+		*reg |= mask;
+	} else {
+		*reg &= ~mask;
+		if (mode == INPUT_PULLUP)
+			*out |= mask;
+		else
+			*out &= ~mask;
+	}
+	SREG = oldSREG;
+}
+
+// Changes all the pins in mask with a single store, so they switch at the
+// same time. Like the *Fast() functions, this does not turn off PWM.
+void portWrite(uint8_t port, uint8_t mask, uint8_t value)
+{
+	volatile uint8_t *out;
+	uint8_t oldSREG;
+
+	if (port == NOT_A_PORT) return;
+
+	out = portOutputRegister(port);
+
+	oldSREG = SREG;
+	cli();
+	*out = (*out & ~mask) | (value & mask);
+	SREG = oldSREG;
+}
+
+uint8_t portRead(uint8_t port, uint8_t mask)
+{
+	if (port == NOT_A_PORT) return 0;
+
+	return *portInputRegister(port) & mask;
+}
+
+// Collects the changes for each port first and then updates every port
+// with a single read-modify-write of DDR and PORT each, all within one
+// interrupt-free section, so no pin is seen half configured.
+void pinModes(const PinModeEntry *table, uint8_t count)
+{
+	// indexed by port, PA (1) to PL (12)
+	uint8_t output[PL + 1], input[PL + 1], pullup[PL + 1];
+	uint8_t oldSREG, port;
+
+	memset(output, 0, sizeof(output));
+	memset(input, 0, sizeof(input));
+	memset(pullup, 0, sizeof(pullup));
+
+	for (; count; count--, table++) {
+		uint8_t pin = pgm_read_byte(&table->pin);
+		uint8_t mode = pgm_read_byte(&table->mode);
+		uint8_t bit = digitalPinToBitMask(pin);
+
+		port = digitalPinToPort(pin);
+		if (port == NOT_A_PIN) continue;
+
+		// a later entry for the same pin wins, as with pinMode()
+		output[port] &= ~bit;
+		input[port] &= ~bit;
+		pullup[port] &= ~bit;
+		if (mode == INPUT) input[port] |= bit;
+		else if (mode == INPUT_PULLUP) pullup[port] |= bit;
+		else output[port] |= bit;
+	}
+
+	oldSREG = SREG;
+	cli();
+	for (port = 1; port <= PL; port++) {
+		volatile uint8_t *reg, *out;
+
+		if (!(output[port] | input[port] | pullup[port])) continue;
+
+		reg = portModeRegister(port);
+		out = portOutputRegister(port);
+		*reg = (*reg & ~(input[port] | pullup[port])) | output[port];
+		*out = (*out & ~input[port]) | pullup[port];
+	}
+	SREG = oldSREG;
+}
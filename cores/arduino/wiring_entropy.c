@@ -0,0 +1,108 @@
+/*
+  wiring_entropy.c - random seed from watchdog jitter
+  Part of Arduino - http://www.arduino.cc/
+
+  Copyright (c) 2026 Arduino.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General
+  Public License along with this library; if not, write to the
+  Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+  Boston, MA  02111-1307  USA
+*/
+
+#include "wiring_private.h"
+
+// The watchdog runs from its own RC oscillator, whose period drifts by a
+// few percent with temperature and supply and jitters from one timeout to
+// the next, while micros() counts the crystal. Where within a 4 us step
+// each watchdog interrupt lands is therefore not predictable, and
+// randomEntropy() mixes the low bits of micros() at RANDOM_ENTROPY_TICKS
+// of them into a seed for randomSeed() or fastRandomSeed(). That takes
+// RANDOM_ENTROPY_TICKS * 16 ms.
+//
+// It takes over the watchdog interrupt (see WInterruptsWdt.c) while it
+// runs, and leaves the watchdog off.
+
+#if defined(WDTCSR) && defined(WDIE) && defined(WDT_vect)
+
+#include <avr/wdt.h>
+
+#ifndef RANDOM_ENTROPY_TICKS
+#define RANDOM_ENTROPY_TICKS 32
+#endif
+
+static volatile uint8_t entropy_ticks;
+static volatile uint32_t entropy_pool;
+
+static void entropyTick(void)
+{
+	// one-at-a-time hash step of the byte
+	uint32_t h = entropy_pool + (uint8_t)micros();
+	h += h << 10;
+	h ^= h >> 6;
+	entropy_pool = h;
+	entropy_ticks++;
+}
+
+unsigned long randomEntropy(void)
+{
+	uint8_t oldSREG = SREG;
+	uint32_t h;
+
+	cli();
+	entropy_ticks = 0;
+	entropy_pool = 0;
+	attachInterruptWdt(entropyTick);
+	MCUSR &= ~_BV(WDRF);
+	// timed sequence: interrupt mode, no reset, 16 ms
+	WDTCSR = _BV(WDCE) | _BV(WDE);
+	WDTCSR = _BV(WDIE);
+	sei();
+
+	while (entropy_ticks < RANDOM_ENTROPY_TICKS)
+		;
+
+	cli();
+	wdt_reset();
+	WDTCSR = _BV(WDCE) | _BV(WDE);
+	WDTCSR = 0;
+	detachInterruptWdt();
+	SREG = oldSREG;
+
+	h = entropy_pool;
+	h += h << 3;
+	h ^= h >> 11;
+	h += h << 15;
+	return h;
+}
+
+#else
+
+// no watchdog interrupt (ATmega8), fall back on the noise of a floating
+// analog input
+unsigned long randomEntropy(void)
+{
+	uint32_t h = 0;
+
+	for (uint8_t i = 0; i < 32; i++) {
+		h += analogRead(0) & 3;
+		h += h << 10;
+		h ^= h >> 6;
+	}
+	h += h << 3;
+	h ^= h >> 11;
+	h += h << 15;
+	return h;
+}
+
+#endif
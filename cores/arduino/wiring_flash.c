@@ -0,0 +1,231 @@
+/*
+  wiring_flash.c - erasing and writing the flash from the sketch
+  Part of Arduino - http://www.arduino.cc/
+
+  Copyright (c) 2026 Arduino.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General
+  Public License along with this library; if not, write to the
+  Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+  Boston, MA  02111-1307  USA
+*/
+
+#include <avr/boot.h>
+#include <util/crc16.h>
+#include "wiring_private.h"
+
+// SPM only works from the boot section, so every SPM goes through the
+// do_spm() of optiboot (built with APP_SPM), which it keeps at the second
+// word of the bootloader, or past 128K that of the stk500v2 bootloader, in
+// its INT0 vector 4 bytes in. It runs with interrupts off: the vectors are
+// in the section being programmed, which can't be read until do_spm() is
+// done. A page erase or write takes about 4ms, so millis() loses a few
+// ticks each.
+//
+// A page that was erased only needs its bits cleared, so flashWrite()
+// leaves out the erase when that's all the new data does (appending to a
+// log in erased flash, say), which halves the time, and skips pages that
+// don't change at all.
+
+#if defined(SPM_PAGESIZE)
+
+#define FLASH_APP_END ((uint32_t)FLASHEND + 1 - FLASH_BOOTLOADER_SIZE)
+
+#if FLASHEND > 0x1FFFF
+
+#define FLASH_SPM_ENTRY (FLASH_APP_END + 4)
+
+// Function pointers only reach the first 128K, so call it with EIND set
+// to the upper half, and back to 0, what the compiler expects it to be
+static void do_spm(uint16_t address, uint8_t command, uint16_t data)
+{
+	register uint16_t a asm("r24") = address;
+	register uint8_t c asm("r22") = command;
+	register uint16_t d asm("r20") = data;
+	uint16_t entry = (uint16_t)(FLASH_SPM_ENTRY / 2);
+
+	asm volatile (
+		"out %[eind], %[upper]\n\t"
+		"eicall\n\t"
+		"out %[eind], __zero_reg__\n\t"
+		: "+z" (entry), "+r" (c)
+		: [eind] "I" (_SFR_IO_ADDR(EIND)),
+		  [upper] "r" ((uint8_t)(FLASH_SPM_ENTRY >> 17)),
+		  "r" (a), "r" (d)
+		: "r0", "memory");
+}
+
+#else
+
+typedef void (*do_spm_t)(uint16_t address, uint8_t command, uint16_t data);
+
+// function pointers are word addresses
+static const do_spm_t do_spm = (do_spm_t)(uint16_t)((FLASH_APP_END + 2) / 2);
+
+#endif
+
+static void spm(uint32_t address, uint8_t command, uint16_t data)
+{
+	uint8_t oldSREG = SREG;
+
+	cli();
+	// SPM doesn't start while the EEPROM is being written
+	while (EECR & _BV(EEPE))
+		;
+#ifdef RAMPZ
+	uint8_t oldRAMPZ = RAMPZ;
+	RAMPZ = address >> 16;
+#endif
+	do_spm(address, command, data);
+#ifdef RAMPZ
+	RAMPZ = oldRAMPZ;
+#endif
+	SREG = oldSREG;
+}
+
+static uint8_t flashRead(uint32_t address)
+{
+#if FLASHEND > 0xFFFF
+	return pgm_read_byte_far(address);
+#else
+	return pgm_read_byte((uint16_t)address);
+#endif
+}
+
+// Fills the page buffer with bytes from to to - 1 of the page, taken from
+// src, and writes the page. The rest of the buffer stays 0xFF, which
+// leaves those bytes as they are.
+static void programPage(uint32_t page, const uint8_t *src, uint16_t from, uint16_t to)
+{
+	uint16_t i;
+
+	for (i = from & ~1; i < to; i += 2) {
+		uint8_t lo = i >= from ? *src++ : 0xFF;
+		uint8_t hi = i + 1 < to ? *src++ : 0xFF;
+		spm(page + i, __BOOT_PAGE_FILL, lo | (hi << 8));
+	}
+	spm(page, __BOOT_PAGE_WRITE, 0);
+}
+
+// Erases the page address is in. Returns 0 if that is the bootloader.
+uint8_t flashErasePage(uint32_t address)
+{
+	if (address >= FLASH_APP_END)
+		return 0;
+	spm(address & ~(uint32_t)(SPM_PAGESIZE - 1), __BOOT_PAGE_ERASE, 0);
+	return 1;
+}
+
+// Replaces the page address is in with the SPM_PAGESIZE bytes at data.
+uint8_t flashWritePage(uint32_t address, const void *data)
+{
+	if (!flashErasePage(address))
+		return 0;
+	programPage(address & ~(uint32_t)(SPM_PAGESIZE - 1), (const uint8_t *)data, 0, SPM_PAGESIZE);
+	return 1;
+}
+
+// Writes size bytes from data to any place in the flash, keeping the rest
+// of the pages it touches. Returns 0, writing nothing, if that would
+// reach into the bootloader.
+uint8_t flashWrite(uint32_t address, const void *data, size_t size)
+{
+	const uint8_t *src = (const uint8_t *)data;
+
+	if (address + size > FLASH_APP_END)
+		return 0;
+
+	while (size) {
+		uint32_t page = address & ~(uint32_t)(SPM_PAGESIZE - 1);
+		uint16_t from = address - page;
+		uint16_t to = size < SPM_PAGESIZE - from ? from + size : SPM_PAGESIZE;
+		uint8_t changed = 0, setsBits = 0;
+		uint16_t i;
+
+		for (i = from; i < to; i++) {
+			uint8_t old = flashRead(page + i);
+			changed |= old ^ src[i - from];
+			setsBits |= src[i - from] & ~old;
+		}
+
+		if (setsBits) {
+			uint8_t buffer[SPM_PAGESIZE];
+			for (i = 0; i < SPM_PAGESIZE; i++)
+				buffer[i] = i >= from && i < to ? src[i - from] : flashRead(page + i);
+			flashWritePage(page, buffer);
+		} else if (changed) {
+			programPage(page, src, from, to);
+		}
+
+		src += to - from;
+		address += to - from;
+		size -= to - from;
+	}
+	return 1;
+}
+
+#ifdef FLASH_UPDATE_START
+
+// Marks the length bytes written from FLASH_UPDATE_START on as the next
+// sketch. At the next reset the stk500v2 bootloader checks them against
+// the CRC-16/XMODEM stored here and copies them to address 0. Returns 0 if
+// length doesn't fit.
+uint8_t flashUpdateCommit(uint32_t length)
+{
+	uint8_t descriptor[8];
+	uint16_t crc = 0;
+	uint32_t i;
+
+	if (length == 0 || length > FLASH_UPDATE_SIZE)
+		return 0;
+
+	for (i = 0; i < length; i++)
+		crc = _crc_xmodem_update(crc, flashRead(FLASH_UPDATE_START + i));
+
+	// 0x5AA5, length and CRC, little endian as the bootloader reads them
+	descriptor[0] = 0xA5;
+	descriptor[1] = 0x5A;
+	for (i = 0; i < 4; i++)
+		descriptor[2 + i] = length >> (8 * i);
+	descriptor[6] = crc;
+	descriptor[7] = crc >> 8;
+	return flashWrite(FLASH_UPDATE_START + FLASH_UPDATE_SIZE, descriptor, sizeof(descriptor));
+}
+
+#endif
+
+#else
+
+// No SPM
+uint8_t flashErasePage(uint32_t address)
+{
+	(void)address;
+	return 0;
+}
+
+uint8_t flashWritePage(uint32_t address, const void *data)
+{
+	(void)address;
+	(void)data;
+	return 0;
+}
+
+uint8_t flashWrite(uint32_t address, const void *data, size_t size)
+{
+	(void)address;
+	(void)data;
+	(void)size;
+	return 0;
+}
+
+#endif
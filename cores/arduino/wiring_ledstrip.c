@@ -0,0 +1,142 @@
+/*
+  wiring_ledstrip.c - output for single-wire addressable LEDs (WS2812)
+  Part of Arduino - http://www.arduino.cc/
+
+  Copyright (c) 2026 Arduino.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General
+  Public License along with this library; if not, write to the
+  Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+  Boston, MA  02111-1307  USA
+*/
+
+#include "wiring_private.h"
+#include "pins_arduino.h"
+
+// WS2812 and compatible LEDs take 800 kHz bits, most significant first:
+// high for about 0.4 us for a 0 and 0.8 us for a 1, then low for the
+// rest of the 1.25 us. The high times have to be right to about 150 ns,
+// so the bit loop below is counted in clock cycles, with delays of nops
+// worked out from F_CPU by the preprocessor (F_CPU ends in L, which the
+// assembler can't take, hence inline assembly rather than a .S file).
+// The port is written with st through a pointer, which takes two cycles
+// on every port, so any pin gets the same timing.
+//
+// The low time may be much longer than spec without the LEDs latching,
+// as long as it stays below about 5 us. Interrupts are therefore only
+// disabled for LEDSTRIP_CHUNK bytes at a time (30 us), and taken in the
+// low time in between; an interrupt handler running longer than the
+// latch time makes the rest of the buffer go to the first LEDs again.
+// millis() is not affected. The port is read again after each such
+// break, so other pins of the port may change from interrupts.
+//
+// Below 16 MHz the loop overhead makes a bit longer than 1.25 us, up to
+// 1.5 us at 8 MHz, which the LEDs accept. Below 7 MHz the high time of a
+// 0 can't be made, and ledStripWrite() does nothing.
+
+#define LEDSTRIP_CHUNK 3		// bytes per interrupt-off stretch
+#define LEDSTRIP_LATCH_US 300	// low time that latches the data
+
+#define LEDSTRIP_CYCLES(ns) ((F_CPU / 1000L * (ns) + 500000L) / 1000000L)
+#define LEDSTRIP_T0H LEDSTRIP_CYCLES(375)
+#define LEDSTRIP_T1H LEDSTRIP_CYCLES(800)
+#define LEDSTRIP_BIT LEDSTRIP_CYCLES(1250)
+
+// The loop takes 3 cycles from the rising edge to the falling edge of a
+// 0, one more to that of a 1, and 10 for the whole bit
+#define LEDSTRIP_D1 (LEDSTRIP_T0H - 3)
+#define LEDSTRIP_D2 (LEDSTRIP_T1H - LEDSTRIP_T0H - 1)
+#define LEDSTRIP_D3 (LEDSTRIP_BIT - 10 - LEDSTRIP_D1 - LEDSTRIP_D2 > 0 ? \
+	LEDSTRIP_BIT - 10 - LEDSTRIP_D1 - LEDSTRIP_D2 : 0)
+
+#if F_CPU >= 7000000L
+
+static unsigned long ledstrip_end;
+
+// Sends n bytes from p on the pin, with interrupts disabled
+static inline const uint8_t *ledStripBytes(volatile uint8_t *out, uint8_t hi, uint8_t lo,
+	const uint8_t *p, uint8_t n)
+{
+	uint8_t byte, bit;
+
+	asm volatile(
+		"1:	ld %[byte], %a[p]+"	"\n\t"
+		"	ldi %[bit], 8"		"\n\t"
+		"2:	st %a[out], %[hi]"	"\n\t"	// rising edge
+		"	.rept %[d1]"		"\n\t"
+		"	nop"				"\n\t"
+		"	.endr"				"\n\t"
+		"	sbrs %[byte], 7"	"\n\t"
+		"	st %a[out], %[lo]"	"\n\t"	// falling edge of a 0
+		"	.rept %[d2]"		"\n\t"
+		"	nop"				"\n\t"
+		"	.endr"				"\n\t"
+		"	st %a[out], %[lo]"	"\n\t"	// falling edge of a 1
+		"	lsl %[byte]"		"\n\t"
+		"	.rept %[d3]"		"\n\t"
+		"	nop"				"\n\t"
+		"	.endr"				"\n\t"
+		"	dec %[bit]"			"\n\t"
+		"	brne 2b"			"\n\t"
+		"	dec %[n]"			"\n\t"
+		"	brne 1b"			"\n\t"
+		: [p] "+e" (p), [n] "+r" (n), [byte] "=&r" (byte), [bit] "=&d" (bit)
+		: [out] "e" (out), [hi] "r" (hi), [lo] "r" (lo),
+		  [d1] "n" (LEDSTRIP_D1), [d2] "n" (LEDSTRIP_D2), [d3] "n" (LEDSTRIP_D3)
+		: "memory"
+	);
+	return p;
+}
+
+// Sends len bytes of data, in the order the LEDs take them (GRB for the
+// WS2812B). The LEDs show the new colours LEDSTRIP_LATCH_US after the
+// return; a call before that waits for it.
+void ledStripWrite(uint8_t pin, const uint8_t *data, size_t len)
+{
+	uint8_t bit = digitalPinToBitMask(pin);
+	uint8_t port = digitalPinToPort(pin);
+	volatile uint8_t *out;
+
+	if (port == NOT_A_PIN || len == 0)
+		return;
+	out = portOutputRegister(port);
+	digitalWrite(pin, LOW);
+	pinMode(pin, OUTPUT);
+
+	// the previous frame has to latch first
+	while (micros() - ledstrip_end < LEDSTRIP_LATCH_US)
+		;
+
+	while (len > 0) {
+		uint8_t n = len < LEDSTRIP_CHUNK ? len : LEDSTRIP_CHUNK;
+		uint8_t oldSREG = SREG;
+
+		cli();
+		uint8_t lo = *out & ~bit;
+		data = ledStripBytes(out, lo | bit, lo, data, n);
+		SREG = oldSREG;
+		len -= n;
+	}
+	ledstrip_end = micros();
+}
+
+#else
+
+void ledStripWrite(uint8_t pin, const uint8_t *data, size_t len)
+{
+	(void)pin;
+	(void)data;
+	(void)len;
+}
+
+#endif
@@ -0,0 +1,166 @@
+/*
+  wiring_memory.c - free RAM and stack use
+  Part of Arduino - http://www.arduino.cc/
+
+  Copyright (c) 2026 Arduino.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General
+  Public License along with this library; if not, write to the
+  Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+  Boston, MA  02111-1307  USA
+*/
+
+#include "wiring_private.h"
+
+// The heap grows up from __heap_start (the end of .bss) to __brkval, the
+// stack grows down from RAMEND. With external RAM (XMEM_END, see
+// wiring.c) the heap is there instead, from XMEM_START up, and the stack
+// has everything above .bss to itself. At startup, before .data and .bss
+// are set up, paintMemory() fills everything above .bss with
+// MEMORY_CANARY. The deepest the stack ever went is then the lowest byte
+// above the heap that no longer holds the canary.
+//
+// This file, and with it the painting, is only linked in when one of the
+// functions below is used.
+
+#define MEMORY_CANARY 0xC5
+
+// from avr-libc's malloc()
+struct __freelist {
+	size_t sz;
+	struct __freelist *nx;
+};
+
+extern char __heap_start;
+extern char *__brkval;
+extern size_t __malloc_margin;
+extern struct __freelist *__flp;
+
+// .init3 runs after the stack pointer is set (.init2) and before .data
+// and .bss are initialized (.init4), with nothing on the stack yet
+void paintMemory(void) __attribute__((naked, used, section(".init3")));
+
+void paintMemory(void)
+{
+	uint8_t *p = (uint8_t *)&__heap_start;
+
+	while (p <= (uint8_t *)RAMEND)
+		*p++ = MEMORY_CANARY;
+}
+
+#if defined(XMCRA) && XMEM_END
+#define HEAP_EXTERNAL 1
+#else
+#define HEAP_EXTERNAL 0
+#endif
+
+extern char *__malloc_heap_start;
+extern char *__malloc_heap_end;
+
+// the lowest byte the stack may grow into
+static char *heapEnd(void)
+{
+	if (HEAP_EXTERNAL || !__brkval)
+		return &__heap_start;
+	return __brkval;
+}
+
+#if HEAP_EXTERNAL
+
+static char *xmemBrk(void)
+{
+	return __brkval ? __brkval : __malloc_heap_start;
+}
+
+// Takes size bytes from the top of the external RAM, below any taken
+// before, for buffers that should stay put for the whole run, like a
+// frame buffer or a log, without a malloc() header or the chance that
+// fragmentation keeps them from fitting. malloc() is only left what is
+// below them, so call this early, during setup(). Returns NULL if malloc()
+// already uses the space.
+void *xmemBuffer(size_t size)
+{
+	// malloc() stops short of __malloc_heap_end
+	char *end = __malloc_heap_end;
+
+	if (size > (size_t)(end - xmemBrk()))
+		return NULL;
+	__malloc_heap_end = end - size;
+	return end - size;
+}
+
+#endif
+
+static char *stackPointer(void)
+{
+	return (char *)SP;
+}
+
+// Bytes between the heap and the stack, plus the blocks malloc() has on
+// its free list
+size_t freeMemory(void)
+{
+	size_t bytes = stackPointer() - heapEnd();
+
+#if HEAP_EXTERNAL
+	// and the part of the external RAM the heap hasn't reached yet
+	bytes += __malloc_heap_end - xmemBrk();
+#endif
+
+	for (struct __freelist *fp = __flp; fp; fp = fp->nx)
+		bytes += fp->sz + sizeof(size_t);
+	return bytes;
+}
+
+// Largest malloc() that would succeed right now
+size_t largestFreeBlock(void)
+{
+	size_t largest = 0;
+#if HEAP_EXTERNAL
+	char *top = __malloc_heap_end;
+	char *brk = xmemBrk();
+#else
+	char *top = stackPointer() - __malloc_margin;
+	char *brk = heapEnd();
+#endif
+
+	for (struct __freelist *fp = __flp; fp; fp = fp->nx)
+		if (fp->sz > largest)
+			largest = fp->sz;
+
+	// malloc() keeps __malloc_margin bytes away from the stack and takes
+	// its size word from the block
+	if (top > brk + sizeof(size_t)) {
+		size_t gap = top - brk - sizeof(size_t);
+		if (gap > largest)
+			largest = gap;
+	}
+	return largest;
+}
+
+// Bytes between the heap and the deepest point the stack has reached
+size_t stackUnused(void)
+{
+	uint8_t *p = (uint8_t *)heapEnd();
+	uint8_t *sp = (uint8_t *)stackPointer();
+
+	while (p <= sp && *p == MEMORY_CANARY)
+		p++;
+	return p - (uint8_t *)heapEnd();
+}
+
+// Most bytes the stack has ever taken
+size_t stackMaxUsed(void)
+{
+	return (uint8_t *)RAMEND + 1 - (uint8_t *)heapEnd() - stackUnused();
+}
@@ -0,0 +1,168 @@
+/*
+  wiring_pool.c - fixed-size block allocator
+  Part of Arduino - http://www.arduino.cc/
+
+  Copyright (c) 2026 Arduino.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General
+  Public License along with this library; if not, write to the
+  Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+  Boston, MA  02111-1307  USA
+*/
+
+#include "wiring_private.h"
+
+// Up to four size classes of POOL_COUNT_n blocks of POOL_SIZE_n
+// bytes each, reserved as static arrays. Free blocks of a class are kept
+// in a list threaded through the blocks themselves, so poolAlloc() and
+// poolFree() take the same few cycles however full the pool is, and never
+// fragment. poolAlloc() takes a block from the smallest class that fits
+// and has one free; poolFree() finds the class from the address.
+//
+// Both may be called from interrupts. Built with NEW_USE_POOL, operator
+// new and delete go through here first and fall back to malloc().
+
+#if POOL_COUNT_0 > 255 || POOL_COUNT_1 > 255 || POOL_COUNT_2 > 255 || POOL_COUNT_3 > 255
+#error "POOL_COUNT_n must be at most 255"
+#endif
+#if POOL_SIZE_0 < 2 || POOL_SIZE_1 < 2 || POOL_SIZE_2 < 2 || POOL_SIZE_3 < 2
+#error "POOL_SIZE_n must be at least 2, a free block holds a pointer"
+#endif
+
+struct pool_block {
+	struct pool_block *next;
+};
+
+typedef struct {
+	uint8_t *mem;
+	struct pool_block *free;
+	uint16_t size;
+	uint8_t count;
+	uint8_t used;
+	uint8_t highWater;
+} pool_class;
+
+#define POOL_MEM(n) static uint8_t pool_mem##n[POOL_COUNT_##n * POOL_SIZE_##n];
+#define POOL_CLASS(n) { pool_mem##n, NULL, POOL_SIZE_##n, POOL_COUNT_##n, 0, 0 },
+
+#if POOL_COUNT_0 > 0
+POOL_MEM(0)
+#endif
+#if POOL_COUNT_1 > 0
+POOL_MEM(1)
+#endif
+#if POOL_COUNT_2 > 0
+POOL_MEM(2)
+#endif
+#if POOL_COUNT_3 > 0
+POOL_MEM(3)
+#endif
+
+// in order of size, as poolAlloc() takes the first that fits
+static pool_class pool_classes[] = {
+#if POOL_COUNT_0 > 0
+	POOL_CLASS(0)
+#endif
+#if POOL_COUNT_1 > 0
+	POOL_CLASS(1)
+#endif
+#if POOL_COUNT_2 > 0
+	POOL_CLASS(2)
+#endif
+#if POOL_COUNT_3 > 0
+	POOL_CLASS(3)
+#endif
+	{ NULL, NULL, 0, 0, 0, 0 }
+};
+
+#define POOL_CLASS_COUNT (sizeof(pool_classes) / sizeof(pool_classes[0]) - 1)
+
+static uint8_t pool_ready;
+
+static void pool_init(void)
+{
+	for (uint8_t i = 0; i < POOL_CLASS_COUNT; i++) {
+		pool_class *c = &pool_classes[i];
+		uint8_t *p = c->mem + (uint16_t)c->count * c->size;
+
+		// thread the list back to front, so it starts at the first block
+		for (uint8_t n = c->count; n; n--) {
+			struct pool_block *b;
+
+			p -= c->size;
+			b = (struct pool_block *)p;
+			b->next = c->free;
+			c->free = b;
+		}
+	}
+	pool_ready = 1;
+}
+
+void *poolAlloc(size_t size)
+{
+	void *ptr = NULL;
+	uint8_t oldSREG = SREG;
+
+	cli();
+	if (!pool_ready)
+		pool_init();
+
+	for (pool_class *c = pool_classes; c->count; c++) {
+		if (size > c->size || !c->free)
+			continue;
+		ptr = c->free;
+		c->free = c->free->next;
+		if (++c->used > c->highWater)
+			c->highWater = c->used;
+		break;
+	}
+	SREG = oldSREG;
+
+	return ptr;
+}
+
+uint8_t poolFree(void *ptr)
+{
+	uint8_t *p = (uint8_t *)ptr;
+
+	for (pool_class *c = pool_classes; c->count; c++) {
+		if (p < c->mem || p >= c->mem + (uint16_t)c->count * c->size)
+			continue;
+
+		uint8_t oldSREG = SREG;
+		cli();
+		((struct pool_block *)p)->next = c->free;
+		c->free = (struct pool_block *)p;
+		c->used--;
+		SREG = oldSREG;
+		return 1;
+	}
+	return 0;
+}
+
+uint8_t poolGetStats(uint8_t index, poolStats *stats)
+{
+	if (index >= POOL_CLASS_COUNT)
+		return 0;
+
+	pool_class *c = &pool_classes[index];
+	uint8_t oldSREG = SREG;
+
+	cli();
+	stats->size = c->size;
+	stats->count = c->count;
+	stats->used = c->used;
+	stats->highWater = c->highWater;
+	SREG = oldSREG;
+	return 1;
+}
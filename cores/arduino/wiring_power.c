@@ -0,0 +1,49 @@
+/*
+  wiring_power.c - clocks of the serial ports
+  Part of Arduino - http://www.arduino.cc/
+
+  Copyright (c) 2026 Arduino.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General
+  Public License along with this library; if not, write to the
+  Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+  Boston, MA  02111-1307  USA
+*/
+
+#include "wiring_private.h"
+
+// Starts (on) or stops the clock of the USART whose UCSRnB register is
+// ucsrb, for HardwareSerial and the USART SPI mode of the SPI library.
+// While stopped, the USART can't be written to at all, so this comes
+// first in begin() and last in end().
+void usartPower(volatile uint8_t *ucsrb, uint8_t on)
+{
+#define USART_POWER(n) \
+	if (ucsrb == &UCSR##n##B) { \
+		if (on) power_usart##n##_enable(); else power_usart##n##_disable(); \
+	}
+#if defined(power_usart0_enable) && defined(UCSR0B)
+	USART_POWER(0)
+#endif
+#if defined(power_usart1_enable) && defined(UCSR1B)
+	USART_POWER(1)
+#endif
+#if defined(power_usart2_enable) && defined(UCSR2B)
+	USART_POWER(2)
+#endif
+#if defined(power_usart3_enable) && defined(UCSR3B)
+	USART_POWER(3)
+#endif
+	(void)ucsrb;
+	(void)on;
+}
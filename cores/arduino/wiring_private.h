@@ -25,6 +25,7 @@
 
 #include <avr/io.h>
 #include <avr/interrupt.h>
+#include <avr/power.h>
 #include <stdio.h>
 #include <stdarg.h>
 
@@ -41,6 +42,8 @@ extern "C"{
 #define sbi(sfr, bit) (_SFR_BYTE(sfr) |= _BV(bit))
 #endif
 
+void analogSelectInput(uint8_t pin);
+
 uint32_t countPulseASM(volatile uint8_t *port, uint8_t bit, uint8_t stateMask, unsigned long maxloops);
 
 #define EXTERNAL_INT_0 0
@@ -65,6 +68,56 @@ uint32_t countPulseASM(volatile uint8_t *port, uint8_t bit, uint8_t stateMask, u
 
 typedef void (*voidFuncPtr)(void);
 
+// Timer0 drives millis(), micros() and delay(). Its prescaler can be set
+// at build time (the "Timer0 prescaler" board menu) to 1, 8, 64, 256 or
+// 1024, trading overflow interrupt rate for micros() resolution. It also
+// sets the PWM frequency on the Timer0 pins.
+#ifndef TIMER0_PRESCALER
+#define TIMER0_PRESCALER 64
+#endif
+
+#define TIMER0_CYCLES_PER_OVERFLOW (TIMER0_PRESCALER * 256UL)
+#define MICROSECONDS_PER_TIMER0_OVERFLOW (clockCyclesToMicroseconds(TIMER0_CYCLES_PER_OVERFLOW))
+
+// Define INIT_LAZY to 1 to have init() only start Timer0 for millis().
+// Timers 1 to 5 are then set up for PWM by the first analogWrite() on one
+// of their pins, and the ADC clock by the first analogRead(), which
+// shortens the time from reset to setup(). Code that programs a timer
+// directly and relies on init() having started it has to call
+// initPwmTimer() itself.
+#ifndef INIT_LAZY
+#define INIT_LAZY 0
+#endif
+
+extern uint8_t timer_pwm_ready;	// bit n set once timer n is set up
+void initPwmTimer(uint8_t timer);
+void analogInit(void);
+
+// Moves millis() and micros() on by us microseconds that Timer0 did not
+// count, because it was stopped in a sleep mode. us must stay below
+// 2^32 clock cycles (268 s at 16 MHz).
+void timer0Advance(unsigned long us);
+
+// init() stops the clocks of the serial ports (USARTs, SPI, TWI) and the
+// ADC, which then draw no current until something starts them: Serial,
+// SPI and Wire begin(), analogRead() and the other users of the ADC. The
+// timers keep running, as analogWrite() and sketches set them up directly.
+// PRR_CORE is the power reduction register with the SPI, TWI, ADC and
+// USART0 bits.
+#if defined(PRR0)
+#define PRR_CORE PRR0
+#elif defined(PRR)
+#define PRR_CORE PRR
+#endif
+
+void usartPower(volatile uint8_t *ucsrb, uint8_t on);
+
+// Set by the interrupts that bring work for loop() (received serial data,
+// pin interrupts), so loopIdle() doesn't sleep past work that came in
+// after loop() looked for it.
+extern volatile uint8_t idle_wake;
+#define IDLE_WAKE() (idle_wake = 1)
+
 #ifdef __cplusplus
 } // extern "C"
 #endif
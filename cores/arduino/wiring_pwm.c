@@ -0,0 +1,187 @@
+/*
+  wiring_pwm.c - high resolution PWM on the 16-bit timers
+  Part of Arduino - http://www.arduino.cc/
+
+  Copyright (c) 2026 Arduino.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General
+  Public License along with this library; if not, write to the
+  Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+  Boston, MA  02111-1307  USA
+*/
+
+#include "wiring_private.h"
+#include "pins_arduino.h"
+
+// init() runs Timer1 and Timers 3 to 5 in 8-bit phase correct mode at
+// 490 Hz, which is what analogWrite() expects. beginPwm16() instead puts
+// the timer of a pin in phase correct mode with ICRn as TOP, where both
+// the frequency and the resolution depend on TOP: the highest TOP that
+// gives the requested frequency is chosen, and returned. The duty cycle
+// then goes from 0 (off) to TOP (on). At 16 MHz, 20 kHz gives a TOP of
+// 400, 244 Hz the full 16 bits.
+//
+// All the channels of the timer share the frequency. The timer is claimed
+// (see wiring_timer_alloc.c) until endPwm16() is called for its last
+// channel, so analogWrite() on its other pins only switches them on or off.
+// pwm16_channels keeps the COM bits of the channels of each timer that
+// beginPwm16() set up, for endPwm16() to tell the last one.
+
+typedef struct {
+	volatile uint8_t *tccra;
+	volatile uint8_t *tccrb;
+	volatile uint16_t *icr;
+	volatile uint16_t *ocr;
+	uint8_t com;	// COMnx1 bit in TCCRnA
+} pwm16_t;
+
+#define PWM16_CHANNEL(n, x) \
+	r->tccra = &TCCR##n##A; \
+	r->tccrb = &TCCR##n##B; \
+	r->icr = &ICR##n; \
+	r->ocr = &OCR##n##x; \
+	r->com = _BV(COM##n##x##1); \
+	return 1;
+
+static uint8_t pwm16_channels[TIMER_COUNT];
+
+static uint8_t pwm16Lookup(uint8_t timer, pwm16_t *r)
+{
+	switch (timer) {
+#if defined(TCCR1A) && defined(ICR1) && defined(COM1A1)
+	case TIMER1A: PWM16_CHANNEL(1, A)
+	case TIMER1B: PWM16_CHANNEL(1, B)
+#if defined(OCR1C) && defined(COM1C1)
+	case TIMER1C: PWM16_CHANNEL(1, C)
+#endif
+#endif
+#if defined(TCCR3A) && defined(ICR3) && defined(COM3A1)
+	case TIMER3A: PWM16_CHANNEL(3, A)
+	case TIMER3B: PWM16_CHANNEL(3, B)
+	case TIMER3C: PWM16_CHANNEL(3, C)
+#endif
+	// Timer4 of the 32U4 is a 10-bit timer without ICR4
+#if defined(TCCR4A) && defined(ICR4) && defined(COM4A1)
+	case TIMER4A: PWM16_CHANNEL(4, A)
+	case TIMER4B: PWM16_CHANNEL(4, B)
+	case TIMER4C: PWM16_CHANNEL(4, C)
+#endif
+#if defined(TCCR5A) && defined(ICR5) && defined(COM5A1)
+	case TIMER5A: PWM16_CHANNEL(5, A)
+	case TIMER5B: PWM16_CHANNEL(5, B)
+	case TIMER5C: PWM16_CHANNEL(5, C)
+#endif
+	default:
+		return 0;
+	}
+}
+
+// Returns TOP, the duty cycle that gives a constant high output, or 0 if
+// the pin is not on a 16-bit timer or the frequency can't be reached.
+uint16_t beginPwm16(uint8_t pin, unsigned long frequency)
+{
+	static const uint16_t prescalers[] = { 1, 8, 64, 256, 1024 };
+	uint8_t timer = digitalPinToTimer(pin);
+	unsigned long top = 0;
+	uint8_t cs;
+	pwm16_t r;
+
+	if (!pwm16Lookup(timer, &r) || frequency == 0)
+		return 0;
+
+	// phase correct mode counts up to TOP and back down again
+	for (cs = 0; cs < sizeof(prescalers) / sizeof(prescalers[0]); cs++) {
+		top = F_CPU / 2 / prescalers[cs] / frequency;
+		if (top <= 65535UL)
+			break;
+	}
+	if (top < 2 || top > 65535UL)
+		return 0;
+	if (!claimTimer(timerOfChannel(timer), TIMER_OWNER_PWM16))
+		return 0;
+
+	pinMode(pin, OUTPUT);
+
+	uint8_t oldSREG = SREG;
+	cli();
+	// mode 10: phase correct PWM, TOP = ICRn. Keep the other channels'
+	// COM bits, so they go on running at the new frequency.
+	*r.tccrb = 0;
+	*r.tccra = (*r.tccra & ~(_BV(WGM10) | _BV(WGM11))) | _BV(WGM11) | r.com;
+	*r.icr = top;
+	*r.ocr = 0;
+	*r.tccrb = _BV(WGM13) | (cs + 1);
+	timer_pwm_active[timer] = 1;
+	pwm16_channels[timerOfChannel(timer)] |= r.com;
+	SREG = oldSREG;
+
+	return top;
+}
+
+// Sets the duty cycle of a pin set up with beginPwm16(), from 0 to TOP.
+void pwmWrite16(uint8_t pin, uint16_t value)
+{
+	pwm16_t r;
+	if (!pwm16Lookup(digitalPinToTimer(pin), &r))
+		return;
+
+	uint8_t oldSREG = SREG;
+	cli();
+	*r.ocr = value;
+	SREG = oldSREG;
+}
+
+// Returns the OCRnx register of a pin set up with beginPwm16(), so the
+// duty cycle can be written without any lookups, or 0 for pins that are
+// not on a 16-bit timer. Writing it is a 16-bit access through the shared
+// TEMP register, so it must not race with interrupt handlers that access
+// 16-bit registers of the same timer.
+volatile uint16_t *pwmRegister16(uint8_t pin)
+{
+	pwm16_t r;
+	if (!pwm16Lookup(digitalPinToTimer(pin), &r))
+		return 0;
+	return r.ocr;
+}
+
+// Turns PWM off on the pin. Once no other channel of the timer is left
+// from beginPwm16(), puts the timer back into the 8-bit mode
+// analogWrite() uses and gives it back.
+void endPwm16(uint8_t pin)
+{
+	uint8_t timer = digitalPinToTimer(pin);
+	uint8_t n = timerOfChannel(timer);
+	pwm16_t r;
+
+	if (!pwm16Lookup(timer, &r) || timerOwner(n) != TIMER_OWNER_PWM16 ||
+	    !(pwm16_channels[n] & r.com))
+		return;
+
+	uint8_t oldSREG = SREG;
+	cli();
+	*r.tccra &= ~r.com;
+	timer_pwm_active[timer] = 0;
+	pwm16_channels[n] &= ~r.com;
+	if (!pwm16_channels[n]) {
+		*r.tccra = (*r.tccra & ~_BV(WGM11)) | _BV(WGM10);
+		// prescale factor 64, as set by init()
+		*r.tccrb = _BV(CS11);
+#if F_CPU < 8000000L
+		// below 8 MHz, init() gives Timer1 a prescale factor of 8
+		if (r.tccrb != &TCCR1B)
+#endif
+			*r.tccrb |= _BV(CS10);
+		releaseTimer(n, TIMER_OWNER_PWM16);
+	}
+	SREG = oldSREG;
+}
@@ -0,0 +1,523 @@
+/*
+  wiring_sampling.c - interrupt driven analog conversions
+  Part of Arduino - http://www.arduino.cc/
+
+  Copyright (c) 2026 Arduino.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General
+  Public License along with this library; if not, write to the
+  Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+  Boston, MA  02111-1307  USA
+*/
+
+#include "wiring_private.h"
+#include <avr/sleep.h>
+
+// analogRead() starts one conversion and waits about 104 us for it. For a
+// steady stream of samples, the ADC is instead put in auto trigger mode: it
+// either converts back to back (free running, one sample every 13 ADC
+// clocks) or on every compare match B of Timer1 running in CTC mode at the
+// requested rate. Each result is stored by ADC_vect into a ring buffer
+// supplied by the sketch, and read back from loop().
+//
+// While sampling, analogRead() must not be used. Timer-triggered sampling
+// takes over Timer1, like the cycle counter and pulse capture do.
+//
+// ADC_vect serves every interrupt driven use of the ADC in this file, one
+// at a time, as selected by adc_mode.
+
+#if defined(ADCSRA) && defined(ADATE) && defined(ADTS0) && defined(ADC_vect)
+
+#define ADTS_FREE_RUNNING	0
+#define ADTS_TIMER1_COMPB	5	// same value on the 328, 2560 and 32U4
+
+#define ADC_MODE_IDLE		0
+#define ADC_MODE_SAMPLING	1
+#define ADC_MODE_ASYNC		2
+#define ADC_MODE_SCAN		3
+#define ADC_MODE_OVERSAMPLE	4
+#define ADC_MODE_SLEEP		5
+#define ADC_MODE_STOPPING	6	// auto trigger off, a conversion still running
+
+static volatile uint8_t adc_mode;
+
+static void (*async_callback)(int);
+
+static uint8_t scan_admux[ANALOG_SCAN_MAX];
+#if defined(ADCSRB) && defined(MUX5)
+static uint8_t scan_mux5[ANALOG_SCAN_MAX];
+#endif
+static uint16_t *scan_results;
+static uint8_t scan_count;
+static uint8_t scan_inflight;	// entry the running conversion is for
+static uint8_t scan_muxed;	// entry ADMUX is set to
+static uint8_t scan_continuous;
+static volatile uint8_t scan_done;
+
+static uint16_t oversample_sum;
+static uint8_t oversample_left;
+static uint8_t oversample_count;
+static uint8_t oversample_shift;
+static volatile uint16_t oversample_result;
+static volatile uint8_t oversample_ready;
+
+static uint16_t *sampling_buffer;
+static uint16_t sampling_size;
+static volatile uint16_t sampling_head;
+static volatile uint16_t sampling_tail;
+static volatile uint8_t sampling_overflow;
+static uint8_t sampling_timer;
+
+static inline void sampling_store(uint16_t value) __attribute__((always_inline));
+static inline void sampling_store(uint16_t value)
+{
+	uint16_t head = sampling_head;
+	uint16_t next = head + 1;
+
+	// the ADC triggers on the rising edge of OCF1B, which nothing else
+	// clears as the compare interrupt is not enabled
+	if (sampling_timer) {
+#if defined(TIFR1)
+		TIFR1 = _BV(OCF1B);
+#else
+		TIFR = _BV(OCF1B);
+#endif
+	}
+
+	if (next == sampling_size)
+		next = 0;
+	if (next == sampling_tail) {
+		sampling_overflow = 1;
+		return;
+	}
+	sampling_buffer[head] = value;
+	sampling_head = next;
+}
+
+static inline void scan_store(uint16_t value) __attribute__((always_inline));
+static inline void scan_store(uint16_t value)
+{
+	uint8_t entry = scan_inflight;
+
+	// in free running mode the next conversion has already started with
+	// the entry ADMUX was set to, so the one after it is selected now,
+	// giving the input a whole conversion time to settle
+	scan_inflight = scan_muxed;
+	if (++scan_muxed == scan_count)
+		scan_muxed = 0;
+	ADMUX = scan_admux[scan_muxed];
+#if defined(ADCSRB) && defined(MUX5)
+	ADCSRB = (ADCSRB & ~_BV(MUX5)) | scan_mux5[scan_muxed];
+#endif
+
+	scan_results[entry] = value;
+	if (entry == scan_count - 1) {
+		scan_done = 1;
+		if (!scan_continuous) {
+			// the next conversion is already running; its interrupt
+			// frees the ADC for the next user, who would otherwise get
+			// its result
+			ADCSRA &= ~_BV(ADATE);
+			adc_mode = ADC_MODE_STOPPING;
+		}
+	}
+}
+
+static inline void oversample_store(uint16_t value) __attribute__((always_inline));
+static inline void oversample_store(uint16_t value)
+{
+	oversample_sum += value;
+	if (--oversample_left == 0) {
+		oversample_result = oversample_sum >> oversample_shift;
+		oversample_ready = 1;
+		oversample_sum = 0;
+		oversample_left = oversample_count;
+	}
+}
+
+ISR(ADC_vect)
+{
+	uint16_t value = ADC;
+
+	switch (adc_mode) {
+	case ADC_MODE_SAMPLING:
+		sampling_store(value);
+		break;
+	case ADC_MODE_SCAN:
+		scan_store(value);
+		break;
+	case ADC_MODE_OVERSAMPLE:
+		oversample_store(value);
+		break;
+	case ADC_MODE_SLEEP:
+		// only there to wake analogReadNoiseReduced()
+	case ADC_MODE_STOPPING:
+		ADCSRA &= ~_BV(ADIE);
+		adc_mode = ADC_MODE_IDLE;
+		break;
+	case ADC_MODE_ASYNC:
+		ADCSRA &= ~_BV(ADIE);
+		adc_mode = ADC_MODE_IDLE;
+		async_callback(value);
+		break;
+	}
+}
+
+// Like analogReadStart(), but calls callback with the result from the ADC
+// interrupt when the conversion is done. Returns 0 if the ADC is busy with
+// another interrupt driven conversion.
+uint8_t analogReadAsync(uint8_t pin, void (*callback)(int))
+{
+	uint8_t oldSREG = SREG;
+
+	cli();
+	if (adc_mode != ADC_MODE_IDLE || !callback) {
+		SREG = oldSREG;
+		return 0;
+	}
+	adc_mode = ADC_MODE_ASYNC;
+	async_callback = callback;
+	SREG = oldSREG;
+
+	analogSelectInput(pin);
+	ADCSRA |= _BV(ADIF) | _BV(ADIE) | _BV(ADSC);
+	return 1;
+}
+
+#if defined(SLEEP_MODE_ADC)
+// Like analogRead(), but the CPU sleeps in ADC noise reduction mode while
+// the ADC converts, so no digital switching disturbs the measurement.
+// Entering the sleep mode starts the conversion. Other interrupts, such as
+// the millis() timer, still wake the CPU and are handled, after which it
+// goes back to sleep until the conversion is done. Without interrupts
+// enabled nothing could wake the CPU, so it falls back to analogRead().
+int analogReadNoiseReduced(uint8_t pin)
+{
+	uint8_t oldSREG = SREG;
+
+	if (!(oldSREG & _BV(SREG_I)))
+		return analogRead(pin);
+
+	cli();
+	if (adc_mode != ADC_MODE_IDLE) {
+		SREG = oldSREG;
+		return analogRead(pin);
+	}
+	adc_mode = ADC_MODE_SLEEP;
+	SREG = oldSREG;
+
+	analogSelectInput(pin);
+	ADCSRA |= _BV(ADIF) | _BV(ADIE);
+	set_sleep_mode(SLEEP_MODE_ADC);
+
+	for (;;) {
+		cli();
+		if (adc_mode != ADC_MODE_SLEEP)
+			break;
+		// sei only takes effect after the next instruction, so the ADC
+		// interrupt can't sneak in between and leave us sleeping
+		sleep_enable();
+		sei();
+		sleep_cpu();
+		sleep_disable();
+	}
+	SREG = oldSREG;
+
+	return ADC;
+}
+#endif
+
+// Converts the count pins (at most ANALOG_SCAN_MAX) one after the other in
+// the ADC interrupt, storing the result for pins[i] in results[i]. The
+// channel mapping is worked out once here. With continuous set, the scan
+// starts over when it is done, otherwise the ADC stops after one scan.
+// analogScanDone() tells when a full scan has completed. Returns 0 if
+// the ADC is busy with another interrupt driven conversion.
+uint8_t beginAnalogScan(const uint8_t *pins, uint8_t count, uint16_t *results, uint8_t continuous)
+{
+	uint8_t i, oldSREG;
+
+	if (!pins || !results || count == 0 || count > ANALOG_SCAN_MAX)
+		return 0;
+
+	oldSREG = SREG;
+	cli();
+	if (adc_mode != ADC_MODE_IDLE) {
+		SREG = oldSREG;
+		return 0;
+	}
+	adc_mode = ADC_MODE_SCAN;
+	SREG = oldSREG;
+
+	// let analogSelectInput() do the mapping and keep the register values
+	for (i = 0; i < count; i++) {
+		analogSelectInput(pins[i]);
+		scan_admux[i] = ADMUX;
+#if defined(ADCSRB) && defined(MUX5)
+		scan_mux5[i] = ADCSRB & _BV(MUX5);
+#endif
+	}
+	analogSelectInput(pins[0]);
+
+	scan_results = results;
+	scan_count = count;
+	scan_inflight = 0;
+	scan_muxed = 0;
+	scan_continuous = continuous;
+	scan_done = 0;
+
+	// the first conversion runs with pins[0] selected, and so does the
+	// second one since ADMUX only changes in the first interrupt
+	ADCSRB &= ~(_BV(ADTS2) | _BV(ADTS1) | _BV(ADTS0));
+	ADCSRA |= _BV(ADIF) | _BV(ADATE) | _BV(ADIE) | _BV(ADSC);
+	return 1;
+}
+
+// Returns 1 if a full scan completed since the last call.
+uint8_t analogScanDone(void)
+{
+	uint8_t done = scan_done;
+	scan_done = 0;
+	return done;
+}
+
+void endAnalogScan(void)
+{
+	uint8_t oldSREG = SREG;
+	cli();
+	if (adc_mode == ADC_MODE_SCAN || adc_mode == ADC_MODE_STOPPING) {
+		ADCSRA &= ~(_BV(ADATE) | _BV(ADIE));
+		adc_mode = ADC_MODE_IDLE;
+	}
+	SREG = oldSREG;
+
+	while (bit_is_set(ADCSRA, ADSC))
+		;
+}
+
+// Keeps converting pin in the background, summing 4^(bits - 10) samples
+// and shifting the sum right by bits - 10, for a result with bits (10 to
+// 13) of resolution. This needs some noise on the input (about one LSB),
+// which is usually there. Each result is made of 1, 4, 16 or 64 samples,
+// and a new one is available from analogOversampleResult() after that
+// many conversions. Returns 0 if the ADC is busy with another interrupt
+// driven conversion.
+uint8_t beginAnalogOversample(uint8_t pin, uint8_t bits)
+{
+	uint8_t oldSREG;
+
+	if (bits < 10 || bits > 13)
+		return 0;
+
+	oldSREG = SREG;
+	cli();
+	if (adc_mode != ADC_MODE_IDLE) {
+		SREG = oldSREG;
+		return 0;
+	}
+	adc_mode = ADC_MODE_OVERSAMPLE;
+	SREG = oldSREG;
+
+	oversample_shift = bits - 10;
+	oversample_count = 1 << (2 * oversample_shift);
+	oversample_left = oversample_count;
+	oversample_sum = 0;
+	oversample_ready = 0;
+
+	analogSelectInput(pin);
+	ADCSRB &= ~(_BV(ADTS2) | _BV(ADTS1) | _BV(ADTS0));
+	ADCSRA |= _BV(ADIF) | _BV(ADATE) | _BV(ADIE) | _BV(ADSC);
+	return 1;
+}
+
+// Returns 1 if a new result was completed since the last call to
+// analogOversampleResult().
+uint8_t analogOversampleReady(void)
+{
+	return oversample_ready;
+}
+
+// Returns the latest result, with the resolution given to
+// beginAnalogOversample().
+uint16_t analogOversampleResult(void)
+{
+	uint16_t result;
+	uint8_t oldSREG = SREG;
+
+	cli();
+	result = oversample_result;
+	oversample_ready = 0;
+	SREG = oldSREG;
+
+	return result;
+}
+
+void endAnalogOversample(void)
+{
+	uint8_t oldSREG = SREG;
+	cli();
+	if (adc_mode == ADC_MODE_OVERSAMPLE) {
+		ADCSRA &= ~(_BV(ADATE) | _BV(ADIE));
+		adc_mode = ADC_MODE_IDLE;
+	}
+	SREG = oldSREG;
+
+	while (bit_is_set(ADCSRA, ADSC))
+		;
+}
+
+// Starts sampling pin at rate samples per second, or as fast as the ADC
+// can with rate 0, into buffer (which can hold size - 1 samples). The ADC
+// needs 13 ADC clocks per conversion, so with the default ADC clock of
+// 125 kHz, rates above 9600 samples per second are not reached; see
+// analogPrescaler() for a faster ADC clock. Returns 0 if the rate can't be
+// set up.
+uint8_t beginAnalogSampling(uint8_t pin, unsigned long rate, uint16_t *buffer, uint16_t size)
+{
+	unsigned long top = 0;
+	uint8_t cs = 0;
+
+	if (!buffer || size < 2)
+		return 0;
+
+	if (rate) {
+		static const uint16_t prescalers[] = { 1, 8, 64, 256, 1024 };
+		for (cs = 0; cs < sizeof(prescalers) / sizeof(prescalers[0]); cs++) {
+			top = F_CPU / prescalers[cs] / rate;
+			if (top <= 65536UL)
+				break;
+		}
+		if (top == 0 || top > 65536UL)
+			return 0;
+		cs++;	// CS12:0 value of the prescaler
+	}
+
+	endAnalogSampling();
+	if (adc_mode != ADC_MODE_IDLE)
+		return 0;
+	if (rate && !claimTimer(1, TIMER_OWNER_SAMPLING))
+		return 0;
+
+	sampling_buffer = buffer;
+	sampling_size = size;
+	sampling_head = sampling_tail = 0;
+	sampling_overflow = 0;
+	sampling_timer = rate != 0;
+
+	analogSelectInput(pin);
+
+	uint8_t oldSREG = SREG;
+	cli();
+	adc_mode = ADC_MODE_SAMPLING;
+	if (rate) {
+		TCCR1B = 0;
+		TCCR1A = 0;
+		TCNT1 = 0;
+		OCR1A = top - 1;
+		OCR1B = top - 1;
+#if defined(TIFR1)
+		TIFR1 = _BV(OCF1B);
+#else
+		TIFR = _BV(OCF1B);
+#endif
+		ADCSRB = (ADCSRB & ~(_BV(ADTS2) | _BV(ADTS1) | _BV(ADTS0))) | ADTS_TIMER1_COMPB;
+		ADCSRA |= _BV(ADIF) | _BV(ADATE) | _BV(ADIE);
+		TCCR1B = _BV(WGM12) | cs;	// CTC mode, TOP at OCR1A
+	} else {
+		ADCSRB = (ADCSRB & ~(_BV(ADTS2) | _BV(ADTS1) | _BV(ADTS0))) | ADTS_FREE_RUNNING;
+		ADCSRA |= _BV(ADIF) | _BV(ADATE) | _BV(ADIE) | _BV(ADSC);
+	}
+	SREG = oldSREG;
+
+	return 1;
+}
+
+void endAnalogSampling(void)
+{
+	uint8_t oldSREG = SREG;
+	cli();
+
+	if (adc_mode != ADC_MODE_SAMPLING) {
+		SREG = oldSREG;
+		return;
+	}
+	adc_mode = ADC_MODE_IDLE;
+	ADCSRA &= ~(_BV(ADATE) | _BV(ADIE));
+	ADCSRB &= ~(_BV(ADTS2) | _BV(ADTS1) | _BV(ADTS0));
+
+	if (sampling_timer) {
+		// back to the configuration init() left it in: prescale factor
+		// 64, 8-bit phase correct pwm
+		TCCR1B = _BV(CS11);
+#if F_CPU >= 8000000L
+		sbi(TCCR1B, CS10);
+#endif
+		TCCR1A = _BV(WGM10);
+		sampling_timer = 0;
+		releaseTimer(1, TIMER_OWNER_SAMPLING);
+	}
+
+	SREG = oldSREG;
+
+	// let a conversion that was already started finish, so the next
+	// analogRead() gets a fresh one
+	while (bit_is_set(ADCSRA, ADSC))
+		;
+}
+
+// Number of samples waiting in the buffer
+uint16_t analogSamplesAvailable(void)
+{
+	uint16_t head;
+	uint8_t oldSREG = SREG;
+
+	cli();
+	head = sampling_head;
+	SREG = oldSREG;
+
+	if (head >= sampling_tail)
+		return head - sampling_tail;
+	return sampling_size - sampling_tail + head;
+}
+
+// Returns the oldest sample, or -1 if there is none
+int readAnalogSample(void)
+{
+	uint16_t tail = sampling_tail;
+	uint16_t head, value;
+	uint8_t oldSREG = SREG;
+
+	cli();
+	head = sampling_head;
+	SREG = oldSREG;
+
+	if (head == tail)
+		return -1;
+
+	value = sampling_buffer[tail];
+	if (++tail == sampling_size)
+		tail = 0;
+	sampling_tail = tail;	// only written here, ADC_vect just reads it
+	return value;
+}
+
+// Returns 1 if samples were dropped because the buffer was full since the
+// last call.
+uint8_t analogSamplingOverflow(void)
+{
+	uint8_t lost = sampling_overflow;
+	sampling_overflow = 0;
+	return lost;
+}
+
+#endif
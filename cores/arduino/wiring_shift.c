@@ -22,32 +22,191 @@
 
 #include "wiring_private.h"
 
+// digitalRead() turns off PWM on the pin without changing its state, which
+// the loops below rely on, as they write the port directly.
+static void shiftPinPrepare(uint8_t pin)
+{
+	if (timer_pwm_active[digitalPinToTimer(pin)])
+		digitalRead(pin);
+}
+
+#if defined(SPCR) && defined(SPDR) && defined(PIN_SPI_MOSI) && defined(PIN_SPI_MISO) && defined(PIN_SPI_SCK) && defined(PIN_SPI_SS)
+// shiftOut() matches SPI mode 0, so when it is called on the MOSI and SCK
+// pins the SPI hardware can clock the bytes out, at a quarter of the CPU
+// clock. This is only done while the SPI library is not using the
+// hardware, and not when SS is an input held low, as that would switch
+// the SPI to slave mode. A master SPI also makes MISO an input whatever
+// its DDR bit says, so the hardware is not used either while the sketch
+// drives MISO as an output. Returns 0 if the bytes must be shifted in
+// software.
+static uint8_t shiftOutSPI(uint8_t bitOrder, const uint8_t *buf, size_t len)
+{
+	uint8_t ss = digitalPinToBitMask(PIN_SPI_SS);
+	uint8_t ssPort = digitalPinToPort(PIN_SPI_SS);
+	uint8_t spcr;
+
+	if (!(*portModeRegister(ssPort) & ss) && !(*portInputRegister(ssPort) & ss))
+		return 0;
+	// the SPI does not drive pins that are not outputs
+	if (!(*portModeRegister(digitalPinToPort(PIN_SPI_MOSI)) & digitalPinToBitMask(PIN_SPI_MOSI)) ||
+	    !(*portModeRegister(digitalPinToPort(PIN_SPI_SCK)) & digitalPinToBitMask(PIN_SPI_SCK)))
+		return 0;
+	if (*portModeRegister(digitalPinToPort(PIN_SPI_MISO)) & digitalPinToBitMask(PIN_SPI_MISO))
+		return 0;
+
+#if defined(PRR_CORE) && defined(PRSPI)
+	// init() stopped the SPI clock, unless the SPI library started it
+	uint8_t stopped = PRR_CORE & _BV(PRSPI);
+	PRR_CORE &= ~_BV(PRSPI);
+#endif
+	spcr = SPCR;
+	if (spcr & _BV(SPE))
+		return 0;
+
+	SPCR = _BV(SPE) | _BV(MSTR) | (bitOrder == LSBFIRST ? _BV(DORD) : 0);
+	while (len--) {
+		SPDR = *buf++;
+		while (!(SPSR & _BV(SPIF)))
+			;
+		(void)SPDR;	// clears SPIF
+	}
+	SPCR = spcr;
+#if defined(PRR_CORE) && defined(PRSPI)
+	PRR_CORE |= stopped;
+#endif
+	return 1;
+}
+#endif
+
 uint8_t shiftIn(uint8_t dataPin, uint8_t clockPin, uint8_t bitOrder) {
+	volatile uint8_t *in = portInputRegister(digitalPinToPort(dataPin));
+	volatile uint8_t *clock = portOutputRegister(digitalPinToPort(clockPin));
+	uint8_t dataMask = digitalPinToBitMask(dataPin);
+	uint8_t clockMask = digitalPinToBitMask(clockPin);
 	uint8_t value = 0;
-	uint8_t i;
+	uint8_t i, oldSREG;
+
+	if (!in || !clock) return 0;
+	shiftPinPrepare(dataPin);
+	shiftPinPrepare(clockPin);
 
 	for (i = 0; i < 8; ++i) {
-		digitalWrite(clockPin, HIGH);
+		oldSREG = SREG;
+		cli();
+		*clock |= clockMask;
+		SREG = oldSREG;
 		if (bitOrder == LSBFIRST)
-			value |= digitalRead(dataPin) << i;
+			value = (value >> 1) | ((*in & dataMask) ? 0x80 : 0);
 		else
-			value |= digitalRead(dataPin) << (7 - i);
-		digitalWrite(clockPin, LOW);
+			value = (value << 1) | ((*in & dataMask) ? 1 : 0);
+		oldSREG = SREG;
+		cli();
+		*clock &= ~clockMask;
+		SREG = oldSREG;
 	}
 	return value;
 }
 
+// Shifts out len bytes, resolving the pins only once, e.g. for a chain of
+// shift registers.
+void shiftOutBuffer(uint8_t dataPin, uint8_t clockPin, uint8_t bitOrder, const uint8_t *buf, size_t len)
+{
+	volatile uint8_t *data = portOutputRegister(digitalPinToPort(dataPin));
+	volatile uint8_t *clock = portOutputRegister(digitalPinToPort(clockPin));
+	uint8_t dataMask = digitalPinToBitMask(dataPin);
+	uint8_t clockMask = digitalPinToBitMask(clockPin);
+	uint8_t i, val, bit, oldSREG;
+
+	if (!data || !clock) return;
+	shiftPinPrepare(dataPin);
+	shiftPinPrepare(clockPin);
+
+#if defined(SPCR) && defined(SPDR) && defined(PIN_SPI_MOSI) && defined(PIN_SPI_MISO) && defined(PIN_SPI_SCK) && defined(PIN_SPI_SS)
+	if (dataPin == PIN_SPI_MOSI && clockPin == PIN_SPI_SCK && shiftOutSPI(bitOrder, buf, len))
+		return;
+#endif
+
+	while (len--) {
+		val = *buf++;
+		for (i = 0; i < 8; i++)  {
+			if (bitOrder == LSBFIRST) {
+				bit = val & 1;
+				val >>= 1;
+			} else {
+				bit = val & 0x80;
+				val <<= 1;
+			}
+
+			// the data and clock pins may share a port with pins that
+			// interrupt handlers write, so each update is atomic
+			oldSREG = SREG;
+			cli();
+			if (bit)
+				*data |= dataMask;
+			else
+				*data &= ~dataMask;
+			*clock |= clockMask;
+			SREG = oldSREG;
+			oldSREG = SREG;
+			cli();
+			*clock &= ~clockMask;
+			SREG = oldSREG;
+		}
+	}
+}
+
 void shiftOut(uint8_t dataPin, uint8_t clockPin, uint8_t bitOrder, uint8_t val)
 {
-	uint8_t i;
+	shiftOutBuffer(dataPin, clockPin, bitOrder, &val, 1);
+}
 
-	for (i = 0; i < 8; i++)  {
-		if (bitOrder == LSBFIRST)
-			digitalWrite(dataPin, !!(val & (1 << i)));
-		else	
-			digitalWrite(dataPin, !!(val & (1 << (7 - i))));
-			
-		digitalWrite(clockPin, HIGH);
-		digitalWrite(clockPin, LOW);		
+// Shifts out to up to 8 chains of shift registers that share one clock,
+// all of whose data pins are on the same port, so every chain gets a bit
+// on each clock pulse. buf holds len bytes for each chain, interleaved:
+// first byte of chain 0, first byte of chain 1, ..., second byte of chain
+// 0 and so on. Returns 0 without shifting anything if the data pins are
+// not all on one port.
+uint8_t shiftOutParallel(const uint8_t *dataPins, uint8_t chains, uint8_t clockPin, uint8_t bitOrder, const uint8_t *buf, size_t len)
+{
+	volatile uint8_t *data, *clock;
+	uint8_t masks[8];
+	uint8_t port, clockMask, allMask = 0;
+	uint8_t c, i, bit, out, oldSREG;
+
+	if (chains == 0 || chains > 8) return 0;
+
+	port = digitalPinToPort(dataPins[0]);
+	for (c = 0; c < chains; c++) {
+		if (digitalPinToPort(dataPins[c]) != port) return 0;
+		masks[c] = digitalPinToBitMask(dataPins[c]);
+		allMask |= masks[c];
+		shiftPinPrepare(dataPins[c]);
+	}
+
+	data = portOutputRegister(port);
+	clock = portOutputRegister(digitalPinToPort(clockPin));
+	clockMask = digitalPinToBitMask(clockPin);
+	if (!data || !clock) return 0;
+	shiftPinPrepare(clockPin);
+
+	for (; len--; buf += chains) {
+		for (i = 0; i < 8; i++)  {
+			bit = (bitOrder == LSBFIRST) ? _BV(i) : _BV(7 - i);
+			out = 0;
+			for (c = 0; c < chains; c++)
+				if (buf[c] & bit)
+					out |= masks[c];
+
+			oldSREG = SREG;
+			cli();
+			*data = (*data & ~allMask) | out;
+			*clock |= clockMask;
+			SREG = oldSREG;
+			oldSREG = SREG;
+			cli();
+			*clock &= ~clockMask;
+			SREG = oldSREG;
+		}
 	}
+	return 1;
 }
@@ -0,0 +1,189 @@
+/*
+  wiring_sleep.c - power-down sleep that keeps millis() counting
+  Part of Arduino - http://www.arduino.cc/
+
+  Copyright (c) 2026 Arduino.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General
+  Public License along with this library; if not, write to the
+  Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+  Boston, MA  02111-1307  USA
+*/
+
+#include "wiring_private.h"
+#include <avr/sleep.h>
+
+// In power-down mode the chip draws a few uA, but the clock and with it
+// Timer0 stop, so millis() would lose all the time spent asleep. The
+// watchdog keeps running from its own 128 kHz oscillator and can wake the
+// CPU after 16 ms to 8 s, and sleepFor() adds each of these periods to
+// millis() and micros() with timer0Advance() when it wakes up.
+//
+// The watchdog oscillator is only accurate to about 10 %, so the first
+// call measures one 16 ms period against the crystal, and all periods
+// are taken as multiples of that. What is left of ms below one watchdog
+// period is waited for with delay().
+//
+// Other interrupts still run while sleeping (pin change and external
+// interrupts on a level, the TWI address match, ...), after which
+// sleepFor() goes back to sleep; they don't make the time count wrong.
+// The watchdog is turned off afterwards, so it can't be used as a reset
+// watchdog at the same time. USB boards lose the USB connection while
+// asleep.
+
+#if defined(WDTCSR) && defined(WDIE) && defined(WDT_vect) && defined(SLEEP_MODE_PWR_DOWN)
+
+#include <avr/wdt.h>
+
+// the longest watchdog timeout is WDP 9, 512 times the shortest
+#if defined(WDP3)
+#define SLEEP_WDP_MAX 9
+#else
+#define SLEEP_WDP_MAX 7
+#endif
+
+static volatile uint8_t sleep_ticks;
+static uint16_t sleep_tick_us;	// measured length of the 16 ms timeout
+
+static void sleepTick(void)
+{
+	sleep_ticks++;
+}
+
+// Starts the watchdog interrupt with timeout 16 ms << wdp. Interrupts must
+// be disabled.
+static void sleepWatchdog(uint8_t wdp)
+{
+	uint8_t bits = _BV(WDIE) | (wdp & 7);
+
+#if defined(WDP3)
+	if (wdp & 8)
+		bits |= _BV(WDP3);
+#endif
+	wdt_reset();
+	MCUSR &= ~_BV(WDRF);
+	// timed sequence: interrupt mode, no reset
+	WDTCSR = _BV(WDCE) | _BV(WDE);
+	WDTCSR = bits;
+}
+
+static void sleepWatchdogOff(void)
+{
+	wdt_reset();
+	WDTCSR = _BV(WDCE) | _BV(WDE);
+	WDTCSR = 0;
+}
+
+// Times two 16 ms watchdog timeouts with micros(), the first one only to
+// start from an interrupt, in idle mode where Timer0 keeps running.
+static void sleepCalibrate(void)
+{
+	unsigned long start;
+
+	cli();
+	sleep_ticks = 0;
+	sleepWatchdog(0);
+	sei();
+	while (sleep_ticks == 0)
+		;
+	start = micros();
+	while (sleep_ticks == 1)
+		;
+	sleep_tick_us = micros() - start;
+	cli();
+	sleepWatchdogOff();
+	sei();
+}
+
+// Sleeps in power-down mode for about ms milliseconds, in whole watchdog
+// periods, and waits for the rest. Returns about how many milliseconds
+// of that were spent asleep. Interrupts have to be enabled, or nothing
+// would wake the CPU up again; without them it is only a delay().
+unsigned long sleepFor(unsigned long ms)
+{
+	unsigned long slept = 0, left_us = 0;
+	uint8_t oldSREG = SREG;
+
+	if (!(oldSREG & _BV(SREG_I))) {
+		delay(ms);
+		return 0;
+	}
+
+	attachInterruptWdt(sleepTick);
+	if (sleep_tick_us == 0)
+		sleepCalibrate();
+
+#if defined(ADCSRA)
+	// an enabled ADC keeps drawing current in power-down mode
+	uint8_t adcsra = ADCSRA;
+	cbi(ADCSRA, ADEN);
+#endif
+
+	for (;;) {
+		uint8_t wdp = SLEEP_WDP_MAX;
+		unsigned long period;
+
+		// ms * 1000 would overflow beyond 71 minutes, so take it in parts
+		if (ms > 0 && left_us < 10000000UL) {
+			unsigned long part = ms < 1000000UL ? ms : 1000000UL;
+			ms -= part;
+			left_us += part * 1000;
+		}
+		while ((period = (unsigned long)sleep_tick_us << wdp) > left_us && wdp > 0)
+			wdp--;
+		if (period > left_us)
+			break;
+
+		cli();
+		sleep_ticks = 0;
+		sleepWatchdog(wdp);
+		set_sleep_mode(SLEEP_MODE_PWR_DOWN);
+		while (sleep_ticks == 0) {
+			sleep_enable();
+#if defined(sleep_bod_disable)
+			sleep_bod_disable();
+#endif
+			// the instruction after sei always runs, so no interrupt
+			// gets between it and the sleep
+			sei();
+			sleep_cpu();
+			sleep_disable();
+			cli();
+		}
+		sleepWatchdogOff();
+		SREG = oldSREG;
+
+		timer0Advance(period);
+		left_us -= period;
+		slept += period / 1000;
+	}
+
+#if defined(ADCSRA)
+	ADCSRA = adcsra;
+#endif
+	detachInterruptWdt();
+
+	delay(left_us / 1000);
+	return slept;
+}
+
+#else
+
+// no watchdog interrupt (ATmega8)
+unsigned long sleepFor(unsigned long ms)
+{
+	delay(ms);
+	return 0;
+}
+
+#endif
@@ -0,0 +1,370 @@
+/*
+  wiring_softpwm.c - PWM on any digital pin
+  Part of Arduino - http://www.arduino.cc/
+
+  Copyright (c) 2026 Arduino.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General
+  Public License along with this library; if not, write to the
+  Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+  Boston, MA  02111-1307  USA
+*/
+
+#include "wiring_private.h"
+#include "pins_arduino.h"
+
+// analogWrite() only works on the few pins wired to a timer output. This
+// instead borrows one 16-bit timer (SOFTPWM_TIMER, Timer5 on the Mega,
+// Timer1 elsewhere) in CTC mode, with one period of the PWM frequency as
+// TOP, and drives up to SOFTPWM_CHANNELS pins from its compare B
+// interrupt, with the same 0 to 255 duty cycles as analogWrite().
+//
+// A timer tick per duty step would cost an interrupt 256 times a period.
+// Instead, softPwmWrite() sorts the channels by duty cycle into an edge
+// table: at the start of the period the interrupt switches all pins on,
+// with one write for each port, and then it only runs at the times where
+// pins have to go off again, clearing all of them in their ports at once.
+// Channels with the same duty cycle share an edge, so the CPU time goes
+// with the number of different duty cycles, not the number of pins, and
+// edges too close together for another interrupt are done in the same
+// one. Duty cycles 0 and 255 need no edge at all.
+//
+// The table is built in a second copy while the other one is in use, which
+// the interrupt switches to at the start of the next period, so a change
+// never cuts a period short. The pins can be on any SOFTPWM_PORTS
+// different ports. Other pins on the same ports can still be used with
+// digitalWrite().
+
+#ifndef SOFTPWM_TIMER
+#if defined(TCCR5A) && defined(TIMER5_COMPB_vect)
+#define SOFTPWM_TIMER 5
+#else
+#define SOFTPWM_TIMER 1
+#endif
+#endif
+
+#ifndef SOFTPWM_CHANNELS
+#if defined(PORTL)
+#define SOFTPWM_CHANNELS 24
+#else
+#define SOFTPWM_CHANNELS 12
+#endif
+#endif
+
+#ifndef SOFTPWM_PORTS
+#if defined(PORTL)
+#define SOFTPWM_PORTS 6
+#else
+#define SOFTPWM_PORTS 3
+#endif
+#endif
+
+// Edges less than this many timer ticks from now are waited for in the
+// interrupt instead of getting one of their own
+#ifndef SOFTPWM_GUARD_CYCLES
+#define SOFTPWM_GUARD_CYCLES 120
+#endif
+
+#define SOFTPWM_CAT3(a, b, c) a##b##c
+#define SOFTPWM_REG(a, b) SOFTPWM_CAT3(a, SOFTPWM_TIMER, b)
+
+#define SOFTPWM_TCCRA SOFTPWM_REG(TCCR, A)
+#define SOFTPWM_TCCRB SOFTPWM_REG(TCCR, B)
+#define SOFTPWM_TCNT SOFTPWM_REG(TCNT, )
+#define SOFTPWM_OCRA SOFTPWM_REG(OCR, A)
+#define SOFTPWM_OCRB SOFTPWM_REG(OCR, B)
+#define SOFTPWM_TIMSK SOFTPWM_REG(TIMSK, )
+#define SOFTPWM_TIFR SOFTPWM_REG(TIFR, )
+#define SOFTPWM_VECT SOFTPWM_REG(TIMER, _COMPB_vect)
+// the bits have the same numbers in all 16-bit timers
+#define SOFTPWM_OCIEB OCIE1B
+#define SOFTPWM_OCFB OCF1B
+#define SOFTPWM_WGM2 WGM12
+#define SOFTPWM_CS0 CS10
+
+#if defined(TIMSK1) && defined(TIMER1_COMPB_vect)
+
+typedef struct {
+	uint16_t time;			// timer count at which the pins go off
+	uint8_t off[SOFTPWM_PORTS];
+} softpwm_edge_t;
+
+typedef struct {
+	uint8_t on[SOFTPWM_PORTS];	// pins switched on at the period start
+	uint8_t count;
+	softpwm_edge_t edge[SOFTPWM_CHANNELS];
+} softpwm_table_t;
+
+typedef struct {
+	uint8_t pin;
+	uint8_t port;			// index into softpwm_port
+	uint8_t mask;			// 0 for a free channel
+	uint8_t duty;
+} softpwm_channel_t;
+
+static softpwm_channel_t channels[SOFTPWM_CHANNELS];
+static volatile uint8_t *softpwm_port[SOFTPWM_PORTS];
+static uint8_t softpwm_ports;
+static softpwm_table_t tables[2];
+static softpwm_table_t *volatile active = &tables[0];
+static volatile uint8_t pending;	// the other table is to be used next
+static uint8_t next_edge;		// 0 for the period start
+static uint32_t period;			// TOP + 1
+static uint16_t guard;			// SOFTPWM_GUARD_CYCLES in ticks
+static uint8_t running;
+
+ISR(SOFTPWM_VECT, HOT_FUNCTION)
+{
+	softpwm_table_t *t = active;
+	uint8_t i = next_edge, p;
+
+	for (;;) {
+		if (i == 0) {
+			if (pending) {
+				t = active = (t == &tables[0]) ? &tables[1] : &tables[0];
+				pending = 0;
+			}
+			for (p = 0; p < softpwm_ports; p++)
+				if (t->on[p])
+					*softpwm_port[p] |= t->on[p];
+		} else {
+			const softpwm_edge_t *e = &t->edge[i - 1];
+			for (p = 0; p < softpwm_ports; p++)
+				if (e->off[p])
+					*softpwm_port[p] &= ~e->off[p];
+		}
+
+		if (i == t->count) {
+			// the next period starts when the counter wraps around to 0
+			next_edge = 0;
+			SOFTPWM_OCRB = 0;
+			return;
+		}
+		i++;
+
+		uint16_t when = t->edge[i - 1].time;
+		uint16_t now = SOFTPWM_TCNT;
+		if (when > now && when - now > guard) {
+			next_edge = i;
+			SOFTPWM_OCRB = when;
+			return;
+		}
+		// wait for the edge; a count below now means the counter went
+		// past TOP and wrapped, so the edge is over (and late) too
+		uint16_t t;
+		do {
+			t = SOFTPWM_TCNT;
+		} while (t >= now && t < when);
+	}
+}
+
+// Rebuilds the table the interrupt is not using and hands it over
+static void softPwmUpdate(void)
+{
+	uint8_t order[SOFTPWM_CHANNELS];
+	uint8_t n = 0, i, j;
+	softpwm_table_t *t;
+
+	// keep the interrupt on the current table until this one is done
+	pending = 0;
+	t = (active == &tables[0]) ? &tables[1] : &tables[0];
+	memset(t, 0, sizeof(*t));
+
+	// insertion sort of the channels that need an edge, by duty cycle
+	for (i = 0; i < SOFTPWM_CHANNELS; i++) {
+		softpwm_channel_t *c = &channels[i];
+		if (c->mask == 0 || c->duty == 0)
+			continue;
+		t->on[c->port] |= c->mask;
+		if (c->duty == 255)
+			continue;
+		for (j = n; j > 0 && channels[order[j - 1]].duty > c->duty; j--)
+			order[j] = order[j - 1];
+		order[j] = i;
+		n++;
+	}
+
+	for (i = 0; i < n; i++) {
+		softpwm_channel_t *c = &channels[order[i]];
+		if (!t->count || channels[order[i - 1]].duty != c->duty) {
+			t->edge[t->count].time = ((uint32_t)c->duty * period) >> 8;
+			t->count++;
+		}
+		t->edge[t->count - 1].off[c->port] |= c->mask;
+	}
+
+	pending = 1;
+	if (!running) {
+		uint8_t oldSREG = SREG;
+		cli();
+		active = t;
+		pending = 0;
+		SREG = oldSREG;
+	}
+}
+
+// Takes over the timer for PWM at frequency Hz on the pins added with
+// softPwmAttach(). Returns 0 if the timer is taken or the frequency can't
+// be reached (below 1 Hz or above 62.5 kHz at 16 MHz); with many channels, more than a
+// few hundred Hz leaves little time for the sketch.
+uint8_t beginSoftPwm(unsigned long frequency)
+{
+	static const uint16_t prescalers[] = { 1, 8, 64, 256, 1024 };
+	unsigned long top = 0;
+	uint8_t cs;
+
+	if (running)
+		endSoftPwm();
+	if (frequency == 0)
+		return 0;
+	for (cs = 0; cs < sizeof(prescalers) / sizeof(prescalers[0]); cs++) {
+		top = F_CPU / prescalers[cs] / frequency;
+		if (top <= 65536UL)
+			break;
+	}
+	// at least one tick per duty step
+	if (top < 256 || top > 65536UL)
+		return 0;
+	if (!claimTimer(SOFTPWM_TIMER, TIMER_OWNER_SOFTPWM))
+		return 0;
+
+	period = top;
+	guard = SOFTPWM_GUARD_CYCLES / prescalers[cs];
+	if (guard == 0)
+		guard = 1;
+	softPwmUpdate();
+
+	uint8_t oldSREG = SREG;
+	cli();
+	// mode 4: CTC with OCRnA as TOP, no output compare pins. The first
+	// period starts with the compare at 0 right after TOP.
+	SOFTPWM_TCCRB = 0;
+	SOFTPWM_TCCRA = 0;
+	SOFTPWM_OCRA = top - 1;
+	SOFTPWM_OCRB = 0;
+	SOFTPWM_TCNT = top - 1;
+	next_edge = 0;
+	SOFTPWM_TIFR = _BV(SOFTPWM_OCFB);
+	SOFTPWM_TIMSK |= _BV(SOFTPWM_OCIEB);
+	SOFTPWM_TCCRB = _BV(SOFTPWM_WGM2) | ((cs + 1) << SOFTPWM_CS0);
+	running = 1;
+	SREG = oldSREG;
+
+	return 1;
+}
+
+// Adds pin as a channel with a duty cycle of 0. Returns 0 if all channels
+// or ports are in use.
+uint8_t softPwmAttach(uint8_t pin)
+{
+	volatile uint8_t *out;
+	uint8_t i, free = 0xFF, p;
+
+	if (digitalPinToPort(pin) == NOT_A_PIN)
+		return 0;
+	out = portOutputRegister(digitalPinToPort(pin));
+
+	for (i = 0; i < SOFTPWM_CHANNELS; i++) {
+		if (channels[i].mask == 0) {
+			if (free == 0xFF)
+				free = i;
+		} else if (channels[i].pin == pin) {
+			return 1;
+		}
+	}
+	if (free == 0xFF)
+		return 0;
+
+	for (p = 0; p < softpwm_ports && softpwm_port[p] != out; p++)
+		;
+	if (p == softpwm_ports) {
+		if (p == SOFTPWM_PORTS)
+			return 0;
+		softpwm_port[p] = out;
+		softpwm_ports++;
+	}
+
+	digitalWrite(pin, LOW);
+	pinMode(pin, OUTPUT);
+	channels[free].port = p;
+	channels[free].mask = digitalPinToBitMask(pin);
+	channels[free].duty = 0;
+	channels[free].pin = pin;
+	return 1;
+}
+
+// Sets the duty cycle of an attached pin, from 0 (off) to 255 (on). It
+// takes effect at the start of the next period.
+void softPwmWrite(uint8_t pin, uint8_t value)
+{
+	uint8_t i;
+
+	for (i = 0; i < SOFTPWM_CHANNELS; i++) {
+		if (channels[i].pin == pin && channels[i].mask) {
+			if (channels[i].duty != value) {
+				channels[i].duty = value;
+				softPwmUpdate();
+			}
+			return;
+		}
+	}
+}
+
+// Frees the channel of pin and leaves the pin low.
+void softPwmDetach(uint8_t pin)
+{
+	uint8_t i;
+
+	for (i = 0; i < SOFTPWM_CHANNELS; i++) {
+		if (channels[i].pin == pin && channels[i].mask) {
+			channels[i].mask = 0;
+			channels[i].duty = 0;
+			softPwmUpdate();
+			// wait for the period start to drop the pin from the table
+			while (running && pending && bit_is_set(SREG, SREG_I))
+				;
+			digitalWrite(pin, LOW);
+			return;
+		}
+	}
+}
+
+// Stops the interrupt, switches all channels off and puts the timer back
+// into the 8-bit mode analogWrite() uses. The channels stay attached.
+void endSoftPwm(void)
+{
+	uint8_t i;
+
+	if (!running)
+		return;
+
+	uint8_t oldSREG = SREG;
+	cli();
+	SOFTPWM_TIMSK &= ~_BV(SOFTPWM_OCIEB);
+	for (i = 0; i < SOFTPWM_CHANNELS; i++)
+		if (channels[i].mask)
+			*softpwm_port[channels[i].port] &= ~channels[i].mask;
+	// prescale factor 64 and 8-bit phase correct PWM, as set by init()
+	SOFTPWM_TCCRA = _BV(WGM10);
+	SOFTPWM_TCCRB = _BV(CS11);
+#if F_CPU < 8000000L
+	if (SOFTPWM_TIMER != 1)
+#endif
+		SOFTPWM_TCCRB |= _BV(CS10);
+	running = 0;
+	pending = 0;
+	releaseTimer(SOFTPWM_TIMER, TIMER_OWNER_SOFTPWM);
+	SREG = oldSREG;
+}
+
+#endif
@@ -0,0 +1,180 @@
+/*
+  wiring_synth.c - several tones at once on one PWM pin
+  Part of Arduino - http://www.arduino.cc/
+
+  Copyright (c) 2026 Arduino.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General
+  Public License along with this library; if not, write to the
+  Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+  Boston, MA  02111-1307  USA
+*/
+
+#include <util/atomic.h>
+#include "wiring_private.h"
+#include "pins_arduino.h"
+
+// tone() needs a timer for every pin that plays at the same time. This
+// instead runs Timer2 in fast PWM mode without prescaler (62.5 kHz at
+// 16 MHz, above the audible range) and computes a new sample every
+// SYNTH_DIVIDER overflows: each of the TONE_VOICES voices is a square wave
+// made by a 16-bit phase accumulator (direct digital synthesis), and the
+// sum of all of them is the duty cycle of the output. A low-pass filter
+// or the speaker itself smooths the PWM carrier away.
+//
+// The output must be an OC2A or OC2B pin (11 or 3 on the Uno, 10 or 9 on
+// the Mega). Timer2 is claimed meanwhile, so tone() and analogWrite()
+// can't use it.
+
+#if defined(TCCR2A) && defined(TCCR2B) && defined(OCR2A) && defined(OCR2B) && defined(TIMER2_OVF_vect)
+
+#define SYNTH_DIVIDER	4	// power of 2
+#define SYNTH_RATE	(F_CPU / 256 / SYNTH_DIVIDER)
+#define SYNTH_LEVEL	(255 / TONE_VOICES)
+
+typedef struct {
+	uint16_t phase;
+	uint16_t increment;	// 0 when the voice is silent
+	unsigned long left;	// samples to play, 0 for no limit
+} voice_t;
+
+static voice_t voices[TONE_VOICES];
+static volatile uint8_t *synth_ocr;
+static uint8_t synth_timer;
+
+ISR(TIMER2_OVF_vect)
+{
+	static uint8_t divider;
+	uint8_t i, out = 0;
+
+	if (++divider & (SYNTH_DIVIDER - 1))
+		return;
+
+	for (i = 0; i < TONE_VOICES; i++) {
+		voice_t *v = &voices[i];
+
+		if (!v->increment)
+			continue;
+		v->phase += v->increment;
+		if (v->phase & 0x8000)
+			out += SYNTH_LEVEL;
+		if (v->left && --v->left == 0)
+			v->increment = 0;
+	}
+
+	*synth_ocr = out;
+}
+
+// Takes over Timer2 to play voices on pin. Returns 0 if the pin is not an
+// output of Timer2.
+uint8_t beginToneVoices(uint8_t pin)
+{
+	uint8_t timer = digitalPinToTimer(pin);
+	uint8_t com;
+
+	if (timer == TIMER2A) {
+		synth_ocr = &OCR2A;
+		com = _BV(COM2A1);
+	} else if (timer == TIMER2B) {
+		synth_ocr = &OCR2B;
+		com = _BV(COM2B1);
+	} else {
+		return 0;
+	}
+	if (!claimTimer(2, TIMER_OWNER_SYNTH))
+		return 0;
+
+	memset((void *)voices, 0, sizeof(voices));
+	pinMode(pin, OUTPUT);
+
+	uint8_t oldSREG = SREG;
+	cli();
+	*synth_ocr = 0;
+	// fast PWM, non-inverting output, clock without prescaler
+	TCCR2A = com | _BV(WGM21) | _BV(WGM20);
+	TCCR2B = _BV(CS20);
+	TIFR2 = _BV(TOV2);
+	sbi(TIMSK2, TOIE2);
+	timer_pwm_active[timer] = 1;
+	synth_timer = timer;
+	SREG = oldSREG;
+
+	return 1;
+}
+
+// Plays frequency Hz (up to half of SYNTH_RATE, 7.8 kHz at 16 MHz) on
+// voice for duration milliseconds, or until stopVoice() if duration is 0.
+// Durations longer than 2^32 samples (about 76 hours at 16 MHz) are cut
+// to that.
+void playVoice(uint8_t voice, unsigned int frequency, unsigned long duration)
+{
+	uint16_t increment;
+	unsigned long left = 0;
+
+	if (voice >= TONE_VOICES)
+		return;
+
+	increment = ((unsigned long)frequency << 16) / SYNTH_RATE;
+	if (duration) {
+		// whole seconds and the rest apart, so duration * SYNTH_RATE
+		// can't overflow
+		unsigned long seconds = duration / 1000;
+		if (seconds >= 0xFFFFFFFFUL / SYNTH_RATE)
+			left = 0xFFFFFFFFUL;
+		else
+			left = seconds * SYNTH_RATE + duration % 1000 * SYNTH_RATE / 1000;
+		if (!left)
+			left = 1;
+	}
+
+	// both fields are read by the interrupt
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		voices[voice].increment = increment;
+		voices[voice].left = left;
+	}
+}
+
+void stopVoice(uint8_t voice)
+{
+	if (voice >= TONE_VOICES)
+		return;
+	// the increment takes two stores, which the interrupt must not see
+	// halfway
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		voices[voice].increment = 0;
+	}
+}
+
+// Stops all voices and gives Timer2 back, in the 8-bit phase correct
+// mode init() sets up for analogWrite().
+void endToneVoices(void)
+{
+	uint8_t oldSREG;
+
+	if (timerOwner(2) != TIMER_OWNER_SYNTH)
+		return;
+
+	oldSREG = SREG;
+	cli();
+	cbi(TIMSK2, TOIE2);
+	TCCR2A = _BV(WGM20);
+	TCCR2B = _BV(CS22);
+	if (synth_ocr) {
+		*synth_ocr = 0;
+		timer_pwm_active[synth_timer] = 0;
+	}
+	releaseTimer(2, TIMER_OWNER_SYNTH);
+	SREG = oldSREG;
+}
+
+#endif
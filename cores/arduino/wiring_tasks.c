@@ -0,0 +1,96 @@
+/*
+  wiring_tasks.c - cooperative periodic tasks
+  Part of Arduino - http://www.arduino.cc/
+
+  Copyright (c) 2026 Arduino.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General
+  Public License along with this library; if not, write to the
+  Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+  Boston, MA  02111-1307  USA
+*/
+
+#include "wiring_private.h"
+
+// Tasks registered with addTask() are run from runTasks(), which is
+// called after every loop() and from yield(), so they also keep running
+// while the sketch is inside delay(). Tasks are plain functions that must
+// return quickly; they are never preempted and never run nested inside
+// one another.
+
+typedef struct {
+	void (*func)(void);
+	unsigned long period;
+	unsigned long next;
+} task_t;
+
+static task_t tasks[TASKS_MAX];
+static uint8_t tasks_running = 0;
+
+// Runs func every period milliseconds, starting period milliseconds from
+// now (a period of 0 runs it on every call to runTasks()). Returns the
+// task number for removeTask(), or -1 when all TASKS_MAX slots are taken.
+int8_t addTask(void (*func)(void), unsigned long period)
+{
+	int8_t i;
+
+	for (i = 0; i < TASKS_MAX; i++) {
+		if (tasks[i].func == NULL) {
+			tasks[i].period = period;
+			tasks[i].next = millis() + period;
+			tasks[i].func = func;
+			return i;
+		}
+	}
+	return -1;
+}
+
+void removeTask(int8_t task)
+{
+	if (task >= 0 && task < TASKS_MAX)
+		tasks[task].func = NULL;
+}
+
+void runTasks(void)
+{
+	uint8_t i;
+
+	// a task that calls delay() or yield() must not run itself (or the
+	// others) again from inside
+	if (tasks_running)
+		return;
+	tasks_running = 1;
+
+	for (i = 0; i < TASKS_MAX; i++) {
+		task_t *t = &tasks[i];
+		void (*func)(void) = t->func;
+		unsigned long now;
+
+		if (func == NULL)
+			continue;
+		now = millis();
+		if ((long)(now - t->next) < 0)
+			continue;
+
+		// keep the schedule fixed relative to the start, unless we are
+		// more than a whole period late: then skip the missed runs
+		// instead of running the task several times in a row
+		t->next += t->period;
+		if ((long)(now - t->next) >= 0)
+			t->next = now + t->period;
+
+		func();
+	}
+
+	tasks_running = 0;
+}
@@ -0,0 +1,140 @@
+/*
+  wiring_timer_alloc.c - ownership of the hardware timers
+  Part of Arduino - http://www.arduino.cc/
+
+  Copyright (c) 2026 Arduino.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General
+  Public License along with this library; if not, write to the
+  Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+  Boston, MA  02111-1307  USA
+*/
+
+#include "wiring_private.h"
+
+// init() sets all timers up for 8-bit PWM, and analogWrite() can use any of
+// them. Code that reconfigures a whole timer (tone(), beginPwm16(), pulse
+// capture, ...) claims it here first. Claiming fails if another owner has
+// the timer, instead of both silently breaking each other, and
+// analogWrite() leaves claimed timers alone: on their pins it behaves as
+// on pins without PWM. Timer0 is owned by millis(), which does not change
+// its PWM setup, so analogWrite() keeps working there.
+//
+// Libraries such as Servo can claim timers with TIMER_OWNER_USER.
+
+static uint8_t timer_owner[TIMER_COUNT];
+
+// Timer number of each analogWrite() channel, NOT_ON_TIMER ... TIMER5C
+static const uint8_t PROGMEM channel_timer_PGM[] = {
+	0xFF,		// NOT_ON_TIMER
+	0, 0,		// TIMER0A, TIMER0B
+	1, 1, 1,	// TIMER1A ... TIMER1C
+	2, 2, 2,	// TIMER2, TIMER2A, TIMER2B
+	3, 3, 3,	// TIMER3A ... TIMER3C
+	4, 4, 4, 4,	// TIMER4A ... TIMER4D
+	5, 5, 5,	// TIMER5A ... TIMER5C
+};
+
+// Returns the timer (0 to 5) a PWM channel from digitalPinToTimer() belongs
+// to, or 0xFF for NOT_ON_TIMER.
+uint8_t timerOfChannel(uint8_t channel)
+{
+	if (channel >= sizeof(channel_timer_PGM))
+		return 0xFF;
+	return pgm_read_byte(channel_timer_PGM + channel);
+}
+
+// Gives timer to owner if it is free or owner already has it. Returns 0
+// if somebody else owns it.
+uint8_t claimTimer(uint8_t timer, uint8_t owner)
+{
+	uint8_t ok, oldSREG;
+
+	if (timer >= TIMER_COUNT)
+		return 0;
+
+	oldSREG = SREG;
+	cli();
+	ok = timer_owner[timer] == TIMER_FREE || timer_owner[timer] == owner;
+	if (ok)
+		timer_owner[timer] = owner;
+	SREG = oldSREG;
+
+	return ok;
+}
+
+// Frees timer if owner has it
+void releaseTimer(uint8_t timer, uint8_t owner)
+{
+	if (timer < TIMER_COUNT && timer_owner[timer] == owner)
+		timer_owner[timer] = TIMER_FREE;
+}
+
+uint8_t timerOwner(uint8_t timer)
+{
+	if (timer >= TIMER_COUNT)
+		return TIMER_FREE;
+	return timer_owner[timer];
+}
+
+// Claims the first of count timers in candidates that is free, and returns
+// it, or -1 if all are taken.
+int8_t claimFreeTimer(const uint8_t *candidates, uint8_t count, uint8_t owner)
+{
+	uint8_t i;
+
+	for (i = 0; i < count; i++)
+		if (claimTimer(candidates[i], owner))
+			return candidates[i];
+	return -1;
+}
+
+// Returns the prescale factor timer is currently running with, read back
+// from its clock select bits, 0 if it is stopped or clocked externally.
+uint16_t timerPrescaler(uint8_t timer)
+{
+	static const uint16_t PROGMEM factors[] = { 0, 1, 8, 64, 256, 1024, 0, 0 };
+	static const uint16_t PROGMEM factors2[] = { 0, 1, 8, 32, 64, 128, 256, 1024 };
+	uint8_t cs;
+
+	switch (timer) {
+#if defined(TCCR0B)
+	case 0: cs = TCCR0B; break;
+#elif defined(TCCR0)
+	case 0: cs = TCCR0; break;
+#endif
+#if defined(TCCR1B)
+	case 1: cs = TCCR1B; break;
+#endif
+#if defined(TCCR2B)
+	case 2: return pgm_read_word(factors2 + (TCCR2B & 7));
+#elif defined(TCCR2)
+	case 2: return pgm_read_word(factors2 + (TCCR2 & 7));
+#endif
+#if defined(TCCR3B)
+	case 3: cs = TCCR3B; break;
+#endif
+#if defined(TCCR4B) && !defined(TCCR4D)
+	case 4: cs = TCCR4B; break;
+#elif defined(TCCR4B)
+	// the 32U4 Timer4 has 4 clock select bits, for powers of 2 up to 16384
+	case 4: cs = TCCR4B & 0x0F; return cs ? 1 << (cs - 1) : 0;
+#endif
+#if defined(TCCR5B)
+	case 5: cs = TCCR5B; break;
+#endif
+	default: return 0;
+	}
+
+	return pgm_read_word(factors + (cs & 7));
+}
@@ -0,0 +1,188 @@
+/*
+  wiring_timers.c - software timers on the Timer0 compare B interrupt
+  Part of Arduino - http://www.arduino.cc/
+
+  Copyright (c) 2026 Arduino.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General
+  Public License along with this library; if not, write to the
+  Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+  Boston, MA  02111-1307  USA
+*/
+
+#include "wiring_private.h"
+
+// The Timer0 compare B interrupt fires once per Timer0 cycle, whatever
+// the value of OCR0B, so it ticks at the same rate as the overflow that
+// drives millis() and leaves PWM on OC0B (pin 5 on the Uno) working. The
+// handler only counts ticks. runTimers(), called after every loop() and
+// from yield(), catches up with the elapsed ticks and runs the callbacks
+// of the timers that expired, so callbacks run in normal context and may
+// do anything a sketch may do.
+//
+// Timers are kept in a hashed timer wheel: a timer due in n ticks is put
+// in slot (now + n) % TIMER_WHEEL_SIZE and is passed over (n - 1) /
+// TIMER_WHEEL_SIZE times before it expires. Starting or stopping a timer
+// does not depend on the number of timers, and each tick only looks at
+// the timers in one slot.
+
+#if defined(TIMER0_COMPB_vect) && defined(OCR0B) && defined(TIMSK0) && defined(OCIE0B)
+
+#ifndef TIMER_WHEEL_SIZE
+#define TIMER_WHEEL_SIZE 16
+#endif
+
+#if (TIMER_WHEEL_SIZE & (TIMER_WHEEL_SIZE - 1)) != 0 || TIMER_WHEEL_SIZE > 128
+#error "TIMER_WHEEL_SIZE must be a power of 2 and at most 128"
+#endif
+
+#define TIMER_WHEEL_MASK (TIMER_WHEEL_SIZE - 1)
+
+// Values of softTimer::slot besides the wheel slots
+#define TIMER_DUE 0xFE   // expired, waiting in timer_due for its callback
+#define TIMER_IDLE 0xFF  // not running
+
+static softTimer *timer_wheel[TIMER_WHEEL_SIZE];
+static softTimer *timer_due;
+static volatile uint16_t timer_ticks;
+static uint16_t timer_now;
+
+ISR(TIMER0_COMPB_vect)
+{
+	timer_ticks++;
+}
+
+static unsigned int ms_to_ticks(unsigned int ms)
+{
+	unsigned long ticks = (ms * (F_CPU / 1000) + TIMER0_CYCLES_PER_OVERFLOW / 2) / TIMER0_CYCLES_PER_OVERFLOW;
+
+	return ticks ? ticks : 1;
+}
+
+// Number of ticks runTimers() has not processed yet
+static uint16_t timer_backlog(void)
+{
+	uint16_t ticks;
+	uint8_t oldSREG = SREG;
+
+	cli();
+	ticks = timer_ticks;
+	SREG = oldSREG;
+
+	return ticks - timer_now;
+}
+
+static void timer_insert(softTimer *t, unsigned int ticks)
+{
+	uint8_t slot = (timer_now + ticks) & TIMER_WHEEL_MASK;
+
+	t->rounds = (ticks - 1) / TIMER_WHEEL_SIZE;
+	t->slot = slot;
+	t->next = timer_wheel[slot];
+	timer_wheel[slot] = t;
+}
+
+static void timer_unlink(softTimer **list, softTimer *t)
+{
+	for (; *list; list = &(*list)->next) {
+		if (*list == t) {
+			*list = t->next;
+			return;
+		}
+	}
+}
+
+// Calls callback(arg) after ms milliseconds and then every period
+// milliseconds, or only once if period is 0. Timers have a resolution of
+// one Timer0 overflow (1.024 ms at 16 MHz with the default prescaler).
+// Restarts t if it is already running.
+void startTimer(softTimer *t, unsigned int ms, unsigned int period, void (*callback)(void *), void *arg)
+{
+	stopTimer(t);
+
+	if (!(TIMSK0 & _BV(OCIE0B))) {
+		uint8_t oldSREG = SREG;
+
+		cli();
+		timer_now = timer_ticks;
+		TIFR0 = _BV(OCF0B);
+		sbi(TIMSK0, OCIE0B);
+		SREG = oldSREG;
+	}
+
+	t->callback = callback;
+	t->arg = arg;
+	t->period = period ? ms_to_ticks(period) : 0;
+	// count from the current tick, even if runTimers() has not caught up
+	// with it yet
+	timer_insert(t, ms_to_ticks(ms) + timer_backlog());
+}
+
+void stopTimer(softTimer *t)
+{
+	if (t->slot == TIMER_DUE)
+		timer_unlink(&timer_due, t);
+	else if (t->slot < TIMER_WHEEL_SIZE)
+		timer_unlink(&timer_wheel[t->slot], t);
+	t->slot = TIMER_IDLE;
+}
+
+void runTimers(void)
+{
+	static uint8_t running = 0;
+	uint16_t backlog;
+
+	// a callback that calls delay() or yield() must not run timers from
+	// inside
+	if (running)
+		return;
+	running = 1;
+
+	for (backlog = timer_backlog(); backlog; backlog--) {
+		softTimer **p;
+
+		timer_now++;
+
+		// First collect everything that expires on this tick, so that
+		// callbacks starting or stopping timers cannot disturb the walk
+		p = &timer_wheel[timer_now & TIMER_WHEEL_MASK];
+		while (*p) {
+			softTimer *t = *p;
+
+			if (t->rounds) {
+				t->rounds--;
+				p = &t->next;
+			} else {
+				*p = t->next;
+				t->slot = TIMER_DUE;
+				t->next = timer_due;
+				timer_due = t;
+			}
+		}
+
+		while (timer_due) {
+			softTimer *t = timer_due;
+
+			timer_due = t->next;
+			if (t->period)
+				timer_insert(t, t->period);
+			else
+				t->slot = TIMER_IDLE;
+			t->callback(t->arg);
+		}
+	}
+
+	running = 0;
+}
+
+#endif
@@ -0,0 +1,117 @@
+/*
+  Arduino.h - What the portable core classes need, for the host build
+  Copyright (c) 2026 Arduino.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+// The Makefile includes this file ahead of every source (-include), so
+// its guard keeps the real Arduino.h, and the AVR registers and pins it
+// drags in, out of the core sources built here. It stands in for
+// wiring_private.h as well. Only the core types, macros and functions
+// the portable classes use are declared.
+
+#ifndef Arduino_h
+#define Arduino_h
+#define WiringPrivate_h
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+#include <avr/pgmspace.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+#include "binary.h"
+
+#ifndef F_CPU
+#define F_CPU 16000000L
+#endif
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+#define HIGH 0x1
+#define LOW  0x0
+
+#ifdef abs
+#undef abs
+#endif
+
+#define min(a,b) ((a)<(b)?(a):(b))
+#define max(a,b) ((a)>(b)?(a):(b))
+#define abs(x) ((x)>0?(x):-(x))
+#define constrain(amt,low,high) ((amt)<(low)?(low):((amt)>(high)?(high):(amt)))
+#define sq(x) ((x)*(x))
+
+#define HOT_FUNCTION
+
+#define interrupts() sei()
+#define noInterrupts() cli()
+
+#define lowByte(w) ((uint8_t) ((w) & 0xff))
+#define highByte(w) ((uint8_t) ((w) >> 8))
+
+typedef unsigned int word;
+typedef bool boolean;
+typedef uint8_t byte;
+
+// From the host clock, see host.cpp
+unsigned long millis(void);
+unsigned long micros(void);
+void delay(unsigned long ms);
+void yield(void);
+
+// As in the real Arduino.h, see wiring_arena.c
+typedef struct memArena {
+	uint8_t *base;
+	size_t size;
+	size_t used;
+	size_t last;
+	size_t highWater;
+} memArena;
+
+void arenaBegin(memArena *arena, void *buffer, size_t size);
+void *arenaAlloc(memArena *arena, size_t size);
+void *arenaRealloc(memArena *arena, void *ptr, size_t oldSize, size_t size);
+uint8_t arenaOwns(const memArena *arena, const void *ptr);
+void arenaReset(memArena *arena);
+
+#ifdef __cplusplus
+} // extern "C"
+
+#include "WCharacter.h"
+#include "WString.h"
+// the real one gets these through HardwareSerial.h
+#include "Stream.h"
+
+unsigned int makeWord(unsigned int w);
+unsigned int makeWord(unsigned char h, unsigned char l);
+
+long random(long);
+long random(long, long);
+void randomSeed(unsigned long);
+long fastRandom(long);
+long fastRandom(long, long);
+uint32_t fastRandom32(void);
+void fastRandomSeed(unsigned long);
+long map(long, long, long, long, long);
+#endif
+
+#endif
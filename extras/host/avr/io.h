@@ -0,0 +1,42 @@
+/*
+  io.h - The registers the portable core classes touch, for the host build
+  Copyright (c) 2026 Arduino.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef _AVR_IO_H_
+#define _AVR_IO_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+// Only the status register, for the interrupt-off sections of the ring
+// buffers; nothing interrupts the host build
+extern volatile uint8_t SREG;
+#define SREG_I 7
+
+#ifndef _BV
+#define _BV(bit) (1 << (bit))
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,328 @@
+/*
+  bench.cpp - Microbenchmarks of the portable core classes on the host
+  Copyright (c) 2026 Arduino.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+// Each benchmark runs its function BENCH_ITERATIONS times per round, for
+// BENCH_ROUNDS rounds, and the fastest round counts, so a round the
+// scheduler cut into doesn't. Results are "name<TAB>ns per call", one per
+// line as printed by the Benchmark library on the board, so two runs
+// (before and after a change) compare with diff or a spreadsheet. The
+// host has 32-bit ints and 64-bit longs and a CPU that is nothing like
+// the AVR: compare runs with each other, not with the board.
+//
+// Every benchmark checks its result first and exits with an error if it
+// is wrong, so the run also catches a change that broke the class.
+//
+//   bench            all benchmarks
+//   bench String     only those whose name starts with String
+
+#include "Arduino.h"
+#include "Print.h"
+#include "Stream.h"
+#include "IPAddress.h"
+#include "RingBuffer.h"
+#include "host.h"
+
+#ifndef BENCH_ITERATIONS
+#define BENCH_ITERATIONS 20000
+#endif
+#ifndef BENCH_ROUNDS
+#define BENCH_ROUNDS 7
+#endif
+
+static HostSerial serial;
+static volatile long sink;
+static const char *filter;
+static int failures;
+
+static void check(const char *name, bool ok)
+{
+  if (!ok) {
+    printf("%s\tFAILED\n", name);
+    failures++;
+  }
+}
+
+static void run(const char *name, void (*fn)(void))
+{
+  if (filter && strncmp(name, filter, strlen(filter)) != 0)
+    return;
+
+  uint64_t best = ~(uint64_t)0;
+  for (int r = 0; r < BENCH_ROUNDS; r++) {
+    uint64_t start = hostNanos();
+    for (int i = 0; i < BENCH_ITERATIONS; i++)
+      fn();
+    uint64_t t = hostNanos() - start;
+    if (t < best)
+      best = t;
+  }
+  printf("%s\t%.1f\n", name, (double)best / BENCH_ITERATIONS);
+}
+
+// String
+
+static void stringConcatNumbers(void)
+{
+  String s;
+  for (int i = 0; i < 8; i++) {
+    s += i * 1234;
+    s += ',';
+  }
+  sink = s.length();
+}
+
+static void stringConcatChars(void)
+{
+  String s;
+  for (char c = 'a'; c <= 'z'; c++)
+    s += c;
+  sink = s.length();
+}
+
+static void stringFromFloat(void)
+{
+  String s(3.14159f, 3);
+  sink = s.length();
+}
+
+static void stringSearch(void)
+{
+  static const String s("GET /index.html HTTP/1.1\r\nHost: example");
+  sink = s.indexOf("Host:") + s.lastIndexOf('/');
+}
+
+static void stringReplace(void)
+{
+  String s("one two three two one");
+  s.replace("two", "2");
+  sink = s.length();
+}
+
+static void stringToInt(void)
+{
+  static const String s("-1234567");
+  sink = s.toInt();
+}
+
+// Print
+
+static void printDecimal(void)
+{
+  serial.clearOutput();
+  serial.print(4294967295UL);
+  serial.print(-2147483647L);
+  sink = serial.outputLength();
+}
+
+static void printHex(void)
+{
+  serial.clearOutput();
+  serial.print(0xDEADBEEFUL, HEX);
+  sink = serial.outputLength();
+}
+
+static void printFloat(void)
+{
+  serial.clearOutput();
+  serial.print(1234.5678, 4);
+  sink = serial.outputLength();
+}
+
+static void printFormatted(void)
+{
+  serial.clearOutput();
+  serial.printf("%d:%02d:%02d %s", 12, 34, 56, "ok");
+  sink = serial.outputLength();
+}
+
+// Stream
+
+static const char numbers[] = "12345 -678 90 3.25 text 42\n";
+
+static void streamParseInt(void)
+{
+  serial.rewind();
+  sink = serial.parseInt() + serial.parseInt() + serial.parseInt();
+}
+
+static void streamParseFloat(void)
+{
+  serial.rewind();
+  sink = (long)(serial.parseFloat() * 100);
+}
+
+static void streamFind(void)
+{
+  serial.rewind();
+  sink = serial.find((char *)"text");
+}
+
+static void streamReadUntil(void)
+{
+  char buf[32];
+  serial.rewind();
+  sink = serial.readBytesUntil('\n', buf, sizeof(buf));
+}
+
+// IPAddress
+
+static void ipFromString(void)
+{
+  IPAddress ip;
+  sink = ip.fromString("192.168.100.254");
+}
+
+static void ipPrint(void)
+{
+  static const IPAddress ip(192, 168, 100, 254);
+  serial.clearOutput();
+  serial.print(ip);
+  sink = serial.outputLength();
+}
+
+// WMath
+
+static void mathRandom(void)
+{
+  sink = random(1000);
+}
+
+static void mathFastRandom(void)
+{
+  sink = fastRandom(1000);
+}
+
+static void mathMap(void)
+{
+  sink = map(sink & 1023, 0, 1023, 0, 255);
+}
+
+// Ring buffers
+
+static SpscQueue<uint8_t, 64> queue8;
+static SpscQueue<uint16_t, 512> queue16;
+
+static void ringPushPop8(void)
+{
+  uint8_t v;
+  for (uint8_t i = 0; i < 32; i++)
+    queue8.push(i);
+  while (queue8.pop(v))
+    sink = v;
+}
+
+static void ringPushPop16(void)
+{
+  uint16_t v;
+  for (uint16_t i = 0; i < 32; i++)
+    queue16.push(i);
+  while (queue16.pop(v))
+    sink = v;
+}
+
+static void checkResults(void)
+{
+  String s("x=");
+  s += 42;
+  s += ",f=";
+  s += String(2.5f, 1);
+  check("String", s == "x=42,f=2.5" && String("-1234567").toInt() == -1234567);
+
+  serial.clearOutput();
+  serial.print(4294967295UL);
+  serial.print(' ');
+  serial.print(-2147483647L);
+  serial.print(' ');
+  serial.print(0xBEEF, HEX);
+  serial.print(' ');
+  serial.print(1.25, 2);
+  serial.printf(" %d-%s", 7, "ok");
+  static const char printed[] = "4294967295 -2147483647 BEEF 1.25 7-ok";
+  check("Print", serial.outputLength() == sizeof(printed) - 1 &&
+        memcmp(serial.output(), printed, sizeof(printed) - 1) == 0);
+
+  serial.feed(numbers, sizeof(numbers) - 1);
+  check("Stream", serial.parseInt() == 12345 && serial.parseInt() == -678 &&
+        serial.parseInt() == 90 && serial.parseFloat() == 3.25f &&
+        serial.find((char *)"text") && serial.parseInt() == 42);
+  serial.rewind();
+
+  IPAddress ip;
+  serial.clearOutput();
+  check("IPAddress", ip.fromString("10.0.0.254") && ip == IPAddress(10, 0, 0, 254) &&
+        serial.print(ip) == 10);
+
+  bool inRange = true;
+  for (int i = 0; i < 1000; i++) {
+    long r = fastRandom(10, 20);
+    inRange = inRange && r >= 10 && r < 20;
+  }
+  check("WMath", inRange && map(512, 0, 1023, 0, 255) == 127);
+
+  uint8_t v = 0;
+  bool ringOk = true;
+  for (uint8_t i = 0; i < 63; i++)
+    ringOk = ringOk && queue8.push(i);
+  ringOk = ringOk && !queue8.push(63) && queue8.available() == 63;
+  for (uint8_t i = 0; i < 63; i++)
+    ringOk = ringOk && queue8.pop(v) && v == i;
+  check("Ring", ringOk && queue8.empty());
+}
+
+int main(int argc, char **argv)
+{
+  if (argc > 1)
+    filter = argv[1];
+
+  checkResults();
+  if (failures)
+    return 1;
+
+  printf("# host, %d iterations, best of %d rounds, ns per call\n",
+         BENCH_ITERATIONS, BENCH_ROUNDS);
+
+  run("String concat numbers", stringConcatNumbers);
+  run("String concat chars", stringConcatChars);
+  run("String from float", stringFromFloat);
+  run("String indexOf", stringSearch);
+  run("String replace", stringReplace);
+  run("String toInt", stringToInt);
+
+  run("Print decimal", printDecimal);
+  run("Print hex", printHex);
+  run("Print float", printFloat);
+  run("Print printf", printFormatted);
+
+  serial.feed(numbers, sizeof(numbers) - 1);
+  run("Stream parseInt", streamParseInt);
+  run("Stream parseFloat", streamParseFloat);
+  run("Stream find", streamFind);
+  run("Stream readBytesUntil", streamReadUntil);
+
+  run("IPAddress fromString", ipFromString);
+  run("IPAddress print", ipPrint);
+
+  run("WMath random", mathRandom);
+  run("WMath fastRandom", mathFastRandom);
+  run("WMath map", mathMap);
+
+  run("Ring push/pop 8-bit", ringPushPop8);
+  run("Ring push/pop 16-bit", ringPushPop16);
+  return 0;
+}
@@ -0,0 +1,123 @@
+/*
+  host.cpp - The AVR and avr-libc pieces under the host build
+  Copyright (c) 2026 Arduino.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include <time.h>
+#include "Arduino.h"
+#include "host.h"
+
+volatile uint8_t SREG = _BV(SREG_I);
+
+uint64_t hostNanos(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+unsigned long millis(void)
+{
+  return (unsigned long)(hostNanos() / 1000000ULL);
+}
+
+unsigned long micros(void)
+{
+  return (unsigned long)(hostNanos() / 1000ULL);
+}
+
+void delay(unsigned long ms)
+{
+  unsigned long start = millis();
+  while (millis() - start < ms)
+    yield();
+}
+
+void yield(void)
+{
+}
+
+// The avr-libc number conversions
+
+char *ultoa(unsigned long val, char *s, int radix)
+{
+  char buf[8 * sizeof(long) + 1];
+  char *p = &buf[sizeof(buf) - 1];
+
+  *p = 0;
+  if (radix < 2 || radix > 36)
+    radix = 10;
+  do {
+    unsigned d = val % radix;
+    *--p = d < 10 ? '0' + d : 'a' + d - 10;
+    val /= radix;
+  } while (val);
+  return strcpy(s, p);
+}
+
+char *ltoa(long val, char *s, int radix)
+{
+  if (val < 0 && radix == 10) {
+    s[0] = '-';
+    ultoa(-(unsigned long)val, s + 1, radix);
+    return s;
+  }
+  return ultoa((unsigned long)val, s, radix);
+}
+
+char *utoa(unsigned int val, char *s, int radix)
+{
+  return ultoa(val, s, radix);
+}
+
+char *itoa(int val, char *s, int radix)
+{
+  if (val < 0 && radix == 10)
+    return ltoa(val, s, radix);
+  return ultoa((unsigned int)val, s, radix);
+}
+
+char *dtostrf(double val, signed char width, unsigned char prec, char *s)
+{
+  sprintf(s, "%*.*f", width, prec, val);
+  return s;
+}
+
+// The stand-in for an avr-libc stream, see stdio.h here
+int host_vfprintf(struct host_file *stream, const char *format, va_list ap)
+{
+  char small[64];
+  char *buf = small;
+  va_list copy;
+
+  va_copy(copy, ap);
+  int n = vsnprintf(small, sizeof(small), format, copy);
+  va_end(copy);
+  if (n < 0)
+    return n;
+  if ((size_t)n >= sizeof(small)) {
+    buf = (char *)malloc(n + 1);
+    if (!buf)
+      return -1;
+    vsnprintf(buf, n + 1, format, ap);
+  }
+  for (int i = 0; i < n; i++)
+    stream->put(buf[i], stream);
+  if (buf != small)
+    free(buf);
+  return n;
+}
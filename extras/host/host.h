@@ -0,0 +1,61 @@
+/*
+  host.h - Helpers of the host build for the benchmarks
+  Copyright (c) 2026 Arduino.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef host_h
+#define host_h
+
+#include "Arduino.h"
+#include "Stream.h"
+
+// Time of the host's monotonic clock in nanoseconds
+uint64_t hostNanos(void);
+
+// A Stream standing in for Serial: write() appends to an output buffer,
+// discarding what doesn't fit, and read() takes from an input buffer
+// given with feed(), which rewind() starts over
+class HostSerial : public Stream
+{
+  public:
+    HostSerial() : _in(NULL), _inLen(0), _inPos(0), _outLen(0) { setTimeout(0); }
+
+    void feed(const char *data, size_t len) { _in = data; _inLen = len; _inPos = 0; }
+    void rewind() { _inPos = 0; }
+    void clearOutput() { _outLen = 0; }
+    size_t outputLength() const { return _outLen; }
+    const char *output() const { return _out; }
+
+    virtual int available() { return _inLen - _inPos; }
+    virtual int read() { return _inPos < _inLen ? (unsigned char)_in[_inPos++] : -1; }
+    virtual int peek() { return _inPos < _inLen ? (unsigned char)_in[_inPos] : -1; }
+    virtual size_t write(uint8_t c) {
+      if (_outLen < sizeof(_out))
+        _out[_outLen++] = c;
+      return 1;
+    }
+    using Print::write;
+
+  private:
+    const char *_in;
+    size_t _inLen;
+    size_t _inPos;
+    size_t _outLen;
+    char _out[4096];
+};
+
+#endif
@@ -0,0 +1,56 @@
+/*
+  stdio.h - The avr-libc stream setup on top of the host stdio.h
+  Copyright (c) 2026 Arduino.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include_next <stdio.h>
+
+#ifndef HOST_STDIO_H
+#define HOST_STDIO_H
+
+#include <stdarg.h>
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+// Print::printf() sets up an avr-libc FILE that hands each character to
+// a function. The host FILE can't do that, so in the core sources FILE,
+// fdev_setup_stream() and vfprintf() are this stand-in, which formats
+// with the host vsnprintf() and then passes the characters on.
+struct host_file {
+	int (*put)(char, struct host_file *);
+	void *udata;
+};
+
+#define _FDEV_SETUP_WRITE 2
+#define fdev_setup_stream(stream, p, g, f) \
+	do { (stream)->put = (p); (stream)->udata = 0; (void)(g); (void)(f); } while (0)
+#define fdev_set_udata(stream, u) ((stream)->udata = (u))
+#define fdev_get_udata(stream) ((stream)->udata)
+
+int host_vfprintf(struct host_file *stream, const char *format, va_list ap);
+
+#define FILE struct host_file
+#define vfprintf host_vfprintf
+#define vfprintf_P host_vfprintf
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
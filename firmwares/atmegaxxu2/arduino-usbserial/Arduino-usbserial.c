@@ -34,13 +34,16 @@
  *  the project and is responsible for the initial application hardware configuration.
  */
 
+#define  INCLUDE_FROM_ARDUINO_USBSERIAL_C
 #include "Arduino-usbserial.h"
 
 /** Circular buffer to hold data from the host before it is sent to the device via the serial port. */
 RingBuff_t USBtoUSART_Buffer;
+static RingBuff_Data_t USBtoUSART_Storage[USBtoUSART_BUFFER_SIZE];
 
 /** Circular buffer to hold data from the serial port before it is sent to the host. */
 RingBuff_t USARTtoUSB_Buffer;
+static RingBuff_Data_t USARTtoUSB_Storage[USARTtoUSB_BUFFER_SIZE];
 
 /** Pulse generation counters to keep track of the number of milliseconds remaining for each pulse type */
 volatile struct
@@ -81,38 +84,20 @@ int main(void)
 {
 	SetupHardware();
 	
-	RingBuffer_InitBuffer(&USBtoUSART_Buffer);
-	RingBuffer_InitBuffer(&USARTtoUSB_Buffer);
+	RingBuffer_InitBuffer(&USBtoUSART_Buffer, USBtoUSART_Storage, sizeof(USBtoUSART_Storage));
+	RingBuffer_InitBuffer(&USARTtoUSB_Buffer, USARTtoUSB_Storage, sizeof(USARTtoUSB_Storage));
 
 	sei();
 
 	for (;;)
 	{
-		/* Only try to read in bytes from the CDC interface if the transmit buffer is not full */
-		if (!(RingBuffer_IsFull(&USBtoUSART_Buffer)))
-		{
-			int16_t ReceivedByte = CDC_Device_ReceiveByte(&VirtualSerial_CDC_Interface);
+		/* The flush timer also times the LED pulses */
+		bool FlushTimerExpired = (TIFR0 & (1 << TOV0));
 
-			/* Read bytes from the USB OUT endpoint into the USART transmit buffer */
-			if (!(ReceivedByte < 0))
-			  RingBuffer_Insert(&USBtoUSART_Buffer, ReceivedByte);
-		}
-		
-		/* Check if the UART receive buffer flush timer has expired or the buffer is nearly full */
-		RingBuff_Count_t BufferCount = RingBuffer_GetCount(&USARTtoUSB_Buffer);
-		if ((TIFR0 & (1 << TOV0)) || (BufferCount > BUFFER_NEARLY_FULL))
+		if (FlushTimerExpired)
 		{
 			TIFR0 |= (1 << TOV0);
 
-			if (USARTtoUSB_Buffer.Count) {
-				LEDs_TurnOnLEDs(LEDMASK_TX);
-				PulseMSRemaining.TxLEDPulse = TX_RX_LED_PULSE_MS;
-			}
-
-			/* Read bytes from the USART receive buffer into the USB IN endpoint */
-			while (BufferCount--)
-			  CDC_Device_SendByte(&VirtualSerial_CDC_Interface, RingBuffer_Remove(&USARTtoUSB_Buffer));
-			  
 			/* Turn off TX LED(s) once the TX pulse period has elapsed */
 			if (PulseMSRemaining.TxLEDPulse && !(--PulseMSRemaining.TxLEDPulse))
 			  LEDs_TurnOffLEDs(LEDMASK_TX);
@@ -121,20 +106,124 @@ int main(void)
 			if (PulseMSRemaining.RxLEDPulse && !(--PulseMSRemaining.RxLEDPulse))
 			  LEDs_TurnOffLEDs(LEDMASK_RX);
 		}
-		
-		/* Load the next byte from the USART transmit buffer into the USART */
-		if (!(RingBuffer_IsEmpty(&USBtoUSART_Buffer))) {
-		  Serial_TxByte(RingBuffer_Remove(&USBtoUSART_Buffer));
-		  	
-		  	LEDs_TurnOnLEDs(LEDMASK_RX);
-			PulseMSRemaining.RxLEDPulse = TX_RX_LED_PULSE_MS;
+
+		if (USB_DeviceState == DEVICE_STATE_Configured)
+		{
+			USBtoUSART_Task();
+			USARTtoUSB_Task(FlushTimerExpired);
 		}
-		
+
+		FlowControl_Task();
+
 		CDC_Device_USBTask(&VirtualSerial_CDC_Interface);
 		USB_USBTask();
 	}
 }
 
+/** Moves a whole packet from the CDC OUT endpoint into the USART transmit buffer, once the buffer has
+ *  room for all of it. Reading the endpoint directly saves the endpoint selection and status checks
+ *  that \ref CDC_Device_ReceiveByte() repeats for every byte.
+ */
+static void USBtoUSART_Task(void)
+{
+	Endpoint_SelectEndpoint(CDC_RX_EPNUM);
+
+	if (!(Endpoint_IsOUTReceived()))
+	  return;
+
+	uint8_t BytesInPacket = Endpoint_BytesInEndpoint();
+
+	if (BytesInPacket > RingBuffer_GetFreeCount(&USBtoUSART_Buffer))
+	  return;
+
+	if (BytesInPacket)
+	{
+		LEDs_TurnOnLEDs(LEDMASK_RX);
+		PulseMSRemaining.RxLEDPulse = TX_RX_LED_PULSE_MS;
+	}
+
+	while (BytesInPacket--)
+	  RingBuffer_Insert(&USBtoUSART_Buffer, Endpoint_Read_Byte());
+
+	Endpoint_ClearOUT();
+
+	/* Let the USART data register empty interrupt send them; the line encoding handler also writes
+	 * UCSR1B, from the USB interrupt */
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		UCSR1B |= (1 << UDRIE1);
+	}
+}
+
+/** Sends the bytes received by the USART to the host in packets. A full packet goes out as soon as it
+ *  is buffered, so a fast stream is never held back by the flush timer; whatever is left over goes
+ *  out when the timer expires. After a full packet the host may wait for the end of the transfer,
+ *  so if nothing follows it an empty packet ends it.
+ *
+ *  \param[in] FlushTimerExpired  True if the flush timer has expired since the last call
+ */
+static void USARTtoUSB_Task(const bool FlushTimerExpired)
+{
+	static bool LastPacketFull;
+
+	RingBuff_Count_t BufferCount = RingBuffer_GetCount(&USARTtoUSB_Buffer);
+
+	if ((BufferCount < CDC_TXRX_EPSIZE) && !(FlushTimerExpired))
+	  return;
+
+	if ((BufferCount == 0) && !(LastPacketFull))
+	  return;
+
+	Endpoint_SelectEndpoint(CDC_TX_EPNUM);
+
+	if (!(Endpoint_IsINReady()))
+	  return;
+
+	uint8_t BytesInPacket = MIN(BufferCount, CDC_TXRX_EPSIZE);
+
+	if (BytesInPacket)
+	{
+		LEDs_TurnOnLEDs(LEDMASK_TX);
+		PulseMSRemaining.TxLEDPulse = TX_RX_LED_PULSE_MS;
+	}
+
+	LastPacketFull = (BytesInPacket == CDC_TXRX_EPSIZE);
+
+	while (BytesInPacket--)
+	  Endpoint_Write_Byte(RingBuffer_Remove(&USARTtoUSB_Buffer));
+
+	Endpoint_ClearIN();
+}
+
+/** Drives the RTS line from the free space in the buffer of data for the host and the host's own RTS, and
+ *  restarts sending to the target once it asserts CTS again, if those lines are configured.
+ */
+static void FlowControl_Task(void)
+{
+	#if defined(AVR_RTS_LINE_PORT)
+	if ((USB_DeviceState == DEVICE_STATE_Configured) &&
+	    (VirtualSerial_CDC_Interface.State.ControlLineStates.HostToDevice & CDC_CONTROL_LINE_OUT_RTS) &&
+	    (RingBuffer_GetFreeCount(&USARTtoUSB_Buffer) > RTS_FREE_THRESHOLD))
+	{
+		AVR_RTS_LINE_PORT &= ~AVR_RTS_LINE_MASK;
+	}
+	else
+	{
+		AVR_RTS_LINE_PORT |= AVR_RTS_LINE_MASK;
+	}
+	#endif
+
+	#if defined(AVR_CTS_LINE_PIN)
+	if (!(AVR_CTS_LINE_PIN & AVR_CTS_LINE_MASK) && !(RingBuffer_IsEmpty(&USBtoUSART_Buffer)))
+	{
+		ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+		{
+			UCSR1B |= (1 << UDRIE1);
+		}
+	}
+	#endif
+}
+
 /** Configures the board hardware and chip peripherals for the demo's functionality. */
 void SetupHardware(void)
 {
@@ -153,6 +242,12 @@ void SetupHardware(void)
 	/* Pull target /RESET line high */
 	AVR_RESET_LINE_PORT |= AVR_RESET_LINE_MASK;
 	AVR_RESET_LINE_DDR  |= AVR_RESET_LINE_MASK;
+
+	#if defined(AVR_RTS_LINE_PORT)
+	/* Hold the target off until the host is connected */
+	AVR_RTS_LINE_PORT |= AVR_RTS_LINE_MASK;
+	AVR_RTS_LINE_DDR  |= AVR_RTS_LINE_MASK;
+	#endif
 }
 
 /** Event handler for the library USB Configuration Changed event. */
@@ -167,7 +262,39 @@ void EVENT_USB_Device_UnhandledControlRequest(void)
 	CDC_Device_ProcessControlRequest(&VirtualSerial_CDC_Interface);
 }
 
+/** Retrieves the UBRR value that gets closest to the given baud rate, limited to what fits in the register.
+ *
+ *  \param[in] BaudRateBPS  Requested baud rate, in bits per second
+ *  \param[in] Divisor      Clock cycles per bit for each UBRR step: 8 in double speed mode, 16 in normal mode
+ */
+static uint16_t BaudSettingFor(const uint32_t BaudRateBPS, const uint8_t Divisor)
+{
+	if (!(BaudRateBPS))
+	  return 4095;
+
+	uint32_t Setting = (F_CPU + (uint32_t)(Divisor / 2) * BaudRateBPS) / ((uint32_t)Divisor * BaudRateBPS);
+
+	if (Setting == 0)
+	  return 0;
+
+	if (Setting > 4096)
+	  return 4095;
+
+	return (Setting - 1);
+}
+
+/** Retrieves the difference between two baud rates. */
+static uint32_t BaudDifference(const uint32_t A, const uint32_t B)
+{
+	return ((A > B) ? (A - B) : (B - A));
+}
+
 /** Event handler for the CDC Class driver Line Encoding Changed event.
+ *
+ *  The baud rate is set up the way HardwareSerial::begin() in the Arduino core does it, by trying both
+ *  double speed and normal mode and taking which gets closer, normal mode on a tie. Both run at 16MHz,
+ *  so for any rate the target's sketch or bootloader opens its port with, both ends land on exactly the
+ *  same divisor, even at rates like 230400 which 16MHz can't make exactly.
  *
  *  \param[in] CDCInterfaceInfo  Pointer to the CDC class interface configuration structure being referenced
  */
@@ -206,14 +333,21 @@ void EVENT_CDC_Device_LineEncodingChanged(USB_ClassInfo_CDC_Device_t* const CDCI
 	UCSR1A = 0;
 	UCSR1C = 0;
 
-	/* Special case 57600 baud for compatibility with the ATmega328 bootloader. */	
-	UBRR1  = (CDCInterfaceInfo->State.LineEncoding.BaudRateBPS == 57600)
-			 ? SERIAL_UBBRVAL(CDCInterfaceInfo->State.LineEncoding.BaudRateBPS)
-			 : SERIAL_2X_UBBRVAL(CDCInterfaceInfo->State.LineEncoding.BaudRateBPS);	
+	uint32_t BaudRateBPS = CDCInterfaceInfo->State.LineEncoding.BaudRateBPS;
+	uint16_t Setting2X   = BaudSettingFor(BaudRateBPS, 8);
+	uint16_t Setting1X   = BaudSettingFor(BaudRateBPS, 16);
+	bool     DoubleSpeed = (BaudDifference(F_CPU / 8 / (Setting2X + 1), BaudRateBPS) <
+	                        BaudDifference(F_CPU / 16 / (Setting1X + 1), BaudRateBPS));
+
+	/* Special case 57600 baud for compatibility with the ATmega328 bootloader. */
+	if ((F_CPU == 16000000UL) && (BaudRateBPS == 57600))
+	  DoubleSpeed = false;
+
+	UBRR1  = (DoubleSpeed ? Setting2X : Setting1X);
 
 	UCSR1C = ConfigMask;
-	UCSR1A = (CDCInterfaceInfo->State.LineEncoding.BaudRateBPS == 57600) ? 0 : (1 << U2X1);
-	UCSR1B = ((1 << RXCIE1) | (1 << TXEN1) | (1 << RXEN1));
+	UCSR1A = (DoubleSpeed ? (1 << U2X1) : 0);
+	UCSR1B = ((1 << RXCIE1) | (1 << TXEN1) | (1 << RXEN1) | (1 << UDRIE1));
 }
 
 /** ISR to manage the reception of data from the serial port, placing received bytes into a circular buffer
@@ -223,10 +357,29 @@ ISR(USART1_RX_vect, ISR_BLOCK)
 {
 	uint8_t ReceivedByte = UDR1;
 
-	if (USB_DeviceState == DEVICE_STATE_Configured)
+	/* A full buffer drops the new byte; inserting it would make the buffer look empty */
+	if ((USB_DeviceState == DEVICE_STATE_Configured) && !(RingBuffer_IsFull(&USARTtoUSB_Buffer)))
 	  RingBuffer_Insert(&USARTtoUSB_Buffer, ReceivedByte);
 }
 
+/** ISR to feed the serial port from the circular buffer of data from the host, one byte each time the
+ *  USART data register is empty. It turns itself off once the buffer is empty, until the main loop
+ *  adds more.
+ */
+ISR(USART1_UDRE_vect, ISR_BLOCK)
+{
+	#if defined(AVR_CTS_LINE_PIN)
+	/* Wait for the target to assert CTS; the main loop turns this back on then */
+	if (AVR_CTS_LINE_PIN & AVR_CTS_LINE_MASK)
+	  UCSR1B &= ~(1 << UDRIE1);
+	else
+	#endif
+	if (RingBuffer_IsEmpty(&USBtoUSART_Buffer))
+	  UCSR1B &= ~(1 << UDRIE1);
+	else
+	  UDR1 = RingBuffer_Remove(&USBtoUSART_Buffer);
+}
+
 /** Event handler for the CDC Class driver Host-to-Device Line Encoding Changed event.
  *
  *  \param[in] CDCInterfaceInfo  Pointer to the CDC class interface configuration structure being referenced
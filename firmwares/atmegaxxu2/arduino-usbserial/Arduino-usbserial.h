@@ -41,6 +41,7 @@
 		#include <avr/wdt.h>
 		#include <avr/interrupt.h>
 		#include <avr/power.h>
+		#include <util/atomic.h>
 
 		#include "Descriptors.h"
 
@@ -64,10 +65,39 @@
 		
 		/** LED mask for the library LED driver, to indicate that the USB interface is busy. */
 		#define LEDMASK_BUSY             (LEDS_LED1 | LEDS_LED2)		
+
+		/** Size of the buffer of data from the host for the serial port, a power of two up to 256. The USB
+		 *  side only copies whole packets, so it must be larger than \ref CDC_TXRX_EPSIZE.
+		 */
+		#define USBtoUSART_BUFFER_SIZE   128
+
+		/** Size of the buffer of data from the serial port for the host, a power of two up to 256. The
+		 *  target can't be held up, so this one gets the larger share of the 512 bytes of SRAM.
+		 */
+		#define USARTtoUSB_BUFFER_SIZE   256
+
+		/** Hardware flow control. If AVR_RTS_LINE_PORT, AVR_RTS_LINE_DDR and AVR_RTS_LINE_MASK are
+		 *  defined (see the makefile; PB4 is free on the Uno and Mega 2560), that pin is driven low while
+		 *  the buffer for the host has more than \ref RTS_FREE_THRESHOLD bytes free and the host asserts
+		 *  RTS, and high otherwise, telling the target to stop sending. If AVR_CTS_LINE_PIN and
+		 *  AVR_CTS_LINE_MASK are defined (PB5, say), nothing is sent to the target while that pin is high.
+		 *  It has no pull-up: give it a pull-down resistor, so that it reads low while the target is in
+		 *  reset or in its bootloader, and uploads still work.
+		 */
+		#define RTS_FREE_THRESHOLD       32
+
+		/** Smaller of two values. */
+		#define MIN(x, y)                (((x) < (y)) ? (x) : (y))
 		
 	/* Function Prototypes: */
 		void SetupHardware(void);
 
+		#if defined(INCLUDE_FROM_ARDUINO_USBSERIAL_C)
+			static void USBtoUSART_Task(void);
+			static void USARTtoUSB_Task(const bool FlushTimerExpired);
+			static void FlowControl_Task(void);
+		#endif
+
 		void EVENT_USB_Device_Connect(void);
 		void EVENT_USB_Device_Disconnect(void);
 		void EVENT_USB_Device_ConfigurationChanged(void);
@@ -37,65 +37,56 @@
 #define _ULW_RING_BUFF_H_
 
 	/* Includes: */
-		#include <util/atomic.h>
-	
 		#include <stdint.h>
 		#include <stdbool.h>
 
 	/* Defines: */
-		/** Size of each ring buffer, in data elements - must be between 1 and 255. */
-		#define BUFFER_SIZE         128
-		
-		/** Maximum number of data elements to buffer before forcing a flush. 
-		 *  Must be less than BUFFER_SIZE
-		 */
-		#define BUFFER_NEARLY_FULL	96
-		
 		/** Type of data to store into the buffer. */
 		#define RingBuff_Data_t     uint8_t
 
 		/** Datatype which may be used to store the count of data stored in a buffer, retrieved
 		 *  via a call to \ref RingBuffer_GetCount().
 		 */
-		#if (BUFFER_SIZE <= 0xFF)
-			#define RingBuff_Count_t   uint8_t
-		#else
-			#define RingBuff_Count_t   uint16_t
-		#endif
+		#define RingBuff_Count_t    uint8_t
 
 	/* Type Defines: */
 		/** Type define for a new ring buffer object. Buffers should be initialized via a call to
 		 *  \ref RingBuffer_InitBuffer() before use.
+		 *
+		 *  The storage is a power of two in size, up to 256 bytes, and the In and Out indexes are
+		 *  masked into it, so there is no shared count that both ends update: each index is a
+		 *  single byte, written only by its own end of the buffer, and reading it needs no atomic
+		 *  lock. One element is always left free, so that a full buffer can be told from an
+		 *  empty one; a buffer holds at most its size minus one elements.
 		 */
 		typedef struct
 		{
-			RingBuff_Data_t  Buffer[BUFFER_SIZE]; /**< Internal ring buffer data, referenced by the buffer pointers. */
-			RingBuff_Data_t* In; /**< Current storage location in the circular buffer */
-			RingBuff_Data_t* Out; /**< Current retrieval location in the circular buffer */
-			RingBuff_Count_t Count;
+			RingBuff_Data_t* Buffer; /**< Storage of the buffer, given to \ref RingBuffer_InitBuffer(). */
+			uint8_t Mask; /**< Size of the storage, minus one. */
+			volatile uint8_t In; /**< Index of the next storage location in the circular buffer */
+			volatile uint8_t Out; /**< Index of the next retrieval location in the circular buffer */
 		} RingBuff_t;
-	
+
 	/* Inline Functions: */
 		/** Initializes a ring buffer ready for use. Buffers must be initialized via this function
 		 *  before any operations are called upon them. Already initialized buffers may be reset
-		 *  by re-initializing them using this function.
+		 *  by re-initializing them using this function, as long as nothing else uses them meanwhile.
 		 *
-		 *  \param[out] Buffer  Pointer to a ring buffer structure to initialize
+		 *  \param[out] Buffer   Pointer to a ring buffer structure to initialize
+		 *  \param[in]  Storage  Storage for the buffer's elements
+		 *  \param[in]  Size     Number of elements in Storage, a power of two between 2 and 256
 		 */
-		static inline void RingBuffer_InitBuffer(RingBuff_t* const Buffer)
+		static inline void RingBuffer_InitBuffer(RingBuff_t* const Buffer,
+		                                         RingBuff_Data_t* const Storage,
+		                                         const uint16_t Size)
 		{
-			ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
-			{
-				Buffer->In  = Buffer->Buffer;
-				Buffer->Out = Buffer->Buffer;
-			}
+			Buffer->Buffer = Storage;
+			Buffer->Mask   = (Size - 1);
+			Buffer->In     = 0;
+			Buffer->Out    = 0;
 		}
-		
-		/** Retrieves the minimum number of bytes stored in a particular buffer. This value is computed
-		 *  by entering an atomic lock on the buffer while the IN and OUT locations are fetched, so that
-		 *  the buffer cannot be modified while the computation takes place. This value should be cached
-		 *  when reading out the contents of the buffer, so that as small a time as possible is spent
-		 *  in an atomic lock.
+
+		/** Retrieves the minimum number of bytes stored in a particular buffer.
 		 *
 		 *  \note The value returned by this function is guaranteed to only be the minimum number of bytes
 		 *        stored in the given buffer; this value may change as other threads write new data and so
@@ -106,44 +97,43 @@
 		 */
 		static inline RingBuff_Count_t RingBuffer_GetCount(RingBuff_t* const Buffer)
 		{
-			RingBuff_Count_t Count;
-			
-			ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
-			{
-				Count = Buffer->Count;
-			}
-			
-			return Count;
+			return ((Buffer->In - Buffer->Out) & Buffer->Mask);
+		}
+
+		/** Retrieves the minimum number of elements that can be inserted into a particular buffer, for
+		 *  the thread that inserts into it.
+		 *
+		 *  \param[in] Buffer  Pointer to a ring buffer structure whose free space is to be computed
+		 */
+		static inline RingBuff_Count_t RingBuffer_GetFreeCount(RingBuff_t* const Buffer)
+		{
+			return (Buffer->Mask - RingBuffer_GetCount(Buffer));
 		}
-		
-		/** Atomically determines if the specified ring buffer contains any free space. This should
+
+		/** Determines if the specified ring buffer contains any free space. This should
 		 *  be tested before storing data to the buffer, to ensure that no data is lost due to a
 		 *  buffer overrun.
 		 *
 		 *  \param[in,out] Buffer  Pointer to a ring buffer structure to insert into
 		 *
 		 *  \return Boolean true if the buffer contains no free space, false otherwise
-		 */		 
+		 */
 		static inline bool RingBuffer_IsFull(RingBuff_t* const Buffer)
 		{
-			return (RingBuffer_GetCount(Buffer) == BUFFER_SIZE);
+			return (((Buffer->In + 1) & Buffer->Mask) == Buffer->Out);
 		}
 
-		/** Atomically determines if the specified ring buffer contains any data. This should
+		/** Determines if the specified ring buffer contains any data. This should
 		 *  be tested before removing data from the buffer, to ensure that the buffer does not
 		 *  underflow.
 		 *
-		 *  If the data is to be removed in a loop, store the total number of bytes stored in the
-		 *  buffer (via a call to the \ref RingBuffer_GetCount() function) in a temporary variable
-		 *  to reduce the time spent in atomicity locks.
-		 *
 		 *  \param[in,out] Buffer  Pointer to a ring buffer structure to insert into
 		 *
-		 *  \return Boolean true if the buffer contains no free space, false otherwise
-		 */		 
+		 *  \return Boolean true if the buffer contains no data, false otherwise
+		 */
 		static inline bool RingBuffer_IsEmpty(RingBuff_t* const Buffer)
 		{
-			return (RingBuffer_GetCount(Buffer) == 0);
+			return (Buffer->In == Buffer->Out);
 		}
 
 		/** Inserts an element into the ring buffer.
@@ -158,15 +148,10 @@
 		static inline void RingBuffer_Insert(RingBuff_t* const Buffer,
 		                                     const RingBuff_Data_t Data)
 		{
-			*Buffer->In = Data;
-			
-			if (++Buffer->In == &Buffer->Buffer[BUFFER_SIZE])
-			  Buffer->In = Buffer->Buffer;
-
-			ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
-			{
-				Buffer->Count++;
-			}
+			uint8_t In = Buffer->In;
+
+			Buffer->Buffer[In] = Data;
+			Buffer->In = ((In + 1) & Buffer->Mask);
 		}
 
 		/** Removes an element from the ring buffer.
@@ -181,16 +166,11 @@
 		 */
 		static inline RingBuff_Data_t RingBuffer_Remove(RingBuff_t* const Buffer)
 		{
-			RingBuff_Data_t Data = *Buffer->Out;
-			
-			if (++Buffer->Out == &Buffer->Buffer[BUFFER_SIZE])
-			  Buffer->Out = Buffer->Buffer;
-
-			ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
-			{
-				Buffer->Count--;
-			}
-			
+			uint8_t Out = Buffer->Out;
+			RingBuff_Data_t Data = Buffer->Buffer[Out];
+
+			Buffer->Out = ((Out + 1) & Buffer->Mask);
+
 			return Data;
 		}
 
@@ -200,7 +200,7 @@
 
 /* Pin related to shield communication */
  #define ARDUINO_HANDSHAKE_PIN 		AVR32_PIN_PA25
- #define ARDUINO_EXTINT_PIN 		AVR32_PIN_PA04		//not used
+ #define ARDUINO_EXTINT_PIN 		AVR32_PIN_PA04		//event line, see EVENT_FOR_SPI()
 
  #define AVR32_PDCA_PID_TX 			AVR32_PDCA_PID_SPI1_TX
  #define AVR32_PDCA_PID_RX 			AVR32_PDCA_PID_SPI1_RX
@@ -47,6 +47,13 @@ extern const char* fwVersion;
 #endif
 #if BOARD == ARDUINO
 #  define ARD_SPI                 (&AVR32_SPI0)
+/* The link to the AVR has PDCA channels of its own, channels 0 and 1
+ * belong to the WiFi chip (see avr32_spi.c). */
+#  define ARD_PDCA_CH_TX          2
+#  define ARD_PDCA_CH_RX          3
+#  define ARD_PDCA_PID_TX         AVR32_PDCA_PID_SPI0_TX
+#  define ARD_PDCA_PID_RX         AVR32_PDCA_PID_SPI0_RX
+#  define ARD_PDCA_RX_IRQ         (AVR32_PDCA_IRQ_0 + ARD_PDCA_CH_RX)
 #define EXT_INT_PIN_LINE1               AVR32_EIC_EXTINT_5_PIN
 #define EXT_INT_FUNCTION_LINE1          AVR32_EIC_EXTINT_5_FUNCTION
 #define EXT_INT_LINE1                   EXT_INT5
@@ -81,7 +88,6 @@ extern void tcp_debug_print_pcbs(void);
 extern bool ifStatus;
 extern bool scanNetCompleted;
 
-static char buf[CMD_MAX_LEN];
 static char reply[REPLY_MAX_LEN];
 static uint16_t cmdCorr = 0;
 static uint16_t count = 0;
@@ -89,13 +95,41 @@ static uint16_t replyCount = 0;
 static cmd_spi_state_t state = SPI_CMD_IDLE;
 int receivedChars = 0;
 static uint8_t _receiveBuffer[_BUFFERSIZE];
+// where the bytes clocked in while a reply goes out end up
+static char _replySink[REPLY_MAX_LEN];
 bool startReply = false;
+
+/*
+ * Pipelined commands: PIPE_CMD only queues a command with the AVR's
+ * sequence number and acks at once; spi_poll() runs the queued ones
+ * in between SPI transfers, building each reply in pipeReplies as
+ * seq, 16 bit length, reply frame, until GET_PIPE_REPLIES_CMD hands
+ * them over. A bulk read in a pipeline is kept short enough for its
+ * entry to fit a single GET_PIPE_REPLIES_CMD reply.
+ */
+#define PIPE_CMD_NUM		4
+#define PIPE_REPLY_LEN		(2*REPLY_MAX_LEN)
+#define PIPE_ENTRY_HDR		3
+
+typedef struct sPipeCmd{
+	uint8_t seq;
+	uint8_t len;
+	char cmd[_BUFFERSIZE];
+}tPipeCmd;
+
+static tPipeCmd pipeCmds[PIPE_CMD_NUM];
+static uint8_t pipeHead = 0;
+static uint8_t pipeCount = 0;
+static uint8_t pipeQueued = 0;
+static char pipeReplies[PIPE_REPLY_LEN];
+static uint16_t pipeRepliesLen = 0;
+static bool pipeMode = false;	// a queued command runs, keep its reply
 bool end_write = false;	//TODO only for debug
 
 // Signal indicating a new command is coming from SPI interface
 static volatile Bool startRecvCmdSignal = FALSE;
 
-#define MAX_CMD_NUM 36
+#define MAX_CMD_NUM 48
 typedef struct sCmd_spi_list{
 	cmd_spi_cb_t cb;
 	char cmd_id;
@@ -123,6 +157,63 @@ typedef struct sStatSpi
 
 tStatSpi statSpi = {0};
 
+// Time from a command frame being complete to its reply being sent, in
+// CPU cycles, per entry of cmd_spi_list
+typedef struct sStatCmd
+{
+	uint32_t count;
+	uint32_t minCy;
+	uint32_t maxCy;
+	uint64_t totCy;
+}tStatCmd;
+
+static tStatCmd statCmd[MAX_CMD_NUM];
+
+// Network bytes of each socket since statStart (ms)
+static uint32_t statSockRx[MAX_SOCK_NUM];
+static uint32_t statSockTx[MAX_SOCK_NUM];
+static uint32_t statStart = 0;
+
+void statSpiCmd(unsigned char cmdId, uint32_t cy)
+{
+	int i;
+	for (i = 0; i < MAX_CMD_NUM; i++)
+	{
+		if ((cmd_spi_list[i].cb != NULL) && (cmd_spi_list[i].cmd_id == cmdId))
+		{
+			tStatCmd* s = &statCmd[i];
+			if ((s->count == 0) || (cy < s->minCy))
+				s->minCy = cy;
+			if (cy > s->maxCy)
+				s->maxCy = cy;
+			s->totCy += cy;
+			s->count++;
+			return;
+		}
+	}
+}
+
+void statSpiSock(uint8_t sock, uint16_t rx, uint16_t tx)
+{
+	if (sock < MAX_SOCK_NUM)
+	{
+		statSockRx[sock] += rx;
+		statSockTx[sock] += tx;
+	}
+}
+
+// Average rate of bytes since statStart
+static uint32_t statRate(uint32_t bytes)
+{
+	uint32_t ms = timer_get_ms() - statStart;
+	return (ms == 0) ? 0 : (uint32_t)(((uint64_t)bytes * 1000) / ms);
+}
+
+static uint32_t statAvgUs(tStatCmd* s)
+{
+	return (s->count == 0) ? 0 : cpu_cy_2_us(s->totCy / s->count, FCPU_HZ);
+}
+
 void initStatSpi()
 {
 	statSpi.lastCmd = 0;
@@ -135,6 +226,10 @@ void initStatSpi()
 	statSpi.wrongFrame = 0;
 	statSpi.frameDisalign = 0;
 	statSpi.overrideFrame = 0;
+	memset(statCmd, 0, sizeof(statCmd));
+	memset(statSockRx, 0, sizeof(statSockRx));
+	memset(statSockTx, 0, sizeof(statSockTx));
+	statStart = timer_get_ms();
 }
 
 void printStatSpi()
@@ -150,6 +245,26 @@ void printStatSpi()
 	printk("wrongFrame\t: 0x%x\n", statSpi.wrongFrame);
 	printk("disalFrame\t: 0x%x\n", statSpi.frameDisalign);
 	printk("overrideFrame\t: 0x%x\n", statSpi.overrideFrame);
+
+	int i;
+	printk("cmd\tcount\tmin\tavg\tmax [us]\n");
+	for (i = 0; i < MAX_CMD_NUM; i++)
+	{
+		tStatCmd* s = &statCmd[i];
+		if ((cmd_spi_list[i].cb == NULL) || (s->count == 0))
+			continue;
+		printk("0x%x\t%d\t%d\t%d\t%d\n", (uint8_t)cmd_spi_list[i].cmd_id, s->count,
+				cpu_cy_2_us(s->minCy, FCPU_HZ), statAvgUs(s),
+				cpu_cy_2_us(s->maxCy, FCPU_HZ));
+	}
+	printk("sock\trx\ttx\trx/s\ttx/s\n");
+	for (i = 0; i < MAX_SOCK_NUM; i++)
+	{
+		if ((statSockRx[i] == 0) && (statSockTx[i] == 0))
+			continue;
+		printk("%d\t%d\t%d\t%d\t%d\n", i, statSockRx[i], statSockTx[i],
+				statRate(statSockRx[i]), statRate(statSockTx[i]));
+	}
 }
 
 cmd_state_t
@@ -167,6 +282,39 @@ cmd_resetStatSpi(int argc, char* argv[], void* ctx)
 }
 #endif
 
+// Bytes of a command DUMP_SPI_CMD() prints, as many as a dlog entry keeps
+#define DUMP_SPI_CMD_LEN 32
+
+// Formats the command into one line and prints it with a single printk(),
+// or with _DLOG_ only copies it into the log
+void dumpSpiCmd(const char* func, const char* buf)
+{
+	uint16_t len = 0;
+
+	while (len < CMD_MAX_LEN && (uint8_t)buf[len++] != END_CMD)
+		;
+#ifdef _DLOG_
+	dlog_dump(func, buf, len);
+#else
+	static const char hex[] = "0123456789abcdef";
+	char line[DUMP_SPI_CMD_LEN * 5 + 1];
+	uint16_t i, n = 0;
+
+	for (i = 0; i < len && i < DUMP_SPI_CMD_LEN; ++i)
+	{
+		uint8_t b = buf[i];
+		line[n++] = '0';
+		line[n++] = 'x';
+		if (b >= 0x10)
+			line[n++] = hex[b >> 4];
+		line[n++] = hex[b & 0xf];
+		line[n++] = ' ';
+	}
+	line[n] = '\0';
+	printk("[%s]: %s%s\n", func, line, (i < len) ? "..." : "");
+#endif
+}
+
 #define ARRAY_SIZE(a) sizeof(a) / sizeof(a[0])
 #define RETURN_ERR(e) return (e==WL_SUCCESS) ? WIFI_SPI_ACK : WIFI_SPI_ERR;
 #define RESET_USART_CSR(usart) usart->cr = AVR32_USART_CR_RSTSTA_MASK;
@@ -216,12 +364,10 @@ int getSock(void * _ttcp)
 {
 	if (_ttcp != NULL)
 	{
-		int i = 0;
-		for (; i<MAX_SOCK_NUM; i++)
-		{
-			if (_ttcp == mapSockTCP[i][GET_TCP_MODE(_ttcp)])
-				return i;
-		}
+		// the ttcp knows its socket, the map tells if it still has it
+		int i = ((ttcp_t*)_ttcp)->sock;
+		if ((i<MAX_SOCK_NUM) && (_ttcp == mapSockTCP[i][GET_TCP_MODE(_ttcp)]))
+			return i;
 	}
 	return -1;
 }
@@ -323,34 +469,88 @@ void showTTCPstatus()
 	tcp_debug_print_pcbs();
 }
 
+/*
+ * Sends len bytes from stream with the PDCA, while the bytes the AVR
+ * clocks in meanwhile go to _replySink. The AVR sets the pace; only give
+ * up when it stops clocking for SPI_TIMEOUT polls.
+ */
 int write_stream(volatile avr32_spi_t *spi, const char *stream, uint16_t len)
 {
-	uint16_t _len = 0;
-	unsigned short dummy=0;
-
-     	do {
-            //SIGN1_DN();
-    		if (spi_write(spi, *stream) == SPI_ERROR_TIMEOUT)
-    		{
-#ifdef _SPI_STATS_
-    			statSpi.timeoutErr++;
-    			statSpi.txErr++;
-    			statSpi.lastError = SPI_ERROR_TIMEOUT;
-    			statSpi.status = spi_getStatus(spi);
-#endif
-    			return SPI_ERROR_TIMEOUT;
-    		}
-    		else
-    		{
-    			stream++;
-    			_len++;
-    			spi_read(spi,&dummy);
-    		}
-    		//SIGN1_UP();
-    }while (_len < len);
+	volatile avr32_pdca_channel_t *pdca_tx = &AVR32_PDCA.channel[ARD_PDCA_CH_TX];
+	volatile avr32_pdca_channel_t *pdca_rx = &AVR32_PDCA.channel[ARD_PDCA_CH_RX];
+	unsigned int timeout = SPI_TIMEOUT;
+	uint16_t left = len;
+
+	if (len > sizeof(_replySink))
+		return SPI_ERROR_ARGUMENT;
+
+	/* drop the byte that may be left from the command */
+	pdca_rx->CR.tdis = 1;
+	pdca_rx->IDR.rcz = 1;
+	(void)spi->rdr;
+
+	pdca_rx->mar = (U32) _replySink;
+	pdca_rx->PSR.pid = ARD_PDCA_PID_RX;
+	pdca_rx->tcr = len;
+	pdca_rx->tcrr = 0;
+	pdca_rx->MR.size = 0; /* 1-byte */
+
+	pdca_tx->mar = (U32) stream;
+	pdca_tx->PSR.pid = ARD_PDCA_PID_TX;
+	pdca_tx->tcr = len;
+	pdca_tx->tcrr = 0;
+	pdca_tx->MR.size = 0; /* 1-byte */
+
+	/* as in dma_txrx(), rx is started prior to tx */
+	pdca_rx->CR.ten = 1;
+	pdca_tx->CR.ten = 1;
+
+	/* the last byte is out once its counterpart came in */
+	while (!pdca_rx->ISR.trc)
+	{
+		if (pdca_rx->tcr != left)
+		{
+			left = pdca_rx->tcr;
+			timeout = SPI_TIMEOUT;
+		}
+		else if ((timeout--) == 0)
+		{
+			pdca_tx->CR.tdis = 1;
+			pdca_rx->CR.tdis = 1;
+			STATSPI_TX_TIMEOUT_ERROR();
+			return SPI_ERROR_TIMEOUT;
+		}
+	}
+	pdca_tx->CR.tdis = 1;
+	pdca_rx->CR.tdis = 1;
 	return SPI_OK;
 }
 
+/*
+ * Arms the PDCA to receive the next command into _receiveBuffer. The
+ * first byte is a transfer of its own, so its reload raises BUSY_FOR_SPI()
+ * right away; the end is left to the NSS rise.
+ */
+static void spi_recv_start(void)
+{
+	volatile avr32_spi_t *spi = ARD_SPI;
+	volatile avr32_pdca_channel_t *pdca_rx = &AVR32_PDCA.channel[ARD_PDCA_CH_RX];
+
+	pdca_rx->CR.tdis = 1;
+	/* drop a byte left over from the reply and the NSS rise that ended it */
+	(void)spi->rdr;
+	(void)spi->sr;
+
+	pdca_rx->mar = (U32) _receiveBuffer;
+	pdca_rx->PSR.pid = ARD_PDCA_PID_RX;
+	pdca_rx->tcr = 1;
+	pdca_rx->marr = (U32) &_receiveBuffer[1];
+	pdca_rx->tcrr = _BUFFERSIZE - 1;
+	pdca_rx->MR.size = 0; /* 1-byte */
+	pdca_rx->IER.rcz = 1;
+	pdca_rx->CR.ten = 1;
+}
+
 void sendError()
 {
 	AVAIL_FOR_SPI();
@@ -363,11 +563,12 @@ void sendError()
 	WARN("Send SPI error!\n");
 }
 
+/* A command ends when the AVR raises NSS */
 #define ENABLE_SPI_INT() do {										\
 	volatile avr32_spi_t *spi = ARD_SPI;							\
     Bool global_interrupt_enabled = Is_global_interrupt_enabled();	\
     if (global_interrupt_enabled) Disable_global_interrupt();		\
-    spi->IER.rdrf = 1; spi->IER.rxbuff = 1;	spi->IER.endrx = 1;		\
+    spi->ier = AVR32_SPI_IER_NSSR_MASK;								\
     if (global_interrupt_enabled) Enable_global_interrupt();		\
 }while(0);
 
@@ -375,7 +576,7 @@ void sendError()
 	volatile avr32_spi_t *spi = ARD_SPI;							\
     Bool global_interrupt_enabled = Is_global_interrupt_enabled();	\
     if (global_interrupt_enabled) Disable_global_interrupt();		\
-    spi->IDR.rdrf = 1; spi->IDR.rxbuff = 1;	spi->IDR.endrx = 1;										\
+    spi->idr = AVR32_SPI_IDR_NSSR_MASK;								\
     if (global_interrupt_enabled) Enable_global_interrupt();		\
 }while(0);
 
@@ -851,6 +1052,54 @@ int send_data_udp_cmd_cb(int numParam, char* buf, void* ctx) {
     return (err==WL_SUCCESS) ? WIFI_SPI_ACK : WIFI_SPI_ERR;
 }
 
+static uint8_t udpSent = 0;	// datagrams of the last SEND_DATAGRAMS_UDP_CMD
+
+// The UDP pcb of sock, of the client or else of the server
+static void* getUdpTTCP(uint8_t sock)
+{
+	ttcp_t* _ttcp = NULL;
+	if (sock >= MAX_SOCK_NUM)
+		return NULL;
+	_ttcp = (ttcp_t*)getTTCP(sock, TTCP_MODE_TRANSMIT);
+	if ((_ttcp == NULL) || (_ttcp->udp != UDP_MODE))
+		_ttcp = (ttcp_t*)getTTCP(sock, TTCP_MODE_RECEIVE);
+	if ((_ttcp == NULL) || (_ttcp->udp != UDP_MODE) || (_ttcp->upcb == NULL))
+		return NULL;
+	return _ttcp;
+}
+
+int send_datagrams_udp_cmd_cb(int numParam, char* buf, void* ctx) {
+	void* _ttcp = NULL;
+	uint16_t off = 0;
+	bool ok = true;
+
+	udpSent = 0;
+	tDataParam* msg = (tDataParam*) buf;
+    if ((numParam == 2)&&(msg->dataLen == 1))
+    {
+        GET_DATA_BYTE(sock, buf+2);
+        GET_DATA_INT(len, buf+3);
+        uint8_t* p = (uint8_t*)(buf+5);
+
+        _ttcp = getUdpTTCP(sock);
+        while ((_ttcp != NULL) && (off + UDP_ENTRY_HDR <= len))
+        {
+        	uint32_t ipaddr = ((uint32_t)p[off] << 24) | ((uint32_t)p[off+1] << 16) |
+        			((uint32_t)p[off+2] << 8) | p[off+3];
+        	uint16_t port = (p[off+4] << 8) | p[off+5];
+        	uint16_t n = (p[off+6] << 8) | p[off+7];
+        	off += UDP_ENTRY_HDR;
+        	if (off + n > len)
+        		break;
+        	if (sendUdpDataTo(_ttcp, p + off, n, ipaddr, port) == WL_SUCCESS)
+        		++udpSent;
+        	else
+        		ok = false;
+        	off += n;
+        }
+    }
+    return ((_ttcp != NULL) && ok) ? WIFI_SPI_ACK : WIFI_SPI_ERR;
+}
 
 int send_data_tcp_cmd_cb(int numParam, char* buf, void* ctx) {
 	wl_err_t err = WL_FAILURE;
@@ -1296,6 +1545,125 @@ cmd_spi_state_t get_client_state_tcp_cmd_cb(char* recv, char* reply, void* ctx,
     return SPI_CMD_DONE;
 }
 
+// Socket states as GET_SOCKETS_STATE_CMD last reported them
+static uint8_t sockState[MAX_SOCK_NUM][2];
+
+// State of the listening pcb of a server, or of the first connection of
+// a client, without making it the current connection as getStateTcp()
+// does
+static uint8_t getSockState(uint8_t sock, bool client)
+{
+	ttcp_t* _ttcp = (ttcp_t*)getTTCP(sock, client ? TTCP_MODE_TRANSMIT : TTCP_MODE_RECEIVE);
+	int i = 0;
+
+	if ((!ifStatus) || (_ttcp == NULL) || (_ttcp->udp != TCP_MODE))
+		return CLOSED;
+	if (!client)
+		return (_ttcp->lpcb != NULL) ? _ttcp->lpcb->state : CLOSED;
+	for (; i<MAX_CLIENT_ACCEPTED; ++i)
+	{
+		if (_ttcp->tpcb[i] != NULL)
+			return _ttcp->tpcb[i]->state;
+	}
+	return CLOSED;
+}
+
+// Drives the event line, from spi_poll()
+static void event_poll(void)
+{
+	bool event = false;
+	uint8_t i = 0;
+
+	for (; (i<MAX_SOCK_NUM) && !event; ++i)
+	{
+		event = (get_pBuf(i) != NULL) ||
+				(getSockState(i, false) != sockState[i][0]) ||
+				(getSockState(i, true) != sockState[i][1]);
+	}
+	if (event)
+		EVENT_FOR_SPI();
+	else
+		NO_EVENT_FOR_SPI();
+}
+
+cmd_spi_state_t get_sockets_state_cmd_cb(char* recv, char* reply, void* ctx, uint16_t* count) {
+
+	uint8_t i = 0;
+	int idx = 3;
+
+	CHECK_ARD_NETIF(recv, reply, count);
+
+	CREATE_HEADER_REPLY(reply, recv, PARAM_NUMS_3);
+
+	reply[idx++] = (MAX_SOCK_NUM + 7) / 8;
+	memset(&reply[idx], 0, (MAX_SOCK_NUM + 7) / 8);
+	for (i = 0; i<MAX_SOCK_NUM; ++i)
+	{
+		if (get_pBuf(i) != NULL)
+			reply[idx + i/8] |= 1 << (i%8);
+	}
+	idx += (MAX_SOCK_NUM + 7) / 8;
+
+	reply[idx++] = MAX_SOCK_NUM;
+	for (i = 0; i<MAX_SOCK_NUM; ++i)
+		reply[idx++] = sockState[i][0] = getSockState(i, false);
+
+	reply[idx++] = MAX_SOCK_NUM;
+	for (i = 0; i<MAX_SOCK_NUM; ++i)
+		reply[idx++] = sockState[i][1] = getSockState(i, true);
+
+	END_HEADER_REPLY(reply, idx, *count);
+	event_poll();
+
+    return SPI_CMD_DONE;
+}
+
+#ifdef _SPI_STATS_
+cmd_spi_state_t get_cmd_stats_cmd_cb(char* recv, char* reply, void* ctx, uint16_t* count) {
+
+	tStatCmd none = {0};
+	tStatCmd* s = &none;
+	int i;
+
+	GET_DATA_BYTE(cmdId, recv+4);
+	for (i = 0; i < MAX_CMD_NUM; i++)
+	{
+		if ((cmd_spi_list[i].cb != NULL) && (cmd_spi_list[i].cmd_id == cmdId))
+			s = &statCmd[i];
+	}
+
+	CREATE_HEADER_REPLY(reply, recv, PARAM_NUMS_4);
+	PUT_LONG_IN_BYTE_NO(s->count, reply, 3);
+	PUT_LONG_IN_BYTE_NO(cpu_cy_2_us(s->minCy, FCPU_HZ), reply, 8);
+	PUT_LONG_IN_BYTE_NO(statAvgUs(s), reply, 13);
+	PUT_LONG_IN_BYTE_NO(cpu_cy_2_us(s->maxCy, FCPU_HZ), reply, 18);
+	END_HEADER_REPLY(reply, 23, *count);
+
+    return SPI_CMD_DONE;
+}
+
+cmd_spi_state_t get_sock_stats_cmd_cb(char* recv, char* reply, void* ctx, uint16_t* count) {
+
+	uint32_t rx = 0, tx = 0;
+
+	GET_DATA_BYTE(sock, recv+4);
+	if (sock < MAX_SOCK_NUM)
+	{
+		rx = statSockRx[sock];
+		tx = statSockTx[sock];
+	}
+
+	CREATE_HEADER_REPLY(reply, recv, PARAM_NUMS_4);
+	PUT_LONG_IN_BYTE_NO(rx, reply, 3);
+	PUT_LONG_IN_BYTE_NO(tx, reply, 8);
+	PUT_LONG_IN_BYTE_NO(statRate(rx), reply, 13);
+	PUT_LONG_IN_BYTE_NO(statRate(tx), reply, 18);
+	END_HEADER_REPLY(reply, 23, *count);
+
+    return SPI_CMD_DONE;
+}
+#endif
+
 cmd_spi_state_t avail_data_tcp_cmd_cb(char* recv, char* reply, void* ctx, uint16_t* count) {
 
 	CHECK_ARD_NETIF(recv, reply, count);
@@ -1377,7 +1745,7 @@ cmd_spi_state_t get_databuf_tcp_cmd_cb(char* recv, char* reply, void* ctx, uint1
 
     CHECK_ARD_NETIF(recv, reply, count);
 
-    GET_DATA_BYTE(sock, buf+5);
+    GET_DATA_BYTE(sock, recv+5);
     if ((sock>=0)&&(sock<MAX_SOCK_NUM))
     {
     	if (getTcpData((uint8_t)sock, (void**)&data, &len))
@@ -1394,6 +1762,74 @@ cmd_spi_state_t get_databuf_tcp_cmd_cb(char* recv, char* reply, void* ctx, uint1
     return SPI_CMD_DONE;
 }
 
+// room for the header, the 16 bit length, END_CMD and the 0 after it
+#define DATABULK_MAX_LEN	(REPLY_MAX_LEN - 7)
+// in pipe mode, the whole reply (the data and the 6 bytes around it)
+// and its entry header have to fit one get_reply_pipe_replies_cb()
+#define DATABULK_PIPE_MAX_LEN	(DATABULK_MAX_LEN - PIPE_ENTRY_HDR - 6)
+
+cmd_spi_state_t get_databulk_tcp_cmd_cb(char* recv, char* reply, void* ctx, uint16_t* count) {
+
+	uint16_t len = 0;
+	uint16_t maxLen = DATABULK_MAX_LEN;
+
+    CHECK_ARD_NETIF(recv, reply, count);
+
+    GET_DATA_BYTE(sock, recv+5);
+    if ((recv[2] == PARAM_NUMS_2) && (recv[6] == 0) && (recv[7] == 2))
+    	maxLen = ((uint8_t)recv[8] << 8) | (uint8_t)recv[9];
+    if (maxLen > DATABULK_MAX_LEN)
+    	maxLen = DATABULK_MAX_LEN;
+    if (pipeMode && (maxLen > DATABULK_PIPE_MAX_LEN))
+    	maxLen = DATABULK_PIPE_MAX_LEN;
+
+    if (sock < MAX_SOCK_NUM)
+    	len = getTcpDataBuf(sock, (uint8_t*)&reply[5], maxLen);
+
+    if (len > 0)
+    {
+    	CREATE_HEADER_REPLY(reply, recv, PARAM_NUMS_1);
+    	reply[3] = (uint8_t)((len & 0xff00)>>8);
+    	reply[4] = (uint8_t)(len & 0xff);
+    	END_HEADER_REPLY(reply, 3+len+2, *count);
+    }else{
+    	CREATE_HEADER_REPLY(reply, recv, PARAM_NUMS_0);
+    	END_HEADER_REPLY(reply, 3, *count);
+    }
+    return SPI_CMD_DONE;
+}
+
+cmd_spi_state_t get_datagrams_udp_cmd_cb(char* recv, char* reply, void* ctx, uint16_t* count) {
+
+	uint16_t len = 0;
+	uint16_t maxLen = DATABULK_MAX_LEN;
+
+    CHECK_ARD_NETIF(recv, reply, count);
+
+    GET_DATA_BYTE(sock, recv+5);
+    if ((recv[2] == PARAM_NUMS_2) && (recv[6] == 0) && (recv[7] == 2))
+    	maxLen = ((uint8_t)recv[8] << 8) | (uint8_t)recv[9];
+    if (maxLen > DATABULK_MAX_LEN)
+    	maxLen = DATABULK_MAX_LEN;
+    if (pipeMode && (maxLen > DATABULK_PIPE_MAX_LEN))
+    	maxLen = DATABULK_PIPE_MAX_LEN;
+
+    if (getUdpTTCP(sock) != NULL)
+    	len = getUdpDatagrams(sock, (uint8_t*)&reply[5], maxLen);
+
+    if (len > 0)
+    {
+    	CREATE_HEADER_REPLY(reply, recv, PARAM_NUMS_1);
+    	reply[3] = (uint8_t)((len & 0xff00)>>8);
+    	reply[4] = (uint8_t)(len & 0xff);
+    	END_HEADER_REPLY(reply, 3+len+2, *count);
+    }else{
+    	CREATE_HEADER_REPLY(reply, recv, PARAM_NUMS_0);
+    	END_HEADER_REPLY(reply, 3, *count);
+    }
+    return SPI_CMD_DONE;
+}
+
 cmd_spi_state_t get_firmware_version_cmd_cb(char* recv, char* reply, void* ctx, uint16_t* count) {
 
     CHECK_ARD_NETIF(recv, reply, count);
@@ -1438,6 +1874,12 @@ int sendReply(int cmdIdx, char* recv, char* reply, void* resultCmd)
     int _result = SPI_OK;
 
     cmd_spi_list[cmdIdx].reply_cb(recv, reply, resultCmd, &_count);
+    if (pipeMode)
+    {
+    	// the reply stays where it was built until it is collected
+    	replyCount = _count;
+    	return SPI_OK;
+    }
     state = SPI_CMD_REPLING;
 
     AVAIL_FOR_SPI();
@@ -1488,7 +1930,7 @@ inline bool spiMsg8(uint8_t cmd)
 	return ((cmd & DATA_FLAG)==0);
 }
 
-int call_reply_cb(char* recv, char* reply) {
+static int exec_reply_cb(char* recv, char* reply) {
 
 //	// check the start of message
 //	//TODO CHECK if also the ,en must be resize
@@ -1561,42 +2003,155 @@ int call_reply_cb(char* recv, char* reply) {
 	return REPLY_NO_ERR;
 }
 
-void init_spi_cmds(void* ctx) {
-	spi_add_cmd(SET_NET_CMD, set_net_cmd_cb, ack_reply_cb, NULL, CMD_SET_FLAG);
-	spi_add_cmd(SET_PASSPHRASE_CMD, set_passphrase_cmd_cb, ack_reply_cb, NULL, CMD_SET_FLAG);
-	spi_add_cmd(SET_KEY_CMD, set_key_cmd_cb, ack_reply_cb, NULL, CMD_SET_FLAG);
-	spi_add_cmd(SET_IP_CONFIG_CMD, set_ip_config_cmd_cb, ack_reply_cb, ctx, CMD_SET_FLAG);
-	spi_add_cmd(SET_DNS_CONFIG_CMD, set_dns_config_cmd_cb, ack_reply_cb, ctx, CMD_SET_FLAG);
-	spi_add_cmd(GET_CONN_STATUS_CMD, get_result_cmd_cb, get_reply_cb, NULL, CMD_GET_FLAG);
-	spi_add_cmd(GET_IPADDR_CMD, ack_cmd_cb, get_reply_ipaddr_cb, NULL, CMD_GET_FLAG);
-	spi_add_cmd(GET_MACADDR_CMD, ack_cmd_cb, get_reply_mac_cb, NULL, CMD_GET_FLAG);
-	spi_add_cmd(GET_CURR_SSID_CMD, ack_cmd_cb, get_reply_curr_net_cb, (void*)GET_CURR_SSID_CMD, CMD_GET_FLAG);
-	spi_add_cmd(GET_CURR_BSSID_CMD, ack_cmd_cb, get_reply_curr_net_cb, (void*)GET_CURR_BSSID_CMD, CMD_GET_FLAG);
-	spi_add_cmd(GET_CURR_RSSI_CMD, ack_cmd_cb, get_reply_curr_net_cb, (void*)GET_CURR_RSSI_CMD, CMD_GET_FLAG);
-	spi_add_cmd(GET_CURR_ENCT_CMD, ack_cmd_cb, get_reply_curr_net_cb, (void*)GET_CURR_ENCT_CMD, CMD_GET_FLAG);
-	spi_add_cmd(START_SCAN_NETWORKS, start_scan_net_cmd_cb, ack_reply_cb, NULL, CMD_SET_FLAG);
-	spi_add_cmd(SCAN_NETWORKS, ack_cmd_cb, get_reply_scan_networks_cb, NULL, CMD_GET_FLAG);
-	spi_add_cmd(DISCONNECT_CMD, disconnect_cmd_cb, ack_reply_cb, NULL, CMD_SET_FLAG);
-	spi_add_cmd(GET_IDX_ENCT_CMD, ack_cmd_cb, get_reply_idx_net_cb, (void*)GET_IDX_ENCT_CMD, CMD_GET_FLAG);
-	spi_add_cmd(GET_IDX_SSID_CMD, ack_cmd_cb, get_reply_idx_net_cb, (void*)GET_IDX_SSID_CMD, CMD_GET_FLAG);
-	spi_add_cmd(GET_IDX_RSSI_CMD, ack_cmd_cb, get_reply_idx_net_cb, (void*)GET_IDX_RSSI_CMD, CMD_GET_FLAG);
-	spi_add_cmd(REQ_HOST_BY_NAME_CMD, req_reply_host_by_name_cb, ack_reply_cb, NULL, CMD_SET_FLAG);
-	spi_add_cmd(GET_HOST_BY_NAME_CMD, ack_cmd_cb, get_reply_host_by_name_cb, NULL, CMD_GET_FLAG);
-	spi_add_cmd(START_SERVER_TCP_CMD, start_server_tcp_cmd_cb, ack_reply_cb, NULL, CMD_SET_FLAG);
-	spi_add_cmd(START_CLIENT_TCP_CMD, start_client_tcp_cmd_cb, ack_reply_cb, NULL, CMD_SET_FLAG);
-	spi_add_cmd(STOP_CLIENT_TCP_CMD, stop_client_tcp_cmd_cb, ack_reply_cb, NULL, CMD_SET_FLAG);
-	spi_add_cmd(GET_STATE_TCP_CMD, ack_cmd_cb, get_state_tcp_cmd_cb, NULL, CMD_GET_FLAG);
-	spi_add_cmd(GET_DATA_TCP_CMD, ack_cmd_cb, get_data_tcp_cmd_cb, NULL, CMD_GET_FLAG);
-	spi_add_cmd(AVAIL_DATA_TCP_CMD, ack_cmd_cb, avail_data_tcp_cmd_cb, NULL, CMD_GET_FLAG);
-	spi_add_cmd(SEND_DATA_TCP_CMD, send_data_tcp_cmd_cb, ack_reply_cb, NULL, CMD_IMM_SET_FLAG);
-	spi_add_cmd(DATA_SENT_TCP_CMD, ack_cmd_cb, data_sent_tcp_cmd_cb, NULL, CMD_GET_FLAG);
-	spi_add_cmd(GET_DATABUF_TCP_CMD, ack_cmd_cb, get_databuf_tcp_cmd_cb, NULL, CMD_GET_FLAG);
-	spi_add_cmd(GET_CLIENT_STATE_TCP_CMD, ack_cmd_cb, get_client_state_tcp_cmd_cb, NULL, CMD_GET_FLAG);
-	spi_add_cmd(GET_FW_VERSION_CMD, ack_cmd_cb, get_firmware_version_cmd_cb, NULL, CMD_GET_FLAG);
-	spi_add_cmd(GET_TEST_CMD, ack_cmd_cb, get_test_cmd_cb, NULL, CMD_GET_FLAG);
-	spi_add_cmd(INSERT_DATABUF_CMD, insert_data_cmd_cb, ack_reply_cb, NULL, CMD_IMM_SET_FLAG);
-	spi_add_cmd(SEND_DATA_UDP_CMD, send_data_udp_cmd_cb, ack_reply_cb, NULL, CMD_SET_FLAG);
-	spi_add_cmd(GET_REMOTE_DATA_CMD, ack_cmd_cb, get_reply_remote_data_cb, NULL, CMD_GET_FLAG);
+int call_reply_cb(char* recv, char* reply) {
+#ifdef _SPI_STATS_
+	uint32_t start = Get_sys_count();
+	int err = exec_reply_cb(recv, reply);
+	statSpiCmd((unsigned char)recv[1], Get_sys_count() - start);
+	return err;
+#else
+	return exec_reply_cb(recv, reply);
+#endif
+}
+
+bool checkMsgFormat(uint8_t* _recv, int len, int* offset);
+
+int pipe_cmd_cb(int numParam, char* buf, void* ctx) {
+	int offset = 0;
+	pipeQueued = 0;
+	if ((numParam == 2) && (buf[0] == 0) && (buf[1] == 1))
+	{
+		GET_DATA_BYTE(seq, buf+2);
+		uint16_t len = ((uint8_t)buf[3] << 8) | (uint8_t)buf[4];
+		char* cmd = buf+5;
+		if ((pipeCount < PIPE_CMD_NUM) && (len <= _BUFFERSIZE) &&
+			(len > CMD_POS) && ((uint8_t)cmd[CMD_POS] != PIPE_CMD) &&
+			checkMsgFormat((uint8_t*)cmd, len, &offset) && (offset == 0))
+		{
+			uint8_t idx = (pipeHead + pipeCount) % PIPE_CMD_NUM;
+			pipeCmds[idx].seq = seq;
+			pipeCmds[idx].len = len;
+			memcpy(pipeCmds[idx].cmd, cmd, len);
+			++pipeCount;
+			pipeQueued = 1;
+		}
+	}
+	return WIFI_SPI_ACK;
+}
+
+cmd_spi_state_t get_reply_pipe_cb(char* recv, char* reply, void* ctx, uint16_t* count) {
+
+    CREATE_HEADER_REPLY(reply, recv, PARAM_NUMS_1);
+    PUT_DATA_BYTE(pipeQueued, reply, 3);
+    END_HEADER_REPLY(reply, 5, *count);
+
+    return SPI_CMD_DONE;
+}
+
+cmd_spi_state_t get_reply_pipe_replies_cb(char* recv, char* reply, void* ctx, uint16_t* count) {
+
+	uint16_t len = 0;
+
+	// whole entries only, oldest first
+	while (len + PIPE_ENTRY_HDR <= pipeRepliesLen)
+	{
+		uint16_t n = PIPE_ENTRY_HDR + (((uint8_t)pipeReplies[len+1] << 8) | (uint8_t)pipeReplies[len+2]);
+		if (len + n > DATABULK_MAX_LEN)
+			break;
+		len += n;
+	}
+	memcpy(&reply[5], pipeReplies, len);
+	pipeRepliesLen -= len;
+	memmove(pipeReplies, &pipeReplies[len], pipeRepliesLen);
+
+    CREATE_HEADER_REPLY(reply, recv, PARAM_NUMS_1);
+    reply[3] = (uint8_t)((len & 0xff00)>>8);
+    reply[4] = (uint8_t)(len & 0xff);
+    END_HEADER_REPLY(reply, 3+len+2, *count);
+
+    return SPI_CMD_DONE;
+}
+
+// Runs the oldest queued command if its reply is sure to fit
+static void pipe_poll(void)
+{
+	if ((pipeCount == 0) ||
+		(pipeRepliesLen + PIPE_ENTRY_HDR + REPLY_MAX_LEN > PIPE_REPLY_LEN))
+		return;
+
+	tPipeCmd* c = &pipeCmds[pipeHead];
+	char* entry = &pipeReplies[pipeRepliesLen];
+
+	replyCount = 0;
+	pipeMode = true;
+	if (call_reply_cb(c->cmd, entry + PIPE_ENTRY_HDR) != REPLY_NO_ERR)
+		WARN("Pipelined cmd 0x%x seq:%d failed\n", c->cmd[CMD_POS], c->seq);
+	pipeMode = false;
+
+	// an unknown command leaves an empty reply, as does one too long to
+	// be collected
+	if (PIPE_ENTRY_HDR + replyCount > DATABULK_MAX_LEN)
+		replyCount = 0;
+	entry[0] = c->seq;
+	entry[1] = (uint8_t)((replyCount & 0xff00)>>8);
+	entry[2] = (uint8_t)(replyCount & 0xff);
+	pipeRepliesLen += PIPE_ENTRY_HDR + replyCount;
+
+	pipeHead = (pipeHead + 1) % PIPE_CMD_NUM;
+	--pipeCount;
+}
+
+// Returns -1 if MAX_CMD_NUM is too small for all the commands
+int init_spi_cmds(void* ctx) {
+	int err = 0;
+
+	err |= spi_add_cmd(SET_NET_CMD, set_net_cmd_cb, ack_reply_cb, NULL, CMD_SET_FLAG);
+	err |= spi_add_cmd(SET_PASSPHRASE_CMD, set_passphrase_cmd_cb, ack_reply_cb, NULL, CMD_SET_FLAG);
+	err |= spi_add_cmd(SET_KEY_CMD, set_key_cmd_cb, ack_reply_cb, NULL, CMD_SET_FLAG);
+	err |= spi_add_cmd(SET_IP_CONFIG_CMD, set_ip_config_cmd_cb, ack_reply_cb, ctx, CMD_SET_FLAG);
+	err |= spi_add_cmd(SET_DNS_CONFIG_CMD, set_dns_config_cmd_cb, ack_reply_cb, ctx, CMD_SET_FLAG);
+	err |= spi_add_cmd(GET_CONN_STATUS_CMD, get_result_cmd_cb, get_reply_cb, NULL, CMD_GET_FLAG);
+	err |= spi_add_cmd(GET_IPADDR_CMD, ack_cmd_cb, get_reply_ipaddr_cb, NULL, CMD_GET_FLAG);
+	err |= spi_add_cmd(GET_MACADDR_CMD, ack_cmd_cb, get_reply_mac_cb, NULL, CMD_GET_FLAG);
+	err |= spi_add_cmd(GET_CURR_SSID_CMD, ack_cmd_cb, get_reply_curr_net_cb, (void*)GET_CURR_SSID_CMD, CMD_GET_FLAG);
+	err |= spi_add_cmd(GET_CURR_BSSID_CMD, ack_cmd_cb, get_reply_curr_net_cb, (void*)GET_CURR_BSSID_CMD, CMD_GET_FLAG);
+	err |= spi_add_cmd(GET_CURR_RSSI_CMD, ack_cmd_cb, get_reply_curr_net_cb, (void*)GET_CURR_RSSI_CMD, CMD_GET_FLAG);
+	err |= spi_add_cmd(GET_CURR_ENCT_CMD, ack_cmd_cb, get_reply_curr_net_cb, (void*)GET_CURR_ENCT_CMD, CMD_GET_FLAG);
+	err |= spi_add_cmd(START_SCAN_NETWORKS, start_scan_net_cmd_cb, ack_reply_cb, NULL, CMD_SET_FLAG);
+	err |= spi_add_cmd(SCAN_NETWORKS, ack_cmd_cb, get_reply_scan_networks_cb, NULL, CMD_GET_FLAG);
+	err |= spi_add_cmd(DISCONNECT_CMD, disconnect_cmd_cb, ack_reply_cb, NULL, CMD_SET_FLAG);
+	err |= spi_add_cmd(GET_IDX_ENCT_CMD, ack_cmd_cb, get_reply_idx_net_cb, (void*)GET_IDX_ENCT_CMD, CMD_GET_FLAG);
+	err |= spi_add_cmd(GET_IDX_SSID_CMD, ack_cmd_cb, get_reply_idx_net_cb, (void*)GET_IDX_SSID_CMD, CMD_GET_FLAG);
+	err |= spi_add_cmd(GET_IDX_RSSI_CMD, ack_cmd_cb, get_reply_idx_net_cb, (void*)GET_IDX_RSSI_CMD, CMD_GET_FLAG);
+	err |= spi_add_cmd(REQ_HOST_BY_NAME_CMD, req_reply_host_by_name_cb, ack_reply_cb, NULL, CMD_SET_FLAG);
+	err |= spi_add_cmd(GET_HOST_BY_NAME_CMD, ack_cmd_cb, get_reply_host_by_name_cb, NULL, CMD_GET_FLAG);
+	err |= spi_add_cmd(REQ_GET_HOST_BY_NAME_CMD, req_reply_host_by_name_cb, get_reply_host_by_name_cb, NULL, CMD_GET_FLAG);
+	err |= spi_add_cmd(START_SERVER_TCP_CMD, start_server_tcp_cmd_cb, ack_reply_cb, NULL, CMD_SET_FLAG);
+	err |= spi_add_cmd(START_CLIENT_TCP_CMD, start_client_tcp_cmd_cb, ack_reply_cb, NULL, CMD_SET_FLAG);
+	err |= spi_add_cmd(STOP_CLIENT_TCP_CMD, stop_client_tcp_cmd_cb, ack_reply_cb, NULL, CMD_SET_FLAG);
+	err |= spi_add_cmd(GET_STATE_TCP_CMD, ack_cmd_cb, get_state_tcp_cmd_cb, NULL, CMD_GET_FLAG);
+	err |= spi_add_cmd(GET_DATA_TCP_CMD, ack_cmd_cb, get_data_tcp_cmd_cb, NULL, CMD_GET_FLAG);
+	err |= spi_add_cmd(AVAIL_DATA_TCP_CMD, ack_cmd_cb, avail_data_tcp_cmd_cb, NULL, CMD_GET_FLAG);
+	err |= spi_add_cmd(SEND_DATA_TCP_CMD, send_data_tcp_cmd_cb, ack_reply_cb, NULL, CMD_IMM_SET_FLAG);
+	err |= spi_add_cmd(DATA_SENT_TCP_CMD, ack_cmd_cb, data_sent_tcp_cmd_cb, NULL, CMD_GET_FLAG);
+	err |= spi_add_cmd(GET_DATABUF_TCP_CMD, ack_cmd_cb, get_databuf_tcp_cmd_cb, NULL, CMD_GET_FLAG);
+	err |= spi_add_cmd(GET_DATABULK_TCP_CMD, ack_cmd_cb, get_databulk_tcp_cmd_cb, NULL, CMD_GET_FLAG);
+	err |= spi_add_cmd(PIPE_CMD, pipe_cmd_cb, get_reply_pipe_cb, NULL, CMD_GET_FLAG);
+	err |= spi_add_cmd(GET_PIPE_REPLIES_CMD, ack_cmd_cb, get_reply_pipe_replies_cb, NULL, CMD_GET_FLAG);
+	err |= spi_add_cmd(GET_SOCKETS_STATE_CMD, ack_cmd_cb, get_sockets_state_cmd_cb, NULL, CMD_GET_FLAG);
+	err |= spi_add_cmd(GET_CLIENT_STATE_TCP_CMD, ack_cmd_cb, get_client_state_tcp_cmd_cb, NULL, CMD_GET_FLAG);
+	err |= spi_add_cmd(GET_FW_VERSION_CMD, ack_cmd_cb, get_firmware_version_cmd_cb, NULL, CMD_GET_FLAG);
+	err |= spi_add_cmd(GET_TEST_CMD, ack_cmd_cb, get_test_cmd_cb, NULL, CMD_GET_FLAG);
+	err |= spi_add_cmd(INSERT_DATABUF_CMD, insert_data_cmd_cb, ack_reply_cb, NULL, CMD_IMM_SET_FLAG);
+	err |= spi_add_cmd(SEND_DATA_UDP_CMD, send_data_udp_cmd_cb, ack_reply_cb, NULL, CMD_SET_FLAG);
+	err |= spi_add_cmd(GET_REMOTE_DATA_CMD, ack_cmd_cb, get_reply_remote_data_cb, NULL, CMD_GET_FLAG);
+	err |= spi_add_cmd(GET_DATAGRAMS_UDP_CMD, ack_cmd_cb, get_datagrams_udp_cmd_cb, NULL, CMD_GET_FLAG);
+	err |= spi_add_cmd(SEND_DATAGRAMS_UDP_CMD, send_datagrams_udp_cmd_cb, get_reply_cb, &udpSent, CMD_GET_FLAG);
+#ifdef _SPI_STATS_
+	err |= spi_add_cmd(GET_CMD_STATS_CMD, ack_cmd_cb, get_cmd_stats_cmd_cb, NULL, CMD_GET_FLAG);
+	err |= spi_add_cmd(GET_SOCK_STATS_CMD, ack_cmd_cb, get_sock_stats_cmd_cb, NULL, CMD_GET_FLAG);
+#endif
+	return err;
 }
 
 
@@ -1676,6 +2231,12 @@ bool checkMsgFormat(uint8_t* _recv, int len, int* offset)
 //#define AVR32_USART_CSR_RXRDY_MASK                           0x00000001
 
 
+// Work spi_poll() has left without a new interrupt
+bool spi_pending(void)
+{
+	return startReply || (pipeCount > 0);
+}
+
 void spi_poll(struct netif* netif) {
 
     ard_netif = netif;
@@ -1687,21 +2248,21 @@ void spi_poll(struct netif* netif) {
 		DISABLE_SPI_INT();
 		if (checkMsgFormat(_receiveBuffer, receivedChars, &offset))
 		{
+			// the command is handled where it was received, the PDCA
+			// isn't armed again until after the reply
+			char* recv = (char*)&_receiveBuffer[offset];
 			state = SPI_CMD_INPROGRESS;
 			count = receivedChars-offset;
-			if (count >= CMD_MAX_LEN)
-				count = CMD_MAX_LEN;
-			memcpy(buf, &_receiveBuffer[offset], count);
 
-			//mark as buffer used
-			_receiveBuffer[0] = 0;
-
-			int err = call_reply_cb(buf, &reply[0]);
+			int err = call_reply_cb(recv, &reply[0]);
 			if (err != REPLY_NO_ERR)
 			{
-				DUMP_SPI(buf, count);
+				DUMP_SPI(recv, count);
 				DUMP_SPI(reply, replyCount);
 			}
+
+			//mark as buffer used
+			_receiveBuffer[0] = 0;
 			receivedChars = 0;
 			count = 0;
 			state = SPI_CMD_IDLE;
@@ -1718,10 +2279,14 @@ void spi_poll(struct netif* netif) {
 		}
 		CLEAR_SPI_INT();
 		//Enable Spi int to receive a new command
+		spi_recv_start();
 		ENABLE_SPI_INT();
 		//Available for receiving a new spi data
 	    AVAIL_FOR_SPI();
 	}
+	else
+		pipe_poll();
+	event_poll();
 
 #ifdef _SPI_STATS_
     if (statSpi.lastError != 0)
@@ -1732,83 +2297,19 @@ void spi_poll(struct netif* netif) {
 #endif
 }
 
-inline int spi_slaveReceiveInt(volatile avr32_spi_t *spi)
-{
-	receivedChars=0;
-	int index = 0;
-	int err = SPI_OK;
-	state = SPI_CMD_INPUT;
-	bool endOfFrame = false;
-
-	do {
-		unsigned int timeout = SPI_TIMEOUT;
-		err = SPI_OK;
-
-		while ((spi->sr & (AVR32_SPI_SR_RDRF_MASK | AVR32_SPI_SR_TXEMPTY_MASK)) !=
-				(AVR32_SPI_SR_RDRF_MASK | AVR32_SPI_SR_TXEMPTY_MASK)) {
-			if ((timeout--)==0) {
-				err=SPI_ERROR_TIMEOUT;
-				break;
-			}
-		}
-		//DEB_PIN_TG();
-		#if 0
-#ifdef _SPI_STATS_		
-		if (spi->sr & AVR32_SPI_SR_OVRES_MASK)
-		{
-			STATSPI_OVERRIDE_ERROR();
-		}
-#endif	
-#endif					
-		if (err == SPI_OK) {
-			_receiveBuffer[index] = (spi->rdr >> AVR32_SPI_RDR_RD_OFFSET) & 0x00ff;
-			DEB_PIN_UP(2);
-			if ((index==0) && (_receiveBuffer[index] != START_CMD))
-				DEB_PIN_TRIGGER();
-			++index;
-			++receivedChars;
-		}else{
-#ifdef _SPI_STATS_
-			STATSPI_TIMEOUT_ERROR();
+#if defined (__GNUC__)
+__attribute__((__interrupt__))
+#elif defined (__ICCAVR32__)
+__interrupt
 #endif
-			break;
-		}
-
-		/* break on buffer overflow */
-		if (receivedChars >= _BUFFERSIZE) {
-			err = SPI_ERROR_OVERRUN_AND_MODE_FAULT;
-			break;
-		}
+static void pdca_rx_int_handler(void)
+{
+	volatile avr32_pdca_channel_t *pdca_rx = &AVR32_PDCA.channel[ARD_PDCA_CH_RX];
 
-		if (_receiveBuffer[index - 1] == END_CMD)
-		{
-			int8_t numParams = 0;
-			int idx = PARAM_LEN_POS+1;
-			bool islen16bit = ((_receiveBuffer[CMD_POS] & DATA_FLAG) == DATA_FLAG);
-			if (index >= idx)
-			{
-				numParams = _receiveBuffer[PARAM_LEN_POS];					
-				while (((index-1) > idx)&&(numParams>0))
-				{
-					if (islen16bit)
-						idx += (_receiveBuffer[idx]<<8) + _receiveBuffer[idx+1]+2;
-					else
-						idx += _receiveBuffer[idx]+1;
-					--numParams;
-				}
-				if (((index-1) == idx) && (numParams == 0))
-					endOfFrame = true;
-			}
-			if (!endOfFrame){
-				WARN("Wrong termination index:%d nParam:%d idx:%d 16bit:%d\n", index, numParams, idx, islen16bit);
-				#ifdef _DEBUG_
-					dump((char*)_receiveBuffer, receivedChars); 
-					while(0);
-				#endif
-			}		
-		}
-	} while (!endOfFrame);
-	return err;
+	// the first byte of a command is in, what is left goes on from the
+	// reload registers: the AVR has to wait for the reply from now on
+	pdca_rx->IDR.rcz = 1;
+	BUSY_FOR_SPI();
 }
 
 #if defined (__GNUC__)
@@ -1819,22 +2320,35 @@ __interrupt
 static void spi_int_handler(void)
 {
 	volatile avr32_spi_t *spi = ARD_SPI;
+	volatile avr32_pdca_channel_t *pdca_rx = &AVR32_PDCA.channel[ARD_PDCA_CH_RX];
 	DEB_PIN_DN(2);
-	DISABLE_SPI_INT();
 
-	if ((spi->sr & AVR32_SPI_SR_RDRF_MASK) != 0)
+	if ((spi->sr & AVR32_SPI_SR_NSSR_MASK) != 0)
 	{
-		int err = spi_slaveReceiveInt(ARD_SPI);
-        if (err == SPI_OK)
-        {
-        	BUSY_FOR_SPI();
-        	startReply=true;
-        	++cmdCorr;
-        	//maintain disable interrupt to send the reply command
-        	return;
-        }
-   	}
-	ENABLE_SPI_INT();
+		int received = _BUFFERSIZE - pdca_rx->tcr - pdca_rx->tcrr;
+
+		// a rise without bytes is the end of the last reply
+		if (received == 0)
+			return;
+
+		if (_receiveBuffer[0] == START_CMD)
+		{
+			DISABLE_SPI_INT();
+			pdca_rx->CR.tdis = 1;
+			BUSY_FOR_SPI();
+			state = SPI_CMD_INPUT;
+			receivedChars = received;
+			startReply=true;
+			SET_PENDING_EVENT(EVENT_SPI);
+			++cmdCorr;
+			//maintain disable interrupt to send the reply command
+			return;
+		}
+		// stray bytes, wait for the next command
+		DEB_PIN_TRIGGER();
+		STATSPI_DISALIGN_ERROR();
+		spi_recv_start();
+	}
 }
 
 inline spi_status_t spi_read8(volatile avr32_spi_t *spi, unsigned char *data)
@@ -1943,20 +2457,22 @@ int initSpi(void* ctx)
 
     // Register the SPI interrupt handler to the interrupt controller.
     INTC_register_interrupt((__int_handler)(&spi_int_handler), AVR32_SPI0_IRQ, AVR32_INTC_INT0);
+    INTC_register_interrupt((__int_handler)(&pdca_rx_int_handler), ARD_PDCA_RX_IRQ, AVR32_INTC_INT0);
 
     // Enable all interrupts.
 	Enable_global_interrupt();
 
-    ENABLE_SPI_INT();
-
 	spi_enable(spi);
+
+	spi_recv_start();
+    ENABLE_SPI_INT();
 #ifdef _SPI_STATS_
 	initStatSpi();
 #endif
-	init_spi_cmds(ctx);
+	if (init_spi_cmds(ctx))
+		return -1;
 
 	memset(_receiveBuffer, 0, sizeof(_receiveBuffer));
-	memset(buf, 0, sizeof(buf));
 	memset(reply, 0, sizeof(reply));
 
 	initMapSockTcp();
@@ -63,6 +63,8 @@ void initExtInt();
 
 void spi_poll(struct netif* netif);
 
+bool spi_pending(void);
+
 int spi_slaveReceive(volatile avr32_spi_t *spi);
 
 void showTTCPstatus();
@@ -137,6 +137,9 @@ static err_t tcp_send_data_pcb(struct ttcp *ttcp, struct tcp_pcb *pcb) {
 	}else{
 		ttcp->buff_sent[id] = 1;
 		ttcp->left[id] -= len;
+		/* what is left goes out from the start of the payload next time */
+		if (ttcp->left[id] > 0)
+			memmove(ttcp->payload[id], ttcp->payload[id] + len, ttcp->left[id]);
 	}
 
 	return err;
@@ -283,8 +286,6 @@ static err_t atcp_recv_cb(void *arg, struct tcp_pcb *pcb, struct pbuf *p,
 
 	if (err == ERR_OK && p != NULL) {
 		DATA_LED_ON();
-		/* for print_stats() */
-		ttcp->recved += p->tot_len;
 
 		if ((ttcp->verbose)||(verboseDebug & INFO_TCP_FLAG)) {
 			INFO_TCP("len:%d\n",p->tot_len);
@@ -295,8 +296,14 @@ static err_t atcp_recv_cb(void *arg, struct tcp_pcb *pcb, struct pbuf *p,
 		uint8_t* pBufferStore = insert_pBuf(p, ttcp->sock, (void*) pcb);
 		INFO_TCP("sock:%d pcb:%p pbuf:%p err:%d bufStore:%p len:%d\n",
 				ttcp->sock, pcb, p, err, pBufferStore, p->tot_len);
-		pbuf_free(p);
 		DATA_LED_OFF();
+		// the buffers are shared by all sockets: if they ran out
+		// lwIP keeps p and tries again later
+		if (pBufferStore == NULL)
+			return ERR_MEM;
+		/* for print_stats(), once p is taken and won't come again */
+		ttcp->recved += p->tot_len;
+		pbuf_free(p);
 	}
 
 	/* p will be NULL when remote end is done */
@@ -617,8 +624,6 @@ static void audp_recv_cb(void *arg, struct udp_pcb *upcb, struct pbuf *p,
 		struct ip_addr *addr, u16_t port) {
 	struct ttcp* ttcp = arg;
 
-	/* for print_stats() */
-	ttcp->recved += p->tot_len;
 	DUMP(p->payload,p->tot_len);
 	if (ttcp->verbose) {
 		printk(".");
@@ -628,7 +633,11 @@ static void audp_recv_cb(void *arg, struct udp_pcb *upcb, struct pbuf *p,
 	}
 	INFO_TCP("UDP Insert %p sock:%d addr:%s port:%d\n", p, ttcp->sock,
 			ip2str(*addr), port);
-	insert_pBuf(p, ttcp->sock, (void*) upcb);
+	if (insert_pBuf(p, ttcp->sock, (void*) upcb) != NULL) {
+		/* for print_stats(), only what was stored */
+		ttcp->recved += p->tot_len;
+		setBufRemote(ttcp->sock, addr->addr, port);
+	}
 	setRemoteClient(ttcp->sock, addr->addr, port);
 
 	pbuf_free(p);
@@ -853,12 +862,33 @@ int sendTcpData(void* p, uint8_t* buf, uint16_t len)
 		if (pcb->state == ESTABLISHED || pcb->state == CLOSE_WAIT ||
 			pcb->state == SYN_SENT || pcb->state == SYN_RCVD) {
 
-		memcpy(_ttcp->payload[id], buf, len);
-		_ttcp->payload[id][len]='\0';
-		INFO_TCP_VER("'%s'\n", _ttcp->payload[id]);
-		_ttcp->left[id] = len;
+		/* lwIP copies what fits in the send buffer straight from the
+		 * SPI command; only the rest waits in the payload for
+		 * tcp_send_data_pcb() */
+		uint16_t now = len;
+		err_t err = ERR_OK;
+		if (now > tcp_sndbuf(pcb))
+			now = tcp_sndbuf(pcb);
+		if (len - now > _ttcp->buflen)
+			return WL_FAILURE;
+
 		tcp_sent(pcb, tcp_data_sent);
-		tcp_send_data_pcb(_ttcp, pcb);
+		IF_TCP(startTime = timer_get_ms());
+		if (now > 0)
+			err = tcp_write(pcb, buf, now, TCP_WRITE_FLAG_COPY);
+		if (err != ERR_OK)
+		{
+			INFO_TCP("tcp_write failed %p state:%d len:%d err:%d\n",
+					pcb, pcb->state, now, err);
+			now = 0;
+			if (len > _ttcp->buflen)
+				return WL_FAILURE;
+		}
+		_ttcp->buff_sent[id] = (now > 0);
+		_ttcp->left[id] = len - now;
+		if (_ttcp->left[id] > 0)
+			memcpy(_ttcp->payload[id], buf + now, _ttcp->left[id]);
+		STATSPI_SOCK_TX(_ttcp->sock, len);
 
 		return WL_SUCCESS;
 		}
@@ -868,7 +898,15 @@ int sendTcpData(void* p, uint8_t* buf, uint16_t len)
 }
 
 int sendUdpData(void* ttcp, uint8_t* buf, uint16_t len) {
+	return sendUdpDataTo(ttcp, buf, len, 0, 0);
+}
+
+/**
+ * Sends buf to ipaddr:port, or to the connected remote if ipaddr is 0.
+ */
+int sendUdpDataTo(void* ttcp, uint8_t* buf, uint16_t len, uint32_t ipaddr, uint16_t port) {
 	struct ttcp* _ttcp = (struct ttcp*) ttcp;
+	err_t err = ERR_OK;
 	if ((_ttcp != NULL) && (buf != NULL) && (len != 0))
 	{
 		INFO_TCP("buf:%p len:%d\n", buf, len);
@@ -883,13 +921,20 @@ int sendUdpData(void* ttcp, uint8_t* buf, uint16_t len) {
 		return WL_FAILURE;
 	}
 	memcpy(p->payload, buf, len);
-	if (udp_send(_ttcp->upcb, p) != ERR_OK) {
+	if (ipaddr != 0) {
+		struct ip_addr dest = { ipaddr };
+		err = udp_sendto(_ttcp->upcb, p, &dest, port);
+	} else {
+		err = udp_send(_ttcp->upcb, p);
+	}
+	if (err != ERR_OK) {
 		WARN("TTCP [%p]: udp_send() failed\n", _ttcp);
 		pbuf_free(p);
 		return WL_FAILURE;
 	}
 
 	pbuf_free(p);
+	STATSPI_SOCK_TX(_ttcp->sock, len);
 	return WL_SUCCESS;
 }
 
@@ -10,6 +10,7 @@
 
 #include "console.h"
 #include "lwip/tcp.h"
+#include "wl_definitions.h"
 
 typedef void (ard_tcp_done_cb_t)(void *opaque, int result);
 
@@ -21,8 +22,6 @@ typedef void (ard_tcp_done_cb_t)(void *opaque, int result);
 #define IS_VALID_SOCK(SOCK) ((SOCK>=0)&&(SOCK<MAX_SOCK_NUM))
 #define IS_UDP_SOCK(SOCK)	((getTTCP(SOCK, TTCP_MODE_RECEIVE)!=NULL)?((struct ttcp*)(getTTCP(SOCK, TTCP_MODE_RECEIVE)))->udp:0)
 
-// Maximum number of client connection accepted by server
-#define MAX_CLIENT_ACCEPTED			4
 #define NO_VALID_ID					0xff
 
 #define GET_FIRST_CLIENT_TCP(TTCP)		getFirstClient(TTCP, 1)
@@ -101,6 +100,8 @@ int sendTcpData(void* p, uint8_t* buf, uint16_t len);
 
 int sendUdpData(void* p, uint8_t* buf, uint16_t len);
 
+int sendUdpDataTo(void* p, uint8_t* buf, uint16_t len, uint32_t ipaddr, uint16_t port);
+
 uint8_t isDataSent(void* p );
 
 cmd_state_t cmd_ttcp(int argc, char* argv[], void* ctx);
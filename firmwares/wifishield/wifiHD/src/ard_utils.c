@@ -13,19 +13,53 @@
 #include "ard_spi.h"
 #include "ard_tcp.h"
 
-#define MAX_PBUF_STORED	30
+/*
+ * The received buffers of all sockets come from one pool of slots. Each
+ * socket queues its own from firstBuf (the oldest, read first) to
+ * lastBuf through tData.next; the unused slots are chained from
+ * freeBuf. Adding and taking a buffer never has to search.
+ */
+#ifndef MAX_PBUF_STORED
+#define MAX_PBUF_STORED	64
+#endif
+#define NO_BUF			0xff
 
-tData pBufStore[MAX_PBUF_STORED][MAX_SOCK_NUM];
+tData pBufStore[MAX_PBUF_STORED];
 
-unsigned char headBuf[MAX_SOCK_NUM] = {0};
-unsigned char tailBuf[MAX_SOCK_NUM] = {0};
+static unsigned char freeBuf = NO_BUF;
+static unsigned char firstBuf[MAX_SOCK_NUM];
+static unsigned char lastBuf[MAX_SOCK_NUM];
 
-#define IS_BUF_AVAIL(x) (tailBuf[x] != headBuf[x])
-#define IS_BUF_EMPTY(x) ((tailBuf[x] == 0) && (headBuf[x] == 0))
+#define IS_BUF_AVAIL(x) (firstBuf[x] != NO_BUF)
 
 void init_pBuf()
 {
+	int i = 0;
 	memset(pBufStore, 0, sizeof(pBufStore));
+	for (; i<MAX_PBUF_STORED; ++i)
+		pBufStore[i].next = (i+1 < MAX_PBUF_STORED) ? i+1 : NO_BUF;
+	freeBuf = 0;
+	memset(firstBuf, NO_BUF, sizeof(firstBuf));
+	memset(lastBuf, NO_BUF, sizeof(lastBuf));
+}
+
+// Takes a slot from the pool and queues it behind the others of sock
+static tData* newBuf(uint8_t sock)
+{
+	unsigned char index = freeBuf;
+	if (index == NO_BUF)
+	{
+		WARN("No free buffer for sock:%d\n", sock);
+		return NULL;
+	}
+	freeBuf = pBufStore[index].next;
+	pBufStore[index].next = NO_BUF;
+	if (lastBuf[sock] == NO_BUF)
+		firstBuf[sock] = index;
+	else
+		pBufStore[lastBuf[sock]].next = index;
+	lastBuf[sock] = index;
+	return &pBufStore[index];
 }
 
 uint8_t* insertBuf(uint8_t sock, uint8_t* buf, uint16_t len)
@@ -36,34 +70,21 @@ uint8_t* insertBuf(uint8_t sock, uint8_t* buf, uint16_t len)
 		WARN("Sock out of range: sock=%d", sock);
 		return NULL;
 	}		
-	if (pBufStore[headBuf[sock]][sock].data != NULL)
-	{
-		WARN("Overwriting buffer %p idx:%d!\n", pBufStore[headBuf[sock]][sock].data, headBuf[sock]);
-		// to avoid memory leak free the oldest buffer
-		freetDataIdx(headBuf[sock], sock);
-	}
 
 	u8_t* p = (u8_t*)calloc(len,sizeof(u8_t));
     if(p != NULL) {
+    	tData* d = newBuf(sock);
+    	if (d == NULL) {
+    		free(p);
+    		return NULL;
+    	}
     	memcpy(p, buf, len);
 
-    	pBufStore[headBuf[sock]][sock].data = p;
-    	pBufStore[headBuf[sock]][sock].len = len;
-    	pBufStore[headBuf[sock]][sock].idx = 0;
-    	pBufStore[headBuf[sock]][sock].pcb = getTTCP(sock, TTCP_MODE_TRANSMIT);
-    	headBuf[sock]++;
-
-    	if (headBuf[sock] == MAX_PBUF_STORED)
-    		headBuf[sock] = 0;
-    	if (headBuf[sock] == tailBuf[sock])
-    	{
-    		WARN("Avoid to Overwrite data [%d-%d]!\n", headBuf[sock], tailBuf[sock]);
-    		if (headBuf[sock] != 0)
-    			--headBuf[sock];
-    		else
-    			headBuf[sock] = MAX_PBUF_STORED-1;
-    	}
-    	INFO_UTIL("Insert[%d]: %p:%d-%d [%d,%d]\n", sock, p, len, p[0], headBuf[sock], tailBuf[sock]);
+    	d->data = p;
+    	d->len = len;
+    	d->idx = 0;
+    	d->pcb = getTTCP(sock, TTCP_MODE_TRANSMIT);
+    	INFO_UTIL("Insert[%d]: %p:%d-%d [%d,%d]\n", sock, p, len, p[0], firstBuf[sock], lastBuf[sock]);
     }
     return p;
 }
@@ -73,36 +94,21 @@ uint16_t calcMergeLen(uint8_t sock)
 {
 	uint16_t len = 0;
 
-	unsigned char index = tailBuf[sock];
-	do {
-	if (pBufStore[index][sock].data != NULL)
+	unsigned char index = firstBuf[sock];
+	for (; index != NO_BUF; index = pBufStore[index].next)
 	{
-		len += pBufStore[index][sock].len;
-		len -= pBufStore[index][sock].idx;
-		INFO_UTIL_VER(" [%d]: len:%d idx:%d tot:%d\n", sock, pBufStore[index][sock].len, pBufStore[index][sock].idx, len);
+		len += pBufStore[index].len;
+		len -= pBufStore[index].idx;
+		INFO_UTIL_VER(" [%d]: len:%d idx:%d tot:%d\n", sock, pBufStore[index].len, pBufStore[index].idx, len);
 	}
-	++index;
-	if (index == MAX_PBUF_STORED)
-		index = 0;
-	}while (index!=headBuf[sock]);
 	return len;
 }
 
 uint16_t clearBuf(uint8_t sock)
 {
-	uint16_t len = 0;
+	uint16_t len = calcMergeLen(sock);
 
-	unsigned char index = tailBuf[sock];
-	do {
-	if (pBufStore[index][sock].data != NULL)
-	{
-		freetDataIdx(index,sock);
-	}
-	++index;
-	if (index == MAX_PBUF_STORED)
-		index = 0;
-	}while (index!=headBuf[sock]);
-	tailBuf[sock]=index;
+	freeAllTcpData(sock);
 	return len;
 }
 
@@ -112,17 +118,13 @@ uint8_t* mergeBuf(uint8_t sock, uint8_t** buf, uint16_t* _len)
 	uint8_t* p = (u8_t*)calloc(len,sizeof(u8_t));
 	uint8_t* _p = p;
 	if(p != NULL) {
-		unsigned char index = tailBuf[sock];
-		do {
-		if (pBufStore[index][sock].data != NULL)
+		unsigned char index = firstBuf[sock];
+		for (; index != NO_BUF; index = pBufStore[index].next)
 		{
-			memcpy(p, pBufStore[index][sock].data, pBufStore[index][sock].len);
-			p += pBufStore[index][sock].len;
+			uint16_t n = pBufStore[index].len - pBufStore[index].idx;
+			memcpy(p, pBufStore[index].data + pBufStore[index].idx, n);
+			p += n;
 		}
-		++index;
-		if (index == MAX_PBUF_STORED)
-			index = 0;
-		}while (index!=headBuf[sock]);
 	}
 	DUMP(_p,len);
 	if (buf != NULL)
@@ -134,16 +136,9 @@ uint8_t* mergeBuf(uint8_t sock, uint8_t** buf, uint16_t* _len)
 
 uint8_t* insert_pBuf(struct pbuf* q, uint8_t sock, void* _pcb)
 {
-	if (q == NULL)
+	if ((q == NULL)||(sock >= MAX_SOCK_NUM))
 		return NULL;
 
-	if (pBufStore[headBuf[sock]][sock].data != NULL)
-	{
-		WARN("Overwriting buffer %p idx:%d!\n", pBufStore[headBuf[sock]][sock].data, headBuf[sock]);
-		// to avoid memory leak free the oldest buffer
-		freetDataIdx(headBuf[sock], sock);
-	}
-
 	u8_t* p = (u8_t*)calloc(q->tot_len,sizeof(u8_t));
     if(p != NULL) {
       if (pbuf_copy_partial(q, p, q->tot_len,0) != q->tot_len) {
@@ -153,57 +148,43 @@ uint8_t* insert_pBuf(struct pbuf* q, uint8_t sock, void* _pcb)
     	  return p;
       }
 
-      pBufStore[headBuf[sock]][sock].data = p;
-      pBufStore[headBuf[sock]][sock].len = q->tot_len;
-      pBufStore[headBuf[sock]][sock].idx = 0;
-      pBufStore[headBuf[sock]][sock].pcb = _pcb;
-      headBuf[sock]++;
-
-  	  if (headBuf[sock] == MAX_PBUF_STORED)
-  		headBuf[sock] = 0;
-  	  if (headBuf[sock] == tailBuf[sock])
-  	  {
-  		  WARN("Avoid to Overwrite data [%d-%d]!\n", headBuf[sock], tailBuf[sock]);
-  		  if (headBuf[sock] != 0)
-  			  --headBuf[sock];
-  		  else
-  			  headBuf[sock] = MAX_PBUF_STORED-1;
-  	  }
-  	  INFO_UTIL("Insert[%d]: %p:%d-%d [%d,%d]\n", sock, p, q->tot_len, p[0], headBuf[sock], tailBuf[sock]);
+      tData* d = newBuf(sock);
+      if (d == NULL) {
+    	  free(p);
+    	  return NULL;
+      }
+      d->data = p;
+      d->len = q->tot_len;
+      d->idx = 0;
+      d->pcb = _pcb;
+      STATSPI_SOCK_RX(sock, q->tot_len);
+  	  INFO_UTIL("Insert[%d]: %p:%d-%d [%d,%d]\n", sock, p, q->tot_len, p[0], firstBuf[sock], lastBuf[sock]);
     }
     return p;
 }
 
 void dumpPbuf(uint8_t sock)
 {
-	unsigned char index = tailBuf[sock];
-	printk("headBuf=%d tailBuf=%d\n", headBuf[sock], tailBuf[sock]);
-	do {
-	if (pBufStore[index][sock].data != NULL)
+	unsigned char index = firstBuf[sock];
+	printk("firstBuf=%d lastBuf=%d freeBuf=%d\n", firstBuf[sock], lastBuf[sock], freeBuf);
+	for (; index != NO_BUF; index = pBufStore[index].next)
 	{
-		printk("%d] pcb:%p Buf: %p Len:%d\n", pBufStore[index][sock].idx, pBufStore[index][sock].pcb, 
-			pBufStore[index][sock].data, pBufStore[index][sock].len);
+		printk("%d] pcb:%p Buf: %p Len:%d\n", pBufStore[index].idx, pBufStore[index].pcb, 
+			pBufStore[index].data, pBufStore[index].len);
 	}
-	++index;
-	if (index == MAX_PBUF_STORED)
-		index = 0;
-	}while (index!=headBuf[sock]);
 }
 
 tData* get_pBuf(uint8_t sock)
 {
-	if (IS_BUF_EMPTY(sock))
+	if ((sock >= MAX_SOCK_NUM)||(!IS_BUF_AVAIL(sock)))
 		return NULL;
 
-	if (IS_BUF_AVAIL(sock))
-	{
-		tData* p = &(pBufStore[tailBuf[sock]][sock]);
-		INFO_UTIL_VER("%p [%d,%d]\n", p, headBuf[sock], tailBuf[sock]);
-		return p;
-	}
-	return NULL;
+	tData* p = &(pBufStore[firstBuf[sock]]);
+	INFO_UTIL_VER("%p [%d,%d]\n", p, firstBuf[sock], lastBuf[sock]);
+	return p;
 }
 
+// Frees the oldest buffer of sock, which holds buf, and gives its slot back
 void freetData(void * buf, uint8_t sock)
 {
 	if (buf==NULL)
@@ -212,35 +193,25 @@ void freetData(void * buf, uint8_t sock)
 		return;
 	}
 
-    pBufStore[tailBuf[sock]][sock].data = NULL;
-    pBufStore[tailBuf[sock]][sock].len = 0;
-    pBufStore[tailBuf[sock]][sock].idx = 0;
-    pBufStore[tailBuf[sock]][sock].pcb = 0;
-
-	if (++tailBuf[sock] == MAX_PBUF_STORED)
-		tailBuf[sock] = 0;
-	INFO_UTIL("%p [%d,%d]\n", buf, headBuf[sock], tailBuf[sock]);
-	free(buf);
-}
-
-void freetDataIdx(uint8_t idxBuf, uint8_t sock)
-{
-	if (idxBuf >=MAX_PBUF_STORED)
-	{
-		WARN("idxBuf out of range: %d\n", idxBuf);
+	unsigned char index = firstBuf[sock];
+	if (index == NO_BUF)
 		return;
-	}
 
-	void * buf = pBufStore[idxBuf][sock].data;
+	firstBuf[sock] = pBufStore[index].next;
+	if (firstBuf[sock] == NO_BUF)
+		lastBuf[sock] = NO_BUF;
 
-	INFO_UTIL("%p idx:%d\n", buf, idxBuf);
+    pBufStore[index].data = NULL;
+    pBufStore[index].len = 0;
+    pBufStore[index].idx = 0;
+    pBufStore[index].pcb = 0;
+    pBufStore[index].remoteIp = 0;
+    pBufStore[index].remotePort = 0;
+    pBufStore[index].next = freeBuf;
+    freeBuf = index;
 
+	INFO_UTIL("%p [%d,%d]\n", buf, firstBuf[sock], lastBuf[sock]);
 	free(buf);
-
-    pBufStore[idxBuf][sock].data = 0;
-    pBufStore[idxBuf][sock].len = 0;
-    pBufStore[idxBuf][sock].idx = 0;
-    pBufStore[idxBuf][sock].pcb = 0;
 }
 
 
@@ -265,8 +236,8 @@ bool isAvailTcpDataByte(uint8_t sock)
 		INFO_UTIL_VER("check:%d %d %p\n",p->idx, p->len, p->data);
 		if (p->idx == p->len)
 		{
-			INFO_UTIL("Free %p other buf %d tail:%d head:%d\n",
-					p->data, IS_BUF_AVAIL(sock), tailBuf[sock], headBuf[sock]);
+			INFO_UTIL("Free %p other buf %d first:%d last:%d\n",
+					p->data, IS_BUF_AVAIL(sock), firstBuf[sock], lastBuf[sock]);
 			ackAndFreeData(p->pcb, p->len, sock, p->data);						
 			return (IS_BUF_AVAIL(sock));
 		}else{
@@ -309,6 +280,77 @@ bool getTcpDataByte(uint8_t sock, uint8_t* payload, uint8_t peek)
 	return false;
 }
 
+/*
+ * Copies up to maxLen bytes into dst, going on through as many of the
+ * stored buffers as it takes, and acks and frees each one that is used
+ * up on the way. Returns the number of bytes copied.
+ */
+uint16_t getTcpDataBuf(uint8_t sock, uint8_t* dst, uint16_t maxLen)
+{
+	uint16_t len = 0;
+	tData* p = NULL;
+
+	while ((len < maxLen) && ((p = get_pBuf(sock)) != NULL))
+	{
+		uint16_t n = p->len - p->idx;
+		if (n > maxLen - len)
+			n = maxLen - len;
+		memcpy(dst + len, p->data + p->idx, n);
+		p->idx += n;
+		len += n;
+		INFO_UTIL_VER("bulk:%d %p %d\n", p->idx, p->data, len);
+		if (p->idx == p->len)
+			ackAndFreeData(p->pcb, p->len, sock, p->data);
+	}
+	return len;
+}
+
+// Records where the datagram inserted last for sock came from
+void setBufRemote(uint8_t sock, uint32_t ipaddr, uint16_t port)
+{
+	if ((sock < MAX_SOCK_NUM) && (lastBuf[sock] != NO_BUF))
+	{
+		pBufStore[lastBuf[sock]].remoteIp = ipaddr;
+		pBufStore[lastBuf[sock]].remotePort = port;
+	}
+}
+
+/*
+ * Copies as many whole datagrams as fit in maxLen bytes into dst, each
+ * behind a UDP_ENTRY_HDR header with its source and length, and frees
+ * them. A datagram that does not fit even alone is cut short, as
+ * recvfrom() would do.
+ */
+uint16_t getUdpDatagrams(uint8_t sock, uint8_t* dst, uint16_t maxLen)
+{
+	uint16_t len = 0;
+	tData* p = NULL;
+
+	while ((p = get_pBuf(sock)) != NULL)
+	{
+		uint16_t n = p->len - p->idx;
+		if (len + UDP_ENTRY_HDR + n > maxLen)
+		{
+			if ((len > 0) || (maxLen <= UDP_ENTRY_HDR))
+				break;
+			n = maxLen - UDP_ENTRY_HDR;
+		}
+		dst[len++] = (uint8_t)((p->remoteIp & 0xff000000)>>24);
+		dst[len++] = (uint8_t)((p->remoteIp & 0xff0000)>>16);
+		dst[len++] = (uint8_t)((p->remoteIp & 0xff00)>>8);
+		dst[len++] = (uint8_t)(p->remoteIp & 0xff);
+		dst[len++] = (uint8_t)((p->remotePort & 0xff00)>>8);
+		dst[len++] = (uint8_t)(p->remotePort & 0xff);
+		dst[len++] = (uint8_t)((n & 0xff00)>>8);
+		dst[len++] = (uint8_t)(n & 0xff);
+		memcpy(dst + len, p->data + p->idx, n);
+		len += n;
+		INFO_UTIL_VER("datagram:%d %p %d\n", n, p->data, len);
+		ackAndFreeData(p->pcb, p->len, sock, p->data);
+	}
+	return len;
+}
+
 bool getTcpData(uint8_t sock, void** payload, uint16_t* len)
 {
 	tData* p = NULL;
@@ -14,6 +14,10 @@
 #define INIT_SIGNAL_FOR_SPI() 	gpio_disable_pin_pull_up(ARDUINO_HANDSHAKE_PIN);
 #define BUSY_FOR_SPI() 			gpio_set_gpio_pin(ARDUINO_HANDSHAKE_PIN)
 #define AVAIL_FOR_SPI() 		gpio_clr_gpio_pin(ARDUINO_HANDSHAKE_PIN)
+// High while a socket has data to read or changed state since the last
+// GET_SOCKETS_STATE_CMD, so the AVR only has to ask then
+#define EVENT_FOR_SPI() 		gpio_set_gpio_pin(ARDUINO_EXTINT_PIN)
+#define NO_EVENT_FOR_SPI() 		gpio_clr_gpio_pin(ARDUINO_EXTINT_PIN)
 
 #define LED0_UP() 				gpio_set_gpio_pin(LED0_GPIO)
 #define LED0_DN() 				gpio_clr_gpio_pin(LED0_GPIO)
@@ -234,11 +238,19 @@
 		statSpi.txErr++;			\
 		statSpi.lastError = SPI_ERROR_TIMEOUT;	\
 		statSpi.status = spi_getStatus(ARD_SPI);
+
+void statSpiSock(uint8_t sock, uint16_t rx, uint16_t tx);
+
+// bytes a socket received from or sent to the network
+#define STATSPI_SOCK_RX(SOCK, LEN)	statSpiSock(SOCK, LEN, 0)
+#define STATSPI_SOCK_TX(SOCK, LEN)	statSpiSock(SOCK, 0, LEN)
 #else
 #define STATSPI_TIMEOUT_ERROR()
 #define STATSPI_TX_TIMEOUT_ERROR()
 #define STATSPI_DISALIGN_ERROR()
 #define STATSPI_OVERRIDE_ERROR()
+#define STATSPI_SOCK_RX(SOCK, LEN)
+#define STATSPI_SOCK_TX(SOCK, LEN)
 #endif
 
 #define DUMP_TCP_STATE(TTCP) do {\
@@ -258,8 +270,15 @@ typedef struct sData
 	uint16_t	len;
 	uint16_t	idx;
 	void* 	pcb;
+	uint32_t	remoteIp;	// source of a UDP datagram
+	uint16_t	remotePort;
+	uint8_t		next;	// next slot in the queue of the socket
 }tData;
 
+// remote ip, remote port and len in front of each datagram of
+// getUdpDatagrams() and SEND_DATAGRAMS_UDP_CMD
+#define UDP_ENTRY_HDR	8
+
 struct pbuf;
 
 void init_pBuf();
@@ -276,14 +295,18 @@ tData* get_pBuf(uint8_t sock);
 
 void freetData(void * buf, uint8_t sock);
 
-void freetDataIdx(uint8_t idxBuf, uint8_t sock);
-
 bool isBufAvail();
 
 bool getTcpData(uint8_t sock, void** payload, uint16_t* len);
 
 bool getTcpDataByte(uint8_t sock, uint8_t* payload, uint8_t peek);
 
+uint16_t getTcpDataBuf(uint8_t sock, uint8_t* dst, uint16_t maxLen);
+
+void setBufRemote(uint8_t sock, uint32_t ipaddr, uint16_t port);
+
+uint16_t getUdpDatagrams(uint8_t sock, uint8_t* dst, uint16_t maxLen);
+
 uint16_t getAvailTcpDataByte(uint8_t sock);
 
 bool isAvailTcpDataByte(uint8_t sock);
@@ -33,6 +33,7 @@
 #include <wl_spi.h>
 #include <printf-stdarg.h>
 #include <board_init.h>
+#include <timer.h>
 
 #define ARRAY_SIZE(a) sizeof(a) / sizeof(a[0])
 
@@ -388,6 +389,7 @@ __attribute__((__interrupt__)) void avr32_irq_handler(void)
         if (gpio_get_pin_interrupt_flag(WL_IRQ_PIN)) {
 		gpio_clear_pin_interrupt_flag(WL_IRQ_PIN);
                 wl_spi_irq();
+                SET_PENDING_EVENT(EVENT_WIFI);
 	}
 #endif
 
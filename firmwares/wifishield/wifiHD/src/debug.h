@@ -12,6 +12,7 @@
 
 #include <stdio.h>
 #include <string.h>
+#include "dlog.h"
 
 #define INFO_INIT_FLAG 	1
 #define INFO_TCP_FLAG 	2
@@ -85,7 +86,13 @@ extern uint16_t pollDebug;
 		CHECK_DUMP_DEBUG(LEVEL, INFO_FLAG)		\
 		CHECK_POLL_DEBUG(LEVEL, INFO_FLAG)
 
-#ifdef _INFO_DEBUG_
+#if defined(_INFO_DEBUG_) && defined(_DLOG_)
+// Only recorded here, dlog_flush() prints them from the main loop
+#define PRINT_DEBUG(msg, args...) 	dlog_put("[%s] ", __func__, msg, ##args)
+#define INFO_DEBUG(msg, args...) 	dlog_put("I-[%s] ", __func__, msg, ##args)
+#define WARN_DEBUG(msg, args...) 	dlog_put("W-[%s] ", __func__, msg, ##args)
+
+#elif defined(_INFO_DEBUG_)
 #define PRINT_DEBUG(msg, args...) do { 			\
 	printk("[%s] " msg , __func__ , ##args );	\
 } while (0)
@@ -161,10 +168,14 @@ Y;	\
 
 extern void dump(char* _buf, uint16_t _count);
 
+#ifdef _DLOG_
+#define _DUMP(BUF, COUNT) dlog_dump(__func__, (const char*)BUF, COUNT)
+#else
 #define _DUMP(BUF, COUNT) do {		\
 	printk("[%s]: ", __func__);		\
 	dump((char*)BUF, COUNT);				\
 	} while (0)
+#endif
 
 #ifdef _APP_DEBUG_
 #define DUMP(BUF, COUNT) _DUMP(BUF, COUNT)
@@ -176,16 +187,11 @@ extern void dump(char* _buf, uint16_t _count);
 #define DUMP_TCP(BUF, COUNT) IF_TCP_DUMP(_DUMP(BUF, COUNT))
 #define DUMP_SPI(BUF, COUNT) IF_SPI_DUMP(_DUMP(BUF, COUNT))
 
+// Prints a command up to its END_CMD byte, see ard_spi.c
+extern void dumpSpiCmd(const char* func, const char* buf);
+
 #define DUMP_SPI_CMD(BUF) do {				\
-	if (dumpDebug & INFO_SPI_FLAG) {		\
-	int i = 0;								\
-	for (; i < CMD_MAX_LEN; ++i) 			\
-	{										\
-		printk("0x%x ", BUF[i]);			\
-		if (BUF[i] == END_CMD)				\
-			break;							\
-	}										\
-	printk("\n");							\
-	}										\
+	if (dumpDebug & INFO_SPI_FLAG)			\
+		dumpSpiCmd(__func__, (const char*)BUF);	\
 }while(0);
 
@@ -0,0 +1,189 @@
+/*
+ * dlog.c
+ *
+ *  Deferred debug log, see dlog.h
+ */
+
+#include <stdarg.h>
+#include "compiler.h"
+#include "printf-stdarg.h"
+#include "debug.h"
+#include "dlog.h"
+
+#ifdef _DLOG_
+
+typedef struct sDlog {
+	const char* pfx;		// "[%s] " prefix, NULL for a dump
+	const char* func;
+	const char* fmt;
+	uint8_t strMask;		// args that are offsets into str
+	uint8_t strLen;			// bytes of str in use
+	uint32_t args[DLOG_MAX_ARGS];	// args[0] is the size for a dump
+	char str[DLOG_STR_LEN];
+} tDlog;
+
+static tDlog dlogRing[DLOG_ENTRIES];
+static volatile uint16_t dlogHead = 0;	// next entry to fill
+static volatile uint16_t dlogTail = 0;	// next entry to print
+static volatile uint16_t dlogLost = 0;
+
+#define DLOG_NEXT(i)	(((i) + 1 < DLOG_ENTRIES) ? (i) + 1 : 0)
+
+// Entries are filled with the interrupts off, so messages from the
+// interrupt handlers can't take the same one
+#define DLOG_LOCK()	Bool global_interrupt_enabled = Is_global_interrupt_enabled();	\
+					if (global_interrupt_enabled) Disable_global_interrupt();
+#define DLOG_UNLOCK()	if (global_interrupt_enabled) Enable_global_interrupt();
+
+static tDlog* dlog_alloc(void)
+{
+	uint16_t next = DLOG_NEXT(dlogHead);
+	if (next == dlogTail)
+	{
+		++dlogLost;
+		return NULL;
+	}
+	return &dlogRing[dlogHead];
+}
+
+// Copies a %s argument, which may be gone by the time it is printed,
+// and returns its offset in e->str
+static uint32_t dlog_str(tDlog* e, const char* s)
+{
+	uint8_t n = 0;
+	uint8_t off = e->strLen;
+
+	while (s[n] && (off + n < DLOG_STR_LEN - 1))
+	{
+		e->str[off + n] = s[n];
+		++n;
+	}
+	e->str[off + n] = '\0';
+	e->strLen = off + n + 1;
+	if (e->strLen > DLOG_STR_LEN - 1)
+		e->strLen = DLOG_STR_LEN - 1;
+	return off;
+}
+
+void dlog_put(const char* pfx, const char* func, const char* fmt, ...)
+{
+	va_list ap;
+	uint8_t n = 0;
+	tDlog* e;
+
+	DLOG_LOCK();
+	if ((e = dlog_alloc()) == NULL)
+	{
+		DLOG_UNLOCK();
+		return;
+	}
+	e->pfx = pfx;
+	e->func = func;
+	e->fmt = fmt;
+	e->strMask = 0;
+	e->strLen = 0;
+
+	// Walk the format the way printk_va() does, it takes an int
+	// for each of the conversions below and nothing for the others
+	va_start(ap, fmt);
+	for (; *fmt != 0 && n < DLOG_MAX_ARGS; ++fmt)
+	{
+		if (*fmt != '%')
+			continue;
+		++fmt;
+		if (*fmt == '\0') break;
+		if (*fmt == '-') ++fmt;
+		while ((*fmt >= '0') && (*fmt <= '9')) ++fmt;
+		switch (*fmt)
+		{
+		case 's':
+		{
+			const char* s = va_arg(ap, const char*);
+			if (s)
+			{
+				e->args[n] = dlog_str(e, s);
+				e->strMask |= (1 << n);
+			}
+			else
+				e->args[n] = 0;
+			++n;
+			break;
+		}
+		case 'd': case 'p': case 'x': case 'X': case 'u': case 'c':
+			e->args[n++] = va_arg(ap, uint32_t);
+			break;
+		case '\0':
+			--fmt;
+			break;
+		}
+	}
+	va_end(ap);
+	while (n < DLOG_MAX_ARGS)
+		e->args[n++] = 0;
+
+	dlogHead = DLOG_NEXT(dlogHead);
+	DLOG_UNLOCK();
+}
+
+void dlog_dump(const char* func, const char* buf, uint16_t count)
+{
+	tDlog* e;
+
+	DLOG_LOCK();
+	if ((e = dlog_alloc()) == NULL)
+	{
+		DLOG_UNLOCK();
+		return;
+	}
+	e->pfx = NULL;
+	e->func = func;
+	e->fmt = NULL;
+	e->args[0] = count;
+	e->strLen = (count < DLOG_STR_LEN) ? count : DLOG_STR_LEN;
+	memcpy(e->str, buf, e->strLen);
+
+	dlogHead = DLOG_NEXT(dlogHead);
+	DLOG_UNLOCK();
+}
+
+// Prints up to max messages, returns how many are still waiting
+uint16_t dlog_flush(uint16_t max)
+{
+	uint16_t lost;
+
+	if (dlogLost)
+	{
+		DLOG_LOCK();
+		lost = dlogLost;
+		dlogLost = 0;
+		DLOG_UNLOCK();
+		printk("dlog: %d messages lost\n", lost);
+	}
+
+	while (max-- && (dlogTail != dlogHead))
+	{
+		tDlog* e = &dlogRing[dlogTail];
+		uint32_t a[DLOG_MAX_ARGS];
+		uint8_t i;
+
+		if (e->fmt)
+		{
+			for (i = 0; i < DLOG_MAX_ARGS; ++i)
+				a[i] = (e->strMask & (1 << i)) ? (uint32_t)&e->str[e->args[i]] : e->args[i];
+			printk(e->pfx, e->func);
+			printk(e->fmt, a[0], a[1], a[2], a[3], a[4], a[5], a[6], a[7]);
+		}
+		else
+		{
+			printk("[%s]: ", e->func);
+			dump(e->str, e->strLen);
+			if (e->args[0] > e->strLen)
+				printk("\t... %d bytes\n", e->args[0]);
+		}
+		// the entry is only given back once it has been printed
+		dlogTail = DLOG_NEXT(dlogTail);
+	}
+	return (dlogHead + DLOG_ENTRIES - dlogTail) % DLOG_ENTRIES;
+}
+
+#endif
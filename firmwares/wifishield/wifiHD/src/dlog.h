@@ -0,0 +1,32 @@
+/*
+ * dlog.h
+ *
+ *  Deferred debug log: the INFO_xxx, WARN and DUMP_xxx macros only record
+ *  the format and its raw arguments in a RAM ring when _DLOG_ is defined,
+ *  and the main loop prints them once nothing else is waiting.
+ */
+
+#ifndef DLOG_H_
+#define DLOG_H_
+
+#include <stdint.h>
+
+#ifndef DLOG_ENTRIES
+#define DLOG_ENTRIES	32
+#endif
+// Arguments kept per message, printk only takes int sized ones
+#define DLOG_MAX_ARGS	8
+// Room for the %s strings, or the dumped bytes, of a message
+#define DLOG_STR_LEN	32
+// Messages printed per pass of the main loop
+#define DLOG_FLUSH_MAX	4
+
+#ifdef _DLOG_
+void dlog_put(const char* pfx, const char* func, const char* fmt, ...);
+void dlog_dump(const char* func, const char* buf, uint16_t count);
+uint16_t dlog_flush(uint16_t max);
+#else
+#define dlog_flush(max)	0
+#endif
+
+#endif /* DLOG_H_ */
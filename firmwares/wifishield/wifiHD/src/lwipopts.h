@@ -41,12 +41,28 @@
 #define __LWIPOPTS_H__
 
 #include "wl_api.h"
+#include "wl_definitions.h"
 #include <board.h>
 
 #ifndef BOARD
 #error "BOARD must be defined"
 #endif
 
+/**
+ * LWIP_PROFILE: how the TCP and pbuf options below trade RAM for
+ * throughput. Set it with the project's symbols.
+ * LWIP_PROFILE_LOW_MEM (default): 512 byte segments and a 4K send buffer.
+ * LWIP_PROFILE_THROUGHPUT: full 1460 byte segments and a four segment
+ * send buffer and window, so more data is in flight over the WiFi
+ * latency; takes pool pbufs of about 1.5K each. Not for EVK1101.
+ * Compare them on a board with the ttcp console command.
+ */
+#define LWIP_PROFILE_LOW_MEM            0
+#define LWIP_PROFILE_THROUGHPUT         1
+#ifndef LWIP_PROFILE
+#define LWIP_PROFILE                    LWIP_PROFILE_LOW_MEM
+#endif
+
 /*
    -----------------------------------------------
    ---------- Platform specific locking ----------
@@ -110,14 +126,15 @@
 /**
  * MEMP_NUM_TCP_PCB: the number of simulatenously active TCP connections.
  * (requires the LWIP_TCP option)
+ * One for each client socket and each connection a server accepted.
  */
-#define MEMP_NUM_TCP_PCB                4
+#define MEMP_NUM_TCP_PCB                (MAX_SOCK_NUM + MAX_CLIENT_ACCEPTED)
 
 /**
  * MEMP_NUM_TCP_PCB_LISTEN: the number of listening TCP connections.
  * (requires the LWIP_TCP option)
  */
-#define MEMP_NUM_TCP_PCB_LISTEN         2
+#define MEMP_NUM_TCP_PCB_LISTEN         MAX_SOCK_NUM
 
 /**
  * MEMP_NUM_TCP_SEG: the number of simultaneously queued TCP segments.
@@ -174,6 +191,8 @@
  */
 #if BOARD == EVK1101 /* Reduced RAM */
   #define PBUF_POOL_SIZE                  2
+#elif LWIP_PROFILE == LWIP_PROFILE_THROUGHPUT
+  #define PBUF_POOL_SIZE                  12 /* in about the RAM of 32 small ones */
 #else
   #define PBUF_POOL_SIZE                  32
 #endif
@@ -331,6 +350,15 @@
  */
 #define LWIP_DNS                        1
 
+/**
+ * DNS_TABLE_SIZE: number of names whose address is kept, for as long as
+ * the server's TTL allows, so reconnecting to the same hosts needs no
+ * new query. Each entry takes about DNS_MAX_NAME_LENGTH bytes.
+ */
+#ifndef DNS_TABLE_SIZE
+#define DNS_TABLE_SIZE                  8
+#endif
+
 /*
    ---------------------------------
    ---------- UDP options ----------
@@ -441,10 +469,16 @@
 #define ETH_PAD_SIZE WL_HEADER_SIZE /* size of wifiengine header */
 #define MEM_LIBC_MALLOC 1
 
+#if (LWIP_PROFILE == LWIP_PROFILE_THROUGHPUT) && (BOARD != EVK1101)
+ #define TCP_MSS                         1460 /* MTU (1500) - IP - TCP hdrs == 1460 */
+ #define TCP_SND_BUF                     (4 * TCP_MSS)
+ #define TCP_WND                         (4 * TCP_MSS)
+#else
 #define TCP_MSS                         512
 #if BOARD == EVK1101 /* Reduced RAM */
  #define TCP_SND_BUF                     (1460*1) /* MTU (1500) - IP - TCP hdrs == 1460 */
 #else
  #define TCP_SND_BUF                     4096
 #endif
+#endif
 #endif /* __LWIPOPTS_H__ */
@@ -35,6 +35,7 @@
 #include "delay.h"
 #include "tc.h"
 #include "debug.h"
+#include "dlog.h"
 #include "ard_utils.h"
 #include <lwip_setup.h>
 
@@ -352,6 +353,7 @@ void startup_init(void)
 {
 	INIT_SIGNAL_FOR_SPI();
 	BUSY_FOR_SPI();
+	NO_EVENT_FOR_SPI();
 
 	// if DEBUG enabled use DEB_PIN_GPIO for debug purposes
     DEB_PIN_ENA();
@@ -422,9 +424,20 @@ main(void)
     if (wl_status != WL_SUCCESS)
             goto err;
 
-    /* start main loop */
-    for (;;)
+    /* start main loop, idle between the interrupts that bring work, the
+     * RTC tick being one of them */
+    for (;;) {
+            take_pending_events();
             poll(hs);
+            if (initSpiComplete && spi_pending())
+                    continue;
+            /* nothing is waiting, print what was logged meanwhile */
+            if (dlog_flush(DLOG_FLUSH_MAX))
+                    continue;
+#ifndef WITH_NO_SLEEP
+            sleep_until_event();
+#endif
+    }
 
 
 err:
@@ -29,6 +29,7 @@
 #include <stdint.h>
 #include <rtc.h>
 #include <intc.h>
+#include <pm.h>
 #include <timer.h>
 #ifdef FREERTOS_USED
 #include "FreeRTOS.h"
@@ -85,6 +86,7 @@ static __attribute__((__interrupt__)) void irq_handler(void)
         volatile avr32_rtc_t *rtc = &AVR32_RTC;
         struct timer_t* priv = &TIMER;
         priv->tick++;
+        SET_PENDING_EVENT(EVENT_TIMER);
 
         if(priv->tick_isr)
                 priv->tick_isr(priv->ctx);
@@ -119,6 +121,38 @@ void timer_init(void (*tick_isr) (void* ctx), void* ctx)
 }
 
 
+volatile uint32_t pending_events = 0;
+
+/* Returns and clears the events set since the last call */
+uint32_t take_pending_events(void)
+{
+        uint32_t ev;
+
+        Disable_global_interrupt();
+        ev = pending_events;
+        pending_events = 0;
+        Enable_global_interrupt();
+        return ev;
+}
+
+/*
+ * Idles the CPU until the next interrupt unless an event is pending
+ * already. Clocks and peripherals keep running in idle mode. The check
+ * and the sleep instruction both run with interrupts masked: sleep
+ * clears SR[GM] as it halts the CPU, and an interrupt that came after
+ * the check is still pending then and wakes it right away, so no event
+ * waits for the next RTC tick.
+ */
+void sleep_until_event(void)
+{
+#ifndef FREERTOS_USED
+        Disable_global_interrupt();
+        if (!pending_events)
+                SLEEP(AVR32_PM_SMODE_IDLE);
+        Enable_global_interrupt();
+#endif
+}
+
 U32 timer_get_ms(void)
 {
         struct timer_t* priv = &TIMER;
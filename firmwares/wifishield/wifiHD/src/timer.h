@@ -48,4 +48,16 @@ uint32_t timer_mod(uint32_t id, uint32_t ms, uint8_t type, void (*cb)(void *ctx)
 void timer_cancel_timeout(uint32_t id);
 uint32_t timer_get_ms(void);
 
+/* Interrupts that leave work for the main loop, which only sleeps while
+ * none of them is pending */
+#define EVENT_TIMER     (1 << 0)
+#define EVENT_SPI       (1 << 1)
+#define EVENT_WIFI      (1 << 2)
+
+extern volatile uint32_t pending_events;
+#define SET_PENDING_EVENT(ev)   (pending_events |= (ev))
+
+uint32_t take_pending_events(void);
+void sleep_until_event(void);
+
 #endif
@@ -62,12 +62,34 @@ enum {
 	GET_TEST_CMD		= 0x38,
 	SEND_DATA_UDP_CMD	= 0x39,
 	GET_REMOTE_DATA_CMD = 0x3A,
+	// -> replies of the pipelined commands done so far, see PIPE_CMD
+	GET_PIPE_REPLIES_CMD = 0x3B,
+	// -> data available bitmap, server states, client states of all sockets
+	GET_SOCKETS_STATE_CMD = 0x3C,
+	// cmd -> count, min, avg, max handling time in us (_SPI_STATS_ only)
+	GET_CMD_STATS_CMD	= 0x3D,
+	// sock -> bytes received, sent, and both per second (_SPI_STATS_ only)
+	GET_SOCK_STATS_CMD	= 0x3E,
+	// host name -> its address if known already (cached or an IP
+	// string), else 0xffffffff and GET_HOST_BY_NAME_CMD polls as usual
+	REQ_GET_HOST_BY_NAME_CMD = 0x3F,
 
     // All command with DATA_FLAG 0x40 send a 16bit Len
 
 	SEND_DATA_TCP_CMD		= 0x44,
     GET_DATABUF_TCP_CMD		= 0x45,
     INSERT_DATABUF_CMD		= 0x46,
+    // sock, max len (MSB first) -> up to max len bytes of what was received
+    GET_DATABULK_TCP_CMD	= 0x47,
+    // seq, whole command frame -> queued (1) or queue full (0); the
+    // command runs later, GET_PIPE_REPLIES_CMD collects its reply
+    PIPE_CMD				= 0x48,
+    // sock, max len (MSB first) -> as many whole datagrams as fit, each
+    // as remote ip, remote port, len (MSB first), data
+    GET_DATAGRAMS_UDP_CMD	= 0x49,
+    // sock, datagrams as above (ip 0 sends to the connected remote)
+    // -> number of datagrams sent
+    SEND_DATAGRAMS_UDP_CMD	= 0x4A,
 
 };
 
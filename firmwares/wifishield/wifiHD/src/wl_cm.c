@@ -59,9 +59,18 @@
  */
 #define ROAMING_RSSI_DIFF 10
 
+/*! The CM_SCAN_CACHE_MS setting defines for how long the list of
+ *  networks from the last scan is trusted. Within that time
+ *  wl_cm_set_network() picks a network from it right away instead
+ *  of starting a new scan.
+ *  Unit is ms.
+ */
+#define CM_SCAN_CACHE_MS 30000
+
 # include "printf-stdarg.h"
 #include "ard_utils.h"
 #include "debug.h"
+#include "timer.h"
 
 /** \defgroup wl_cm Connection Manager
  *
@@ -84,6 +93,11 @@ struct cm {
         void* ctx;
         uint8_t enabled;
         struct cm_candidate candidate;
+        struct wl_mac_addr_t last_bssid; /* AP of the last connection */
+        uint8_t have_last;
+        uint8_t fast_retry;     /* reconnecting to last_bssid, no scan */
+        uint8_t have_scan;
+        uint32_t scan_ms;       /* when the last scan completed */
 };
 
 
@@ -236,6 +250,8 @@ wl_scan_complete_cb(void* ctx)
         struct cm *cm = ctx;
 
         CM_DPRINTF("CM: scan completed\n");
+        cm->have_scan = 1;
+        cm->scan_ms = timer_get_ms();
 
         if (cm->scan_cb)
                 cm->scan_cb(cm->ctx);
@@ -255,6 +271,9 @@ wl_media_connected_cb(void* ctx)
         struct cm *cm = ctx;
         struct wl_network_t *net = wl_get_current_network();
         CM_DPRINTF("CM: connected to %s\n", ssid2str(&net->ssid));
+        memcpy(&cm->last_bssid, &net->bssid, sizeof(cm->last_bssid));
+        cm->have_last = 1;
+        cm->fast_retry = 0;
         LINK_LED_ON();
         ERROR_LED_OFF();
         if (cm->conn_cb)
@@ -276,6 +295,11 @@ wl_conn_failure_cb(void* ctx)
         if ( 0 == cm->enabled ) {
                 return;
         }
+        if (cm->fast_retry) {
+                CM_DPRINTF("CM: reconnect to last AP failed\n");
+                cm->fast_retry = 0;
+                cm->have_last = 0;
+        }
         if (wl_scan() != WL_SUCCESS)
                 /* should never happen */
                 CM_DPRINTF("CM: could not start scan after connect fail!\n");
@@ -297,6 +321,15 @@ wl_conn_lost_cb(void* ctx)
         if ( 0 == cm->enabled ) {
                 return;
         }
+        /* Most losses are short drop outs of the same AP, so first
+         * probe for it directly; a failure makes wl_conn_failure_cb()
+         * fall back to a full scan. */
+        if (cm->have_last && !cm->fast_retry) {
+                cm->fast_retry = 1;
+                if (wl_connect_bssid(cm->last_bssid) == WL_SUCCESS)
+                        return;
+                cm->fast_retry = 0;
+        }
         if (wl_scan() != WL_SUCCESS)
                 /* should never happen */
                 CM_DPRINTF("CM: could not start scan after connect lost!\n");
@@ -421,8 +454,17 @@ wl_cm_set_network(struct wl_ssid_t *ssid, struct wl_mac_addr_t *bssid)
         else
                 memset(&cm->candidate.bssid, 0xff, sizeof(cm->candidate.bssid));
 
-        if (cm->candidate.ssid.len)
-                wl_scan();
+        /* a new network makes the last AP meaningless */
+        cm->have_last = 0;
+        cm->fast_retry = 0;
+
+        if (cm->candidate.ssid.len) {
+                if (cm->enabled && cm->have_scan &&
+                    timer_get_ms() - cm->scan_ms < CM_SCAN_CACHE_MS)
+                        select_net(cm);
+                else
+                        wl_scan();
+        }
         
         return WL_SUCCESS;
 }
@@ -21,7 +21,13 @@
 // Maximum size of a SSID list
 #define WL_NETWORKS_LIST_MAXNUM	10
 // Maxmium number of socket
-#define	MAX_SOCK_NUM		4
+#ifndef MAX_SOCK_NUM
+#define	MAX_SOCK_NUM		8
+#endif
+// Maximum number of client connection accepted by server
+#ifndef MAX_CLIENT_ACCEPTED
+#define MAX_CLIENT_ACCEPTED	8
+#endif
 //Maximum number of attempts to establish wifi connection
 #define WL_MAX_ATTEMPT_CONNECTION	10
 
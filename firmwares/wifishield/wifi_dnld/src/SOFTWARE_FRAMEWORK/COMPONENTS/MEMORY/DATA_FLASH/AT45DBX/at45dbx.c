@@ -138,6 +138,7 @@
 #define AT45DBX_MSK_BUSY                  0x80        //!< Busy status bit-mask.
 #define AT45DBX_BUSY                      0x00        //!< Busy status value (0x00 when busy, 0x80 when ready).
 #define AT45DBX_MSK_DENSITY               0x3C        //!< Device density bit-mask.
+#define AT45DBX_MSK_COMP                  0x40        //!< Page to buffer compare bit-mask (0x00 when equal).
 //! @}
 #if AT45DBX_MEM_SIZE == AT45DBX_1MB
 
@@ -209,6 +210,9 @@
 //! Bit-mask for page selection in \ref gl_ptr_mem.
 #define AT45DBX_MSK_PTR_PAGE              (((1 << AT45DBX_PAGE_ADDR_BITS) - 1) << AT45DBX_PAGE_BITS)
 
+//! Number of pages erased by a Block Erase.
+#define AT45DBX_BLOCK_PAGES               8
+
 //! Bit-mask for byte position within sector in \ref gl_ptr_mem.
 #define AT45DBX_MSK_PTR_SECTOR            ((1 << AT45DBX_SECTOR_BITS) - 1)
 
@@ -669,4 +673,133 @@ Bool at45dbx_write_sector_from_ram(const void *ram)
 //! @}
 
 
+/*! \name Pipelined Access Functions
+ */
+//! @{
+
+
+/*! \brief Waits until the DF gl_ptr_mem points to is ready.
+ *
+ * \return The status register.
+ */
+static U8 at45dbx_ready_status(void)
+{
+  U16 status;
+
+  at45dbx_chipselect_df(gl_ptr_mem >> AT45DBX_MEM_SIZE, TRUE);
+  spi_write(AT45DBX_SPI, AT45DBX_CMDC_RD_STATUS_REG);
+  do
+  {
+    spi_write_dummy();
+    spi_read(AT45DBX_SPI, &status);
+  } while ((status & AT45DBX_MSK_BUSY) == AT45DBX_BUSY);
+  at45dbx_chipselect_df(gl_ptr_mem >> AT45DBX_MEM_SIZE, FALSE);
+
+  return status;
+}
+
+
+/*! \brief Runs a command on the page gl_ptr_mem points to.
+ *
+ * \param cmd Command using a page address.
+ */
+static void at45dbx_page_cmd(U8 cmd)
+{
+  U32 addr = Rd_bitfield(gl_ptr_mem, AT45DBX_MSK_PTR_PAGE) << AT45DBX_BYTE_ADDR_BITS;
+
+  at45dbx_chipselect_df(gl_ptr_mem >> AT45DBX_MEM_SIZE, TRUE);
+  spi_write(AT45DBX_SPI, cmd);
+  spi_write(AT45DBX_SPI, LSB2W(addr));
+  spi_write(AT45DBX_SPI, LSB1W(addr));
+  spi_write(AT45DBX_SPI, LSB0W(addr));
+  at45dbx_chipselect_df(gl_ptr_mem >> AT45DBX_MEM_SIZE, FALSE);
+}
+
+
+/*! \brief Compares a programmed page with the buffer it came from.
+ *
+ * \param page Page number.
+ * \param buf  Buffer 1 (0) or 2 (1).
+ *
+ * \retval OK The page matches.
+ * \retval KO The page differs.
+ */
+static Bool at45dbx_page_verify(U32 page, U8 buf)
+{
+  gl_ptr_mem = page << AT45DBX_PAGE_BITS;
+  at45dbx_ready_status();
+  at45dbx_page_cmd(buf ? AT45DBX_CMDB_CMP_PAGE_TO_BUF2 : AT45DBX_CMDB_CMP_PAGE_TO_BUF1);
+  return (at45dbx_ready_status() & AT45DBX_MSK_COMP) ? KO : OK;
+}
+
+
+Bool at45dbx_write_verify(U32 addr, const void *ram, U32 len, U32 *bad_addr)
+{
+  const U8 *_ram = ram;
+  U32 first = addr >> AT45DBX_PAGE_BITS;
+  U32 end = first + ((len + AT45DBX_PAGE_SIZE - 1) >> AT45DBX_PAGE_BITS);
+  U32 erased = first;
+  U32 page, i;
+
+  Assert(!Rd_bitfield(addr, AT45DBX_MSK_PTR_BYTE));
+
+  // Let a program the byte access functions started finish.
+  if (at45dbx_busy) at45dbx_wait_ready();
+  at45dbx_busy = FALSE;
+
+  for (page = first; page < end; page++)
+  {
+    U8 buf = (page - first) & 1;
+
+    // Load the page into a buffer, while the DF may still program the
+    // previous page from the other one.
+    gl_ptr_mem = page << AT45DBX_PAGE_BITS;
+    at45dbx_chipselect_df(gl_ptr_mem >> AT45DBX_MEM_SIZE, TRUE);
+    spi_write(AT45DBX_SPI, buf ? AT45DBX_CMDC_WR_BUF2 : AT45DBX_CMDC_WR_BUF1);
+    spi_write(AT45DBX_SPI, 0);
+    spi_write(AT45DBX_SPI, 0);
+    spi_write(AT45DBX_SPI, 0);
+    for (i = 0; i < AT45DBX_PAGE_SIZE; i++)
+      spi_write(AT45DBX_SPI, (_ram < (const U8 *)ram + len) ? *_ram++ : 0x00);
+    at45dbx_chipselect_df(gl_ptr_mem >> AT45DBX_MEM_SIZE, FALSE);
+
+    // The previous page is checked before its buffer gets reused.
+    if (page > first && at45dbx_page_verify(page - 1, !buf) != OK)
+    {
+      *bad_addr = (page - 1) << AT45DBX_PAGE_BITS;
+      return KO;
+    }
+
+    gl_ptr_mem = page << AT45DBX_PAGE_BITS;
+    at45dbx_ready_status();
+    if (page >= erased)
+    {
+      // Erase ahead, a block at a time where the range covers all of it.
+      if (!(page % AT45DBX_BLOCK_PAGES) && page + AT45DBX_BLOCK_PAGES <= end)
+      {
+        at45dbx_page_cmd(AT45DBX_CMDB_ER_BLOCK);
+        erased = page + AT45DBX_BLOCK_PAGES;
+      }
+      else
+      {
+        at45dbx_page_cmd(AT45DBX_CMDB_ER_PAGE);
+        erased = page + 1;
+      }
+      at45dbx_ready_status();
+    }
+    at45dbx_page_cmd(buf ? AT45DBX_CMDB_PR_BUF2_TO_PAGE : AT45DBX_CMDB_PR_BUF1_TO_PAGE);
+  }
+
+  if (end > first && at45dbx_page_verify(end - 1, (end - 1 - first) & 1) != OK)
+  {
+    *bad_addr = (end - 1) << AT45DBX_PAGE_BITS;
+    return KO;
+  }
+  return OK;
+}
+
+
+//! @}
+
+
 #endif  // AT45DBX_MEM == ENABLE
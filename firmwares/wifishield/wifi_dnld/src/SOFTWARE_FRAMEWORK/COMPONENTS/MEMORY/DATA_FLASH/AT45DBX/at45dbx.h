@@ -266,4 +266,33 @@ extern Bool at45dbx_write_sector_from_ram(const void *ram);
 //! @}
 
 
+/*! \name Pipelined Access Functions
+ */
+//! @{
+
+/*! \brief Writes and verifies len bytes from a RAM buffer, from a page
+ *         boundary on.
+ *
+ * Pages are loaded alternately into the two SRAM buffers of the DF, so the
+ * next page is transferred while the previous one is being programmed.
+ * Blocks the range covers completely are erased once ahead, and pages are
+ * then programmed without built-in erase. The DF compares every page with
+ * its buffer once it is programmed, so nothing is read back over SPI. The
+ * rest of a last partial page is zero-filled.
+ *
+ * Data flow is: RAM -> DF.
+ *
+ * \param addr     Byte address of the first page.
+ * \param ram      Pointer to RAM buffer.
+ * \param len      Number of bytes to write.
+ * \param bad_addr Set to the address of the page that failed to verify.
+ *
+ * \retval OK Success.
+ * \retval KO A page does not match what was written.
+ */
+extern Bool at45dbx_write_verify(U32 addr, const void *ram, U32 len, U32 *bad_addr);
+
+//! @}
+
+
 #endif  // _AT45DBX_H_
@@ -63,7 +63,7 @@ led_init(void)
 
 int main(void)
 {
-        U32 pos, len;
+        U32 bad;
 
         startup_init();
         printk("*** HD chip firmware upgrade ver 2.7 ***\n");
@@ -81,42 +81,14 @@ int main(void)
         	printk("Memory check... [FAIL]\n");
         	return 0;
         }
-        printk("Writing firmware data to flash\n");
-        pos = 0;
-        while (pos < fw_len) {
-                if (fw_len - pos > SECTOR_SIZE)
-                        len = SECTOR_SIZE;
-                else
-                        len = fw_len - pos;
-                
-                flash_write(pos, fw_buf + pos, len);
-                pos += len;
-        }
-
-        printk("Verifying firmware data\n");
-        pos = 0;
-        while (pos < fw_len) {
-                static U8 page_buf[SECTOR_SIZE];
-                U32 i;
-
-                if (fw_len - pos > SECTOR_SIZE)
-                        len = SECTOR_SIZE;
-                else
-                        len = fw_len - pos;
-                
-                flash_read(pos, page_buf, len);
-
-                for (i = 0; i < len; i++)
-                    if (*(page_buf + i) != *(fw_buf + pos + i)) {
-                    	RED_ON();
-                    	GREEN_OFF();
-                        printk("Verify failed at byte %d, 0x%02x != 0x%02x\n",
-                               pos + i, *(page_buf + i), *(fw_buf + pos + i));
-                        return 0;
-                    }
-                        
-                
-                pos += len;
+        printk("Writing and verifying firmware data\n");
+        /* Each page is compared with what was written by the flash itself,
+         * while the next one is being transferred */
+        if (flash_write_verify(0, fw_buf, fw_len, &bad) != OK) {
+        	RED_ON();
+        	GREEN_OFF();
+                printk("Verify failed in page at byte %d\n", bad);
+                return 0;
         }
         GREEN_OFF();
         BLUE_ON();
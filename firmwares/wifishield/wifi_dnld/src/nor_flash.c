@@ -86,6 +86,14 @@ void flash_write(U32 addr, const U8* buf, U32 len)
         at45dbx_write_close();
 }
 
+/* Erases, programs and verifies a page at a time, see at45dbx_write_verify */
+Bool flash_write_verify(U32 addr, const U8* buf, U32 len, U32* bad_addr)
+{
+        Assert(addr % AT45DBX_SECTOR_SIZE == 0);
+
+        return at45dbx_write_verify(addr, buf, len, bad_addr);
+}
+
 void flash_read(U32 addr, U8* buf, U32 len)
 {
         U32 sector = addr / AT45DBX_SECTOR_SIZE;
@@ -37,5 +37,6 @@
 void flash_init(void);
 void flash_write(U32 addr, const U8* buf, U32 len);
 void flash_read(U32 addr, U8* buf, U32 len);
+Bool flash_write_verify(U32 addr, const U8* buf, U32 len, U32* bad_addr);
 
 #endif
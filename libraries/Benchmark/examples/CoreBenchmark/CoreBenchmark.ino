@@ -0,0 +1,95 @@
+/*
+  Core Benchmark
+
+  Prints the clock cycles that the pin, analog, time and serial functions
+  of the core take, and how long an external interrupt takes from the
+  edge to the first line of its handler. Run it on each board to compare
+  them, or before and after a change to the core.
+
+  Pin 2 is toggled as an output to trigger its own interrupt (INT0 on the
+  Uno and Mega), and pin 13 by the pin tests, so leave nothing connected
+  to them. Analog input 0 is read.
+
+  created 14 Oct 2026
+*/
+
+#include <Benchmark.h>
+
+const uint8_t outPin = 13;
+const uint8_t irqPin = 2;
+
+Benchmark bench(Serial);
+volatile unsigned long isrCycles;
+volatile uint8_t sink;
+uint8_t level;
+
+void testDigitalWrite() {
+  digitalWrite(outPin, level ^= 1);
+}
+
+void testDigitalRead() {
+  sink = digitalRead(outPin);
+}
+
+void testAnalogRead() {
+  sink = analogRead(A0);
+}
+
+void testMillis() {
+  sink = millis();
+}
+
+void testMicros() {
+  sink = micros();
+}
+
+void testSerialWrite() {
+  Serial.write('.');
+}
+
+void onEdge() {
+  isrCycles = cycleCounter();
+}
+
+void setup() {
+  Serial.begin(115200);
+  while (!Serial) ; // wait for the serial port on boards with native USB
+
+  pinMode(outPin, OUTPUT);
+  bench.begin();
+
+  bench.run(F("digitalWrite()"), testDigitalWrite);
+  bench.run(F("digitalRead()"), testDigitalRead);
+  bench.run(F("analogRead()"), testAnalogRead, 10);
+  bench.run(F("millis()"), testMillis);
+  bench.run(F("micros()"), testMicros);
+
+  // the fastest round is the first, while the 16 dots still fit in the
+  // transmit buffer, so this is the cost of queueing a byte
+  Serial.flush();
+  bench.run(F("Serial.write() buffered"), testSerialWrite, 16);
+  Serial.println();
+  Serial.flush();
+
+  // from the write that makes the edge to the handler reading the counter
+  pinMode(irqPin, OUTPUT);
+  digitalWrite(irqPin, LOW);
+  attachInterrupt(digitalPinToInterrupt(irqPin), onEdge, RISING);
+  unsigned long best = 0xFFFFFFFFUL;
+  for (uint8_t i = 0; i < 10; i++) {
+    isrCycles = 0;
+    unsigned long start = cycleCounter();
+    digitalWrite(irqPin, HIGH);
+    while (!isrCycles) ;
+    if (isrCycles - start < best)
+      best = isrCycles - start;
+    digitalWrite(irqPin, LOW);
+  }
+  detachInterrupt(digitalPinToInterrupt(irqPin));
+  bench.report(F("attachInterrupt() latency"), best);
+
+  bench.end();
+}
+
+void loop() {
+}
@@ -0,0 +1,71 @@
+/*
+  Peripheral Benchmark
+
+  Prints the clock cycles that SPI, Wire and EEPROM operations take. The
+  numbers include the time on the wire, so they show how much of each
+  operation is overhead next to the SPI, I2C or EEPROM hardware.
+
+  Nothing needs to be connected. The Wire test addresses a device that
+  isn't there (0x7F), so it times a start, an address byte that nobody
+  acknowledges and a stop, which is the fixed cost of every transfer;
+  with pull-ups missing Wire may hit its timeout instead. The EEPROM
+  test only uses update() with the value already stored, so it never
+  wears out a cell.
+
+  created 14 Oct 2026
+*/
+
+#include <Benchmark.h>
+#include <SPI.h>
+#include <Wire.h>
+#include <EEPROM.h>
+
+Benchmark bench(Serial);
+volatile uint8_t sink;
+uint8_t buffer[32];
+
+void testSpiTransfer() {
+  sink = SPI.transfer(0x55);
+}
+
+void testSpiBlock() {
+  SPI.transfer(buffer, sizeof(buffer));
+}
+
+void testWireNack() {
+  Wire.beginTransmission(0x7F);
+  sink = Wire.endTransmission();
+}
+
+void testEepromRead() {
+  sink = EEPROM.read(0);
+}
+
+void testEepromUpdate() {
+  EEPROM.update(0, EEPROM.read(0));
+}
+
+void setup() {
+  Serial.begin(115200);
+  while (!Serial) ; // wait for the serial port on boards with native USB
+
+  SPI.begin();
+  Wire.begin();
+  Wire.setWireTimeout(1000, true);
+  bench.begin();
+
+  SPI.beginTransaction(SPISettings(F_CPU / 2, MSBFIRST, SPI_MODE0));
+  bench.run(F("SPI.transfer() at fosc/2"), testSpiTransfer);
+  bench.run(F("SPI.transfer(buf, 32)"), testSpiBlock, 10);
+  SPI.endTransaction();
+
+  bench.run(F("Wire transaction, no ack"), testWireNack, 10);
+  bench.run(F("EEPROM.read()"), testEepromRead);
+  bench.run(F("EEPROM.update() unchanged"), testEepromUpdate);
+
+  bench.end();
+  SPI.end();
+}
+
+void loop() {
+}
@@ -0,0 +1,111 @@
+/*
+  Benchmark.h - Clock cycle measurements on the board
+  Copyright (c) 2026 Arduino.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef Benchmark_h
+#define Benchmark_h
+
+#include <Arduino.h>
+
+#ifndef BENCHMARK_REPEATS
+#define BENCHMARK_REPEATS 5
+#endif
+
+// __AVR_DEVICE_NAME__ is a bare name such as atmega328p, not a string
+#define BENCH_STR(x) BENCH_STR2(x)
+#define BENCH_STR2(x) #x
+
+/***
+    Benchmark class.
+
+    run() calls a function iterations times between two reads of the
+    cycle counter (Timer1 without prescaler, see beginCycleCounter()),
+    does that BENCHMARK_REPEATS times and keeps the fastest round, so
+    an interrupt that happened to hit one round doesn't count. The cost
+    of the loop and the call itself, measured with an empty function in
+    begin(), is taken off, so what is left is the function body.
+
+    Every result is one line, "name<TAB>cycles", after a header line with
+    the MCU and clock, so the output of the same sketch on two boards or
+    two core versions can be compared line by line.
+
+    Timer1 PWM, Servo and anything else on Timer1 can't be used between
+    begin() and end().
+***/
+
+class Benchmark{
+    public:
+        Benchmark( Print &out ) : out( out ), loopCycles( 0 ) {}
+
+        void begin(){
+            if( !beginCycleCounter() ){
+                out.println( F("# Timer1 is in use, no cycle counter") );
+                return;
+            }
+            loopCycles = 0;
+            loopCycles = measure( empty, 100 );
+            out.print( F("# ") );
+#if defined(__AVR_DEVICE_NAME__)
+            out.print( F(BENCH_STR(__AVR_DEVICE_NAME__)) );
+#endif
+            out.print( F(" at ") );
+            out.print( F_CPU / 1000000L );
+            out.print( F(" MHz, call overhead ") );
+            out.print( loopCycles / 100.0, 1 );
+            out.println( F(" cycles") );
+        }
+
+        void end()                      { endCycleCounter(); }
+
+        //Prints the cycles per call of fn.
+        float run( const __FlashStringHelper *name, void (*fn)(), uint16_t iterations = 100 ){
+            float cycles = (float) measure( fn, iterations ) / iterations;
+            report( name, cycles );
+            return cycles;
+        }
+
+        //Prints a result measured some other way, e.g. an interrupt latency.
+        void report( const __FlashStringHelper *name, float cycles ){
+            out.print( name );
+            out.print( '\t' );
+            out.println( cycles, 1 );
+        }
+
+        //Cycles the loop and call of run() take per iteration.
+        float overhead() const          { return loopCycles / 100.0; }
+
+    private:
+        static void empty()              {}
+
+        unsigned long measure( void (*fn)(), uint16_t iterations ){
+            unsigned long best = 0xFFFFFFFFUL;
+            for( uint8_t r = 0 ; r < BENCHMARK_REPEATS ; ++r ){
+                unsigned long start = cycleCounter();
+                for( uint16_t i = 0 ; i < iterations ; ++i )  fn();
+                unsigned long cycles = cycleCounter() - start;
+                if( cycles < best ) best = cycles;
+            }
+            unsigned long base = loopCycles * iterations / 100;
+            return best > base ? best - base : 0;
+        }
+
+        Print &out;
+        unsigned long loopCycles;   //Of 100 calls to empty().
+};
+
+#endif
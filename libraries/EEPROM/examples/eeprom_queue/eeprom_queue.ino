@@ -0,0 +1,36 @@
+/***
+    eeprom_queue example.
+
+    This shows how to save settings with EEPROMQueue without
+    holding up the sketch. EEPROM.put() of the struct below can
+    take up to 60ms, as each changed byte takes 3.4ms to write.
+    EEPROMQueue.put() returns at once and the bytes are written
+    from an interrupt while loop() keeps blinking the LED.
+
+    Released under MIT licence.
+***/
+
+#include <EEPROMQueue.h>
+
+struct Settings {
+  int setpoint;
+  float gain[4];
+};
+
+Settings settings;
+unsigned long lastSave;
+
+void setup() {
+  pinMode(LED_BUILTIN, OUTPUT);
+  EEPROMQueue.get(0, settings);
+}
+
+void loop() {
+  digitalWrite(LED_BUILTIN, (millis() / 100) & 1);
+
+  if (millis() - lastSave > 10000) {
+    lastSave = millis();
+    settings.setpoint++;
+    EEPROMQueue.put(0, settings);
+  }
+}
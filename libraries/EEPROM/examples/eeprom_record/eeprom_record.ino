@@ -0,0 +1,46 @@
+/***
+    eeprom_record example.
+
+    This shows how to use EEPROM.putRecord() and EEPROM.getRecord()
+    to keep settings that survive a reset, and to notice when they
+    are missing or damaged, so the sketch can fall back to defaults.
+
+    The record holds a version number, the data and a CRC. Change
+    SETTINGS_VERSION whenever the layout of Settings changes, and
+    records written by older sketches are ignored.
+
+    Released under MIT licence.
+***/
+
+#include <EEPROM.h>
+
+#define SETTINGS_VERSION 1
+
+struct Settings {
+  unsigned int baud;
+  byte brightness;
+  char name[10];
+};
+
+Settings settings;
+
+void setup() {
+  Serial.begin(9600);
+  while (!Serial) {
+    ; // wait for serial port to connect. Needed for native USB port only
+  }
+
+  if (EEPROM.getRecord(0, settings, SETTINGS_VERSION)) {
+    Serial.print("Stored settings for: ");
+    Serial.println(settings.name);
+  } else {
+    Serial.println("No valid settings, storing defaults");
+    Settings defaults = { 9600, 128, "Arduino" };
+    settings = defaults;
+    EEPROM.putRecord(0, settings, SETTINGS_VERSION);
+  }
+}
+
+void loop() {
+  /* Empty loop */
+}
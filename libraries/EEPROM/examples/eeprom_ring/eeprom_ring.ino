@@ -0,0 +1,45 @@
+/***
+    eeprom_ring example.
+
+    This shows how to use EEPROMRing to keep a value that changes
+    often, here a count of minutes the board has been running in
+    total, without wearing out one spot of the EEPROM.
+
+    Each put() writes to the next slot of the region, so with the
+    512 bytes used below (84 slots of 6 bytes) the EEPROM lasts 84
+    times longer than with EEPROM.put() to a fixed address.
+
+    Released under MIT licence.
+***/
+
+#include <EEPROMRing.h>
+
+struct Uptime {
+  unsigned long minutes;
+};
+
+EEPROMRing<Uptime> ring(0, 512);  // first 512 bytes of the EEPROM
+Uptime uptime;
+
+void setup() {
+  Serial.begin(9600);
+  while (!Serial) {
+    ; // wait for serial port to connect. Needed for native USB port only
+  }
+
+  if (!ring.begin()) {
+    // nothing stored yet, make sure old data doesn't get in the way
+    ring.clear();
+    uptime.minutes = 0;
+  } else {
+    ring.get(uptime);
+  }
+  Serial.print("Minutes so far: ");
+  Serial.println(uptime.minutes);
+}
+
+void loop() {
+  delay(60000);
+  uptime.minutes++;
+  ring.put(uptime);
+}
@@ -0,0 +1,100 @@
+/*
+  EEPROMQueue.cpp - Write-behind queue for the EEPROM library
+  Copyright (c) 2026 Arduino.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+// This file holds the EE_READY_vect handler. The library is linked as an
+// archive (see library.properties), so the handler and the queue are
+// only part of the sketch when EEPROMQueue is used.
+
+#include <avr/interrupt.h>
+#include <RingBuffer.h>
+#include "EEPROMQueue.h"
+
+// The ATmega8 names
+#if !defined(EE_READY_vect) && defined(EE_RDY_vect)
+#define EE_READY_vect EE_RDY_vect
+#endif
+
+struct eeprom_write_t {
+    uint16_t address;
+    uint8_t value;
+};
+
+static SpscQueue<eeprom_write_t, EEPROM_QUEUE_SIZE> queue;
+
+// Starts programming the next queued byte that differs from the EEPROM,
+// or turns the interrupt off when there is none. Called with interrupts
+// off and the EEPROM idle.
+static void eeprom_next()
+{
+    eeprom_write_t w;
+    while( queue.pop( w ) ){
+        EEAR = w.address;
+        EECR |= _BV(EERE);
+        uint8_t old = EEDR;
+        if( old == w.value ) continue;
+
+        EECR = _BV(EERIE) | EEPROMMode( old, w.value );
+        EEDR = w.value;
+        EECR |= _BV(EEMPE);
+        EECR |= _BV(EEPE);
+        return;
+    }
+    EECR &= ~_BV(EERIE);
+}
+
+ISR(EE_READY_vect)
+{
+    eeprom_next();
+}
+
+// With interrupts off, the waits below run the queue themselves
+static inline void eeprom_poll()
+{
+    if( bit_is_clear( SREG, SREG_I ) && bit_is_set( EECR, EERIE ) && bit_is_clear( EECR, EEPE ) )
+        eeprom_next();
+}
+
+bool EEPROMQueueClass::write( int idx, uint8_t val )
+{
+    eeprom_write_t w = { (uint16_t) idx, val };
+    while( !queue.push( w ) )  eeprom_poll();
+    EECR |= _BV(EERIE);
+    return true;
+}
+
+bool EEPROMQueueClass::busy()
+{
+    return bit_is_set( EECR, EERIE ) || bit_is_set( EECR, EEPE );
+}
+
+uint16_t EEPROMQueueClass::pending()
+{
+    return queue.available() + ( bit_is_set( EECR, EEPE ) ? 1 : 0 );
+}
+
+void EEPROMQueueClass::flush()
+{
+    while( bit_is_set( EECR, EERIE ) )  eeprom_poll();
+}
+
+uint8_t EEPROMQueueClass::read( int idx )
+{
+    flush();
+    return EEPROM.read( idx );
+}
@@ -0,0 +1,66 @@
+/*
+  EEPROMQueue.h - Write-behind queue for the EEPROM library
+  Copyright (c) 2026 Arduino.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef EEPROMQueue_h
+#define EEPROMQueue_h
+
+#include <EEPROM.h>
+
+//Number of bytes that can wait to be written, must be a power of 2.
+#ifndef EEPROM_QUEUE_SIZE
+#define EEPROM_QUEUE_SIZE 32
+#endif
+
+/***
+    EEPROMQueueClass class.
+
+    Writing an EEPROM cell takes about 3.4ms, which EEPROM.write() and
+    EEPROM.put() wait out for every byte. EEPROMQueue.write() and put()
+    only queue the bytes instead, and the EEPROM ready interrupt programs
+    them one after the other, so they return right away unless the queue
+    is full. Like update(), bytes that already hold the value are skipped.
+
+    The interrupt uses the EEPROM address register, so while bytes are
+    queued the EEPROM must only be read through EEPROMQueue.read() and
+    get(), which wait for the queue to drain first. flush() does the
+    same, before using EEPROM directly or going to sleep.
+***/
+
+struct EEPROMQueueClass{
+
+    bool write( int idx, uint8_t val );  //Waits for room if the queue is full.
+    uint8_t read( int idx );
+    void flush();
+    bool busy();                        //True while bytes are still being written.
+    uint16_t pending();                 //Number of them.
+
+    template< typename T > T &get( int idx, T &t ){
+        flush();
+        return EEPROM.get( idx, t );
+    }
+
+    template< typename T > const T &put( int idx, const T &t ){
+        const uint8_t *ptr = (const uint8_t*) &t;
+        for( int count = sizeof(T) ; count ; --count )  write( idx++, *ptr++ );
+        return t;
+    }
+};
+
+static EEPROMQueueClass EEPROMQueue;
+#endif
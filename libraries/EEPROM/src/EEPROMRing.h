@@ -0,0 +1,107 @@
+/*
+  EEPROMRing.h - Wear-leveled record store for the EEPROM library
+  Copyright (c) 2026 Arduino.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef EEPROMRing_h
+#define EEPROMRing_h
+
+#include <EEPROM.h>
+
+/***
+    EEPROMRing class.
+
+    Keeps the latest of a series of records of type T in a region of the
+    EEPROM. Every put() goes to the slot after the previous one, so each
+    cell is only written once per round through the region, and the
+    region lasts as many times longer than a fixed address as it has
+    slots (length / (sizeof(T) + 2)).
+
+    Each slot starts with a 16-bit sequence number, one higher than in the
+    slot before (0xFFFF, an erased cell, is skipped). begin() walks the
+    slots once until the numbers stop counting up, which marks the latest
+    record; from then on get() and put() know where it is. The number is
+    written after the record, so a reset in the middle of put() leaves the
+    previous record as the latest. Call begin() before the first put().
+***/
+
+template< typename T >
+struct EEPROMRing{
+
+    EEPROMRing( const int start, const int length )
+        : start( start ), count( length / slotSize ), latest( -1 ), seq( 0 ) {}
+
+    //Finds the latest record, returns false if there is none yet.
+    bool begin(){
+        latest = -1;
+        if( !count ) return false;
+
+        uint16_t s = readSeq( 0 );
+        if( s == 0xFFFF ) return false;
+
+        int i = 0;
+        while( i + 1 < count && readSeq( i + 1 ) == next( s ) ){
+            s = next( s );
+            ++i;
+        }
+        latest = i;
+        seq = s;
+        return true;
+    }
+
+    //Copies the latest record into t, returns false if there is none.
+    bool get( T &t ){
+        if( latest < 0 ) return false;
+        EEPROM.get( address( latest ) + 2, t );
+        return true;
+    }
+
+    //Stores t as the new latest record.
+    const T &put( const T &t ){
+        int slot = latest + 1 < count ? latest + 1 : 0;
+        uint16_t s = latest < 0 ? 0 : next( seq );
+        EEPROM.put( address( slot ) + 2, t );
+        EEPROM.put( address( slot ), s );
+        latest = slot;
+        seq = s;
+        return t;
+    }
+
+    //Forgets all records, by erasing the sequence numbers. Do this once
+    //for a region that held other data before, so no left over bytes
+    //look like part of the series.
+    void clear(){
+        for( int i = 0 ; i < count ; ++i )  EEPROM.put( address( i ), (uint16_t) 0xFFFF );
+        latest = -1;
+    }
+
+    int slots() const                   { return count; }
+
+    static const int slotSize = sizeof(T) + 2;
+
+    private:
+        int address( int slot ) const   { return start + slot * slotSize; }
+        uint16_t readSeq( int slot )    { uint16_t s; return EEPROM.get( address( slot ), s ); }
+        static uint16_t next( uint16_t s ){ return s == 0xFFFE ? 0 : s + 1; }
+
+        int start;
+        int count;
+        int latest;     //Slot of the latest record, -1 if there is none.
+        uint16_t seq;   //Its sequence number.
+};
+
+#endif
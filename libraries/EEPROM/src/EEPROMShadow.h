@@ -0,0 +1,109 @@
+/*
+  EEPROMShadow.h - RAM copy of an EEPROM region for the EEPROM library
+  Copyright (c) 2026 Arduino.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef EEPROMShadow_h
+#define EEPROMShadow_h
+
+#include <string.h>
+#include <EEPROM.h>
+
+/***
+    EEPROMShadow class.
+
+    Keeps the N bytes of EEPROM from start on in RAM. begin() loads them,
+    after which read() and get() never touch the EEPROM. write() and put()
+    change the RAM copy and mark the bytes that really changed as dirty,
+    one bit per byte; commit() writes them all, or commitStep() one at a
+    time whenever the EEPROM is idle, so calling it from loop() saves
+    the changes without ever waiting for a write. Changing a byte back
+    before it is committed costs no write at all.
+
+    Indexes are relative to start.
+***/
+
+template< int N >
+struct EEPROMShadow{
+
+    EEPROMShadow( const int start )
+        : start( start ), next( 0 ), count( 0 ) {}
+
+    void begin(){
+        eeprom_read_block( shadow, (const void*) start, N );
+        memset( dirtyBits, 0, sizeof(dirtyBits) );
+        count = 0;
+    }
+
+    uint8_t read( int idx ) const       { return shadow[ idx ]; }
+    uint8_t operator[]( int idx ) const { return shadow[ idx ]; }
+    const uint8_t *data() const         { return shadow; }
+
+    void write( int idx, uint8_t val ){
+        if( shadow[ idx ] == val ) return;
+        shadow[ idx ] = val;
+        uint8_t bit = _BV( idx & 7 );
+        if( !( dirtyBits[ idx >> 3 ] & bit ) ){
+            dirtyBits[ idx >> 3 ] |= bit;
+            ++count;
+        }
+    }
+
+    template< typename T > T &get( int idx, T &t ) const{
+        memcpy( &t, shadow + idx, sizeof(T) );
+        return t;
+    }
+
+    template< typename T > const T &put( int idx, const T &t ){
+        const uint8_t *ptr = (const uint8_t*) &t;
+        for( int i = 0 ; i < (int) sizeof(T) ; ++i )  write( idx + i, ptr[ i ] );
+        return t;
+    }
+
+    //Number of bytes changed since they were last committed.
+    int dirty() const                   { return count; }
+
+    //Writes the next dirty byte if the EEPROM is idle, returns false if
+    //it was busy or nothing was dirty.
+    bool commitStep(){
+        if( !count || ( EECR & _BV(EEPE) ) ) return false;
+        while( !( dirtyBits[ next >> 3 ] & _BV( next & 7 ) ) )  next = next + 1 < N ? next + 1 : 0;
+        dirtyBits[ next >> 3 ] &= ~_BV( next & 7 );
+        --count;
+        EEPROM.update( start + next, shadow + next, 1 );
+        return true;
+    }
+
+    //Writes all dirty bytes, returns how many there were.
+    int commit(){
+        int written = count;
+        while( count ){
+            while( EECR & _BV(EEPE) );
+            commitStep();
+        }
+        return written;
+    }
+
+    private:
+        int start;
+        int next;       //Where commitStep() looks first.
+        int count;      //Number of bits set in dirtyBits.
+        uint8_t shadow[ N ];
+        uint8_t dirtyBits[ ( N + 7 ) / 8 ];
+};
+
+#endif
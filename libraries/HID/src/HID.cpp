@@ -30,11 +30,21 @@ int HID_::getInterface(uint8_t* interfaceCount)
 {
 	*interfaceCount += 1; // uses 1
 	HIDDescriptor hidInterface = {
-		D_INTERFACE(pluggedInterface, 1, USB_DEVICE_CLASS_HUMAN_INTERFACE, HID_SUBCLASS_NONE, HID_PROTOCOL_NONE),
+		D_INTERFACE(pluggedInterface, 1 + HID_OUT_ENDPOINT, USB_DEVICE_CLASS_HUMAN_INTERFACE, HID_SUBCLASS_NONE, HID_PROTOCOL_NONE),
 		D_HIDREPORT(descriptorSize),
-		D_ENDPOINT(USB_ENDPOINT_IN(pluggedEndpoint), USB_ENDPOINT_TYPE_INTERRUPT, USB_EP_SIZE, 0x01)
+		D_ENDPOINT(USB_ENDPOINT_IN(pluggedEndpoint), USB_ENDPOINT_TYPE_INTERRUPT, USB_EP_SIZE, interval)
 	};
-	return USB_SendControl(0, &hidInterface, sizeof(hidInterface));
+	int r = USB_SendControl(0, &hidInterface, sizeof(hidInterface));
+#if HID_OUT_ENDPOINT
+	if (r < 0)
+		return r;
+	EndpointDescriptor out = D_ENDPOINT(USB_ENDPOINT_OUT(pluggedEndpoint + 1), USB_ENDPOINT_TYPE_INTERRUPT, USB_EP_SIZE, interval);
+	int r2 = USB_SendControl(0, &out, sizeof(out));
+	if (r2 < 0)
+		return r2;
+	r += r2;
+#endif
+	return r;
 }
 
 int HID_::getDescriptor(USBSetup& setup)
@@ -88,6 +98,15 @@ void HID_::AppendDescriptor(HIDSubDescriptor *node)
 
 int HID_::SendReport(uint8_t id, const void* data, int len)
 {
+	// ID and report in one packet, rather than two transfers which can
+	// each wait for the host
+	if (len >= 0 && len < USB_EP_SIZE) {
+		uint8_t packet[USB_EP_SIZE];
+		packet[0] = id;
+		memcpy(packet + 1, data, len);
+		return USB_Send(pluggedEndpoint | TRANSFER_RELEASE, packet, len + 1);
+	}
+
 	auto ret = USB_Send(pluggedEndpoint, &id, 1);
 	if (ret < 0) return ret;
 	auto ret2 = USB_Send(pluggedEndpoint | TRANSFER_RELEASE, data, len);
@@ -95,6 +114,85 @@ int HID_::SendReport(uint8_t id, const void* data, int len)
 	return ret + ret2;
 }
 
+static inline uint8_t queueNext(uint8_t i)
+{
+	return (uint8_t)(i + 1) % HID_QUEUE_SIZE;
+}
+
+int HID_::QueueReport(uint8_t id, const void* data, int len)
+{
+	if (len < 0 || len >= USB_EP_SIZE)
+		return -1;
+	uint8_t n = len + 1;
+
+	if (queueHead == queueTail && USB_SendSpace(pluggedEndpoint) >= n)
+		return SendReport(id, data, len);
+
+	uint8_t head = queueHead;
+	uint8_t space = ((unsigned int)(HID_QUEUE_SIZE + queueTail - head - 1)) % HID_QUEUE_SIZE;
+	if (space < n + 1)
+		return -1;
+
+	const uint8_t* src = (const uint8_t*)data;
+	queue[head] = n;
+	head = queueNext(head);
+	queue[head] = id;
+	head = queueNext(head);
+	while (len--) {
+		queue[head] = *src++;
+		head = queueNext(head);
+	}
+	queueHead = head;
+	return n;
+}
+
+#if HID_OUT_ENDPOINT
+int HID_::ReceiveReport(void* data, int len)
+{
+	if (outputHandler || len < 0 || !USB_Available(pluggedEndpoint + 1))
+		return -1;
+
+	// a whole packet at a time, so the next call starts at a report
+	uint8_t packet[USB_EP_SIZE];
+	int n = USB_Recv(pluggedEndpoint + 1, packet, sizeof(packet));
+	if (n < 0)
+		return n;
+	memcpy(data, packet, min(n, len));
+	return n;
+}
+#endif
+
+// Sends the oldest queued report once the bank is free; the interrupt
+// endpoint has one bank, so that is at most one report per frame. Also
+// hands a received output report to the handler.
+void HID_::startOfFrame(void)
+{
+#if HID_OUT_ENDPOINT
+	if (outputHandler && USB_Available(pluggedEndpoint + 1)) {
+		uint8_t report[USB_EP_SIZE];
+		int n = USB_Recv(pluggedEndpoint + 1, report, sizeof(report));
+		if (n > 0)
+			outputHandler(report, n);
+	}
+#endif
+
+	if (queueHead == queueTail)
+		return;
+
+	uint8_t tail = queueTail;
+	uint8_t n = queue[tail];
+	if (USB_SendSpace(pluggedEndpoint) < n)
+		return;
+
+	uint8_t packet[USB_EP_SIZE];
+	for (uint8_t i = 0; i < n; i++) {
+		tail = queueNext(tail);
+		packet[i] = queue[tail];
+	}
+	USB_Send(pluggedEndpoint | TRANSFER_RELEASE | TRANSFER_NOWAIT, packet, n);
+	queueTail = queueNext(tail);
+}
+
 bool HID_::setup(USBSetup& setup)
 {
 	if (pluggedInterface != setup.wIndex) {
@@ -133,24 +231,32 @@ bool HID_::setup(USBSetup& setup)
 		}
 		if (request == HID_SET_REPORT)
 		{
-			//uint8_t reportID = setup.wValueL;
-			//uint16_t length = setup.wLength;
-			//uint8_t data[length];
-			// Make sure to not read more data than USB_EP_SIZE.
-			// You can read multiple times through a loop.
-			// The first byte (may!) contain the reportID on a multreport.
-			//USB_RecvControl(data, length);
+			// The first byte is the report ID if the descriptor uses
+			// IDs. Longer reports than one packet are not taken.
+			uint16_t length = setup.wLength;
+			if (setup.wValueH != HID_REPORT_TYPE_OUTPUT || !outputHandler || length > USB_EP_SIZE)
+				return false;
+			uint8_t report[USB_EP_SIZE];
+			if (USB_RecvControl(report, length) != length)
+				return false;
+			outputHandler(report, length);
+			return true;
 		}
 	}
 
 	return false;
 }
 
-HID_::HID_(void) : PluggableUSBModule(1, 1, epType),
+HID_::HID_(void) : PluggableUSBModule(1 + HID_OUT_ENDPOINT, 1, epType),
+                   interval(HID_INTERVAL), outputHandler(NULL),
+                   queueHead(0), queueTail(0),
                    rootNode(NULL), descriptorSize(0),
                    protocol(HID_REPORT_PROTOCOL), idle(1)
 {
 	epType[0] = EP_TYPE_INTERRUPT_IN;
+#if HID_OUT_ENDPOINT
+	epType[1] = EP_TYPE_INTERRUPT_OUT;
+#endif
 	PluggableUSB().plug(this);
 }
 
@@ -59,6 +59,28 @@
 #define HID_REPORT_TYPE_OUTPUT  2
 #define HID_REPORT_TYPE_FEATURE 3
 
+// Bytes of the QueueReport() queue; a report takes its length plus two
+#ifndef HID_QUEUE_SIZE
+#define HID_QUEUE_SIZE 32
+#endif
+#if (HID_QUEUE_SIZE > 256) || (HID_QUEUE_SIZE < 4)
+#error HID_QUEUE_SIZE must be between 4 and 256
+#endif
+
+// How often the host polls the endpoints, in ms (frames), 1 to 255.
+// setInterval() changes it for the next enumeration.
+#ifndef HID_INTERVAL
+#define HID_INTERVAL 1
+#endif
+
+// Build with HID_OUT_ENDPOINT=1 to give the interface an interrupt OUT
+// endpoint. Hosts then send output reports (LEDs, force feedback) over
+// it, one interrupt transfer each, instead of as SET_REPORT control
+// transfers with their setup, data and status stages.
+#ifndef HID_OUT_ENDPOINT
+#define HID_OUT_ENDPOINT 0
+#endif
+
 typedef struct
 {
   uint8_t len;      // 9
@@ -94,7 +116,26 @@ public:
   HID_(void);
   int begin(void);
   int SendReport(uint8_t id, const void* data, int len);
+  // Never blocks: sends the report right away if the endpoint bank is
+  // free and nothing is queued, otherwise queues it for the next start
+  // of frame. Returns -1 when the queue is full. Reports sent with
+  // SendReport() meanwhile can overtake queued ones.
+  int QueueReport(uint8_t id, const void* data, int len);
   void AppendDescriptor(HIDSubDescriptor* node);
+  // Polling interval in ms, sent to the host when it enumerates the
+  // device. Call it before USB is attached, or detach and attach again.
+  void setInterval(uint8_t ms) { interval = ms ? ms : 1; }
+  // Output reports from the host, with the report ID as the first byte
+  // if the report descriptor uses IDs. The handler is called from the
+  // USB interrupt, once per report, both for SET_REPORT requests and,
+  // with HID_OUT_ENDPOINT, for reports on the OUT endpoint.
+  void onOutputReport(void (*handler)(const uint8_t* report, uint8_t len)) { outputHandler = handler; }
+#if HID_OUT_ENDPOINT
+  // Copies the next report from the OUT endpoint, as far as it fits in
+  // len bytes. Returns its length, or -1 if none came or a handler is
+  // set with onOutputReport().
+  int ReceiveReport(void* data, int len);
+#endif
 
 protected:
   // Implementation of the PluggableUSBModule
@@ -102,9 +143,16 @@ protected:
   int getDescriptor(USBSetup& setup);
   bool setup(USBSetup& setup);
   uint8_t getShortName(char* name);
+  void startOfFrame(void);
 
 private:
-  uint8_t epType[1];
+  uint8_t epType[1 + HID_OUT_ENDPOINT];
+  uint8_t interval;
+  void (*outputHandler)(const uint8_t* report, uint8_t len);
+
+  uint8_t queue[HID_QUEUE_SIZE];
+  volatile uint8_t queueHead;
+  volatile uint8_t queueTail;
 
   HIDSubDescriptor* rootNode;
   uint16_t descriptorSize;
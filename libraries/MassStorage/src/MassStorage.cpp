@@ -0,0 +1,360 @@
+/*
+  MassStorage.cpp - USB mass storage (Bulk-Only Transport) for PluggableUSB
+  Copyright (c) 2026 Arduino.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "MassStorage.h"
+
+#if defined(USBCON)
+
+#define MSC_EP_OUT (pluggedEndpoint)
+#define MSC_EP_IN  (pluggedEndpoint + 1)
+
+#define MSC_SUBCLASS_SCSI  0x06
+#define MSC_PROTOCOL_BOT   0x50
+
+// Class requests of the Bulk-Only Transport
+#define MSC_REQUEST_RESET    0xFF
+#define MSC_REQUEST_MAX_LUN  0xFE
+
+#define MSC_CBW_SIGNATURE  0x43425355UL  // "USBC"
+#define MSC_CSW_SIGNATURE  0x53425355UL  // "USBS"
+
+#define MSC_STATUS_PASSED  0
+#define MSC_STATUS_FAILED  1
+
+// SCSI operation codes
+#define SCSI_TEST_UNIT_READY          0x00
+#define SCSI_REQUEST_SENSE            0x03
+#define SCSI_INQUIRY                  0x12
+#define SCSI_MODE_SENSE_6             0x1A
+#define SCSI_START_STOP_UNIT          0x1B
+#define SCSI_PREVENT_ALLOW_REMOVAL    0x1E
+#define SCSI_READ_FORMAT_CAPACITIES   0x23
+#define SCSI_READ_CAPACITY_10         0x25
+#define SCSI_READ_10                  0x28
+#define SCSI_WRITE_10                 0x2A
+#define SCSI_VERIFY_10                0x2F
+#define SCSI_SYNCHRONIZE_CACHE_10     0x35
+#define SCSI_MODE_SENSE_10            0x5A
+
+// Sense keys and additional sense codes
+#define SENSE_NONE             0x00
+#define SENSE_NOT_READY        0x02
+#define SENSE_MEDIUM_ERROR     0x03
+#define SENSE_ILLEGAL_REQUEST  0x05
+#define SENSE_DATA_PROTECT     0x07
+
+#define ASC_NONE                    0x00
+#define ASC_WRITE_FAULT             0x03
+#define ASC_READ_ERROR              0x11
+#define ASC_INVALID_COMMAND         0x20
+#define ASC_LBA_OUT_OF_RANGE        0x21
+#define ASC_WRITE_PROTECTED         0x27
+#define ASC_MEDIUM_NOT_PRESENT      0x3A
+
+// How long a command waits for the host to send its data
+#define MSC_RECV_TIMEOUT USB_SEND_TIMEOUT
+
+static const uint8_t inquiryData[36] PROGMEM = {
+  0x00,                   // direct access block device
+  0x80,                   // removable
+  0x04,                   // SPC-2
+  0x02,                   // response data format
+  31,                     // additional length
+  0, 0, 0,
+  'A', 'r', 'd', 'u', 'i', 'n', 'o', ' ',
+  'M', 'a', 's', 's', ' ', 'S', 't', 'o', 'r', 'a', 'g', 'e', ' ', ' ', ' ', ' ',
+  '1', '.', '0', ' '
+};
+
+static inline uint32_t be32(const uint8_t *p)
+{
+  return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint16_t)p[2] << 8) | p[3];
+}
+
+static inline void putBe32(uint8_t *p, uint32_t v)
+{
+  p[0] = v >> 24;
+  p[1] = v >> 16;
+  p[2] = v >> 8;
+  p[3] = v;
+}
+
+MassStorage_& MassStorage()
+{
+  static MassStorage_ obj;
+  return obj;
+}
+
+int MassStorage_::getInterface(uint8_t* interfaceCount)
+{
+  *interfaceCount += 1; // uses 1
+  MassStorageDescriptor mscInterface = {
+    D_INTERFACE(pluggedInterface, 2, USB_DEVICE_CLASS_STORAGE, MSC_SUBCLASS_SCSI, MSC_PROTOCOL_BOT),
+    D_ENDPOINT(USB_ENDPOINT_OUT(MSC_EP_OUT), USB_ENDPOINT_TYPE_BULK, USB_EP_SIZE, 0),
+    D_ENDPOINT(USB_ENDPOINT_IN(MSC_EP_IN), USB_ENDPOINT_TYPE_BULK, USB_EP_SIZE, 0)
+  };
+  return USB_SendControl(0, &mscInterface, sizeof(mscInterface));
+}
+
+int MassStorage_::getDescriptor(USBSetup& setup)
+{
+  (void)setup;
+  return 0;
+}
+
+uint8_t MassStorage_::getShortName(char *name)
+{
+  name[0] = 'M';
+  name[1] = 'S';
+  name[2] = 'C';
+  return 3;
+}
+
+bool MassStorage_::setup(USBSetup& setup)
+{
+  if (pluggedInterface != setup.wIndex) {
+    return false;
+  }
+
+  if (setup.bmRequestType == REQUEST_DEVICETOHOST_CLASS_INTERFACE &&
+      setup.bRequest == MSC_REQUEST_MAX_LUN) {
+    uint8_t maxLun = 0;
+    return USB_SendControl(0, &maxLun, 1) >= 0;
+  }
+  if (setup.bmRequestType == REQUEST_HOSTTODEVICE_CLASS_INTERFACE &&
+      setup.bRequest == MSC_REQUEST_RESET) {
+    // commands run to completion in poll(), so there is nothing to abort
+    senseKey = SENSE_NONE;
+    senseAsc = ASC_NONE;
+    return true;
+  }
+  return false;
+}
+
+MassStorage_::MassStorage_(void) : PluggableUSBModule(2, 1, epType),
+                                   device(NULL), remaining(0), dataIn(false),
+                                   senseKey(SENSE_NONE), senseAsc(ASC_NONE)
+{
+  epType[0] = EP_TYPE_BULK_OUT;
+  epType[1] = EP_TYPE_BULK_IN;
+  PluggableUSB().plug(this);
+}
+
+int MassStorage_::begin(MassStorageDevice *dev)
+{
+  device = dev;
+  return 0;
+}
+
+// Sends up to len bytes of the data phase, never more than the host
+// asked for. A full last bank is sent without a zero length packet, as
+// the host knows the length; the CSW follows right after.
+int MassStorage_::sendData(const void *data, uint16_t len, uint8_t flags)
+{
+  if (!dataIn)
+    return 0;
+  if (len > remaining)
+    len = remaining;
+  if (len == 0)
+    return 0;
+  int r = USB_Send(MSC_EP_IN | TRANSFER_NOZLP | TRANSFER_RELEASE | flags, data, len);
+  if (r > 0)
+    remaining -= r;
+  return r;
+}
+
+// Receives exactly len bytes of the data phase, across packets
+int MassStorage_::recvData(void *data, uint16_t len)
+{
+  uint8_t *p = (uint8_t *)data;
+  uint16_t got = 0;
+  unsigned long start = millis();
+
+  if (dataIn)
+    return 0;
+  if (len > remaining)
+    len = remaining;
+  while (got < len) {
+    int r = USB_Recv(MSC_EP_OUT, p + got, len - got);
+    if (r < 0)
+      return -1;
+    if (r > 0) {
+      got += r;
+      start = millis();
+    } else if (millis() - start >= MSC_RECV_TIMEOUT) {
+      return -1;
+    }
+  }
+  remaining -= got;
+  return got;
+}
+
+uint8_t MassStorage_::fail(uint8_t key, uint8_t asc)
+{
+  senseKey = key;
+  senseAsc = asc;
+  return MSC_STATUS_FAILED;
+}
+
+// READ(10) and WRITE(10), MSC_CHUNK_SIZE bytes at a time
+uint8_t MassStorage_::transfer(const uint8_t *cb, bool write)
+{
+  uint32_t lba = be32(cb + 2);
+  uint16_t blocks = ((uint16_t)cb[7] << 8) | cb[8];
+  uint8_t chunk[MSC_CHUNK_SIZE];
+
+  if (lba + blocks > device->blockCount() || lba + blocks < lba)
+    return fail(SENSE_ILLEGAL_REQUEST, ASC_LBA_OUT_OF_RANGE);
+  if (write && device->writeProtected())
+    return fail(SENSE_DATA_PROTECT, ASC_WRITE_PROTECTED);
+
+  for (; blocks; blocks--, lba++) {
+    for (uint16_t offset = 0; offset < MSC_BLOCK_SIZE; offset += MSC_CHUNK_SIZE) {
+      if (remaining < MSC_CHUNK_SIZE)
+        return fail(SENSE_ILLEGAL_REQUEST, ASC_INVALID_COMMAND);
+      if (write) {
+        if (recvData(chunk, MSC_CHUNK_SIZE) != MSC_CHUNK_SIZE)
+          return MSC_STATUS_FAILED;
+        if (!device->writeBlock(lba, offset, chunk, MSC_CHUNK_SIZE))
+          return fail(SENSE_MEDIUM_ERROR, ASC_WRITE_FAULT);
+      } else {
+        if (!device->readBlock(lba, offset, chunk, MSC_CHUNK_SIZE))
+          return fail(SENSE_MEDIUM_ERROR, ASC_READ_ERROR);
+        if (sendData(chunk, MSC_CHUNK_SIZE) != MSC_CHUNK_SIZE)
+          return MSC_STATUS_FAILED;
+      }
+    }
+  }
+  return MSC_STATUS_PASSED;
+}
+
+uint8_t MassStorage_::command(const uint8_t *cb)
+{
+  uint8_t op = cb[0];
+  uint8_t data[18];
+
+  if (op == SCSI_INQUIRY) {
+    sendData(inquiryData, sizeof(inquiryData), TRANSFER_PGM);
+    return MSC_STATUS_PASSED;
+  }
+  if (op == SCSI_REQUEST_SENSE) {
+    memset(data, 0, sizeof(data));
+    data[0] = 0x70;           // current errors, fixed format
+    data[2] = senseKey;
+    data[7] = 10;             // additional length
+    data[12] = senseAsc;
+    senseKey = SENSE_NONE;
+    senseAsc = ASC_NONE;
+    sendData(data, 18);
+    return MSC_STATUS_PASSED;
+  }
+
+  uint32_t blocks = device ? device->blockCount() : 0;
+  if (blocks == 0)
+    return fail(SENSE_NOT_READY, ASC_MEDIUM_NOT_PRESENT);
+
+  switch (op) {
+    case SCSI_TEST_UNIT_READY:
+    case SCSI_PREVENT_ALLOW_REMOVAL:
+    case SCSI_VERIFY_10:
+      return MSC_STATUS_PASSED;
+
+    case SCSI_START_STOP_UNIT:
+    case SCSI_SYNCHRONIZE_CACHE_10:
+      device->sync();
+      return MSC_STATUS_PASSED;
+
+    case SCSI_READ_CAPACITY_10:
+      putBe32(data, blocks - 1);
+      putBe32(data + 4, MSC_BLOCK_SIZE);
+      sendData(data, 8);
+      return MSC_STATUS_PASSED;
+
+    case SCSI_READ_FORMAT_CAPACITIES:
+      memset(data, 0, 12);
+      data[3] = 8;              // capacity list length
+      putBe32(data + 4, blocks);
+      // formatted media of MSC_BLOCK_SIZE blocks
+      putBe32(data + 8, (0x02UL << 24) | MSC_BLOCK_SIZE);
+      sendData(data, 12);
+      return MSC_STATUS_PASSED;
+
+    case SCSI_MODE_SENSE_6:
+      // header only, no mode pages
+      data[0] = 3;
+      data[1] = 0;
+      data[2] = device->writeProtected() ? 0x80 : 0;
+      data[3] = 0;
+      sendData(data, 4);
+      return MSC_STATUS_PASSED;
+
+    case SCSI_MODE_SENSE_10:
+      memset(data, 0, 8);
+      data[1] = 6;
+      data[3] = device->writeProtected() ? 0x80 : 0;
+      sendData(data, 8);
+      return MSC_STATUS_PASSED;
+
+    case SCSI_READ_10:
+      return transfer(cb, false);
+
+    case SCSI_WRITE_10:
+      return transfer(cb, true);
+  }
+  return fail(SENSE_ILLEGAL_REQUEST, ASC_INVALID_COMMAND);
+}
+
+void MassStorage_::poll(void)
+{
+  MSCCommandBlock cbw;
+  int n = USB_Available(MSC_EP_OUT);
+
+  if (n == 0)
+    return;
+  // anything but a command block out of turn is dropped
+  if (USB_Recv(MSC_EP_OUT, &cbw, sizeof(cbw)) != sizeof(cbw) ||
+      n != sizeof(cbw) || cbw.signature != MSC_CBW_SIGNATURE)
+    return;
+
+  remaining = cbw.dataLength;
+  dataIn = cbw.flags & 0x80;
+  uint8_t status = command(cbw.cb);
+
+  // What the command did not send or take of the data phase: the host
+  // gets zeros, or its data is dropped, and the residue tells it how
+  // much that was. A short packet already ended the data phase.
+  uint32_t residue = remaining;
+  if (dataIn) {
+    if ((cbw.dataLength - remaining) % USB_EP_SIZE)
+      remaining = 0;
+    while (remaining)
+      if (sendData(NULL, remaining < USB_EP_SIZE ? remaining : USB_EP_SIZE, TRANSFER_ZERO) <= 0)
+        return;
+  } else {
+    uint8_t chunk[USB_EP_SIZE];
+    while (remaining)
+      if (recvData(chunk, remaining < USB_EP_SIZE ? remaining : USB_EP_SIZE) <= 0)
+        return;
+  }
+
+  MSCCommandStatus csw = { MSC_CSW_SIGNATURE, cbw.tag, residue, status };
+  USB_Send(MSC_EP_IN | TRANSFER_NOZLP | TRANSFER_RELEASE, &csw, sizeof(csw));
+}
+
+#endif /* if defined(USBCON) */
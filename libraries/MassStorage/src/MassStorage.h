@@ -0,0 +1,137 @@
+/*
+  MassStorage.h - USB mass storage (Bulk-Only Transport) for PluggableUSB
+  Copyright (c) 2026 Arduino.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef MassStorage_h
+#define MassStorage_h
+
+#include <stdint.h>
+#include <Arduino.h>
+#include "PluggableUSB.h"
+
+#if defined(USBCON)
+
+// One interface of the mass storage class (SCSI transparent command set,
+// Bulk-Only Transport) with a bulk OUT and a bulk IN endpoint, so the
+// host mounts the device as a removable drive and copies files at bulk
+// speed, with its own caching. The host sees whatever file system the
+// block device holds; a FAT image written with the sketch's own file
+// system library works on all desktop systems.
+//
+// The commands are handled by poll(), which has to be called from
+// loop() often enough to keep the host happy: it waits for nothing when
+// no command came, but then runs the whole command, reads and writes of
+// many blocks included. The block device is only accessed from poll(),
+// so it may share the SPI bus with the rest of the sketch. While the host
+// has the drive mounted, the sketch must not change its contents behind
+// its back.
+
+#define MSC_BLOCK_SIZE 512
+// The block device gets each block in pieces of this many bytes, in
+// order, so it needs no block buffer of its own
+#define MSC_CHUNK_SIZE USB_EP_SIZE
+
+class MassStorageDevice
+{
+public:
+  // Number of MSC_BLOCK_SIZE blocks, 0 if there is no medium
+  virtual uint32_t blockCount(void) = 0;
+  // Bytes offset to offset + len of block lba; offset runs from 0 to
+  // MSC_BLOCK_SIZE - MSC_CHUNK_SIZE in steps of MSC_CHUNK_SIZE for
+  // each block, and blocks come in the order the host asks for them.
+  // Return false on an error.
+  virtual bool readBlock(uint32_t lba, uint16_t offset, uint8_t *data, uint8_t len) = 0;
+  virtual bool writeBlock(uint32_t lba, uint16_t offset, const uint8_t *data, uint8_t len) = 0;
+  // Writes cached data out, when the host syncs or ejects the drive
+  virtual void sync(void) { }
+  virtual bool writeProtected(void) { return false; }
+};
+
+typedef struct
+{
+  uint32_t signature;     // MSC_CBW_SIGNATURE
+  uint32_t tag;
+  uint32_t dataLength;
+  uint8_t  flags;         // bit 7 set for data to the host
+  uint8_t  lun;
+  uint8_t  cbLength;
+  uint8_t  cb[16];
+} MSCCommandBlock;
+
+typedef struct
+{
+  uint32_t signature;     // MSC_CSW_SIGNATURE
+  uint32_t tag;
+  uint32_t residue;
+  uint8_t  status;
+} MSCCommandStatus;
+
+typedef struct
+{
+  InterfaceDescriptor iface;
+  EndpointDescriptor  out;
+  EndpointDescriptor  in;
+} MassStorageDescriptor;
+
+class MassStorage_ : public PluggableUSBModule
+{
+public:
+  MassStorage_(void);
+  // Serves device to the host from now on; with NULL, the drive reports
+  // that there is no medium
+  int begin(MassStorageDevice *device);
+  int begin(MassStorageDevice &device) { return begin(&device); }
+  void end(void) { begin(NULL); }
+  // Runs a command of the host if one came, see above
+  void poll(void);
+
+protected:
+  // Implementation of the PluggableUSBModule
+  int getInterface(uint8_t* interfaceCount);
+  int getDescriptor(USBSetup& setup);
+  bool setup(USBSetup& setup);
+  uint8_t getShortName(char* name);
+
+private:
+  uint8_t command(const uint8_t *cb);
+  uint8_t transfer(const uint8_t *cb, bool write);
+  int sendData(const void *data, uint16_t len, uint8_t flags = 0);
+  int recvData(void *data, uint16_t len);
+  uint8_t fail(uint8_t key, uint8_t asc);
+
+  uint8_t epType[2];
+
+  MassStorageDevice *device;
+  // data bytes of the current command the host still expects, and
+  // whether they go to the host
+  uint32_t remaining;
+  bool dataIn;
+
+  // REQUEST SENSE data of the last command
+  uint8_t senseKey;
+  uint8_t senseAsc;
+};
+
+// Replacement for global singleton.
+// This function prevents static-initialization-order-fiasco
+// https://isocpp.org/wiki/faq/ctors#static-init-order-on-first-use
+MassStorage_& MassStorage();
+
+#endif // USBCON
+
+#endif // MassStorage_h
@@ -0,0 +1,143 @@
+/*
+  SPI Benchmark
+
+  Measures how fast each way of moving data over SPI runs at every clock
+  divider, and prints the throughput in bytes per second and the CPU
+  clock cycles spent per byte. At fosc/2 a byte takes 16 cycles on the
+  wire, so anything above that is overhead between bytes.
+
+  Nothing needs to be connected: MISO reads back whatever it floats at,
+  which doesn't matter for the timing. Pin 10 (the chip select of the
+  SPIDevice and asynchronous tests) toggles during the run.
+
+  The cycle counter uses Timer1, so PWM on its pins stops while this
+  runs. Interrupts stay enabled, so the millis() tick adds a little
+  noise to each result.
+
+  created 14 Oct 2026
+*/
+
+#include <SPI.h>
+
+const uint8_t csPin = 10;
+const size_t blockSize = 256;
+
+uint8_t buffer[blockSize];
+SPISettings settings;
+SPIDevice *device;
+SPIAsyncTransfer asyncTransfer;
+volatile bool asyncDone;
+
+// every test moves blockSize bytes
+
+void testTransfer8() {
+  SPI.beginTransaction(settings);
+  for (size_t i = 0; i < blockSize; i++)
+    buffer[i] = SPI.transfer(buffer[i]);
+  SPI.endTransaction();
+}
+
+void testTransfer16() {
+  uint16_t *words = (uint16_t *)buffer;
+  SPI.beginTransaction(settings);
+  for (size_t i = 0; i < blockSize / 2; i++)
+    words[i] = SPI.transfer16(words[i]);
+  SPI.endTransaction();
+}
+
+void testTransferBlock() {
+  SPI.beginTransaction(settings);
+  SPI.transfer(buffer, blockSize);
+  SPI.endTransaction();
+}
+
+void testTransmit() {
+  SPI.beginTransaction(settings);
+  SPI.transmit(buffer, blockSize);
+  SPI.endTransaction();
+}
+
+void testReceive() {
+  SPI.beginTransaction(settings);
+  SPI.receive(buffer, blockSize);
+  SPI.endTransaction();
+}
+
+void testDevice() {
+  const SPIOperation ops[] = {
+    { buffer, NULL, blockSize / 2 },
+    { NULL, buffer, blockSize / 2 },
+  };
+  device->run(ops, 2);
+}
+
+void asyncComplete(SPIAsyncTransfer *) {
+  asyncDone = true;
+}
+
+void testAsync() {
+  asyncTransfer.tx = buffer;
+  asyncTransfer.rx = buffer;
+  asyncTransfer.count = blockSize;
+  asyncTransfer.settings = settings;
+  asyncTransfer.csPin = csPin;
+  asyncTransfer.fill = 0xFF;
+  asyncTransfer.callback = asyncComplete;
+  asyncDone = false;
+  if (SPI.transferAsync(&asyncTransfer))
+    while (!asyncDone) ;
+}
+
+struct Test {
+  const char *name;
+  void (*run)();
+};
+
+const Test tests[] = {
+  { "transfer(uint8_t)", testTransfer8 },
+  { "transfer16()", testTransfer16 },
+  { "transfer(buf, n)", testTransferBlock },
+  { "transmit()", testTransmit },
+  { "receive()", testReceive },
+  { "SPIDevice::run()", testDevice },
+  { "transferAsync()", testAsync },
+};
+
+void setup() {
+  Serial.begin(115200);
+  while (!Serial) ; // wait for the serial port on boards with native USB
+
+  pinMode(csPin, OUTPUT);
+  digitalWrite(csPin, HIGH);
+  SPI.begin();
+  beginCycleCounter();
+
+  for (uint8_t divider = 2; divider != 0; divider <<= 1) {
+    settings = SPISettings(F_CPU / divider, MSBFIRST, SPI_MODE0);
+    SPIDevice dev(csPin, settings);
+    dev.begin();
+    device = &dev;
+    Serial.print(F("fosc/"));
+    Serial.println(divider);
+
+    for (size_t t = 0; t < sizeof(tests) / sizeof(tests[0]); t++) {
+      unsigned long start = cycleCounter();
+      tests[t].run();
+      unsigned long cycles = cycleCounter() - start;
+
+      Serial.print(F("  "));
+      Serial.print(tests[t].name);
+      Serial.print('\t');
+      Serial.print((float)F_CPU * blockSize / cycles, 0);
+      Serial.print(F(" bytes/s\t"));
+      Serial.print((float)cycles / blockSize, 1);
+      Serial.println(F(" cycles/byte"));
+    }
+  }
+
+  endCycleCounter();
+  SPI.end();
+}
+
+void loop() {
+}
@@ -12,6 +12,7 @@
  */
 
 #include "SPI.h"
+#include <avr/power.h>
 
 SPIClass SPI;
 
@@ -19,6 +20,7 @@ uint8_t SPIClass::initialized = 0;
 uint8_t SPIClass::interruptMode = 0;
 uint8_t SPIClass::interruptMask = 0;
 uint8_t SPIClass::interruptSave = 0;
+volatile uint8_t SPIClass::busy = 0;
 #ifdef SPI_TRANSACTION_MISMATCH_LED
 uint8_t SPIClass::inTransactionFlag = 0;
 #endif
@@ -44,6 +46,11 @@ void SPIClass::begin()
     // SPI operations).
     pinMode(SS, OUTPUT);
 
+    // init() stopped the SPI clock
+#if defined(power_spi_enable)
+    power_spi_enable();
+#endif
+
     // Warning: if the SS pin ever becomes a LOW INPUT then SPI
     // automatically switches to Slave, so the data direction of
     // the SS pin MUST be kept as OUTPUT.
@@ -72,6 +79,9 @@ void SPIClass::end() {
   // If there are no more references disable SPI
   if (!initialized) {
     SPCR &= ~_BV(SPE);
+#if defined(power_spi_disable)
+    power_spi_disable();
+#endif
     interruptMode = 0;
     #ifdef SPI_TRANSACTION_MISMATCH_LED
     inTransactionFlag = 0;
@@ -199,3 +209,35 @@ void SPIClass::notUsingInterrupt(uint8_t interruptNumber)
     interruptMode = 0;
   SREG = sreg;
 }
+
+void SPIDevice::begin()
+{
+  if (csPin == SPI_NO_CS)
+    return;
+  digitalWrite(csPin, HIGH);
+  pinMode(csPin, OUTPUT);
+  csPort = portOutputRegister(digitalPinToPort(csPin));
+  csMask = digitalPinToBitMask(csPin);
+}
+
+void SPIDevice::run(const SPIOperation *ops, uint8_t count)
+{
+  beginTransaction();
+  for (; count > 0; ops++, count--) {
+    if (!ops->rx) {
+      if (ops->tx) {
+        SPIClass::transmit(ops->tx, ops->count);
+      } else {
+        for (size_t i = 0; i < ops->count; i++)
+          SPIClass::transfer(0xFF);
+      }
+    } else if (!ops->tx) {
+      SPIClass::receive(ops->rx, ops->count);
+    } else {
+      if (ops->tx != ops->rx)
+        memcpy(ops->rx, ops->tx, ops->count);
+      SPIClass::transfer(ops->rx, ops->count);
+    }
+  }
+  endTransaction();
+}
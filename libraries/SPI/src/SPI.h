@@ -150,6 +150,75 @@ private:
   uint8_t spcr;
   uint8_t spsr;
   friend class SPIClass;
+  friend class USARTSPIClass;
+};
+
+// csPin value of an SPIAsyncTransfer that has no chip select
+#define SPI_NO_CS 0xFF
+
+// An interrupt-driven transfer for SPIClass::transferAsync(). The
+// descriptor and its buffers must stay valid until the callback ran.
+struct SPIAsyncTransfer {
+  const uint8_t *tx;  // bytes to send, or NULL to send fill
+  uint8_t *rx;        // received bytes, or NULL to discard them
+  size_t count;
+  SPISettings settings;
+  uint8_t csPin;      // driven LOW during the transfer, or SPI_NO_CS
+  uint8_t fill;
+  // Called from the SPI interrupt once the last byte is in, with the
+  // chip select released; may start the next transfer
+  void (*callback)(SPIAsyncTransfer *transfer);
+};
+
+// One step of SPIDevice::run()
+struct SPIOperation {
+  const void *tx;     // bytes to send, or NULL to send 0xFF
+  void *rx;           // received bytes, or NULL to discard them
+  size_t count;
+};
+
+// A device on the bus: its settings are computed and its chip select port
+// and mask are looked up once, instead of on every transaction. Back to
+// back transactions on the same device don't rewrite SPCR and SPSR.
+class SPIDevice {
+public:
+  SPIDevice(uint8_t csPin, SPISettings settings)
+    : settings(settings), csPin(csPin), csPort(NULL), csMask(0) { }
+  // Makes the chip select an output and drives it HIGH
+  void begin();
+
+  // Gains the bus like SPI.beginTransaction() and drives the chip select
+  // LOW; endTransaction() releases both.
+  inline void beginTransaction();
+  inline void endTransaction();
+
+  // Runs the operations in a single transaction, with the chip select
+  // held LOW from the first byte to the last
+  void run(const SPIOperation *ops, uint8_t count);
+
+private:
+  inline void select() {
+    if (csPort) {
+      uint8_t sreg = SREG;
+      noInterrupts();
+      *csPort &= ~csMask;
+      SREG = sreg;
+    }
+  }
+  inline void deselect() {
+    if (csPort) {
+      uint8_t sreg = SREG;
+      noInterrupts();
+      *csPort |= csMask;
+      SREG = sreg;
+    }
+  }
+
+  SPISettings settings;
+  uint8_t csPin;
+  volatile uint8_t *csPort;
+  uint8_t csMask;
+  friend class SPIClass;
 };
 
 
@@ -176,33 +245,46 @@ public:
   // this function is used to gain exclusive access to the SPI bus
   // and configure the correct settings.
   inline static void beginTransaction(SPISettings settings) {
-    if (interruptMode > 0) {
-      uint8_t sreg = SREG;
-      noInterrupts();
-
-      #ifdef SPI_AVR_EIMSK
-      if (interruptMode == 1) {
-        interruptSave = SPI_AVR_EIMSK;
-        SPI_AVR_EIMSK &= ~interruptMask;
-        SREG = sreg;
-      } else
-      #endif
-      {
-        interruptSave = sreg;
-      }
-    }
-
-    #ifdef SPI_TRANSACTION_MISMATCH_LED
-    if (inTransactionFlag) {
-      pinMode(SPI_TRANSACTION_MISMATCH_LED, OUTPUT);
-      digitalWrite(SPI_TRANSACTION_MISMATCH_LED, HIGH);
-    }
-    inTransactionFlag = 1;
-    #endif
+    acquire();
+    SPCR = settings.spcr;
+    SPSR = settings.spsr;
+  }
+  // The same for a registered device. The settings are only written if
+  // the registers hold different ones, e.g. from the last transaction
+  // being for another device.
+  inline static void beginTransaction(SPIDevice &device) {
+    acquire();
+    loadSettings(device.settings);
+  }
 
+  // A lighter alternative to usingInterrupt() for drivers that use SPI from
+  // an interrupt: instead of having every beginTransaction() mask their
+  // interrupt, they call this from the ISR and, if it returns false
+  // because the bus is taken, retry later (e.g. from loop() or the next
+  // interrupt). Transactions in the sketch then only pay for setting a
+  // flag. Must be called with interrupts disabled, e.g. from an ISR, and
+  // be paired with tryEndTransaction(), as nothing was masked that
+  // endTransaction() would restore.
+  inline static bool tryBeginTransaction(SPISettings settings) {
+    if (busy)
+      return false;
+    busy = 1;
     SPCR = settings.spcr;
     SPSR = settings.spsr;
+    return true;
+  }
+  inline static bool tryBeginTransaction(SPIDevice &device) {
+    if (busy)
+      return false;
+    busy = 1;
+    loadSettings(device.settings);
+    return true;
+  }
+  inline static void tryEndTransaction() {
+    busy = 0;
   }
+  // True while a transaction or an asynchronous transfer holds the bus
+  inline static bool inTransaction() { return busy; }
 
   // Write to the SPI bus (MOSI pin) and also receive (MISO pin)
   inline static uint8_t transfer(uint8_t data) {
@@ -255,6 +337,46 @@ public:
     while (!(SPSR & _BV(SPIF))) ;
     *p = SPDR;
   }
+  // Write only: what comes back on MISO is discarded, so the loop only
+  // has to load the next byte while the current one is shifted out.
+  // Nothing needs to be stored, which keeps the gap between bytes at
+  // the SPIF polling latency even at fosc/2.
+  inline static void transmit(const void *buf, size_t count) {
+    if (count == 0) return;
+    const uint8_t *p = (const uint8_t *)buf;
+    SPDR = *p++;
+    while (--count > 0) {
+      uint8_t out = *p++;
+      while (!(SPSR & _BV(SPIF))) ;
+      SPDR = out;
+    }
+    while (!(SPSR & _BV(SPIF))) ;
+    (void)SPDR; // clears SPIF
+  }
+  // Read only: clocks out fill for every byte (0xFF keeps MOSI high, as
+  // SD cards want it)
+  inline static void receive(void *buf, size_t count, uint8_t fill = 0xFF) {
+    if (count == 0) return;
+    uint8_t *p = (uint8_t *)buf;
+    SPDR = fill;
+    while (--count > 0) {
+      while (!(SPSR & _BV(SPIF))) ;
+      uint8_t in = SPDR;
+      SPDR = fill;
+      *p++ = in;
+    }
+    while (!(SPSR & _BV(SPIF))) ;
+    *p = SPDR;
+  }
+  // transmit(), receive() and transfer() that also return the CRC of the
+  // bytes sent (transmit) or received (receive, transfer), continued
+  // from crc, computed while the bytes are on the bus. CRC7 is the one of
+  // SD commands, sent as (crc << 1) | 1; CRC16 is CCITT/XMODEM, the one
+  // of SD data blocks. See SPICrc.cpp.
+  static uint8_t transmitCRC7(const void *buf, size_t count, uint8_t crc = 0);
+  static uint16_t transmitCRC16(const void *buf, size_t count, uint16_t crc = 0);
+  static uint16_t receiveCRC16(void *buf, size_t count, uint16_t crc = 0, uint8_t fill = 0xFF);
+  static uint16_t transferCRC16(void *buf, size_t count, uint16_t crc = 0);
   // After performing a group of transfers and releasing the chip select
   // signal, this function allows others to access the SPI bus
   inline static void endTransaction(void) {
@@ -266,6 +388,7 @@ public:
     inTransactionFlag = 0;
     #endif
 
+    busy = 0;
     if (interruptMode > 0) {
       #ifdef SPI_AVR_EIMSK
       uint8_t sreg = SREG;
@@ -309,7 +432,65 @@ public:
   inline static void attachInterrupt() { SPCR |= _BV(SPIE); }
   inline static void detachInterrupt() { SPCR &= ~_BV(SPIE); }
 
+  // Starts an interrupt-driven transfer and returns right away, false
+  // if one is still running or the bus is in a transaction. Every byte costs an SPI interrupt, so this
+  // pays off at the slower clock rates, where the CPU would otherwise
+  // spin for most of each byte. No other SPI traffic is allowed until
+  // the callback has run. The SPI_STC_vect handler comes with it, so a
+  // sketch that defines its own handler cannot use this.
+  static bool transferAsync(SPIAsyncTransfer *transfer);
+  inline static bool asyncBusy() { return asyncTransfer != NULL; }
+
+  // Interrupt handler - Not intended to be called externally
+  static void _async_irq(void);
+
 private:
+  // Writes settings unless SPCR and SPSR already hold them. The registers
+  // themselves are compared rather than remembering whose settings were
+  // loaded last, so writes from elsewhere (the deprecated setters,
+  // shiftOutSPI(), another library) and a device object reused at the
+  // same address with new settings are all caught.
+  inline static void loadSettings(const SPISettings &settings) {
+    if (SPCR != settings.spcr || (SPSR & SPI_2XCLOCK_MASK) != settings.spsr) {
+      SPCR = settings.spcr;
+      SPSR = settings.spsr;
+    }
+  }
+
+  // The interrupt masking and mismatch detection of beginTransaction()
+  inline static void acquire() {
+    if (interruptMode > 0) {
+      uint8_t sreg = SREG;
+      noInterrupts();
+
+      #ifdef SPI_AVR_EIMSK
+      if (interruptMode == 1) {
+        interruptSave = SPI_AVR_EIMSK;
+        SPI_AVR_EIMSK &= ~interruptMask;
+        SREG = sreg;
+      } else
+      #endif
+      {
+        interruptSave = sreg;
+      }
+    }
+
+    #ifdef SPI_TRANSACTION_MISMATCH_LED
+    if (inTransactionFlag) {
+      pinMode(SPI_TRANSACTION_MISMATCH_LED, OUTPUT);
+      digitalWrite(SPI_TRANSACTION_MISMATCH_LED, HIGH);
+    }
+    inTransactionFlag = 1;
+    #endif
+
+    busy = 1;
+  }
+
+  static volatile uint8_t busy; // see tryBeginTransaction()
+  static SPIAsyncTransfer * volatile asyncTransfer;
+  static size_t asyncIndex;
+  static volatile uint8_t *asyncCsPort;
+  static uint8_t asyncCsMask;
   static uint8_t initialized;
   static uint8_t interruptMode; // 0=none, 1=mask, 2=global
   static uint8_t interruptMask; // which interrupts to mask
@@ -321,4 +502,14 @@ private:
 
 extern SPIClass SPI;
 
+void SPIDevice::beginTransaction() {
+  SPIClass::beginTransaction(*this);
+  select();
+}
+
+void SPIDevice::endTransaction() {
+  deselect();
+  SPIClass::endTransaction();
+}
+
 #endif
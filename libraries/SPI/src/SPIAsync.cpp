@@ -0,0 +1,86 @@
+/*
+ * Copyright (c) 2026 Arduino.  All right reserved.
+ * Interrupt-driven transfers for the SPI Master library for arduino.
+ *
+ * This file is free software; you can redistribute it and/or modify
+ * it under the terms of either the GNU General Public License version 2
+ * or the GNU Lesser General Public License version 2.1, both as
+ * published by the Free Software Foundation.
+ */
+
+// This file holds the SPI_STC_vect handler. The library is linked as an
+// archive (see library.properties), so the handler is only part of the
+// sketch when transferAsync() or asyncBusy() is used, and sketches that
+// define their own SPI_STC_vect keep linking.
+
+#include "SPI.h"
+
+SPIAsyncTransfer * volatile SPIClass::asyncTransfer = NULL;
+size_t SPIClass::asyncIndex = 0;
+volatile uint8_t *SPIClass::asyncCsPort = NULL;
+uint8_t SPIClass::asyncCsMask = 0;
+
+bool SPIClass::transferAsync(SPIAsyncTransfer *transfer)
+{
+  if (transfer->count == 0)
+    return false;
+
+  // look the chip select up once, the interrupt only toggles the bit
+  volatile uint8_t *csPort = NULL;
+  uint8_t csMask = 0;
+  if (transfer->csPin != SPI_NO_CS) {
+    csPort = portOutputRegister(digitalPinToPort(transfer->csPin));
+    csMask = digitalPinToBitMask(transfer->csPin);
+  }
+
+  uint8_t sreg = SREG;
+  noInterrupts();
+  // taken by a transaction, possibly one from an interrupt that used
+  // tryBeginTransaction(), or by another asynchronous transfer
+  if (busy) {
+    SREG = sreg;
+    return false;
+  }
+  busy = 1;
+  asyncTransfer = transfer;
+  asyncIndex = 0;
+  asyncCsPort = csPort;
+  asyncCsMask = csMask;
+  if (csPort)
+    *csPort &= ~csMask;
+  SPCR = transfer->settings.spcr | _BV(SPIE);
+  SPSR = transfer->settings.spsr;
+  SPDR = transfer->tx ? transfer->tx[0] : transfer->fill;
+  SREG = sreg;
+  return true;
+}
+
+void SPIClass::_async_irq(void)
+{
+  SPIAsyncTransfer *transfer = asyncTransfer;
+  uint8_t in = SPDR;
+  if (!transfer)
+    return;
+
+  size_t i = asyncIndex;
+  if (transfer->rx)
+    transfer->rx[i] = in;
+  if (++i < transfer->count) {
+    SPDR = transfer->tx ? transfer->tx[i] : transfer->fill;
+    asyncIndex = i;
+    return;
+  }
+
+  SPCR &= ~_BV(SPIE);
+  if (asyncCsPort)
+    *asyncCsPort |= asyncCsMask;
+  asyncTransfer = NULL;
+  busy = 0;
+  if (transfer->callback)
+    transfer->callback(transfer);
+}
+
+ISR(SPI_STC_vect)
+{
+  SPIClass::_async_irq();
+}
@@ -0,0 +1,162 @@
+/*
+ * Copyright (c) 2026 Arduino.  All right reserved.
+ * SPI Slave library for arduino.
+ *
+ * This file is free software; you can redistribute it and/or modify
+ * it under the terms of either the GNU General Public License version 2
+ * or the GNU Lesser General Public License version 2.1, both as
+ * published by the Free Software Foundation.
+ */
+
+#include "SPISlave.h"
+#include <avr/power.h>
+
+#if (SPI_SLAVE_RX_BUFFER_SIZE & (SPI_SLAVE_RX_BUFFER_SIZE - 1)) || SPI_SLAVE_RX_BUFFER_SIZE > 256
+#error SPI_SLAVE_RX_BUFFER_SIZE must be a power of 2 no larger than 256
+#endif
+#if (SPI_SLAVE_TX_BUFFER_SIZE & (SPI_SLAVE_TX_BUFFER_SIZE - 1)) || SPI_SLAVE_TX_BUFFER_SIZE > 256
+#error SPI_SLAVE_TX_BUFFER_SIZE must be a power of 2 no larger than 256
+#endif
+
+#define RX_MASK (SPI_SLAVE_RX_BUFFER_SIZE - 1)
+#define TX_MASK (SPI_SLAVE_TX_BUFFER_SIZE - 1)
+
+SPISlaveClass SPISlave;
+
+static void ss_changed(void)
+{
+  SPISlave._ss_irq();
+}
+
+void SPISlaveClass::begin(uint8_t dataMode, uint8_t bitOrder)
+{
+  uint8_t sreg = SREG;
+  noInterrupts();
+  _rx_head = _rx_tail = 0;
+  _tx_head = _tx_tail = 0;
+  _overruns = 0;
+  _idle = 0xFF;
+
+  // In slave mode only MISO is an output; SS must stay an input, or the
+  // peripheral would ignore the host
+  pinMode(SS, INPUT);
+  pinMode(SCK, INPUT);
+  pinMode(MOSI, INPUT);
+  pinMode(MISO, OUTPUT);
+
+#if defined(power_spi_enable)
+  power_spi_enable();
+#endif
+  SPCR = _BV(SPE) | _BV(SPIE) | (dataMode & SPI_MODE_MASK) |
+    ((bitOrder == LSBFIRST) ? _BV(DORD) : 0);
+  SPDR = _idle;
+  SREG = sreg;
+
+  attachPinChangeInterrupt(SS, ss_changed, RISING);
+}
+
+void SPISlaveClass::end()
+{
+  detachPinChangeInterrupt(SS);
+  SPCR = 0;
+#if defined(power_spi_disable)
+  power_spi_disable();
+#endif
+  pinMode(MISO, INPUT);
+}
+
+int SPISlaveClass::available(void)
+{
+  return (uint8_t)(_rx_head - _rx_tail) & RX_MASK;
+}
+
+int SPISlaveClass::peek(void)
+{
+  uint8_t tail = _rx_tail;
+  if (tail == _rx_head)
+    return -1;
+  return _rx_buffer[tail];
+}
+
+int SPISlaveClass::read(void)
+{
+  uint8_t tail = _rx_tail;
+  if (tail == _rx_head)
+    return -1;
+  uint8_t c = _rx_buffer[tail];
+  _rx_tail = (tail + 1) & RX_MASK;
+  return c;
+}
+
+int SPISlaveClass::availableForWrite(void)
+{
+  return TX_MASK - ((uint8_t)(_tx_head - _tx_tail) & TX_MASK);
+}
+
+// Waits until every queued byte has been loaded for the host; the last
+// one goes out with the next byte the host clocks
+void SPISlaveClass::flush(void)
+{
+  while (_tx_head != _tx_tail) ;
+}
+
+// Queues c for the host, waiting for room if the queue is full
+size_t SPISlaveClass::write(uint8_t c)
+{
+  uint8_t head = _tx_head;
+  uint8_t next = (head + 1) & TX_MASK;
+  while (next == _tx_tail) ;
+  _tx_buffer[head] = c;
+  _tx_head = next;
+  return 1;
+}
+
+bool SPISlaveClass::selected(void)
+{
+  return !(*portInputRegister(digitalPinToPort(SS)) & digitalPinToBitMask(SS));
+}
+
+uint16_t SPISlaveClass::overruns(void)
+{
+  uint8_t sreg = SREG;
+  noInterrupts();
+  uint16_t n = _overruns;
+  _overruns = 0;
+  SREG = sreg;
+  return n;
+}
+
+void SPISlaveClass::_stc_irq(void)
+{
+  uint8_t in = SPDR;
+
+  // Load the next byte first: the host may already be waiting to clock it
+  uint8_t tail = _tx_tail;
+  if (tail != _tx_head) {
+    SPDR = _tx_buffer[tail];
+    _tx_tail = (tail + 1) & TX_MASK;
+  } else {
+    SPDR = _idle;
+  }
+
+  uint8_t head = _rx_head;
+  uint8_t next = (head + 1) & RX_MASK;
+  if (next != _rx_tail) {
+    _rx_buffer[head] = in;
+    _rx_head = next;
+  } else {
+    _overruns++;
+  }
+}
+
+void SPISlaveClass::_ss_irq(void)
+{
+  void (*callback)(void) = _deselect;
+  if (callback)
+    callback();
+}
+
+ISR(SPI_STC_vect)
+{
+  SPISlave._stc_irq();
+}
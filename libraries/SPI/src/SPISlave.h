@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) 2026 Arduino.  All right reserved.
+ * SPI Slave library for arduino.
+ *
+ * This file is free software; you can redistribute it and/or modify
+ * it under the terms of either the GNU General Public License version 2
+ * or the GNU Lesser General Public License version 2.1, both as
+ * published by the Free Software Foundation.
+ */
+
+#ifndef _SPISLAVE_H_INCLUDED
+#define _SPISLAVE_H_INCLUDED
+
+#include "SPI.h"
+
+// Both sizes must be powers of two no larger than 256
+#ifndef SPI_SLAVE_RX_BUFFER_SIZE
+#define SPI_SLAVE_RX_BUFFER_SIZE 64
+#endif
+#ifndef SPI_SLAVE_TX_BUFFER_SIZE
+#define SPI_SLAVE_TX_BUFFER_SIZE 64
+#endif
+
+// The SPI peripheral as a slave to another master. Every byte the host
+// clocks in is put into a receive buffer by the SPI interrupt, which at
+// the same time loads the next byte of the transmit queue into SPDR, or
+// the idle byte if the queue is empty. The host therefore reads each
+// queued byte one byte after it was loaded, and the first byte of a
+// frame is the one loaded at the end of the previous frame.
+//
+// A slave cannot stretch the clock: the interrupt has to finish before
+// the host starts the next byte. At 16 MHz that takes about 3 us, so a
+// host clocking at 2-4 MHz has to leave a gap of that length between
+// bytes. Bytes that arrive while the receive buffer is full are counted
+// by overruns().
+//
+// The SS pin is watched with a pin change interrupt, so onDeselect() can
+// report the end of every frame. SPISlave owns SPI_STC_vect, so it can't
+// be used in the same sketch as SPI.transferAsync().
+class SPISlaveClass : public Stream {
+public:
+  void begin(uint8_t dataMode = SPI_MODE0, uint8_t bitOrder = MSBFIRST);
+  void end();
+
+  virtual int available(void);
+  virtual int peek(void);
+  virtual int read(void);
+  virtual int availableForWrite(void);
+  virtual void flush(void);
+  virtual size_t write(uint8_t);
+  using Print::write; // pull in write(str) and write(buf, size) from Print
+
+  // Sent when the transmit queue is empty, 0xFF by default
+  void setIdleByte(uint8_t idle) { _idle = idle; }
+  // Called from the pin change interrupt when the host releases SS
+  void onDeselect(void (*callback)(void)) { _deselect = callback; }
+  // True while SS is LOW
+  bool selected(void);
+  // Returns and clears the number of received bytes that were dropped
+  uint16_t overruns(void);
+
+  // Interrupt handlers - Not intended to be called externally
+  void _stc_irq(void);
+  void _ss_irq(void);
+
+private:
+  volatile uint8_t _rx_head;
+  volatile uint8_t _rx_tail;
+  volatile uint8_t _tx_head;
+  volatile uint8_t _tx_tail;
+  volatile uint8_t _idle;
+  volatile uint16_t _overruns;
+  void (* volatile _deselect)(void);
+  uint8_t _rx_buffer[SPI_SLAVE_RX_BUFFER_SIZE];
+  uint8_t _tx_buffer[SPI_SLAVE_TX_BUFFER_SIZE];
+};
+
+extern SPISlaveClass SPISlave;
+
+#endif
@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) 2026 Arduino.  All right reserved.
+ * SPI master over a USART in MSPIM mode for arduino.
+ *
+ * This file is free software; you can redistribute it and/or modify
+ * it under the terms of either the GNU General Public License version 2
+ * or the GNU Lesser General Public License version 2.1, both as
+ * published by the Free Software Foundation.
+ */
+
+#include "USARTSPI.h"
+#include "wiring_private.h" // for usartPower()
+
+// UCSRnB and UCSRnC bits in MSPIM mode, the same on every USART
+#define MSPIM_RXEN  _BV(4)
+#define MSPIM_TXEN  _BV(3)
+#define MSPIM_MODE  (_BV(7) | _BV(6)) // UMSELn1:0
+#define MSPIM_UDORD _BV(2)
+#define MSPIM_UCPHA _BV(1)
+#define MSPIM_UCPOL _BV(0)
+
+void USARTSPIClass::begin()
+{
+  // The datasheet order: the baud rate register must be zero while the
+  // transmitter is enabled, and XCK must be an output before that
+  usartPower(_ucsrb, true);
+  *_ubrrh = 0;
+  *_ubrrl = 0;
+  *_xckDdr |= _xckMask;
+  *_ucsrc = MSPIM_MODE;
+  *_ucsrb = MSPIM_RXEN | MSPIM_TXEN;
+  beginTransaction(SPISettings());
+}
+
+void USARTSPIClass::end()
+{
+  *_ucsrb = 0;
+  usartPower(_ucsrb, false);
+  *_xckDdr &= ~_xckMask;
+}
+
+void USARTSPIClass::beginTransaction(SPISettings settings)
+{
+  // Undo the SPISettings packing (see init_AlwaysInline()) to get the
+  // divider 2 ^ (d + 1), with fosc/64 at both d = 5 and d = 6. In MSPIM
+  // mode the clock is fosc / (2 * (UBRR + 1)).
+  uint8_t d = ((settings.spcr & SPI_CLOCK_MASK) << 1 |
+    (settings.spsr & SPI_2XCLOCK_MASK)) ^ 0x1;
+  if (d >= 6) d--;
+
+  uint8_t c = MSPIM_MODE;
+  if (settings.spcr & _BV(DORD)) c |= MSPIM_UDORD;
+  if (settings.spcr & _BV(CPOL)) c |= MSPIM_UCPOL;
+  if (settings.spcr & _BV(CPHA)) c |= MSPIM_UCPHA;
+
+  *_ucsrc = c;
+  *_ubrrl = (1 << d) - 1;
+}
+
+uint16_t USARTSPIClass::transfer16(uint16_t data)
+{
+  uint8_t buf[2];
+  if (*_ucsrc & MSPIM_UDORD) {
+    buf[0] = data;
+    buf[1] = data >> 8;
+    pipeline(buf, buf, 2, 0);
+    return buf[0] | buf[1] << 8;
+  }
+  buf[0] = data >> 8;
+  buf[1] = data;
+  pipeline(buf, buf, 2, 0);
+  return buf[0] << 8 | buf[1];
+}
+
+// Keeps two bytes in flight: one shifting out and one in the transmit
+// buffer. The receive buffer holds two bytes, so it cannot overrun, and
+// counting the received bytes tells when the last one is out, without
+// the TXC flag. tx and rx may be the same buffer, as a byte is always
+// sent before its slot is overwritten.
+void USARTSPIClass::pipeline(const uint8_t *tx, uint8_t *rx, size_t count,
+  uint8_t fill)
+{
+  size_t sent = 0, received = 0;
+
+  while (received < count) {
+    uint8_t status = *_ucsra;
+    if (sent < count && sent - received < 2 && (status & _BV(USARTSPI_UDRE)))
+      *_udr = tx ? tx[sent++] : (sent++, fill);
+    if (status & _BV(USARTSPI_RXC)) {
+      uint8_t in = *_udr;
+      if (rx)
+        rx[received] = in;
+      received++;
+    }
+  }
+}
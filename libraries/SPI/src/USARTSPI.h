@@ -0,0 +1,98 @@
+/*
+ * Copyright (c) 2026 Arduino.  All right reserved.
+ * SPI master over a USART in MSPIM mode for arduino.
+ *
+ * This file is free software; you can redistribute it and/or modify
+ * it under the terms of either the GNU General Public License version 2
+ * or the GNU Lesser General Public License version 2.1, both as
+ * published by the Free Software Foundation.
+ */
+
+#ifndef _USARTSPI_H_INCLUDED
+#define _USARTSPI_H_INCLUDED
+
+#include "SPI.h"
+
+// Constructor arguments for the USARTs that can run in MSPIM mode: the
+// USART registers followed by the data direction register and bit of its
+// XCK pin, which carries SCK. MOSI is TXDn and MISO is RXDn. On the
+// ATmega1280/2560 and the 32U4 the XCK pins are not on the headers of
+// the Arduino boards.
+#if defined(__AVR_ATmega1280__) || defined(__AVR_ATmega2560__)
+  #define USARTSPI_USART0 &UBRR0H, &UBRR0L, &UCSR0A, &UCSR0B, &UCSR0C, &UDR0, &DDRE, _BV(2)
+  #define USARTSPI_USART1 &UBRR1H, &UBRR1L, &UCSR1A, &UCSR1B, &UCSR1C, &UDR1, &DDRD, _BV(5)
+  #define USARTSPI_USART2 &UBRR2H, &UBRR2L, &UCSR2A, &UCSR2B, &UCSR2C, &UDR2, &DDRH, _BV(2)
+  #define USARTSPI_USART3 &UBRR3H, &UBRR3L, &UCSR3A, &UCSR3B, &UCSR3C, &UDR3, &DDRJ, _BV(2)
+#elif defined(__AVR_ATmega32U4__)
+  #define USARTSPI_USART1 &UBRR1H, &UBRR1L, &UCSR1A, &UCSR1B, &UCSR1C, &UDR1, &DDRD, _BV(5)
+#elif defined(__AVR_ATmega644P__) || defined(__AVR_ATmega644PA__) || defined(__AVR_ATmega1284__) || defined(__AVR_ATmega1284P__)
+  #define USARTSPI_USART0 &UBRR0H, &UBRR0L, &UCSR0A, &UCSR0B, &UCSR0C, &UDR0, &DDRB, _BV(0)
+  #define USARTSPI_USART1 &UBRR1H, &UBRR1L, &UCSR1A, &UCSR1B, &UCSR1C, &UDR1, &DDRD, _BV(4)
+#elif defined(UMSEL01)
+  // ATmega48/88/168/328: XCK is PD4, digital pin 4 on the Uno
+  #define USARTSPI_USART0 &UBRR0H, &UBRR0L, &UCSR0A, &UCSR0B, &UCSR0C, &UDR0, &DDRD, _BV(4)
+#endif
+
+// An SPI master on a USART, e.g.
+//
+//   USARTSPIClass displaySPI(USARTSPI_USART0);
+//
+// It has the transfer interface of SPIClass. Unlike the SPI peripheral
+// the USART buffers the next byte to send and two received bytes, so the
+// block transfers keep the clock running between bytes. The clock is
+// fosc / 2 ^ n like the SPI dividers, taken from SPISettings.
+//
+// The transactions only apply the settings: there is no usingInterrupt()
+// support, so use each bus from one context only. The chip select is
+// driven by the sketch, or use the USART's own bus for a single device.
+// While in use, the USART is not available to HardwareSerial.
+class USARTSPIClass {
+public:
+  USARTSPIClass(volatile uint8_t *ubrrh, volatile uint8_t *ubrrl,
+    volatile uint8_t *ucsra, volatile uint8_t *ucsrb,
+    volatile uint8_t *ucsrc, volatile uint8_t *udr,
+    volatile uint8_t *xckDdr, uint8_t xckMask)
+    : _ubrrh(ubrrh), _ubrrl(ubrrl), _ucsra(ucsra), _ucsrb(ucsrb),
+      _ucsrc(ucsrc), _udr(udr), _xckDdr(xckDdr), _xckMask(xckMask) { }
+
+  void begin();
+  void end();
+
+  void beginTransaction(SPISettings settings);
+  inline void endTransaction(void) { }
+
+  inline uint8_t transfer(uint8_t data) {
+    while (!(*_ucsra & _BV(USARTSPI_UDRE))) ;
+    *_udr = data;
+    while (!(*_ucsra & _BV(USARTSPI_RXC))) ;
+    return *_udr;
+  }
+  uint16_t transfer16(uint16_t data);
+  inline void transfer(void *buf, size_t count) {
+    pipeline((const uint8_t *)buf, (uint8_t *)buf, count, 0);
+  }
+  inline void transmit(const void *buf, size_t count) {
+    pipeline((const uint8_t *)buf, NULL, count, 0);
+  }
+  inline void receive(void *buf, size_t count, uint8_t fill = 0xFF) {
+    pipeline(NULL, (uint8_t *)buf, count, fill);
+  }
+
+private:
+  // UCSRnA bits, at the same position on every USART
+  static const uint8_t USARTSPI_RXC = 7;
+  static const uint8_t USARTSPI_UDRE = 5;
+
+  void pipeline(const uint8_t *tx, uint8_t *rx, size_t count, uint8_t fill);
+
+  volatile uint8_t * const _ubrrh;
+  volatile uint8_t * const _ubrrl;
+  volatile uint8_t * const _ucsra;
+  volatile uint8_t * const _ucsrb;
+  volatile uint8_t * const _ucsrc;
+  volatile uint8_t * const _udr;
+  volatile uint8_t * const _xckDdr;
+  const uint8_t _xckMask;
+};
+
+#endif
@@ -0,0 +1,43 @@
+/*
+  Software serial asynchronous transmit
+
+ Sends a counter on a software serial port without holding up
+ the sketch or the other interrupts.
+
+ After beginAsyncTx(), print() only queues the bytes, and a
+ Timer2 interrupt sends them one bit at a time. The sketch keeps
+ echoing the hardware serial port at 115200 baud meanwhile,
+ which a plain software serial write() would disturb.
+ Timer2 can't be used for tone() or for analogWrite() on its
+ pins while it is sending.
+
+ The circuit:
+ * TX is digital pin 11 (connect to RX of other device)
+
+ This example code is in the public domain.
+
+ */
+
+#include <SoftwareSerial.h>
+
+SoftwareSerial mySerial(10, 11); // RX, TX
+unsigned long count;
+
+void setup() {
+  Serial.begin(115200);
+  mySerial.begin(9600);
+  if (!mySerial.beginAsyncTx()) {
+    Serial.println("Timer2 is not available");
+  }
+}
+
+void loop() {
+  mySerial.print("count ");
+  mySerial.println(count++);
+
+  // runs while the line above is still being sent
+  while (Serial.available()) {
+    Serial.write(Serial.read());
+  }
+  delay(100);
+}
@@ -0,0 +1,56 @@
+/*
+  Software serial concurrent receive
+
+ Receives from three software serial ports at the same time,
+ sends to the hardware serial port.
+
+ Unlike listen(), which only lets one port receive at a time,
+ listenConcurrently() keeps every port that calls it listening,
+ so nothing is lost while reading from the others. Call it after
+ begin(), since begin() makes its port the only one listening.
+
+ The circuit:
+ Three devices which communicate serially at 9600 baud,
+ their TX attached to digital pins 8, 10 and 12
+
+ Note:
+ Not all pins on the Mega and Mega 2560 support change interrupts,
+ so only the following can be used for RX:
+ 10, 11, 12, 13, 50, 51, 52, 53, 62, 63, 64, 65, 66, 67, 68, 69
+
+ This example code is in the public domain.
+
+ */
+
+#include <SoftwareSerial.h>
+
+SoftwareSerial ports[] = {
+  {8, 9},
+  {10, 11},
+  {12, 13},
+};
+
+void setup() {
+  // Open serial communications and wait for port to open:
+  Serial.begin(115200);
+  while (!Serial) {
+    ; // wait for serial port to connect. Needed for native USB port only
+  }
+
+  for (SoftwareSerial &port : ports) {
+    port.begin(9600);
+  }
+  for (SoftwareSerial &port : ports) {
+    port.listenConcurrently();
+  }
+}
+
+void loop() {
+  for (uint8_t i = 0; i < 3; i++) {
+    while (ports[i].available() > 0) {
+      Serial.print(i);
+      Serial.print(": ");
+      Serial.println(ports[i].read(), HEX);
+    }
+  }
+}
@@ -43,14 +43,17 @@ http://arduiniana.org.
 #include <Arduino.h>
 #include <SoftwareSerial.h>
 #include <util/delay_basic.h>
+#include "wiring_private.h" // for TIMER0_PRESCALER
+
+// counted by the Timer0 overflow interrupt in wiring.c
+extern "C" volatile unsigned long timer0_overflow_count;
 
 //
 // Statics
 //
-SoftwareSerial *SoftwareSerial::active_object = 0;
-uint8_t SoftwareSerial::_receive_buffer[_SS_MAX_RX_BUFF]; 
-volatile uint8_t SoftwareSerial::_receive_buffer_tail = 0;
-volatile uint8_t SoftwareSerial::_receive_buffer_head = 0;
+SoftwareSerialBase *SoftwareSerialBase::active_object = 0;
+SoftwareSerialBase *SoftwareSerialBase::concurrent_list = 0;
+SoftwareSerialBase *SoftwareSerialBase::async_tx_object = 0;
 
 //
 // Debugging
@@ -78,24 +81,127 @@ inline void DebugPulse(uint8_t, uint8_t) {}
 //
 
 /* static */ 
-inline void SoftwareSerial::tunedDelay(uint16_t delay) { 
+inline void SoftwareSerialBase::tunedDelay(uint16_t delay) { 
   _delay_loop_2(delay);
 }
 
+// The bit loops of write() and recv() are written in assembly, so a bit
+// takes exactly 4 * _bit_delay + _bit_pad + SS_KERNEL_CYCLES cycles
+// whatever the compiler does around them. That keeps the bit times
+// within a cycle of the baud rate up to 250000 baud at 16MHz (and
+// 115200 at 8MHz), where the rounding and miscounted loop overhead of a
+// C loop add up over the byte.
+#define SS_KERNEL_CYCLES 15
+
+// Cycles from the start bit edge until recv() starts its bit loop: 3 or
+// 4 cycles until the interrupt flag is set, 4 to enter the vector, the
+// prologue of the core's pin change handler plus the call of our hook,
+// and the start bit check in recv(). Counted from gcc 4.8.2 (and 4.3.2)
+// output; define it to tune reception for other compilers.
+#ifndef _SS_RX_LATENCY_CYCLES
+#if GCC_VERSION > 40800
+#define _SS_RX_LATENCY_CYCLES (4 + 4 + 75 + 12)
+#else
+#define _SS_RX_LATENCY_CYCLES (4 + 4 + 97 + 12)
+#endif
+#endif
+
+// Puts bits of frame on the pin, least significant first: each bit
+// writes the port value hi (for a 1) or lo (for a 0). Interrupts must
+// be off.
+static inline void txKernel(volatile uint8_t *reg, uint8_t hi, uint8_t lo,
+  uint16_t frame, uint8_t bits, uint16_t delay, uint8_t pad)
+{
+  uint16_t cnt;
+  uint8_t tmp;
+  asm volatile(
+    "mov  %[tmp], %[lo]       \n\t"
+    "sbrc %A[frame], 0        \n\t"
+    "mov  %[tmp], %[hi]       \n\t"
+    "1:                       \n\t"
+    "st   %a[reg], %[tmp]     \n\t" // 2, the bit starts here
+    "lsr  %B[frame]           \n\t" // 1
+    "ror  %A[frame]           \n\t" // 1
+    "mov  %[tmp], %[lo]       \n\t" // 1
+    "sbrc %A[frame], 0        \n\t" // 2 with the mov below
+    "mov  %[tmp], %[hi]       \n\t"
+    "dec  %[bits]             \n\t" // 1
+    "breq 3f                  \n\t" // 1
+    "movw %[cnt], %[delay]    \n\t" // 1
+    "2:                       \n\t"
+    "sbiw %[cnt], 1           \n\t" // 4 * delay - 1
+    "brne 2b                  \n\t"
+    "sbrc %[pad], 0           \n\t" // 2 + (pad & 1)
+    "rjmp .+0                 \n\t"
+    "sbrc %[pad], 1           \n\t" // 2 + (pad & 2)
+    "lpm                      \n\t"
+    "rjmp 1b                  \n\t" // 2
+    "3:                       \n\t"
+    : [frame] "+r" (frame), [bits] "+r" (bits), [cnt] "=&w" (cnt), [tmp] "=&r" (tmp)
+    : [reg] "e" (reg), [hi] "r" (hi), [lo] "r" (lo), [delay] "r" (delay), [pad] "r" (pad)
+  );
+}
+
+// Reads 8 bits from the pin, least significant first, the first one
+// 4 * first + 4 + pad cycles from now. Interrupts must be off.
+static inline uint8_t rxKernel(volatile uint8_t *reg, uint8_t mask,
+  uint16_t first, uint16_t delay, uint8_t pad)
+{
+  uint8_t data = 0, bits = 8, tmp;
+  asm volatile(
+    "1:                       \n\t"
+    "sbiw %[cnt], 1           \n\t" // 4 * cnt - 1
+    "brne 1b                  \n\t"
+    "sbrc %[pad], 0           \n\t" // 2 + (pad & 1)
+    "rjmp .+0                 \n\t"
+    "sbrc %[pad], 1           \n\t" // 2 + (pad & 2)
+    "lpm                      \n\t"
+    "ld   %[tmp], %a[reg]     \n\t" // 2, the bit is sampled here
+    "lsr  %[data]             \n\t" // 1
+    "and  %[tmp], %[mask]     \n\t" // 1
+    "breq 2f                  \n\t" // 2 with the ori below
+    "ori  %[data], 0x80       \n\t"
+    "2:                       \n\t"
+    "movw %[cnt], %[delay]    \n\t" // 1
+    "nop                      \n\t" // 1
+    "nop                      \n\t" // 1
+    "dec  %[bits]             \n\t" // 1
+    "brne 1b                  \n\t" // 2
+    : [data] "+d" (data), [bits] "+r" (bits), [cnt] "+w" (first), [tmp] "=&r" (tmp)
+    : [reg] "e" (reg), [mask] "r" (mask), [delay] "r" (delay), [pad] "r" (pad)
+  );
+  return data;
+}
+
 // This function sets the current object as the "listening"
-// one and returns true if it replaces another 
-bool SoftwareSerial::listen()
+// one and returns true if it replaces another. When begin() chose a
+// speed Timer0 can time (see _SS_EDGE_MIN_TICKS), the port is decoded
+// from edge timestamps like with listenConcurrently(), so the pin change
+// interrupt returns after a few microseconds instead of a whole byte.
+bool SoftwareSerialBase::listen()
 {
   if (!_rx_delay_stopbit)
     return false;
 
+  if (_rx_edges)
+  {
+    if (concurrent_list == this && !_next_concurrent)
+      return false;
+    while (concurrent_list)
+      concurrent_list->stopListening();
+    return listenConcurrently();
+  }
+
   if (active_object != this)
   {
     if (active_object)
       active_object->stopListening();
+    // recv() blocks for a whole byte, which the edge decoder can't take
+    while (concurrent_list)
+      concurrent_list->stopListening();
 
     _buffer_overflow = false;
-    _receive_buffer_head = _receive_buffer_tail = 0;
+    _receive_queue.clear();
     active_object = this;
 
     setRxIntMsk(true);
@@ -105,8 +211,59 @@ bool SoftwareSerial::listen()
   return false;
 }
 
+// Starts listening without stopping the other ports that listen this
+// way, so several of them receive at the same time. Instead of sampling
+// the whole byte from within the interrupt like listen() does, each pin
+// change just timestamps the edge with Timer0 and works out the bits
+// that went by since the last one, so one port's byte doesn't block
+// another's. Timer0 ticks are 4us at 16MHz, which limits this to about
+// 19200 baud. Returns true if the port wasn't listening this way before.
+bool SoftwareSerialBase::listenConcurrently()
+{
+  if (!_rx_delay_stopbit || _concurrent)
+    return false;
+
+  if (active_object)
+    active_object->stopListening();
+
+  _buffer_overflow = false;
+  _receive_queue.clear();
+
+  uint8_t oldSREG = SREG;
+  cli();
+  _rx_bits_left = 0;
+  _rx_level = rx_pin_read() ? 1 : 0;
+  _next_concurrent = concurrent_list;
+  concurrent_list = this;
+  _concurrent = true;
+  setRxIntMsk(true);
+  SREG = oldSREG;
+  return true;
+}
+
+// Copies the receive error counters, and clears them if clear is set.
+// Only frame and overflow are counted, as there is no parity, and the
+// pin change interrupt doesn't tell us about edges it was too late for.
+void SoftwareSerialBase::getErrors(SerialErrors &errors, bool clear)
+{
+  uint8_t oldSREG = SREG;
+  cli();
+  errors = _errors;
+  if (clear)
+    memset(&_errors, 0, sizeof(_errors));
+  SREG = oldSREG;
+}
+
+void SoftwareSerialBase::clearErrors()
+{
+  uint8_t oldSREG = SREG;
+  cli();
+  memset(&_errors, 0, sizeof(_errors));
+  SREG = oldSREG;
+}
+
 // Stop listening. Returns true if we were actually listening.
-bool SoftwareSerial::stopListening()
+bool SoftwareSerialBase::stopListening()
 {
   if (active_object == this)
   {
@@ -114,13 +271,26 @@ bool SoftwareSerial::stopListening()
     active_object = NULL;
     return true;
   }
+  if (_concurrent)
+  {
+    uint8_t oldSREG = SREG;
+    cli();
+    setRxIntMsk(false);
+    SoftwareSerialBase **p = &concurrent_list;
+    while (*p != this)
+      p = &(*p)->_next_concurrent;
+    *p = _next_concurrent;
+    _concurrent = false;
+    SREG = oldSREG;
+    return true;
+  }
   return false;
 }
 
 //
 // The receive routine called by the interrupt handler
 //
-void SoftwareSerial::recv()
+void SoftwareSerialBase::recv()
 {
 
 #if GCC_VERSION < 40302
@@ -141,6 +311,12 @@ void SoftwareSerial::recv()
 
   uint8_t d = 0;
 
+#if CORE_ISR_NOBLOCK
+  // a change of another pin during our own reception
+  if (!(*_pcint_maskreg & _pcint_maskvalue))
+    return;
+#endif
+
   // If RX line is high, then we don't see any start bit
   // so interrupt is probably not for us
   if (_inverse_logic ? rx_pin_read() : !rx_pin_read())
@@ -149,42 +325,37 @@ void SoftwareSerial::recv()
     // triggering another interrupt directly after we return, which can
     // cause problems at higher baudrates.
     setRxIntMsk(false);
+#if CORE_ISR_NOBLOCK
+    // Other interrupts may come in now; each one delays the following
+    // bit samples by its length, which costs margin at high baud rates
+    sei();
+#endif
 
-    // Wait approximately 1/2 of a bit width to "center" the sample
-    tunedDelay(_rx_delay_centering);
+    // Read each of the 8 bits, the first 1.5 bit times after the edge
+    d = rxKernel(_receivePortRegister, _receiveBitMask,
+                 _rx_delay_centering, _bit_delay, _bit_pad);
     DebugPulse(_DEBUG_PIN2, 1);
 
-    // Read each of the 8 bits
-    for (uint8_t i=8; i > 0; --i)
-    {
-      tunedDelay(_rx_delay_intrabit);
-      d >>= 1;
-      DebugPulse(_DEBUG_PIN2, 1);
-      if (rx_pin_read())
-        d |= 0x80;
-    }
-
     if (_inverse_logic)
       d = ~d;
 
     // if buffer full, set the overflow flag and return
-    uint8_t next = (_receive_buffer_tail + 1) % _SS_MAX_RX_BUFF;
-    if (next != _receive_buffer_head)
-    {
-      // save new data in buffer: tail points to where byte goes
-      _receive_buffer[_receive_buffer_tail] = d; // save new byte
-      _receive_buffer_tail = next;
-    } 
-    else 
+    if (!_receive_queue.push(d))
     {
       DebugPulse(_DEBUG_PIN1, 1);
       _buffer_overflow = true;
+      _errors.overflow++;
     }
 
-    // skip the stop bit
+    // skip into the stop bit, which must be at the idle level
     tunedDelay(_rx_delay_stopbit);
     DebugPulse(_DEBUG_PIN1, 1);
+    if (_inverse_logic ? rx_pin_read() : !rx_pin_read())
+      _errors.frame++;
 
+#if CORE_ISR_NOBLOCK
+    cli();
+#endif
     // Re-enable interrupts when we're sure to be inside the stop bit
     setRxIntMsk(true);
 
@@ -206,53 +377,151 @@ void SoftwareSerial::recv()
 #endif
 }
 
-uint8_t SoftwareSerial::rx_pin_read()
+uint8_t SoftwareSerialBase::rx_pin_read()
 {
   return *_receivePortRegister & _receiveBitMask;
 }
 
 //
-// Interrupt handling
+// The edge decoder for listenConcurrently()
 //
 
+// Timer0 ticks since startup, like micros() but without converting them;
+// interrupts must be off
 /* static */
-inline void SoftwareSerial::handle_interrupt()
+inline uint32_t SoftwareSerialBase::ticks()
 {
-  if (active_object)
+  uint8_t t = TCNT0;
+  uint32_t m = timer0_overflow_count;
+#ifdef TIFR0
+  if ((TIFR0 & _BV(TOV0)) && (t < 255))
+    m++;
+#else
+  if ((TIFR & _BV(TOV0)) && (t < 255))
+    m++;
+#endif
+  return (m << 8) | t;
+}
+
+// Takes the bits whose middle passed before ticks; the line has been at
+// _rx_level ever since the last edge
+void SoftwareSerialBase::decodeUntil(uint32_t ticks)
+{
+  while (_rx_bits_left && (int32_t)(ticks - _rx_sample) >= 0)
   {
-    active_object->recv();
+    uint8_t one = _rx_level != _inverse_logic;
+
+    uint16_t f = (uint16_t)_rx_sample_frac + _rx_period_frac;
+    _rx_sample += _rx_period + (f >> 8);
+    _rx_sample_frac = f;
+
+    if (--_rx_bits_left == 0)
+    {
+      // the stop bit
+      if (!one)
+        _errors.frame++;
+      continue;
+    }
+
+    uint8_t d = _rx_data >> 1;
+    if (one)
+      d |= 0x80;
+    _rx_data = d;
+
+    if (_rx_bits_left == 1)
+    {
+      // if buffer full, set the overflow flag
+      if (!_receive_queue.push(d))
+      {
+        _buffer_overflow = true;
+        _errors.overflow++;
+      }
+    }
   }
 }
 
-#if defined(PCINT0_vect)
-ISR(PCINT0_vect)
+// Called on every pin change interrupt, which may well be for another pin
+void SoftwareSerialBase::recvEdge(uint32_t ticks)
 {
-  SoftwareSerial::handle_interrupt();
+  uint8_t level = rx_pin_read() ? 1 : 0;
+  if (level == _rx_level)
+    return;
+
+  decodeUntil(ticks);
+  _rx_level = level;
+
+  // a sender slightly faster than us ends the stop bit before its
+  // middle, which it was at the idle level until now
+  if (_rx_bits_left == 1 && level == _inverse_logic)
+    _rx_bits_left = 0;
+
+  // a start bit, if the line left its idle level between bytes
+  if (!_rx_bits_left && level == _inverse_logic)
+  {
+    _rx_bits_left = 9;  // 8 data bits and the stop bit
+    _rx_sample = ticks + _rx_first;
+    _rx_sample_frac = _rx_first_frac;
+  }
 }
-#endif
 
-#if defined(PCINT1_vect)
-ISR(PCINT1_vect, ISR_ALIASOF(PCINT0_vect));
-#endif
+// A byte that ends in 1 bits has no edge after its last bit, so it is
+// only complete once its time is up
+void SoftwareSerialBase::flushEdges()
+{
+  if (_concurrent && _rx_bits_left)
+  {
+    uint8_t oldSREG = SREG;
+    cli();
+    decodeUntil(ticks());
+    SREG = oldSREG;
+  }
+}
 
-#if defined(PCINT2_vect)
-ISR(PCINT2_vect, ISR_ALIASOF(PCINT0_vect));
-#endif
+//
+// Interrupt handling
+//
 
-#if defined(PCINT3_vect)
-ISR(PCINT3_vect, ISR_ALIASOF(PCINT0_vect));
-#endif
+/* static */
+inline void SoftwareSerialBase::handle_interrupt()
+{
+  if (active_object)
+  {
+    active_object->recv();
+  }
+  else if (concurrent_list)
+  {
+    uint32_t t = ticks();
+    SoftwareSerialBase *p = concurrent_list;
+    do {
+      p->recvEdge(t);
+      p = p->_next_concurrent;
+    } while (p);
+  }
+}
+
+// The pin change vectors belong to the core (WPinChange.c), which calls
+// this hook on every pin change interrupt before its per-pin callbacks.
+static void softwareSerialPinChange()
+{
+  SoftwareSerialBase::handle_interrupt();
+}
 
 //
 // Constructor
 //
-SoftwareSerial::SoftwareSerial(uint8_t receivePin, uint8_t transmitPin, bool inverse_logic /* = false */) : 
+SoftwareSerialBase::SoftwareSerialBase(uint8_t receivePin, uint8_t transmitPin, bool inverse_logic,
+  uint8_t *buffer, uint16_t size) :
   _rx_delay_centering(0),
-  _rx_delay_intrabit(0),
   _rx_delay_stopbit(0),
-  _tx_delay(0),
+  _bit_delay(0),
+  _bit_pad(0),
   _buffer_overflow(false),
-  _inverse_logic(inverse_logic)
+  _inverse_logic(inverse_logic),
+  _concurrent(false),
+  _rx_edges(false),
+  _receive_queue(buffer, size),
+  _errors(),
+  _rx_bits_left(0)
 {
   setTX(transmitPin);
   setRX(receivePin);
@@ -261,12 +530,12 @@ SoftwareSerial::SoftwareSerial(uint8_t receivePin, uint8_t transmitPin, bool inv
 //
 // Destructor
 //
-SoftwareSerial::~SoftwareSerial()
+SoftwareSerialBase::~SoftwareSerialBase()
 {
   end();
 }
 
-void SoftwareSerial::setTX(uint8_t tx)
+void SoftwareSerialBase::setTX(uint8_t tx)
 {
   // First write, then set output. If we do this the other way around,
   // the pin would be output low for a short while before switching to
@@ -279,7 +548,7 @@ void SoftwareSerial::setTX(uint8_t tx)
   _transmitPortRegister = portOutputRegister(port);
 }
 
-void SoftwareSerial::setRX(uint8_t rx)
+void SoftwareSerialBase::setRX(uint8_t rx)
 {
   pinMode(rx, INPUT);
   if (!_inverse_logic)
@@ -290,7 +559,7 @@ void SoftwareSerial::setRX(uint8_t rx)
   _receivePortRegister = portInputRegister(port);
 }
 
-uint16_t SoftwareSerial::subtract_cap(uint16_t num, uint16_t sub) {
+uint16_t SoftwareSerialBase::subtract_cap(uint16_t num, uint16_t sub) {
   if (num > sub)
     return num - sub;
   else
@@ -301,55 +570,58 @@ uint16_t SoftwareSerial::subtract_cap(uint16_t num, uint16_t sub) {
 // Public methods
 //
 
-void SoftwareSerial::begin(long speed)
+void SoftwareSerialBase::begin(long speed)
 {
-  _rx_delay_centering = _rx_delay_intrabit = _rx_delay_stopbit = _tx_delay = 0;
+  // the timer was set up for the old speed
+  endAsyncTx();
+
+  _rx_delay_centering = _rx_delay_stopbit = _bit_delay = 0;
 
   // Precalculate the various delays, in number of 4-cycle delays
-  uint16_t bit_delay = (F_CPU / speed) / 4;
+  uint32_t bit_cycles = (F_CPU + speed / 2) / speed;
+  uint16_t bit_delay = bit_cycles / 4;
+
+  // The bit loops take SS_KERNEL_CYCLES on top of their delay, the
+  // remainder goes into _bit_pad
+  if (bit_cycles >= SS_KERNEL_CYCLES + 4) {
+    bit_cycles -= SS_KERNEL_CYCLES;
+    _bit_delay = bit_cycles > 0x3FFFF ? 0xFFFF : bit_cycles / 4;
+    _bit_pad = bit_cycles % 4;
+  } else {
+    _bit_delay = 1;
+    _bit_pad = 0;
+  }
 
-  // 12 (gcc 4.8.2) or 13 (gcc 4.3.2) cycles from start bit to first bit,
-  // 15 (gcc 4.8.2) or 16 (gcc 4.3.2) cycles between bits,
-  // 12 (gcc 4.8.2) or 14 (gcc 4.3.2) cycles from last bit to stop bit
-  // These are all close enough to just use 15 cycles, since the inter-bit
-  // timings are the most critical (deviations stack 8 times)
-  _tx_delay = subtract_cap(bit_delay, 15 / 4);
+  // Bit time in Timer0 ticks with an 8 bit fraction, for the edge decoder
+  uint32_t period = (F_CPU / TIMER0_PRESCALER * 256UL) / speed;
+  _rx_period = period >> 8;
+  _rx_period_frac = period;
+  period = period * 3 / 2;
+  _rx_first = period >> 8;
+  _rx_first_frac = period;
+  _rx_edges = _rx_period >= _SS_EDGE_MIN_TICKS;
 
   // Only setup rx when we have a valid PCINT for this pin
   if (digitalPinToPCICR(_receivePin)) {
+    // The first bit is sampled 1.5 bit times after the start bit edge.
+    // rxKernel() starts _SS_RX_LATENCY_CYCLES after the edge and samples
+    // 4 + _bit_pad cycles after its first delay.
+    uint32_t first = (uint32_t)bit_delay * 4 * 3 / 2;
+    uint32_t late = _SS_RX_LATENCY_CYCLES + 4 + _bit_pad;
+    _rx_delay_centering = first > late + 4 ? (first - late) / 4 : 1;
+
+    // The last bit is sampled 9 cycles before rxKernel() returns. The
+    // C code in recv() from there to the stop bit delay, and from the
+    // delay until the interrupt mask is enabled again (which _must_
+    // happen during the stop bit), is not cycle counted; the constants
+    // below are allowances for it, taken from the compiled output of
+    // the C bit loop the kernel replaced. This delay aims at 3/4 of a
+    // bit time, meaning the end of the delay will be at 1/4th of the
+    // stop bit. This allows some extra time for ISR cleanup, which
+    // makes 115200 baud at 16Mhz work more reliably
     #if GCC_VERSION > 40800
-    // Timings counted from gcc 4.8.2 output. This works up to 115200 on
-    // 16Mhz and 57600 on 8Mhz.
-    //
-    // When the start bit occurs, there are 3 or 4 cycles before the
-    // interrupt flag is set, 4 cycles before the PC is set to the right
-    // interrupt vector address and the old PC is pushed on the stack,
-    // and then 75 cycles of instructions (including the RJMP in the
-    // ISR vector table) until the first delay. After the delay, there
-    // are 17 more cycles until the pin value is read (excluding the
-    // delay in the loop).
-    // We want to have a total delay of 1.5 bit time. Inside the loop,
-    // we already wait for 1 bit time - 23 cycles, so here we wait for
-    // 0.5 bit time - (71 + 18 - 22) cycles.
-    _rx_delay_centering = subtract_cap(bit_delay / 2, (4 + 4 + 75 + 17 - 23) / 4);
-
-    // There are 23 cycles in each loop iteration (excluding the delay)
-    _rx_delay_intrabit = subtract_cap(bit_delay, 23 / 4);
-
-    // There are 37 cycles from the last bit read to the start of
-    // stopbit delay and 11 cycles from the delay until the interrupt
-    // mask is enabled again (which _must_ happen during the stopbit).
-    // This delay aims at 3/4 of a bit time, meaning the end of the
-    // delay will be at 1/4th of the stopbit. This allows some extra
-    // time for ISR cleanup, which makes 115200 baud at 16Mhz work more
-    // reliably
     _rx_delay_stopbit = subtract_cap(bit_delay * 3 / 4, (37 + 11) / 4);
     #else // Timings counted from gcc 4.3.2 output
-    // Note that this code is a _lot_ slower, mostly due to bad register
-    // allocation choices of gcc. This works up to 57600 on 16Mhz and
-    // 38400 on 8Mhz.
-    _rx_delay_centering = subtract_cap(bit_delay / 2, (4 + 4 + 97 + 29 - 11) / 4);
-    _rx_delay_intrabit = subtract_cap(bit_delay, 11 / 4);
     _rx_delay_stopbit = subtract_cap(bit_delay * 3 / 4, (44 + 17) / 4);
     #endif
 
@@ -357,13 +629,14 @@ void SoftwareSerial::begin(long speed)
     // Enable the PCINT for the entire port here, but never disable it
     // (others might also need it, so we disable the interrupt by using
     // the per-pin PCMSK register).
+    attachPinChangeHook(softwareSerialPinChange);
     *digitalPinToPCICR(_receivePin) |= _BV(digitalPinToPCICRbit(_receivePin));
     // Precalculate the pcint mask register and value, so setRxIntMask
     // can be used inside the ISR without costing too much time.
     _pcint_maskreg = digitalPinToPCMSK(_receivePin);
     _pcint_maskvalue = _BV(digitalPinToPCMSKbit(_receivePin));
 
-    tunedDelay(_tx_delay); // if we were low this establishes the end
+    tunedDelay(_bit_delay); // if we were low this establishes the end
   }
 
 #if _DEBUG
@@ -374,7 +647,7 @@ void SoftwareSerial::begin(long speed)
   listen();
 }
 
-void SoftwareSerial::setRxIntMsk(bool enable)
+void SoftwareSerialBase::setRxIntMsk(bool enable)
 {
     if (enable)
       *_pcint_maskreg |= _pcint_maskvalue;
@@ -382,105 +655,92 @@ void SoftwareSerial::setRxIntMsk(bool enable)
       *_pcint_maskreg &= ~_pcint_maskvalue;
 }
 
-void SoftwareSerial::end()
+void SoftwareSerialBase::end()
 {
+  endAsyncTx();
   stopListening();
 }
 
+// Waits for the bytes still queued by beginAsyncTx() to go out, then
+// goes back to sending from write()
+void SoftwareSerialBase::endAsyncTx()
+{
+  if (this == async_tx_object)
+    asyncStop();
+}
+
 
 // Read data from buffer
-int SoftwareSerial::read()
+int SoftwareSerialBase::read()
 {
   if (!isListening())
     return -1;
+  flushEdges();
 
   // Empty buffer?
-  if (_receive_buffer_head == _receive_buffer_tail)
+  uint8_t d;
+  if (!_receive_queue.pop(d))
     return -1;
-
-  // Read from "head"
-  uint8_t d = _receive_buffer[_receive_buffer_head]; // grab next byte
-  _receive_buffer_head = (_receive_buffer_head + 1) % _SS_MAX_RX_BUFF;
   return d;
 }
 
-int SoftwareSerial::available()
+int SoftwareSerialBase::available()
 {
   if (!isListening())
     return 0;
+  flushEdges();
 
-  return (_receive_buffer_tail + _SS_MAX_RX_BUFF - _receive_buffer_head) % _SS_MAX_RX_BUFF;
+  return _receive_queue.available();
 }
 
-size_t SoftwareSerial::write(uint8_t b)
+size_t SoftwareSerialBase::write(uint8_t b)
 {
-  if (_tx_delay == 0) {
+  if (_bit_delay == 0) {
     setWriteError();
     return 0;
   }
 
-  // By declaring these as local variables, the compiler will put them
-  // in registers _before_ disabling interrupts and entering the
-  // critical timing sections below, which makes it a lot easier to
-  // verify the cycle timings
+  if (this == async_tx_object)
+    return asyncWrite(b);
+
   volatile uint8_t *reg = _transmitPortRegister;
-  uint8_t reg_mask = _transmitBitMask;
-  uint8_t inv_mask = ~_transmitBitMask;
   uint8_t oldSREG = SREG;
-  bool inv = _inverse_logic;
-  uint16_t delay = _tx_delay;
 
-  if (inv)
-    b = ~b;
+  // start bit, 8 data bits, then back to idle for the stop bit
+  uint16_t frame = ((uint16_t)b << 1) | 0x200;
+  if (_inverse_logic)
+    frame = ~frame;
 
   cli();  // turn off interrupts for a clean txmit
 
-  // Write the start bit
-  if (inv)
-    *reg |= reg_mask;
-  else
-    *reg &= inv_mask;
-
-  tunedDelay(delay);
-
-  // Write each of the 8 bits
-  for (uint8_t i = 8; i > 0; --i)
-  {
-    if (b & 1) // choose bit
-      *reg |= reg_mask; // send 1
-    else
-      *reg &= inv_mask; // send 0
-
-    tunedDelay(delay);
-    b >>= 1;
-  }
-
-  // restore pin to natural state
-  if (inv)
-    *reg &= inv_mask;
-  else
-    *reg |= reg_mask;
+  // Nothing else can change the port while interrupts are off, so the
+  // kernel only has to store one of two values
+  uint8_t lo = *reg & ~_transmitBitMask;
+  uint8_t hi = lo | _transmitBitMask;
+  txKernel(reg, hi, lo, frame, 10, _bit_delay, _bit_pad);
 
   SREG = oldSREG; // turn interrupts back on
-  tunedDelay(_tx_delay);
+  tunedDelay(_bit_delay);
   
   return 1;
 }
 
-void SoftwareSerial::flush()
+void SoftwareSerialBase::flush()
 {
-  // There is no tx buffering, simply return
+  // Only beginAsyncTx() buffers, write() returns once the byte is out
+  if (this == async_tx_object)
+    asyncFlush();
 }
 
-int SoftwareSerial::peek()
+int SoftwareSerialBase::peek()
 {
   if (!isListening())
     return -1;
+  flushEdges();
 
   // Empty buffer?
-  if (_receive_buffer_head == _receive_buffer_tail)
+  uint8_t d;
+  if (!_receive_queue.peek(d))
     return -1;
-
-  // Read from "head"
-  return _receive_buffer[_receive_buffer_head];
+  return d;
 }
@@ -34,20 +34,42 @@ http://arduiniana.org.
 
 #include <inttypes.h>
 #include <Stream.h>
+#include <RingBuffer.h>
+#include <HardwareSerial.h> // for SerialErrors
 
 /******************************************************************************
 * Definitions
 ******************************************************************************/
 
+// RX buffer size of SoftwareSerial, must be a power of 2. Ports that
+// need a different size can be declared as BufferedSoftwareSerial<N>.
 #ifndef _SS_MAX_RX_BUFF
-#define _SS_MAX_RX_BUFF 64 // RX buffer size
+#define _SS_MAX_RX_BUFF 64
+#endif
+
+// The receive buffer of a port. The storage is given to the constructor,
+// so every port can have its own size.
+typedef SpscQueue<uint8_t, 0> _ss_rx_queue;
+
+// Shortest bit time, in Timer0 ticks, that listen() decodes from pin
+// change timestamps instead of waiting out each byte in the interrupt
+// (10 ticks is 25000 baud at 16MHz). 0xFFFF keeps the blocking receive
+// at all speeds.
+#ifndef _SS_EDGE_MIN_TICKS
+#define _SS_EDGE_MIN_TICKS 10
+#endif
+
+#ifndef _SS_MAX_TX_BUFF
+#define _SS_MAX_TX_BUFF 32 // TX buffer of beginAsyncTx(), must be a power of 2
 #endif
 
 #ifndef GCC_VERSION
 #define GCC_VERSION (__GNUC__ * 10000 + __GNUC_MINOR__ * 100 + __GNUC_PATCHLEVEL__)
 #endif
 
-class SoftwareSerial : public Stream
+// Everything but the receive buffer, see SoftwareSerial and
+// BufferedSoftwareSerial below
+class SoftwareSerialBase : public Stream
 {
 private:
   // per object data
@@ -61,21 +83,48 @@ private:
 
   // Expressed as 4-cycle delays (must never be 0!)
   uint16_t _rx_delay_centering;
-  uint16_t _rx_delay_intrabit;
   uint16_t _rx_delay_stopbit;
-  uint16_t _tx_delay;
+  uint16_t _bit_delay;
+  uint8_t _bit_pad;             // cycles a bit takes beyond the 4-cycle delays
 
   uint16_t _buffer_overflow:1;
   uint16_t _inverse_logic:1;
+  uint16_t _concurrent:1;
+  uint16_t _rx_edges:1;         // listen() uses the edge decoder as well
+
+  _ss_rx_queue _receive_queue; // filled by recv() or recvEdge(), emptied by read()
+  SerialErrors _errors;         // frame and overflow are counted
+
+  // Edge decoder of listenConcurrently(); times are in Timer0 ticks, the
+  // bit time also has a fraction in 1/256 ticks
+  uint16_t _rx_period;          // bit time
+  uint8_t _rx_period_frac;
+  uint16_t _rx_first;           // start edge to the middle of bit 0
+  uint8_t _rx_first_frac;
+  uint32_t _rx_sample;          // middle of the next bit
+  uint8_t _rx_sample_frac;
+  uint8_t _rx_bits_left;        // 0 while waiting for a start bit
+  uint8_t _rx_data;
+  uint8_t _rx_level;            // last level seen on the pin
+  SoftwareSerialBase *_next_concurrent;
 
   // static data
-  static uint8_t _receive_buffer[_SS_MAX_RX_BUFF]; 
-  static volatile uint8_t _receive_buffer_tail;
-  static volatile uint8_t _receive_buffer_head;
-  static SoftwareSerial *active_object;
+  static SoftwareSerialBase *active_object;
+  static SoftwareSerialBase *concurrent_list;
+  static SoftwareSerialBase *async_tx_object;
+
+  // The timer driven transmitter of beginAsyncTx() (SoftwareSerialTx.cpp).
+  // Weak, so that file is only linked in when beginAsyncTx() is used.
+  static size_t asyncWrite(uint8_t byte) __attribute__((weak));
+  static void asyncFlush() __attribute__((weak));
+  static void asyncStop() __attribute__((weak));
 
   // private methods
   inline void recv() __attribute__((__always_inline__));
+  inline void recvEdge(uint32_t ticks) __attribute__((__always_inline__));
+  inline void decodeUntil(uint32_t ticks) __attribute__((__always_inline__));
+  void flushEdges();
+  static inline uint32_t ticks() __attribute__((__always_inline__));
   uint8_t rx_pin_read();
   void setTX(uint8_t transmitPin);
   void setRX(uint8_t receivePin);
@@ -87,16 +136,26 @@ private:
   // private static method for timing
   static inline void tunedDelay(uint16_t delay);
 
+protected:
+  // buffer must stay valid for the lifetime of the port, its size is a
+  // power of 2
+  SoftwareSerialBase(uint8_t receivePin, uint8_t transmitPin, bool inverse_logic,
+                     uint8_t *buffer, uint16_t size);
+
 public:
   // public methods
-  SoftwareSerial(uint8_t receivePin, uint8_t transmitPin, bool inverse_logic = false);
-  ~SoftwareSerial();
+  ~SoftwareSerialBase();
   void begin(long speed);
   bool listen();
+  bool listenConcurrently();
+  bool beginAsyncTx();
+  void endAsyncTx();
   void end();
-  bool isListening() { return this == active_object; }
+  bool isListening() { return this == active_object || _concurrent; }
   bool stopListening();
   bool overflow() { bool ret = _buffer_overflow; if (ret) _buffer_overflow = false; return ret; }
+  void getErrors(SerialErrors &errors, bool clear = false);
+  void clearErrors();
   int peek();
 
   virtual size_t write(uint8_t byte);
@@ -111,6 +170,29 @@ public:
   static inline void handle_interrupt() __attribute__((__always_inline__));
 };
 
+// A port with a receive buffer of N bytes, e.g. a small one for
+// a link that only sees short replies, or a large one for a busy link:
+//   BufferedSoftwareSerial<16> gps(10, 11);
+// N must be a power of 2.
+template <unsigned int N>
+class BufferedSoftwareSerial : public SoftwareSerialBase
+{
+private:
+  uint8_t _rx_storage[RingIndex<N>::size];
+
+public:
+  BufferedSoftwareSerial(uint8_t receivePin, uint8_t transmitPin, bool inverse_logic = false) :
+    SoftwareSerialBase(receivePin, transmitPin, inverse_logic, _rx_storage, N) {}
+};
+
+// A port with a receive buffer of _SS_MAX_RX_BUFF bytes
+class SoftwareSerial : public BufferedSoftwareSerial<_SS_MAX_RX_BUFF>
+{
+public:
+  SoftwareSerial(uint8_t receivePin, uint8_t transmitPin, bool inverse_logic = false) :
+    BufferedSoftwareSerial<_SS_MAX_RX_BUFF>(receivePin, transmitPin, inverse_logic) {}
+};
+
 // Arduino 0012 workaround
 #undef int
 #undef char
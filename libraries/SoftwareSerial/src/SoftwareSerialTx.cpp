@@ -0,0 +1,205 @@
+/*
+SoftwareSerialTx.cpp - Timer driven transmit for SoftwareSerial
+Copyright (c) 2026 Arduino.  All right reserved.
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+// This file holds the buffered transmitter of beginAsyncTx() and its
+// TIMER2_COMPB_vect handler. The library is linked as an archive (see
+// library.properties), so both are only part of the sketch when
+// beginAsyncTx() is used. Compare B is the Timer2 vector nothing else in
+// the core defines; tone() and analogWrite() can't use the timer while
+// it is claimed here.
+
+#include <avr/interrupt.h>
+#include <Arduino.h>
+#include <SoftwareSerial.h>
+#include "wiring_private.h" // for TIMER0_PRESCALER
+
+#if defined(TIMER2_COMPB_vect) && defined(TCCR2A)
+
+typedef SpscQueue<uint8_t, _SS_MAX_TX_BUFF> _ss_tx_queue;
+
+static _ss_tx_queue tx_queue;
+static volatile uint8_t *tx_port;
+static uint8_t tx_mask;
+static uint8_t tx_inverse;
+static uint8_t tx_level;        // level of the next bit, 1 is idle
+static uint8_t tx_bits;         // bits of tx_shift still to go
+static uint16_t tx_shift;       // start bit, 8 data bits, stop bit
+static uint8_t tx_idle;         // a whole bit time went by without data
+static volatile uint8_t tx_running;
+
+// Timer2 prescalers, as log2 of the CS2 setting 1 to 7
+static const uint8_t tx_prescaler_shift[] = { 0, 3, 5, 6, 7, 8, 10 };
+
+// Called once per bit time
+static void tx_bit()
+{
+  // The level was worked out the bit before, so the edges only move
+  // with the interrupt latency
+  if (tx_level != tx_inverse)
+    *tx_port |= tx_mask;
+  else
+    *tx_port &= ~tx_mask;
+
+  if (tx_bits == 0)
+  {
+    uint8_t b;
+    if (!tx_queue.pop(b))
+    {
+      // give the stop bit that just started its full length before
+      // flush() may return
+      if (tx_idle)
+      {
+        TIMSK2 &= ~_BV(OCIE2B);
+        tx_running = false;
+      }
+      tx_idle = true;
+      return;
+    }
+    tx_idle = false;
+    tx_shift = ((uint16_t)b << 1) | 0x200;
+    tx_bits = 10;
+  }
+
+  tx_level = tx_shift & 1;
+  tx_shift >>= 1;
+  tx_bits--;
+}
+
+ISR(TIMER2_COMPB_vect)
+{
+  tx_bit();
+}
+
+// With interrupts off, the waits below run the transmitter themselves
+static inline void tx_poll()
+{
+  if (bit_is_clear(SREG, SREG_I) && bit_is_set(TIFR2, OCF2B))
+  {
+    TIFR2 = _BV(OCF2B);
+    tx_bit();
+  }
+}
+
+// Makes write() queue its bytes for a Timer2 compare interrupt, which
+// sends one bit per interrupt, so write() returns right away unless the
+// buffer is full and interrupts stay enabled between bits. flush() waits
+// until everything is sent. Only one port at a time can do this; call it
+// after begin(), which (like end()) goes back to plain write(). Returns
+// false if another port has it, Timer2 is taken (by tone() for example)
+// or the board has no Timer2 compare B.
+//
+// Receiving with listen() at speeds too fast for the edge decoder (see
+// _SS_EDGE_MIN_TICKS) blocks all interrupts for a whole byte at a time,
+// which garbles what is being sent meanwhile.
+bool SoftwareSerialBase::beginAsyncTx()
+{
+  if (async_tx_object == this)
+    return true;
+  if (_bit_delay == 0 || async_tx_object || !claimTimer(2, TIMER_OWNER_USER))
+    return false;
+
+  // One bit in CPU cycles, from the Timer0 ticks begin() worked out
+  uint32_t cycles = ((((uint32_t)_rx_period << 8) | _rx_period_frac) * TIMER0_PRESCALER) >> 8;
+  uint8_t cs;
+  uint32_t top;
+  for (cs = 0; ; cs++)
+  {
+    uint8_t shift = tx_prescaler_shift[cs];
+    top = (cycles + ((1UL << shift) >> 1)) >> shift;
+    if (top <= 256 || cs == sizeof(tx_prescaler_shift) - 1)
+      break;
+  }
+  if (top > 256)
+    top = 256;
+  else if (top == 0)
+    top = 1;
+
+  uint8_t oldSREG = SREG;
+  cli();
+  tx_queue.clear();
+  tx_port = _transmitPortRegister;
+  tx_mask = _transmitBitMask;
+  tx_inverse = _inverse_logic;
+  tx_level = 1;
+  tx_bits = 0;
+  tx_idle = true;
+  tx_running = false;
+
+  // CTC mode with OCR2A as TOP, compare B matching at TOP as well
+  TIMSK2 = 0;
+  TCCR2A = _BV(WGM21);
+  TCCR2B = cs + 1;
+  OCR2A = top - 1;
+  OCR2B = top - 1;
+  TCNT2 = 0;
+  async_tx_object = this;
+  SREG = oldSREG;
+  return true;
+}
+
+/* static */
+size_t SoftwareSerialBase::asyncWrite(uint8_t b)
+{
+  while (!tx_queue.push(b))
+    tx_poll();
+
+  uint8_t oldSREG = SREG;
+  cli();
+  if (!tx_running)
+  {
+    // the first interrupt comes a full bit time from now
+    tx_running = true;
+    TCNT2 = 0;
+    TIFR2 = _BV(OCF2B);
+    TIMSK2 |= _BV(OCIE2B);
+  }
+  SREG = oldSREG;
+  return 1;
+}
+
+/* static */
+void SoftwareSerialBase::asyncFlush()
+{
+  while (tx_running)
+    tx_poll();
+}
+
+/* static */
+void SoftwareSerialBase::asyncStop()
+{
+  asyncFlush();
+  async_tx_object = NULL;
+
+  // back to the 8-bit PWM setup of init()
+  TIMSK2 = 0;
+  TCCR2A = _BV(WGM20);
+  TCCR2B = _BV(CS22);
+  OCR2A = 0;
+  OCR2B = 0;
+  releaseTimer(2, TIMER_OWNER_USER);
+}
+
+#else
+
+bool SoftwareSerialBase::beginAsyncTx()
+{
+  return false;
+}
+
+#endif
@@ -0,0 +1,130 @@
+/*
+  VendorUSB.cpp - Vendor-specific bulk interface for PluggableUSB
+  Copyright (c) 2026 Arduino.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "VendorUSB.h"
+
+#if defined(USBCON)
+
+#define VENDOR_EP_OUT (pluggedEndpoint)
+#define VENDOR_EP_IN  (pluggedEndpoint + 1)
+
+// "MSFT100" followed by the vendor code the host is to use
+static const uint8_t msOsString[18] PROGMEM = {
+  18, USB_STRING_DESCRIPTOR_TYPE,
+  'M', 0, 'S', 0, 'F', 0, 'T', 0, '1', 0, '0', 0, '0', 0,
+  VENDOR_USB_MS_VENDOR_CODE, 0
+};
+
+VendorUSB_& VendorUSB()
+{
+  static VendorUSB_ obj;
+  return obj;
+}
+
+int VendorUSB_::getInterface(uint8_t* interfaceCount)
+{
+  *interfaceCount += 1; // uses 1
+  VendorUSBDescriptor vendorInterface = {
+    D_INTERFACE(pluggedInterface, 2, USB_DEVICE_CLASS_VENDOR_SPECIFIC, 0, 0),
+    D_ENDPOINT(USB_ENDPOINT_OUT(VENDOR_EP_OUT), USB_ENDPOINT_TYPE_BULK, USB_EP_SIZE, 0),
+    D_ENDPOINT(USB_ENDPOINT_IN(VENDOR_EP_IN), USB_ENDPOINT_TYPE_BULK, USB_EP_SIZE, 0)
+  };
+  return USB_SendControl(0, &vendorInterface, sizeof(vendorInterface));
+}
+
+int VendorUSB_::getDescriptor(USBSetup& setup)
+{
+  if (setup.bmRequestType != (REQUEST_DEVICETOHOST | REQUEST_STANDARD | REQUEST_DEVICE)) { return 0; }
+  if (setup.wValueH != USB_STRING_DESCRIPTOR_TYPE) { return 0; }
+  if (setup.wValueL != MS_OS_STRING_INDEX) { return 0; }
+
+  return USB_SendControl(TRANSFER_PGM, msOsString, sizeof(msOsString));
+}
+
+uint8_t VendorUSB_::getShortName(char *name)
+{
+  name[0] = 'V';
+  name[1] = 'N';
+  name[2] = 'D';
+  return 3;
+}
+
+bool VendorUSB_::setup(USBSetup& setup)
+{
+  // The extended compat ID request is addressed to the device, the core
+  // passes its wIndex (4) on as the interface number
+  if (setup.bmRequestType != (REQUEST_DEVICETOHOST | REQUEST_VENDOR | REQUEST_DEVICE) ||
+      setup.bRequest != VENDOR_USB_MS_VENDOR_CODE ||
+      setup.wIndex != MS_OS_EXTENDED_COMPAT_ID) {
+    return false;
+  }
+
+  const uint8_t compatId[40] = {
+    40, 0, 0, 0,                        // dwLength
+    0x00, 0x01,                         // bcdVersion 1.00
+    lowByte(MS_OS_EXTENDED_COMPAT_ID), highByte(MS_OS_EXTENDED_COMPAT_ID),
+    1,                                  // bCount: one function
+    0, 0, 0, 0, 0, 0, 0,
+    pluggedInterface,                   // bFirstInterfaceNumber
+    1,
+    'W', 'I', 'N', 'U', 'S', 'B', 0, 0, // compatibleID
+    0, 0, 0, 0, 0, 0, 0, 0,             // subCompatibleID
+    0, 0, 0, 0, 0, 0
+  };
+  return USB_SendControl(0, compatId, sizeof(compatId)) >= 0;
+}
+
+VendorUSB_::VendorUSB_(void) : PluggableUSBModule(2, 1, epType)
+{
+  epType[0] = EP_TYPE_BULK_OUT;
+  epType[1] = EP_TYPE_BULK_IN;
+  PluggableUSB().plug(this);
+}
+
+int VendorUSB_::begin(void)
+{
+  return 0;
+}
+
+int VendorUSB_::available(void)
+{
+  return USB_Available(VENDOR_EP_OUT);
+}
+
+int VendorUSB_::read(void *buffer, int len)
+{
+  return USB_Recv(VENDOR_EP_OUT, buffer, len);
+}
+
+int VendorUSB_::availableForWrite(void)
+{
+  return USB_SendSpace(VENDOR_EP_IN);
+}
+
+int VendorUSB_::write(const void *buffer, int len, bool wait)
+{
+  return USB_Send(VENDOR_EP_IN | (wait ? 0 : TRANSFER_NOWAIT), buffer, len);
+}
+
+void VendorUSB_::flush(void)
+{
+  USB_Flush(VENDOR_EP_IN);
+}
+
+#endif /* if defined(USBCON) */
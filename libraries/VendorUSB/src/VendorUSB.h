@@ -0,0 +1,93 @@
+/*
+  VendorUSB.h - Vendor-specific bulk interface for PluggableUSB
+  Copyright (c) 2026 Arduino.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef VendorUSB_h
+#define VendorUSB_h
+
+#include <stdint.h>
+#include <Arduino.h>
+#include "PluggableUSB.h"
+
+#if defined(USBCON)
+
+// One interface of class 0xFF with a bulk OUT and a bulk IN endpoint,
+// without any framing or line state: the host reads and writes it with
+// libusb or WinUSB. Windows asks for the Microsoft OS 1.0 descriptors
+// (string 0xEE and the extended compat ID), which tell it to bind
+// WinUSB without an .inf file. Windows remembers the answer per
+// VID/PID/bcdDevice, so a board that enumerated before needs its entry
+// under usbflags in the registry removed once.
+
+// bRequest of the Microsoft OS vendor request
+#ifndef VENDOR_USB_MS_VENDOR_CODE
+#define VENDOR_USB_MS_VENDOR_CODE 0x20
+#endif
+
+#define MS_OS_STRING_INDEX        0xEE
+#define MS_OS_EXTENDED_COMPAT_ID  0x0004
+
+typedef struct
+{
+  InterfaceDescriptor iface;
+  EndpointDescriptor  out;
+  EndpointDescriptor  in;
+} VendorUSBDescriptor;
+
+class VendorUSB_ : public PluggableUSBModule
+{
+public:
+  VendorUSB_(void);
+  int begin(void);
+
+  // Bytes waiting in the current OUT bank
+  int available(void);
+  // Copies up to len received bytes, returns how many (0 if none, -1
+  // if the device is not configured)
+  int read(void *buffer, int len);
+
+  // Free space in the current IN bank
+  int availableForWrite(void);
+  // Blocking write of len bytes (up to USB_SEND_TIMEOUT ms per bank);
+  // with wait == false returns at the first full bank with the number
+  // of bytes accepted
+  int write(const void *buffer, int len, bool wait = true);
+  // A partly filled IN bank only goes out once it is full or on flush(),
+  // which hands it to the host and returns without waiting for the host
+  // to read it; write() then waits for a free bank as usual
+  void flush(void);
+
+protected:
+  // Implementation of the PluggableUSBModule
+  int getInterface(uint8_t* interfaceCount);
+  int getDescriptor(USBSetup& setup);
+  bool setup(USBSetup& setup);
+  uint8_t getShortName(char* name);
+
+private:
+  uint8_t epType[2];
+};
+
+// Replacement for global singleton.
+// This function prevents static-initialization-order-fiasco
+// https://isocpp.org/wiki/faq/ctors#static-init-order-on-first-use
+VendorUSB_& VendorUSB();
+
+#endif // USBCON
+
+#endif // VendorUSB_h
@@ -0,0 +1,63 @@
+// Wire Bus Profiler
+
+// Demonstrates use of the Wire library
+// Lists the devices on the bus, then reads from one of them again and
+// again and prints how long the reads take and how many fail. Build with
+// -DTWI_STATS=1 to also get the times measured in the TWI interrupt,
+// including how long the device stretches the clock.
+
+// This example code is in the public domain.
+
+
+#include <Wire.h>
+
+const uint8_t device = 0x68;  // device to time
+const uint8_t bytes = 6;      // bytes to read per transfer
+const int transfers = 100;
+
+void setup() {
+  Wire.begin();        // join i2c bus (address optional for master)
+  Serial.begin(9600);  // start serial for output
+
+  uint8_t found[16];
+  uint8_t count = Wire.scan(found, sizeof(found));
+  Serial.print(count);
+  Serial.println(" devices found");
+  for (uint8_t i = 0; i < count && i < sizeof(found); i++) {
+    Serial.print("  0x");
+    Serial.println(found[i], HEX);
+  }
+}
+
+void loop() {
+  int failed = 0;
+  unsigned long slowest = 0;
+  unsigned long start = micros();
+
+#if TWI_STATS
+  Wire.clearStats();
+#endif
+  for (int i = 0; i < transfers; i++) {
+    unsigned long t = micros();
+    if (Wire.requestFrom(device, bytes) != bytes) {
+      failed++;
+    }
+    t = micros() - t;
+    if (t > slowest) {
+      slowest = t;
+    }
+  }
+  unsigned long total = micros() - start;
+
+  Serial.print("avg ");
+  Serial.print(total / transfers);
+  Serial.print(" us, max ");
+  Serial.print(slowest);
+  Serial.print(" us, failed ");
+  Serial.println(failed);
+#if TWI_STATS
+  Wire.printStats(Serial);
+#endif
+
+  delay(1000);
+}
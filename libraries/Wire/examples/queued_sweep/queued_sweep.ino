@@ -0,0 +1,54 @@
+// Wire Queued Sweep
+
+// Demonstrates use of the Wire library
+// Queues one register read for each of several I2C sensors, so the
+// whole sweep runs in the background while loop() does other work
+
+// This example code is in the public domain.
+
+
+#include <Wire.h>
+
+const uint8_t addresses[] = { 0x48, 0x49, 0x4A, 0x4B }; // sensor addresses
+const uint8_t reg = 0x00;                               // register to read
+
+const uint8_t count = sizeof(addresses);
+twi_job_t jobs[count];
+uint8_t data[count][2];
+
+void setup() {
+  Wire.begin();        // join i2c bus (address optional for master)
+  Serial.begin(9600);  // start serial for output
+
+  for (uint8_t i = 0; i < count; i++) {
+    jobs[i].address = addresses[i];
+    jobs[i].flags = 0;
+    jobs[i].txData = &reg;    // write the register number,
+    jobs[i].txLength = 1;
+    jobs[i].rxData = data[i]; // then read two bytes after a repeated start
+    jobs[i].rxLength = 2;
+    jobs[i].done = NULL;
+  }
+}
+
+void loop() {
+  for (uint8_t i = 0; i < count; i++) {
+    Wire.queue(&jobs[i]);  // returns right away
+  }
+
+  // the CPU is free here until the sweep is done
+  while (Wire.queueBusy()) {
+  }
+
+  for (uint8_t i = 0; i < count; i++) {
+    Serial.print(addresses[i], HEX);
+    Serial.print(": ");
+    if (jobs[i].status == 0) {
+      Serial.println((data[i][0] << 8) | data[i][1]);
+    } else {
+      Serial.println("error");
+    }
+  }
+
+  delay(500);
+}
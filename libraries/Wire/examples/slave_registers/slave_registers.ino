@@ -0,0 +1,38 @@
+// Wire Slave Registers
+
+// Demonstrates use of the Wire library
+// Acts as an I2C/TWI slave with registers, like a sensor: the master
+// writes a register number, then reads or writes the registers from
+// there on, e.g. with Wire.requestFrom(8, 2, 0x00, 1, true)
+
+// This example code is in the public domain.
+
+
+#include <Wire.h>
+
+// registers 0 and 1: analog reading, high byte first (read only)
+// register 2: LED on if not 0
+uint8_t registers[3];
+
+void setup() {
+  pinMode(LED_BUILTIN, OUTPUT);
+  Wire.begin(8);                                // join i2c bus with address #8
+  Wire.setRegisterMap(registers, sizeof(registers), registerWrite);
+}
+
+void loop() {
+  int value = analogRead(A0);
+  noInterrupts();               // so the master never reads half an update
+  registers[0] = value >> 8;
+  registers[1] = value;
+  interrupts();
+  delay(10);
+}
+
+// function that executes after the master wrote registers
+// this function is registered as an event, see setup()
+void registerWrite(uint8_t first, uint16_t count) {
+  if (first <= 2 && first + count > 2) {
+    digitalWrite(LED_BUILTIN, registers[2] ? HIGH : LOW);
+  }
+}
@@ -0,0 +1,309 @@
+/*
+  SoftWire.h - Bit-banged I2C master on any two pins
+  Copyright (c) 2026 Arduino.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef SoftWire_h
+#define SoftWire_h
+
+#include <inttypes.h>
+#include <util/delay_basic.h>
+#include "Arduino.h"
+#include "Stream.h"
+#include "Wire.h" // for WIRE_BUFFER_LENGTH and wire_buffer_index_t
+
+// Cycles each half SCL period spends outside the delay loop, changing and
+// sampling the pins; setClock() takes them off the delay
+#ifndef SOFTWIRE_OVERHEAD_CYCLES
+#define SOFTWIRE_OVERHEAD_CYCLES 10
+#endif
+
+// A second I2C bus, as a master only, with the same calls as Wire, e.g.
+//   SoftWire<4, 5> bus2;           // SDA on pin 4, SCL on pin 5
+// The pins are template arguments, so every pin access compiles to a
+// single sbi/cbi/sbic on the register from the variant's pin tables
+// (see pinModeFast()), and a half period is an exact count of delay loop
+// cycles. That reaches 400kHz at 16MHz, where digitalWrite() based ones
+// manage about 40kHz. Like the TWI, SoftWire only ever drives the pins
+// low, so the bus needs pull-ups. Slaves may stretch the clock.
+template <uint8_t sdaPin, uint8_t sclPin>
+class SoftWire : public Stream
+{
+  private:
+    uint8_t rxBuffer[WIRE_BUFFER_LENGTH];
+    wire_buffer_index_t rxBufferIndex;
+    wire_buffer_index_t rxBufferLength;
+
+    uint8_t txAddress;
+    uint8_t txBuffer[WIRE_BUFFER_LENGTH];
+    wire_buffer_index_t txBufferLength;
+
+    uint8_t transmitting;
+    uint8_t stuck;         // a slave held SCL low for too long
+    uint16_t halfPeriod;   // _delay_loop_2() count for half an SCL period
+
+    // low drives the pin, release lets the pull-up take it high; the
+    // PORT bit stays 0 throughout
+    static inline void sdaLow() { pinModeFast(sdaPin, OUTPUT); }
+    static inline void sdaRelease() { pinModeFast(sdaPin, INPUT); }
+    static inline void sclLow() { pinModeFast(sclPin, OUTPUT); }
+    static inline void sclRelease() { pinModeFast(sclPin, INPUT); }
+    static inline uint8_t sdaHigh() { return digitalReadFast(sdaPin); }
+
+    inline void wait() const
+    {
+      if (halfPeriod)
+        _delay_loop_2(halfPeriod);
+    }
+
+    // releases SCL and waits for slaves that stretch the clock
+    inline void sclRise()
+    {
+      uint16_t n = 0;
+      sclRelease();
+      while (!digitalReadFast(sclPin)) {
+        if (++n == 0) {
+          stuck = true;
+          return;
+        }
+      }
+    }
+
+    // a start, or a repeated start if the bus is still ours
+    void start()
+    {
+      sdaRelease();
+      wait();
+      sclRise();
+      wait();
+      sdaLow();
+      wait();
+      sclLow();
+    }
+
+    void stop()
+    {
+      sdaLow();
+      wait();
+      sclRise();
+      wait();
+      sdaRelease();
+      wait();
+    }
+
+    // returns true if the slave acked
+    uint8_t writeByte(uint8_t data)
+    {
+      uint8_t ack;
+      for (uint8_t i = 0; i < 8; i++) {
+        if (data & 0x80)
+          sdaRelease();
+        else
+          sdaLow();
+        data <<= 1;
+        wait();
+        sclRise();
+        wait();
+        sclLow();
+      }
+      sdaRelease();
+      wait();
+      sclRise();
+      ack = !sdaHigh();
+      wait();
+      sclLow();
+      return ack;
+    }
+
+    uint8_t readByte(uint8_t ack)
+    {
+      uint8_t data = 0;
+      sdaRelease();
+      for (uint8_t i = 0; i < 8; i++) {
+        wait();
+        sclRise();
+        data = (data << 1) | sdaHigh();
+        wait();
+        sclLow();
+      }
+      if (ack)
+        sdaLow();
+      wait();
+      sclRise();
+      wait();
+      sclLow();
+      sdaRelease();
+      return data;
+    }
+
+  public:
+    SoftWire() : rxBufferIndex(0), rxBufferLength(0), txAddress(0),
+                 txBufferLength(0), transmitting(0), stuck(0)
+    {
+      setClock(100000);
+    }
+
+    void begin()
+    {
+      sdaRelease();
+      sclRelease();
+      rxBufferIndex = 0;
+      rxBufferLength = 0;
+      txBufferLength = 0;
+    }
+
+    void end()
+    {
+      sdaRelease();
+      sclRelease();
+    }
+
+    // Sets the fastest SCL clock not above clock the delay loop allows,
+    // and returns it
+    uint32_t setClock(uint32_t clock)
+    {
+      uint32_t cycles = (F_CPU + 2 * clock - 1) / (2 * clock);
+      cycles = cycles > SOFTWIRE_OVERHEAD_CYCLES ? (cycles - SOFTWIRE_OVERHEAD_CYCLES + 3) / 4 : 0;
+      if (cycles > 0xFFFF)
+        cycles = 0xFFFF;
+      halfPeriod = cycles;
+      return F_CPU / (2 * (SOFTWIRE_OVERHEAD_CYCLES + 4 * cycles));
+    }
+
+    // Same codes as Wire: 0 success, 2 address NACKed, 3 data NACKed,
+    // 5 timeout (SCL held low)
+    uint8_t writeTo(uint8_t address, const uint8_t *data, uint16_t length, uint8_t sendStop = true)
+    {
+      uint8_t ret = 0;
+      stuck = false;
+      start();
+      if (!writeByte(address << 1)) {
+        ret = 2;
+      } else {
+        for (uint16_t i = 0; i < length; i++) {
+          if (!writeByte(data[i])) {
+            ret = 3;
+            break;
+          }
+        }
+      }
+      // a NACK ends the transfer in any case
+      if (ret || sendStop)
+        stop();
+      return stuck ? 5 : ret;
+    }
+
+    // Returns the number of bytes read
+    uint16_t readFrom(uint8_t address, uint8_t *data, uint16_t length, uint8_t sendStop = true)
+    {
+      uint16_t i;
+      stuck = false;
+      start();
+      if (!writeByte((address << 1) | 1)) {
+        stop();
+        return 0;
+      }
+      for (i = 0; i < length; i++) {
+        // NACK the last byte
+        data[i] = readByte(i + 1 < length);
+      }
+      if (sendStop)
+        stop();
+      return stuck ? 0 : length;
+    }
+
+    void beginTransmission(uint8_t address)
+    {
+      transmitting = 1;
+      txAddress = address;
+      txBufferLength = 0;
+    }
+    void beginTransmission(int address) { beginTransmission((uint8_t)address); }
+
+    uint8_t endTransmission(uint8_t sendStop)
+    {
+      uint8_t ret = writeTo(txAddress, txBuffer, txBufferLength, sendStop);
+      txBufferLength = 0;
+      transmitting = 0;
+      return ret;
+    }
+    uint8_t endTransmission(void) { return endTransmission(true); }
+
+    uint8_t requestFrom(uint8_t address, uint8_t quantity, uint32_t iaddress, uint8_t isize, uint8_t sendStop)
+    {
+      if (isize > 0) {
+        // send internal address, most significant byte first, followed by
+        // a repeated start
+        beginTransmission(address);
+        if (isize > 3) {
+          isize = 3;
+        }
+        while (isize-- > 0)
+          write((uint8_t)(iaddress >> (isize*8)));
+        endTransmission(false);
+      }
+
+      // clamp to buffer length
+      if (quantity > WIRE_BUFFER_LENGTH) {
+        quantity = (uint8_t)WIRE_BUFFER_LENGTH;
+      }
+      uint8_t read = readFrom(address, rxBuffer, quantity, sendStop);
+      rxBufferIndex = 0;
+      rxBufferLength = read;
+      return read;
+    }
+    uint8_t requestFrom(uint8_t address, uint8_t quantity, uint8_t sendStop)
+    {
+      return requestFrom(address, quantity, (uint32_t)0, (uint8_t)0, sendStop);
+    }
+    uint8_t requestFrom(uint8_t address, uint8_t quantity) { return requestFrom(address, quantity, (uint8_t)true); }
+    uint8_t requestFrom(int address, int quantity) { return requestFrom((uint8_t)address, (uint8_t)quantity, (uint8_t)true); }
+    uint8_t requestFrom(int address, int quantity, int sendStop) { return requestFrom((uint8_t)address, (uint8_t)quantity, (uint8_t)sendStop); }
+
+    // must be called after beginTransmission(address)
+    virtual size_t write(uint8_t data)
+    {
+      if (!transmitting || txBufferLength >= WIRE_BUFFER_LENGTH) {
+        setWriteError();
+        return 0;
+      }
+      txBuffer[txBufferLength++] = data;
+      return 1;
+    }
+    virtual size_t write(const uint8_t *data, size_t quantity)
+    {
+      for (size_t i = 0; i < quantity; ++i) {
+        if (!write(data[i]))
+          return i;
+      }
+      return quantity;
+    }
+
+    // must be called after requestFrom(address, numBytes)
+    virtual int available(void) { return rxBufferLength - rxBufferIndex; }
+    virtual int read(void) { return rxBufferIndex < rxBufferLength ? rxBuffer[rxBufferIndex++] : -1; }
+    virtual int peek(void) { return rxBufferIndex < rxBufferLength ? rxBuffer[rxBufferIndex] : -1; }
+    virtual void flush(void) { }
+
+    inline size_t write(unsigned long n) { return write((uint8_t)n); }
+    inline size_t write(long n) { return write((uint8_t)n); }
+    inline size_t write(unsigned int n) { return write((uint8_t)n); }
+    inline size_t write(int n) { return write((uint8_t)n); }
+    using Print::write;
+};
+
+#endif
@@ -32,17 +32,18 @@ extern "C" {
 // Initialize Class Variables //////////////////////////////////////////////////
 
 uint8_t TwoWire::rxBuffer[BUFFER_LENGTH];
-uint8_t TwoWire::rxBufferIndex = 0;
-uint8_t TwoWire::rxBufferLength = 0;
+wire_buffer_index_t TwoWire::rxBufferIndex = 0;
+wire_buffer_index_t TwoWire::rxBufferLength = 0;
 
 uint8_t TwoWire::txAddress = 0;
 uint8_t TwoWire::txBuffer[BUFFER_LENGTH];
-uint8_t TwoWire::txBufferIndex = 0;
-uint8_t TwoWire::txBufferLength = 0;
+wire_buffer_index_t TwoWire::txBufferIndex = 0;
+wire_buffer_index_t TwoWire::txBufferLength = 0;
 
 uint8_t TwoWire::transmitting = 0;
 void (*TwoWire::user_onRequest)(void);
 void (*TwoWire::user_onReceive)(int);
+void (*TwoWire::user_onDone)(uint8_t);
 
 // Constructors ////////////////////////////////////////////////////////////////
 
@@ -61,6 +62,8 @@ void TwoWire::begin(void)
   txBufferLength = 0;
 
   twi_init();
+  // twi.c works on these buffers directly, no copies in between
+  twi_setSlaveBuffers(rxBuffer, BUFFER_LENGTH, txBuffer, BUFFER_LENGTH);
   twi_attachSlaveTxEvent(onRequestService); // default callback must exist
   twi_attachSlaveRxEvent(onReceiveService); // default callback must exist
 }
@@ -81,9 +84,38 @@ void TwoWire::end(void)
   twi_disable();
 }
 
-void TwoWire::setClock(uint32_t clock)
+// Sets the fastest SCL clock not above clock, and returns it
+uint32_t TwoWire::setClock(uint32_t clock)
 {
-  twi_setFrequency(clock);
+  return twi_setFrequency(clock);
+}
+
+// Sets how long a transfer may wait for the bus, or go without moving a
+// byte, in microseconds before it fails; endTransmission() then returns
+// 5 and requestFrom() 0. With reset_with_timeout, the TWI is also reset
+// and a slave holding the bus is clocked free with recoverBus(). 0 waits
+// forever, as Wire used to.
+void TwoWire::setWireTimeout(uint32_t timeout, bool reset_with_timeout)
+{
+  twi_setTimeoutInMicros(timeout, reset_with_timeout);
+}
+
+// True if a timeout happened since clearWireTimeoutFlag()
+bool TwoWire::getWireTimeoutFlag(void)
+{
+  return twi_manageTimeoutFlag(false);
+}
+
+void TwoWire::clearWireTimeoutFlag(void)
+{
+  twi_manageTimeoutFlag(true);
+}
+
+// Clocks SCL until a slave holding SDA low lets go, then sends a stop.
+// Returns true if the bus is free again.
+bool TwoWire::recoverBus(void)
+{
+  return twi_recoverBus();
 }
 
 uint8_t TwoWire::requestFrom(uint8_t address, uint8_t quantity, uint32_t iaddress, uint8_t isize, uint8_t sendStop)
@@ -108,7 +140,7 @@ uint8_t TwoWire::requestFrom(uint8_t address, uint8_t quantity, uint32_t iaddres
 
   // clamp to buffer length
   if(quantity > BUFFER_LENGTH){
-    quantity = BUFFER_LENGTH;
+    quantity = (uint8_t)BUFFER_LENGTH;
   }
   // perform blocking read into buffer
   uint8_t read = twi_readFrom(address, rxBuffer, quantity, sendStop);
@@ -140,6 +172,10 @@ uint8_t TwoWire::requestFrom(int address, int quantity, int sendStop)
 
 void TwoWire::beginTransmission(uint8_t address)
 {
+  // the buffer may still be going out from endTransmissionAsync()
+  while(twi_masterBusy()){
+    continue;
+  }
   // indicate that we are transmitting
   transmitting = 1;
   // set address of targeted slave
@@ -187,6 +223,97 @@ uint8_t TwoWire::endTransmission(void)
   return endTransmission(true);
 }
 
+// Like endTransmission(), but returns as soon as the transfer has started
+// and the TWI interrupt finishes it in the background, sending straight
+// from the transmit buffer; the next beginTransmission() waits for it to
+// finish. Once busy() is false, result() has the code
+// endTransmission() would have returned; callback, if given, gets it
+// from the interrupt. Returns 0 if the transfer started, 1 if it doesn't
+// fit the buffer, or 5 if another transfer or a slave operation is still
+// going on.
+uint8_t TwoWire::endTransmissionAsync(uint8_t sendStop, void (*callback)(uint8_t))
+{
+  uint8_t ret = twi_beginWriteTo(txAddress, txBuffer, txBufferLength, sendStop, callback);
+  if (ret == 5)
+    return ret; // keep the data, so the sketch can try again
+  // the buffer is still being sent, but nothing more may be added
+  transmitting = 0;
+  return ret;
+}
+
+// Like requestFrom(), but returns as soon as the transfer has started.
+// The data can be read with available() and read() once busy() is false,
+// or from callback, which is called from the interrupt with the result()
+// code. Returns 0 if the transfer started, 1 if quantity is 0 or larger
+// than the buffer, or 5 if the bus is busy.
+uint8_t TwoWire::requestFromAsync(uint8_t address, uint8_t quantity, uint8_t sendStop, void (*callback)(uint8_t))
+{
+  // clamp to buffer length
+  if(quantity > BUFFER_LENGTH){
+    quantity = (uint8_t)BUFFER_LENGTH;
+  }
+  // The interrupt may call user_onDone as soon as the transfer has
+  // started, so set it together with starting, and leave it (and the
+  // receive buffer) to a transfer that is still running if busy
+  uint8_t oldSREG = SREG;
+  cli();
+  void (*previous)(uint8_t) = user_onDone;
+  user_onDone = callback;
+  uint8_t ret = twi_beginReadFrom(address, rxBuffer, quantity, sendStop, onReadDoneService);
+  if (ret) {
+    user_onDone = previous;
+  } else {
+    // nothing to read until the transfer is done
+    rxBufferIndex = 0;
+    rxBufferLength = 0;
+  }
+  SREG = oldSREG;
+  return ret;
+}
+
+// Writes length bytes from data to the device in one transfer, without
+// going through the transmit buffer, so any length is possible. Returns
+// the same codes as endTransmission().
+uint8_t TwoWire::writeTo(uint8_t address, const uint8_t *data, uint16_t length, uint8_t sendStop)
+{
+  return twi_writeTo(address, (uint8_t *)data, length, 1, sendStop);
+}
+
+// Reads length bytes from the device straight into data, bypassing the
+// receive buffer. Returns the number of bytes read.
+uint16_t TwoWire::readFrom(uint8_t address, uint8_t *data, uint16_t length, uint8_t sendStop)
+{
+  return twi_readFrom(address, data, length, sendStop);
+}
+
+// True while an asynchronous transfer is still running
+bool TwoWire::busy(void)
+{
+  return twi_masterBusy();
+}
+
+// The result of the last transfer, coded like endTransmission()
+uint8_t TwoWire::result(void)
+{
+  return twi_masterResult();
+}
+
+// Queues a transaction, which the TWI interrupt runs once the ones
+// before it are done, using the job's own buffers. A sweep over several
+// devices can so be queued at once and run in the background; each job's
+// status turns from TWI_JOB_PENDING into an endTransmission() style code
+// and its done callback, if any, is called from the interrupt.
+void TwoWire::queue(twi_job_t *job)
+{
+  twi_queue(job);
+}
+
+// True until all queued jobs are done
+bool TwoWire::queueBusy(void)
+{
+  return twi_queueBusy();
+}
+
 // must be called in:
 // slave tx event callback
 // or after beginTransmission(address)
@@ -276,21 +403,11 @@ void TwoWire::flush(void)
 // behind the scenes function that is called when data is received
 void TwoWire::onReceiveService(uint8_t* inBytes, int numBytes)
 {
+  (void)inBytes; // that is rxBuffer, filled by twi.c directly
   // don't bother if user hasn't registered a callback
   if(!user_onReceive){
     return;
   }
-  // don't bother if rx buffer is in use by a master requestFrom() op
-  // i know this drops data, but it allows for slight stupidity
-  // meaning, they may not have read all the master requestFrom() data yet
-  if(rxBufferIndex < rxBufferLength){
-    return;
-  }
-  // copy twi rx buffer into local read buffer
-  // this enables new reads to happen in parallel
-  for(uint8_t i = 0; i < numBytes; ++i){
-    rxBuffer[i] = inBytes[i];    
-  }
   // set rx iterator vars
   rxBufferIndex = 0;
   rxBufferLength = numBytes;
@@ -298,6 +415,16 @@ void TwoWire::onReceiveService(uint8_t* inBytes, int numBytes)
   user_onReceive(numBytes);
 }
 
+// behind the scenes function that is called when requestFromAsync() is done
+void TwoWire::onReadDoneService(uint8_t status)
+{
+  rxBufferIndex = 0;
+  rxBufferLength = twi_masterCount();
+  if(user_onDone){
+    user_onDone(status);
+  }
+}
+
 // behind the scenes function that is called when data is requested
 void TwoWire::onRequestService(void)
 {
@@ -325,6 +452,67 @@ void TwoWire::onRequest( void (*function)(void) )
   user_onRequest = function;
 }
 
+// Makes the slave behave like a sensor with size registers in regs: the
+// master writes a register number, then reads or writes from there on.
+// twi.c does that from the interrupt on its own, so onRequest() and
+// onReceive() aren't called and the master never waits for the sketch;
+// onWrite, if given, is told which registers the master changed. Pass
+// NULL to go back to the callbacks.
+void TwoWire::setRegisterMap(uint8_t *regs, uint16_t size, void (*onWrite)(uint8_t, uint16_t))
+{
+  twi_setRegisterMap(regs, size, onWrite);
+}
+
+// Looks for devices at addresses 0x08 to 0x77, the ones not reserved, by
+// sending each address alone. Stores up to size of the addresses that
+// acked in found, and returns how many did.
+uint8_t TwoWire::scan(uint8_t *found, uint8_t size)
+{
+  uint8_t count = 0;
+  for (uint8_t address = 0x08; address < 0x78; address++) {
+    if (twi_writeTo(address, txBuffer, 0, 1, 1) == 0) {
+      if (count < size) {
+        found[count] = address;
+      }
+      count++;
+    }
+  }
+  return count;
+}
+
+#if TWI_STATS
+// Prints what twi.c recorded about the transfers since clearStats(): how
+// many, their errors, how long they took from start to stop, and how much
+// of that slaves spent stretching the clock
+void TwoWire::printStats(Print &out)
+{
+  twi_stats_t stats;
+  twi_getStats(&stats);
+
+  out.print(F("transfers "));
+  out.print(stats.transfers);
+  out.print(F(", address NACK "));
+  out.print(stats.errors[0]);
+  out.print(F(", data NACK "));
+  out.print(stats.errors[1]);
+  out.print(F(", other "));
+  out.print(stats.errors[2]);
+  out.print(F(", timeout "));
+  out.println(stats.errors[3]);
+  out.print(F("us avg "));
+  out.print(stats.transfers ? stats.totalMicros / stats.transfers : 0);
+  out.print(F(", max "));
+  out.print(stats.maxMicros);
+  out.print(F(", stretched "));
+  out.println(stats.stretchMicros);
+}
+
+void TwoWire::clearStats(void)
+{
+  twi_clearStats();
+}
+#endif
+
 // Preinstantiate Objects //////////////////////////////////////////////////////
 
 TwoWire Wire = TwoWire();
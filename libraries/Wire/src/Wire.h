@@ -24,36 +24,63 @@
 
 #include <inttypes.h>
 #include "Stream.h"
+extern "C" {
+  #include "utility/twi.h" // for twi_job_t
+}
 
-#define BUFFER_LENGTH 32
+// The size of each of the two Wire buffers, which limits how much a
+// single requestFrom() or endTransmission() can move. It can be raised
+// with a build flag, e.g. -DWIRE_BUFFER_LENGTH=130 for a 128-byte EEPROM
+// page plus its address. Transfers of any length can also use readFrom()
+// and writeTo(), which work on the caller's buffer.
+#ifndef WIRE_BUFFER_LENGTH
+#define WIRE_BUFFER_LENGTH 32
+#endif
+#define BUFFER_LENGTH WIRE_BUFFER_LENGTH
+
+#if WIRE_BUFFER_LENGTH > 255
+typedef uint16_t wire_buffer_index_t;
+#else
+typedef uint8_t wire_buffer_index_t;
+#endif
 
 // WIRE_HAS_END means Wire has end()
 #define WIRE_HAS_END 1
 
+// WIRE_HAS_TIMEOUT means Wire has setWireTimeout(), getWireTimeoutFlag
+// and clearWireTimeoutFlag()
+#define WIRE_HAS_TIMEOUT 1
+
 class TwoWire : public Stream
 {
   private:
     static uint8_t rxBuffer[];
-    static uint8_t rxBufferIndex;
-    static uint8_t rxBufferLength;
+    static wire_buffer_index_t rxBufferIndex;
+    static wire_buffer_index_t rxBufferLength;
 
     static uint8_t txAddress;
     static uint8_t txBuffer[];
-    static uint8_t txBufferIndex;
-    static uint8_t txBufferLength;
+    static wire_buffer_index_t txBufferIndex;
+    static wire_buffer_index_t txBufferLength;
 
     static uint8_t transmitting;
     static void (*user_onRequest)(void);
     static void (*user_onReceive)(int);
     static void onRequestService(void);
     static void onReceiveService(uint8_t*, int);
+    static void (*user_onDone)(uint8_t);
+    static void onReadDoneService(uint8_t);
   public:
     TwoWire();
     void begin();
     void begin(uint8_t);
     void begin(int);
     void end();
-    void setClock(uint32_t);
+    uint32_t setClock(uint32_t);
+    void setWireTimeout(uint32_t timeout = 25000, bool reset_with_timeout = true);
+    bool getWireTimeoutFlag(void);
+    void clearWireTimeoutFlag(void);
+    bool recoverBus(void);
     void beginTransmission(uint8_t);
     void beginTransmission(int);
     uint8_t endTransmission(void);
@@ -63,6 +90,14 @@ class TwoWire : public Stream
 	uint8_t requestFrom(uint8_t, uint8_t, uint32_t, uint8_t, uint8_t);
     uint8_t requestFrom(int, int);
     uint8_t requestFrom(int, int, int);
+    uint8_t endTransmissionAsync(uint8_t sendStop = true, void (*)(uint8_t) = NULL);
+    uint8_t requestFromAsync(uint8_t, uint8_t, uint8_t sendStop = true, void (*)(uint8_t) = NULL);
+    uint8_t writeTo(uint8_t, const uint8_t *, uint16_t, uint8_t sendStop = true);
+    uint16_t readFrom(uint8_t, uint8_t *, uint16_t, uint8_t sendStop = true);
+    bool busy(void);
+    uint8_t result(void);
+    void queue(twi_job_t *);
+    bool queueBusy(void);
     virtual size_t write(uint8_t);
     virtual size_t write(const uint8_t *, size_t);
     virtual int available(void);
@@ -71,6 +106,12 @@ class TwoWire : public Stream
     virtual void flush(void);
     void onReceive( void (*)(int) );
     void onRequest( void (*)(void) );
+    void setRegisterMap(uint8_t *, uint16_t, void (*)(uint8_t, uint16_t) = NULL);
+    uint8_t scan(uint8_t *, uint8_t);
+#if TWI_STATS
+    void printStats(Print &);
+    void clearStats(void);
+#endif
 
     inline size_t write(unsigned long n) { return write((uint8_t)n); }
     inline size_t write(long n) { return write((uint8_t)n); }
@@ -21,11 +21,15 @@
 
 #include <math.h>
 #include <stdlib.h>
+#include <string.h>
 #include <inttypes.h>
 #include <avr/io.h>
 #include <avr/interrupt.h>
+#include <avr/power.h>
 #include <compat/twi.h>
+#include <util/delay.h>
 #include "Arduino.h" // for digitalWrite
+#include "Profile.h"
 
 #ifndef cbi
 #define cbi(sfr, bit) (_SFR_BYTE(sfr) &= ~_BV(bit))
@@ -46,19 +50,71 @@ static volatile uint8_t twi_inRepStart;			// in the middle of a repeated start
 static void (*twi_onSlaveTransmit)(void);
 static void (*twi_onSlaveReceive)(uint8_t*, int);
 
-static uint8_t twi_masterBuffer[TWI_BUFFER_LENGTH];
-static volatile uint8_t twi_masterBufferIndex;
-static volatile uint8_t twi_masterBufferLength;
+// All transfers work on the caller's buffers: the master operations on
+// the one passed to them, the slave ones on those from
+// twi_setSlaveBuffers()
+static uint8_t *twi_masterBuffer;
+static volatile uint16_t twi_masterBufferIndex;
+static volatile uint16_t twi_masterBufferLength;
 
-static uint8_t twi_txBuffer[TWI_BUFFER_LENGTH];
-static volatile uint8_t twi_txBufferIndex;
-static volatile uint8_t twi_txBufferLength;
+static uint8_t *twi_txBuffer;
+static uint16_t twi_txBufferSize;
+static volatile uint16_t twi_txBufferIndex;
+static volatile uint16_t twi_txBufferLength;
 
-static uint8_t twi_rxBuffer[TWI_BUFFER_LENGTH];
-static volatile uint8_t twi_rxBufferIndex;
+static uint8_t *twi_rxBuffer;
+static uint16_t twi_rxBufferSize;
+static volatile uint16_t twi_rxBufferIndex;
+
+// Register map slave mode, see twi_setRegisterMap()
+static uint8_t *twi_regMap;
+static uint16_t twi_regMapSize;
+static volatile uint16_t twi_regPointer;	// next register read or written
+static volatile uint16_t twi_regFirst;		// first one written this time
+static volatile uint16_t twi_regCount;		// and how many
+static volatile uint8_t twi_regAddressed;	// the next byte sets twi_regPointer
+static void (*twi_onRegisterWrite)(uint8_t, uint16_t);
 
 static volatile uint8_t twi_error;
 
+static volatile uint8_t twi_masterPending;	// a master operation has not finished yet
+static void (*twi_onMasterDone)(uint8_t);
+
+// Jobs from twi_queue(), run one after the other by the interrupt
+static twi_job_t * volatile twi_queueHead;
+static twi_job_t *twi_queueTail;
+static volatile uint8_t twi_queueActive;	// the head job is on the bus
+static uint8_t twi_queueReading;		// and in its read part
+
+static void twi_queueRun(void);
+
+// Result of the blocking twi_readFrom()/twi_writeTo() on the bus, kept
+// apart from twi_error and twi_masterBufferIndex, which a queued job
+// started by the interrupt right after it overwrites
+static volatile uint8_t twi_blockingPending;
+static volatile uint8_t twi_blockingResult;
+static volatile uint16_t twi_blockingCount;
+
+// Timeouts, measured with micros() from the start of a master operation
+// or the last byte it moved
+#define TWI_TIMEOUT_ERROR 0x01		// twi_error value, not a TW_STATUS
+static volatile uint32_t twi_timeoutUs = TWI_TIMEOUT_US;
+static volatile uint8_t twi_timeoutReset = true;
+static volatile uint8_t twi_timedOut;
+static volatile uint32_t twi_masterStart;
+static uint16_t twi_masterLastIndex;
+
+static void twi_handleTimeout(void);
+
+static void twi_interrupt(void);
+
+#if TWI_STATS
+static twi_stats_t twi_stats;
+static uint32_t twi_statsStart;		// when the master operation began
+static uint32_t twi_statsLast;		// when the last master event came
+static uint16_t twi_byteMicros;		// 9 SCL periods, one byte and its ack
+#endif
+
 /* 
  * Function twi_init
  * Desc     readys twi pins and sets twi bitrate
@@ -71,22 +127,25 @@ void twi_init(void)
   twi_state = TWI_READY;
   twi_sendStop = true;		// default value
   twi_inRepStart = false;
+  twi_queueHead = NULL;
+  twi_queueTail = NULL;
+  twi_queueActive = false;
   
   // activate internal pullups for twi.
   digitalWrite(SDA, 1);
   digitalWrite(SCL, 1);
 
-  // initialize twi prescaler and bit rate
-  cbi(TWSR, TWPS0);
-  cbi(TWSR, TWPS1);
-  TWBR = ((F_CPU / TWI_FREQ) - 16) / 2;
+  // init() stopped the TWI clock
+#if defined(power_twi_enable)
+  power_twi_enable();
+#endif
 
-  /* twi bit rate formula from atmega128 manual pg 204
-  SCL Frequency = CPU Clock Frequency / (16 + (2 * TWBR))
-  note: TWBR should be 10 or higher for master mode
-  It is 72 for a 16mhz Wiring board with 100kHz TWI */
+  // initialize twi prescaler and bit rate
+  twi_setFrequency(TWI_FREQ);
 
-  // enable twi module, acks, and twi interrupt
+  // take over the TWI interrupt from the core, then enable twi module,
+  // acks, and twi interrupt
+  attachInterruptTwi(twi_interrupt);
   TWCR = _BV(TWEN) | _BV(TWIE) | _BV(TWEA);
 }
 
@@ -100,6 +159,10 @@ void twi_disable(void)
 {
   // disable twi module, acks, and twi interrupt
   TWCR &= ~(_BV(TWEN) | _BV(TWIE) | _BV(TWEA));
+  detachInterruptTwi();
+#if defined(power_twi_disable)
+  power_twi_disable();
+#endif
 
   // deactivate internal pullups for twi.
   digitalWrite(SDA, 0);
@@ -118,51 +181,190 @@ void twi_setAddress(uint8_t address)
   TWAR = address << 1;
 }
 
+/* 
+ * Function twi_setSlaveBuffers
+ * Desc     sets the buffers the slave receives into and sends from;
+ *          without them, received bytes are NACKed and a read by the
+ *          master gets 0x00
+ * Input    rx: buffer for data written by the master
+ *          rxSize: its size
+ *          tx: buffer filled by twi_transmit() for the master to read
+ *          txSize: its size
+ * Output   none
+ */
+void twi_setSlaveBuffers(uint8_t* rx, uint16_t rxSize, uint8_t* tx, uint16_t txSize)
+{
+  uint8_t oldSREG = SREG;
+  cli();
+  twi_rxBuffer = rx;
+  twi_rxBufferSize = rxSize;
+  twi_txBuffer = tx;
+  twi_txBufferSize = txSize;
+  SREG = oldSREG;
+}
+
+/* 
+ * Function twi_setRegisterMap
+ * Desc     makes the slave serve map like the registers of a sensor:
+ *          the first byte the master writes sets the register pointer,
+ *          any further ones are stored at it, and reads are sent from it;
+ *          the pointer advances with each byte and survives a repeated
+ *          start. All of this happens in the TWI interrupt without
+ *          calling back, so the master sees no clock stretching; only
+ *          writes are reported, after the stop. Writes past the end are
+ *          NACKed, reads past it get 0xFF.
+ * Input    map: the registers, or NULL for the buffers from
+ *               twi_setSlaveBuffers() and their callbacks
+ *          size: number of registers, up to 256
+ *          onWrite: called from the interrupt with the first register
+ *                   written and the number of them, or NULL
+ * Output   none
+ */
+void twi_setRegisterMap(uint8_t* map, uint16_t size, void (*onWrite)(uint8_t, uint16_t))
+{
+  uint8_t oldSREG = SREG;
+  cli();
+  twi_regMap = map;
+  twi_regMapSize = size;
+  twi_regPointer = 0;
+  twi_onRegisterWrite = onWrite;
+  SREG = oldSREG;
+}
+
 /* 
  * Function twi_setClock
- * Desc     sets twi bit rate
+ * Desc     sets twi bit rate to the fastest one not above frequency,
+ *          choosing both prescaler and TWBR; F_CPU / 16 (1MHz at 16MHz)
+ *          is the fastest the hardware can do, F_CPU / 32656 the slowest
  * Input    Clock Frequency
+ * Output   the frequency actually set
+ */
+uint32_t twi_setFrequency(uint32_t frequency)
+{
+  /* twi bit rate formula from atmega328 manual
+  SCL Frequency = CPU Clock Frequency / (16 + (2 * TWBR * 4^TWPS))
+  The time SCL takes to rise adds to this, since the hardware only
+  counts the high period from when it sees SCL high. */
+  const uint32_t rise = ((F_CPU / 1000000UL) * TWI_RISE_TIME_NS + 500) / 1000;
+  uint32_t cycles;
+  uint8_t prescaler = 0;
+
+  if (0 == frequency)
+    frequency = 1;
+  // cycles per SCL period, rounded up so the clock is never too fast
+  cycles = (F_CPU + frequency - 1) / frequency;
+  cycles = (cycles > 16 + rise) ? (cycles - 16 - rise + 1) / 2 : 0;
+  // that is TWBR * 4^TWPS; use the smallest prescaler TWBR fits with
+  while (cycles > 255 && prescaler < 3) {
+    cycles = (cycles + 3) / 4;
+    prescaler++;
+  }
+  if (cycles > 255)
+    cycles = 255;
+
+  TWSR = prescaler;  // the status bits are read only
+  TWBR = cycles;
+
+  frequency = F_CPU / (16 + ((2 * cycles) << (2 * prescaler)) + rise);
+#if TWI_STATS
+  twi_byteMicros = 9000000UL / frequency;
+#endif
+  return frequency;
+}
+
+/* 
+ * Function twi_start
+ * Desc     sends the start condition, or just the address if the previous
+ *          operation ended with a repeated start
+ * Input    none
  * Output   none
  */
-void twi_setFrequency(uint32_t frequency)
+static void twi_start(void)
 {
-  TWBR = ((F_CPU / frequency) - 16) / 2;
-  
-  /* twi bit rate formula from atmega128 manual pg 204
-  SCL Frequency = CPU Clock Frequency / (16 + (2 * TWBR))
-  note: TWBR should be 10 or higher for master mode
-  It is 72 for a 16mhz Wiring board with 100kHz TWI */
+  if (true == twi_inRepStart) {
+    // if we're in the repeated start state, then we've already sent the start,
+    // (@@@ we hope), and the TWI statemachine is just waiting for the address byte.
+    // We need to remove ourselves from the repeated start state before we enable interrupts,
+    // since the ISR is ASYNC, and we could get confused if we hit the ISR before cleaning
+    // up. Rather than waiting here for the repeated start to go out, enable the
+    // interrupt without touching TWINT: the ISR then sends the address on
+    // TW_REP_START, right away if the start is done already.
+    twi_inRepStart = false;			// remember, we're dealing with an ASYNC ISR
+    TWCR = _BV(TWEN) | _BV(TWIE) | _BV(TWEA) | _BV(TWSTA);
+  }
+  else
+    // send start condition, after the stop if twi_stop()'s is still going out
+    TWCR = _BV(TWEN) | _BV(TWIE) | _BV(TWEA) | _BV(TWINT) | _BV(TWSTA) | (TWCR & _BV(TWSTO));
 }
 
 /* 
- * Function twi_readFrom
- * Desc     attempts to become twi bus master and read a
- *          series of bytes from a device on the bus
+ * Function twi_masterDone
+ * Desc     ends the current master operation and calls its callback,
+ *          then starts the next queued job if the bus is free
+ * Input    none
+ * Output   none
+ */
+static void twi_masterDone(void)
+{
+  if (twi_masterPending) {
+#if TWI_STATS
+    uint32_t time = micros() - twi_statsStart;
+    uint8_t result = twi_masterResult();
+    twi_stats.transfers++;
+    if (result)
+      twi_stats.errors[result - 2]++;
+    twi_stats.totalMicros += time;
+    if (time > twi_stats.maxMicros)
+      twi_stats.maxMicros = time;
+#endif
+    twi_masterPending = false;
+    if (twi_onMasterDone)
+      twi_onMasterDone(twi_masterResult());
+  }
+  twi_queueRun();
+}
+
+/* 
+ * Function twi_beginReadFrom
+ * Desc     starts reading a series of bytes from a device on the bus and
+ *          returns right away; the TWI interrupt does the rest. Once
+ *          twi_masterBusy() is false, twi_masterCount() tells how many
+ *          bytes arrived.
  * Input    address: 7bit i2c device address
- *          data: pointer to byte array
+ *          data: pointer to byte array, written by the interrupt
  *          length: number of bytes to read into array
  *          sendStop: Boolean indicating whether to send a stop at the end
- * Output   number of bytes read
+ *          done: called from the interrupt with the twi_masterResult()
+ *                code when the operation finished, or NULL
+ * Output   0 .. started
+ *          1 .. nothing to read
+ *          5 .. busy with another operation
  */
-uint8_t twi_readFrom(uint8_t address, uint8_t* data, uint8_t length, uint8_t sendStop)
+uint8_t twi_beginReadFrom(uint8_t address, uint8_t* data, uint16_t length, uint8_t sendStop, void (*done)(uint8_t))
 {
-  uint8_t i;
-
-  // ensure data will fit into buffer
-  if(TWI_BUFFER_LENGTH < length){
-    return 0;
+  if(0 == length){
+    return 1;
   }
 
-  // wait until twi is ready, become master receiver
-  while(TWI_READY != twi_state){
-    continue;
+  // become master receiver, unless a slave or other master operation is
+  // still going on
+  uint8_t oldSREG = SREG;
+  cli();
+  if(TWI_READY != twi_state || twi_masterPending){
+    SREG = oldSREG;
+    return 5;
   }
+  // set up everything before the interrupt can see any of it
   twi_state = TWI_MRX;
+  twi_masterPending = true;
+
   twi_sendStop = sendStop;
+  twi_onMasterDone = done;
   // reset error state (0xFF.. no error occured)
   twi_error = 0xFF;
 
   // initialize buffer iteration vars
+  twi_masterBuffer = data;
   twi_masterBufferIndex = 0;
   twi_masterBufferLength = length-1;  // This is not intuitive, read on...
   // On receive, the previously configured ACK/NACK setting is transmitted in
@@ -175,120 +377,335 @@ uint8_t twi_readFrom(uint8_t address, uint8_t* data, uint8_t length, uint8_t sen
   twi_slarw = TW_READ;
   twi_slarw |= address << 1;
 
-  if (true == twi_inRepStart) {
-    // if we're in the repeated start state, then we've already sent the start,
-    // (@@@ we hope), and the TWI statemachine is just waiting for the address byte.
-    // We need to remove ourselves from the repeated start state before we enable interrupts,
-    // since the ISR is ASYNC, and we could get confused if we hit the ISR before cleaning
-    // up. Also, don't enable the START interrupt. There may be one pending from the 
-    // repeated start that we sent ourselves, and that would really confuse things.
-    twi_inRepStart = false;			// remember, we're dealing with an ASYNC ISR
-    do {
-      TWDR = twi_slarw;
-    } while(TWCR & _BV(TWWC));
-    TWCR = _BV(TWINT) | _BV(TWEA) | _BV(TWEN) | _BV(TWIE);	// enable INTs, but not START
-  }
-  else
-    // send start condition
-    TWCR = _BV(TWEN) | _BV(TWIE) | _BV(TWEA) | _BV(TWINT) | _BV(TWSTA);
-
-  // wait for read operation to complete
-  while(TWI_MRX == twi_state){
-    continue;
-  }
-
-  if (twi_masterBufferIndex < length)
-    length = twi_masterBufferIndex;
-
-  // copy twi buffer to data
-  for(i = 0; i < length; ++i){
-    data[i] = twi_masterBuffer[i];
-  }
-	
-  return length;
+  twi_masterStart = micros();
+  twi_masterLastIndex = 0;
+#if TWI_STATS
+  twi_statsStart = twi_statsLast = twi_masterStart;
+#endif
+  twi_start();
+  SREG = oldSREG;
+  return 0;
 }
 
 /* 
- * Function twi_writeTo
- * Desc     attempts to become twi bus master and write a
- *          series of bytes to a device on the bus
+ * Function twi_beginWriteTo
+ * Desc     starts writing a series of bytes to a device on the bus and
+ *          returns right away; the TWI interrupt does the rest
  * Input    address: 7bit i2c device address
- *          data: pointer to byte array
+ *          data: pointer to byte array, read by the interrupt, so it
+ *                must not change until the operation finished
  *          length: number of bytes in array
- *          wait: boolean indicating to wait for write or not
  *          sendStop: boolean indicating whether or not to send a stop at the end
- * Output   0 .. success
- *          1 .. length to long for buffer
- *          2 .. address send, NACK received
- *          3 .. data send, NACK received
- *          4 .. other twi error (lost bus arbitration, bus error, ..)
+ *          done: called from the interrupt with the twi_masterResult()
+ *                code when the operation finished, or NULL
+ * Output   0 .. started
+ *          5 .. busy with another operation
  */
-uint8_t twi_writeTo(uint8_t address, uint8_t* data, uint8_t length, uint8_t wait, uint8_t sendStop)
+uint8_t twi_beginWriteTo(uint8_t address, const uint8_t* data, uint16_t length, uint8_t sendStop, void (*done)(uint8_t))
 {
-  uint8_t i;
-
-  // ensure data will fit into buffer
-  if(TWI_BUFFER_LENGTH < length){
-    return 1;
-  }
-
-  // wait until twi is ready, become master transmitter
-  while(TWI_READY != twi_state){
-    continue;
+  // become master transmitter, unless a slave or other master operation is
+  // still going on
+  uint8_t oldSREG = SREG;
+  cli();
+  if(TWI_READY != twi_state || twi_masterPending){
+    SREG = oldSREG;
+    return 5;
   }
+  // set up everything before the interrupt can see any of it
   twi_state = TWI_MTX;
+  twi_masterPending = true;
+
   twi_sendStop = sendStop;
+  twi_onMasterDone = done;
   // reset error state (0xFF.. no error occured)
   twi_error = 0xFF;
 
-  // initialize buffer iteration vars
+  // initialize buffer iteration vars; the ISR only reads from it
+  twi_masterBuffer = (uint8_t*)data;
   twi_masterBufferIndex = 0;
   twi_masterBufferLength = length;
   
-  // copy data to twi buffer
-  for(i = 0; i < length; ++i){
-    twi_masterBuffer[i] = data[i];
-  }
-  
   // build sla+w, slave device address + w bit
   twi_slarw = TW_WRITE;
   twi_slarw |= address << 1;
   
-  // if we're in a repeated start, then we've already sent the START
-  // in the ISR. Don't do it again.
-  //
-  if (true == twi_inRepStart) {
-    // if we're in the repeated start state, then we've already sent the start,
-    // (@@@ we hope), and the TWI statemachine is just waiting for the address byte.
-    // We need to remove ourselves from the repeated start state before we enable interrupts,
-    // since the ISR is ASYNC, and we could get confused if we hit the ISR before cleaning
-    // up. Also, don't enable the START interrupt. There may be one pending from the 
-    // repeated start that we sent outselves, and that would really confuse things.
-    twi_inRepStart = false;			// remember, we're dealing with an ASYNC ISR
-    do {
-      TWDR = twi_slarw;				
-    } while(TWCR & _BV(TWWC));
-    TWCR = _BV(TWINT) | _BV(TWEA) | _BV(TWEN) | _BV(TWIE);	// enable INTs, but not START
-  }
-  else
-    // send start condition
-    TWCR = _BV(TWINT) | _BV(TWEA) | _BV(TWEN) | _BV(TWIE) | _BV(TWSTA);	// enable INTs
+  twi_masterStart = micros();
+  twi_masterLastIndex = 0;
+#if TWI_STATS
+  twi_statsStart = twi_statsLast = twi_masterStart;
+#endif
+  twi_start();
+  SREG = oldSREG;
+  return 0;
+}
+
+/* 
+ * Function twi_masterBusy
+ * Desc     tells whether a master operation is still running; ends it
+ *          with a timeout if it hasn't moved a byte for the time set with
+ *          twi_setTimeoutInMicros()
+ * Input    none
+ * Output   true while running
+ */
+uint8_t twi_masterBusy(void)
+{
+  uint8_t timedOut = false;
 
-  // wait for write operation to complete
-  while(wait && (TWI_MTX == twi_state)){
-    continue;
+  uint8_t oldSREG = SREG;
+  cli();
+  if (twi_masterPending && twi_timeoutUs) {
+    uint32_t now = micros();
+    if (twi_masterBufferIndex != twi_masterLastIndex) {
+      // still making progress
+      twi_masterLastIndex = twi_masterBufferIndex;
+      twi_masterStart = now;
+    } else if (now - twi_masterStart > twi_timeoutUs) {
+      timedOut = true;
+    }
   }
-  
+  SREG = oldSREG;
+
+  if (timedOut)
+    twi_handleTimeout();
+  return twi_masterPending;
+}
+
+/* 
+ * Function twi_masterResult
+ * Desc     result of the last master operation
+ * Input    none
+ * Output   0 .. success
+ *          2 .. address send, NACK received
+ *          3 .. data send, NACK received
+ *          4 .. other twi error (lost bus arbitration, bus error, ..)
+ *          5 .. timeout
+ */
+uint8_t twi_masterResult(void)
+{
   if (twi_error == 0xFF)
     return 0;	// success
-  else if (twi_error == TW_MT_SLA_NACK)
+  else if (twi_error == TW_MT_SLA_NACK || twi_error == TW_MR_SLA_NACK)
     return 2;	// error: address send, nack received
   else if (twi_error == TW_MT_DATA_NACK)
     return 3;	// error: data send, nack received
+  else if (twi_error == TWI_TIMEOUT_ERROR)
+    return 5;	// error: timeout
   else
     return 4;	// other twi error
 }
 
+/* 
+ * Function twi_masterCount
+ * Desc     number of bytes transferred by the last master operation
+ * Input    none
+ * Output   bytes received or sent
+ */
+uint16_t twi_masterCount(void)
+{
+  return twi_masterBufferIndex;
+}
+
+/* 
+ * Function twi_queueDone
+ * Desc     master callback for queued jobs; starts the read part after
+ *          the write part, or finishes the job
+ * Input    status: twi_masterResult() code
+ * Output   none
+ */
+static void twi_queueDone(uint8_t status)
+{
+  twi_job_t *job = twi_queueHead;
+
+  if (!twi_queueReading && 0 == status && job->rxLength) {
+    // the write part ended with a repeated start, so the bus is still ours
+    twi_queueReading = true;
+    twi_beginReadFrom(job->address, job->rxData, job->rxLength,
+                      !(job->flags & TWI_JOB_NOSTOP), twi_queueDone);
+    return;
+  }
+
+  twi_queueHead = job->next;
+  if (!twi_queueHead)
+    twi_queueTail = NULL;
+  twi_queueActive = false;
+
+  job->count = twi_masterCount();
+  job->status = status;
+  // may queue the job again; twi_masterDone() starts the next one after
+  if (job->done)
+    job->done(job);
+}
+
+/* 
+ * Function twi_queueRun
+ * Desc     starts the first queued job, unless one is running already or
+ *          the bus is busy; in that case, twi_masterDone() or the end of
+ *          the slave operation tries again
+ * Input    none
+ * Output   none
+ */
+static void twi_queueRun(void)
+{
+  twi_job_t *job = twi_queueHead;
+  uint8_t ret;
+
+  if (twi_queueActive || !job)
+    return;
+
+  twi_queueReading = (0 == job->txLength && job->rxLength);
+  if (twi_queueReading)
+    ret = twi_beginReadFrom(job->address, job->rxData, job->rxLength,
+                            !(job->flags & TWI_JOB_NOSTOP), twi_queueDone);
+  else
+    ret = twi_beginWriteTo(job->address, job->txData, job->txLength,
+                           !job->rxLength && !(job->flags & TWI_JOB_NOSTOP),
+                           twi_queueDone);
+  if (0 == ret)
+    twi_queueActive = true;
+}
+
+/* 
+ * Function twi_queue
+ * Desc     adds a job to the end of the queue and returns right away; the
+ *          TWI interrupt runs the queued jobs in turn, between other
+ *          master operations. A job with TWI_JOB_NOSTOP holds the bus with
+ *          a repeated start for the next one.
+ * Input    job: the transaction, which must stay valid, and its buffers
+ *               unchanged, until job->status is no longer TWI_JOB_PENDING
+ * Output   none
+ */
+void twi_queue(twi_job_t* job)
+{
+  job->next = NULL;
+  job->status = TWI_JOB_PENDING;
+  job->count = 0;
+
+  uint8_t oldSREG = SREG;
+  cli();
+  if (twi_queueTail)
+    twi_queueTail->next = job;
+  else
+    twi_queueHead = job;
+  twi_queueTail = job;
+  twi_queueRun();
+  SREG = oldSREG;
+}
+
+/* 
+ * Function twi_queueBusy
+ * Desc     tells whether queued jobs are left
+ * Input    none
+ * Output   true until the last one finished
+ */
+uint8_t twi_queueBusy(void)
+{
+  twi_masterBusy();	// for its timeout
+  return NULL != twi_queueHead;
+}
+
+/* 
+ * Function twi_blockingDone
+ * Desc     master callback for twi_readFrom() and twi_writeTo()
+ * Input    status: twi_masterResult() code
+ * Output   none
+ */
+static void twi_blockingDone(uint8_t status)
+{
+  twi_blockingResult = status;
+  twi_blockingCount = twi_masterCount();
+  twi_blockingPending = false;
+}
+
+/* 
+ * Function twi_readFrom
+ * Desc     attempts to become twi bus master and read a
+ *          series of bytes from a device on the bus
+ * Input    address: 7bit i2c device address
+ *          data: pointer to byte array
+ *          length: number of bytes to read into array
+ *          sendStop: Boolean indicating whether to send a stop at the end
+ * Output   number of bytes read
+ */
+uint16_t twi_readFrom(uint8_t address, uint8_t* data, uint16_t length, uint8_t sendStop)
+{
+  // wait until twi is ready, become master receiver
+  uint32_t start = micros();
+  uint8_t ret;
+  for(;;){
+    // mark the operation as ours before the interrupt can end it
+    uint8_t oldSREG = SREG;
+    cli();
+    ret = twi_beginReadFrom(address, data, length, sendStop, twi_blockingDone);
+    if (0 == ret)
+      twi_blockingPending = true;
+    SREG = oldSREG;
+    if (5 != ret)
+      break;
+    if(twi_timeoutUs && micros() - start > twi_timeoutUs){
+      twi_handleTimeout();
+      return 0;
+    }
+  }
+  if (ret != 0)
+    return 0;
+
+  // wait for this read operation to complete, not a queued job after it
+  while(twi_blockingPending){
+    twi_masterBusy();	// for its timeout
+  }
+
+  return twi_blockingCount;
+}
+
+/* 
+ * Function twi_writeTo
+ * Desc     attempts to become twi bus master and write a
+ *          series of bytes to a device on the bus
+ * Input    address: 7bit i2c device address
+ *          data: pointer to byte array
+ *          length: number of bytes in array
+ *          wait: boolean indicating to wait for write or not
+ *          sendStop: boolean indicating whether or not to send a stop at the end
+ * Output   0 .. success
+ *          2 .. address send, NACK received
+ *          3 .. data send, NACK received
+ *          4 .. other twi error (lost bus arbitration, bus error, ..)
+ *          5 .. timeout
+ */
+uint8_t twi_writeTo(uint8_t address, uint8_t* data, uint16_t length, uint8_t wait, uint8_t sendStop)
+{
+  // wait until twi is ready, become master transmitter
+  uint32_t start = micros();
+  uint8_t ret;
+  for(;;){
+    // mark the operation as ours before the interrupt can end it
+    uint8_t oldSREG = SREG;
+    cli();
+    ret = twi_beginWriteTo(address, data, length, sendStop, twi_blockingDone);
+    if (0 == ret)
+      twi_blockingPending = true;
+    SREG = oldSREG;
+    if (5 != ret)
+      break;
+    if(twi_timeoutUs && micros() - start > twi_timeoutUs){
+      twi_handleTimeout();
+      return 5;
+    }
+  }
+  if (ret != 0)
+    return ret;
+
+  if (!wait)
+    return 0;
+
+  // wait for this write operation to complete, not a queued job after it
+  while(twi_blockingPending){
+    twi_masterBusy();	// for its timeout
+  }
+  
+  return twi_blockingResult;
+}
+
 /* 
  * Function twi_transmit
  * Desc     fills slave tx buffer with data
@@ -299,12 +716,12 @@ uint8_t twi_writeTo(uint8_t address, uint8_t* data, uint8_t length, uint8_t wait
  *          2 not slave transmitter
  *          0 ok
  */
-uint8_t twi_transmit(const uint8_t* data, uint8_t length)
+uint8_t twi_transmit(const uint8_t* data, uint16_t length)
 {
-  uint8_t i;
+  uint16_t i;
 
   // ensure data will fit into buffer
-  if(TWI_BUFFER_LENGTH < (twi_txBufferLength+length)){
+  if(twi_txBufferSize < (twi_txBufferLength+length)){
     return 1;
   }
   
@@ -371,16 +788,166 @@ void twi_stop(void)
   // send stop condition
   TWCR = _BV(TWEN) | _BV(TWIE) | _BV(TWEA) | _BV(TWINT) | _BV(TWSTO);
 
-  // wait for stop condition to be exectued on bus
+  // wait for stop condition to be executed on bus
   // TWINT is not set after a stop condition!
+  // This may run in the ISR, where micros() doesn't advance, so the
+  // timeout is counted in steps of 10 us; a slave holding SCL low
+  // would otherwise hang here for good
+  uint32_t counter = (twi_timeoutUs + 9) / 10;
   while(TWCR & _BV(TWSTO)){
-    continue;
+    if(twi_timeoutUs > 0){
+      if(counter > 0){
+        _delay_us(10);
+        counter--;
+      }else{
+        twi_handleTimeout();
+        return;
+      }
+    }
   }
 
   // update twi state
   twi_state = TWI_READY;
+  twi_masterDone();
 }
 
+/* 
+ * Function twi_recoverBus
+ * Desc     frees a bus that a slave holds, e.g. after a reset in the
+ *          middle of a read: with the TWI off, clocks SCL up to 9 times
+ *          until the slave releases SDA, then sends a stop. The TWI is
+ *          enabled again with the same bit rate and address.
+ * Input    none
+ * Output   true if SDA and SCL are both high again
+ */
+uint8_t twi_recoverBus(void)
+{
+  uint8_t twbr = TWBR;
+  uint8_t twsr = TWSR & (_BV(TWPS0) | _BV(TWPS1));
+  uint8_t twar = TWAR;
+  uint8_t i;
+
+  // with the TWI off, SCL and SDA are plain pins, only ever driven low
+  TWCR = 0;
+  pinMode(SDA, INPUT_PULLUP);
+  pinMode(SCL, INPUT_PULLUP);
+  delayMicroseconds(5);
+
+  // clock out the rest of the byte the slave is sending
+  for (i = 0; i < 9 && !digitalRead(SDA); i++) {
+    digitalWrite(SCL, LOW);
+    pinMode(SCL, OUTPUT);
+    delayMicroseconds(5);
+    pinMode(SCL, INPUT_PULLUP);
+    delayMicroseconds(5);
+  }
+
+  // stop: SDA rises while SCL is high
+  digitalWrite(SCL, LOW);
+  pinMode(SCL, OUTPUT);
+  delayMicroseconds(5);
+  digitalWrite(SDA, LOW);
+  pinMode(SDA, OUTPUT);
+  delayMicroseconds(5);
+  pinMode(SCL, INPUT_PULLUP);
+  delayMicroseconds(5);
+  pinMode(SDA, INPUT_PULLUP);
+  delayMicroseconds(5);
+
+  i = digitalRead(SDA) && digitalRead(SCL);
+
+  TWBR = twbr;
+  TWSR = twsr;
+  TWAR = twar;
+  twi_inRepStart = false;
+  TWCR = _BV(TWEN) | _BV(TWIE) | _BV(TWEA);
+
+  return i;
+}
+
+/* 
+ * Function twi_setTimeoutInMicros
+ * Desc     sets how long a master operation may wait for the bus, or go
+ *          without moving a byte, before it fails with a timeout
+ * Input    timeout: in microseconds, 0 waits forever
+ *          reset: whether a timeout also resets the TWI and runs
+ *                 twi_recoverBus()
+ * Output   none
+ */
+void twi_setTimeoutInMicros(uint32_t timeout, uint8_t reset)
+{
+  uint8_t oldSREG = SREG;
+  cli();
+  twi_timeoutUs = timeout;
+  twi_timeoutReset = reset;
+  SREG = oldSREG;
+}
+
+/* 
+ * Function twi_manageTimeoutFlag
+ * Desc     tells whether a timeout happened since the flag was cleared
+ * Input    clear: whether to clear the flag
+ * Output   the flag
+ */
+uint8_t twi_manageTimeoutFlag(uint8_t clear)
+{
+  uint8_t flag = twi_timedOut;
+  if (clear)
+    twi_timedOut = false;
+  return flag;
+}
+
+/* 
+ * Function twi_handleTimeout
+ * Desc     fails the current master operation with a timeout, after
+ *          freeing the bus if so set
+ * Input    none
+ * Output   none
+ */
+static void twi_handleTimeout(void)
+{
+  uint8_t oldSREG = SREG;
+  cli();
+  twi_timedOut = true;
+  if (twi_timeoutReset)
+    twi_recoverBus();
+  twi_state = TWI_READY;
+  if (twi_masterPending)
+    twi_error = TWI_TIMEOUT_ERROR;
+  twi_masterDone();
+  SREG = oldSREG;
+}
+
+#if TWI_STATS
+/* 
+ * Function twi_getStats
+ * Desc     copies the master operation statistics
+ * Input    stats: where to put them
+ * Output   none
+ */
+void twi_getStats(twi_stats_t* stats)
+{
+  uint8_t oldSREG = SREG;
+  cli();
+  *stats = twi_stats;
+  SREG = oldSREG;
+}
+
+/* 
+ * Function twi_clearStats
+ * Desc     starts the statistics over
+ * Input    none
+ * Output   none
+ */
+void twi_clearStats(void)
+{
+  uint8_t oldSREG = SREG;
+  cli();
+  memset(&twi_stats, 0, sizeof(twi_stats));
+  SREG = oldSREG;
+}
+#endif
+
 /* 
  * Function twi_releaseBus
  * Desc     releases bus control
@@ -394,10 +961,31 @@ void twi_releaseBus(void)
 
   // update twi state
   twi_state = TWI_READY;
+  twi_masterDone();
 }
 
-ISR(TWI_vect)
+/* 
+ * Function twi_interrupt
+ * Desc     the TWI state machine, attached to TWI_vect by twi_init()
+ * Input    none
+ * Output   none
+ */
+HOT_FUNCTION static void twi_interrupt(void)
 {
+  PROFILE_BEGIN();
+
+#if TWI_STATS
+  // a byte (or the address) of the master operation is done; whatever
+  // it took beyond 9 SCL periods, a slave held SCL low
+  if (twi_masterPending) {
+    uint32_t now = micros();
+    uint32_t time = now - twi_statsLast;
+    if (TW_STATUS != TW_START && TW_STATUS != TW_REP_START && time > twi_byteMicros)
+      twi_stats.stretchMicros += time - twi_byteMicros;
+    twi_statsLast = now;
+  }
+#endif
+
   switch(TW_STATUS){
     // All Master
     case TW_START:     // sent start condition
@@ -425,6 +1013,7 @@ ISR(TWI_vect)
 	  // at the point where we would normally issue the start.
 	  TWCR = _BV(TWINT) | _BV(TWSTA)| _BV(TWEN) ;
 	  twi_state = TWI_READY;
+	  twi_masterDone();
 	}
       }
       break;
@@ -465,9 +1054,11 @@ ISR(TWI_vect)
 	  // at the point where we would normally issue the start.
 	  TWCR = _BV(TWINT) | _BV(TWSTA)| _BV(TWEN) ;
 	  twi_state = TWI_READY;
+	  twi_masterDone();
 	}    
 	break;
     case TW_MR_SLA_NACK: // address sent, nack received
+      twi_error = TW_MR_SLA_NACK;
       twi_stop();
       break;
     // TW_MR_ARB_LOST handled by TW_MT_ARB_LOST case
@@ -477,16 +1068,38 @@ ISR(TWI_vect)
     case TW_SR_GCALL_ACK: // addressed generally, returned ack
     case TW_SR_ARB_LOST_SLA_ACK:   // lost arbitration, returned ack
     case TW_SR_ARB_LOST_GCALL_ACK: // lost arbitration, returned ack
-      // enter slave receiver mode
+      // enter slave receiver mode first, so nothing queued starts now
       twi_state = TWI_SRX;
+      // a master operation that lost arbitration, or whose start was
+      // cancelled by being addressed, has failed
+      if (twi_masterPending) {
+        twi_error = TW_MT_ARB_LOST;
+        twi_masterDone();
+      }
       // indicate that rx buffer can be overwritten and ack
       twi_rxBufferIndex = 0;
+      // in register map mode, the first byte is the register pointer
+      twi_regAddressed = true;
+      twi_regCount = 0;
       twi_reply(1);
       break;
     case TW_SR_DATA_ACK:       // data received, returned ack
     case TW_SR_GCALL_DATA_ACK: // data received generally, returned ack
+      if(twi_regMap){
+        if(twi_regAddressed){
+          twi_regAddressed = false;
+          twi_regPointer = twi_regFirst = TWDR;
+          twi_reply(1);
+        }else if(twi_regPointer < twi_regMapSize){
+          twi_regMap[twi_regPointer++] = TWDR;
+          twi_regCount++;
+          twi_reply(1);
+        }else{
+          twi_reply(0);
+        }
+      }
       // if there is still room in the rx buffer
-      if(twi_rxBufferIndex < TWI_BUFFER_LENGTH){
+      else if(twi_rxBufferIndex < twi_rxBufferSize){
         // put byte in buffer and ack
         twi_rxBuffer[twi_rxBufferIndex++] = TWDR;
         twi_reply(1);
@@ -498,8 +1111,14 @@ ISR(TWI_vect)
     case TW_SR_STOP: // stop or repeated start condition received
       // ack future responses and leave slave receiver state
       twi_releaseBus();
+      if(twi_regMap){
+        if(twi_regCount && twi_onRegisterWrite){
+          twi_onRegisterWrite(twi_regFirst, twi_regCount);
+        }
+        break;
+      }
       // put a null char after data if there's room
-      if(twi_rxBufferIndex < TWI_BUFFER_LENGTH){
+      if(twi_rxBufferIndex < twi_rxBufferSize){
         twi_rxBuffer[twi_rxBufferIndex] = '\0';
       }
       // callback to user defined callback
@@ -516,24 +1135,43 @@ ISR(TWI_vect)
     // Slave Transmitter
     case TW_ST_SLA_ACK:          // addressed, returned ack
     case TW_ST_ARB_LOST_SLA_ACK: // arbitration lost, returned ack
-      // enter slave transmitter mode
+      // enter slave transmitter mode first, so nothing queued starts now
       twi_state = TWI_STX;
+      // a master operation that lost arbitration, or whose start was
+      // cancelled by being addressed, has failed
+      if (twi_masterPending) {
+        twi_error = TW_MT_ARB_LOST;
+        twi_masterDone();
+      }
       // ready the tx buffer index for iteration
       twi_txBufferIndex = 0;
       // set tx buffer length to be zero, to verify if user changes it
       twi_txBufferLength = 0;
       // request for txBuffer to be filled and length to be set
       // note: user must call twi_transmit(bytes, length) to do this
-      twi_onSlaveTransmit();
-      // if they didn't change buffer & length, initialize it
-      if(0 == twi_txBufferLength){
-        twi_txBufferLength = 1;
-        twi_txBuffer[0] = 0x00;
+      if(!twi_regMap){
+        twi_onSlaveTransmit();
       }
       // transmit first byte from buffer, fall
     case TW_ST_DATA_ACK: // byte sent, ack returned
-      // copy data to output register
-      TWDR = twi_txBuffer[twi_txBufferIndex++];
+      if(twi_regMap){
+        // send registers for as long as the master acks them
+        if(twi_regPointer < twi_regMapSize){
+          TWDR = twi_regMap[twi_regPointer++];
+        }else{
+          TWDR = 0xFF;
+        }
+        twi_reply(1);
+        break;
+      }
+      // copy data to output register, or 0x00 if the callback didn't
+      // provide any
+      if(twi_txBufferIndex < twi_txBufferLength){
+        TWDR = twi_txBuffer[twi_txBufferIndex];
+      }else{
+        TWDR = 0x00;
+      }
+      twi_txBufferIndex++;
       // if there is more to send, ack, otherwise nack
       if(twi_txBufferIndex < twi_txBufferLength){
         twi_reply(1);
@@ -547,6 +1185,8 @@ ISR(TWI_vect)
       twi_reply(1);
       // leave slave receiver state
       twi_state = TWI_READY;
+      // start what was queued meanwhile
+      twi_queueRun();
       break;
 
     // All
@@ -557,5 +1197,7 @@ ISR(TWI_vect)
       twi_stop();
       break;
   }
+
+  PROFILE_END(PROFILE_TWI);
 }
 
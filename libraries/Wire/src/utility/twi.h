@@ -28,6 +28,30 @@
   #define TWI_FREQ 100000L
   #endif
 
+  // Time SCL takes to rise on the bus in ns, which twi_setFrequency()
+  // allows for; it depends on the pull-ups and bus capacitance, e.g.
+  // about 300 for 4.7k and 100pF. 0 keeps the plain datasheet formula.
+  #ifndef TWI_RISE_TIME_NS
+  #define TWI_RISE_TIME_NS 0
+  #endif
+
+  // How long a master operation may wait for the bus, or go without
+  // moving a byte, in microseconds, before it fails; see
+  // twi_setTimeoutInMicros()
+  #ifndef TWI_TIMEOUT_US
+  #define TWI_TIMEOUT_US 25000
+  #endif
+
+  // Build with TWI_STATS=1 (e.g. -DTWI_STATS=1 in build.extra_flags) to
+  // have twi.c count master operations and errors and time them with
+  // micros(), see twi_getStats(). That costs a micros() call in each TWI
+  // interrupt of a master operation.
+  #ifndef TWI_STATS
+  #define TWI_STATS 0
+  #endif
+
+  // twi.c has no buffers of its own any more (see twi_setSlaveBuffers()
+  // and the master functions), so this is only kept for old code
   #ifndef TWI_BUFFER_LENGTH
   #define TWI_BUFFER_LENGTH 32
   #endif
@@ -37,19 +61,66 @@
   #define TWI_MTX   2
   #define TWI_SRX   3
   #define TWI_STX   4
+
+  // twi_job_t.flags
+  #define TWI_JOB_NOSTOP  0x01  // end with a repeated start, not a stop
+
+  // twi_job_t.status while the job is queued or running
+  #define TWI_JOB_PENDING 0xFF
+
+  // One transaction for twi_queue(): txLength bytes from txData are
+  // written, then rxLength bytes read into rxData after a repeated start.
+  // Either part may be empty; with both empty only the address is sent.
+  // twi.c owns the job from twi_queue() until done is called.
+  typedef struct twi_job {
+    struct twi_job *next;       // used by twi.c
+    uint8_t address;            // 7bit i2c device address
+    uint8_t flags;
+    const uint8_t *txData;
+    uint16_t txLength;
+    uint8_t *rxData;
+    uint16_t rxLength;
+    void (*done)(struct twi_job *); // called from the interrupt, or NULL
+    volatile uint8_t status;    // TWI_JOB_PENDING, then twi_masterResult() code
+    volatile uint16_t count;    // bytes read, or written if rxLength is 0
+  } twi_job_t;
   
+  typedef struct {
+    uint32_t transfers;       // master operations finished
+    uint32_t errors[4];       // by twi_masterResult() code 2 to 5
+    uint32_t totalMicros;     // start to stop, all of them together
+    uint32_t maxMicros;       // the longest one
+    uint32_t stretchMicros;   // bytes took beyond 9 SCL periods
+  } twi_stats_t;
+
   void twi_init(void);
   void twi_disable(void);
   void twi_setAddress(uint8_t);
-  void twi_setFrequency(uint32_t);
-  uint8_t twi_readFrom(uint8_t, uint8_t*, uint8_t, uint8_t);
-  uint8_t twi_writeTo(uint8_t, uint8_t*, uint8_t, uint8_t, uint8_t);
-  uint8_t twi_transmit(const uint8_t*, uint8_t);
+  void twi_setSlaveBuffers(uint8_t*, uint16_t, uint8_t*, uint16_t);
+  void twi_setRegisterMap(uint8_t*, uint16_t, void (*)(uint8_t, uint16_t));
+  uint32_t twi_setFrequency(uint32_t);
+  uint16_t twi_readFrom(uint8_t, uint8_t*, uint16_t, uint8_t);
+  uint8_t twi_writeTo(uint8_t, uint8_t*, uint16_t, uint8_t, uint8_t);
+  uint8_t twi_beginReadFrom(uint8_t, uint8_t*, uint16_t, uint8_t, void (*)(uint8_t));
+  uint8_t twi_beginWriteTo(uint8_t, const uint8_t*, uint16_t, uint8_t, void (*)(uint8_t));
+  uint8_t twi_masterBusy(void);
+  uint8_t twi_masterResult(void);
+  uint16_t twi_masterCount(void);
+  void twi_queue(twi_job_t*);
+  uint8_t twi_queueBusy(void);
+  uint8_t twi_transmit(const uint8_t*, uint16_t);
   void twi_attachSlaveRxEvent( void (*)(uint8_t*, int) );
   void twi_attachSlaveTxEvent( void (*)(void) );
   void twi_reply(uint8_t);
   void twi_stop(void);
   void twi_releaseBus(void);
+  uint8_t twi_recoverBus(void);
+  void twi_setTimeoutInMicros(uint32_t, uint8_t);
+  uint8_t twi_manageTimeoutFlag(uint8_t);
+  #if TWI_STATS
+  void twi_getStats(twi_stats_t*);
+  void twi_clearStats(void);
+  #endif
 
 #endif
 
@@ -78,6 +78,17 @@ static const uint8_t A7 = PIN_A7;
 
 #define digitalPinToInterrupt(p)  ((p) == 2 ? 0 : ((p) == 3 ? 1 : NOT_AN_INTERRUPT))
 
+// Compile time versions of the port and bit mask tables below, for the
+// digital*Fast() functions in Arduino.h
+#define digitalPinToPortLetter(p) ( \
+  ((p) <= 7) ? 'D' : \
+  ((p) <= 13) ? 'B' : \
+  ((p) <= 19) ? 'C' : 0)
+#define digitalPinToBitNumber(p) ( \
+  ((p) <= 7) ? (p) : \
+  ((p) <= 13) ? (p) - 8 : \
+  (p) - 14)
+
 #ifdef ARDUINO_MAIN
 
 // On the Arduino board, digital pins are also used
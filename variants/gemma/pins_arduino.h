@@ -67,6 +67,16 @@ static const uint8_t A3 = PIN_A3;
 
 #define TCCR1A GTCCR
 
+// Compile time versions of the port and bit mask tables below, for the
+// digital*Fast() functions in Arduino.h
+#define digitalPinToPortLetter(p) ( \
+  ((p) <= 9) ? 'B' : 0)
+#define digitalPinToBitNumber(p) ( \
+  ((p) <= 5) ? (p) : \
+  ((p) <= 6) ? 5 : \
+  ((p) <= 7) ? 2 : \
+  12 - (p))
+
 #ifdef ARDUINO_MAIN
 
 void initVariant()
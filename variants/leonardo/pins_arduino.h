@@ -159,6 +159,41 @@ extern const uint8_t PROGMEM analog_pin_to_channel_PGM[];
 
 #define digitalPinToInterrupt(p) ((p) == 0 ? 2 : ((p) == 1 ? 3 : ((p) == 2 ? 1 : ((p) == 3 ? 0 : ((p) == 7 ? 4 : NOT_AN_INTERRUPT)))))
 
+// Compile time versions of the port and bit mask tables below, for the
+// digital*Fast() functions in Arduino.h
+#define digitalPinToPortLetter(p) ( \
+  ((p) <= 4) ? 'D' : \
+  ((p) <= 5) ? 'C' : \
+  ((p) <= 6) ? 'D' : \
+  ((p) <= 7) ? 'E' : \
+  ((p) <= 11) ? 'B' : \
+  ((p) <= 12) ? 'D' : \
+  ((p) <= 13) ? 'C' : \
+  ((p) <= 17) ? 'B' : \
+  ((p) <= 23) ? 'F' : \
+  ((p) <= 25) ? 'D' : \
+  ((p) <= 28) ? 'B' : \
+  ((p) <= 30) ? 'D' : 0)
+#define digitalPinToBitNumber(p) ( \
+  ((p) <= 1) ? (p) + 2 : \
+  ((p) <= 3) ? 3 - (p) : \
+  ((p) <= 4) ? 4 : \
+  ((p) <= 5) ? 6 : \
+  ((p) <= 6) ? 7 : \
+  ((p) <= 7) ? 6 : \
+  ((p) <= 11) ? (p) - 4 : \
+  ((p) <= 12) ? 6 : \
+  ((p) <= 13) ? 7 : \
+  ((p) <= 14) ? 3 : \
+  ((p) <= 16) ? (p) - 14 : \
+  ((p) <= 17) ? 0 : \
+  ((p) <= 21) ? 25 - (p) : \
+  ((p) <= 23) ? 23 - (p) : \
+  ((p) <= 24) ? 4 : \
+  ((p) <= 25) ? 7 : \
+  ((p) <= 28) ? (p) - 22 : \
+  35 - (p))
+
 #ifdef ARDUINO_MAIN
 
 // On the Arduino board, digital pins are also used
@@ -109,6 +109,44 @@ static const uint8_t A15 = PIN_A15;
 
 #define digitalPinToInterrupt(p) ((p) == 2 ? 0 : ((p) == 3 ? 1 : ((p) >= 18 && (p) <= 21 ? 23 - (p) : NOT_AN_INTERRUPT)))
 
+// Compile time versions of the port and bit mask tables below, for the
+// digital*Fast() functions in Arduino.h
+#define digitalPinToPortLetter(p) ( \
+  ((p) <= 3) ? 'E' : \
+  ((p) <= 4) ? 'G' : \
+  ((p) <= 5) ? 'E' : \
+  ((p) <= 9) ? 'H' : \
+  ((p) <= 13) ? 'B' : \
+  ((p) <= 15) ? 'J' : \
+  ((p) <= 17) ? 'H' : \
+  ((p) <= 21) ? 'D' : \
+  ((p) <= 29) ? 'A' : \
+  ((p) <= 37) ? 'C' : \
+  ((p) <= 38) ? 'D' : \
+  ((p) <= 41) ? 'G' : \
+  ((p) <= 49) ? 'L' : \
+  ((p) <= 53) ? 'B' : \
+  ((p) <= 61) ? 'F' : \
+  ((p) <= 69) ? 'K' : 0)
+#define digitalPinToBitNumber(p) ( \
+  ((p) <= 1) ? (p) : \
+  ((p) <= 3) ? (p) + 2 : \
+  ((p) <= 4) ? 5 : \
+  ((p) <= 5) ? 3 : \
+  ((p) <= 9) ? (p) - 3 : \
+  ((p) <= 13) ? (p) - 6 : \
+  ((p) <= 15) ? 15 - (p) : \
+  ((p) <= 17) ? 17 - (p) : \
+  ((p) <= 21) ? 21 - (p) : \
+  ((p) <= 29) ? (p) - 22 : \
+  ((p) <= 37) ? 37 - (p) : \
+  ((p) <= 38) ? 7 : \
+  ((p) <= 41) ? 41 - (p) : \
+  ((p) <= 49) ? 49 - (p) : \
+  ((p) <= 53) ? 53 - (p) : \
+  ((p) <= 61) ? (p) - 54 : \
+  (p) - 62)
+
 #ifdef ARDUINO_MAIN
 
 const uint16_t PROGMEM port_to_mode_PGM[] = {